@@ -89,24 +89,40 @@ STACK_BOTTOM = $1f80
         .long Tad_Init
         .long Tad_Process
         .long Tad_FinishLoadingData
+        .long Tad_ProcessNmi
+        .long Tad_StageSong
         .long Tad_QueueCommand
         .long Tad_QueueCommandOverride
+        .long Tad_GetCommandQueueSpace
         .long Tad_QueuePannedSoundEffect
         .long Tad_QueueSoundEffect
+        .long Tad_BatchPannedSoundEffect
+        .long Tad_BatchSoundEffect
+        .long Tad_GetSfxBatchSpace
         .long Tad_LoadSong
         .long Tad_LoadSongIfChanged
         .long Tad_GetSong
         .long Tad_ReloadCommonAudioData
+        .long Tad_PatchCommonAudioData
+        .long Tad_SetSongStagingBuffer
+        .long Tad_GetStagedSongHandshakes
         .long Tad_SetMono
         .long Tad_SetStereo
         .long Tad_GetStereoFlag
         .long Tad_SongsStartImmediately
         .long Tad_SongsStartPaused
+        .long Tad_UseCompressedAudioData
+        .long Tad_UseUncompressedAudioData
+        .long Tad_EnableTickBudget
+        .long Tad_DisableTickBudget
         .long Tad_SetTransferSize
+        .long Tad_SetTransferDeadline
         .long Tad_IsLoaderActive
+        .long Tad_GetLoadProgress
         .long Tad_IsSongLoaded
         .long Tad_IsSfxPlaying
         .long Tad_IsSongPlaying
+        .long Tad_GetDriverHeadroom
 .send
 
 
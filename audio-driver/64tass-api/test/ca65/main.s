@@ -36,24 +36,40 @@ TadSubroutines:
     .faraddr Tad_Init
     .faraddr Tad_Process
     .faraddr Tad_FinishLoadingData
+    .faraddr Tad_ProcessNmi
+    .faraddr Tad_StageSong
     .faraddr Tad_QueueCommand
     .faraddr Tad_QueueCommandOverride
+    .faraddr Tad_GetCommandQueueSpace
     .faraddr Tad_QueuePannedSoundEffect
     .faraddr Tad_QueueSoundEffect
+    .faraddr Tad_BatchPannedSoundEffect
+    .faraddr Tad_BatchSoundEffect
+    .faraddr Tad_GetSfxBatchSpace
     .faraddr Tad_LoadSong
     .faraddr Tad_LoadSongIfChanged
     .faraddr Tad_GetSong
     .faraddr Tad_ReloadCommonAudioData
+    .faraddr Tad_PatchCommonAudioData
+    .faraddr Tad_SetSongStagingBuffer
+    .faraddr Tad_GetStagedSongHandshakes
     .faraddr Tad_SetMono
     .faraddr Tad_SetStereo
     .faraddr Tad_GetStereoFlag
     .faraddr Tad_SongsStartImmediately
     .faraddr Tad_SongsStartPaused
+    .faraddr Tad_UseCompressedAudioData
+    .faraddr Tad_UseUncompressedAudioData
+    .faraddr Tad_EnableTickBudget
+    .faraddr Tad_DisableTickBudget
     .faraddr Tad_SetTransferSize
+    .faraddr Tad_SetTransferDeadline
     .faraddr Tad_IsLoaderActive
+    .faraddr Tad_GetLoadProgress
     .faraddr Tad_IsSongLoaded
     .faraddr Tad_IsSfxPlaying
     .faraddr Tad_IsSongPlaying
+    .faraddr Tad_GetDriverHeadroom
 
 
 .export Tad_Loader_Bin          =   $1234
@@ -33,13 +33,20 @@
 .autoimport -
 
 
-.export Tad_Init : far, Tad_Process : far, Tad_FinishLoadingData : far
-.export Tad_QueueCommand, Tad_QueueCommandOverride
+.export Tad_Init : far, Tad_Process : far, Tad_FinishLoadingData : far, Tad_ProcessNmi : far
+.export Tad_QueueCommand, Tad_QueueCommandOverride, Tad_GetCommandQueueSpace
 .export Tad_QueuePannedSoundEffect, Tad_QueueSoundEffect
-.export Tad_LoadSong, Tad_LoadSongIfChanged, Tad_GetSong, Tad_ReloadCommonAudioData
+.export Tad_BatchPannedSoundEffect, Tad_BatchSoundEffect, Tad_GetSfxBatchSpace
+.export Tad_LoadSong, Tad_LoadSongIfChanged, Tad_GetSong
+.export Tad_ReloadCommonAudioData, Tad_PatchCommonAudioData
+.export Tad_StageSong : far, Tad_SetSongStagingBuffer, Tad_GetStagedSongHandshakes
 .export Tad_SetMono, Tad_SetStereo, Tad_GetStereoFlag
-.export Tad_SongsStartImmediately, Tad_SongsStartPaused, Tad_SetTransferSize
-.export Tad_IsLoaderActive, Tad_IsSongLoaded, Tad_IsSfxPlaying, Tad_IsSongPlaying
+.export Tad_SongsStartImmediately, Tad_SongsStartPaused
+.export Tad_UseCompressedAudioData, Tad_UseUncompressedAudioData
+.export Tad_EnableTickBudget, Tad_DisableTickBudget
+.export Tad_SetTransferSize, Tad_SetTransferDeadline
+.export Tad_IsLoaderActive, Tad_GetLoadProgress, Tad_IsSongLoaded, Tad_IsSfxPlaying, Tad_IsSongPlaying
+.export Tad_GetDriverHeadroom
 
 .exportzp Tad_sfxQueue_sfx, Tad_sfxQueue_pan
 
@@ -108,7 +115,7 @@
 
 ;; Terrific Audio Driver spc700 Loader (loader.bin)
 .import Tad_Loader_Bin
-.importzp Tad_Loader_SIZE
+.import Tad_Loader_SIZE
 
 ;; Terrific Audio Driver spc700 driver (audio-driver.bin)
 .import Tad_AudioDriver_Bin, Tad_AudioDriver_SIZE
@@ -118,7 +125,7 @@
 .importzp Tad_BlankSong_SIZE
 
 
-.assert Tad_Loader_SIZE > 64 && Tad_Loader_SIZE < 128, lderror, "Invalid Tad_Loader_Bin size"
+.assert Tad_Loader_SIZE > 64 && Tad_Loader_SIZE < $400, lderror, "Invalid Tad_Loader_Bin size"
 .assert .bankbyte(Tad_Loader_Bin) = .bankbyte(Tad_Loader_Bin + Tad_Loader_SIZE), lderror, "Tad_Loader_Bin does not fit inside a single bank"
 
 .assert Tad_AudioDriver_SIZE > $600 && Tad_AudioDriver_SIZE < $b80, lderror, "Invalid Tad_AudioDriver_Bin size"
@@ -175,6 +182,9 @@ TAD_MAX_TRANSFER_PER_FRAME = 800
 ;; MUST BE > 0
 TAD_DEFAULT_TRANSFER_PER_FRAME = 256
 
+;; `Tad_SetTransferDeadline` value to disable the transfer deadline
+TAD_NO_TRANSFER_DEADLINE = 0
+
 
 
 ;; ========
@@ -186,7 +196,7 @@ TAD_DEFAULT_TRANSFER_PER_FRAME = 256
 ;; Used by `tad-compiler ca65-export` to verify the IO protocol in `tad-audio.s` matches the audio-driver.
 ;;
 ;; This constant MUST be increased if `LOADER_ADDR` or the IO Communication protocol changes.
-.export TAD_IO_VERSION : abs = 16
+.export TAD_IO_VERSION : abs = 21
 
 
 ; MUST match `audio-driver/src/io-commands.wiz`
@@ -204,6 +214,16 @@ TAD_DEFAULT_TRANSFER_PER_FRAME = 256
 TAD_MAX_PAN = 128
 TAD_CENTER_PAN = TAD_MAX_PAN / 2
 
+;; Number of commands the command queue can hold
+;; (MUST be a power of two)
+TAD_COMMAND_QUEUE_SIZE = 4
+.assert TAD_COMMAND_QUEUE_SIZE & (TAD_COMMAND_QUEUE_SIZE - 1) = 0, error
+
+;; Number of sound effects the sound effect batch can hold
+;; (MUST be a power of two)
+TAD_SFX_BATCH_SIZE = 4
+.assert TAD_SFX_BATCH_SIZE & (TAD_SFX_BATCH_SIZE - 1) = 0, error
+
 
 ;; MUST match `audio-driver/src/io-commands.wiz`
 .scope TadIO_ToDriver
@@ -275,6 +295,19 @@ TAD_CENTER_PAN = TAD_MAX_PAN / 2
 
     ;; The S-SMP is running the audio-driver.
     MODE_AUDIO_DRIVER = $61 ; 'a'
+
+
+    ;; Tick headroom of the last music and sound effect ticks.
+    ;;
+    ;; The number of 0.5ms timer counts left in the audio driver's tick budget after the
+    ;; channels were processed (0 if the tick was at or over budget).
+    ;;
+    ;; Not used in the loader.
+    MUSIC_HEADROOM_PORT = $2142 ; APUIO2
+    SFX_HEADROOM_PORT = $2143 ; APUIO3
+
+    ;; The headroom of a tick that did not process any channels.
+    MAX_HEADROOM = 7
 .endscope
 
 
@@ -306,6 +339,27 @@ TAD_CENTER_PAN = TAD_MAX_PAN / 2
     ;; MUST NOT be set when loading code or common-audio-data.
     PLAY_SONG_BIT = 6
     PLAY_SONG_FLAG = 1 << PLAY_SONG_BIT
+
+    ;; If this bit is set, the audio driver skips the vibrato and portamento of the remaining
+    ;; channels for a tick that takes too long to process.
+    ;;
+    ;; MUST NOT be set when loading code or common-audio-data.
+    TICK_BUDGET_BIT = 2
+    TICK_BUDGET_FLAG = 1 << TICK_BUDGET_BIT
+
+    ;; If this bit is set, the data is transferred 3 bytes at a time
+    ;; (using `TadIO_Loader::FAST_DATA_PORT_*`).
+    ;;
+    ;; MUST NOT be set when loading common-audio-data.
+    FAST_TRANSFER_BIT = 4
+    FAST_TRANSFER_FLAG = 1 << FAST_TRANSFER_BIT
+
+    ;; If this bit is set, the data is compressed and is decompressed by the loader.
+    ;;
+    ;; MUST NOT be set when loading code.
+    ;; MUST NOT be set with the `FAST_TRANSFER_FLAG`.
+    COMPRESSED_BIT = 5
+    COMPRESSED_FLAG = 1 << COMPRESSED_BIT
 .endscope
 
 
@@ -329,6 +383,14 @@ TAD_CENTER_PAN = TAD_MAX_PAN / 2
     DATA_PORT_H   = $2142 ; APUIO2
     SPINLOCK_PORT = $2143 ; APUIO3
 
+    ;; The data ports used if `TadLoaderDataType::FAST_TRANSFER_FLAG` was sent to the loader.
+    ;;
+    ;; `FAST_DATA_PORT_0` MUST be cleared at the end of a fast transfer
+    ;; (it is also `TadIO_ToDriver::COMMAND_PORT`).
+    FAST_DATA_PORT_0 = $2140 ; APUIO0
+    FAST_DATA_PORT_1 = $2141 ; APUIO1
+    FAST_DATA_PORT_2 = $2142 ; APUIO2
+
     ;; The spinlock value when the audio driver starts playing a song
     SPINLOCK_INIT_VALUE = 0
 
@@ -343,6 +405,12 @@ TAD_CENTER_PAN = TAD_MAX_PAN / 2
 .endscope
 
 
+;; PPU registers used to read the vertical scanline counter
+TAD__SLHV   = $2137 ; Reading latches the H/V counters
+TAD__OPVCT  = $213d ; Latched vertical counter (low byte then high bit)
+TAD__STAT78 = $213f ; Reading resets the OPVCT read flip-flop
+
+
 ;; =========
 ;; Variables
 ;; =========
@@ -388,9 +456,27 @@ TAD__FIRST_LOADING_SONG_STATE = TadState::LOADING_SONG_DATA_PAUSED
     ;; This flag is cleared after the *common audio data* is loaded into Audio-RAM
     RELOAD_COMMON_AUDIO_DATA = 1 << 0
 
+    ;; If set, the next *common audio data* transfer will send the `Tad_commonAudioDataPatch`
+    ;; instead of calling `LoadAudioData`.
+    ;;
+    ;; This flag is cleared after the patch is loaded into Audio-RAM
+    ;; (MUST only be set with `RELOAD_COMMON_AUDIO_DATA`)
+    PATCH_COMMON_AUDIO_DATA  = 1 << 1
+
+    ;; If set, the data returned by `LoadAudioData` is compressed.
+    ;; (The blank song is never compressed)
+    ;; Default: Clear
+    COMPRESSED_AUDIO_DATA    = TadLoaderDataType::COMPRESSED_FLAG
+
+    ;; The tick budget guard flag
+    ;;  * If set, the audio driver skips the vibrato and portamento of the remaining channels
+    ;;    when a tick is over budget.
+    ;; Default: Clear
+    TICK_BUDGET              = TadLoaderDataType::TICK_BUDGET_FLAG
+
 
     ;; A mask for the flags that are sent to the loader
-    _LOADER_MASK = STEREO | PLAY_SONG_IMMEDIATELY
+    _LOADER_MASK = STEREO | PLAY_SONG_IMMEDIATELY | TICK_BUDGET
 .endscope
 
 
@@ -411,6 +497,24 @@ TAD__FIRST_LOADING_SONG_STATE = TadState::LOADING_SONG_DATA_PAUSED
     ;; The previous `TadIO_ToScpu::COMMAND_PORT` sent to the S-SMP audio driver.
     Tad_previousCommand: .res 1
 
+    ;; Non-zero if `Tad_Process`, `Tad_FinishLoadingData` or `Tad_LoadSong` is executing.
+    ;; `Tad_ProcessNmi` does nothing if this value is non-zero.
+    Tad_processLock: .res 1
+
+    ;; Non-zero if `Tad_Process` was called after the previous `Tad_ProcessNmi` call.
+    ;; Used by `Tad_ProcessNmi` to detect lag frames.
+    Tad_processCalled: .res 1
+
+    ;; Non-zero if `Tad_Process` may have work to do.
+    ;;
+    ;; Set by `Tad_Init`, `Tad_LoadSong` and the command queue and sound effect batch subroutines.
+    ;; Cleared by `Tad_Process` when the state is PAUSED, PLAYING_SFX or PLAYING and there is
+    ;; nothing to send to the audio driver.
+    ;;
+    ;; If zero and `Tad_sfxQueue_sfx` is empty, `Tad_Process` returns immediately.
+    ;; (`Tad_sfxQueue_sfx` is public, it is tested separately.)
+    Tad_workPending: .res 1
+
 
 ;; ---------------------------------------------------
 ;; Queue 1 - remaining data to transfer into Audio-RAM
@@ -437,17 +541,24 @@ TAD__FIRST_LOADING_SONG_STATE = TadState::LOADING_SONG_DATA_PAUSED
     Tad_nextSong: .res 1
 
 
-;; ------------------------------------------------------
-;; Queue 3 - The next command to send to the audio driver
-;; ------------------------------------------------------
+;; --------------------------------------------------
+;; Queue 3 - The commands to send to the audio driver
+;; --------------------------------------------------
 .bss
-    ;; The next `TadCommand` to send to the audio driver.
-    ;; MUST NOT be PLAY_SOUND_EFFECT_COMMAND.
-    ;; If this value is negative, the queue is empty.
-    Tad_nextCommand_id: .res 1
+    ;; A ring buffer of the `TadCommand`s to send to the audio driver.
+    ;; MUST NOT contain PLAY_SOUND_EFFECT_COMMAND.
+    Tad_commandQueue_id: .res TAD_COMMAND_QUEUE_SIZE
 
-    ;; The parameter of the next next command (if any)
-    Tad_nextCommand_parameter: .res 1
+    ;; The parameter of each queued command (if any)
+    Tad_commandQueue_parameter: .res TAD_COMMAND_QUEUE_SIZE
+
+    ;; Index of the oldest command in the queue
+    ;; (MUST be < TAD_COMMAND_QUEUE_SIZE)
+    Tad_commandQueue_readIndex: .res 1
+
+    ;; Number of commands in the queue.
+    ;; If this value is 0, the queue is empty.
+    Tad_commandQueue_count: .res 1
 
 
 ;; ---------------------------------------
@@ -459,6 +570,84 @@ TAD__FIRST_LOADING_SONG_STATE = TadState::LOADING_SONG_DATA_PAUSED
     Tad_sfxQueue_pan: .res 1
 
 
+;; ---------------------------------------
+;; Queue 5 - Batched sound effects to play
+;; ---------------------------------------
+.bss
+    ;; A ring buffer of the sound effects to send to the audio driver
+    ;; after the sound effect queue is empty.
+    Tad_sfxBatch_sfx: .res TAD_SFX_BATCH_SIZE
+
+    ;; The pan value of each batched sound effect
+    Tad_sfxBatch_pan: .res TAD_SFX_BATCH_SIZE
+
+    ;; Index of the oldest sound effect in the batch
+    ;; (MUST be < TAD_SFX_BATCH_SIZE)
+    Tad_sfxBatch_readIndex: .res 1
+
+    ;; Number of sound effects in the batch.
+    ;; If this value is 0, the batch is empty.
+    Tad_sfxBatch_count: .res 1
+
+
+;; ------------------------
+;; Loader transfer deadline
+;; ------------------------
+.bss
+    ;; The scanline `Tad_Process` stops transferring data to the loader at.
+    ;; If this value is `TAD_NO_TRANSFER_DEADLINE`, `Tad_bytesToTransferPerFrame` bytes are
+    ;; transferred per `Tad_Process` call.
+    Tad_transferDeadline: .res 2
+
+    ;; The scanline the current `Tad_Process` transfer started at.
+    ;; Used to detect a deadline that is after the last scanline of the frame.
+    Tad_transferStartScanline: .res 2
+
+
+;; ------------------
+;; Loader data type
+;; ------------------
+.bss
+    ;; The `TadLoaderDataType` sent to the loader.
+    ;; Used to determine how the data is transferred to the loader.
+    Tad_dataToTransfer_loaderDataType: .res 1
+
+
+;; ------------------------
+;; Common audio data patch
+;; ------------------------
+.bss
+    ;; The compressed patch to transfer if the `PATCH_COMMON_AUDIO_DATA` flag is set.
+    ;; (see `Tad_PatchCommonAudioData`)
+    Tad_commonAudioDataPatch_addr: .res 2
+    Tad_commonAudioDataPatch_bank: .res 1
+    Tad_commonAudioDataPatch_size: .res 2
+
+
+;; ------------
+;; Song staging
+;; ------------
+.bss
+    ;; The Work-RAM buffer `Tad_StageSong` copies song data into (see `Tad_SetSongStagingBuffer`)
+    Tad_songStaging_addr: .res 2
+    Tad_songStaging_bank: .res 1
+    Tad_songStaging_bufferSize: .res 2
+
+    ;; The song in the staging buffer.
+    ;; If this value is 0, no song is staged.
+    Tad_stagedSong: .res 1
+
+    ;; Size of the staged song data
+    Tad_stagedSong_size: .res 2
+
+    ;; The `TadLoaderDataType` transfer flag of the staged song
+    ;; (`FAST_TRANSFER_FLAG` or `COMPRESSED_FLAG`)
+    Tad_stagedSong_transferFlag: .res 1
+
+    ;; Far pointer to the next staging buffer byte (only used by `Tad_StageSong`)
+    Tad_songStaging_writePtr: .res 3
+
+
 ;; Memory Map Asserts
 ;; ==================
 .bss
@@ -514,10 +703,9 @@ APUIO3 = $2143
 
 
     ; Transfer the data
-    .assert Tad_Loader_SIZE < $ff, error, "Cannot fit Tad_Loader_SIZE in an 8 bit index"
+    ; (The IPL only tests the low byte of the index)
+    .assert .lobyte(Tad_Loader_SIZE + 2) <> 0, error, "Invalid Tad_Loader_SIZE (execute command is 0)"
 
-    sep     #$30
-.i8
     ldx     #0
     @IplLoop:
         ; Send the next byte to the IPL
@@ -525,25 +713,23 @@ APUIO3 = $2143
         sta     APUIO1
 
         ; Tell the IPL the next byte is ready
-        stx     APUIO0
+        txa
+        sta     APUIO0
 
         ; Wait for a response form the IPL
         :
-            cpx     APUIO0
+            cmp     APUIO0
             bne     :-
 
         inx
         cpx     #Tad_Loader_SIZE
         bcc     @IplLoop
 
-    rep     #$10
-.i16
-
     ; Send an execute program command to the IPL
     ldx     #TAD_LOADER_ARAM_ADDR
     stx     APUIO2                  ; A-RAM address
     stz     APUIO1                  ; zero = execute program at A-RAM address
-    lda     #Tad_Loader_SIZE + 2
+    lda     #.lobyte(Tad_Loader_SIZE + 2)
     sta     APUIO0                  ; New data command (must be +2 the previous APUIO0 write)
 .endmacro
 
@@ -566,6 +752,7 @@ APUIO3 = $2143
     bne     ReturnFalse
         ; Send the ready signal and the TadLoaderDataType
         sta     TadIO_Loader_Init::LOADER_DATA_TYPE_PORT
+        sta     Tad_dataToTransfer_loaderDataType
 
         lda     #TadIO_Loader_Init::LOADER_READY_L
         sta     TadIO_Loader_Init::READY_PORT_L
@@ -626,6 +813,13 @@ ReturnFalse:
     cmp     f:TadIO_Loader::SPINLOCK_PORT
     bne     @ReturnFalse
 
+    ; Transfer 3 bytes at a time if the fast transfer flag was sent to the loader
+    lda     Tad_dataToTransfer_loaderDataType
+    bit     #TadLoaderDataType::FAST_TRANSFER_FLAG
+    beq     :+
+        jmp     _Tad_Loader_TransferDataFast
+    :
+
     phd
     phb
 
@@ -758,9 +952,207 @@ ReturnFalse:
 .endproc
 
 
+;; Transfer data to the audio loader, 3 bytes at a time.
+;;
+;; ASSUMES: The loader is ready (tested by `_Tad_Loader_TransferData`).
+;; ASSUMES: `TadLoaderDataType::FAST_TRANSFER_FLAG` was sent to the loader.
+;;
+;; NOTE: This function may read two bytes past the end of the transfer queue.
+;;
+;; OUT: carry set if all data in the transfer queue was sent to Audio-RAM.
+;;
+.a8
+.i16
+;; DB access lowram
+.proc _Tad_Loader_TransferDataFast
+    phd
+    phb
+
+    rep     #$30
+.a16
+
+    ; Calculate number of bytes to read
+    lda     Tad_dataToTransfer_size
+    cmp     Tad_bytesToTransferPerFrame
+    bcc     :+
+        lda     Tad_bytesToTransferPerFrame
+    :
+
+    ; Prevent corrupting all of Audio-RAM if number of bytes == 0
+    cmp     #1
+    bcs     :+
+        lda     #1
+    :
+    ; Store bytes to read in X
+    tax
+
+    ; Reverse subtract Tad_dataToTransfer_size (with clamping)
+    eor     #$ffff
+    sec
+    adc     Tad_dataToTransfer_size
+    bcs     :+
+        lda     #0
+    :
+    sta     Tad_dataToTransfer_size
+
+
+    lda     #$2100
+    tcd
+; D = $2100
+
+    sep     #$20
+.a8
+
+    lda     Tad_dataToTransfer_bank
+    ldy     Tad_dataToTransfer_addr
+
+    pha
+    plb
+; DB = Tad_dataToTransfer_bank
+
+    @Loop:
+        ; x = number of bytes remaining
+        ; y = data address (using y to force addr,y addressing mode)
+
+        lda     a:0,y
+        sta     z:.lobyte(TadIO_Loader::FAST_DATA_PORT_0)
+
+        ; The bank overflow test must be done after every byte
+        iny
+        beq     @BankOverflow_1
+    @BankOverflow_1_Resume:
+
+        lda     a:0,y
+        sta     z:.lobyte(TadIO_Loader::FAST_DATA_PORT_1)
+
+        iny
+        beq     @BankOverflow_2
+    @BankOverflow_2_Resume:
+
+        lda     a:0,y
+        sta     z:.lobyte(TadIO_Loader::FAST_DATA_PORT_2)
+
+        ; Increment this spinloack value
+        ;
+        ; y increments by 3, `(y & 7) + 1` is different on every write.
+        tya
+        and     #7
+        inc
+        sta     z:.lobyte(TadIO_Loader::SPINLOCK_PORT)
+
+        iny
+        beq     @BankOverflow_3
+    @BankOverflow_3_Resume:
+
+        dex
+        dex
+        dex
+        beq     @EndLoop
+        bmi     @EndLoop
+
+        ; Spinloop until the S-SMP has acknowledged the data
+        :
+            cmp     z:.lobyte(TadIO_Loader::SPINLOCK_PORT)
+            bne     :-
+
+        bra     @Loop
+@EndLoop:
+
+    plb
+    pld
+; DB restored
+; D = 0
+
+    sty     Tad_dataToTransfer_addr
+    sta     Tad_dataToTransfer_prevSpinLock
+
+    rep     #$20
+.a16
+    ; Remove the padding bytes from Tad_dataToTransfer_size (with clamping)
+    ; X = 0 - number of bytes sent after the end of this block
+    txa
+    clc
+    adc     Tad_dataToTransfer_size
+    bcs     :+
+        ; No padding bytes or Tad_dataToTransfer_size underflowed
+        cpx     #0
+        beq     :+
+            lda     #0
+    :
+    sta     Tad_dataToTransfer_size
+
+    sep     #$20
+.a8
+
+    ldy     Tad_dataToTransfer_size
+    bne     @ReturnFalse
+        ; End of data transfer
+
+        ; Wait for Loader to acknowledge the last write
+        lda     Tad_dataToTransfer_prevSpinLock
+        :
+            cmp     f:TadIO_Loader::SPINLOCK_PORT
+            bne     :-
+
+        ; Clear the command port (the audio driver reads it after the song has loaded)
+        lda     #0
+        sta     f:TadIO_Loader::FAST_DATA_PORT_0
+
+        ; No more data to transfer
+        lda     #TadIO_Loader::SPINLOCK_COMPLETE
+        sta     f:TadIO_Loader::SPINLOCK_PORT
+
+        sec
+        rts
+
+@ReturnFalse:
+    clc
+    rts
+
+
+@BankOverflow_1:
+    jsr     __Tad_Loader_GotoNextBank
+    bra     @BankOverflow_1_Resume
+
+@BankOverflow_2:
+    jsr     __Tad_Loader_GotoNextBank
+    bra     @BankOverflow_2_Resume
+
+@BankOverflow_3:
+    ; Must save/restore A, it holds the spinlock
+    pha
+        jsr     __Tad_Loader_GotoNextBank
+    pla
+    bra     @BankOverflow_3_Resume
+.endproc
+
+
+;; Read the PPU's vertical scanline counter
+;;
+;; NOTE: The H/V counters are only latched if bit 7 of WRIO ($4201) is set.
+;;
+;; OUT: X = vertical scanline counter
+.a8
+.i16
+;; DB unknown
+.proc _Tad_ReadVCounter
+    lda     f:TAD__STAT78
+    lda     f:TAD__SLHV
+
+    lda     f:TAD__OPVCT
+    xba
+    lda     f:TAD__OPVCT
+    and     #1
+    xba
+    tax
+
+    rts
+.endproc
+
+
 ;; Advance to the next bank
 ;;
-;; MUST only be called to _Tad_Loader_TransferData
+;; MUST only be called to _Tad_Loader_TransferData or _Tad_Loader_TransferDataFast
 ;;
 ;; ASSUMES: Y = 0 (Y addr overflowed to 0)
 ;;
@@ -859,19 +1251,31 @@ ReturnFalse:
     ldx     #TAD_DEFAULT_TRANSFER_PER_FRAME
     stx     Tad_bytesToTransferPerFrame
 
+    ldx     #TAD_NO_TRANSFER_DEADLINE
+    stx     Tad_transferDeadline
+
     lda     #.bankbyte(Tad_AudioDriver_Bin)
     ldx     #.loword(Tad_AudioDriver_Bin)
     ldy     #Tad_AudioDriver_SIZE
     jsr     _Tad_Loader_SetDataToTransfer
 
+    stz     Tad_commandQueue_readIndex
+    stz     Tad_commandQueue_count
+
+    stz     Tad_sfxBatch_readIndex
+    stz     Tad_sfxBatch_count
+
     lda     #$ff
-    sta     Tad_nextCommand_id
     sta     Tad_sfxQueue_sfx
 
     stz     Tad_nextSong
+    stz     Tad_stagedSong
+
+    stz     Tad_processLock
+    stz     Tad_processCalled
 
     @DataTypeLoop:
-        lda     #TadLoaderDataType::CODE
+        lda     #TadLoaderDataType::CODE | TadLoaderDataType::FAST_TRANSFER_FLAG
         jsr     _Tad_Loader_CheckReadyAndSendLoaderDataType
         bcc     @DataTypeLoop
 
@@ -882,20 +1286,22 @@ ReturnFalse:
     lda     #TadState::WAITING_FOR_LOADER
     sta     Tad_state
 
+    lda     #1
+    sta     Tad_workPending
+
     plb
 ; DB restored
     rtl
 .endproc
 
 
-;; Sends a command to the audio driver.
+;; Sends the oldest queued command to the audio driver and removes it from the command queue.
 ;;
 ;; REQUIRES: state == PAUSED or state == PLAYING.
 ;; REQUIRES: The previous command has been processed by the audio-driver.
-;; REQUIRES: `Tad_nextCommand_id` is not a play-sound-effect command.
-;; REQUIRES: `Tad_nextCommand_id` is a valid comma.
-;;
-;; IN: Y = Tad_nextCommand_id
+;; REQUIRES: The command queue is not empty.
+;; REQUIRES: The queued command is not a play-sound-effect command.
+;; REQUIRES: The queued command is a valid command.
 .a8
 .i8
 ;; DB access lowram
@@ -903,13 +1309,17 @@ ReturnFalse:
     .assert .asize = 8, error
     .assert .isize = 8, error
 
-    lda     Tad_nextCommand_parameter
+    ldx     Tad_commandQueue_readIndex
+
+    lda     Tad_commandQueue_parameter,x
     sta     f:TadIO_ToDriver::PARAMETER0_PORT
 
+    ldy     Tad_commandQueue_id,x
+
     lda     Tad_previousCommand
     and     #TadIO_ToDriver::COMMAND_I_MASK    ; Clear the non i bits of the command
     eor     #TadIO_ToDriver::COMMAND_I_MASK    ; Flip the i bits
-    ora     Tad_nextCommand_id              ; Set the c bits
+    ora     Tad_commandQueue_id,x           ; Set the c bits
     sta     f:TadIO_ToDriver::COMMAND_PORT
     sta     Tad_previousCommand
 
@@ -928,9 +1338,13 @@ ReturnFalse:
         sta     Tad_state
 @NotPauseOrPlay:
 
-    ; Reset command queue
-    lda     #$ff
-    sta     Tad_nextCommand_id
+    ; Remove the command from the queue
+    inx
+    txa
+    and     #TAD_COMMAND_QUEUE_SIZE - 1
+    sta     Tad_commandQueue_readIndex
+
+    dec     Tad_commandQueue_count
 .endmacro
 
 
@@ -982,6 +1396,36 @@ ReturnFalse:
 .i16
 ; DB access lowram
 .proc Tad_Process : far
+    ; Return immediately if there is nothing to send or load (19 cycles, excluding the JSL).
+    ; `Tad_processCalled` is not set, `Tad_ProcessNmi` only uses it when the loader is active.
+    lda     Tad_workPending
+    bne     @Process
+    lda     Tad_sfxQueue_sfx
+    inc
+    bne     @Process
+        rtl
+
+@Process:
+    inc     Tad_processLock
+
+    lda     #1
+    sta     Tad_processCalled
+
+    jsl     __Tad_Process
+
+    dec     Tad_processLock
+    rtl
+.endproc
+
+
+
+;; The `Tad_Process` state machine
+;;
+;; return using RTL
+.a8
+.i16
+;; DB access lowram
+.proc __Tad_Process ; RTL
     .assert TadState::PAUSED = $80, error
     .assert TadState::PLAYING > $80, error
     lda     Tad_state
@@ -997,19 +1441,37 @@ ReturnFalse:
             ; Previous command has been processed
 
             ; Check command queue
-            ldy     Tad_nextCommand_id
-            bpl     @SendCommand
+            lda     Tad_commandQueue_count
+            bne     @SendCommand
 
             ; X = Tad_state
             .assert TadState::PAUSED < $81, error
             .assert TadState::PLAYING >= $81, error
             .assert TadState::PLAYING_SFX >= $81, error
             dex
-            bpl     @Return_I8
+            bpl     @Idle
                 ; Playing state
                 lda     Tad_sfxQueue_sfx
                 cmp     #$ff
-                beq     @Return_I8
+                bne     @SendSfx
+                    ; Sound effect queue is empty, move the oldest batched sound effect (if any) to the queue
+                    ldy     Tad_sfxBatch_count
+                    beq     @Idle
+
+                    dec     Tad_sfxBatch_count
+
+                    ldy     Tad_sfxBatch_readIndex
+                    lda     Tad_sfxBatch_pan,y
+                    sta     Tad_sfxQueue_pan
+
+                    tya
+                    inc
+                    and     #TAD_SFX_BATCH_SIZE - 1
+                    sta     Tad_sfxBatch_readIndex
+
+                    lda     Tad_sfxBatch_sfx,y
+
+                @SendSfx:
                     __Tad_Process_SendSfxCommand
 
         @Return_I8:
@@ -1017,6 +1479,18 @@ ReturnFalse:
         .i16
             rtl
 
+        .a8
+        .i8
+        @Idle:
+            ; Nothing to send, skip the state machine until the next command, sound effect or
+            ; song is queued.
+            ; (The state is not a loading state and a paused sound effect batch is not sent until
+            ; an UNPAUSE or PAUSE_MUSIC_PLAY_SFX command is queued.)
+            stz     Tad_workPending
+            rep     #$10
+        .i16
+            rtl
+
         .a8
         .i8
         @SendCommand:
@@ -1058,13 +1532,16 @@ ReturnFalse:
     plb
 ; DB = $80
 
+    ; Test if the loader is ready before calling `LoadAudioData`
+    ; (the `TadLoaderDataType` depends on the data returned by `LoadAudioData`)
+    ldx     #TadIO_Loader_Init::LOADER_READY_HL
+    cpx     TadIO_Loader_Init::READY_PORT_HL
+    bne     @Return
+
     lda     Tad_flags
     bit     #TadFlags::RELOAD_COMMON_AUDIO_DATA
     beq     @SongData
         ; Common audio data
-        lda     #TadLoaderDataType::COMMON_DATA
-        jsr     _Tad_Loader_CheckReadyAndSendLoaderDataType
-        bcc     @Return
 
         ; Clear the RELOAD_COMMON_AUDIO_DATA flag
         ;
@@ -1076,22 +1553,37 @@ ReturnFalse:
         lda     #TadState::LOADING_COMMON_AUDIO_DATA
         pha
 
+        ; Transfer the patch if `Tad_PatchCommonAudioData` was called (and clear the patch flag)
+        lda     #TadFlags::PATCH_COMMON_AUDIO_DATA
+        trb     Tad_flags
+        beq     @LoadCommonAudioData
+            lda     Tad_commonAudioDataPatch_bank
+            ldx     Tad_commonAudioDataPatch_addr
+            ldy     Tad_commonAudioDataPatch_size
+            jsr     _Tad_Loader_SetDataToTransfer
+
+            ; Patches are always compressed
+            lda     #TadLoaderDataType::COMMON_DATA | TadLoaderDataType::COMPRESSED_FLAG
+            bra     @SendLoaderDataType
+
+    @LoadCommonAudioData:
         lda     #0
-        bra     @LoadData
+        jsl     LoadAudioData
+        ; LoadAudioData MUST return carry set when `A = 0`
+        jsr     _Tad_Loader_SetDataToTransfer
+
+        lda     Tad_flags
+        and     #TadFlags::COMPRESSED_AUDIO_DATA
+        ora     #TadLoaderDataType::COMMON_DATA
+        bra     @SendLoaderDataType
 
     @SongData:
         ; Songs
 
-        ; a = Tad_flags
-        and     #TadFlags::_LOADER_MASK
-        ora     #TadLoaderDataType::MIN_SONG_VALUE
-        jsr     _Tad_Loader_CheckReadyAndSendLoaderDataType
-        bcc     @Return
-
         ; Determine next state
         .assert TadFlags::PLAY_SONG_IMMEDIATELY = $40, error
         .assert TadState::LOADING_SONG_DATA_PAUSED + 1 = TadState::LOADING_SONG_DATA_PLAY, error
-        lda     Tad_flags
+        ; a = Tad_flags
         asl
         asl
         lda     #0
@@ -1103,20 +1595,52 @@ ReturnFalse:
         lda     Tad_nextSong
         beq     @UseBlankSong
 
-@LoadData:
-    jsl     LoadAudioData
-    bcs     :+
-        ; LoadAudioData returned false
-    @UseBlankSong:
-        lda     #.bankbyte(Tad_BlankSong_Bin)
-        ldx     #.loword(Tad_BlankSong_Bin)
-        ldy     #Tad_BlankSong_SIZE
-    :
-
+        ; Skip `LoadAudioData` if the song was staged by `Tad_StageSong`
+        cmp     Tad_stagedSong
+        bne     @LoadSong
+            lda     Tad_songStaging_bank
+            ldx     Tad_songStaging_addr
+            ldy     Tad_stagedSong_size
+            jsr     _Tad_Loader_SetDataToTransfer
+
+            lda     Tad_flags
+            and     #TadFlags::_LOADER_MASK
+            ora     Tad_stagedSong_transferFlag
+            ora     #TadLoaderDataType::MIN_SONG_VALUE
+            bra     @SendLoaderDataType
+
+    @LoadSong:
+        jsl     LoadAudioData
+        bcc     @UseBlankSong
+            jsr     _Tad_Loader_SetDataToTransfer
+
+            ; Compressed data is transferred 2 bytes at a time
+            lda     Tad_flags
+            bit     #TadFlags::COMPRESSED_AUDIO_DATA
+            beq     @UncompressedSong
+                and     #TadFlags::_LOADER_MASK | TadFlags::COMPRESSED_AUDIO_DATA
+                ora     #TadLoaderDataType::MIN_SONG_VALUE
+                bra     @SendLoaderDataType
+
+        @UseBlankSong:
+            ; LoadAudioData returned false or song is 0
+            lda     #.bankbyte(Tad_BlankSong_Bin)
+            ldx     #.loword(Tad_BlankSong_Bin)
+            ldy     #Tad_BlankSong_SIZE
+            jsr     _Tad_Loader_SetDataToTransfer
+
+            ; The blank song is never compressed
+            lda     Tad_flags
+
+        @UncompressedSong:
+            and     #TadFlags::_LOADER_MASK
+            ora     #TadLoaderDataType::MIN_SONG_VALUE | TadLoaderDataType::FAST_TRANSFER_FLAG
+
+@SendLoaderDataType:
+    ; A = TadLoaderDataType
     ; STACK holds next state
-    ; A:X = data address
-    ; Y = data size
-    jsr     _Tad_Loader_SetDataToTransfer
+    jsr     _Tad_Loader_CheckReadyAndSendLoaderDataType
+    ; The loader is ready (tested above), carry is always set
 
     pla
     sta     Tad_state
@@ -1136,8 +1660,31 @@ ReturnFalse:
 .i16
 ;; DB access lowram
 .proc __Tad_Process_Loading ; RTL
-    jsr     _Tad_Loader_TransferData
-    bcc     @Return
+    ldx     Tad_transferDeadline
+    bne     @TransferUntilDeadline
+        jsr     _Tad_Loader_TransferData
+        bcc     @Return
+        bra     @Loaded
+
+    @TransferUntilDeadline:
+        jsr     _Tad_ReadVCounter
+        stx     Tad_transferStartScanline
+
+        @DeadlineLoop:
+            ; Transfer at least one block, even if the deadline has already passed
+            jsr     _Tad_Loader_TransferData
+            bcs     @Loaded
+
+            jsr     _Tad_ReadVCounter
+            cpx     Tad_transferDeadline
+            bcs     @Return
+
+            ; Stop if the V counter wrapped (the deadline is after the last scanline)
+            cpx     Tad_transferStartScanline
+            bcs     @DeadlineLoop
+            rtl
+
+@Loaded:
         ; Data loaded successfully
         lda     Tad_state
         cmp     #TadState::LOADING_COMMON_AUDIO_DATA
@@ -1154,8 +1701,13 @@ ReturnFalse:
             stz     Tad_previousCommand
 
             ; Reset command and SFX queues
+            stz     Tad_commandQueue_readIndex
+            stz     Tad_commandQueue_count
+
+            stz     Tad_sfxBatch_readIndex
+            stz     Tad_sfxBatch_count
+
             lda     #$ff
-            sta     Tad_nextCommand_id
             sta     Tad_sfxQueue_sfx
             sta     Tad_sfxQueue_pan
 
@@ -1184,6 +1736,8 @@ ReturnFalse:
 .i16
 ; DB access lowram
 .proc Tad_FinishLoadingData : far
+    inc     Tad_processLock
+
     @Loop:
         __Tad_IsLoaderActive
         bcc     @EndLoop
@@ -1191,6 +1745,206 @@ ReturnFalse:
         bra     @Loop
     @EndLoop:
 
+    dec     Tad_processLock
+    rtl
+.endproc
+
+
+
+; JSL/RTL subroutine
+; A unknown
+; I unknown
+; DB unknown
+; D unknown
+.proc Tad_ProcessNmi : far
+    php
+    rep     #$30
+.a16
+.i16
+    pha
+    phx
+    phy
+    phd
+    phb
+
+    lda     #0
+    tcd
+; D = 0
+
+    sep     #$20
+.a8
+
+    lda     #$80
+    pha
+    plb
+; DB = $80
+
+    ; Do not interrupt `Tad_Process`, `Tad_FinishLoadingData` or `Tad_LoadSong`
+    lda     Tad_processLock
+    bne     @Return
+
+    ; Only transfer data on lag frames
+    lda     Tad_processCalled
+    stz     Tad_processCalled
+    bne     @Return
+
+    __Tad_IsLoaderActive
+    bcc     @Return
+
+    ; Do not transfer the last block of data.
+    ; Finishing the transfer changes the state and resets the command and sound effect queues,
+    ; which cannot be done safely in an interrupt.
+    ; (`_Tad_Loader_TransferData` transfers at most `Tad_bytesToTransferPerFrame + 1` bytes)
+    rep     #$20
+.a16
+    lda     Tad_bytesToTransferPerFrame
+    inc
+    cmp     Tad_dataToTransfer_size
+    sep     #$20
+.a8
+    bcs     @Return
+
+    jsr     _Tad_Loader_TransferData
+
+@Return:
+    rep     #$30
+.a16
+.i16
+    plb
+    pld
+    ply
+    plx
+    pla
+    plp
+    rtl
+.endproc
+
+
+
+; IN: A = song_id
+; OUT: carry set if the song was staged
+;
+; JSL/RTL subroutine
+.a8
+.i16
+; DB access lowram
+.proc Tad_StageSong : far
+    ; The blank song is never staged
+    cmp     #0
+    beq     ReturnFalse
+
+    ; Calling `LoadAudioData` can free the data that is being transferred to the loader
+    pha
+        __Tad_IsLoaderActive
+    pla
+    bcs     ReturnFalse
+
+    ; The staging buffer is about to be overwritten
+    stz     Tad_stagedSong
+
+    pha
+    phb
+
+    ; `LoadAudioData` is called with a fixed data bank (as in `__Tad_Process_WaitingForLoader`)
+    lda     #$80
+    pha
+    plb
+; DB = $80
+
+    lda     2,s
+    jsl     LoadAudioData
+
+    plb
+; DB restored
+    bcc     PullReturnFalse
+
+    ; The data MUST NOT be empty and MUST fit in the staging buffer
+    dey
+    cpy     Tad_songStaging_bufferSize
+    iny
+    bcs     PullReturnFalse
+
+    sty     Tad_stagedSong_size
+
+    ; A:X = far address of the song data
+    pha
+
+    rep     #$20
+.a16
+    lda     Tad_songStaging_addr
+    sta     Tad_songStaging_writePtr
+
+    sep     #$20
+.a8
+    lda     Tad_songStaging_bank
+    sta     Tad_songStaging_writePtr + 2
+
+    ; X = number of bytes to copy
+    ; Y = data address (`__Tad_Loader_GotoNextBank` advances Y)
+    phx
+    tyx
+    ply
+
+    phd
+    phb
+
+    rep     #$20
+.a16
+    lda     #.loword(Tad_songStaging_writePtr)
+    tcd
+; D = Tad_songStaging_writePtr
+
+    sep     #$20
+.a8
+    ; Stack: DB, D, data bank
+    lda     4,s
+    pha
+    plb
+; DB = data bank
+
+    @Loop:
+        lda     a:0,y
+        sta     [z:0]
+
+        rep     #$20
+    .a16
+        inc     z:0
+        sep     #$20
+    .a8
+
+        iny
+        bne     :+
+            jsr     __Tad_Loader_GotoNextBank
+        :
+        dex
+        bne     @Loop
+
+    plb
+    pld
+; DB restored
+; D restored
+
+    pla
+
+    ; Compressed data is transferred 2 bytes at a time
+    .assert TadFlags::COMPRESSED_AUDIO_DATA = TadLoaderDataType::COMPRESSED_FLAG, error
+    lda     Tad_flags
+    and     #TadFlags::COMPRESSED_AUDIO_DATA
+    bne     :+
+        lda     #TadLoaderDataType::FAST_TRANSFER_FLAG
+    :
+    sta     Tad_stagedSong_transferFlag
+
+    pla
+    sta     Tad_stagedSong
+
+    sec
+    rtl
+
+PullReturnFalse:
+    pla
+ReturnFalse:
+    clc
     rtl
 .endproc
 
@@ -1208,16 +1962,50 @@ ReturnFalse:
 .a8
 ; I unknown
 ; DB access lowram
+; KEEP: X, Y
 .proc Tad_QueueCommand
-    bit     Tad_nextCommand_id
-    bpl     ReturnFalse
-        ; command queue is empty
-    WriteCommand:
+    pha
+    lda     Tad_commandQueue_count
+    cmp     #TAD_COMMAND_QUEUE_SIZE
+    pla
+    bcs     ReturnFalse
+        ; command queue is not full
+    AppendCommand:
+        php
+        rep     #$10
+    .i16
+        phx
+        phy
+
+        sep     #$10
+    .i8
         and     #TadIO_ToDriver::COMMAND_MASK
-        sta     Tad_nextCommand_id
+        pha
+
+        ; Y = index of the first empty slot
+        lda     Tad_commandQueue_readIndex
+        clc
+        adc     Tad_commandQueue_count
+        and     #TAD_COMMAND_QUEUE_SIZE - 1
+        tay
+
+        pla
+        sta     Tad_commandQueue_id,y
 
         txa
-        sta     Tad_nextCommand_parameter
+        sta     Tad_commandQueue_parameter,y
+
+        inc     Tad_commandQueue_count
+
+        lda     #1
+        sta     Tad_workPending
+
+        rep     #$10
+    .i16
+        ply
+        plx
+        plp
+    ; I unknown
 
         ; return true
         sec
@@ -1226,7 +2014,6 @@ ReturnFalse:
 ReturnFalse:
     clc
     rts
-.endproc
 
 
 ; IN: A = command
@@ -1234,7 +2021,27 @@ ReturnFalse:
 .a8
 ; I unknown
 ; DB access lowram
-Tad_QueueCommandOverride := Tad_QueueCommand::WriteCommand
+; KEEP: X, Y
+Override:
+    ; Clear the command queue
+    stz     Tad_commandQueue_count
+    bra     AppendCommand
+.endproc
+
+Tad_QueueCommandOverride := Tad_QueueCommand::Override
+
+
+; OUT: A = number of commands that can be added to the command queue
+.a8
+; I unknown
+; DB access lowram
+; KEEP: X, Y
+.proc Tad_GetCommandQueueSpace
+    lda     #TAD_COMMAND_QUEUE_SIZE
+    sec
+    sbc     Tad_commandQueue_count
+    rts
+.endproc
 
 
 
@@ -1276,6 +2083,111 @@ Tad_QueueCommandOverride := Tad_QueueCommand::WriteCommand
 
 
 
+; IN: A = sfx id
+; IN: X = pan
+; OUT: Carry set if the sound effect was added to the batch
+.a8
+; I unknown
+; DB access lowram
+; KEEP: X, Y
+.proc Tad_BatchPannedSoundEffect
+    pha
+    lda     Tad_sfxBatch_count
+    cmp     #TAD_SFX_BATCH_SIZE
+    pla
+    bcs     ReturnFalse
+        ; sound effect batch is not full
+        php
+        rep     #$10
+    .i16
+        phx
+        phy
+
+        sep     #$10
+    .i8
+        pha
+
+        ; Y = index of the first empty slot
+        lda     Tad_sfxBatch_readIndex
+        clc
+        adc     Tad_sfxBatch_count
+        and     #TAD_SFX_BATCH_SIZE - 1
+        tay
+
+        pla
+        sta     Tad_sfxBatch_sfx,y
+
+        txa
+        sta     Tad_sfxBatch_pan,y
+
+        inc     Tad_sfxBatch_count
+
+        lda     #1
+        sta     Tad_workPending
+
+        rep     #$10
+    .i16
+        ply
+        plx
+        plp
+    ; I unknown
+
+        ; return true
+        sec
+        rts
+
+ReturnFalse:
+    clc
+    rts
+.endproc
+
+
+
+; IN: A = sfx id
+; OUT: Carry set if the sound effect was added to the batch
+.a8
+; I unknown
+; DB access lowram
+; KEEP: X, Y
+.proc Tad_BatchSoundEffect
+    php
+    rep     #$10
+.i16
+    phx
+
+    ldx     #TAD_CENTER_PAN
+    jsr     Tad_BatchPannedSoundEffect
+
+    ; `plx` does not change carry
+    plx
+    bcc     ReturnFalse
+        plp
+    ; I unknown
+        sec
+        rts
+
+ReturnFalse:
+    plp
+    clc
+    rts
+.endproc
+
+
+
+; OUT: A = number of sound effects that can be added to the sound effect batch
+.a8
+; I unknown
+; DB access lowram
+; KEEP: X, Y
+.proc Tad_GetSfxBatchSpace
+    lda     #TAD_SFX_BATCH_SIZE
+    sec
+    sbc     Tad_sfxBatch_count
+    rts
+.endproc
+
+
+
 ; IN: A = song_id
 .a8
 ; I unknown
@@ -1285,8 +2197,14 @@ Tad_QueueCommandOverride := Tad_QueueCommand::WriteCommand
     .assert TAD__FIRST_LOADING_SONG_STATE > TadState::WAITING_FOR_LOADER, error
     .assert TAD__FIRST_LOADING_SONG_STATE > TadState::LOADING_COMMON_AUDIO_DATA, error
 
+    ; Prevent `Tad_ProcessNmi` from transferring data after the switch-to-loader command is sent
+    inc     Tad_processLock
+
     sta     Tad_nextSong
 
+    lda     #1
+    sta     Tad_workPending
+
     lda     Tad_state
     cmp     #TAD__FIRST_LOADING_SONG_STATE
     bcc     :+
@@ -1299,6 +2217,8 @@ Tad_QueueCommandOverride := Tad_QueueCommand::WriteCommand
         lda     #TadState::WAITING_FOR_LOADER
         sta     Tad_state
     :
+
+    dec     Tad_processLock
     rts
 .endproc
 
@@ -1341,6 +2261,98 @@ Tad_QueueCommandOverride := Tad_QueueCommand::WriteCommand
 .endproc
 
 
+; IN: A:X = far address of the patch
+; IN: Y = size of the patch
+.a8
+.i16
+; DB access lowram
+.proc Tad_PatchCommonAudioData
+    stx     Tad_commonAudioDataPatch_addr
+    sta     Tad_commonAudioDataPatch_bank
+    sty     Tad_commonAudioDataPatch_size
+
+    lda     #TadFlags::RELOAD_COMMON_AUDIO_DATA | TadFlags::PATCH_COMMON_AUDIO_DATA
+    tsb     Tad_flags
+    rts
+.endproc
+
+
+; IN: A:X = far address of the staging buffer
+; IN: Y = size of the staging buffer
+.a8
+.i16
+; DB access lowram
+.proc Tad_SetSongStagingBuffer
+    stx     Tad_songStaging_addr
+    sta     Tad_songStaging_bank
+    sty     Tad_songStaging_bufferSize
+
+    stz     Tad_stagedSong
+    rts
+.endproc
+
+
+; OUT: X = number of handshakes required to transfer the staged song (0 if no song is staged)
+.a8
+.i16
+; DB access lowram
+.proc Tad_GetStagedSongHandshakes
+    WRDIV  = $4204
+    WRDIVB = $4206
+    RDDIV  = $4214
+    RDMPY  = $4216
+
+    ldx     #0
+
+    lda     Tad_stagedSong
+    beq     Return
+
+    lda     Tad_stagedSong_transferFlag
+    cmp     #TadLoaderDataType::FAST_TRANSFER_FLAG
+
+    rep     #$20
+.a16
+    beq     @Fast
+        ; 2 bytes per handshake
+        lda     Tad_stagedSong_size
+        lsr
+        adc     #0
+        bra     @EndIf
+
+    @Fast:
+        ; 3 bytes per handshake
+        lda     Tad_stagedSong_size
+        sta     f:WRDIV
+
+        sep     #$20
+    .a8
+        lda     #3
+        sta     f:WRDIVB
+
+        rep     #$20
+    .a16
+        ; Wait for the division to complete
+        nop
+        nop
+        nop
+        nop
+        nop
+
+        ; carry set if the remainder is non-zero
+        lda     f:RDMPY
+        cmp     #1
+        lda     f:RDDIV
+        adc     #0
+@EndIf:
+    tax
+
+    sep     #$20
+.a8
+Return:
+    rts
+.endproc
+
+
 .a8
 ; I unknown
 ; DB access lowram
@@ -1393,6 +2405,46 @@ Tad_QueueCommandOverride := Tad_QueueCommand::WriteCommand
 .endproc
 
 
+.a8
+; I unknown
+; DB access lowram
+.proc Tad_UseCompressedAudioData
+    lda     #TadFlags::COMPRESSED_AUDIO_DATA
+    tsb     Tad_flags
+    rts
+.endproc
+
+
+.a8
+; I unknown
+; DB access lowram
+.proc Tad_UseUncompressedAudioData
+    lda     #TadFlags::COMPRESSED_AUDIO_DATA
+    trb     Tad_flags
+    rts
+.endproc
+
+
+.a8
+; I unknown
+; DB access lowram
+.proc Tad_EnableTickBudget
+    lda     #TadFlags::TICK_BUDGET
+    tsb     Tad_flags
+    rts
+.endproc
+
+
+.a8
+; I unknown
+; DB access lowram
+.proc Tad_DisableTickBudget
+    lda     #TadFlags::TICK_BUDGET
+    trb     Tad_flags
+    rts
+.endproc
+
+
 ; IN: X = new `Tad_bytesToTransferPerFrame` value
 ; A unknown
 .i16
@@ -1412,6 +2464,16 @@ Tad_QueueCommandOverride := Tad_QueueCommand::WriteCommand
 .endproc
 
 
+; IN: X = new `Tad_transferDeadline` value
+; A unknown
+.i16
+; DB access lowram
+.proc Tad_SetTransferDeadline
+    stx     Tad_transferDeadline
+    rts
+.endproc
+
+
 
 ; OUT: carry set if state is LOADING_*
 .a8
@@ -1423,6 +2485,69 @@ Tad_QueueCommandOverride := Tad_QueueCommand::WriteCommand
 .endproc
 
 
+; OUT: carry set if state is LOADING_*
+; OUT: X = number of bytes remaining in the current transfer (0 if the loader is inactive)
+; OUT: Y = estimated number of `Tad_Process` calls required to finish the transfer
+.a8
+.i16
+; DB access lowram
+.proc Tad_GetLoadProgress
+    ldx     #0
+    ldy     #0
+
+    __Tad_IsLoaderActive
+    bcc     Return
+
+    rep     #$20
+.a16
+    ; Y = ceil(Tad_dataToTransfer_size / Tad_bytesToTransferPerFrame)
+    ;
+    ; The hardware divider cannot be used as `Tad_bytesToTransferPerFrame` can be > 255.
+    ;
+    ; Shift-subtract division
+    ;   X = dividend, shifted left into the quotient
+    ;   1,s = remainder
+    ldx     Tad_dataToTransfer_size
+
+    lda     #0
+    pha
+
+    ldy     #16
+    @Loop:
+        txa
+        asl
+        tax
+
+        lda     1,s
+        rol
+        cmp     Tad_bytesToTransferPerFrame
+        bcc     :+
+            sbc     Tad_bytesToTransferPerFrame
+            inx
+        :
+        sta     1,s
+
+        dey
+        bne     @Loop
+
+    ; carry set if the remainder is non-zero
+    pla
+    cmp     #1
+    txa
+    adc     #0
+    tay
+
+    ldx     Tad_dataToTransfer_size
+
+    sep     #$21
+.a8
+    ; carry set
+Return:
+    rts
+.endproc
+
+
+
 
 ; OUT: carry set if state is PAUSED, PLAYING_SFX or PLAYING
 .a8
@@ -1468,3 +2593,34 @@ Tad_QueueCommandOverride := Tad_QueueCommand::WriteCommand
 .endproc
 
 
+
+; OUT: A = the smallest tick headroom of the unpaused channels
+.a8
+; I unknown
+; DB access lowram
+.proc Tad_GetDriverHeadroom
+    .assert TadState::PLAYING > TadState::PLAYING_SFX, error
+    .assert TadState::PLAYING_SFX > TadState::PAUSED, error
+    ; Assumes PLAYING is the last state
+
+    lda     Tad_state
+    cmp     #TadState::PLAYING_SFX
+    bcc     @Max
+    beq     @Sfx
+        ; PLAYING state
+        lda     f:TadIO_ToScpu::MUSIC_HEADROOM_PORT
+        cmp     f:TadIO_ToScpu::SFX_HEADROOM_PORT
+        bcc     @Return
+
+    @Sfx:
+        lda     f:TadIO_ToScpu::SFX_HEADROOM_PORT
+@Return:
+        rts
+
+@Max:
+    ; No channels are processed when the song is not loaded or the audio driver is paused
+    lda     #TadIO_ToScpu::MAX_HEADROOM
+    rts
+.endproc
+
+
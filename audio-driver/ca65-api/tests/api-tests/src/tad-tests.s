@@ -134,6 +134,7 @@ TestTable:
     .addr   TestSfxQueueWithOnlyMusicPaused
     .addr   TestCommandAndSfxQueuePriority
     .addr   TestCommandAndSfxQueueEmptyAfterSongLoad
+    .addr   TestSfxBatch
     .addr   TestQueuePannedSoundEffectKeepsXY16
     .addr   TestQueuePannedSoundEffectKeepsXY8
     .addr   TestQueueSoundEffectKeepsXY16
@@ -142,6 +143,7 @@ TestTable:
     .addr   TestSongStartsImmediately
     .addr   TestSongStartPaused
     .addr   TestSetTransferSize
+    .addr   TestGetLoadProgress
 TestTable_SIZE = * - TestTable
 
 
@@ -421,8 +423,13 @@ TestTable_SIZE = * - TestTable
 .proc TestQueueCommand
     ; Using PAUSE and UNPAUSE commands as they change the 65816-side state
 
+    .assert TAD_COMMAND_QUEUE_SIZE = 4, error
+
     assert_carry    Tad_IsSongPlaying, true
 
+    jsr     Tad_GetCommandQueueSpace
+    assert_a_eq(TAD_COMMAND_QUEUE_SIZE)
+
 
     lda     #TadCommand::PAUSE
     assert_carry    Tad_QueueCommand, true
@@ -435,43 +442,87 @@ TestTable_SIZE = * - TestTable
 
 
     ; Queue is empty
+    jsr     Tad_GetCommandQueueSpace
+    assert_a_eq(TAD_COMMAND_QUEUE_SIZE)
+
+    ; Fill the queue
     lda     #TadCommand::UNPAUSE
     assert_carry    Tad_QueueCommand, true
 
+    lda     #TadCommand::SET_MAIN_VOLUME
+    ldx     #128
+    assert_carry    Tad_QueueCommand, true
+
+    lda     #TadCommand::STOP_SOUND_EFFECTS
+    assert_carry    Tad_QueueCommand, true
+
+    lda     #TadCommand::PAUSE
+    assert_carry    Tad_QueueCommand, true
+
     ; Assert paused/playing state unchanged
     assert_carry    Tad_IsSongPlaying, false
 
-    ; Command queue contains an UNPAUSE command
-
     ; Queue is full
-    lda     #TadCommand::STOP_SOUND_EFFECTS
-    assert_carry    Tad_QueueCommand, false
+    jsr     Tad_GetCommandQueueSpace
+    assert_a_eq(0)
 
-    ; Queue is full
-    lda     #TadCommand::SET_MAIN_VOLUME
-    ldx     #128
+    lda     #TadCommand::SET_MUSIC_CHANNELS
+    ldx     #0
     assert_carry    Tad_QueueCommand, false
 
-    ; Process command
+    ; Process the UNPAUSE command
     jsr     _Wait
     jsl     Tad_Process
 
     ; Assert UNPAUSE command changed state
     assert_carry    Tad_IsSongPlaying, true
 
+    ; Only one command is sent per `Tad_Process` call
+    jsr     Tad_GetCommandQueueSpace
+    assert_a_eq(1)
+
+    ; Process the SET_MAIN_VOLUME and STOP_SOUND_EFFECTS commands
+    jsr     _Wait
+    jsl     Tad_Process
+    jsr     _Wait
+    jsl     Tad_Process
+
+    assert_carry    Tad_IsSongPlaying, true
+
+    ; Process the PAUSE command
+    jsr     _Wait
+    jsl     Tad_Process
+
+    ; Assert PAUSE command changed state
+    assert_carry    Tad_IsSongPlaying, false
+
+    jsr     Tad_GetCommandQueueSpace
+    assert_a_eq(TAD_COMMAND_QUEUE_SIZE)
+
 
     ; Test `Tad_QueueCommand` can handle an 8 bit index
     sep     #$30
 .a8
 .i8
+    lda     #TadCommand::UNPAUSE
+    ldx     #$ff
+    ldy     #$42
+    assert_carry    Tad_QueueCommand, true
+
+    ; Test X and Y are unchanged
+    assert_x_eq($ff)
+    assert_y_eq($42)
+
     lda     #TadCommand::SET_MAIN_VOLUME
     ldx     #20
     assert_carry    Tad_QueueCommand, true
 
-    ; Queue is full
     lda     #TadCommand::SET_MUSIC_CHANNELS
-    ldx     #0
-    assert_carry    Tad_QueueCommand, false
+    ldx     #$ff
+    assert_carry    Tad_QueueCommand, true
+
+    lda     #TadCommand::STOP_SOUND_EFFECTS
+    assert_carry    Tad_QueueCommand, true
 
     ; Queue is full
     lda     #TadCommand::PAUSE
@@ -480,14 +531,23 @@ TestTable_SIZE = * - TestTable
     rep     #$10
 .i16
 
-    ; Process command
+    ; Process the 4 commands
+    jsr     _Wait
+    jsl     Tad_Process
+    jsr     _Wait
+    jsl     Tad_Process
+    jsr     _Wait
+    jsl     Tad_Process
     jsr     _Wait
     jsl     Tad_Process
 
-    ; Command was SET_MAIN_VOLUME
-    ; Confirm playing state unchanged
+    ; Last command was STOP_SOUND_EFFECTS
+    ; Confirm UNPAUSE command changed the state
     assert_carry    Tad_IsSongPlaying, true
 
+    jsr     Tad_GetCommandQueueSpace
+    assert_a_eq(TAD_COMMAND_QUEUE_SIZE)
+
     rts
 .endproc
 
@@ -514,13 +574,16 @@ TestTable_SIZE = * - TestTable
     ldx     #20
     jsr     Tad_QueueCommandOverride
 
-    ; Test QueueCommand will not fill the queue
     lda     #TadCommand::PAUSE
-    assert_carry    Tad_QueueCommand, false
+    assert_carry    Tad_QueueCommand, true
 
+    ; Test QueueCommandOverride discards the SET_MAIN_VOLUME and PAUSE commands
     lda     #TadCommand::UNPAUSE
     jsr     Tad_QueueCommandOverride
 
+    jsr     Tad_GetCommandQueueSpace
+    assert_a_eq(TAD_COMMAND_QUEUE_SIZE - 1)
+
     ; Assert paused/playing state unchanged
     assert_carry    Tad_IsSongPlaying, false
 
@@ -577,6 +640,10 @@ TestTable_SIZE = * - TestTable
     assert_carry    Tad_IsSongPlaying, false
     assert_carry    Tad_IsSfxPlaying, false
 
+    ; No channels are processed while paused
+    jsr     Tad_GetDriverHeadroom
+    assert_a_eq     7
+
     rts
 .endproc
 
@@ -1000,8 +1067,8 @@ TestTable_SIZE = * - TestTable
     jsr     _QueueSoundEffect_AssertFail
 
     ; Test command queue is unchanged while the loader is active
-    lda     #TadCommand::STOP_SOUND_EFFECTS
-    assert_carry    Tad_QueueCommand, false
+    jsr     Tad_GetCommandQueueSpace
+    assert_a_eq(TAD_COMMAND_QUEUE_SIZE - 1)
 
 
     jsr     _FinishLoading
@@ -1012,6 +1079,9 @@ TestTable_SIZE = * - TestTable
     lda     #$fe
     jsr     _QueueSoundEffect_AssertSuccess
 
+    jsr     Tad_GetCommandQueueSpace
+    assert_a_eq(TAD_COMMAND_QUEUE_SIZE)
+
     lda     #TadCommand::STOP_SOUND_EFFECTS
     assert_carry    Tad_QueueCommand, true
 
@@ -1028,6 +1098,89 @@ TestTable_SIZE = * - TestTable
 
 
 
+;; Tests batched sound effects are sent after the SFX queue, one sound effect per `Tad_Process` call
+.a8
+.i16
+;; DB access lowram
+.proc TestSfxBatch
+    .assert TAD_SFX_BATCH_SIZE = 4, error
+
+    assert_carry    Tad_IsSongPlaying, true
+
+    jsr     Tad_GetSfxBatchSpace
+    assert_a_eq(TAD_SFX_BATCH_SIZE)
+
+    ; Fill the batch
+    lda     #5
+    ldx     #TAD_MAX_PAN
+    assert_carry    Tad_BatchPannedSoundEffect, true
+
+    lda     #6
+    ldx     #$1234
+    ldy     #$5678
+    assert_carry    Tad_BatchSoundEffect, true
+
+    ; Test X and Y are unchanged
+    assert_x_eq($1234)
+    assert_y_eq($5678)
+
+    lda     #7
+    assert_carry    Tad_BatchSoundEffect, true
+
+    lda     #8
+    assert_carry    Tad_BatchSoundEffect, true
+
+    ; Batch is full
+    jsr     Tad_GetSfxBatchSpace
+    assert_a_eq(0)
+
+    lda     #9
+    assert_carry    Tad_BatchSoundEffect, false
+
+
+    ; Test the SFX queue has a higher priority than the batch
+    lda     #20
+    jsr     _QueueSoundEffect_AssertSuccess
+
+    jsr     _Wait
+    jsl     Tad_Process
+    ; play_sound_effect 20 sent to the audio driver
+
+    assert_u8_var_eq   Tad_sfxQueue_sfx, #$ff
+
+    jsr     Tad_GetSfxBatchSpace
+    assert_a_eq(0)
+
+
+    jsr     _Wait
+    jsl     Tad_Process
+    ; play_sound_effect 5 sent to the audio driver
+
+    ; Only one sound effect is sent per `Tad_Process` call
+    assert_u8_var_eq   Tad_sfxQueue_sfx, #$ff
+
+    jsr     Tad_GetSfxBatchSpace
+    assert_a_eq(1)
+
+
+    ; Send the remaining batched sound effects so they don't interfere with the next test
+    jsr     _Wait
+    jsl     Tad_Process
+
+    jsr     _Wait
+    jsl     Tad_Process
+
+    jsr     _Wait
+    jsl     Tad_Process
+
+    jsr     Tad_GetSfxBatchSpace
+    assert_a_eq(TAD_SFX_BATCH_SIZE)
+
+    rts
+.endproc
+
+
+
 ;; Tests that `Tad_QueuePannedSoundEffect` does not modify the X/Y registers
 ;; and can be called with a 16 bit index
 .a8
@@ -1292,6 +1445,56 @@ TestTable_SIZE = * - TestTable
 
 
 
+.a8
+.i16
+;; DB access lowram
+.proc TestGetLoadProgress
+    SONG_ID = 1
+    DATA_SIZE = DummySongData_SIZE
+    TRANSFER_SIZE = 250
+    .assert DATA_SIZE = 2000, error
+
+    ldx     #TRANSFER_SIZE
+    jsr     Tad_SetTransferSize
+
+    assert_carry    Tad_IsSongLoaded, true
+
+    assert_carry    Tad_GetLoadProgress, false
+    assert_x_eq     0
+    assert_y_eq     0
+
+
+    lda     #SONG_ID
+    jsr     Tad_LoadSong
+
+    ; Loader is not active in the WAITING_FOR_LOADER state
+    assert_carry    Tad_GetLoadProgress, false
+
+    jsr     _WaitForLoader
+
+    ; Nothing has been transferred yet
+    assert_carry    Tad_GetLoadProgress, true
+    assert_x_eq     DATA_SIZE
+    assert_y_eq     (DATA_SIZE + TRANSFER_SIZE - 1) / TRANSFER_SIZE
+
+    jsl     Tad_Process
+
+    assert_carry    Tad_GetLoadProgress, true
+    assert_x_eq     DATA_SIZE - TRANSFER_SIZE
+    assert_y_eq     (DATA_SIZE - TRANSFER_SIZE + TRANSFER_SIZE - 1) / TRANSFER_SIZE
+
+
+    jsr     _FinishLoading
+
+    assert_carry    Tad_GetLoadProgress, false
+    assert_x_eq     0
+    assert_y_eq     0
+
+    rts
+.endproc
+
+
+
 ;; Waits for a bit.
 ;;
 ;; This delay should be long enough for the audio-driver to process any pending IO commands.
@@ -211,6 +211,7 @@ void test_queueCommand(void) {
     bool r;
 
     ASSERT_EQ(tad_isSongPlaying(), true)
+    ASSERT_EQ(tad_getCommandQueueSpace(), TAD_COMMAND_QUEUE_SIZE)
 
     r = tad_queueCommand_pause();
     ASSERT_EQ(r, true)
@@ -223,48 +224,64 @@ void test_queueCommand(void) {
 
 
     // Queue is empty
+    ASSERT_EQ(tad_getCommandQueueSpace(), TAD_COMMAND_QUEUE_SIZE)
+
+    // Fill the queue (TAD_COMMAND_QUEUE_SIZE is 4)
     r = tad_queueCommand_unpause();
     ASSERT_EQ(r, true)
 
+    r = tad_queueCommand_setMainVolume(128);
+    ASSERT_EQ(r, true)
+
+    r = tad_queueCommand_stopSoundEffects();
+    ASSERT_EQ(r, true)
+
+    r = tad_queueCommand_pause();
+    ASSERT_EQ(r, true)
+
     // Assert pause/playing state unchanged
     ASSERT_EQ(tad_isSongPlaying(), false)
 
-    // Command queue contains an UNPAUSE command
-
     // Queue is full
-    r = tad_queueCommand_stopSoundEffects();
-    ASSERT_EQ(r, false)
+    ASSERT_EQ(tad_getCommandQueueSpace(), 0)
 
-    // Queue is full
-    r = tad_queueCommand_setMainVolume(128);
+    r = tad_queueCommand_setMusicChannels(0);
     ASSERT_EQ(r, false)
 
-    // Process command
+    // Process the UNPAUSE command
     wait();
     tad_process();
 
     // Assert UNPAUSE command changed state
     ASSERT_EQ(tad_isSongPlaying(), true)
 
+    // Only one command is sent per tad_process() call
+    ASSERT_EQ(tad_getCommandQueueSpace(), 1)
 
-    // Queue is empty
-    r = tad_queueCommand_setMainVolume(20);
-    ASSERT_EQ(r, true)
+    // Process the SET_MAIN_VOLUME and STOP_SOUND_EFFECTS commands
+    wait();
+    tad_process();
+    wait();
+    tad_process();
 
-    // Queue is full
-    r = tad_queueCommand_setMusicChannels(0);
-    ASSERT_EQ(r, false)
+    ASSERT_EQ(tad_isSongPlaying(), true)
 
-    // Queue is full
-    r = tad_queueCommand_pause();
-    ASSERT_EQ(r, false)
+    // Process the PAUSE command
+    wait();
+    tad_process();
+
+    // Assert PAUSE command changed state
+    ASSERT_EQ(tad_isSongPlaying(), false)
+    ASSERT_EQ(tad_getCommandQueueSpace(), TAD_COMMAND_QUEUE_SIZE)
+
+
+    r = tad_queueCommand_unpause();
+    ASSERT_EQ(r, true)
 
     // process command
     wait();
     tad_process();
 
-    // Command was SET_MAIN_VOLUME
-    // Confirm playing state unchanged
     ASSERT_EQ(tad_isSongPlaying(), true)
 }
 
@@ -284,11 +301,12 @@ void test_queueCommandOverride(void) {
 
     tad_queueCommandOverride_setMainVolume(20);
 
-    // Test queueCommand will not fill the queue
     r = tad_queueCommand_pause();
-    ASSERT_EQ(r, false)
+    ASSERT_EQ(r, true)
 
+    // Test queueCommandOverride discards the SET_MAIN_VOLUME and PAUSE commands
     tad_queueCommandOverride_unpause();
+    ASSERT_EQ(tad_getCommandQueueSpace(), TAD_COMMAND_QUEUE_SIZE - 1)
 
     // Assert paused/plating state unchanged
     ASSERT_EQ(tad_isSongPlaying(), false)
@@ -321,6 +339,9 @@ void test_pauseCommand_1(void) {
 
     ASSERT_EQ(tad_isSongPlaying(), false);
     ASSERT_EQ(tad_isSfxPlaying(), false);
+
+    // No channels are processed while paused
+    ASSERT_EQ(tad_getDriverHeadroom(), 7);
 }
 
 void test_pauseCommand_2(void) {
@@ -580,14 +601,15 @@ void test_commandAndSfxQueueEmptyAfterSongLoad(void) {
     queueSoundEffect_assertFail(100);
 
     // Test command queue is unchanged while the loader is active
-    r = tad_queueCommand_stopSoundEffects();
-    ASSERT_EQ(r, false);
+    ASSERT_EQ(tad_getCommandQueueSpace(), TAD_COMMAND_QUEUE_SIZE - 1);
 
     finishLoading();
 
     // Test the two queues are now empty by trying to populate them
     queueSoundEffect_assertSuccess(0xfe);
 
+    ASSERT_EQ(tad_getCommandQueueSpace(), TAD_COMMAND_QUEUE_SIZE);
+
     r = tad_queueCommand_stopSoundEffects();
     ASSERT_EQ(r, true);
 
@@ -599,6 +621,66 @@ void test_commandAndSfxQueueEmptyAfterSongLoad(void) {
     tad_process();
 }
 
+// Tests batched sound effects are sent after the SFX queue, one sound effect per tad_process() call
+void test_sfxBatch(void) {
+    bool r;
+
+    ASSERT_EQ(tad_isSongPlaying(), true);
+    ASSERT_EQ(tad_getSfxBatchSpace(), TAD_SFX_BATCH_SIZE);
+
+    // Fill the batch (TAD_SFX_BATCH_SIZE is 4)
+    r = tad_batchPannedSoundEffect(5, TAD_MAX_PAN);
+    ASSERT_EQ(r, true);
+
+    r = tad_batchSoundEffect(6);
+    ASSERT_EQ(r, true);
+
+    r = tad_batchSoundEffect(7);
+    ASSERT_EQ(r, true);
+
+    r = tad_batchSoundEffect(8);
+    ASSERT_EQ(r, true);
+
+    // Batch is full
+    ASSERT_EQ(tad_getSfxBatchSpace(), 0);
+
+    r = tad_batchSoundEffect(9);
+    ASSERT_EQ(r, false);
+
+
+    // Test the SFX queue has a higher priority than the batch
+    queueSoundEffect_assertSuccess(20);
+
+    wait();
+    tad_process();
+    // play_sound_effect 20 sent to the audio driver
+
+    ASSERT_EQ(tad_sfxQueue_sfx, 0xff);
+    ASSERT_EQ(tad_getSfxBatchSpace(), 0);
+
+
+    wait();
+    tad_process();
+    // play_sound_effect 5 sent to the audio driver
+
+    // Only one sound effect is sent per tad_process() call
+    ASSERT_EQ(tad_sfxQueue_sfx, 0xff);
+    ASSERT_EQ(tad_getSfxBatchSpace(), 1);
+
+
+    // Send the remaining batched sound effects so they don't interfere with the next test
+    wait();
+    tad_process();
+
+    wait();
+    tad_process();
+
+    wait();
+    tad_process();
+
+    ASSERT_EQ(tad_getSfxBatchSpace(), TAD_SFX_BATCH_SIZE);
+}
+
 // Skipped TestQueuePannedSoundEffectKeepsXY16
 // Skipped TestQueuePannedSoundEffectKeepsXY8
 // Skipped TestQueueSoundEffectKeepsXY16
@@ -661,6 +743,46 @@ void test_setTransferSize(void) {
     ASSERT_EQ(countTransfers_song1(), (DUMMY_SONG_DATA_SIZE + MAX_TRANSFER + 1) / MAX_TRANSFER);
 }
 
+void test_setTransferDeadline(void) {
+    ASSERT_EQ(DUMMY_SONG_DATA_SIZE, 2000);
+
+    tad_setTransferSize(MIN_TRANSFER);
+
+    // A deadline after the last scanline transfers data until the scanline counter wraps.
+    // The loader can transfer ~849 bytes per frame.
+    tad_setTransferDeadline(0x1ff);
+    ASSERT_EQ(countTransfers_song1() <= 4, true);
+
+    tad_setTransferDeadline(TAD_NO_TRANSFER_DEADLINE);
+    ASSERT_EQ(countTransfers_song1(), (DUMMY_SONG_DATA_SIZE + MIN_TRANSFER + 1) / MIN_TRANSFER);
+}
+
+
+void test_getLoadProgress(void) {
+    ASSERT_EQ(DUMMY_SONG_DATA_SIZE, 2000);
+
+    tad_setTransferSize(250);
+
+    ASSERT_EQ(tad_isSongLoaded(), true);
+    ASSERT_EQ(tad_getLoadBytesRemaining(), 0);
+    ASSERT_EQ(tad_getLoadFramesRemaining(), 0);
+
+    tad_loadSong(1);
+    waitForLoader();
+
+    // Nothing has been transferred yet
+    ASSERT_EQ(tad_getLoadBytesRemaining(), DUMMY_SONG_DATA_SIZE);
+    ASSERT_EQ(tad_getLoadFramesRemaining(), 8);
+
+    tad_process();
+    ASSERT_EQ(tad_getLoadBytesRemaining(), DUMMY_SONG_DATA_SIZE - 250);
+    ASSERT_EQ(tad_getLoadFramesRemaining(), 7);
+
+    finishLoading();
+    ASSERT_EQ(tad_getLoadBytesRemaining(), 0);
+    ASSERT_EQ(tad_getLoadFramesRemaining(), 0);
+}
+
 
 static const VoidFn TAD_TESTS[] = {
     test_finishLoadingData,
@@ -688,6 +810,7 @@ static const VoidFn TAD_TESTS[] = {
     test_sfxQueueWithOnlyMusicPaused,
     test_commandAndSfxQueuePriority,
     test_commandAndSfxQueueEmptyAfterSongLoad,
+    test_sfxBatch,
     // Skipped TestQueuePannedSoundEffectKeepsXY16
     // Skipped TestQueuePannedSoundEffectKeepsXY8
     // Skipped TestQueueSoundEffectKeepsXY16
@@ -696,6 +819,8 @@ static const VoidFn TAD_TESTS[] = {
     test_songStartsImmediately,
     test_songStartPaused,
     test_setTransferSize,
+    test_setTransferDeadline,
+    test_getLoadProgress,
 };
 
 void runTests(void) {
@@ -706,6 +831,7 @@ void runTests(void) {
     for (testIndex=0; testIndex < N_ELEMENTS(TAD_TESTS); testIndex++) {
         // Reset TAD state
         tad_setTransferSize(256);
+        tad_setTransferDeadline(TAD_NO_TRANSFER_DEADLINE);
         tad_songsStartImmediately();
         // Switch to a blank song
         tad_loadSong(0);
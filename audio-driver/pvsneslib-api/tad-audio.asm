@@ -114,6 +114,16 @@ TAD_COMMAND_I_MASK = %11100001
 TAD_MAX_PAN = 128
 TAD_CENTER_PAN = TAD_MAX_PAN / 2
 
+;; Number of commands the command queue can hold
+;; (MUST be a power of two)
+TAD_COMMAND_QUEUE_SIZE = 4
+.assert (TAD_COMMAND_QUEUE_SIZE & (TAD_COMMAND_QUEUE_SIZE - 1)) == 0
+
+;; Number of sound effects the sound effect batch can hold
+;; (MUST be a power of two)
+TAD_SFX_BATCH_SIZE = 4
+.assert (TAD_SFX_BATCH_SIZE & (TAD_SFX_BATCH_SIZE - 1)) == 0
+
 
 ;; The command to execute.
 ;;
@@ -182,6 +192,19 @@ TAD_IO_ToScpu__MODE_LOADER = $4c ; 'L', Loader.LOADER_READY_L
 TAD_IO_ToScpu__MODE_AUDIO_DRIVER = $61 ; 'a'
 
 
+;; Tick headroom of the last music and sound effect ticks.
+;;
+;; The number of 0.5ms timer counts left in the audio driver's tick budget after the
+;; channels were processed (0 if the tick was at or over budget).
+;;
+;; Not used in the loader.
+TAD_IO_ToScpu__MUSIC_HEADROOM_PORT = $2142 ; APUIO2
+TAD_IO_ToScpu__SFX_HEADROOM_PORT = $2143 ; APUIO3
+
+;; The headroom of a tick that did not process any channels.
+TAD_IO_ToScpu__MAX_HEADROOM = 7
+
+
 ;; The `audio-driver.bin` file.
 ;; MUST be loaded first.
 TAD_LoaderDataType__CODE        = 0
@@ -209,6 +232,27 @@ TAD_LoaderDataType__STEREO_FLAG = 1 << TAD_LoaderDataType__STEREO_FLAG_BIT
 TAD_LoaderDataType__PLAY_SONG_BIT = 6
 TAD_LoaderDataType__PLAY_SONG_FLAG = 1 << TAD_LoaderDataType__PLAY_SONG_BIT
 
+;; If this bit is set, the audio driver skips the vibrato and portamento of the remaining
+;; channels for a tick that takes too long to process.
+;;
+;; MUST NOT be set when loading code or common-audio-data.
+TAD_LoaderDataType__TICK_BUDGET_BIT = 2
+TAD_LoaderDataType__TICK_BUDGET_FLAG = 1 << TAD_LoaderDataType__TICK_BUDGET_BIT
+
+;; If this bit is set, the data is transferred 3 bytes at a time
+;; (using `TAD_IO_Loader__FAST_DATA_PORT_*`).
+;;
+;; MUST NOT be set when loading common-audio-data.
+TAD_LoaderDataType__FAST_TRANSFER_BIT = 4
+TAD_LoaderDataType__FAST_TRANSFER_FLAG = 1 << TAD_LoaderDataType__FAST_TRANSFER_BIT
+
+;; If this bit is set, the data is compressed and is decompressed by the loader.
+;;
+;; MUST NOT be set when loading code.
+;; MUST NOT be set with the `TAD_LoaderDataType__FAST_TRANSFER_FLAG`.
+TAD_LoaderDataType__COMPRESSED_BIT = 5
+TAD_LoaderDataType__COMPRESSED_FLAG = 1 << TAD_LoaderDataType__COMPRESSED_BIT
+
 
 ;; MUST match `audio-driver/src/io-commands.wiz`
 TAD_IO_Loader_Init__LOADER_DATA_TYPE_PORT = $2141 ; APUIO1
@@ -227,6 +271,14 @@ TAD_IO_Loader__DATA_PORT_L   = $2141 ; APUIO1
 TAD_IO_Loader__DATA_PORT_H   = $2142 ; APUIO2
 TAD_IO_Loader__SPINLOCK_PORT = $2143 ; APUIO3
 
+;; The data ports used if `TAD_LoaderDataType__FAST_TRANSFER_FLAG` was sent to the loader.
+;;
+;; `TAD_IO_Loader__FAST_DATA_PORT_0` MUST be cleared at the end of a fast transfer
+;; (it is also `TAD_IO_ToDriver__COMMAND_PORT`).
+TAD_IO_Loader__FAST_DATA_PORT_0 = $2140 ; APUIO0
+TAD_IO_Loader__FAST_DATA_PORT_1 = $2141 ; APUIO1
+TAD_IO_Loader__FAST_DATA_PORT_2 = $2142 ; APUIO2
+
 ;; The spinlock value when the audio driver starts playing a song
 TAD_IO_Loader__SPINLOCK_INIT_VALUE = 0
 
@@ -240,6 +292,12 @@ TAD_IO_Loader__SPINLOCK_COMPLETE = $80
 TAD_IO_Loader__SPINLOCK_SWITCH_TO_LOADER = TAD_IO_ToDriver__SWITCH_TO_LOADER
 
 
+;; PPU registers used to read the vertical scanline counter
+TAD_PPU__SLHV   = $2137 ; Reading latches the H/V counters
+TAD_PPU__OPVCT  = $213d ; Latched vertical counter (low byte then high bit)
+TAD_PPU__STAT78 = $213f ; Reading resets the OPVCT read flip-flop
+
+
 
 ;; =========
 ;; CONSTANTS
@@ -260,6 +318,9 @@ TAD_MAX_TRANSFER_PER_FRAME = 800
 ;; MUST BE > 0
 TAD_DEFAULT_TRANSFER_PER_FRAME = 256    ; ::TODO should I decrement this value?::
 
+;; `tad_setTransferDeadline` value to disable the transfer deadline
+TAD_NO_TRANSFER_DEADLINE = 0
+
 
 ;; ------
 ;; States
@@ -315,8 +376,26 @@ TAD_Flags__PLAY_SONG_IMMEDIATELY    = TAD_LoaderDataType__PLAY_SONG_FLAG
 ;; This flag is cleared after the *common audio data* is loaded into Audio-RAM
 TAD_Flags__RELOAD_COMMON_AUDIO_DATA = 1 << 0
 
+;; If set, the next *common audio data* transfer will send the `tad_commonAudioDataPatch`
+;; instead of calling `loadAudioData`.
+;;
+;; This flag is cleared after the patch is loaded into Audio-RAM
+;; (MUST only be set with `TAD_Flags__RELOAD_COMMON_AUDIO_DATA`)
+TAD_Flags__PATCH_COMMON_AUDIO_DATA  = 1 << 1
+
+;; If set, the data returned by `loadAudioData` is compressed.
+;; (The blank song is never compressed)
+;; Default: Clear
+TAD_Flags__COMPRESSED_AUDIO_DATA    = TAD_LoaderDataType__COMPRESSED_FLAG
+
+;; The tick budget guard flag
+;;  * If set, the audio driver skips the vibrato and portamento of the remaining channels
+;;    when a tick is over budget.
+;; Default: Clear
+TAD_Flags__TICK_BUDGET              = TAD_LoaderDataType__TICK_BUDGET_FLAG
+
 ;; A mask for the flags that are sent to the loader
-TAD_Flags__LOADER_MASK = TAD_Flags__STEREO | TAD_Flags__PLAY_SONG_IMMEDIATELY
+TAD_Flags__LOADER_MASK = TAD_Flags__STEREO | TAD_Flags__PLAY_SONG_IMMEDIATELY | TAD_Flags__TICK_BUDGET
 
 
 ;; ============
@@ -640,8 +719,9 @@ APUIO3 = $2143
         cmp     APUIO0
         bne     -
 
-    sep     #$30
-.index 8
+    ; (The IPL only tests the low byte of the index)
+    .assert ((Tad_Loader_SIZE + 2) & $ff) != 0
+
     ldx     #0
     @IplLoop:
         ; Send the next byte to the IPL
@@ -649,25 +729,23 @@ APUIO3 = $2143
         sta     APUIO1
 
         ; Tell the IPL the next byte is ready
-        stx     APUIO0
+        txa
+        sta     APUIO0
 
         ; Wait for a response form the IPL
         -
-            cpx     APUIO0
+            cmp     APUIO0
             bne     -
 
         inx
         cpx     #Tad_Loader_SIZE
         bcc     @IplLoop
 
-    rep     #$10
-.index 16
-
     ; Send an execute program command to the IPL
     ldx     #TAD_LOADER_ARAM_ADDR
     stx     APUIO2                  ; A-RAM address
     stz     APUIO1                  ; zero = execute program at A-RAM address
-    lda     #Tad_Loader_SIZE + 2
+    lda     #(Tad_Loader_SIZE + 2) & $ff
     sta     APUIO0                  ; New data command (must be +2 the previous APUIO0 write)
 .endm
 
@@ -690,6 +768,7 @@ _tad_loader_checkReadyAndSendLoaderDataType__:
     bne     @ReturnFalse
         ; Send the ready signal and the LoaderDataType
         sta     TAD_IO_Loader_Init__LOADER_DATA_TYPE_PORT
+        sta     tad_dataToTransfer_loaderDataType__
 
         lda     #TAD_IO_Loader_Init__LOADER_READY_L
         sta     TAD_IO_Loader_Init__READY_PORT_L
@@ -753,6 +832,13 @@ _tad_loader_transferData__:
     cmp     TAD_IO_Loader__SPINLOCK_PORT
     bne     @ReturnFalse
 
+    ; Transfer 3 bytes at a time if the fast transfer flag was sent to the loader
+    lda     tad_dataToTransfer_loaderDataType__
+    bit     #TAD_LoaderDataType__FAST_TRANSFER_FLAG
+    beq     +
+        jmp     _tad_loader_transferDataFast__
+    +
+
     phd
     phb
 
@@ -885,9 +971,189 @@ _tad_loader_transferData__:
 
 
 
+;; Transfer data to the audio loader, 3 bytes at a time.
+;;
+;; ASSUMES: The loader is ready (tested by `_tad_loader_transferData`).
+;; ASSUMES: `TAD_LoaderDataType__FAST_TRANSFER_FLAG` was sent to the loader.
+;;
+;; NOTE: This function may read two bytes past the end of the transfer queue.
+;;
+;; OUT: carry set if all data in the transfer queue was sent to Audio-RAM.
+;;
+.accu 8
+.index 16
+;; DB = 0x80
+_tad_loader_transferDataFast__:
+    ; APUIO registers are accessed with direct-page addressing
+    @__dp__FAST_DATA_PORT_0 = TAD_IO_Loader__FAST_DATA_PORT_0 & 0xff
+    @__dp__FAST_DATA_PORT_1 = TAD_IO_Loader__FAST_DATA_PORT_1 & 0xff
+    @__dp__FAST_DATA_PORT_2 = TAD_IO_Loader__FAST_DATA_PORT_2 & 0xff
+    @__dp__SPINLOCK_PORT    = TAD_IO_Loader__SPINLOCK_PORT & 0xff
+
+    phd
+    phb
+
+    rep     #$30
+.accu 16
+
+    ; Calculate number of bytes to read
+    lda     tad_dataToTransfer_size__
+    cmp     tad_bytesToTransferPerFrame__
+    bcc     +
+        lda     tad_bytesToTransferPerFrame__
+    +
+
+    ; Prevent corrupting all of Audio-RAM if number of bytes == 0
+    cmp     #1
+    bcs     +
+        lda     #1
+    +
+    ; Store bytes to read in X
+    tax
+
+    ; Reverse subtract tad_dataToTransfer_size (with clamping)
+    eor     #$ffff
+    sec
+    adc     tad_dataToTransfer_size__
+    bcs     +
+        lda     #0
+    +
+    sta     tad_dataToTransfer_size__
+
+
+    lda     #$2100
+    tcd
+; D = $2100
+
+    sep     #$20
+.accu 8
+
+    lda     tad_dataToTransfer_bank__
+    ldy     tad_dataToTransfer_addr__
+
+    pha
+    plb
+; DB = tad_dataToTransfer_bank__
+
+    @Loop:
+        ; x = number of bytes remaining
+        ; y = data address (using y to force addr,y addressing mode)
+
+        lda.w   0,y
+        sta.b   @__dp__FAST_DATA_PORT_0
+
+        ; The bank overflow test must be done after every byte
+        iny
+        beq     @BankOverflow_1
+    @BankOverflow_1_Resume:
+
+        lda.w   0,y
+        sta.b   @__dp__FAST_DATA_PORT_1
+
+        iny
+        beq     @BankOverflow_2
+    @BankOverflow_2_Resume:
+
+        lda.w   0,y
+        sta.b   @__dp__FAST_DATA_PORT_2
+
+        ; Increment this spinloack value
+        ;
+        ; y increments by 3, `(y & 7) + 1` is different on every write.
+        tya
+        and     #7
+        ina
+        sta.b   @__dp__SPINLOCK_PORT
+
+        iny
+        beq     @BankOverflow_3
+    @BankOverflow_3_Resume:
+
+        dex
+        dex
+        dex
+        beq     @EndLoop
+        bmi     @EndLoop
+
+        ; Spinloop until the S-SMP has acknowledged the data
+        -
+            cmp.b   @__dp__SPINLOCK_PORT
+            bne     -
+
+        bra     @Loop
+@EndLoop:
+
+    plb
+    pld
+; DB restored (0x80)
+; D = 0
+
+    sty     tad_dataToTransfer_addr__
+    sta     tad_dataToTransfer_prevSpinLock__
+
+    rep     #$20
+.accu 16
+    ; Remove the padding bytes from tad_dataToTransfer_size (with clamping)
+    ; X = 0 - number of bytes sent after the end of this block
+    txa
+    clc
+    adc     tad_dataToTransfer_size__
+    bcs     +
+        ; No padding bytes or tad_dataToTransfer_size underflowed
+        cpx     #0
+        beq     +
+            lda     #0
+    +
+    sta     tad_dataToTransfer_size__
+
+    sep     #$20
+.accu 8
+
+    ldy     tad_dataToTransfer_size__
+    bne     @ReturnFalse
+        ; End of data transfer
+
+        ; Wait for Loader to acknowledge the last write
+        lda     tad_dataToTransfer_prevSpinLock__
+        -
+            cmp     TAD_IO_Loader__SPINLOCK_PORT
+            bne     -
+
+        ; Clear the command port (the audio driver reads it after the song has loaded)
+        stz     TAD_IO_Loader__FAST_DATA_PORT_0
+
+        ; No more data to transfer
+        lda     #TAD_IO_Loader__SPINLOCK_COMPLETE
+        sta     TAD_IO_Loader__SPINLOCK_PORT
+
+        sec
+        rts
+
+@ReturnFalse:
+    clc
+    rts
+
+
+@BankOverflow_1:
+    jsr     _tad_loader_gotoNextBank__
+    bra     @BankOverflow_1_Resume
+
+@BankOverflow_2:
+    jsr     _tad_loader_gotoNextBank__
+    bra     @BankOverflow_2_Resume
+
+@BankOverflow_3:
+    ; Must save/restore A, it holds the spinlock
+    pha
+        jsr     _tad_loader_gotoNextBank__
+    pla
+    bra     @BankOverflow_3_Resume
+
+
+
 ;; Advance to the next bank
 ;;
-;; MUST only be called to _tad_loader_transferData
+;; MUST only be called to _tad_loader_transferData or _tad_loader_transferDataFast
 ;;
 ;; ASSUMES: Y = 0 (Y addr overflowed to 0)
 ;;
@@ -939,30 +1205,56 @@ _tad_loader_gotoNextBank__:
     rts
 
 
+
+;; Read the PPU's vertical scanline counter
+;;
+;; NOTE: The H/V counters are only latched if bit 7 of WRIO ($4201) is set.
+;;
+;; OUT: X = vertical scanline counter
+.accu 8
+.index 16
+;; DB = 0x80
+_tad_readVCounter__:
+    lda     TAD_PPU__STAT78
+    lda     TAD_PPU__SLHV
+
+    lda     TAD_PPU__OPVCT
+    xba
+    lda     TAD_PPU__OPVCT
+    and     #1
+    xba
+    tax
+
+    rts
+
+
 ;; --------------
 ;; Process macros
 ;; --------------
 
-;; Sends a command to the audio driver.
+;; Sends the oldest queued command to the audio driver and removes it from the command queue.
 ;;
 ;; REQUIRES: state == PAUSED or state == PLAYING.
 ;; REQUIRES: The previous command has been processed by the audio-driver.
-;; REQUIRES: `tad_nextCommand_id` is not a play-sound-effect command.
-;; REQUIRES: `tad_nextCommand_id` is a valid comma.
-;;
-;; IN: Y = tad_nextCommand_id
+;; REQUIRES: The command queue is not empty.
+;; REQUIRES: The queued command is not a play-sound-effect command.
+;; REQUIRES: The queued command is a valid command.
 ;;
 ;; A8
 ;; I8
 ;; DB = $80
 .macro _Tad_Process_SendCommand__
-    lda     tad_nextCommand_parameter__
+    ldx     tad_commandQueue_readIndex__
+
+    lda.w   tad_commandQueue_parameter__,x
     sta     TAD_IO_ToDriver__PARAMETER0_PORT
 
+    ldy.w   tad_commandQueue_id__,x
+
     lda     tad_previousCommand__
     and     #TAD_IO_ToDriver__COMMAND_I_MASK    ; Clear the non i bits of the command
     eor     #TAD_IO_ToDriver__COMMAND_I_MASK    ; Flip the i bits
-    ora     tad_nextCommand_id__            ; Set the c bits
+    ora.w   tad_commandQueue_id__,x         ; Set the c bits
     sta     TAD_IO_ToDriver__COMMAND_PORT
     sta     tad_previousCommand__
 
@@ -981,9 +1273,13 @@ _tad_loader_gotoNextBank__:
         sta     tad_state__
 @SC_NotPauseOrPlay:
 
-    ; Reset command queue
-    lda     #$ff
-    sta     tad_nextCommand_id__
+    ; Remove the command from the queue
+    inx
+    txa
+    and     #TAD_COMMAND_QUEUE_SIZE - 1
+    sta     tad_commandQueue_readIndex__
+
+    dec     tad_commandQueue_count__
 .endm
 
 
@@ -1033,13 +1329,19 @@ _tad_loader_gotoNextBank__:
 ;; I16
 ;; DB = $80
 .macro _Tad_Process_WaitingForLoader__
+    ; `loadAudioData` is called with the next state on the stack
+    @_bytes_on_stack = 1
+
+    ; Test if the loader is ready before calling `loadAudioData`
+    ; (the LoaderDataType depends on the data returned by `loadAudioData`)
+    ldx     #TAD_IO_Loader_Init__LOADER_READY_HL
+    cpx     TAD_IO_Loader_Init__READY_PORT_HL
+    bne     @WFL_Return
+
     lda     tad_flags__
     bit     #TAD_Flags__RELOAD_COMMON_AUDIO_DATA
     beq     @WFL_SongData
         ; Common audio data
-        lda     #TAD_LoaderDataType__COMMON_DATA
-        jsr     _tad_loader_checkReadyAndSendLoaderDataType__
-        bcc     @WFL_Return
 
         ; Clear the RELOAD_COMMON_AUDIO_DATA flag
         ;
@@ -1051,22 +1353,38 @@ _tad_loader_gotoNextBank__:
         lda     #TAD_State__LOADING_COMMON_AUDIO_DATA
         pha
 
+        ; Transfer the patch if `tad_patchCommonAudioData` was called (and clear the patch flag)
+        lda     #TAD_Flags__PATCH_COMMON_AUDIO_DATA
+        trb     tad_flags__
+        beq     @WFL_LoadCommonAudioData
+            lda     tad_commonAudioDataPatch_bank__
+            ldx     tad_commonAudioDataPatch_addr__
+            ldy     tad_commonAudioDataPatch_size__
+            jsr     _tad_loader_setDataToTransfer__
+
+            ; Patches are always compressed
+            lda     #TAD_LoaderDataType__COMMON_DATA | TAD_LoaderDataType__COMPRESSED_FLAG
+            bra     @WFL_SendLoaderDataType
+
+    @WFL_LoadCommonAudioData:
+        ; STACK holds next state
         lda     #0
-        bra     @WFL_LoadData
+        __Call_loadAudioData__return_carry__
+        ; `loadAudioData` MUST return data with a non-zero size when `id = 0`
+        jsr     _tad_loader_setDataToTransfer__
+
+        lda     tad_flags__
+        and     #TAD_Flags__COMPRESSED_AUDIO_DATA
+        ora     #TAD_LoaderDataType__COMMON_DATA
+        bra     @WFL_SendLoaderDataType
 
     @WFL_SongData:
         ; Songs
 
-        ; a = tad_flags
-        and     #TAD_Flags__LOADER_MASK
-        ora     #TAD_LoaderDataType__MIN_SONG_VALUE
-        jsr     _tad_loader_checkReadyAndSendLoaderDataType__
-        bcc     @WFL_Return
-
         ; Determine next state
         .assert TAD_Flags__PLAY_SONG_IMMEDIATELY == $40
         .assert TAD_State__LOADING_SONG_DATA_PAUSED + 1 == TAD_State__LOADING_SONG_DATA_PLAY
-        lda     tad_flags__
+        ; a = tad_flags
         asl
         asl
         lda     #0
@@ -1078,22 +1396,53 @@ _tad_loader_gotoNextBank__:
         lda     tad_nextSong__
         beq     @WFL_UseBlankSong
 
-@WFL_LoadData:
-    ; STACK holds next state
-    @_bytes_on_stack = 1
-    __Call_loadAudioData__return_carry__
-    bcs     +
-        ; `loadAudioData` returned data with a non-zero size
-    @WFL_UseBlankSong:
-        lda     #:Tad_BlankSong_Bin
-        ldx     #Tad_BlankSong_Bin
-        ldy     #Tad_BlankSong_SIZE
-    +
-
+        ; Skip `loadAudioData` if the song was staged by `tad_stageSong`
+        cmp     tad_stagedSong__
+        bne     @WFL_LoadSong
+            lda     tad_songStaging_bank__
+            ldx     tad_songStaging_addr__
+            ldy     tad_stagedSong_size__
+            jsr     _tad_loader_setDataToTransfer__
+
+            lda     tad_flags__
+            and     #TAD_Flags__LOADER_MASK
+            ora     tad_stagedSong_transferFlag__
+            ora     #TAD_LoaderDataType__MIN_SONG_VALUE
+            bra     @WFL_SendLoaderDataType
+
+    @WFL_LoadSong:
+        ; STACK holds next state
+        __Call_loadAudioData__return_carry__
+        bcc     @WFL_UseBlankSong
+            ; `loadAudioData` returned data with a non-zero size
+            jsr     _tad_loader_setDataToTransfer__
+
+            ; Compressed data is transferred 2 bytes at a time
+            lda     tad_flags__
+            bit     #TAD_Flags__COMPRESSED_AUDIO_DATA
+            beq     @WFL_UncompressedSong
+                and     #TAD_Flags__LOADER_MASK | TAD_Flags__COMPRESSED_AUDIO_DATA
+                ora     #TAD_LoaderDataType__MIN_SONG_VALUE
+                bra     @WFL_SendLoaderDataType
+
+        @WFL_UseBlankSong:
+            lda     #:Tad_BlankSong_Bin
+            ldx     #Tad_BlankSong_Bin
+            ldy     #Tad_BlankSong_SIZE
+            jsr     _tad_loader_setDataToTransfer__
+
+            ; The blank song is never compressed
+            lda     tad_flags__
+
+        @WFL_UncompressedSong:
+            and     #TAD_Flags__LOADER_MASK
+            ora     #TAD_LoaderDataType__MIN_SONG_VALUE | TAD_LoaderDataType__FAST_TRANSFER_FLAG
+
+@WFL_SendLoaderDataType:
+    ; A = LoaderDataType
     ; STACK holds next state
-    ; A:X = data address
-    ; Y = data size
-    jsr     _tad_loader_setDataToTransfer__
+    jsr     _tad_loader_checkReadyAndSendLoaderDataType__
+    ; The loader is ready (tested above), carry is always set
 
     pla
     sta     tad_state__
@@ -1110,8 +1459,31 @@ _tad_loader_gotoNextBank__:
 .index 16
 ;; DB = 0x80
 _tad_process__loading__:
-    jsr     _tad_loader_transferData__
-    bcc     @Return
+    ldx     tad_transferDeadline__
+    bne     @TransferUntilDeadline
+        jsr     _tad_loader_transferData__
+        bcc     @Return
+        bra     @Loaded
+
+    @TransferUntilDeadline:
+        jsr     _tad_readVCounter__
+        stx     tad_transferStartScanline__
+
+        @DeadlineLoop:
+            ; Transfer at least one block, even if the deadline has already passed
+            jsr     _tad_loader_transferData__
+            bcs     @Loaded
+
+            jsr     _tad_readVCounter__
+            cpx     tad_transferDeadline__
+            bcs     @Return
+
+            ; Stop if the V counter wrapped (the deadline is after the last scanline)
+            cpx     tad_transferStartScanline__
+            bcs     @DeadlineLoop
+            rts
+
+@Loaded:
         ; Data loaded successfully
         lda     tad_state__
         cmp     #TAD_State__LOADING_COMMON_AUDIO_DATA
@@ -1128,8 +1500,13 @@ _tad_process__loading__:
             stz     tad_previousCommand__
 
             ; Reset command and SFX queues
+            stz     tad_commandQueue_readIndex__
+            stz     tad_commandQueue_count__
+
+            stz     tad_sfxBatch_readIndex__
+            stz     tad_sfxBatch_count__
+
             lda     #$ff
-            sta     tad_nextCommand_id__
             sta     tad_sfxQueue_sfx
             sta     tad_sfxQueue_pan
 
@@ -1174,24 +1551,50 @@ _tad_process__loading__:
             ; Previous command has been processed
 
             ; Check command queue
-            ldy     tad_nextCommand_id__
-            bpl     @SendCommand
+            lda     tad_commandQueue_count__
+            bne     @SendCommand
 
             ; X = tad_state
             .assert TAD_State__PAUSED < $81
             .assert TAD_State__PLAYING >= $81
             .assert TAD_State__PLAYING_SFX >= $81
             dex
-            bpl     @Return_I8
+            bpl     @Idle
                 ; Playing state
                 lda     tad_sfxQueue_sfx
                 cmp     #$ff
-                beq     @Return_I8
+                bne     @SendSfx
+                    ; Sound effect queue is empty, move the oldest batched sound effect (if any) to the queue
+                    ldy     tad_sfxBatch_count__
+                    beq     @Idle
+
+                    dec     tad_sfxBatch_count__
+
+                    ldy     tad_sfxBatch_readIndex__
+                    lda.w   tad_sfxBatch_pan__,y
+                    sta     tad_sfxQueue_pan
+
+                    tya
+                    ina
+                    and     #TAD_SFX_BATCH_SIZE - 1
+                    sta     tad_sfxBatch_readIndex__
+
+                    lda.w   tad_sfxBatch_sfx__,y
+
+                @SendSfx:
                     _Tad_Process_SendSfxCommand__
                     bra     @Return_I8
 
         .accu 8
         .index 8
+        @Idle:
+            ; Nothing to send, skip the state machine until the next command, sound effect or
+            ; song is queued.
+            ; (The state is not a loading state and a paused sound effect batch is not sent until
+            ; an UNPAUSE or PAUSE_MUSIC_PLAY_SFX command is queued.)
+            stz     tad_workPending__
+            bra     @Return_I8
+
         @SendCommand:
             _Tad_Process_SendCommand__
         @Return_I8:
@@ -1242,19 +1645,31 @@ tad_init:
     ldx     #TAD_DEFAULT_TRANSFER_PER_FRAME
     stx     tad_bytesToTransferPerFrame__
 
+    ldx     #TAD_NO_TRANSFER_DEADLINE
+    stx     tad_transferDeadline__
+
     lda     #:Tad_AudioDriver_Bin
     ldx     #Tad_AudioDriver_Bin
     ldy     #Tad_AudioDriver_SIZE
     jsr     _tad_loader_setDataToTransfer__
 
+    stz     tad_commandQueue_readIndex__
+    stz     tad_commandQueue_count__
+
+    stz     tad_sfxBatch_readIndex__
+    stz     tad_sfxBatch_count__
+
     lda     #$ff
-    sta     tad_nextCommand_id__
     sta     tad_sfxQueue_sfx
 
     stz     tad_nextSong__
+    stz     tad_stagedSong__
+
+    stz     tad_processLock__
+    stz     tad_processCalled__
 
     @DataTypeLoop:
-        lda     #TAD_LoaderDataType__CODE
+        lda     #TAD_LoaderDataType__CODE | TAD_LoaderDataType__FAST_TRANSFER_FLAG
         jsr     _tad_loader_checkReadyAndSendLoaderDataType__
         bcc     @DataTypeLoop
 
@@ -1265,19 +1680,44 @@ tad_init:
     lda     #TAD_State__WAITING_FOR_LOADER
     sta     tad_state__
 
+    lda     #1
+    sta     tad_workPending__
+
     __PopReturn_X16_Y16_DB_80
 
 
 
 ; void tad_process(void)
 tad_process:
+    ; Return immediately if there is nothing to send or load (32 cycles, excluding the JSL).
+    ; `tad_processCalled__` is not set, `tad_processNmi` only uses it when the loader is active.
+    php
+    sep     #$20
+.accu 8
+    lda.l   tad_workPending__
+    bne     @Process
+    lda.l   tad_sfxQueue_sfx
+    ina
+    bne     @Process
+        plp
+        rtl
+
+@Process:
+    plp
     __Push__A8_X16_Y16_DB_80
 .accu 8
 .index 16
 // DB = $80
 
+    inc     tad_processLock__
+
+    lda     #1
+    sta     tad_processCalled__
+
     __Tad_Process__
 
+    dec     tad_processLock__
+
     __PopReturn_X16_Y16_DB_80
 
 
@@ -1289,6 +1729,8 @@ tad_finishLoadingData:
 .index 16
 // DB = $80
 
+    inc     tad_processLock__
+
     @Loop:
         __Tad_IsLoaderActive__a8_db80_carry__
         bcc     @EndLoop
@@ -1296,17 +1738,212 @@ tad_finishLoadingData:
         bra     @Loop
     @EndLoop:
 
-    __PopReturn_X16_Y16_DB_80
-
+    dec     tad_processLock__
 
-
-.ends
+    __PopReturn_X16_Y16_DB_80
 
 
 
-;; ===================
-;; All other functions
-;; ===================
+; void tad_processNmi(void)
+;
+; Does not use the PVSnesLib ABI, all registers are preserved.
+tad_processNmi:
+    php
+    rep     #$30
+.accu 16
+.index 16
+    pha
+    phx
+    phy
+    phd
+    phb
+
+    lda     #0
+    tcd
+// D = 0
+
+    sep     #$20
+.accu 8
+
+    lda     #$80
+    pha
+    plb
+// DB = $80
+
+    ; Do not interrupt `tad_process`, `tad_finishLoadingData` or `tad_loadSong`
+    lda.w   tad_processLock__
+    bne     @Return
+
+    ; Only transfer data on lag frames
+    lda.w   tad_processCalled__
+    stz.w   tad_processCalled__
+    bne     @Return
+
+    __Tad_IsLoaderActive__a8_db80_carry__
+    bcc     @Return
+
+    ; Do not transfer the last block of data.
+    ; Finishing the transfer changes the state and resets the command and sound effect queues,
+    ; which cannot be done safely in an interrupt.
+    ; (`_tad_loader_transferData__` transfers at most `tad_bytesToTransferPerFrame__ + 1` bytes)
+    rep     #$20
+.accu 16
+    lda.w   tad_bytesToTransferPerFrame__
+    ina
+    cmp.w   tad_dataToTransfer_size__
+    sep     #$20
+.accu 8
+    bcs     @Return
+
+    jsr     _tad_loader_transferData__
+
+@Return:
+    rep     #$30
+.accu 16
+.index 16
+    plb
+    pld
+    ply
+    plx
+    pla
+    plp
+    rtl
+
+
+
+; bool tad_stageSong(u8 song_id)
+tad_stageSong:
+    __Push__A8_X16_Y16_DB_80
+.accu 8
+.index 16
+// DB = $80
+
+    ; `loadAudioData` is called with nothing on the stack
+    @_bytes_on_stack = 0
+
+    ; The blank song is never staged
+    lda     _stack_arg_offset,s
+    beq     @ReturnFalse
+
+    ; Calling `loadAudioData` can free the data that is being transferred to the loader
+    __Tad_IsLoaderActive__a8_db80_carry__
+    bcs     @ReturnFalse
+
+    ; The staging buffer is about to be overwritten
+    stz     tad_stagedSong__
+
+    lda     _stack_arg_offset,s
+    __Call_loadAudioData__return_carry__
+    bcc     @ReturnFalse
+
+    ; The data MUST NOT be empty and MUST fit in the staging buffer
+    dey
+    cpy     tad_songStaging_bufferSize__
+    iny
+    bcs     @ReturnFalse
+
+    sty     tad_stagedSong_size__
+
+    ; A:X = far address of the song data
+    pha
+
+    rep     #$20
+.accu 16
+    lda     tad_songStaging_addr__
+    sta     tad_songStaging_writePtr__
+
+    sep     #$20
+.accu 8
+    lda     tad_songStaging_bank__
+    sta     tad_songStaging_writePtr__ + 2
+
+    ; X = number of bytes to copy
+    ; Y = data address (`_tad_loader_gotoNextBank__` advances Y)
+    phx
+    tyx
+    ply
+
+    phd
+    phb
+
+    rep     #$20
+.accu 16
+    lda     #tad_songStaging_writePtr__
+    tcd
+; D = tad_songStaging_writePtr__
+
+    sep     #$20
+.accu 8
+    ; Stack: DB, D, data bank
+    lda     4,s
+    pha
+    plb
+; DB = data bank
+
+    @CopyLoop:
+        lda.w   0,y
+        sta     [$00]
+
+        rep     #$20
+    .accu 16
+        inc.b   $00
+        sep     #$20
+    .accu 8
+
+        iny
+        bne     +
+            jsr     _tad_loader_gotoNextBank__
+        +
+        dex
+        bne     @CopyLoop
+
+    plb
+    pld
+; DB restored (0x80)
+; D = 0
+
+    pla
+
+    ; Compressed data is transferred 2 bytes at a time
+    .assert TAD_Flags__COMPRESSED_AUDIO_DATA == TAD_LoaderDataType__COMPRESSED_FLAG
+    lda     tad_flags__
+    and     #TAD_Flags__COMPRESSED_AUDIO_DATA
+    bne     +
+        lda     #TAD_LoaderDataType__FAST_TRANSFER_FLAG
+    +
+    sta     tad_stagedSong_transferFlag__
+
+    lda     _stack_arg_offset,s
+    sta     tad_stagedSong__
+
+    sec
+    bra     @Return
+
+@ReturnFalse:
+    clc
+@Return:
+    ; Convert carry to a PVSnesLib bool
+    rep     #$20
+.accu 16
+    lda     #PVSNESLIB_FALSE
+    bcc     +
+        lda     #PVSNESLIB_TRUE
+    +
+    sta.b   tcc__r0
+
+    sep     #$20
+.accu 8
+    __PopReturn_X16_Y16_DB_80
+
+
+
+.ends
+
+
+
+;; ===================
+;; All other functions
+;; ===================
 ;;
 ;; Called using the PVSnesLib ABI, with DB unknown.
 ;; All subroutines in this section access variables using long addressing.
@@ -1356,6 +1993,118 @@ tad_queueSoundEffect:
 
 
 
+;; Adds a sound effect to the end of the sound effect batch.
+;;
+;; IN: A = sfx id
+;; IN: X = pan
+;;
+;; OUT: tcc__r0 = bool
+;;
+;; A8
+;; I8
+;; DB = $80
+.macro __Tad_BatchSoundEffect__a8_i8_db80__
+    ldy     tad_sfxBatch_count__
+    cpy     #TAD_SFX_BATCH_SIZE
+    bcs     @BSE_BatchFull
+        pha
+
+        ; Y = index of the first empty slot
+        lda     tad_sfxBatch_readIndex__
+        clc
+        adc     tad_sfxBatch_count__
+        and     #TAD_SFX_BATCH_SIZE - 1
+        tay
+
+        pla
+        sta.w   tad_sfxBatch_sfx__,y
+
+        txa
+        sta.w   tad_sfxBatch_pan__,y
+
+        inc     tad_sfxBatch_count__
+
+        lda     #1
+        sta     tad_workPending__
+
+        rep     #$30
+    .accu 16
+    .index 16
+        lda     #PVSNESLIB_TRUE
+        bra     @BSE_EndIf
+
+    .accu 8
+    .index 8
+    @BSE_BatchFull:
+        rep     #$30
+    .accu 16
+    .index 16
+        lda     #PVSNESLIB_FALSE
+
+.accu 16
+.index 16
+@BSE_EndIf:
+    ; return bool in tcc__r0
+    sta.b   tcc__r0
+.endm
+
+
+
+.section "tad_batchPannedSoundEffect" SUPERFREE
+
+; bool tad_batchPannedSoundEffect(u8 sfx_id, u8 pan)
+tad_batchPannedSoundEffect:
+    __Push__A8_X16_Y16_DB_80
+
+    sep     #$10
+.index 8
+    lda     _stack_arg_offset + 1,s
+    tax
+
+    lda     _stack_arg_offset + 0,s
+
+    __Tad_BatchSoundEffect__a8_i8_db80__
+
+    __PopReturn_X16_Y16_DB_80
+.ends
+
+
+
+.section "tad_batchSoundEffect" SUPERFREE
+
+; bool tad_batchSoundEffect(u8 sfx_id)
+tad_batchSoundEffect:
+    __Push__A8_X16_Y16_DB_80
+
+    sep     #$10
+.index 8
+    ldx     #TAD_CENTER_PAN
+
+    lda     _stack_arg_offset,s
+
+    __Tad_BatchSoundEffect__a8_i8_db80__
+
+    __PopReturn_X16_Y16_DB_80
+.ends
+
+
+
+.section "tad_getSfxBatchSpace" SUPERFREE
+
+; u8 tad_getSfxBatchSpace(void)
+tad_getSfxBatchSpace:
+    __Push__A8_noX_noY
+.accu 8
+
+    lda     #TAD_SFX_BATCH_SIZE
+    sec
+    sbc.l   tad_sfxBatch_count__
+
+    __PopReturn_A8_noX_noY__u8_in_a
+.ends
+
+
+
 .section "tad_loadSong" SUPERFREE
 
 ; void tad_loadSong(u8 song_id)
@@ -1367,9 +2116,18 @@ tad_loadSong:
     __Push__A8_noX_noY
 .accu 8
 
+    ; Prevent `tad_processNmi` from transferring data after the switch-to-loader command is sent.
+    ; (`tad_processNmi` does not write to `tad_processLock__`)
+    lda.l   tad_processLock__
+    ina
+    sta.l   tad_processLock__
+
     lda     _stack_arg_offset,s
     sta.l   tad_nextSong__
 
+    lda     #1
+    sta.l   tad_workPending__
+
     lda.l   tad_state__
     cmp     #TAD_FIRST_LOADING_SONG_STATE
     bcc     +
@@ -1383,6 +2141,10 @@ tad_loadSong:
         sta.l   tad_state__
     +
 
+    lda.l   tad_processLock__
+    dea
+    sta.l   tad_processLock__
+
     __PopReturn_noX_noY
 .ends
 
@@ -1429,6 +2191,118 @@ tad_getSong:
 
 
 
+.section "tad_patchCommonAudioData" SUPERFREE
+
+; void tad_patchCommonAudioData(const u8* patch, u16 size)
+tad_patchCommonAudioData:
+    __Push__A16_noX_noY
+.accu 16
+
+    lda     _stack_arg_offset + 0,s
+    sta.l   tad_commonAudioDataPatch_addr__
+
+    lda     _stack_arg_offset + 4,s
+    sta.l   tad_commonAudioDataPatch_size__
+
+    sep     #$20
+.accu 8
+    lda     _stack_arg_offset + 2,s
+    sta.l   tad_commonAudioDataPatch_bank__
+
+    lda.l   tad_flags__
+    ora     #TAD_Flags__RELOAD_COMMON_AUDIO_DATA | TAD_Flags__PATCH_COMMON_AUDIO_DATA
+    sta.l   tad_flags__
+
+    __PopReturn_noX_noY
+.ends
+
+
+
+.section "tad_setSongStagingBuffer" SUPERFREE
+
+; void tad_setSongStagingBuffer(u8* buffer, u16 size)
+tad_setSongStagingBuffer:
+    __Push__A16_noX_noY
+.accu 16
+
+    lda     _stack_arg_offset + 0,s
+    sta.l   tad_songStaging_addr__
+
+    lda     _stack_arg_offset + 4,s
+    sta.l   tad_songStaging_bufferSize__
+
+    sep     #$20
+.accu 8
+    lda     _stack_arg_offset + 2,s
+    sta.l   tad_songStaging_bank__
+
+    lda     #0
+    sta.l   tad_stagedSong__
+
+    __PopReturn_noX_noY
+.ends
+
+
+
+.section "tad_getStagedSongHandshakes" SUPERFREE
+
+; u16 tad_getStagedSongHandshakes(void)
+tad_getStagedSongHandshakes:
+    __Push__A8_noX_noY
+.accu 8
+
+    lda.l   tad_stagedSong__
+    bne     +
+        rep     #$20
+    .accu 16
+        lda     #0
+        bra     @Return
+    +
+.accu 8
+
+    lda.l   tad_stagedSong_transferFlag__
+    cmp     #TAD_LoaderDataType__FAST_TRANSFER_FLAG
+
+    rep     #$20
+.accu 16
+    beq     @Fast
+        ; 2 bytes per handshake
+        lda.l   tad_stagedSong_size__
+        lsr
+        adc     #0
+        bra     @Return
+
+    @Fast:
+        ; 3 bytes per handshake (using the S-CPU divider)
+        lda.l   tad_stagedSong_size__
+        sta.l   $004204     ; WRDIV
+
+        sep     #$20
+    .accu 8
+        lda     #3
+        sta.l   $004206     ; WRDIVB
+
+        rep     #$20
+    .accu 16
+        ; Wait for the division to complete
+        nop
+        nop
+        nop
+        nop
+        nop
+
+        ; carry set if the remainder is non-zero
+        lda.l   $004216     ; RDMPY
+        cmp     #1
+        lda.l   $004214     ; RDDIV
+        adc     #0
+
+@Return:
+    __PopReturn_A16_noX_noY__u16_in_a
+.ends
+
+
+
 .section "tad_setTransferSize" SUPERFREE
 
 ; void tad_setTransferSize(u16 transferSize)
@@ -1452,6 +2326,21 @@ tad_setTransferSize:
 
 
 
+.section "tad_setTransferDeadline" SUPERFREE
+
+; void tad_setTransferDeadline(u16 scanline)
+tad_setTransferDeadline:
+    __Push__A16_noX_noY
+.accu 16
+
+    lda     _stack_arg_offset,s
+    sta.l   tad_transferDeadline__
+
+    __PopReturn_noX_noY
+.ends
+
+
+
 ;; -------------------------
 ;; Set/Clear Flags functions
 ;; -------------------------
@@ -1480,6 +2369,10 @@ __Tad_FlagFunction tad_setStereo             STEREO                   1
 __Tad_FlagFunction tad_setMono               STEREO                   0
 __Tad_FlagFunction tad_songsStartImmediately PLAY_SONG_IMMEDIATELY    1
 __Tad_FlagFunction tad_songsStartPaused      PLAY_SONG_IMMEDIATELY    0
+__Tad_FlagFunction tad_useCompressedAudioData   COMPRESSED_AUDIO_DATA 1
+__Tad_FlagFunction tad_useUncompressedAudioData COMPRESSED_AUDIO_DATA 0
+__Tad_FlagFunction tad_enableTickBudget         TICK_BUDGET           1
+__Tad_FlagFunction tad_disableTickBudget        TICK_BUDGET           0
 
 
 
@@ -1512,6 +2405,94 @@ tad_isLoaderActive:
 .ends
 
 
+.section "tad_getLoadBytesRemaining" SUPERFREE
+
+; u16 tad_getLoadBytesRemaining(void)
+tad_getLoadBytesRemaining:
+    __Push__A8_noX_noY
+
+    __Tad_IsLoaderActive__a8_far_carry__
+
+    rep     #$20
+.accu 16
+    lda     #0
+    bcc     +
+        lda.l   tad_dataToTransfer_size__
+    +
+
+    __PopReturn_A16_noX_noY__u16_in_a
+.ends
+
+
+
+.section "tad_getLoadFramesRemaining" SUPERFREE
+
+; u16 tad_getLoadFramesRemaining(void)
+tad_getLoadFramesRemaining:
+    __Push__A8_X16_Y16_DB_80
+.accu 8
+.index 16
+// DB = $80
+
+    ldy     #0
+
+    __Tad_IsLoaderActive__a8_db80_carry__
+    bcc     @Return
+
+    rep     #$20
+.accu 16
+    ; Y = ceil(tad_dataToTransfer_size / tad_bytesToTransferPerFrame)
+    ;
+    ; The S-CPU divider cannot be used as `tad_bytesToTransferPerFrame` can be > 255.
+    ;
+    ; Shift-subtract division
+    ;   X = dividend, shifted left into the quotient
+    ;   1,s = remainder
+    ldx.w   tad_dataToTransfer_size__
+
+    lda     #0
+    pha
+
+    ldy     #16
+    @Loop:
+        txa
+        asl
+        tax
+
+        lda     1,s
+        rol
+        cmp.w   tad_bytesToTransferPerFrame__
+        bcc     +
+            sbc.w   tad_bytesToTransferPerFrame__
+            inx
+        +
+        sta     1,s
+
+        dey
+        bne     @Loop
+
+    ; carry set if the remainder is non-zero
+    pla
+    cmp     #1
+    txa
+    adc     #0
+    tay
+
+    sep     #$20
+.accu 8
+@Return:
+    rep     #$20
+.accu 16
+    tya
+    sta.b   tcc__r0
+
+    sep     #$20
+.accu 8
+    __PopReturn_X16_Y16_DB_80
+.ends
+
+
+
 
 .section "tad_isSongLoaded" SUPERFREE
 
@@ -1559,10 +2540,83 @@ tad_isSongPlaying:
 
 
 
+.section "tad_getDriverHeadroom" SUPERFREE
+
+; u8 tad_getDriverHeadroom(void)
+tad_getDriverHeadroom:
+    __Push__A16_noX_noY
+.accu 16
+
+    sep     #$20
+.accu 8
+    .assert TAD_State__PLAYING > TAD_State__PLAYING_SFX
+    .assert TAD_State__PLAYING_SFX > TAD_State__PAUSED
+    ; Assumes PLAYING is the last state
+    lda.l   tad_state__
+    cmp     #TAD_State__PLAYING_SFX
+    bcc     @Max
+    beq     @Sfx
+        ; PLAYING state
+        lda.l   TAD_IO_ToScpu__MUSIC_HEADROOM_PORT
+        cmp.l   TAD_IO_ToScpu__SFX_HEADROOM_PORT
+        bcc     @Return
+
+    @Sfx:
+        lda.l   TAD_IO_ToScpu__SFX_HEADROOM_PORT
+        bra     @Return
+
+    @Max:
+        ; No channels are processed when the song is not loaded or the audio driver is paused
+        lda     #TAD_IO_ToScpu__MAX_HEADROOM
+
+@Return:
+    rep     #$20
+.accu 16
+    and     #$00ff
+
+    __PopReturn_A16_noX_noY__u16_in_a
+.ends
+
+
+
 ;; --------------------------
 ;; Queue IO Command Functions
 ;; --------------------------
 
+;; Adds a command to the end of the command queue.
+;;
+;; REQUIRES: The command queue is not full.
+;;
+;; IN: A = command
+;; IN: X = parameter
+;;
+;; A8
+;; I8
+;; DB = $80
+.macro __Tad_AppendCommand__a8_i8_db80__
+    and     #TAD_IO_ToDriver__COMMAND_MASK
+    pha
+
+    ; Y = index of the first empty slot
+    lda     tad_commandQueue_readIndex__
+    clc
+    adc     tad_commandQueue_count__
+    and     #TAD_COMMAND_QUEUE_SIZE - 1
+    tay
+
+    pla
+    sta.w   tad_commandQueue_id__,y
+
+    txa
+    sta.w   tad_commandQueue_parameter__,y
+
+    inc     tad_commandQueue_count__
+
+    lda     #1
+    sta     tad_workPending__
+.endm
+
+
 .macro _Tad_QueueCommandFunction args NAME TYPE PARAMETER COMMAND_ID
     .section "\1" SUPERFREE
         \1:
@@ -1603,35 +2657,40 @@ _Tad_QueueCommandFunction tad_queueCommandOverride_setSongTempo        Override
 ; I unknown
 ; DB unknown
 tad__Command_A__Test_NoParameter__:
-    __Push__A8_noX_noY
-.accu 8
-
-    ; Cannot use `bit tad_nextCommand_id__` here, DB is unknown
-    ; Temporarily Save it in B
+    ; Temporarily save the command in B (`__Push__A8_X16_Y16_DB_80` clobbers A)
+    xba
+    __Push__A8_X16_Y16_DB_80
     xba
 
-    lda.l   tad_nextCommand_id__
-    bpl     @QueueFull
-        xba
-        sta.l   tad_nextCommand_id__
+    sep     #$10
+.index 8
+    ldy     tad_commandQueue_count__
+    cpy     #TAD_COMMAND_QUEUE_SIZE
+    bcs     @QueueFull
+        ldx     #0
+        __Tad_AppendCommand__a8_i8_db80__
 
-        rep     #$20
+        rep     #$30
     .accu 16
-        lda     #$ff
+    .index 16
+        lda     #PVSNESLIB_TRUE
         bra     @EndIf
 
     .accu 8
+    .index 8
     @QueueFull:
-        rep     #$20
+        rep     #$30
     .accu 16
-        lda     #0
+    .index 16
+        lda     #PVSNESLIB_FALSE
 
 .accu 16
+.index 16
 @EndIf:
     ; return bool in tcc__r0
     sta.b   tcc__r0
 
-    __PopReturn_noX_noY
+    __PopReturn_X16_Y16_DB_80
 .ends
 
 
@@ -1647,40 +2706,42 @@ tad__Command_A__Test_NoParameter__:
 ; I unknown
 ; DB unknown
 tad__Command_A__Test_WithParameter__:
-    __Push__A8_noX_noY
-
-    sep     #$20
-.accu 8
-
-    ; Cannot use `bit tad_nextCommand_id__` here, DB is unknown
-    ; Temporarily Save it in B
+    ; Temporarily save the command in B (`__Push__A8_X16_Y16_DB_80` clobbers A)
     xba
+    __Push__A8_X16_Y16_DB_80
 
-    lda.l   tad_nextCommand_id__
-    bpl     @QueueFull
-        xba
-        sta.l   tad_nextCommand_id__
+    sep     #$10
+.index 8
+    lda     _stack_arg_offset,s
+    tax
+    xba
 
-        lda     _stack_arg_offset,s
-        sta.l   tad_nextCommand_parameter__
+    ldy     tad_commandQueue_count__
+    cpy     #TAD_COMMAND_QUEUE_SIZE
+    bcs     @QueueFull
+        __Tad_AppendCommand__a8_i8_db80__
 
-        rep     #$20
+        rep     #$30
     .accu 16
-        lda     #$ff
+    .index 16
+        lda     #PVSNESLIB_TRUE
         bra     @EndIf
 
     .accu 8
+    .index 8
     @QueueFull:
-        rep     #$20
+        rep     #$30
     .accu 16
-        lda     #0
+    .index 16
+        lda     #PVSNESLIB_FALSE
 
 .accu 16
+.index 16
 @EndIf:
     ; return bool in tcc__r0
     sta.b   tcc__r0
 
-    __PopReturn_noX_noY
+    __PopReturn_X16_Y16_DB_80
 .ends
 
 
@@ -1690,18 +2751,26 @@ tad__Command_A__Test_WithParameter__:
 ;
 ; IN: A = command (bit 8 MUST be clear)
 ;
-; OUT: tcc__r0 = bool
-;
 ; A unknown
 ; I unknown
 ; DB unknown
 tad__Command_A__Override_NoParameter__:
-    __Push__A8_noX_noY
-.accu 8
+    ; Temporarily save the command in B (`__Push__A8_X16_Y16_DB_80` clobbers A)
+    xba
+    __Push__A8_X16_Y16_DB_80
+    xba
 
-    sta.l   tad_nextCommand_id__
+    sep     #$10
+.index 8
+    ; Clear the command queue
+    stz     tad_commandQueue_count__
 
-    __PopReturn_noX_noY
+    ldx     #0
+    __Tad_AppendCommand__a8_i8_db80__
+
+    rep     #$10
+.index 16
+    __PopReturn_X16_Y16_DB_80
 .ends
 
 
@@ -1712,20 +2781,44 @@ tad__Command_A__Override_NoParameter__:
 ; IN: A = command (bit 8 MUST be clear)
 ; IN: u8 parameter on stack
 ;
-; OUT: tcc__r0 = bool
-;
 ; A unknown
 ; I unknown
 ; DB unknown
 tad__Command_A__Override_WithParameter__:
-    __Push__A8_noX_noY
-
-    sta.l   tad_nextCommand_id__
+    ; Temporarily save the command in B (`__Push__A8_X16_Y16_DB_80` clobbers A)
+    xba
+    __Push__A8_X16_Y16_DB_80
 
+    sep     #$10
+.index 8
     lda     _stack_arg_offset,s
-    sta.l   tad_nextCommand_parameter__
+    tax
+    xba
 
-    __PopReturn_noX_noY
+    ; Clear the command queue
+    stz     tad_commandQueue_count__
+
+    __Tad_AppendCommand__a8_i8_db80__
+
+    rep     #$10
+.index 16
+    __PopReturn_X16_Y16_DB_80
+.ends
+
+
+
+.section "tad_getCommandQueueSpace" SUPERFREE
+
+; u8 tad_getCommandQueueSpace(void)
+tad_getCommandQueueSpace:
+    __Push__A8_noX_noY
+.accu 8
+
+    lda     #TAD_COMMAND_QUEUE_SIZE
+    sec
+    sbc.l   tad_commandQueue_count__
+
+    __PopReturn_A8_noX_noY__u8_in_a
 .ends
 
 
@@ -1763,6 +2856,24 @@ tad__Command_A__Override_WithParameter__:
     ;; The previous `IO_ToScpu::COMMAND_PORT` sent to the S-SMP audio driver.
     tad_previousCommand__: db
 
+    ;; Non-zero if `tad_process`, `tad_finishLoadingData` or `tad_loadSong` is executing.
+    ;; `tad_processNmi` does nothing if this value is non-zero.
+    tad_processLock__: db
+
+    ;; Non-zero if `tad_process` was called after the previous `tad_processNmi` call.
+    ;; Used by `tad_processNmi` to detect lag frames.
+    tad_processCalled__: db
+
+    ;; Non-zero if `tad_process` may have work to do.
+    ;;
+    ;; Set by `tad_init`, `tad_loadSong` and the command queue and sound effect batch functions.
+    ;; Cleared by `tad_process` when the state is PAUSED, PLAYING_SFX or PLAYING and there is
+    ;; nothing to send to the audio driver.
+    ;;
+    ;; If zero and `tad_sfxQueue_sfx` is empty, `tad_process` returns immediately.
+    ;; (`tad_sfxQueue_sfx` is public, it is tested separately.)
+    tad_workPending__: db
+
 
 ;; ---------------------------------------------------
 ;; Queue 1 - remaining data to transfer into Audio-RAM
@@ -1787,16 +2898,23 @@ tad__Command_A__Override_WithParameter__:
     tad_nextSong__: db
 
 
-;; ------------------------------------------------------
-;; Queue 3 - The next command to send to the audio driver
-;; ------------------------------------------------------
-    ;; The next `Command` to send to the audio driver.
-    ;; MUST NOT be PLAY_SOUND_EFFECT_COMMAND.
-    ;; If this value is negative, the queue is empty.
-    tad_nextCommand_id__: db
+;; --------------------------------------------------
+;; Queue 3 - The commands to send to the audio driver
+;; --------------------------------------------------
+    ;; A ring buffer of the `Command`s to send to the audio driver.
+    ;; MUST NOT contain PLAY_SOUND_EFFECT_COMMAND.
+    tad_commandQueue_id__: dsb TAD_COMMAND_QUEUE_SIZE
+
+    ;; The parameter of each queued command (if any)
+    tad_commandQueue_parameter__: dsb TAD_COMMAND_QUEUE_SIZE
 
-    ;; The parameter of the next next command (if any)
-    tad_nextCommand_parameter__: db
+    ;; Index of the oldest command in the queue
+    ;; (MUST be < TAD_COMMAND_QUEUE_SIZE)
+    tad_commandQueue_readIndex__: db
+
+    ;; Number of commands in the queue.
+    ;; If this value is 0, the queue is empty.
+    tad_commandQueue_count__: db
 
 
 ;; ---------------------------------------
@@ -1805,6 +2923,80 @@ tad__Command_A__Override_WithParameter__:
     ;; see tad-audio.h
     tad_sfxQueue_sfx: db
     tad_sfxQueue_pan: db
+
+
+;; ---------------------------------------
+;; Queue 5 - Batched sound effects to play
+;; ---------------------------------------
+    ;; A ring buffer of the sound effects to send to the audio driver
+    ;; after the sound effect queue is empty.
+    tad_sfxBatch_sfx__: dsb TAD_SFX_BATCH_SIZE
+
+    ;; The pan value of each batched sound effect
+    tad_sfxBatch_pan__: dsb TAD_SFX_BATCH_SIZE
+
+    ;; Index of the oldest sound effect in the batch
+    ;; (MUST be < TAD_SFX_BATCH_SIZE)
+    tad_sfxBatch_readIndex__: db
+
+    ;; Number of sound effects in the batch.
+    ;; If this value is 0, the batch is empty.
+    tad_sfxBatch_count__: db
+
+
+;; ------------------------
+;; Loader transfer deadline
+;; ------------------------
+    ;; The scanline `tad_process` stops transferring data to the loader at.
+    ;; If this value is `TAD_NO_TRANSFER_DEADLINE`, `tad_bytesToTransferPerFrame` bytes are
+    ;; transferred per `tad_process` call.
+    tad_transferDeadline__: dw
+
+    ;; The scanline the current `tad_process` transfer started at.
+    ;; Used to detect a deadline that is after the last scanline of the frame.
+    tad_transferStartScanline__: dw
+
+
+;; ----------------
+;; Loader data type
+;; ----------------
+    ;; The LoaderDataType sent to the loader.
+    ;; Used to determine how the data is transferred to the loader.
+    tad_dataToTransfer_loaderDataType__: db
+
+
+;; -----------------------
+;; Common audio data patch
+;; -----------------------
+    ;; The compressed patch to transfer if the `TAD_Flags__PATCH_COMMON_AUDIO_DATA` flag is set.
+    ;; (see `tad_patchCommonAudioData`)
+    tad_commonAudioDataPatch_addr__: dw
+    tad_commonAudioDataPatch_bank__: db
+    tad_commonAudioDataPatch_size__: dw
+
+
+;; ------------
+;; Song staging
+;; ------------
+    ;; The Work-RAM buffer `tad_stageSong` copies song data into
+    ;; (see `tad_setSongStagingBuffer`)
+    tad_songStaging_addr__: dw
+    tad_songStaging_bank__: db
+    tad_songStaging_bufferSize__: dw
+
+    ;; The song in the staging buffer.
+    ;; If this value is 0, no song is staged.
+    tad_stagedSong__: db
+
+    ;; Size of the staged song data
+    tad_stagedSong_size__: dw
+
+    ;; The LoaderDataType transfer flag of the staged song
+    ;; (`FAST_TRANSFER_FLAG` or `COMPRESSED_FLAG`)
+    tad_stagedSong_transferFlag__: db
+
+    ;; Far pointer to the next staging buffer byte (only used by `tad_stageSong`)
+    tad_songStaging_writePtr__: dsb 3
 .ends
 
 
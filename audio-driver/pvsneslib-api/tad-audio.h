@@ -122,9 +122,10 @@
  *  * The audio driver (*Common Audio Data*) is responsible for determining if the *sfx id*
  *    is valid.
  *
- * The `tad-compiler pv-export` command can output a single uncompressed binary file that
+ * The `tad-compiler pv-export` command can output a single binary file that
  * contains the audio-driver and audio-data and an assembly file that contains audio driver
  * exports and loadAudioData() callback.
+ * The `--compress` option compresses the audio data (see tad_useCompressedAudioData()).
  *
  * Alternatively, the developer can create their own loadAudioData() callback subroutine and
  * populate the ROM with the output of the `tad-compiler common` and `tad-compiler song`
@@ -147,6 +148,15 @@
 /*! Minimum tick clock value for tad_queueCommand_setSongTempo() and tad_queueCommandOverride_setSongTempo() */
 #define TAD_MIN_TICK_CLOCK 64
 
+/*! Number of IO commands the command queue can hold */
+#define TAD_COMMAND_QUEUE_SIZE 4
+
+/*! Number of sound effects the sound effect batch can hold */
+#define TAD_SFX_BATCH_SIZE 4
+
+/*! tad_setTransferDeadline() value to disable the transfer deadline */
+#define TAD_NO_TRANSFER_DEADLINE 0
+
 
 /*!
  * Initialises the audio driver:
@@ -159,6 +169,7 @@
  *      * Sets the *Reload Common Audio Data* flag
  *      * Sets the *Play Song Immediately* flag
  *      * Clears the *Stereo* flag (mono output)
+ *      * Clears the *Compressed Audio Data* flag
  *  * Queues a common audio data transfer
  *
  * This function will require multiple frames of execution time.
@@ -190,6 +201,14 @@ void tad_init(void);
  *
  * NOTE: The command and sound-effect queues will be reset after a new song is loaded into Audio-RAM.
  *
+ * tad_process() returns immediately if there is nothing to do (no data is being loaded and the
+ * queues are empty or the previous command has been processed with nothing left to send).
+ *
+ * CPU cycles (excluding the 8 cycle JSL):
+ *  * Idle (nothing queued, not loading): 32 cycles.
+ *  * A command, sound effect or song is queued, or loading: 18 cycles plus the state machine
+ *    (27 cycles if only tad_queueSoundEffect() or tad_queuePannedSoundEffect() was called).
+ *
  * TIMING:
  *  * MUST be called after tad_init().
  *  * Should be called once per frame.
@@ -210,12 +229,38 @@ void tad_process(void);
  */
 void tad_finishLoadingData(void);
 
+/*!
+ * Transfers data to Audio-RAM on lag frames.
+ *
+ * An interrupt-safe subset of tad_process() that can be called by the VBlank ISR
+ * (`nmi_handler`) so audio data continues to load when the game lags and tad_process()
+ * is not called every frame.
+ *
+ * tad_processNmi() does nothing unless:
+ *  * tad_process() was not called since the previous tad_processNmi() call (a lag frame).
+ *  * tad_process(), tad_finishLoadingData() and tad_loadSong() are not executing.
+ *  * The loader is active (tad_isLoaderActive() returns true).
+ *
+ * At most tad_setTransferSize() bytes are transferred per call (the transfer deadline is
+ * ignored).  tad_processNmi() never sends commands, sound effects or the last block of data.
+ * These are left to tad_process().
+ *
+ * All registers are preserved.
+ *
+ * TIMING:
+ *  * MUST NOT be called before tad_init() has finished.
+ *  * Should be called once per VBlank.
+ */
+void tad_processNmi(void);
+
 
 /*!
  * @name Queue IO Commands
  *
- * The following functions will add a command to the command queue if the queue is empty.
- * The command queue can only hold 1 command.
+ * The following functions will add a command to the command queue if the queue is not full.
+ * The command queue can hold @ref TAD_COMMAND_QUEUE_SIZE commands.
+ *
+ * Queued commands are sent to the audio driver in order, one command per tad_process() call.
  *
  * @{
  */
@@ -292,6 +337,13 @@ bool tad_queueCommand_setMusicChannels(u8 mask);
  */
 bool tad_queueCommand_setSongTempo(u8 tickClock);
 
+/*!
+ * Returns the number of IO commands that can be added to the command queue.
+ *
+ * @return the number of free command queue slots (0 to @ref TAD_COMMAND_QUEUE_SIZE)
+ */
+u8 tad_getCommandQueueSpace(void);
+
 /*!
  * @}
  */
@@ -373,6 +425,39 @@ void tad_queuePannedSoundEffect(u8 sfx_id, u8 pan);
  */
 void tad_queueSoundEffect(u8 sfx_id);
 
+/*!
+ * Adds a sound effect to the end of the sound effect batch, with panning.
+ *
+ * Unlike tad_queuePannedSoundEffect(), batched sound effects are not dropped if another
+ * sound effect is queued in the same frame.  tad_process() sends the oldest batched sound
+ * effect to the audio driver (one sound effect per tad_process() call) when the sound effect
+ * queue is empty.
+ *
+ * The sound effect batch can hold @ref TAD_SFX_BATCH_SIZE sound effects.
+ *
+ * @param sfx_id the sound effect to play
+ * @param pan pan value. 0 = 100% to the left, TAD_MAX_PAN = 100% to the right.
+ * @return true if the sound effect was added to the batch.
+ */
+bool tad_batchPannedSoundEffect(u8 sfx_id, u8 pan);
+
+/*!
+ * Adds a sound effect to the end of the sound effect batch with center pan (TAD_MAX_PAN/2).
+ *
+ * @see tad_batchPannedSoundEffect()
+ *
+ * @param sfx_id the sound effect to play
+ * @return true if the sound effect was added to the batch.
+ */
+bool tad_batchSoundEffect(u8 sfx_id);
+
+/*!
+ * Returns the number of sound effects that can be added to the sound effect batch.
+ *
+ * @return the number of free sound effect batch slots (0 to @ref TAD_SFX_BATCH_SIZE)
+ */
+u8 tad_getSfxBatchSpace(void);
+
 /*!
  * Disables the audio driver, starts the loader and queues a song transfer.
  *
@@ -421,6 +506,71 @@ u8 tad_getSong();
  */
 void tad_reloadCommonAudioData(void);
 
+/*!
+ * Patches the *common audio data* in Audio-RAM.
+ * This will not take effect until the next song is loaded into Audio-RAM.
+ *
+ * A patch only contains the bytes that differ from the *common audio data* currently in
+ * Audio-RAM, which is faster than tad_reloadCommonAudioData() if only a few instruments,
+ * samples or sound effects have changed.
+ *
+ * Patches are created with the `tad-compiler common --patch BASE_FILE` command.  The patch
+ * is always compressed (it ignores the *Compressed Audio Data* flag).
+ *
+ * CAUTION: The *common audio data* in Audio-RAM MUST match the `BASE_FILE` used to create
+ *          the patch.  This function MUST NOT be called until the *common audio data* has
+ *          been loaded into Audio-RAM.
+ *
+ * NOTE: The patch is read when the *common audio data* is transferred to Audio-RAM.
+ *       The patch MUST remain in memory until tad_isSongLoaded() returns true.
+ *
+ * @param patch the patch data
+ * @param size the size of the patch in bytes
+ */
+void tad_patchCommonAudioData(const u8* patch, u16 size);
+
+/*!
+ * Sets the Work-RAM buffer used by tad_stageSong().
+ *
+ * The staged song (if any) is discarded.
+ *
+ * CAUTION: MUST NOT be called while the loader is active (tad_isLoaderActive() returns true)
+ *          and the buffer MUST NOT cross a bank boundary.
+ *
+ * @param buffer the staging buffer
+ * @param size the size of the staging buffer in bytes
+ */
+void tad_setSongStagingBuffer(u8* buffer, u16 size);
+
+/*!
+ * Calls loadAudioData() and copies the song data into the staging buffer
+ * (see tad_setSongStagingBuffer()), so the song can be loaded without calling loadAudioData().
+ *
+ * When tad_loadSong() is called with the staged song, tad_process() transfers the staged data
+ * to the loader.  This moves the loadAudioData() call (and any decompression in the callback)
+ * from the song transition to an earlier (less busy) frame.
+ *
+ * The song is staged with the current *Compressed Audio Data* flag.  Only one song can be
+ * staged at a time and staging a song discards the previously staged song.
+ *
+ * @param song_id the song to stage
+ * @return false if the loader is active (tad_isLoaderActive() returns true), if `song_id` is 0,
+ *         if loadAudioData() returned no data or if the data does not fit in the staging buffer.
+ *         The previously staged song is discarded unless the loader is active or `song_id` is 0.
+ */
+bool tad_stageSong(u8 song_id);
+
+/*!
+ * Returns the number of loader handshakes required to transfer the staged song.
+ *
+ * This is an estimate of the song's transfer time: the loader receives 3 bytes per handshake
+ * (2 bytes if the staged song is compressed) and tad_setTransferSize() limits the number of
+ * bytes transferred per tad_process() call.
+ *
+ * @return the number of handshakes (0 if no song is staged)
+ */
+u16 tad_getStagedSongHandshakes(void);
+
 /*!
  * Clears the stereo flag.
  * This will not take effect until the next song is loaded into Audio-RAM.
@@ -449,6 +599,46 @@ void tad_songsStartImmediately(void);
  */
 void tad_songsStartPaused(void);
 
+/*!
+ * Sets the *Compressed Audio Data* flag.
+ *
+ * The *common audio data* and songs returned by `loadAudioData` are compressed
+ * (`tad-compiler pv-export --compress` or the `--compress` option of the `tad-compiler common`
+ * and `tad-compiler song` commands) and are decompressed by the loader.
+ * The blank song is never compressed.
+ *
+ * Compressed data is transferred 2 bytes at a time, but usually loads faster as less data
+ * is transferred to Audio-RAM.
+ *
+ * NOTE: tad_init() clears the *Compressed Audio Data* flag.  This function MUST be called
+ *       after tad_init() and before the first tad_process() call.
+ */
+void tad_useCompressedAudioData(void);
+
+/*!
+ * Clears the *Compressed Audio Data* flag (default).
+ */
+void tad_useUncompressedAudioData(void);
+
+/*!
+ * Sets the *tick budget guard* flag.
+ * This will not take effect until the next song is loaded into Audio-RAM.
+ *
+ * When the tick budget guard is enabled, the audio driver measures the time spent processing
+ * the music and sound effect channels.  If a tick is over budget, the vibrato and portamento
+ * of the remaining channels are skipped for that tick.  This keeps the note timing steady
+ * when a song and two sound effects overload the audio driver, at the expense of the pitch
+ * effects: a skipped portamento reaches its target a tick late and a skipped vibrato tick
+ * shifts the vibrato phase.
+ */
+void tad_enableTickBudget(void);
+
+/*!
+ * Clears the *tick budget guard* flag (default).
+ * This will not take effect until the next song is loaded into Audio-RAM.
+ */
+void tad_disableTickBudget(void);
+
 /*!
  * Sets the number of bytes to transfer to Audio-RAM per `tad_process` call.
  *
@@ -456,6 +646,24 @@ void tad_songsStartPaused(void);
  */
 void tad_setTransferSize(u16 transferSize);
 
+/*!
+ * Sets the scanline tad_process() will stop transferring data to Audio-RAM at.
+ *
+ * If a deadline is set, tad_process() will transfer data to Audio-RAM (in tad_setTransferSize()
+ * sized blocks) until the vertical scanline counter is at or after the deadline, the data has been
+ * transferred or the scanline counter wraps to the next frame.
+ * At least one block is transferred on every tad_process() call.
+ *
+ * If the deadline is @ref TAD_NO_TRANSFER_DEADLINE (the default), tad_process() will transfer
+ * tad_setTransferSize() bytes per call.
+ *
+ * CAUTION: The scanline counter is read using the PPU's H/V counter latch.
+ * Bit 7 of WRIO ($4201) MUST be set when tad_process() is called.
+ *
+ * @param scanline the scanline deadline (or @ref TAD_NO_TRANSFER_DEADLINE)
+ */
+void tad_setTransferDeadline(u16 scanline);
+
 /*!
  * @}
  */
@@ -472,6 +680,28 @@ void tad_setTransferSize(u16 transferSize);
  */
 bool tad_isLoaderActive(void);
 
+/*!
+ * The loader transfers the common audio data before the song data.
+ * The value returned by this function only covers the data item that is currently being transferred.
+ *
+ * The size of each data item is listed in the assembly file generated by `tad-compiler pv-export`.
+ *
+ * @return the number of bytes remaining in the current loader transfer (0 if the loader is inactive)
+ */
+u16 tad_getLoadBytesRemaining(void);
+
+/*!
+ * Estimates the number of frames required to finish the current loader transfer.
+ *
+ * The estimate assumes one tad_process() call per frame and is calculated using the current
+ * tad_setTransferSize() value.  It is an upper bound if a transfer deadline is set
+ * (see tad_setTransferDeadline()).
+ *
+ * @return the estimated number of tad_process() calls required to finish the current loader
+ *         transfer (0 if the loader is inactive)
+ */
+u16 tad_getLoadFramesRemaining(void);
+
 /*!
  * @return true if the song is loaded into audio-RAM (state is `PAUSED` or `PLAYING`)
  */
@@ -488,6 +718,25 @@ bool tad_isSfxPlaying(void);
  */
 bool tad_isSongPlaying(void);
 
+/*!
+ * Returns an estimate of the audio driver's spare processing time.
+ *
+ * The audio driver measures how long it takes to process the music and sound effect channels
+ * each tick.  The headroom is the number of 0.5ms timer counts left in the driver's tick budget
+ * (3.5ms) after the channels were processed, or 0 if the tick was at or over budget.
+ *
+ * A game can use the headroom to adapt to a busy audio driver (for example, by skipping
+ * low-priority sound effects when the headroom is 0 or 1).
+ *
+ * The headroom is measured whether or not the tick budget guard is enabled
+ * (see tad_enableTickBudget()).
+ *
+ * @return the smallest headroom of the last music tick (if the song is playing) and the last
+ *         sound effect tick (0 to 7).
+ *         7 if the song is not loaded or the audio driver is paused.
+ */
+u8 tad_getDriverHeadroom(void);
+
 /*!
  * @}
  */
@@ -508,6 +757,9 @@ bool tad_isSongPlaying(void);
  * After the `play_sound_effect` command (or when a song is loaded),
  * `tad_sfxQueue_sfx` and `tad_sfxQueue_pan` will be reset to $ff.
  *
+ * If the queue is empty, the oldest sound effect in the sound effect batch
+ * (see tad_batchPannedSoundEffect()) is sent instead.
+ *
  * In tad_queueSoundEffect() lower sound effect indexes take priority over
  * higher sound effect indexes (as defined by the project file sound effect
  * export order).
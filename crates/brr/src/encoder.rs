@@ -60,15 +60,11 @@ impl std::fmt::Display for EncodeError {
 }
 
 trait Scorer {
-    // BRR encoder will select the lowest scoring sample
+    // BRR encoder will select the lowest scoring sample.
+    //
+    // The score of a block is the sum of its sample scores.
+    // MUST NOT be negative (allows `build_block()` to stop once a block cannot be selected).
     fn score_sample(source: I15Sample, decoded: I15Sample, prev: (I15Sample, I15Sample)) -> i32;
-
-    // BRR encoder will select the lowest scoring block
-    fn score_block(
-        samples: &[I15Sample; SAMPLES_PER_BLOCK],
-        block: &BrrBlock,
-        prev: (I15Sample, I15Sample),
-    ) -> i64;
 }
 
 struct SquaredError {}
@@ -84,22 +80,6 @@ impl Scorer for SquaredError {
     fn score_sample(source: I15Sample, decoded: I15Sample, _prev: (I15Sample, I15Sample)) -> i32 {
         Self::sample_squared_error(source, decoded)
     }
-
-    fn score_block(
-        samples: &[I15Sample; SAMPLES_PER_BLOCK],
-        block: &BrrBlock,
-        _prev: (I15Sample, I15Sample),
-    ) -> i64 {
-        assert!(block.decoded_samples.len() == samples.len());
-
-        let mut square_error = 0;
-
-        for (b, s) in block.decoded_samples.iter().zip(samples) {
-            square_error += i64::from(Self::sample_squared_error(*b, *s));
-        }
-
-        square_error
-    }
 }
 
 struct SquaredErrorAvoidGaussianOverflow {}
@@ -123,27 +103,6 @@ impl Scorer for SquaredErrorAvoidGaussianOverflow {
         let delta = source.value() - decoded.value();
         delta * delta + penalty
     }
-
-    fn score_block(
-        samples: &[I15Sample; SAMPLES_PER_BLOCK],
-        block: &BrrBlock,
-        prev: (I15Sample, I15Sample),
-    ) -> i64 {
-        assert!(block.decoded_samples.len() == samples.len());
-
-        let mut error = 0;
-
-        let mut prev = prev;
-
-        for (s, b) in samples.iter().zip(block.decoded_samples) {
-            error += i64::from(Self::score_sample(*s, b, prev));
-
-            prev.1 = prev.0;
-            prev.0 = b;
-        }
-
-        error
-    }
 }
 
 struct BrrBlock {
@@ -154,104 +113,161 @@ struct BrrBlock {
     decoded_samples: [I15Sample; SAMPLES_PER_BLOCK],
 }
 
+type FilterFn = fn(I15Sample, I15Sample) -> i32;
+
+/// `v / (1 << shift)` (rounding towards 0 when `v` is negative) without a division
+#[inline]
+fn div_pow2_towards_zero(v: i32, shift: u8) -> i32 {
+    // Adding `2^shift - 1` to a negative `v` makes the arithmetic shift round towards 0
+    let bias = (v >> 31) & ((1 << shift) - 1);
+    (v + bias) >> shift
+}
+
+const ALL_FILTERS: [(BrrFilter, FilterFn); 4] = [
+    (BrrFilter::Filter0, filter0),
+    (BrrFilter::Filter1, filter1),
+    (BrrFilter::Filter2, filter2),
+    (BrrFilter::Filter3, filter3),
+];
+
+/// Returns the block and its score.
+///
+/// Returns None if the block's score is `>= max_score` (the block will not be selected).
+/// The block is abandoned as soon as its partial score reaches `max_score`.
 fn build_block<S: Scorer>(
     samples: &[I15Sample; SAMPLES_PER_BLOCK],
     shift: u8,
     filter: BrrFilter,
-    filter_fn: fn(I15Sample, I15Sample) -> i32,
+    filter_fn: FilterFn,
     prev1: I15Sample,
     prev2: I15Sample,
-) -> BrrBlock {
+    max_score: i64,
+) -> Option<(BrrBlock, i64)> {
     assert!(shift <= MAX_SHIFT);
 
     let mut nibbles = [0; SAMPLES_PER_BLOCK];
     let mut decoded_samples: [I15Sample; SAMPLES_PER_BLOCK] = Default::default();
 
-    let div: i32 = 1 << shift;
-
     let mut prev1 = prev1;
     let mut prev2 = prev2;
 
+    let mut score: i64 = 0;
+
     for (i, s) in samples.iter().enumerate() {
         let offset = filter_fn(prev1, prev2);
 
-        // Using division instead of `>> shift` to round towards 0 when s is negative
-        let n = (((s.value() - offset) << 1) / div).clamp(I4_MIN, I4_MAX);
+        let n = div_pow2_towards_zero((s.value() - offset) << 1, shift).clamp(I4_MIN, I4_MAX);
 
         // `n` might not be the best value for `s`.
-        // Use squared-error to determine if `n`, `n-1` or `n+1` is the better value to use
-        let (n, d) = (n - 1..=n + 1)
-            .filter(|n| (I4_MIN..=I4_MAX).contains(n))
-            .map(|n| {
-                // Decode nibble (no shift out-of-range test required)
-                let d = I15Sample::clamp_and_clip(((n << shift) >> 1) + offset);
-                (n, d)
-            })
-            .min_by_key(|(_, d)| S::score_sample(*s, *d, (prev1, prev2)))
-            .unwrap();
+        // Use the scorer to determine if `n`, `n-1` or `n+1` is the better value to use
+        // (the first lowest scoring value is selected)
+        let mut best_n = 0;
+        let mut best_d = I15Sample::default();
+        let mut best_score = i32::MAX;
+        let mut first = true;
+
+        for n in (n - 1).max(I4_MIN)..=(n + 1).min(I4_MAX) {
+            // Decode nibble (no shift out-of-range test required)
+            let d = I15Sample::clamp_and_clip(((n << shift) >> 1) + offset);
+            let score = S::score_sample(*s, d, (prev1, prev2));
+
+            if first || score < best_score {
+                best_n = n;
+                best_d = d;
+                best_score = score;
+                first = false;
+            }
+        }
+
+        score += i64::from(best_score);
+        if score >= max_score {
+            return None;
+        }
 
         prev2 = prev1;
-        prev1 = d;
+        prev1 = best_d;
 
-        nibbles[i] = n.try_into().unwrap();
-        decoded_samples[i] = d;
+        nibbles[i] = best_n.try_into().unwrap();
+        decoded_samples[i] = best_d;
     }
 
-    BrrBlock {
-        filter,
-        shift,
-        nibbles,
-        decoded_samples,
-    }
+    Some((
+        BrrBlock {
+            filter,
+            shift,
+            nibbles,
+            decoded_samples,
+        },
+        score,
+    ))
 }
 
-fn find_best_block<S: Scorer>(
+// Returns the first lowest scoring block
+//
+// `hint` is the filter and shift of a block that is likely to have a low score (the previous
+// block).  The hint is scored first and its score is used to abandon blocks early.
+// The hint does not change the selected block.
+fn find_best_block_with_filters<S: Scorer>(
     samples: &[I15Sample; SAMPLES_PER_BLOCK],
+    filters: &[(BrrFilter, FilterFn)],
+    hint: Option<(BrrFilter, u8)>,
     prev1: I15Sample,
     prev2: I15Sample,
 ) -> BrrBlock {
     let mut best_block = None;
     let mut best_block_score = i64::MAX;
 
-    let mut test_filter = |filter, filter_fn| {
-        for shift in 0..=MAX_SHIFT {
-            let block = build_block::<S>(samples, shift, filter, filter_fn, prev1, prev2);
+    if let Some((filter, shift)) = hint {
+        if let Some((_, filter_fn)) = filters.iter().find(|(f, _)| *f == filter) {
+            if let Some((_, score)) =
+                build_block::<S>(samples, shift, filter, *filter_fn, prev1, prev2, i64::MAX)
+            {
+                // +1 so a block with the same score before the hint is still selected
+                best_block_score = score + 1;
+            }
+        }
+    }
 
-            let score = S::score_block(samples, &block, (prev1, prev2));
-            if score < best_block_score {
+    for (filter, filter_fn) in filters {
+        for shift in 0..=MAX_SHIFT {
+            if let Some((block, score)) = build_block::<S>(
+                samples,
+                shift,
+                *filter,
+                *filter_fn,
+                prev1,
+                prev2,
+                best_block_score,
+            ) {
                 best_block = Some(block);
                 best_block_score = score;
             }
         }
-    };
-
-    test_filter(BrrFilter::Filter0, filter0);
-    test_filter(BrrFilter::Filter1, filter1);
-    test_filter(BrrFilter::Filter2, filter2);
-    test_filter(BrrFilter::Filter3, filter3);
+    }
 
     best_block.unwrap()
 }
 
+fn find_best_block<S: Scorer>(
+    samples: &[I15Sample; SAMPLES_PER_BLOCK],
+    hint: Option<(BrrFilter, u8)>,
+    prev1: I15Sample,
+    prev2: I15Sample,
+) -> BrrBlock {
+    find_best_block_with_filters::<S>(samples, &ALL_FILTERS, hint, prev1, prev2)
+}
+
 fn find_best_block_filter<S: Scorer>(
     samples: &[I15Sample; SAMPLES_PER_BLOCK],
     filter: BrrFilter,
+    hint: Option<(BrrFilter, u8)>,
     prev1: I15Sample,
     prev2: I15Sample,
 ) -> BrrBlock {
-    let test_filter = |filter, filter_fn| {
-        (0..=MAX_SHIFT)
-            .map(|shift| build_block::<S>(samples, shift, filter, filter_fn, prev1, prev2))
-            .min_by_key(|block| S::score_block(samples, block, (prev1, prev2)))
-            .unwrap()
-    };
+    let f = ALL_FILTERS[usize::from(filter.as_u8())];
+    debug_assert!(f.0 == filter);
 
-    match filter {
-        BrrFilter::Filter0 => test_filter(BrrFilter::Filter0, filter0),
-        BrrFilter::Filter1 => test_filter(BrrFilter::Filter1, filter1),
-        BrrFilter::Filter2 => test_filter(BrrFilter::Filter2, filter2),
-        BrrFilter::Filter3 => test_filter(BrrFilter::Filter3, filter3),
-    }
+    find_best_block_with_filters::<S>(samples, &[f], hint, prev1, prev2)
 }
 
 // Loop flag only set if end_flag is set.
@@ -343,6 +359,7 @@ fn encode_brr_with_scorer<S: Scorer>(
 
     let mut prev1 = I15Sample::default();
     let mut prev2 = I15Sample::default();
+    let mut hint = None;
 
     for (i, samples) in samples
         .chunks_exact(SAMPLES_PER_BLOCK)
@@ -355,20 +372,21 @@ fn encode_brr_with_scorer<S: Scorer>(
 
         let block = if i == 0 {
             // The first block always uses filter 0
-            find_best_block_filter::<S>(&samples, BrrFilter::Filter0, prev1, prev2)
+            find_best_block_filter::<S>(&samples, BrrFilter::Filter0, hint, prev1, prev2)
         } else if i == loop_block {
             match loop_filter {
-                None => find_best_block::<S>(&samples, prev1, prev2),
+                None => find_best_block::<S>(&samples, hint, prev1, prev2),
                 Some(loop_filter) => {
-                    find_best_block_filter::<S>(&samples, loop_filter, prev1, prev2)
+                    find_best_block_filter::<S>(&samples, loop_filter, hint, prev1, prev2)
                 }
             }
         } else {
-            find_best_block::<S>(&samples, prev1, prev2)
+            find_best_block::<S>(&samples, hint, prev1, prev2)
         };
 
         prev1 = block.decoded_samples[SAMPLES_PER_BLOCK - 1];
         prev2 = block.decoded_samples[SAMPLES_PER_BLOCK - 2];
+        hint = Some((block.filter, block.shift));
 
         brr_data.extend(encode_block(block, i == last_block_index, loop_flag));
     }
@@ -514,7 +532,7 @@ mod test_decoded_samples {
 
         for filter in ALL_FILTERS {
             let best_block =
-                find_best_block_filter::<SquaredError>(&i15_input, filter, i15_p1, i15_p2);
+                find_best_block_filter::<SquaredError>(&i15_input, filter, None, i15_p1, i15_p2);
             let brr_block_samples = best_block.decoded_samples.map(I15Sample::to_sample);
 
             let brr_block = encode_block(best_block, false, false);
@@ -560,3 +578,54 @@ mod test_decoded_samples {
         );
     }
 }
+
+#[cfg(test)]
+mod test_block_search {
+    use super::*;
+
+    #[test]
+    fn div_pow2_towards_zero_matches_division() {
+        for shift in 0..=MAX_SHIFT {
+            for v in (-0x20000..=0x20000).step_by(7) {
+                assert_eq!(div_pow2_towards_zero(v, shift), v / (1 << shift));
+            }
+        }
+    }
+
+    fn _test(p2: i16, p1: i16, input: [i16; 16]) {
+        let i15_input = input.map(I15Sample::from_sample);
+        let i15_p1 = I15Sample::from_sample(p1);
+        let i15_p2 = I15Sample::from_sample(p2);
+
+        let expected = find_best_block::<SquaredError>(&i15_input, None, i15_p1, i15_p2);
+        let expected = encode_block(expected, false, false);
+
+        for (filter, _) in ALL_FILTERS {
+            for shift in 0..=MAX_SHIFT {
+                let hint = Some((filter, shift));
+                let block = find_best_block::<SquaredError>(&i15_input, hint, i15_p1, i15_p2);
+
+                assert_eq!(
+                    encode_block(block, false, false),
+                    expected,
+                    "hint: {:?}",
+                    hint
+                );
+            }
+        }
+    }
+
+    /// Tests the hint does not change the selected block
+    #[test]
+    fn hint_does_not_change_block() {
+        #[rustfmt::skip]
+        _test(
+            -22011,
+            -11912,
+            [0, 11912, 22011, 28759, 31128, 28759, 22011, 11912, 0, -11912, -22011, -28759, -31128, -28759, -22011, -11912],
+        );
+
+        // A block with a lot of equally scored blocks
+        _test(0, 0, [0; 16]);
+    }
+}
@@ -71,17 +71,14 @@ struct FmtChunk {
     bits_per_sample: u16,
 }
 
-#[derive(Debug, Eq, PartialEq)]
-struct WaveFile {
-    format: FmtChunk,
-    data: Vec<u8>,
-}
-
 const WAVE_CHUNK_ID: [u8; 4] = [b'R', b'I', b'F', b'F'];
 const WAVE_ID: [u8; 4] = [b'W', b'A', b'V', b'E'];
 const FMT_CHUNK_ID: [u8; 4] = [b'f', b'm', b't', b' '];
 const DATA_CHUNK_ID: [u8; 4] = [b'd', b'a', b't', b'a'];
 
+/// Size of the buffer used to convert the data chunk to samples
+const DECODE_BUFFER_SIZE: usize = 4096;
+
 fn parse_fmt_chunk(data: &[u8]) -> Result<FmtChunk, WavError> {
     // There are different versions of fmt chunk.
     if data.len() < 16 {
@@ -116,10 +113,8 @@ fn read_four_bytes(reader: &mut impl io::Read) -> io::Result<[u8; 4]> {
     Ok(data)
 }
 
-fn read_wave_file(
-    reader: &mut (impl io::Read + io::Seek),
-    max_data_size: usize,
-) -> Result<WaveFile, WavError> {
+/// Reads the RIFF header and the fmt chunk.
+fn read_wave_header(reader: &mut impl io::Read) -> Result<FmtChunk, WavError> {
     if read_four_bytes(reader)? != WAVE_CHUNK_ID {
         return Err(WavError::NotAWaveFile);
     }
@@ -131,28 +126,37 @@ fn read_wave_file(
     }
 
     // fmt chunk is always after WAVE chunk
-    let format = {
-        let chunk_id = read_four_bytes(reader)?;
-        let chunk_size = u32::from_le_bytes(read_four_bytes(reader)?);
+    let chunk_id = read_four_bytes(reader)?;
+    let chunk_size = u32::from_le_bytes(read_four_bytes(reader)?);
 
-        if chunk_id != FMT_CHUNK_ID {
-            return Err(WavError::InvalidWaveFile);
-        }
+    if chunk_id != FMT_CHUNK_ID {
+        return Err(WavError::InvalidWaveFile);
+    }
 
-        // This should not happen
-        if chunk_size >= 100 {
-            return Err(WavError::InvalidWaveFile);
-        }
+    // This should not happen
+    if chunk_size >= 100 {
+        return Err(WavError::InvalidWaveFile);
+    }
 
-        let chunk_data = {
-            let mut v = vec![0; chunk_size.try_into().unwrap()];
-            reader.read_exact(&mut v)?;
-            v
-        };
-        parse_fmt_chunk(chunk_data.as_slice())?
+    let chunk_data = {
+        let mut v = vec![0; chunk_size.try_into().unwrap()];
+        reader.read_exact(&mut v)?;
+        v
     };
+    parse_fmt_chunk(chunk_data.as_slice())
+}
 
-    let mut data = Vec::new();
+/// Reads the chunks after the fmt chunk, calling `process_data` with the reader and chunk size
+/// of every data chunk.
+///
+/// `process_data` must read the entire chunk.
+/// Unknown chunks are skipped without reading them.
+fn read_data_chunks<R: io::Read + io::Seek>(
+    reader: &mut R,
+    max_data_size: usize,
+    mut process_data: impl FnMut(&mut R, usize) -> Result<(), WavError>,
+) -> Result<(), WavError> {
+    let mut data_size: usize = 0;
 
     loop {
         let mut chunk_id = [0; 4];
@@ -171,15 +175,14 @@ fn read_wave_file(
 
         match chunk_id {
             DATA_CHUNK_ID => {
-                let start = data.len();
                 let chunk_size = usize::try_from(chunk_size).unwrap();
 
-                if data.len() + chunk_size > max_data_size {
+                if data_size + chunk_size > max_data_size {
                     return Err(WavError::WaveFileTooLarge);
                 }
+                data_size += chunk_size;
 
-                data.resize(data.len() + chunk_size, 0);
-                reader.read_exact(&mut data[start..])?;
+                process_data(reader, chunk_size)?;
             }
 
             FMT_CHUNK_ID => {
@@ -194,64 +197,65 @@ fn read_wave_file(
         }
     }
 
-    if data.is_empty() {
+    if data_size == 0 {
         return Err(WavError::NoSamples);
     }
 
-    Ok(WaveFile { format, data })
+    Ok(())
 }
 
-fn decode_16_bit(wav: WaveFile) -> Result<MonoPcm16WaveFile, WavError> {
-    if wav.data.len() % 2 != 0 {
-        return Err(WavError::InvaidDataChunkSize);
-    }
-
-    // Convert data to i16 vector
-    let mut samples = Vec::with_capacity(wav.data.len() / 2);
-
-    samples.extend(
-        wav.data
-            .chunks_exact(2)
-            .map(|c| i16::from_le_bytes([c[0], c[1]])),
-    );
-
-    Ok(MonoPcm16WaveFile {
-        sample_rate: wav.format.samples_per_second,
-        samples,
-    })
+#[derive(Clone, Copy)]
+enum SampleFormat {
+    Unsigned8,
+    Signed16,
 }
 
-fn decode_8_bit(wav: WaveFile) -> Result<MonoPcm16WaveFile, WavError> {
-    // Convert data to i16 vector
-
-    let samples = wav
-        .data
-        .iter()
-        .map(|s| (i16::from(*s) - 128) << 8)
-        .collect();
+impl SampleFormat {
+    const fn bytes_per_sample(self) -> usize {
+        match self {
+            Self::Unsigned8 => 1,
+            Self::Signed16 => 2,
+        }
+    }
 
-    Ok(MonoPcm16WaveFile {
-        sample_rate: wav.format.samples_per_second,
-        samples,
-    })
+    /// Converts `data` to samples.
+    ///
+    /// A 16-bit sample can be split across data chunks, `partial` holds the first byte of a
+    /// sample that continues in the next block of `data`.
+    fn decode(self, data: &[u8], partial: &mut Option<u8>, out: &mut Vec<i16>) {
+        match self {
+            Self::Unsigned8 => out.extend(data.iter().map(|s| (i16::from(*s) - 128) << 8)),
+            Self::Signed16 => {
+                let data = match (partial.take(), data.split_first()) {
+                    (Some(low), Some((&high, rest))) => {
+                        out.push(i16::from_le_bytes([low, high]));
+                        rest
+                    }
+                    (p, _) => {
+                        *partial = p;
+                        data
+                    }
+                };
+
+                let chunks = data.chunks_exact(2);
+                if let Some(&low) = chunks.remainder().first() {
+                    *partial = Some(low);
+                }
+                out.extend(chunks.map(|c| i16::from_le_bytes([c[0], c[1]])));
+            }
+        }
+    }
 }
 
-pub fn read_mono_pcm_wave_file(
-    reader: &mut (impl io::Read + io::Seek),
-    max_samples: usize,
-) -> Result<MonoPcm16WaveFile, WavError> {
-    let wav = read_wave_file(reader, max_samples * 2)?;
-
-    let fmt = &wav.format;
-
+fn sample_format(fmt: &FmtChunk) -> Result<SampleFormat, WavError> {
     if fmt.format_tag != WAV_FORMAT_PCM_FORMAT {
         Err(WavError::NotAPcmWaveFile)
     } else if fmt.block_align != fmt.n_channels * fmt.bits_per_sample / 8 {
         Err(WavError::InvalidBlockAlign)
     } else {
         match (fmt.bits_per_sample, fmt.n_channels) {
-            (16, 1) => decode_16_bit(wav),
-            (8, 1) => decode_8_bit(wav),
+            (16, 1) => Ok(SampleFormat::Signed16),
+            (8, 1) => Ok(SampleFormat::Unsigned8),
             (16, _) => Err(WavError::NotAMonoWavFile),
             (8, _) => Err(WavError::NotAMonoWavFile),
             (_, _) => Err(WavError::Not8Or16BitPcmWav),
@@ -259,10 +263,91 @@ pub fn read_mono_pcm_wave_file(
     }
 }
 
+/// Converts a data chunk to samples without buffering the entire chunk.
+fn decode_data_chunk(
+    reader: &mut impl io::Read,
+    chunk_size: usize,
+    format: SampleFormat,
+    partial: &mut Option<u8>,
+    samples: &mut Vec<i16>,
+) -> Result<(), WavError> {
+    samples.reserve(chunk_size / format.bytes_per_sample());
+
+    let mut buffer = [0; DECODE_BUFFER_SIZE];
+    let mut remaining = chunk_size;
+
+    while remaining > 0 {
+        let buf = &mut buffer[..remaining.min(DECODE_BUFFER_SIZE)];
+        reader.read_exact(buf)?;
+        format.decode(buf, partial, samples);
+
+        remaining -= buf.len();
+    }
+
+    Ok(())
+}
+
+/// Reads a mono 8 or 16 bit PCM wave file.
+///
+/// The data chunks are converted to samples as they are read, the file is not buffered in
+/// memory.
+/// The format is validated before any samples are read.
+///
+/// For best performance `reader` should be buffered.
+pub fn read_mono_pcm_wave_file(
+    reader: &mut (impl io::Read + io::Seek),
+    max_samples: usize,
+) -> Result<MonoPcm16WaveFile, WavError> {
+    let fmt = read_wave_header(reader)?;
+    let format = sample_format(&fmt)?;
+
+    let mut samples = Vec::new();
+    let mut partial = None;
+
+    read_data_chunks(
+        reader,
+        max_samples * format.bytes_per_sample(),
+        |r, chunk_size| decode_data_chunk(r, chunk_size, format, &mut partial, &mut samples),
+    )?;
+
+    // The total data size must be a multiple of the sample size, not the size of each chunk
+    if partial.is_some() {
+        return Err(WavError::InvaidDataChunkSize);
+    }
+
+    Ok(MonoPcm16WaveFile {
+        sample_rate: fmt.samples_per_second,
+        samples,
+    })
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
 
+    #[derive(Debug, Eq, PartialEq)]
+    struct WaveFile {
+        format: FmtChunk,
+        data: Vec<u8>,
+    }
+
+    fn read_wave_file(
+        reader: &mut (impl io::Read + io::Seek),
+        max_data_size: usize,
+    ) -> Result<WaveFile, WavError> {
+        let format = read_wave_header(reader)?;
+
+        let mut data = Vec::new();
+        read_data_chunks(reader, max_data_size, |r, chunk_size| {
+            let start = data.len();
+            data.resize(start + chunk_size, 0);
+            r.read_exact(&mut data[start..])?;
+            Ok(())
+        })?;
+
+        Ok(WaveFile { format, data })
+    }
+
     // 96000Hz, 32-bit stereo PCM wave file (1 sample of silence)
     // Created with audacity
     const STEREO_96000_32_BIT_PCM: [u8; 52] = [
@@ -424,6 +509,45 @@ mod tests {
         assert!(matches!(r, Err(WavError::WaveFileTooLarge)));
     }
 
+    /// `MONO_32000_16_BIT_PCM` with the samples split into data chunks of `chunk_sizes` bytes
+    fn split_16_bit_data_chunks(chunk_sizes: &[usize]) -> Vec<u8> {
+        const HEADER_SIZE: usize = 36;
+
+        let mut samples = &MONO_32000_16_BIT_PCM[HEADER_SIZE + 8..];
+        let mut wave = MONO_32000_16_BIT_PCM[..HEADER_SIZE].to_vec();
+
+        for &size in chunk_sizes {
+            let (chunk, rest) = samples.split_at(size);
+            wave.extend(DATA_CHUNK_ID);
+            wave.extend(u32::try_from(size).unwrap().to_le_bytes());
+            wave.extend(chunk);
+            samples = rest;
+        }
+        wave
+    }
+
+    #[test]
+    fn test_16_bit_sample_split_across_data_chunks() {
+        let wave = split_16_bit_data_chunks(&[7, 13]);
+
+        let wav = read_mono_pcm_wave_file(&mut io::Cursor::new(wave), 100).unwrap();
+
+        assert!(
+            wav == MonoPcm16WaveFile {
+                sample_rate: 32000,
+                samples: MONO_32000_16_BIT_SAMPLES.to_vec(),
+            }
+        );
+    }
+
+    #[test]
+    fn test_16_bit_odd_data_size() {
+        let wave = split_16_bit_data_chunks(&[8, 11]);
+
+        let r = read_mono_pcm_wave_file(&mut io::Cursor::new(wave), 100);
+        assert!(matches!(r, Err(WavError::InvaidDataChunkSize)));
+    }
+
     #[test]
     fn test_read_8_bit_mono_wave_file() {
         let wav = read_mono_pcm_wave_file(&mut io::Cursor::new(MONO_32000_8_BIT_PCM), 100).unwrap();
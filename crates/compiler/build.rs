@@ -25,11 +25,29 @@ const IO_COMMANDS_FILE: &str = "io-commands.wiz";
 const IO_COMMANDS_VERSION_REGEX: &str = r"\nlet TAD_IO_VERSION = ([0-9]+);";
 const TAD_IO_VERSION: &str = "TAD_IO_VERSION";
 
+/// The S-CPU APIs that declare a `TAD_IO_VERSION` constant (relative to the audio driver source)
+const API_IO_VERSION_FILES: &[(&str, &str)] = &[
+    (
+        "../ca65-api/tad-audio.s",
+        r"\n\.export TAD_IO_VERSION : abs = ([0-9]+)\n",
+    ),
+    (
+        "../64tass-api/tad-process.inc",
+        r"\nTAD_IO_VERSION = ([0-9]+)\n",
+    ),
+];
+
+/// The first symbol of the audio driver binary
+const DRIVER_CODE_SYMBOL: &str = "main";
+
 #[rustfmt::skip]
 const AUDIO_DRIVER_SYMBOLS: &[(&str, &str)] = &[
     ("main", "DRIVER_CODE"),
     ("mainloop", "MAINLOOP_CODE"),
     ("process_music_channels", "PROCESS_MUSIC_CHANNELS_CODE"),
+    ("process_bytecode", "PROCESS_BYTECODE_CODE"),
+    ("process_next_bytecode", "PROCESS_NEXT_BYTECODE_CODE"),
+    ("instructionPtr", "INSTRUCTION_PTR"),
     ("__loader_songPtr", "SONG_PTR"),
     ("__loader_dataType", "LOADER_DATA_TYPE"),
     ("songTickCounter", "SONG_TICK_COUNTER"),
@@ -40,9 +58,11 @@ const AUDIO_DRIVER_SYMBOLS: &[(&str, &str)] = &[
     ("eonShadow_music", "EON_SHADOW_MUSIC"),
     ("eonShadow_sfx", "EON_SHADOW_SFX"),
     ("io_musicChannelsMask", "IO_MUSIC_CHANNELS_MASK"),
+    ("maxTimerCounter", "MAX_TIMER_COUNTER"),
     ("__bcStack", "BYTECODE_STACK"),
 
     ("voiceChannelsDirty_music", "VOICE_CHANNELS_DIRTY_MUSIC"),
+    ("activeMusicChannels", "ACTIVE_MUSIC_CHANNELS"),
     ("channelSoA.virtualChannels.vol_l", "CHANNEL_VC_VOL_L"),
     ("channelSoA.virtualChannels.vol_r", "CHANNEL_VC_VOL_R"),
     ("channelSoA.virtualChannels.pitch_l", "CHANNEL_VC_PITCH_L"),
@@ -185,6 +205,35 @@ fn read_tad_io_version(audio_driver_dir: &Path) -> usize {
     }
 }
 
+/// Confirms every S-CPU API has been updated to the current IO version
+fn check_api_io_versions(audio_driver_dir: &Path, tad_io_version: usize) {
+    for (file, regex) in API_IO_VERSION_FILES {
+        let path = audio_driver_dir.join(file);
+
+        let api = match fs::read_to_string(&path) {
+            Ok(s) => s,
+            Err(e) => panic!("Error reading file {}: {}", path.display(), e),
+        };
+
+        let re = Regex::new(regex).unwrap();
+
+        let api_version: usize = match re.captures(&api) {
+            Some(c) => c[1].parse().unwrap(),
+            None => panic!(
+                "Could not find {TAD_IO_VERSION} const in {}.",
+                path.display()
+            ),
+        };
+
+        if api_version != tad_io_version {
+            panic!(
+                "{TAD_IO_VERSION} mismatch: {} is {api_version}, {IO_COMMANDS_FILE} is {tad_io_version}",
+                path.display()
+            );
+        }
+    }
+}
+
 fn build_rust_consts(
     symbols: Symbols,
     const_list: &[(&str, &str)],
@@ -211,6 +260,34 @@ fn build_rust_consts(
     out
 }
 
+/// Builds a table of every symbol inside the audio driver code, sorted by address
+fn build_code_symbols_table(symbols: &Symbols, code_start: &str, code_size: usize) -> String {
+    let start = symbols.get(code_start);
+    let end = usize::from(start) + code_size;
+
+    let mut code_symbols: Vec<(u16, &str)> = symbols
+        .symbols
+        .iter()
+        .map(|(name, addr)| (*addr, *name))
+        .filter(|(addr, _)| *addr >= start && usize::from(*addr) < end)
+        .collect();
+    code_symbols.sort();
+
+    let mut out = String::new();
+
+    writeln!(
+        out,
+        "pub(crate) const DRIVER_CODE_SYMBOLS : &[(u16, &str)] = &["
+    )
+    .unwrap();
+    for (addr, name) in code_symbols {
+        writeln!(out, "    (0x{:x}, {:?}),", addr, name).unwrap();
+    }
+    writeln!(out, "];").unwrap();
+
+    out
+}
+
 struct AudioDriverCompiler {
     audio_driver_dir: PathBuf,
     out_dir: PathBuf,
@@ -234,6 +311,15 @@ impl AudioDriverCompiler {
         }
     }
 
+    fn binary_size(&self, name: &OsStr) -> usize {
+        let bin_path = self.out_dir.join(name).with_extension("bin");
+
+        match fs::metadata(&bin_path) {
+            Ok(m) => m.len().try_into().unwrap(),
+            Err(e) => panic!("Error reading binary {}: {}", bin_path.display(), e),
+        }
+    }
+
     fn load_sym_file(&self, name: &OsStr) -> String {
         let sym_path = self.out_dir.join(name).with_extension("sym");
 
@@ -262,6 +348,7 @@ fn main() {
     let driver_symbols = read_symbol_file("audio-driver", &driver_sym_file);
 
     let tad_io_version = read_tad_io_version(&wiz.audio_driver_dir);
+    check_api_io_versions(&wiz.audio_driver_dir, tad_io_version);
 
     // confirm common variables are the same in the loader and driver
     for label in COMMON_SYMBOLS {
@@ -275,11 +362,19 @@ fn main() {
     // Generate symbols.rs
     let symbols_rs_path = wiz.out_dir.join("symbols.rs");
 
+    let code_symbols = build_code_symbols_table(
+        &driver_symbols,
+        DRIVER_CODE_SYMBOL,
+        wiz.binary_size(AUDIO_DRIVER.as_ref()),
+    );
+
     let rust_symbol_consts = [
         "// autogenerated by build.rs\n\n",
         &format!("pub(crate) const {TAD_IO_VERSION} : usize = {tad_io_version};\n\n"),
         &build_rust_consts(loader_symbols, LOADER_SYMBOLS, "_LAST_LOADER_SYMBOL"),
         &build_rust_consts(driver_symbols, AUDIO_DRIVER_SYMBOLS, "_LAST_DRIVER_SYMBOL"),
+        "\n",
+        &code_symbols,
     ]
     .concat();
 
@@ -287,4 +382,10 @@ fn main() {
 
     println!("cargo:rerun-if-changed=build.rs");
     println!("cargo:rerun-if-changed={}", wiz.audio_driver_dir.display());
+    for (file, _) in API_IO_VERSION_FILES {
+        println!(
+            "cargo:rerun-if-changed={}",
+            wiz.audio_driver_dir.join(file).display()
+        );
+    }
 }
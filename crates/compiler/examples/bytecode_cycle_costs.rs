@@ -0,0 +1,534 @@
+//! Bytecode instruction S-SMP cycle costs
+//!
+//! Plays every song of one or more projects, single-stepping the S-SMP through every music tick,
+//! and measures the S-SMP cycles each bytecode instruction costs in the audio driver.
+//!
+//! The cycles of a music tick (`process_music_channels()`) are split into:
+//!  * instructions: the cycles between the end of the bytecode dispatch and the next dispatch
+//!    (or the end of `process_bytecode()`), grouped by opcode (every play-note opcode is
+//!    grouped into a single `play_note` row).
+//!  * dispatch: the cycles spent in `process_bytecode()` and `process_next_bytecode()`
+//!    (reading the opcode and jumping to the instruction), per instruction.
+//!  * channel overhead: the rest of the tick (S-DSP writes, pitch/volume/pan effects and the
+//!    channel loop), per music channel.
+//!
+//! Prints a table by default, `--csv` prints a CSV file and `--rust` prints a table of Rust
+//! constants that the compiler can embed.
+//!
+//! `--baseline FILE` compares the results with a CSV file created by a previous `--csv` run
+//! (with the same projects) and exits with an error if the maximum cycles of any instruction,
+//! the dispatch or the channel overhead increased (an audio driver performance regression).
+//!
+//! The measured music ticks are also compared with the compiler's `estimate_tick_costs()`
+//! (the table output includes the number of ticks it underestimated).
+//!
+//! This is an example and not a test as it requires project files.
+//!
+//! Run with `cargo run --release --example bytecode_cycle_costs -- [--csv | --rust] [--baseline FILE] PROJECT_FILE...`.
+
+mod common;
+
+use compiler::{
+    common_audio_data::{build_common_audio_data, CommonAudioData},
+    data::{load_project_file, load_text_file_with_limit, validate_project_file_names},
+    driver_constants::{addresses, driver_code_symbol, LoaderDataType, N_MUSIC_CHANNELS},
+    mml::compile_mml,
+    opcodes::FIRST_PLAY_NOTE_INSTRUCTION,
+    samples::build_sample_and_instrument_data,
+    songs::SongData,
+    sound_effects::{blank_compiled_sound_effects, CompiledSfxSubroutines},
+    tick_cost::{estimate_tick_costs, smp_clocks_to_cycles, TickStep, TickTracker},
+};
+use shvc_sound_emu::ShvcSoundEmu;
+
+use std::collections::BTreeMap;
+use std::fmt::Write;
+use std::path::PathBuf;
+
+/// Number of seconds to play each song for
+const SECONDS_PER_SONG: u64 = 60;
+
+/// The driver functions that read and dispatch the bytecode instructions
+const DISPATCH_SYMBOLS: [&str; 2] = ["process_bytecode", "process_next_bytecode"];
+
+const DISPATCH_ROW: &str = "dispatch";
+const CHANNEL_OVERHEAD_ROW: &str = "channel_overhead";
+
+#[derive(Clone, Copy, Default)]
+struct Stats {
+    count: u64,
+    min: u64,
+    max: u64,
+    total: u64,
+}
+
+impl Stats {
+    fn add(&mut self, cycles: u64) {
+        if self.count == 0 || cycles < self.min {
+            self.min = cycles;
+        }
+        self.max = self.max.max(cycles);
+        self.total += cycles;
+        self.count += 1;
+    }
+
+    fn mean(&self) -> u64 {
+        self.total.checked_div(self.count).unwrap_or(0)
+    }
+}
+
+#[derive(Default)]
+struct CycleCosts {
+    ticks: u64,
+    /// Indexed by opcode (play-note instructions use `FIRST_PLAY_NOTE_INSTRUCTION`)
+    instructions: BTreeMap<u8, (&'static str, Stats)>,
+    dispatch: Stats,
+    channel_overhead: Stats,
+
+    /// Number of music ticks compared with `estimate_tick_costs()`
+    estimated_ticks: u64,
+    /// Number of music ticks that used more cycles than `estimate_tick_costs()` estimated
+    underestimated_ticks: u64,
+}
+
+enum OutputFormat {
+    Table,
+    Csv,
+    Rust,
+}
+
+struct Args {
+    format: OutputFormat,
+    baseline: Option<PathBuf>,
+    project_files: Vec<PathBuf>,
+}
+
+fn parse_args() -> Args {
+    let mut args = Args {
+        format: OutputFormat::Table,
+        baseline: None,
+        project_files: Vec::new(),
+    };
+
+    let mut it = std::env::args_os().skip(1);
+    while let Some(a) = it.next() {
+        match a.to_str() {
+            Some("--csv") => args.format = OutputFormat::Csv,
+            Some("--rust") => args.format = OutputFormat::Rust,
+            Some("--baseline") => {
+                args.baseline = Some(PathBuf::from(
+                    it.next().expect("--baseline expects a CSV file"),
+                ));
+            }
+            _ => args.project_files.push(PathBuf::from(a)),
+        }
+    }
+
+    if args.project_files.is_empty() {
+        panic!("Expected at least one project file");
+    }
+
+    args
+}
+
+fn load_song(common_audio_data: &CommonAudioData, song: &SongData) -> ShvcSoundEmu {
+    common::boot_song(
+        common_audio_data,
+        song,
+        &LoaderDataType {
+            stereo_flag: true,
+            play_song: true,
+            skip_echo_buffer_reset: false,
+            tick_budget: false,
+        },
+    )
+}
+
+fn is_dispatch(pc: u16) -> bool {
+    matches!(driver_code_symbol(pc), Some((name, _)) if DISPATCH_SYMBOLS.contains(&name))
+}
+
+/// Steps `emu` one instruction at a time until `process_music_channels()` returns.
+///
+/// Returns the number of S-SMP clocks emulated or `None` if the tick did not end.
+///
+/// ASSUMES: the program counter is `addresses::PROCESS_MUSIC_CHANNELS_CODE`
+fn measure_tick(emu: &mut ShvcSoundEmu, costs: &mut CycleCosts) -> Option<u64> {
+    // The instruction that is being processed
+    struct Current {
+        opcode: u8,
+        name: Option<&'static str>,
+        clocks: u64,
+    }
+
+    let mut tracker = TickTracker::new(emu.smp_registers().sp);
+
+    // true if the previous instruction was in `process_bytecode()`
+    let mut in_bytecode = false;
+    let mut current: Option<Current> = None;
+    let mut dispatch_clocks = 0;
+
+    let end_instruction = |current: &mut Option<Current>, costs: &mut CycleCosts| {
+        if let Some(c) = current.take() {
+            let name = c.name.unwrap_or("(unknown)");
+            let e = costs
+                .instructions
+                .entry(c.opcode)
+                .or_insert((name, Stats::default()));
+            e.1.add(smp_clocks_to_cycles(c.clocks));
+        }
+    };
+
+    loop {
+        let r = emu.smp_registers();
+
+        let bytecode = match tracker.next_instruction(r.pc, r.sp, r.x) {
+            TickStep::Ended => break,
+            TickStep::TimedOut => return None,
+            TickStep::ChannelOverhead => false,
+            TickStep::Bytecode { .. } => true,
+        };
+
+        if in_bytecode && !bytecode {
+            end_instruction(&mut current, costs);
+        }
+        in_bytecode = bytecode;
+
+        let dispatch = bytecode && is_dispatch(r.pc);
+
+        if dispatch && r.pc == addresses::PROCESS_NEXT_BYTECODE_CODE {
+            end_instruction(&mut current, costs);
+
+            let apuram = emu.apuram();
+            let ip = usize::from(addresses::INSTRUCTION_PTR);
+            let ip = u16::from_le_bytes([apuram[ip], apuram[ip + 1]]);
+            let opcode = apuram[usize::from(ip)].min(FIRST_PLAY_NOTE_INSTRUCTION);
+
+            current = Some(Current {
+                opcode,
+                name: None,
+                clocks: 0,
+            });
+        }
+
+        // Executes a single instruction
+        let c = emu.fast_forward(1);
+        tracker.add_clocks(c);
+
+        match (bytecode, &mut current) {
+            (false, _) => (),
+            (true, _) if dispatch => dispatch_clocks += c,
+            (true, Some(cur)) => {
+                if cur.name.is_none() {
+                    costs.dispatch.add(smp_clocks_to_cycles(dispatch_clocks));
+                    dispatch_clocks = 0;
+
+                    // The first driver function after the dispatch is the instruction
+                    cur.name = driver_code_symbol(r.pc)
+                        .map(|(name, _)| name.strip_prefix("bytecode.").unwrap_or(name));
+                }
+                cur.clocks += c;
+            }
+            (true, None) => dispatch_clocks += c,
+        }
+
+        if !bytecode && dispatch_clocks > 0 {
+            costs.dispatch.add(smp_clocks_to_cycles(dispatch_clocks));
+            dispatch_clocks = 0;
+        }
+    }
+
+    end_instruction(&mut current, costs);
+
+    costs.ticks += 1;
+    costs
+        .channel_overhead
+        .add(smp_clocks_to_cycles(tracker.overhead_smp_clocks()) / N_MUSIC_CHANNELS as u64);
+
+    Some(tracker.smp_clocks())
+}
+
+fn measure_song(common_audio_data: &CommonAudioData, song: &SongData, costs: &mut CycleCosts) {
+    let mut emu = load_song(common_audio_data, song);
+
+    let estimate = estimate_tick_costs(common_audio_data, song).expect("estimate timeout");
+
+    let end_clock = SECONDS_PER_SONG * ShvcSoundEmu::SMP_CLOCKS_PER_SECOND;
+    let mut smp_clock = 0;
+
+    while smp_clock < end_clock {
+        let r = emu.run_until_pc(
+            addresses::PROCESS_MUSIC_CHANNELS_CODE,
+            end_clock - smp_clock,
+        );
+        smp_clock += r.smp_clocks;
+        if !r.hit {
+            break;
+        }
+
+        let song_tick_counter = {
+            let a = usize::from(addresses::SONG_TICK_COUNTER);
+            u16::from_le_bytes([emu.apuram()[a], emu.apuram()[a + 1]])
+        };
+
+        match measure_tick(&mut emu, costs) {
+            Some(c) => {
+                smp_clock += c;
+
+                if let Some(&e) = estimate.cycles.get(usize::from(song_tick_counter)) {
+                    costs.estimated_ticks += 1;
+                    if smp_clocks_to_cycles(c) > u64::from(e) {
+                        costs.underestimated_ticks += 1;
+                    }
+                }
+            }
+            None => panic!("music tick did not end"),
+        }
+    }
+}
+
+fn measure_project(pf_path: &PathBuf, costs: &mut CycleCosts) {
+    let project = load_project_file(pf_path).unwrap();
+    let project = validate_project_file_names(project).unwrap();
+
+    let samples = build_sample_and_instrument_data(&project).unwrap();
+
+    let sfx_subs = CompiledSfxSubroutines::blank();
+    let sfx = blank_compiled_sound_effects();
+
+    let common_audio_data = build_common_audio_data(&samples, &sfx_subs, &sfx).unwrap();
+
+    for song in project.songs.list() {
+        eprintln!("Measuring song: {}", song.name);
+
+        let mml_file = load_text_file_with_limit(&song.source, &project.parent_path).unwrap();
+
+        let song_data = compile_mml(
+            &mml_file,
+            Some(song.name.clone()),
+            &project.instruments_and_samples,
+            samples.pitch_table(),
+        )
+        .unwrap();
+
+        measure_song(&common_audio_data, &song_data, costs);
+    }
+}
+
+/// Returns (row key, name, stats) for each row of the output
+fn rows(costs: &CycleCosts) -> Vec<(String, &'static str, Stats)> {
+    let mut out = vec![
+        (DISPATCH_ROW.to_owned(), "(per instruction)", costs.dispatch),
+        (
+            CHANNEL_OVERHEAD_ROW.to_owned(),
+            "(per channel per tick)",
+            costs.channel_overhead,
+        ),
+    ];
+    out.extend(
+        costs
+            .instructions
+            .iter()
+            .map(|(opcode, (name, stats))| (format!("0x{opcode:02x}"), *name, *stats)),
+    );
+    out
+}
+
+fn table(costs: &CycleCosts) -> String {
+    let mut out = String::new();
+
+    writeln!(
+        out,
+        "S-SMP cycles per bytecode instruction ({} music ticks)",
+        costs.ticks
+    )
+    .unwrap();
+    writeln!(
+        out,
+        "estimate_tick_costs() underestimated {} of {} music ticks",
+        costs.underestimated_ticks, costs.estimated_ticks
+    )
+    .unwrap();
+    writeln!(out).unwrap();
+    writeln!(
+        out,
+        "{:>16} {:>10} {:>6} {:>6} {:>6}  name",
+        "opcode", "count", "min", "max", "mean"
+    )
+    .unwrap();
+
+    for (key, name, s) in rows(costs) {
+        writeln!(
+            out,
+            "{key:>16} {:>10} {:>6} {:>6} {:>6}  {name}",
+            s.count,
+            s.min,
+            s.max,
+            s.mean()
+        )
+        .unwrap();
+    }
+
+    out
+}
+
+fn csv(costs: &CycleCosts) -> String {
+    let mut out = String::new();
+
+    writeln!(out, "opcode,name,count,min,max,mean").unwrap();
+    for (key, name, s) in rows(costs) {
+        writeln!(
+            out,
+            "{key},{name},{},{},{},{}",
+            s.count,
+            s.min,
+            s.max,
+            s.mean()
+        )
+        .unwrap();
+    }
+
+    out
+}
+
+fn rust_consts(costs: &CycleCosts) -> String {
+    let mut out = String::new();
+
+    writeln!(out, "//! Audio driver S-SMP cycle costs").unwrap();
+    writeln!(out, "//!").unwrap();
+    writeln!(
+        out,
+        "//! Regenerate with `cargo run --release --example bytecode_cycle_costs -- --rust PROJECT_FILE...`"
+    )
+    .unwrap();
+    writeln!(out, "//! whenever the audio driver changes.").unwrap();
+    writeln!(out).unwrap();
+
+    let stats = |s: &Stats| format!("({}, {}, {})", s.min, s.max, s.mean());
+
+    writeln!(
+        out,
+        "/// Bytecode dispatch S-SMP cycles per instruction (min, max, mean)"
+    )
+    .unwrap();
+    writeln!(
+        out,
+        "pub const BC_DISPATCH_CYCLES: (u32, u32, u32) = {};",
+        stats(&costs.dispatch)
+    )
+    .unwrap();
+    writeln!(out).unwrap();
+
+    writeln!(
+        out,
+        "/// S-SMP cycles per music channel per tick, excluding bytecode (min, max, mean)"
+    )
+    .unwrap();
+    writeln!(
+        out,
+        "pub const BC_CHANNEL_OVERHEAD_CYCLES: (u32, u32, u32) = {};",
+        stats(&costs.channel_overhead)
+    )
+    .unwrap();
+    writeln!(out).unwrap();
+
+    let unknown = costs
+        .instructions
+        .values()
+        .map(|(_, s)| s.max)
+        .max()
+        .unwrap_or(0);
+    writeln!(
+        out,
+        "/// S-SMP cycles of an instruction that is not in `BC_INSTRUCTION_CYCLES` (the maximum of all instructions)"
+    )
+    .unwrap();
+    writeln!(
+        out,
+        "pub const BC_UNKNOWN_INSTRUCTION_CYCLES: u32 = {unknown};"
+    )
+    .unwrap();
+    writeln!(out).unwrap();
+
+    writeln!(
+        out,
+        "/// S-SMP cycles per bytecode instruction, excluding dispatch (opcode, min, max, mean)"
+    )
+    .unwrap();
+    writeln!(
+        out,
+        "/// (play-note instructions use `FIRST_PLAY_NOTE_INSTRUCTION`)"
+    )
+    .unwrap();
+    writeln!(
+        out,
+        "pub const BC_INSTRUCTION_CYCLES: &[(u8, u32, u32, u32)] = &["
+    )
+    .unwrap();
+    for (opcode, (name, s)) in &costs.instructions {
+        writeln!(
+            out,
+            "    (0x{opcode:02x}, {}, {}, {}), // {name}",
+            s.min,
+            s.max,
+            s.mean()
+        )
+        .unwrap();
+    }
+    writeln!(out, "];").unwrap();
+
+    out
+}
+
+/// Returns the rows whose maximum cycle count increased
+fn compare_with_baseline(costs: &CycleCosts, baseline: &str) -> Vec<String> {
+    let baseline: BTreeMap<&str, u64> = baseline
+        .lines()
+        .skip(1)
+        .filter_map(|l| {
+            let mut it = l.split(',');
+            let key = it.next()?;
+            let max = it.nth(3)?.parse().ok()?;
+            Some((key, max))
+        })
+        .collect();
+
+    rows(costs)
+        .into_iter()
+        .filter_map(|(key, name, s)| match baseline.get(key.as_str()) {
+            Some(&b) if s.max > b => Some(format!("{key} {name}: max {} cycles (was {b})", s.max)),
+            _ => None,
+        })
+        .collect()
+}
+
+fn main() {
+    let args = parse_args();
+
+    let mut costs = CycleCosts::default();
+    for p in &args.project_files {
+        measure_project(p, &mut costs);
+    }
+
+    if costs.ticks == 0 {
+        panic!("No music ticks measured");
+    }
+
+    let out = match args.format {
+        OutputFormat::Table => table(&costs),
+        OutputFormat::Csv => csv(&costs),
+        OutputFormat::Rust => rust_consts(&costs),
+    };
+    print!("{out}");
+
+    if let Some(path) = args.baseline {
+        let baseline = std::fs::read_to_string(&path).unwrap();
+        let regressions = compare_with_baseline(&costs, &baseline);
+        if !regressions.is_empty() {
+            for r in &regressions {
+                eprintln!("{r}");
+            }
+            panic!("{} bytecode cycle regressions", regressions.len());
+        }
+    }
+}
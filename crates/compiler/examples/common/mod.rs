@@ -0,0 +1,100 @@
+//! Audio driver boot sequence shared by the examples
+//!
+//! Writes the loader, audio driver, common audio data and song to Audio-RAM and starts the
+//! S-SMP at the audio driver, skipping the loader transfers.
+
+// Every example uses a different subset of this module
+#![allow(dead_code)]
+
+use compiler::{
+    audio_driver,
+    common_audio_data::CommonAudioData,
+    driver_constants::{addresses, LoaderDataType},
+    songs::SongData,
+};
+use shvc_sound_emu::{ResetRegisters, ShvcSoundEmu};
+
+/// Writes the loader, audio driver, common audio data, song and loader flags to `apuram`
+pub fn write_driver_to_apuram(
+    apuram: &mut [u8],
+    common_audio_data: &CommonAudioData,
+    song_data: &[u8],
+    loader_flags: &LoaderDataType,
+) {
+    const LOADER_DATA_TYPE_ADDR: usize = addresses::LOADER_DATA_TYPE as usize;
+
+    let song_data_addr = common_audio_data.song_data_addr();
+
+    let mut write_spc_ram = |addr: u16, data: &[u8]| {
+        let addr = usize::from(addr);
+        apuram[addr..addr + data.len()].copy_from_slice(data);
+    };
+
+    // Load driver
+    write_spc_ram(addresses::LOADER, audio_driver::LOADER);
+    write_spc_ram(addresses::DRIVER_CODE, audio_driver::AUDIO_DRIVER);
+
+    write_spc_ram(addresses::COMMON_DATA, common_audio_data.data());
+    write_spc_ram(addresses::SONG_PTR, &song_data_addr.to_le_bytes());
+    write_spc_ram(song_data_addr, song_data);
+
+    // Set loader flags
+    apuram[LOADER_DATA_TYPE_ADDR] = loader_flags.driver_value();
+}
+
+/// The S-SMP registers that start the audio driver (written to Audio-RAM by
+/// `write_driver_to_apuram()`)
+pub fn driver_reset_registers(esa: u8, edl: u8) -> ResetRegisters {
+    ResetRegisters {
+        pc: addresses::DRIVER_CODE,
+        a: 0,
+        x: 0,
+        y: 0,
+        psw: 0,
+        sp: 0xff,
+        esa,
+        edl,
+    }
+}
+
+/// `driver_reset_registers()` with the song's echo buffer
+pub fn song_reset_registers(song: &SongData) -> ResetRegisters {
+    let echo_buffer = &song.metadata().echo_buffer;
+
+    driver_reset_registers(echo_buffer.esa_register(), echo_buffer.edl_register())
+}
+
+/// Creates an emulator that starts the audio driver with `song_data`
+pub fn boot_driver(
+    common_audio_data: &CommonAudioData,
+    song_data: &[u8],
+    esa: u8,
+    edl: u8,
+    loader_flags: &LoaderDataType,
+) -> ShvcSoundEmu {
+    let mut emu = ShvcSoundEmu::new(&[0; 64]);
+
+    write_driver_to_apuram(emu.apuram_mut(), common_audio_data, song_data, loader_flags);
+    emu.reset(driver_reset_registers(esa, edl));
+
+    emu
+}
+
+/// Creates an emulator that starts the audio driver with `song`
+pub fn boot_song(
+    common_audio_data: &CommonAudioData,
+    song: &SongData,
+    loader_flags: &LoaderDataType,
+) -> ShvcSoundEmu {
+    let mut emu = ShvcSoundEmu::new(&[0; 64]);
+
+    write_driver_to_apuram(
+        emu.apuram_mut(),
+        common_audio_data,
+        song.data(),
+        loader_flags,
+    );
+    emu.reset(song_reset_registers(song));
+
+    emu
+}
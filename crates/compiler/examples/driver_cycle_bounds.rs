@@ -0,0 +1,499 @@
+//! Audio driver static worst-case cycle bounds
+//!
+//! Disassembles the audio driver binary, builds a control flow graph of every routine reachable
+//! from `main`, the IO command table (`CommandFunctionTable`) and the bytecode instruction table
+//! (`bytecode.InstructionTable`), and prints the worst-case S-SMP cycles of every routine and
+//! bytecode instruction.
+//!
+//! Routines are the audio driver entry point, the table entries and every `CALL`/`PCALL`
+//! target.  A routine's bound includes the routines it calls and tail-calls (jumps or branches
+//! to another routine).  Routines are named with the audio driver code symbols
+//! (`driver_constants::DRIVER_CODE_SYMBOLS`).
+//!
+//! The bound is the longest path through the routine without repeating a loop.  Bounds of
+//! routines that contain a loop, an indirect jump (`JMP [!abs+X]`), a `TCALL`/`BRK`, recursion
+//! or code outside of the audio driver are not guaranteed and are marked in the notes column:
+//!  * `L`: loop (the bound is a single pass through the loop body)
+//!  * `I`: indirect jump or software interrupt (not followed)
+//!  * `R`: recursion (not followed)
+//!  * `X`: jump or call outside of the audio driver (not followed)
+//!
+//! Cycles are S-SMP cycles (2 `ShvcSoundEmu` S-SMP clocks) with the default `TEST` register
+//! wait states.  Conditional branches are assumed to be taken if taking the branch is slower.
+//!
+//! `process_next_bytecode()` dispatches bytecode instructions with `PUSH`/`PUSH`/`RET`, the
+//! dispatch ends at the `RET` and the instruction cycles are the instruction routine's bound.
+//!
+//! This is an example and not a test as the output needs to be reviewed by a human.
+//!
+//! Run with `cargo run --release --example driver_cycle_bounds`.
+
+use compiler::{
+    audio_driver,
+    driver_constants::{addresses, driver_code_symbol, DRIVER_CODE_SYMBOLS},
+};
+
+use std::collections::{BTreeSet, HashMap};
+use std::fmt::Write;
+
+/// S-SMP instruction sizes in bytes, indexed by opcode
+#[rustfmt::skip]
+const INSTRUCTION_SIZE: [u8; 256] = [
+    1,1,2,3,2,3,1,2,2,3,3,2,3,1,3,1, // 0x00
+    2,1,2,3,2,3,3,2,3,1,2,2,1,1,3,3, // 0x10
+    1,1,2,3,2,3,1,2,2,3,3,2,3,1,3,2, // 0x20
+    2,1,2,3,2,3,3,2,3,1,2,2,1,1,2,3, // 0x30
+    1,1,2,3,2,3,1,2,2,3,3,2,3,1,3,2, // 0x40
+    2,1,2,3,2,3,3,2,3,1,2,2,1,1,3,3, // 0x50
+    1,1,2,3,2,3,1,2,2,3,3,2,3,1,3,1, // 0x60
+    2,1,2,3,2,3,3,2,3,1,2,2,1,1,2,1, // 0x70
+    1,1,2,3,2,3,1,2,2,3,3,2,3,2,1,3, // 0x80
+    2,1,2,3,2,3,3,2,3,1,2,2,1,1,1,1, // 0x90
+    1,1,2,3,2,3,1,2,2,3,3,2,3,2,1,1, // 0xa0
+    2,1,2,3,2,3,3,2,3,1,2,2,1,1,1,1, // 0xb0
+    1,1,2,3,2,3,1,2,2,3,3,2,3,2,1,1, // 0xc0
+    2,1,2,3,2,3,3,2,2,2,2,2,1,1,3,1, // 0xd0
+    1,1,2,3,2,3,1,2,2,3,3,2,3,1,1,1, // 0xe0
+    2,1,2,3,2,3,3,2,2,2,3,2,1,1,2,1, // 0xf0
+];
+
+/// S-SMP instruction cycles, indexed by opcode (conditional branches not taken)
+#[rustfmt::skip]
+const INSTRUCTION_CYCLES: [u8; 256] = [
+    2,8,4,5,3,4,3,6,2,6,5,4,5,4,6,8, // 0x00
+    2,8,4,5,4,5,5,6,5,5,6,5,2,2,4,6, // 0x10
+    2,8,4,5,3,4,3,6,2,6,5,4,5,4,5,4, // 0x20
+    2,8,4,5,4,5,5,6,5,5,6,5,2,2,3,8, // 0x30
+    2,8,4,5,3,4,3,6,2,6,4,4,5,4,6,6, // 0x40
+    2,8,4,5,4,5,5,6,5,5,4,5,2,2,4,3, // 0x50
+    2,8,4,5,3,4,3,6,2,6,4,4,5,4,5,5, // 0x60
+    2,8,4,5,4,5,5,6,5,5,5,5,2,2,3,6, // 0x70
+    2,8,4,5,3,4,3,6,2,6,5,4,5,2,4,5, // 0x80
+    2,8,4,5,4,5,5,6,5,5,5,5,2,2,12,5, // 0x90
+    3,8,4,5,3,4,3,6,2,6,4,4,5,2,4,4, // 0xa0
+    2,8,4,5,4,5,5,6,5,5,5,5,2,2,3,4, // 0xb0
+    3,8,4,5,4,5,4,7,2,5,6,4,5,2,4,9, // 0xc0
+    2,8,4,5,5,6,6,7,4,5,5,5,2,2,6,3, // 0xd0
+    2,8,4,5,3,4,3,6,2,4,5,3,4,3,4,3, // 0xe0
+    2,8,4,5,4,5,5,6,3,4,5,4,2,2,4,3, // 0xf0
+];
+
+/// Additional cycles when a conditional branch is taken
+const BRANCH_TAKEN_CYCLES: u32 = 2;
+
+const JMP_ABS: u8 = 0x5f;
+const JMP_INDIRECT_X: u8 = 0x1f;
+const BRA: u8 = 0x2f;
+const CALL: u8 = 0x3f;
+const PCALL: u8 = 0x4f;
+const BRK: u8 = 0x0f;
+const RET: u8 = 0x6f;
+const RETI: u8 = 0x7f;
+const SLEEP: u8 = 0xef;
+const STOP: u8 = 0xff;
+
+const PCALL_PAGE: u16 = 0xff00;
+
+const COMMAND_TABLE_SYMBOL: &str = "CommandFunctionTable";
+const INSTRUCTION_TABLE_SYMBOL: &str = "bytecode.InstructionTable";
+const PLAY_NOTE_SYMBOL: &str = "bytecode._play_note";
+const DISPATCH_SYMBOL: &str = "process_next_bytecode";
+
+#[derive(Clone, Copy, PartialEq, Eq)]
+enum Flow {
+    Next,
+    Branch(u16),
+    Jump(u16),
+    Call(u16),
+    Return,
+    /// Indirect jump or software interrupt
+    Indirect,
+    Stop,
+}
+
+struct Instruction {
+    cycles: u32,
+    next: u16,
+    flow: Flow,
+}
+
+#[derive(Clone, Copy, Default)]
+struct Bound {
+    cycles: u32,
+    has_loop: bool,
+    indirect: bool,
+    recursive: bool,
+    external: bool,
+}
+
+impl Bound {
+    fn end(cycles: u32) -> Self {
+        Self {
+            cycles,
+            ..Default::default()
+        }
+    }
+
+    fn add(self, cycles: u32) -> Self {
+        Self {
+            cycles: self.cycles + cycles,
+            ..self
+        }
+    }
+
+    fn max(self, o: Self) -> Self {
+        Self {
+            cycles: self.cycles.max(o.cycles),
+            has_loop: self.has_loop || o.has_loop,
+            indirect: self.indirect || o.indirect,
+            recursive: self.recursive || o.recursive,
+            external: self.external || o.external,
+        }
+    }
+
+    /// Cycles from `self` and the flags of both bounds
+    fn with_flags(self, o: Self) -> Self {
+        Self {
+            cycles: self.cycles,
+            ..self.max(o)
+        }
+    }
+
+    fn notes(&self) -> String {
+        [
+            (self.has_loop, 'L'),
+            (self.indirect, 'I'),
+            (self.recursive, 'R'),
+            (self.external, 'X'),
+        ]
+        .iter()
+        .filter(|(f, _)| *f)
+        .map(|(_, c)| *c)
+        .collect()
+    }
+}
+
+struct Driver {
+    code: &'static [u8],
+}
+
+impl Driver {
+    fn contains(&self, addr: u16) -> bool {
+        addr >= addresses::DRIVER_CODE
+            && usize::from(addr - addresses::DRIVER_CODE) < self.code.len()
+    }
+
+    fn read(&self, addr: u16) -> u8 {
+        self.code[usize::from(addr - addresses::DRIVER_CODE)]
+    }
+
+    fn read_u16(&self, addr: u16) -> u16 {
+        u16::from_le_bytes([self.read(addr), self.read(addr.wrapping_add(1))])
+    }
+
+    /// Returns None if the instruction is not inside the audio driver
+    fn decode(&self, addr: u16) -> Option<Instruction> {
+        let opcode = self.read(addr);
+        let size = INSTRUCTION_SIZE[usize::from(opcode)];
+        let next = addr.wrapping_add(size.into());
+
+        if !self.contains(next.wrapping_sub(1)) {
+            return None;
+        }
+
+        let relative = || next.wrapping_add_signed((self.read(next - 1) as i8).into());
+
+        let flow = match opcode {
+            // BPL, BMI, BVC, BVS, BCC, BCS, BNE, BEQ
+            o if o & 0x1f == 0x10 => Flow::Branch(relative()),
+            // BBS, BBC
+            o if o & 0x0f == 0x03 => Flow::Branch(relative()),
+            // CBNE dp, CBNE dp+X, DBNZ dp, DBNZ Y
+            0x2e | 0xde | 0x6e | 0xfe => Flow::Branch(relative()),
+
+            BRA => Flow::Jump(relative()),
+            JMP_ABS => Flow::Jump(self.read_u16(addr + 1)),
+            CALL => Flow::Call(self.read_u16(addr + 1)),
+            PCALL => Flow::Call(PCALL_PAGE | u16::from(self.read(addr + 1))),
+
+            // TCALL n
+            o if o & 0x0f == 0x01 => Flow::Indirect,
+            JMP_INDIRECT_X | BRK => Flow::Indirect,
+
+            RET | RETI => Flow::Return,
+            SLEEP | STOP => Flow::Stop,
+
+            _ => Flow::Next,
+        };
+
+        Some(Instruction {
+            cycles: INSTRUCTION_CYCLES[usize::from(opcode)].into(),
+            next,
+            flow,
+        })
+    }
+
+    /// Returns the unique routine entry points reachable from `roots`
+    fn find_routines(&self, roots: &[u16]) -> BTreeSet<u16> {
+        let mut routines = BTreeSet::new();
+        let mut visited = BTreeSet::new();
+        let mut to_visit: Vec<u16> = roots.to_vec();
+
+        routines.extend(roots.iter().copied().filter(|a| self.contains(*a)));
+
+        while let Some(addr) = to_visit.pop() {
+            if !self.contains(addr) || !visited.insert(addr) {
+                continue;
+            }
+            let Some(inst) = self.decode(addr) else {
+                continue;
+            };
+            match inst.flow {
+                Flow::Next => to_visit.push(inst.next),
+                Flow::Branch(t) => to_visit.extend([inst.next, t]),
+                Flow::Jump(t) => to_visit.push(t),
+                Flow::Call(t) => {
+                    if self.contains(t) {
+                        routines.insert(t);
+                    }
+                    to_visit.extend([inst.next, t]);
+                }
+                Flow::Return | Flow::Indirect | Flow::Stop => (),
+            }
+        }
+
+        routines
+    }
+}
+
+#[derive(Clone, Copy)]
+enum State {
+    InProgress,
+    Done(Bound),
+}
+
+struct Analyser<'a> {
+    driver: &'a Driver,
+    routines: &'a BTreeSet<u16>,
+    routine_bounds: HashMap<u16, State>,
+}
+
+impl Analyser<'_> {
+    fn routine_bound(&mut self, entry: u16) -> Bound {
+        if !self.driver.contains(entry) {
+            return Bound {
+                external: true,
+                ..Default::default()
+            };
+        }
+
+        match self.routine_bounds.get(&entry) {
+            Some(State::Done(b)) => return *b,
+            Some(State::InProgress) => {
+                return Bound {
+                    recursive: true,
+                    ..Default::default()
+                }
+            }
+            None => (),
+        }
+
+        self.routine_bounds.insert(entry, State::InProgress);
+
+        let mut nodes = HashMap::new();
+        let b = self.path_bound(entry, entry, &mut nodes);
+
+        self.routine_bounds.insert(entry, State::Done(b));
+        b
+    }
+
+    /// Returns the bound of a jump or branch target (tail-calls another routine)
+    fn target_bound(&mut self, entry: u16, target: u16, nodes: &mut HashMap<u16, State>) -> Bound {
+        if target != entry && self.routines.contains(&target) {
+            self.routine_bound(target)
+        } else {
+            self.path_bound(entry, target, nodes)
+        }
+    }
+
+    /// Longest path from `addr` to the end of the routine
+    fn path_bound(&mut self, entry: u16, addr: u16, nodes: &mut HashMap<u16, State>) -> Bound {
+        match nodes.get(&addr) {
+            Some(State::Done(b)) => return *b,
+            Some(State::InProgress) => {
+                return Bound {
+                    has_loop: true,
+                    ..Default::default()
+                }
+            }
+            None => (),
+        }
+
+        let inst = match self.driver.contains(addr) {
+            true => self.driver.decode(addr),
+            false => None,
+        };
+        let Some(inst) = inst else {
+            return Bound {
+                external: true,
+                ..Default::default()
+            };
+        };
+
+        nodes.insert(addr, State::InProgress);
+
+        let b = match inst.flow {
+            Flow::Next => self.path_bound(entry, inst.next, nodes),
+            Flow::Branch(t) => {
+                let not_taken = self.path_bound(entry, inst.next, nodes);
+                let taken = self.target_bound(entry, t, nodes).add(BRANCH_TAKEN_CYCLES);
+                not_taken.max(taken)
+            }
+            Flow::Jump(t) => self.target_bound(entry, t, nodes),
+            Flow::Call(t) => {
+                let callee = self.routine_bound(t);
+                let rest = self.path_bound(entry, inst.next, nodes);
+                rest.add(callee.cycles).with_flags(callee)
+            }
+            Flow::Indirect => Bound {
+                indirect: true,
+                ..Default::default()
+            },
+            Flow::Return | Flow::Stop => Bound::end(0),
+        }
+        .add(inst.cycles);
+
+        nodes.insert(addr, State::Done(b));
+        b
+    }
+}
+
+fn symbol_addr(name: &str) -> Option<u16> {
+    DRIVER_CODE_SYMBOLS
+        .iter()
+        .find(|(_, n)| *n == name)
+        .map(|(a, _)| *a)
+}
+
+/// Reads a table of routine addresses (the table ends at the next symbol)
+fn read_table(driver: &Driver, name: &str) -> Vec<u16> {
+    let Some(start) = symbol_addr(name) else {
+        eprintln!("Cannot find symbol: {name}");
+        return Vec::new();
+    };
+    let end = DRIVER_CODE_SYMBOLS
+        .iter()
+        .map(|(a, _)| *a)
+        .filter(|a| *a > start)
+        .min()
+        .unwrap_or(addresses::DRIVER_CODE + driver.code.len() as u16);
+
+    (start..end)
+        .step_by(2)
+        .filter(|a| a + 1 < end)
+        .map(|a| driver.read_u16(a))
+        .collect()
+}
+
+fn symbol_name(addr: u16) -> String {
+    match driver_code_symbol(addr) {
+        Some((name, 0)) => name.to_owned(),
+        Some((name, offset)) => format!("{name}+{offset}"),
+        None => "(unknown)".to_owned(),
+    }
+}
+
+fn main() {
+    let driver = Driver {
+        code: audio_driver::AUDIO_DRIVER,
+    };
+
+    let commands = read_table(&driver, COMMAND_TABLE_SYMBOL);
+    let instructions = read_table(&driver, INSTRUCTION_TABLE_SYMBOL);
+
+    let mut roots = vec![addresses::DRIVER_CODE];
+    roots.extend(&commands);
+    roots.extend(&instructions);
+    roots.extend(symbol_addr(PLAY_NOTE_SYMBOL));
+
+    let routines = driver.find_routines(&roots);
+
+    let mut analyser = Analyser {
+        driver: &driver,
+        routines: &routines,
+        routine_bounds: HashMap::new(),
+    };
+
+    let mut out = String::new();
+
+    writeln!(out, "Worst-case S-SMP cycles").unwrap();
+    writeln!(out).unwrap();
+    writeln!(out, "{:>5} {:>7} {:>5}  routine", "addr", "cycles", "notes").unwrap();
+    for &addr in &routines {
+        let b = analyser.routine_bound(addr);
+        writeln!(
+            out,
+            "${addr:04x} {:>7} {:>5}  {}",
+            b.cycles,
+            b.notes(),
+            symbol_name(addr)
+        )
+        .unwrap();
+    }
+
+    let dispatch = symbol_addr(DISPATCH_SYMBOL).map(|a| analyser.routine_bound(a));
+    let with_dispatch = |b: Bound| match dispatch {
+        Some(d) => (b.cycles + d.cycles).to_string(),
+        None => "?".to_owned(),
+    };
+
+    writeln!(out).unwrap();
+    writeln!(
+        out,
+        "{:>6} {:>7} {:>9} {:>5}  instruction",
+        "opcode", "cycles", "+dispatch", "notes"
+    )
+    .unwrap();
+    for (opcode, &addr) in instructions.iter().enumerate() {
+        let b = analyser.routine_bound(addr);
+        writeln!(
+            out,
+            "  0x{opcode:02x} {:>7} {:>9} {:>5}  {}",
+            b.cycles,
+            with_dispatch(b),
+            b.notes(),
+            symbol_name(addr)
+        )
+        .unwrap();
+    }
+    if let Some(addr) = symbol_addr(PLAY_NOTE_SYMBOL) {
+        let b = analyser.routine_bound(addr);
+        writeln!(
+            out,
+            "{:>6} {:>7} {:>9} {:>5}  {}",
+            "note",
+            b.cycles,
+            with_dispatch(b),
+            b.notes(),
+            symbol_name(addr)
+        )
+        .unwrap();
+    }
+
+    writeln!(out).unwrap();
+    writeln!(out, "{:>6} {:>7} {:>5}  command", "id", "cycles", "notes").unwrap();
+    for (i, &addr) in commands.iter().enumerate() {
+        let b = analyser.routine_bound(addr);
+        writeln!(
+            out,
+            "{:>6} {:>7} {:>5}  {}",
+            i * 2,
+            b.cycles,
+            b.notes(),
+            symbol_name(addr)
+        )
+        .unwrap();
+    }
+
+    print!("{out}");
+}
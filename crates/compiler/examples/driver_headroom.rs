@@ -0,0 +1,282 @@
+//! Driver headroom validation
+//!
+//! Plays every song in a project (or a single song) and compares the tick headroom the audio
+//! driver reports to the S-CPU (`IO.ToScpu.musicHeadroom`, IO port 2) with the time the
+//! emulator measured for the music `__process_channels()` loop.
+//!
+//! The loop is timed with the S-SMP instruction trace, from the `counter_2` read that starts the
+//! tick budget to the `counter_2` read after the loop.  Timer 2 counts are not synchronised to
+//! the loop, so a reported headroom is correct if it is within 1 count of the measured time.
+//!
+//! The headroom ports are the loader's ready signal ports (`IO.Loader.Init_ToScpu`), the
+//! S-CPU would mistake the audio driver for the loader if they ever read 'L', 'D'.
+//!
+//! Prints a JSON report (to stdout) with a histogram of the reported headroom, the number of
+//! ticks where the reported headroom did not match the measured time and the number of ticks
+//! where the headroom ports matched the loader ready signal.
+//!
+//! This is an example and not a test as it requires command line input parameters (the project
+//! file and an optional song name).
+//!
+//! Run with `cargo run --release --example driver_headroom -- [--ticks N] PROJECT_FILE [SONG]`.
+
+mod common;
+
+use compiler::{
+    common_audio_data::{build_common_audio_data, CommonAudioData},
+    data::{load_project_file, load_text_file_with_limit, validate_project_file_names},
+    driver_constants::{addresses, LoaderDataType},
+    mml::compile_mml,
+    samples::build_sample_and_instrument_data,
+    songs::SongData,
+    sound_effects::{blank_compiled_sound_effects, CompiledSfxSubroutines},
+};
+use serde::Serialize;
+use shvc_sound_emu::ShvcSoundEmu;
+
+use std::path::PathBuf;
+
+/// Default number of music ticks to test per song
+const DEFAULT_TICKS: u32 = 5000;
+
+/// MUST match `TICK_BUDGET` in `audio-driver/src/audio-driver.wiz`
+const TICK_BUDGET: u64 = 7;
+
+/// S-SMP clocks per timer 2 count (0.5ms)
+const CLOCKS_PER_COUNT: u64 = ShvcSoundEmu::SMP_CLOCKS_PER_SECOND / 2000;
+
+/// Large enough to record every instruction of a music tick
+const TRACE_SIZE: usize = 1 << 16;
+
+const MUSIC_HEADROOM_PORT: usize = 2;
+const SFX_HEADROOM_PORT: usize = 3;
+
+/// MUST match `LOADER_READY_L` and `LOADER_READY_H` in `audio-driver/src/io-commands.wiz`
+const LOADER_READY: [u8; 2] = [b'L', b'D'];
+
+/// `mov a, dp` opcode
+const MOV_A_DP: u8 = 0xe4;
+/// `smp.counter_2` direct page address
+const COUNTER_2: u8 = 0xff;
+
+#[derive(Serialize)]
+struct SongHeadroom {
+    name: String,
+    ticks: u32,
+    /// Number of ticks with each reported headroom (index = headroom)
+    histogram: Vec<u32>,
+    /// The longest music `__process_channels()` loop (in S-SMP clocks)
+    max_loop_clocks: u64,
+    /// Number of ticks where the reported headroom did not match the measured loop time
+    mismatches: u32,
+    /// Number of ticks where the music and sfx headroom ports matched the loader ready signal
+    loader_ready_matches: u32,
+}
+
+struct Args {
+    ticks: u32,
+    project_file: PathBuf,
+    song_name: Option<String>,
+}
+
+fn parse_args() -> Args {
+    let mut ticks = DEFAULT_TICKS;
+    let mut positional = Vec::new();
+
+    let mut it = std::env::args_os().skip(1);
+    while let Some(a) = it.next() {
+        match a.to_str() {
+            Some("--ticks") => {
+                ticks = it
+                    .next()
+                    .and_then(|v| v.to_str()?.parse().ok())
+                    .expect("--ticks expects an integer");
+            }
+            _ => positional.push(a),
+        }
+    }
+
+    if positional.len() != 1 && positional.len() != 2 {
+        panic!("Expected arguments: [--ticks N] project file [song name]");
+    }
+    let mut positional = positional.into_iter();
+
+    Args {
+        ticks,
+        project_file: PathBuf::from(positional.next().unwrap()),
+        song_name: positional.next().map(|s| s.to_string_lossy().into_owned()),
+    }
+}
+
+fn load_song(
+    common_audio_data: &CommonAudioData,
+    song: &SongData,
+    stereo_flag: bool,
+) -> ShvcSoundEmu {
+    // The headroom is measured whether or not the tick budget guard is enabled
+    common::boot_song(
+        common_audio_data,
+        song,
+        &LoaderDataType {
+            stereo_flag,
+            play_song: true,
+            skip_echo_buffer_reset: false,
+            tick_budget: false,
+        },
+    )
+}
+
+/// Returns true if `headroom` matches a loop that took `loop_clocks` S-SMP clocks
+fn headroom_matches(headroom: u8, loop_clocks: u64) -> bool {
+    let expected = |counts: u64| TICK_BUDGET.saturating_sub(counts);
+
+    let counts = loop_clocks / CLOCKS_PER_COUNT;
+    let h = u64::from(headroom);
+
+    h == expected(counts) || h == expected(counts + 1)
+}
+
+/// Emulates a single music tick.
+///
+/// Returns the music `__process_channels()` loop time (in S-SMP clocks) and the music and sfx
+/// headroom ports, or None if the driver stopped processing ticks.
+fn music_tick(emu: &mut ShvcSoundEmu) -> Option<(u64, [u8; 2])> {
+    let r = emu.run_ticks(
+        1,
+        addresses::PROCESS_MUSIC_CHANNELS_CODE,
+        ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+    );
+    if !r.hit || emu.halted() {
+        return None;
+    }
+
+    // Discards the previous tick's instructions
+    emu.set_trace_size(TRACE_SIZE);
+
+    let r = emu.run_until_port_write(
+        1 << MUSIC_HEADROOM_PORT,
+        ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+    );
+    if !r.hit {
+        return None;
+    }
+    let ports = emu.read_io_ports();
+    let headroom = [ports[MUSIC_HEADROOM_PORT], ports[SFX_HEADROOM_PORT]];
+
+    // The first `counter_2` read starts the tick budget, the second is the headroom read
+    let mut reads = emu
+        .trace()
+        .into_iter()
+        .filter(|t| t.opcode == MOV_A_DP && t.operand1 == COUNTER_2)
+        .map(|t| t.smp_clock);
+
+    let loop_start = reads.next()?;
+    let loop_end = reads.last()?;
+
+    Some((loop_end - loop_start, headroom))
+}
+
+fn song_headroom(
+    name: &str,
+    common_audio_data: &CommonAudioData,
+    song: &SongData,
+    ticks: u32,
+) -> SongHeadroom {
+    const STEREO_FLAG: bool = true;
+
+    let mut emu = load_song(common_audio_data, song, STEREO_FLAG);
+
+    let mut out = SongHeadroom {
+        name: name.to_owned(),
+        ticks: 0,
+        histogram: vec![0; TICK_BUDGET as usize + 1],
+        max_loop_clocks: 0,
+        mismatches: 0,
+        loader_ready_matches: 0,
+    };
+
+    for _ in 0..ticks {
+        let Some((loop_clocks, headroom_ports)) = music_tick(&mut emu) else {
+            break;
+        };
+        let headroom = headroom_ports[0];
+
+        out.ticks += 1;
+        out.max_loop_clocks = out.max_loop_clocks.max(loop_clocks);
+
+        if let Some(h) = out.histogram.get_mut(usize::from(headroom)) {
+            *h += 1;
+        }
+        if !headroom_matches(headroom, loop_clocks) {
+            out.mismatches += 1;
+        }
+        if headroom_ports == LOADER_READY {
+            out.loader_ready_matches += 1;
+        }
+    }
+
+    out
+}
+
+fn main() {
+    let args = parse_args();
+
+    let project = load_project_file(&args.project_file).unwrap();
+    let project = validate_project_file_names(project).unwrap();
+
+    let samples = build_sample_and_instrument_data(&project).unwrap();
+
+    let sfx_subs = CompiledSfxSubroutines::blank();
+    let sfx = blank_compiled_sound_effects();
+
+    let common_audio_data = build_common_audio_data(&samples, &sfx_subs, &sfx).unwrap();
+
+    let mut results = Vec::new();
+
+    for song in project.songs.list() {
+        if args
+            .song_name
+            .as_ref()
+            .is_some_and(|n| n != song.name.as_str())
+        {
+            continue;
+        }
+
+        eprintln!("Testing song: {}", song.name);
+
+        let mml_file = load_text_file_with_limit(&song.source, &project.parent_path).unwrap();
+
+        let song_data = compile_mml(
+            &mml_file,
+            Some(song.name.clone()),
+            &project.instruments_and_samples,
+            samples.pitch_table(),
+        )
+        .unwrap();
+
+        results.push(song_headroom(
+            song.name.as_str(),
+            &common_audio_data,
+            &song_data,
+            args.ticks,
+        ));
+    }
+
+    if results.is_empty() {
+        panic!("No songs tested");
+    }
+
+    println!("{}", serde_json::to_string_pretty(&results).unwrap());
+
+    let mismatches: u32 = results.iter().map(|r| r.mismatches).sum();
+    let loader_ready_matches: u32 = results.iter().map(|r| r.loader_ready_matches).sum();
+    if mismatches > 0 {
+        eprintln!("{mismatches} ticks reported the wrong headroom");
+    }
+    if loader_ready_matches > 0 {
+        eprintln!("{loader_ready_matches} ticks matched the loader ready signal");
+    }
+    if mismatches > 0 || loader_ready_matches > 0 {
+        std::process::exit(1);
+    }
+}
@@ -0,0 +1,178 @@
+//! Emulator throughput benchmark
+//!
+//! Boots the audio driver with every song in the `songs/` and `mml-tests/` directories of a
+//! project, emulates the first few seconds of each song and prints the emulator throughput
+//! (emulated seconds, S-SMP instructions and S-DSP samples per second) as JSON (to stdout).
+//!
+//! Each song is emulated `ITERATIONS` times and the fastest iteration is reported, so the results
+//! can be compared between commits to find performance regressions.
+//!
+//! This is an example and not a benchmark target as:
+//!    * emu_benchmark requires a command line input parameter (the project file)
+//!    * emu_benchmark needs the audio driver and the compiler, which shvc-sound-emu cannot depend on.
+//!
+//! Run with `cargo run --release --example emu_benchmark examples/example-project.terrificaudio`.
+
+mod common;
+
+use compiler::{
+    common_audio_data::{build_common_audio_data, CommonAudioData},
+    data::{load_project_file, load_text_file_with_limit, validate_project_file_names},
+    driver_constants::LoaderDataType,
+    mml::compile_mml,
+    samples::build_sample_and_instrument_data,
+    songs::SongData,
+    sound_effects::{blank_compiled_sound_effects, CompiledSfxSubroutines},
+};
+use serde::Serialize;
+use shvc_sound_emu::{EmulatorCounters, ShvcSoundEmu};
+
+use std::path::PathBuf;
+use std::time::{Duration, Instant};
+
+/// Songs outside of these directories are not benchmarked
+const SONG_DIRECTORIES: [&str; 2] = ["songs/", "mml-tests/"];
+
+const SECONDS_TO_EMULATE: u64 = 30;
+const ITERATIONS: usize = 3;
+
+#[derive(Serialize)]
+struct SongResult {
+    name: String,
+    emulated_seconds: f64,
+    wall_seconds: f64,
+    emulated_seconds_per_second: f64,
+    smp_instructions_per_second: f64,
+    dsp_samples_per_second: f64,
+}
+
+#[derive(Serialize)]
+struct BenchmarkResult {
+    seconds_to_emulate: u64,
+    iterations: usize,
+    songs: Vec<SongResult>,
+    total: SongResult,
+}
+
+fn load_song(
+    common_audio_data: &CommonAudioData,
+    song: &SongData,
+    stereo_flag: bool,
+) -> ShvcSoundEmu {
+    common::boot_song(
+        common_audio_data,
+        song,
+        &LoaderDataType {
+            stereo_flag,
+            play_song: true,
+            skip_echo_buffer_reset: false,
+            tick_budget: false,
+        },
+    )
+}
+
+/// Returns the fastest time taken to emulate `SECONDS_TO_EMULATE` seconds of audio and the
+/// emulator counters
+fn benchmark_song(
+    common_audio_data: &CommonAudioData,
+    song: &SongData,
+) -> (Duration, EmulatorCounters) {
+    const STEREO_FLAG: bool = true;
+
+    let buffers = SECONDS_TO_EMULATE * ShvcSoundEmu::SMP_CLOCKS_PER_SECOND
+        / (ShvcSoundEmu::SMP_CLOCKS_PER_SAMPLE * ShvcSoundEmu::AUDIO_BUFFER_SAMPLES as u64);
+
+    let mut best: Option<Duration> = None;
+    let mut counters = EmulatorCounters::default();
+
+    for _ in 0..ITERATIONS {
+        let mut emu = load_song(common_audio_data, song, STEREO_FLAG);
+
+        let start = Instant::now();
+        for _ in 0..buffers {
+            emu.emulate();
+        }
+        let elapsed = start.elapsed();
+
+        // The emulator is deterministic, every iteration has the same counters
+        counters = emu.counters();
+
+        best = Some(best.map_or(elapsed, |b| b.min(elapsed)));
+    }
+
+    (best.unwrap(), counters)
+}
+
+fn song_result(name: String, elapsed: Duration, counters: &EmulatorCounters) -> SongResult {
+    let emulated_seconds = counters.smp_clocks as f64 / ShvcSoundEmu::SMP_CLOCKS_PER_SECOND as f64;
+    let wall_seconds = elapsed.as_secs_f64();
+
+    SongResult {
+        name,
+        emulated_seconds,
+        wall_seconds,
+        emulated_seconds_per_second: emulated_seconds / wall_seconds,
+        smp_instructions_per_second: counters.smp_instructions as f64 / wall_seconds,
+        dsp_samples_per_second: counters.dsp_samples as f64 / wall_seconds,
+    }
+}
+
+fn main() {
+    let mut args = std::env::args_os();
+
+    if args.len() != 2 {
+        panic!("Expected a single argument: project file");
+    }
+    let pf_path = PathBuf::from(args.nth(1).unwrap());
+
+    let project = load_project_file(&pf_path).unwrap();
+    let project = validate_project_file_names(project).unwrap();
+
+    let samples = build_sample_and_instrument_data(&project).unwrap();
+
+    let sfx_subs = CompiledSfxSubroutines::blank();
+    let sfx = blank_compiled_sound_effects();
+
+    let common_audio_data = build_common_audio_data(&samples, &sfx_subs, &sfx).unwrap();
+
+    let mut songs = Vec::new();
+    let mut total = Duration::ZERO;
+    let mut total_counters = EmulatorCounters::default();
+
+    for song in project.songs.list() {
+        if !SONG_DIRECTORIES
+            .iter()
+            .any(|d| song.source.as_str().starts_with(d))
+        {
+            continue;
+        }
+
+        let mml_file = load_text_file_with_limit(&song.source, &project.parent_path).unwrap();
+
+        let song_data = compile_mml(
+            &mml_file,
+            Some(song.name.clone()),
+            &project.instruments_and_samples,
+            samples.pitch_table(),
+        )
+        .unwrap();
+
+        let (elapsed, counters) = benchmark_song(&common_audio_data, &song_data);
+
+        total += elapsed;
+        total_counters.smp_clocks += counters.smp_clocks;
+        total_counters.smp_instructions += counters.smp_instructions;
+        total_counters.dsp_samples += counters.dsp_samples;
+
+        songs.push(song_result(song.name.to_string(), elapsed, &counters));
+    }
+
+    let result = BenchmarkResult {
+        seconds_to_emulate: SECONDS_TO_EMULATE,
+        iterations: ITERATIONS,
+        total: song_result("total".to_owned(), total, &total_counters),
+        songs,
+    };
+
+    println!("{}", serde_json::to_string_pretty(&result).unwrap());
+}
@@ -0,0 +1,313 @@
+//! IO command bandwidth
+//!
+//! Loads a project's audio driver, common audio data and song with
+//! `ShvcSoundEmu::simulate_loader_transfers()`, plays the song in the emulator and measures the
+//! sustained bandwidth of the IO command ports (the 2 parameter bytes of every acknowledged
+//! command), which is the upper bound of any S-CPU to audio driver data stream that does not
+//! use the loader (ie, streaming BRR blocks during playback).
+//!
+//! Two S-CPU models are measured:
+//!  * `per-frame`: one command per frame, like `Tad_Process`.
+//!  * `busy`: the next command is sent as soon as the previous command is acknowledged.
+//!
+//! The measured command is `STOP_SOUND_EFFECTS`, which has no effect on the song.
+//!
+//! Prints the commands and bytes per second, the bytes per frame and the BRR sample rate the
+//! bandwidth could sustain (9 bytes per 16 samples) as JSON (to stdout).
+//!
+//! This is an example and not a test as it requires project files.
+//!
+//! Run with `cargo run --release --example io_command_bandwidth -- [--seconds N] PROJECT_FILE SONG`.
+
+use compiler::{
+    audio_driver,
+    common_audio_data::build_common_audio_data,
+    data::{load_project_file, load_text_file_with_limit, validate_project_file_names},
+    driver_constants::{
+        addresses, io_commands, LoaderDataType, IO_COMMAND_I_MASK, IO_COMMAND_MASK,
+    },
+    mml::compile_mml,
+    samples::build_sample_and_instrument_data,
+    sfx_file::load_sound_effects_file,
+    sound_effects::{
+        blank_compiled_sound_effects, combine_sound_effects, compile_sound_effects_file,
+        CompiledSfxSubroutines,
+    },
+};
+use serde::Serialize;
+use shvc_sound_emu::{LoaderTransfer, ScpuLoaderTiming, ShvcSoundEmu};
+
+use std::path::PathBuf;
+
+/// LoaderDataType.CODE
+const LOADER_DATA_TYPE_CODE: u8 = 0;
+/// LoaderDataType.COMMON_DATA
+const LOADER_DATA_TYPE_COMMON_DATA: u8 = 1;
+/// LoaderDataType.FAST_TRANSFER_BIT
+const FAST_TRANSFER_FLAG: u8 = 1 << 4;
+
+/// TAD_DEFAULT_TRANSFER_PER_FRAME
+const BYTES_PER_FRAME: u32 = 256;
+
+const DEFAULT_SECONDS: u32 = 10;
+
+/// NTSC frame rate
+const FRAMES_PER_SECOND: f64 = 60.0988;
+
+/// Number of parameter bytes sent with every IO command
+const BYTES_PER_COMMAND: u64 = 2;
+
+/// BRR block size and the number of samples in a BRR block
+const BRR_BLOCK_SIZE: f64 = 9.0;
+const BRR_SAMPLES_PER_BLOCK: f64 = 16.0;
+
+#[derive(Serialize)]
+struct Bandwidth {
+    model: &'static str,
+    seconds: u32,
+    commands: u64,
+    unacknowledged: u64,
+    mean_ack_smp_clocks: Option<f64>,
+    max_ack_smp_clocks: u64,
+    bytes_per_second: f64,
+    bytes_per_frame: f64,
+    brr_sample_rate: f64,
+}
+
+struct Args {
+    seconds: u32,
+    project_file: PathBuf,
+    song: String,
+}
+
+fn parse_args() -> Args {
+    let mut seconds = DEFAULT_SECONDS;
+    let mut positional = Vec::new();
+
+    let mut it = std::env::args_os().skip(1);
+    while let Some(a) = it.next() {
+        match a.to_str() {
+            Some("--seconds") => {
+                seconds = it
+                    .next()
+                    .and_then(|v| v.to_str()?.parse().ok())
+                    .expect("--seconds expects an integer");
+            }
+            _ => positional.push(a),
+        }
+    }
+
+    let [project_file, song] = <[_; 2]>::try_from(positional)
+        .unwrap_or_else(|_| panic!("Expected a project file and a song name"));
+
+    Args {
+        seconds,
+        project_file: PathBuf::from(project_file),
+        song: song.into_string().expect("Invalid song name"),
+    }
+}
+
+fn transfer(
+    emu: &mut ShvcSoundEmu,
+    name: &str,
+    timing: &ScpuLoaderTiming,
+    data_type: u8,
+    data: &[u8],
+) {
+    match emu
+        .simulate_loader_transfers(
+            timing,
+            &[LoaderTransfer {
+                data_type,
+                data: data.to_vec(),
+            }],
+        )
+        .first()
+    {
+        Some(r) if r.ok => (),
+        _ => panic!("{name}: loader timeout"),
+    }
+}
+
+/// Returns a new IO command with a different command id
+fn next_command(previous: u8, command: u8) -> u8 {
+    ((previous ^ u8::MAX) & IO_COMMAND_I_MASK) | (command & IO_COMMAND_MASK)
+}
+
+fn measure(
+    emu: &mut ShvcSoundEmu,
+    model: &'static str,
+    seconds: u32,
+    per_frame: bool,
+) -> Bandwidth {
+    let smp_clocks = u64::from(seconds) * ShvcSoundEmu::SMP_CLOCKS_PER_SECOND;
+    let frame_clocks = (ShvcSoundEmu::SMP_CLOCKS_PER_SECOND as f64 / FRAMES_PER_SECOND) as u64;
+
+    let start = emu.counters().smp_clocks;
+    let end = start + smp_clocks;
+
+    // The audio driver starts with the PAUSE command id (`play_song` starts the song)
+    let mut previous_command = io_commands::PAUSE;
+
+    // No command is a key-on command
+    emu.start_io_latency(0, 0xff);
+
+    let mut now = start;
+    while now < end {
+        // Like the S-CPU API, a command is not sent until the previous command has been
+        // acknowledged
+        if emu.read_io_ports()[0] == previous_command {
+            previous_command = next_command(previous_command, io_commands::STOP_SOUND_EFFECTS);
+            emu.write_io_ports([previous_command, 0, 0, 0]);
+        }
+
+        if per_frame {
+            let frame_end = (now + frame_clocks).min(end);
+            emu.fast_forward(frame_end - now);
+        } else {
+            // Port 0 is also written by commands that are still being processed
+            loop {
+                let remaining = end.saturating_sub(emu.counters().smp_clocks);
+                let r = emu.run_until_port_write(1, remaining);
+                if !r.hit || emu.read_io_ports()[0] == previous_command {
+                    break;
+                }
+            }
+        }
+
+        assert!(!emu.halted(), "audio driver halted");
+        now = emu.counters().smp_clocks;
+    }
+
+    let latency = emu.io_latency();
+    emu.stop_io_latency();
+
+    let commands = latency.ack.count;
+    let bytes_per_second = (commands * BYTES_PER_COMMAND) as f64 / f64::from(seconds);
+
+    Bandwidth {
+        model,
+        seconds,
+        commands,
+        unacknowledged: latency.unacknowledged,
+        mean_ack_smp_clocks: latency.ack.mean_clocks(),
+        max_ack_smp_clocks: latency.ack.max_clocks,
+        bytes_per_second,
+        bytes_per_frame: bytes_per_second / FRAMES_PER_SECOND,
+        brr_sample_rate: bytes_per_second * BRR_SAMPLES_PER_BLOCK / BRR_BLOCK_SIZE,
+    }
+}
+
+fn main() {
+    let args = parse_args();
+
+    let project = load_project_file(&args.project_file).unwrap();
+    let project = validate_project_file_names(project).unwrap();
+
+    let samples = build_sample_and_instrument_data(&project).unwrap();
+
+    let (sfx_subs, sfx) = match &project.sound_effect_file {
+        Some(source) => {
+            let sfx_file = load_sound_effects_file(source, &project.parent_path).unwrap();
+            let (subs, sfx) = compile_sound_effects_file(
+                &sfx_file,
+                &project.instruments_and_samples,
+                samples.pitch_table(),
+            )
+            .unwrap();
+            let sfx =
+                combine_sound_effects(&sfx, &project.sfx_export_order, project.default_sfx_flags)
+                    .unwrap();
+            (subs, sfx)
+        }
+        None => (
+            CompiledSfxSubroutines::blank(),
+            blank_compiled_sound_effects(),
+        ),
+    };
+
+    let common_audio_data = build_common_audio_data(&samples, &sfx_subs, &sfx).unwrap();
+
+    let song = project
+        .songs
+        .get(&args.song)
+        .unwrap_or_else(|| panic!("Cannot find song: {}", args.song));
+    let mml_file = load_text_file_with_limit(&song.source, &project.parent_path).unwrap();
+    let song_data = compile_mml(
+        &mml_file,
+        Some(song.name.clone()),
+        &project.instruments_and_samples,
+        samples.pitch_table(),
+    )
+    .unwrap();
+
+    let mut emu = ShvcSoundEmu::new(&[0; 64]);
+
+    let loader_addr = usize::from(addresses::LOADER);
+    emu.apuram_mut()[loader_addr..loader_addr + audio_driver::LOADER.len()]
+        .copy_from_slice(audio_driver::LOADER);
+
+    emu.reset(shvc_sound_emu::ResetRegisters {
+        pc: addresses::LOADER,
+        a: 0,
+        x: 0,
+        y: 0,
+        psw: 0,
+        sp: 0xff,
+        esa: 0,
+        edl: 0,
+    });
+
+    // `Tad_Init` transfers the audio driver with a blocking fast transfer
+    transfer(
+        &mut emu,
+        "audio driver",
+        &ScpuLoaderTiming::ntsc(0),
+        LOADER_DATA_TYPE_CODE | FAST_TRANSFER_FLAG,
+        audio_driver::AUDIO_DRIVER,
+    );
+
+    let timing = ScpuLoaderTiming::ntsc(BYTES_PER_FRAME);
+    transfer(
+        &mut emu,
+        "common audio data",
+        &timing,
+        LOADER_DATA_TYPE_COMMON_DATA,
+        common_audio_data.data(),
+    );
+
+    let data_type = LoaderDataType {
+        stereo_flag: true,
+        play_song: true,
+        skip_echo_buffer_reset: false,
+        tick_budget: false,
+    }
+    .driver_value();
+    transfer(
+        &mut emu,
+        song.name.as_str(),
+        &timing,
+        data_type | FAST_TRANSFER_FLAG,
+        song_data.data(),
+    );
+
+    // Wait for the audio driver to initialise
+    let r = emu.run_until_pc(
+        addresses::MAINLOOP_CODE,
+        ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+    );
+    assert!(r.hit, "audio driver did not start");
+
+    // Both models measure the same part of the song
+    let state = emu.save_state();
+
+    let per_frame = measure(&mut emu, "per-frame", args.seconds, true);
+
+    emu.load_state(&state).unwrap();
+    let busy = measure(&mut emu, "busy", args.seconds, false);
+
+    println!(
+        "{}",
+        serde_json::to_string_pretty(&[per_frame, busy]).unwrap()
+    );
+}
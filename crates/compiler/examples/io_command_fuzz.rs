@@ -0,0 +1,606 @@
+//! IO command fuzzer
+//!
+//! Loads a project's audio driver, common audio data and songs with
+//! `ShvcSoundEmu::simulate_loader_transfers()`, then fires randomised sequences of pause, unpause,
+//! sound effect, volume, music channel and tempo commands at every song and measures the worst
+//! IO command acknowledgement and sound effect key-on latencies.
+//!
+//! Every scenario starts from a copy of the song's emulator state (`save_state()`) and runs on
+//! its own thread (`compiler::parallel`).  Commands are sent with `schedule_port_write()` at
+//! random S-SMP clocks.  Like `Tad_Process`, at most one command is sent per frame and a command
+//! is not sent until the previous command has been acknowledged (late commands are sent at the
+//! start of the next frame the audio driver is ready).
+//!
+//! The sound effect key-on latency is the time from a `PLAY_SOUND_EFFECT` command to the next
+//! non-zero KON write (see `ShvcSoundEmu::start_io_latency()`).
+//!
+//! Prints the worst latencies of every song as JSON (to stdout).  If `--output-dir` is set, the
+//! scenarios with the worst acknowledgement and key-on latency of every song are written to
+//! `DIR/<song>-ack.json` and `DIR/<song>-key-on.json`.  A scenario file can be replayed with
+//! `--replay`, which resends the exact same port writes.
+//!
+//! This is an example and not a test as it requires project files.
+//!
+//! Run with `cargo run --release --example io_command_fuzz -- [--scenarios N] [--seconds N]
+//! [--seed N] [--output-dir DIR] PROJECT_FILE`
+//! or `cargo run --release --example io_command_fuzz -- --replay SCENARIO_FILE PROJECT_FILE`.
+
+use compiler::{
+    audio_driver,
+    common_audio_data::build_common_audio_data,
+    data::{load_project_file, load_text_file_with_limit, validate_project_file_names},
+    driver_constants::{
+        addresses, io_commands, LoaderDataType, IO_COMMAND_I_MASK, IO_COMMAND_MASK,
+    },
+    mml::compile_mml,
+    parallel::{available_threads, parallel_map},
+    samples::build_sample_and_instrument_data,
+    sfx_file::load_sound_effects_file,
+    sound_effects::{
+        blank_compiled_sound_effects, combine_sound_effects, compile_sound_effects_file,
+        CompiledSfxSubroutines, SfxExportOrder,
+    },
+};
+use serde::{Deserialize, Serialize};
+use shvc_sound_emu::{LoaderTransfer, ScpuLoaderTiming, ShvcSoundEmu};
+
+use std::path::PathBuf;
+
+/// LoaderDataType.CODE
+const LOADER_DATA_TYPE_CODE: u8 = 0;
+/// LoaderDataType.COMMON_DATA
+const LOADER_DATA_TYPE_COMMON_DATA: u8 = 1;
+/// LoaderDataType.FAST_TRANSFER_BIT
+const FAST_TRANSFER_FLAG: u8 = 1 << 4;
+
+/// TAD_DEFAULT_TRANSFER_PER_FRAME
+const BYTES_PER_FRAME: u32 = 256;
+
+/// IO commands not in `driver_constants::io_commands`
+const PAUSE_MUSIC_PLAY_SFX: u8 = 2;
+const SET_MAIN_VOLUME: u8 = 10;
+const SET_MUSIC_CHANNELS: u8 = 12;
+const SET_SONG_TEMPO: u8 = 14;
+
+/// audio-driver MIN_TICK_CLOCK
+const MIN_TICK_CLOCK: u8 = 64;
+
+const DEFAULT_SCENARIOS: u32 = 64;
+const DEFAULT_SECONDS: u32 = 10;
+const DEFAULT_SEED: u64 = 0x7ad;
+
+/// NTSC frame rate
+const FRAMES_PER_SECOND: f64 = 60.0988;
+
+/// The maximum number of frames between two commands
+const MAX_FRAMES_BETWEEN_COMMANDS: u64 = 8;
+
+#[derive(Clone, Copy, Serialize, Deserialize)]
+struct PortWrite {
+    /// S-SMP clocks after the song started
+    smp_clock: u64,
+    ports: [u8; 4],
+}
+
+/// A reproducer scenario file
+#[derive(Serialize, Deserialize)]
+struct Scenario {
+    song: String,
+    seed: u64,
+    smp_clocks: u64,
+    max_ack_smp_clocks: u64,
+    max_key_on_smp_clocks: u64,
+    writes: Vec<PortWrite>,
+}
+
+#[derive(Clone, Copy, Default, Serialize)]
+struct Latency {
+    count: u64,
+    mean_smp_clocks: Option<f64>,
+    max_smp_clocks: u64,
+}
+
+#[derive(Serialize)]
+struct SongReport {
+    song: String,
+    scenarios: u32,
+    commands: u64,
+    unacknowledged: u64,
+    ack: Latency,
+    key_on: Latency,
+    worst_ack_seed: Option<u64>,
+    worst_key_on_seed: Option<u64>,
+}
+
+struct ScenarioResult {
+    writes: Vec<PortWrite>,
+    ack: Latency,
+    key_on: Latency,
+    unacknowledged: u64,
+}
+
+struct Args {
+    scenarios: u32,
+    seconds: u32,
+    seed: u64,
+    output_dir: Option<PathBuf>,
+    replay: Option<PathBuf>,
+    project_file: PathBuf,
+}
+
+fn parse_args() -> Args {
+    let mut scenarios = DEFAULT_SCENARIOS;
+    let mut seconds = DEFAULT_SECONDS;
+    let mut seed = DEFAULT_SEED;
+    let mut output_dir = None;
+    let mut replay = None;
+    let mut positional = Vec::new();
+
+    let mut it = std::env::args_os().skip(1);
+    while let Some(a) = it.next() {
+        match a.to_str() {
+            Some("--scenarios") => {
+                scenarios = it
+                    .next()
+                    .and_then(|v| v.to_str()?.parse().ok())
+                    .expect("--scenarios expects an integer");
+            }
+            Some("--seconds") => {
+                seconds = it
+                    .next()
+                    .and_then(|v| v.to_str()?.parse().ok())
+                    .expect("--seconds expects an integer");
+            }
+            Some("--seed") => {
+                seed = it
+                    .next()
+                    .and_then(|v| v.to_str()?.parse().ok())
+                    .expect("--seed expects an integer");
+            }
+            Some("--output-dir") => {
+                output_dir = Some(PathBuf::from(
+                    it.next().expect("--output-dir expects a directory"),
+                ));
+            }
+            Some("--replay") => {
+                replay = Some(PathBuf::from(
+                    it.next().expect("--replay expects a scenario file"),
+                ));
+            }
+            _ => positional.push(a),
+        }
+    }
+
+    let [project_file] =
+        <[_; 1]>::try_from(positional).unwrap_or_else(|_| panic!("Expected a project file"));
+
+    Args {
+        scenarios,
+        seconds,
+        seed,
+        output_dir,
+        replay,
+        project_file: PathBuf::from(project_file),
+    }
+}
+
+/// SplitMix64 (the fuzzer must be reproducible from the seed alone)
+struct Rng(u64);
+
+impl Rng {
+    fn next(&mut self) -> u64 {
+        self.0 = self.0.wrapping_add(0x9e3779b97f4a7c15);
+        let mut z = self.0;
+        z = (z ^ (z >> 30)).wrapping_mul(0xbf58476d1ce4e5b9);
+        z = (z ^ (z >> 27)).wrapping_mul(0x94d049bb133111eb);
+        z ^ (z >> 31)
+    }
+
+    fn below(&mut self, n: u64) -> u64 {
+        self.next() % n
+    }
+
+    fn byte(&mut self) -> u8 {
+        self.next() as u8
+    }
+}
+
+/// Returns a new IO command with a different command id
+fn next_command(previous: u8, command: u8) -> u8 {
+    ((previous ^ u8::MAX) & IO_COMMAND_I_MASK) | (command & IO_COMMAND_MASK)
+}
+
+fn frame_clocks() -> u64 {
+    (ShvcSoundEmu::SMP_CLOCKS_PER_SECOND as f64 / FRAMES_PER_SECOND) as u64
+}
+
+/// A command the S-CPU wants to send (`command`, `parameter0`, `parameter1`)
+struct Command {
+    smp_clock: u64,
+    command: [u8; 3],
+}
+
+fn generate_commands(seed: u64, smp_clocks: u64, n_sound_effects: usize) -> Vec<Command> {
+    let mut rng = Rng(seed);
+    let max_gap = MAX_FRAMES_BETWEEN_COMMANDS * frame_clocks();
+
+    let mut out = Vec::new();
+
+    // Sound effects are not played while everything is paused
+    let mut sfx_paused = false;
+
+    let mut clock = rng.below(max_gap);
+    while clock < smp_clocks {
+        let command = match rng.below(10) {
+            0 => {
+                sfx_paused = true;
+                [io_commands::PAUSE, 0, 0]
+            }
+            1 => {
+                sfx_paused = false;
+                [PAUSE_MUSIC_PLAY_SFX, 0, 0]
+            }
+            2 => {
+                sfx_paused = false;
+                [io_commands::UNPAUSE, 0, 0]
+            }
+            3..=5 if n_sound_effects > 0 && !sfx_paused => [
+                io_commands::PLAY_SOUND_EFFECT,
+                rng.below(n_sound_effects as u64) as u8,
+                rng.below(129) as u8,
+            ],
+            6 => [io_commands::STOP_SOUND_EFFECTS, 0, 0],
+            7 => [SET_MAIN_VOLUME, rng.byte(), 0],
+            8 => [SET_MUSIC_CHANNELS, rng.byte(), 0],
+            _ => [SET_SONG_TEMPO, rng.byte().max(MIN_TICK_CLOCK), 0],
+        };
+        out.push(Command {
+            smp_clock: clock,
+            command,
+        });
+
+        clock += rng.below(max_gap);
+    }
+
+    out
+}
+
+fn latency(h: &shvc_sound_emu::LatencyHistogram) -> Latency {
+    Latency {
+        count: h.count,
+        mean_smp_clocks: h.mean_clocks(),
+        max_smp_clocks: h.max_clocks,
+    }
+}
+
+fn load_emulator(state: &[u8]) -> ShvcSoundEmu {
+    let mut emu = ShvcSoundEmu::new(&[0; 64]);
+    emu.load_state(state).unwrap();
+    emu
+}
+
+/// Sends the commands once per frame (after the previous command has been acknowledged)
+fn run_scenario(state: &[u8], commands: &[Command], smp_clocks: u64) -> ScenarioResult {
+    let mut emu = load_emulator(state);
+
+    let start = emu.counters().smp_clocks;
+    let frame_clocks = frame_clocks();
+
+    // The audio driver starts with the PAUSE command id (`play_song` starts the song)
+    let mut previous_command = io_commands::PAUSE;
+
+    let mut pending = commands.iter().peekable();
+    let mut writes = Vec::with_capacity(commands.len());
+
+    emu.start_io_latency(IO_COMMAND_MASK, io_commands::PLAY_SOUND_EFFECT);
+
+    let mut frame_start = 0;
+    while frame_start < smp_clocks {
+        let frame_end = (frame_start + frame_clocks).min(smp_clocks);
+
+        if emu.read_io_ports()[0] == previous_command {
+            if let Some(c) = pending.next_if(|c| c.smp_clock < frame_end) {
+                let [command, parameter0, parameter1] = c.command;
+                previous_command = next_command(previous_command, command);
+
+                let w = PortWrite {
+                    smp_clock: c.smp_clock.max(frame_start),
+                    ports: [previous_command, parameter0, parameter1, 0],
+                };
+                emu.schedule_port_write(start + w.smp_clock, w.ports);
+                writes.push(w);
+            }
+        }
+
+        let now = emu.counters().smp_clocks - start;
+        emu.fast_forward(frame_end.saturating_sub(now));
+        assert!(!emu.halted(), "audio driver halted");
+
+        frame_start = frame_end;
+    }
+
+    let l = emu.io_latency();
+
+    ScenarioResult {
+        writes,
+        ack: latency(&l.ack),
+        key_on: latency(&l.key_on),
+        unacknowledged: l.unacknowledged,
+    }
+}
+
+/// Resends the exact port writes of a scenario file
+fn replay_scenario(state: &[u8], scenario: &Scenario) -> shvc_sound_emu::IoLatency {
+    let mut emu = load_emulator(state);
+
+    let start = emu.counters().smp_clocks;
+
+    emu.start_io_latency(IO_COMMAND_MASK, io_commands::PLAY_SOUND_EFFECT);
+    for w in &scenario.writes {
+        emu.schedule_port_write(start + w.smp_clock, w.ports);
+    }
+    emu.fast_forward(scenario.smp_clocks);
+
+    emu.io_latency()
+}
+
+fn transfer(
+    emu: &mut ShvcSoundEmu,
+    name: &str,
+    timing: &ScpuLoaderTiming,
+    data_type: u8,
+    data: &[u8],
+) {
+    match emu
+        .simulate_loader_transfers(
+            timing,
+            &[LoaderTransfer {
+                data_type,
+                data: data.to_vec(),
+            }],
+        )
+        .first()
+    {
+        Some(r) if r.ok => (),
+        _ => panic!("{name}: loader timeout"),
+    }
+}
+
+fn write_scenario(dir: &std::path::Path, file_name: String, scenario: &Scenario) {
+    let path = dir.join(file_name);
+    std::fs::write(&path, serde_json::to_string_pretty(scenario).unwrap())
+        .unwrap_or_else(|e| panic!("Cannot write {}: {e}", path.display()));
+}
+
+fn main() {
+    let args = parse_args();
+
+    let project = load_project_file(&args.project_file).unwrap();
+    let project = validate_project_file_names(project).unwrap();
+
+    let samples = build_sample_and_instrument_data(&project).unwrap();
+
+    let (sfx_subs, sfx, n_sound_effects) = match &project.sound_effect_file {
+        Some(source) => {
+            let sfx_file = load_sound_effects_file(source, &project.parent_path).unwrap();
+            let (subs, sfx) = compile_sound_effects_file(
+                &sfx_file,
+                &project.instruments_and_samples,
+                samples.pitch_table(),
+            )
+            .unwrap();
+            let sfx =
+                combine_sound_effects(&sfx, &project.sfx_export_order, project.default_sfx_flags)
+                    .unwrap();
+            (subs, sfx, project.sfx_export_order.n_sound_effects())
+        }
+        None => (
+            CompiledSfxSubroutines::blank(),
+            blank_compiled_sound_effects(),
+            0,
+        ),
+    };
+
+    let common_audio_data = build_common_audio_data(&samples, &sfx_subs, &sfx).unwrap();
+
+    let mut emu = ShvcSoundEmu::new(&[0; 64]);
+
+    let loader_addr = usize::from(addresses::LOADER);
+    emu.apuram_mut()[loader_addr..loader_addr + audio_driver::LOADER.len()]
+        .copy_from_slice(audio_driver::LOADER);
+
+    emu.reset(shvc_sound_emu::ResetRegisters {
+        pc: addresses::LOADER,
+        a: 0,
+        x: 0,
+        y: 0,
+        psw: 0,
+        sp: 0xff,
+        esa: 0,
+        edl: 0,
+    });
+
+    // `Tad_Init` transfers the audio driver with a blocking fast transfer
+    transfer(
+        &mut emu,
+        "audio driver",
+        &ScpuLoaderTiming::ntsc(0),
+        LOADER_DATA_TYPE_CODE | FAST_TRANSFER_FLAG,
+        audio_driver::AUDIO_DRIVER,
+    );
+
+    let timing = ScpuLoaderTiming::ntsc(BYTES_PER_FRAME);
+    transfer(
+        &mut emu,
+        "common audio data",
+        &timing,
+        LOADER_DATA_TYPE_COMMON_DATA,
+        common_audio_data.data(),
+    );
+
+    let common_state = emu.save_state();
+
+    let song_data_type = LoaderDataType {
+        stereo_flag: true,
+        play_song: true,
+        skip_echo_buffer_reset: false,
+        tick_budget: false,
+    }
+    .driver_value();
+
+    let replay: Option<Scenario> = args.replay.as_ref().map(|path| {
+        let json = std::fs::read_to_string(path)
+            .unwrap_or_else(|e| panic!("Cannot read {}: {e}", path.display()));
+        serde_json::from_str(&json)
+            .unwrap_or_else(|e| panic!("Cannot parse {}: {e}", path.display()))
+    });
+
+    // The emulator state of every song after the audio driver has started
+    let song_states: Vec<(String, Vec<u8>)> = project
+        .songs
+        .list()
+        .iter()
+        .filter(|s| replay.as_ref().map_or(true, |r| s.name.as_str() == r.song))
+        .map(|song| {
+            let mml_file = load_text_file_with_limit(&song.source, &project.parent_path).unwrap();
+            let song_data = compile_mml(
+                &mml_file,
+                Some(song.name.clone()),
+                &project.instruments_and_samples,
+                samples.pitch_table(),
+            )
+            .unwrap();
+
+            emu.load_state(&common_state).unwrap();
+            transfer(
+                &mut emu,
+                song.name.as_str(),
+                &timing,
+                song_data_type | FAST_TRANSFER_FLAG,
+                song_data.data(),
+            );
+
+            let r = emu.run_until_pc(
+                addresses::MAINLOOP_CODE,
+                ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+            );
+            assert!(r.hit, "{}: audio driver did not start", song.name.as_str());
+
+            (song.name.as_str().to_owned(), emu.save_state())
+        })
+        .collect();
+
+    if let Some(scenario) = replay {
+        let (_, state) = song_states
+            .first()
+            .unwrap_or_else(|| panic!("Cannot find song: {}", scenario.song));
+
+        let l = replay_scenario(state, &scenario);
+
+        println!(
+            "{}",
+            serde_json::to_string_pretty(&SongReport {
+                song: scenario.song,
+                scenarios: 1,
+                commands: l.ack.count,
+                unacknowledged: l.unacknowledged,
+                ack: latency(&l.ack),
+                key_on: latency(&l.key_on),
+                worst_ack_seed: Some(scenario.seed),
+                worst_key_on_seed: Some(scenario.seed),
+            })
+            .unwrap()
+        );
+        return;
+    }
+
+    let smp_clocks = u64::from(args.seconds) * ShvcSoundEmu::SMP_CLOCKS_PER_SECOND;
+
+    // (song index, scenario seed)
+    let jobs: Vec<(usize, u64)> = (0..song_states.len())
+        .flat_map(|song_index| {
+            (0..args.scenarios).map(move |i| {
+                let mut rng = Rng(args.seed ^ ((song_index as u64) << 32) ^ u64::from(i));
+                (song_index, rng.next())
+            })
+        })
+        .collect();
+
+    let results = parallel_map(&jobs, available_threads(), |&(song_index, seed)| {
+        let commands = generate_commands(seed, smp_clocks, n_sound_effects);
+        run_scenario(&song_states[song_index].1, &commands, smp_clocks)
+    });
+
+    if let Some(dir) = &args.output_dir {
+        std::fs::create_dir_all(dir)
+            .unwrap_or_else(|e| panic!("Cannot create {}: {e}", dir.display()));
+    }
+
+    let mut reports = Vec::with_capacity(song_states.len());
+
+    for (song_index, (song, _)) in song_states.iter().enumerate() {
+        let song_results: Vec<(u64, &ScenarioResult)> = jobs
+            .iter()
+            .zip(&results)
+            .filter(|((i, _), _)| *i == song_index)
+            .map(|((_, seed), r)| (*seed, r))
+            .collect();
+
+        let worst_ack = song_results
+            .iter()
+            .filter(|(_, r)| r.ack.count > 0)
+            .max_by_key(|(_, r)| r.ack.max_smp_clocks);
+        let worst_key_on = song_results
+            .iter()
+            .filter(|(_, r)| r.key_on.count > 0)
+            .max_by_key(|(_, r)| r.key_on.max_smp_clocks);
+
+        let combine = |f: fn(&ScenarioResult) -> Latency| {
+            let (count, total, max) = song_results.iter().fold((0, 0.0, 0), |acc, (_, r)| {
+                let l = f(r);
+                (
+                    acc.0 + l.count,
+                    acc.1 + l.mean_smp_clocks.unwrap_or(0.0) * l.count as f64,
+                    acc.2.max(l.max_smp_clocks),
+                )
+            });
+            Latency {
+                count,
+                mean_smp_clocks: (count > 0).then(|| total / count as f64),
+                max_smp_clocks: max,
+            }
+        };
+        let ack = combine(|r| r.ack);
+        let key_on = combine(|r| r.key_on);
+
+        if let Some(dir) = &args.output_dir {
+            let scenario = |seed: u64, r: &ScenarioResult| Scenario {
+                song: song.clone(),
+                seed,
+                smp_clocks,
+                max_ack_smp_clocks: r.ack.max_smp_clocks,
+                max_key_on_smp_clocks: r.key_on.max_smp_clocks,
+                writes: r.writes.clone(),
+            };
+            if let Some((seed, r)) = worst_ack {
+                write_scenario(dir, format!("{song}-ack.json"), &scenario(*seed, r));
+            }
+            if let Some((seed, r)) = worst_key_on {
+                write_scenario(dir, format!("{song}-key-on.json"), &scenario(*seed, r));
+            }
+        }
+
+        reports.push(SongReport {
+            song: song.clone(),
+            scenarios: args.scenarios,
+            commands: ack.count,
+            unacknowledged: song_results.iter().map(|(_, r)| r.unacknowledged).sum(),
+            ack,
+            key_on,
+            worst_ack_seed: worst_ack.map(|(s, _)| *s),
+            worst_key_on_seed: worst_key_on.map(|(s, _)| *s),
+        });
+    }
+
+    println!("{}", serde_json::to_string_pretty(&reports).unwrap());
+}
@@ -0,0 +1,157 @@
+//! Loader transfer benchmark
+//!
+//! Emulates the S-CPU side of the loader protocol (see `audio-driver/src/io-commands.wiz`) and
+//! transfers the audio driver to Audio-RAM with both the 2 byte (`Transfer_ToLoader`) and the
+//! 3 byte (`Transfer_ToLoader_Fast`) handshakes, then prints the number of bytes transferred per
+//! S-CPU frame as JSON (to stdout).
+//!
+//! The S-CPU is assumed to write the next bytes to the IO ports as soon as the loader
+//! acknowledges the previous spinlock, so the results are the upper bound of the loader's
+//! throughput.  The S-CPU APIs also spend time reading the data and testing for the end of the data.
+//!
+//! This is an example and not a benchmark target as it needs the audio driver, which
+//! shvc-sound-emu cannot depend on.
+//!
+//! Run with `cargo run --release --example loader_benchmark`.
+
+use compiler::{audio_driver, driver_constants::addresses};
+use serde::Serialize;
+use shvc_sound_emu::ShvcSoundEmu;
+
+/// LoaderDataType.CODE
+const LOADER_DATA_TYPE_CODE: u8 = 0;
+/// LoaderDataType.FAST_TRANSFER_BIT
+const FAST_TRANSFER_FLAG: u8 = 1 << 4;
+
+const LOADER_READY_L: u8 = b'L';
+const LOADER_READY_H: u8 = b'D';
+
+const SPINLOCK_MASK: u8 = 0x0f;
+const SPINLOCK_COMPLETE: u8 = 0x80;
+
+/// NTSC S-CPU frame rate
+const FRAMES_PER_SECOND: f64 = 60.0988;
+
+/// Maximum number of S-SMP clocks to wait for the loader to write to an IO port
+const TIMEOUT: u64 = ShvcSoundEmu::SMP_CLOCKS_PER_SECOND;
+
+#[derive(Serialize)]
+struct ModeResult {
+    name: &'static str,
+    bytes_per_handshake: usize,
+    bytes: usize,
+    handshakes: usize,
+    smp_clocks: u64,
+    bytes_per_frame: f64,
+}
+
+#[derive(Serialize)]
+struct BenchmarkResult {
+    normal: ModeResult,
+    fast: ModeResult,
+    speedup: f64,
+}
+
+/// Waits until the loader writes `value` to IO port 3.
+fn wait_for_port_3(emu: &mut ShvcSoundEmu, value: u8) {
+    while emu.read_io_ports()[3] != value {
+        let r = emu.run_until_port_write(1 << 3, TIMEOUT);
+        if !r.hit {
+            panic!("Loader timeout (expected 0x{value:02x} on port 3)");
+        }
+    }
+}
+
+fn benchmark_mode(name: &'static str, data: &[u8], fast: bool) -> ModeResult {
+    let bytes_per_handshake = if fast { 3 } else { 2 };
+
+    let mut emu = ShvcSoundEmu::new(&[0; 64]);
+
+    let loader_addr = usize::from(addresses::LOADER);
+    emu.apuram_mut()[loader_addr..loader_addr + audio_driver::LOADER.len()]
+        .copy_from_slice(audio_driver::LOADER);
+
+    emu.reset(shvc_sound_emu::ResetRegisters {
+        pc: addresses::LOADER,
+        a: 0,
+        x: 0,
+        y: 0,
+        psw: 0,
+        sp: 0xff,
+        esa: 0,
+        edl: 0,
+    });
+
+    // Step 1: wait for the loader
+    wait_for_port_3(&mut emu, LOADER_READY_H);
+    assert_eq!(emu.read_io_ports()[2], LOADER_READY_L);
+
+    // Step 2 & 3: send the data type and wait for the acknowledgement
+    let data_type = match fast {
+        true => LOADER_DATA_TYPE_CODE | FAST_TRANSFER_FLAG,
+        false => LOADER_DATA_TYPE_CODE,
+    };
+    emu.write_io_ports([0, data_type, LOADER_READY_L, LOADER_READY_H]);
+    wait_for_port_3(&mut emu, 0);
+
+    let start = emu.counters().smp_clocks;
+
+    // Step 4 - 6: transfer the data
+    let mut handshakes = 0;
+    let mut spinlock = 0;
+    for chunk in data.chunks(bytes_per_handshake) {
+        let mut d = [0; 3];
+        d[..chunk.len()].copy_from_slice(chunk);
+
+        spinlock = (spinlock + 1) & SPINLOCK_MASK;
+        match fast {
+            true => emu.write_io_ports([d[0], d[1], d[2], spinlock]),
+            false => emu.write_io_ports([0, d[0], d[1], spinlock]),
+        }
+        wait_for_port_3(&mut emu, spinlock);
+
+        handshakes += 1;
+    }
+
+    // Step 7 & 8: end the transfer
+    emu.write_io_ports([0, 0, 0, SPINLOCK_COMPLETE]);
+    wait_for_port_3(&mut emu, SPINLOCK_COMPLETE);
+
+    let smp_clocks = emu.counters().smp_clocks - start;
+
+    let code_addr = usize::from(addresses::DRIVER_CODE);
+    assert_eq!(
+        &emu.apuram()[code_addr..code_addr + data.len()],
+        data,
+        "{name} transfer corrupted the data"
+    );
+
+    let frames =
+        smp_clocks as f64 / (ShvcSoundEmu::SMP_CLOCKS_PER_SECOND as f64 / FRAMES_PER_SECOND);
+
+    ModeResult {
+        name,
+        bytes_per_handshake,
+        bytes: data.len(),
+        handshakes,
+        smp_clocks,
+        bytes_per_frame: data.len() as f64 / frames,
+    }
+}
+
+fn main() {
+    let data = audio_driver::AUDIO_DRIVER;
+
+    let normal = benchmark_mode("normal", data, false);
+    let fast = benchmark_mode("fast", data, true);
+
+    let speedup = fast.bytes_per_frame / normal.bytes_per_frame;
+
+    let result = BenchmarkResult {
+        normal,
+        fast,
+        speedup,
+    };
+
+    println!("{}", serde_json::to_string_pretty(&result).unwrap());
+}
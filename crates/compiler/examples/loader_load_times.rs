@@ -0,0 +1,318 @@
+//! Loader load times
+//!
+//! Loads the audio driver, common audio data and every song of one or more projects with
+//! `ShvcSoundEmu::simulate_loader_transfers()` (which models the timing of the S-CPU APIs' transfer
+//! loops) and prints the number of frames each transfer took as JSON (to stdout).
+//!
+//! The audio driver is transferred by a blocking `Tad_Init` call, the common audio data and songs
+//! are transferred `--bytes-per-frame` bytes per `Tad_Process` call (default 256, the
+//! `TAD_DEFAULT_TRANSFER_PER_FRAME` value).  `--compress` transfers compressed common audio data
+//! and songs.
+//!
+//! Exits with an error if a transfer timed out, corrupted the data or took more frames than a
+//! loader that never keeps the S-CPU waiting would (a loader performance regression).
+//!
+//! This is an example and not a test as it requires project files.
+//!
+//! Run with `cargo run --release --example loader_load_times -- [--bytes-per-frame N] [--compress] PROJECT_FILE...`.
+
+use compiler::{
+    audio_driver,
+    common_audio_data::build_common_audio_data,
+    compression,
+    data::{load_project_file, load_text_file_with_limit, validate_project_file_names},
+    driver_constants::{addresses, LoaderDataType},
+    mml::compile_mml,
+    samples::build_sample_and_instrument_data,
+    sfx_file::load_sound_effects_file,
+    sound_effects::{
+        blank_compiled_sound_effects, combine_sound_effects, compile_sound_effects_file,
+        CompiledSfxSubroutines,
+    },
+};
+use serde::Serialize;
+use shvc_sound_emu::{LoaderTransfer, LoaderTransferResult, ScpuLoaderTiming, ShvcSoundEmu};
+
+use std::path::PathBuf;
+
+/// LoaderDataType.CODE
+const LOADER_DATA_TYPE_CODE: u8 = 0;
+/// LoaderDataType.COMMON_DATA
+const LOADER_DATA_TYPE_COMMON_DATA: u8 = 1;
+/// LoaderDataType.FAST_TRANSFER_BIT
+const FAST_TRANSFER_FLAG: u8 = 1 << 4;
+/// LoaderDataType.COMPRESSED_BIT
+const COMPRESSED_FLAG: u8 = 1 << 5;
+
+/// TAD_DEFAULT_TRANSFER_PER_FRAME
+const DEFAULT_BYTES_PER_FRAME: u32 = 256;
+
+#[derive(Serialize)]
+struct TransferTime {
+    name: String,
+    bytes: usize,
+    transferred_bytes: usize,
+    frames: u64,
+    /// None for a blocking transfer
+    ideal_frames: Option<u64>,
+    handshakes: u32,
+    scpu_wait_percent: f64,
+}
+
+#[derive(Serialize)]
+struct ProjectLoadTimes {
+    project: String,
+    bytes_per_frame: u32,
+    compressed: bool,
+    audio_driver: TransferTime,
+    common_audio_data: TransferTime,
+    songs: Vec<TransferTime>,
+}
+
+struct Args {
+    bytes_per_frame: u32,
+    compress: bool,
+    project_files: Vec<PathBuf>,
+}
+
+fn parse_args() -> Args {
+    let mut args = Args {
+        bytes_per_frame: DEFAULT_BYTES_PER_FRAME,
+        compress: false,
+        project_files: Vec::new(),
+    };
+
+    let mut it = std::env::args_os().skip(1);
+    while let Some(a) = it.next() {
+        match a.to_str() {
+            Some("--bytes-per-frame") => {
+                args.bytes_per_frame = it
+                    .next()
+                    .and_then(|v| v.to_str()?.parse().ok())
+                    .expect("--bytes-per-frame expects an integer");
+            }
+            Some("--compress") => args.compress = true,
+            _ => args.project_files.push(PathBuf::from(a)),
+        }
+    }
+
+    if args.project_files.is_empty() {
+        panic!("Expected at least one project file");
+    }
+
+    args
+}
+
+/// Number of frames needed by a loader that acknowledges every spinlock immediately
+/// (the `Tad_Process` call that sends the LoaderDataType and one call per `bytes_per_frame` bytes)
+fn ideal_frames(size: usize, bytes_per_frame: u32, bytes_per_handshake: usize) -> Option<u64> {
+    if bytes_per_frame == 0 {
+        return None;
+    }
+
+    let mut remaining = size;
+    let mut frames = 1;
+    loop {
+        let n = remaining.min(bytes_per_frame as usize);
+        let handshakes = n.div_ceil(bytes_per_handshake).max(1);
+        remaining = remaining.saturating_sub(handshakes * bytes_per_handshake);
+        frames += 1;
+
+        if remaining == 0 {
+            return Some(frames);
+        }
+    }
+}
+
+fn transfer(
+    emu: &mut ShvcSoundEmu,
+    timing: &ScpuLoaderTiming,
+    name: String,
+    data_type: u8,
+    data: &[u8],
+    compress: bool,
+    addr: u16,
+) -> TransferTime {
+    let (data_type, transferred) = match compress {
+        true => (data_type | COMPRESSED_FLAG, compression::compress(data)),
+        false => (data_type, data.to_vec()),
+    };
+    let bytes_per_handshake = match data_type & (FAST_TRANSFER_FLAG | COMPRESSED_FLAG) {
+        FAST_TRANSFER_FLAG => 3,
+        _ => 2,
+    };
+
+    let r: LoaderTransferResult = match emu
+        .simulate_loader_transfers(
+            timing,
+            &[LoaderTransfer {
+                data_type,
+                data: transferred.clone(),
+            }],
+        )
+        .first()
+    {
+        Some(r) if r.ok => *r,
+        _ => panic!("{name}: loader timeout"),
+    };
+
+    let a = usize::from(addr);
+    assert_eq!(
+        &emu.apuram()[a..a + data.len()],
+        data,
+        "{name}: transfer corrupted the data"
+    );
+
+    let ideal_frames = ideal_frames(
+        transferred.len(),
+        timing.bytes_per_frame,
+        bytes_per_handshake,
+    );
+    if let Some(ideal) = ideal_frames {
+        if r.frames > ideal {
+            panic!(
+                "{name}: took {} frames (expected {ideal}), the loader is too slow for the S-CPU API",
+                r.frames
+            );
+        }
+    }
+
+    TransferTime {
+        name,
+        bytes: data.len(),
+        transferred_bytes: transferred.len(),
+        frames: r.frames,
+        ideal_frames,
+        handshakes: r.handshakes,
+        scpu_wait_percent: r.wait_clocks as f64 * 100.0 / r.busy_clocks.max(1) as f64,
+    }
+}
+
+fn load_times(pf_path: PathBuf, args: &Args) -> ProjectLoadTimes {
+    let project = load_project_file(&pf_path).unwrap();
+    let project = validate_project_file_names(project).unwrap();
+
+    let samples = build_sample_and_instrument_data(&project).unwrap();
+
+    let (sfx_subs, sfx) = match &project.sound_effect_file {
+        Some(source) => {
+            let sfx_file = load_sound_effects_file(source, &project.parent_path).unwrap();
+            let (subs, sfx) = compile_sound_effects_file(
+                &sfx_file,
+                &project.instruments_and_samples,
+                samples.pitch_table(),
+            )
+            .unwrap();
+            let sfx =
+                combine_sound_effects(&sfx, &project.sfx_export_order, project.default_sfx_flags)
+                    .unwrap();
+            (subs, sfx)
+        }
+        None => (
+            CompiledSfxSubroutines::blank(),
+            blank_compiled_sound_effects(),
+        ),
+    };
+
+    let common_audio_data = build_common_audio_data(&samples, &sfx_subs, &sfx).unwrap();
+
+    let mut emu = ShvcSoundEmu::new(&[0; 64]);
+
+    let loader_addr = usize::from(addresses::LOADER);
+    emu.apuram_mut()[loader_addr..loader_addr + audio_driver::LOADER.len()]
+        .copy_from_slice(audio_driver::LOADER);
+
+    emu.reset(shvc_sound_emu::ResetRegisters {
+        pc: addresses::LOADER,
+        a: 0,
+        x: 0,
+        y: 0,
+        psw: 0,
+        sp: 0xff,
+        esa: 0,
+        edl: 0,
+    });
+
+    // `Tad_Init` transfers the audio driver with a blocking fast transfer
+    let audio_driver = transfer(
+        &mut emu,
+        &ScpuLoaderTiming::ntsc(0),
+        "audio driver".to_owned(),
+        LOADER_DATA_TYPE_CODE | FAST_TRANSFER_FLAG,
+        audio_driver::AUDIO_DRIVER,
+        false,
+        addresses::DRIVER_CODE,
+    );
+
+    let timing = ScpuLoaderTiming::ntsc(args.bytes_per_frame);
+
+    let common_audio_data_time = transfer(
+        &mut emu,
+        &timing,
+        "common audio data".to_owned(),
+        LOADER_DATA_TYPE_COMMON_DATA,
+        common_audio_data.data(),
+        args.compress,
+        addresses::COMMON_DATA,
+    );
+
+    // Every song is loaded after the common audio data
+    let state = emu.save_state();
+
+    let songs = project
+        .songs
+        .list()
+        .iter()
+        .map(|song| {
+            let mml_file = load_text_file_with_limit(&song.source, &project.parent_path).unwrap();
+            let song_data = compile_mml(
+                &mml_file,
+                Some(song.name.clone()),
+                &project.instruments_and_samples,
+                samples.pitch_table(),
+            )
+            .unwrap();
+
+            emu.load_state(&state).unwrap();
+
+            let data_type = LoaderDataType {
+                stereo_flag: true,
+                play_song: true,
+                skip_echo_buffer_reset: false,
+                tick_budget: false,
+            }
+            .driver_value();
+
+            transfer(
+                &mut emu,
+                &timing,
+                song.name.as_str().to_owned(),
+                data_type | FAST_TRANSFER_FLAG,
+                song_data.data(),
+                args.compress,
+                common_audio_data.song_data_addr(),
+            )
+        })
+        .collect();
+
+    ProjectLoadTimes {
+        project: pf_path.display().to_string(),
+        bytes_per_frame: args.bytes_per_frame,
+        compressed: args.compress,
+        audio_driver,
+        common_audio_data: common_audio_data_time,
+        songs,
+    }
+}
+
+fn main() {
+    let args = parse_args();
+
+    let results: Vec<ProjectLoadTimes> = args
+        .project_files
+        .iter()
+        .map(|p| load_times(p.clone(), &args))
+        .collect();
+
+    println!("{}", serde_json::to_string_pretty(&results).unwrap());
+}
@@ -0,0 +1,174 @@
+//! MML compile benchmark
+//!
+//! Compiles every song of one or more projects `--iterations` times and prints the median
+//! compile time and the number of heap allocations of a single `compile_mml()` call as JSON
+//! (to stdout).
+//!
+//! The song is compiled with the same function tad-gui uses for the live preview, so the
+//! results are the time between the user pausing typing and the compiler thread having a
+//! compiled song (excluding tad-gui's cursor tracking, the `mml_tracking` feature).
+//!
+//! Allocations are counted with a global allocator that wraps the system allocator.
+//!
+//! This is an example and not a benchmark target as it requires command line input parameters
+//! (the project files).
+//!
+//! Run with `cargo run --release --example mml_compile_benchmark -- [--iterations N] PROJECT_FILE...`.
+
+use compiler::{
+    data::{load_project_file, load_text_file_with_limit, validate_project_file_names},
+    mml::compile_mml,
+    samples::build_sample_and_instrument_data,
+};
+use serde::Serialize;
+
+use std::alloc::{GlobalAlloc, Layout, System};
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::time::Instant;
+
+const DEFAULT_ITERATIONS: u32 = 50;
+
+struct CountingAllocator;
+
+static ALLOCATIONS: AtomicU64 = AtomicU64::new(0);
+static ALLOCATED_BYTES: AtomicU64 = AtomicU64::new(0);
+
+unsafe impl GlobalAlloc for CountingAllocator {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        ALLOCATED_BYTES.fetch_add(layout.size() as u64, Ordering::Relaxed);
+        System.alloc(layout)
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        System.dealloc(ptr, layout)
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        ALLOCATED_BYTES.fetch_add(new_size as u64, Ordering::Relaxed);
+        System.realloc(ptr, layout, new_size)
+    }
+}
+
+#[global_allocator]
+static GLOBAL: CountingAllocator = CountingAllocator;
+
+#[derive(Serialize)]
+struct SongResult {
+    name: String,
+    mml_bytes: usize,
+    median_ms: f64,
+    max_ms: f64,
+    allocations: u64,
+    allocated_bytes: u64,
+}
+
+#[derive(Serialize)]
+struct ProjectResult {
+    project: String,
+    songs: Vec<SongResult>,
+}
+
+struct Args {
+    iterations: u32,
+    project_files: Vec<PathBuf>,
+}
+
+fn parse_args() -> Args {
+    let mut iterations = DEFAULT_ITERATIONS;
+    let mut project_files = Vec::new();
+
+    let mut it = std::env::args_os().skip(1);
+    while let Some(a) = it.next() {
+        match a.to_str() {
+            Some("--iterations") => {
+                iterations = it
+                    .next()
+                    .and_then(|v| v.to_str()?.parse().ok())
+                    .filter(|&i| i > 0)
+                    .expect("--iterations expects a positive integer");
+            }
+            _ => project_files.push(PathBuf::from(a)),
+        }
+    }
+
+    if project_files.is_empty() {
+        panic!("Expected arguments: [--iterations N] PROJECT_FILE...");
+    }
+
+    Args {
+        iterations,
+        project_files,
+    }
+}
+
+fn benchmark_project(pf_path: &Path, iterations: u32) -> ProjectResult {
+    let project = load_project_file(pf_path).unwrap();
+    let project = validate_project_file_names(project).unwrap();
+
+    let samples = build_sample_and_instrument_data(&project).unwrap();
+
+    let songs = project
+        .songs
+        .list()
+        .iter()
+        .map(|song| {
+            let mml_file = load_text_file_with_limit(&song.source, &project.parent_path).unwrap();
+
+            let compile = || {
+                compile_mml(
+                    &mml_file,
+                    Some(song.name.clone()),
+                    &project.instruments_and_samples,
+                    samples.pitch_table(),
+                )
+                .unwrap()
+            };
+
+            let allocations = ALLOCATIONS.load(Ordering::Relaxed);
+            let allocated_bytes = ALLOCATED_BYTES.load(Ordering::Relaxed);
+
+            drop(compile());
+
+            let allocations = ALLOCATIONS.load(Ordering::Relaxed) - allocations;
+            let allocated_bytes = ALLOCATED_BYTES.load(Ordering::Relaxed) - allocated_bytes;
+
+            let mut times: Vec<f64> = (0..iterations)
+                .map(|_| {
+                    let start = Instant::now();
+                    drop(compile());
+                    start.elapsed().as_secs_f64() * 1000.0
+                })
+                .collect();
+            times.sort_by(f64::total_cmp);
+
+            SongResult {
+                name: song.name.as_str().to_owned(),
+                mml_bytes: mml_file.contents.len(),
+                median_ms: times[times.len() / 2],
+                max_ms: times[times.len() - 1],
+                allocations,
+                allocated_bytes,
+            }
+        })
+        .collect();
+
+    ProjectResult {
+        project: pf_path.display().to_string(),
+        songs,
+    }
+}
+
+fn main() {
+    let args = parse_args();
+
+    let results: Vec<_> = args
+        .project_files
+        .iter()
+        .map(|p| benchmark_project(p, args.iterations))
+        .collect();
+
+    println!("{}", serde_json::to_string_pretty(&results).unwrap());
+}
@@ -0,0 +1,286 @@
+//! Profile-guided optimization training workload
+//!
+//! Runs the emulator through a representative workload, to generate the profiles used by the
+//! `SHVC_SOUND_EMU_PGO_USE` build mode (see `crates/shvc-sound-emu/README.md`):
+//!  * boot: transfers the audio driver, common audio data and every song with the loader
+//!    (normal and fast transfers) and waits for the audio driver to start.
+//!  * playback: plays every song.
+//!  * echo: plays the songs that use the echo buffer for twice as long.
+//!  * sfx storm: plays every sound effect (in export order) as fast as the audio driver
+//!    acknowledges the commands, while a song is playing.
+//!
+//! The emulator uses the same settings as tad-gui (fast paths enabled).
+//! The time spent in each scenario is printed to stdout.
+//!
+//! This is an example and not a benchmark target as it requires a command line input parameter
+//! (the project file) and needs the audio driver and the compiler, which shvc-sound-emu cannot
+//! depend on.
+//!
+//! Run with `cargo run --release --example pgo_training -- [--seconds N] PROJECT_FILE`.
+
+use compiler::{
+    audio_driver,
+    common_audio_data::{build_common_audio_data, CommonAudioData},
+    data::{load_project_file, load_text_file_with_limit, validate_project_file_names},
+    driver_constants::{
+        addresses, io_commands, LoaderDataType, IO_COMMAND_I_MASK, IO_COMMAND_MASK,
+    },
+    mml::compile_mml,
+    samples::build_sample_and_instrument_data,
+    sfx_file::load_sound_effects_file,
+    songs::SongData,
+    sound_effects::{
+        blank_compiled_sound_effects, combine_sound_effects, compile_sound_effects_file,
+        CompiledSfxSubroutines,
+    },
+};
+use shvc_sound_emu::{LoaderTransfer, ScpuLoaderTiming, ShvcSoundEmu};
+
+use std::path::PathBuf;
+use std::time::Instant;
+
+/// LoaderDataType.CODE
+const LOADER_DATA_TYPE_CODE: u8 = 0;
+/// LoaderDataType.COMMON_DATA
+const LOADER_DATA_TYPE_COMMON_DATA: u8 = 1;
+/// LoaderDataType.FAST_TRANSFER_BIT
+const FAST_TRANSFER_FLAG: u8 = 1 << 4;
+
+/// TAD_DEFAULT_TRANSFER_PER_FRAME
+const BYTES_PER_FRAME: u32 = 256;
+
+/// Default number of seconds to play each song
+const DEFAULT_SECONDS: u32 = 20;
+
+/// Number of songs the sfx storm is played over
+const SFX_STORM_SONGS: usize = 4;
+
+struct Args {
+    seconds: u32,
+    project_file: PathBuf,
+}
+
+fn parse_args() -> Args {
+    let mut seconds = DEFAULT_SECONDS;
+    let mut project_file = None;
+
+    let mut it = std::env::args_os().skip(1);
+    while let Some(a) = it.next() {
+        match a.to_str() {
+            Some("--seconds") => {
+                seconds = it
+                    .next()
+                    .and_then(|v| v.to_str()?.parse().ok())
+                    .expect("--seconds expects an integer");
+            }
+            _ => {
+                if project_file.replace(PathBuf::from(a)).is_some() {
+                    panic!("Expected a single project file");
+                }
+            }
+        }
+    }
+
+    Args {
+        seconds,
+        project_file: project_file.expect("Expected argument: project file"),
+    }
+}
+
+/// An emulator running the audio driver
+struct Driver {
+    emu: ShvcSoundEmu,
+    previous_command: u8,
+}
+
+impl Driver {
+    /// Loads the audio driver, common audio data and song with the loader, then starts the song.
+    fn boot(common_audio_data: &CommonAudioData, song: &SongData, fast_transfer: bool) -> Self {
+        let mut emu = ShvcSoundEmu::new(&[0; 64]);
+
+        let loader_addr = usize::from(addresses::LOADER);
+        emu.apuram_mut()[loader_addr..loader_addr + audio_driver::LOADER.len()]
+            .copy_from_slice(audio_driver::LOADER);
+
+        emu.reset(shvc_sound_emu::ResetRegisters {
+            pc: addresses::LOADER,
+            a: 0,
+            x: 0,
+            y: 0,
+            psw: 0,
+            sp: 0xff,
+            esa: 0,
+            edl: 0,
+        });
+
+        let fast_flag = match fast_transfer {
+            true => FAST_TRANSFER_FLAG,
+            false => 0,
+        };
+        let song_data_type = LoaderDataType {
+            stereo_flag: true,
+            play_song: true,
+            skip_echo_buffer_reset: false,
+            tick_budget: false,
+        }
+        .driver_value();
+
+        // `Tad_Init` transfers the audio driver with a blocking fast transfer
+        let r = emu.simulate_loader_transfers(
+            &ScpuLoaderTiming::ntsc(0),
+            &[LoaderTransfer {
+                data_type: LOADER_DATA_TYPE_CODE | FAST_TRANSFER_FLAG,
+                data: audio_driver::AUDIO_DRIVER.to_vec(),
+            }],
+        );
+        assert!(r.iter().all(|r| r.ok), "audio driver transfer failed");
+
+        let r = emu.simulate_loader_transfers(
+            &ScpuLoaderTiming::ntsc(BYTES_PER_FRAME),
+            &[
+                LoaderTransfer {
+                    data_type: LOADER_DATA_TYPE_COMMON_DATA | fast_flag,
+                    data: common_audio_data.data().to_vec(),
+                },
+                LoaderTransfer {
+                    data_type: song_data_type | fast_flag,
+                    data: song.data().to_vec(),
+                },
+            ],
+        );
+        assert!(r.iter().all(|r| r.ok), "loader transfer failed");
+
+        let r = emu.run_until_pc(
+            addresses::MAINLOOP_CODE,
+            ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+        );
+        assert!(r.hit, "audio driver did not start");
+
+        let mut driver = Self {
+            emu,
+            // The audio driver starts paused
+            previous_command: io_commands::PAUSE,
+        };
+        assert!(driver.try_send_command(io_commands::UNPAUSE, 0, 0));
+
+        driver
+    }
+
+    /// Sends an IO command if the previous command has been acknowledged
+    fn try_send_command(&mut self, command: u8, param1: u8, param2: u8) -> bool {
+        if self.emu.read_io_ports()[0] != self.previous_command {
+            return false;
+        }
+
+        let command =
+            ((self.previous_command ^ u8::MAX) & IO_COMMAND_I_MASK) | (command & IO_COMMAND_MASK);
+
+        self.emu.write_io_ports([command, param1, param2, 0]);
+        self.previous_command = command;
+
+        true
+    }
+
+    fn play(&mut self, seconds: u32, mut between_buffers: impl FnMut(&mut Self)) {
+        let buffers = seconds as usize * ShvcSoundEmu::SAMPLE_RATE as usize
+            / ShvcSoundEmu::AUDIO_BUFFER_SAMPLES;
+
+        for _ in 0..buffers {
+            self.emu.emulate();
+            between_buffers(self);
+        }
+    }
+}
+
+fn scenario(name: &str, f: impl FnOnce()) {
+    let start = Instant::now();
+    f();
+    println!("{name}: {:.2}s", start.elapsed().as_secs_f64());
+}
+
+fn main() {
+    let args = parse_args();
+
+    let project = load_project_file(&args.project_file).unwrap();
+    let project = validate_project_file_names(project).unwrap();
+
+    let samples = build_sample_and_instrument_data(&project).unwrap();
+
+    let (sfx_subs, sfx) = match &project.sound_effect_file {
+        Some(source) => {
+            let sfx_file = load_sound_effects_file(source, &project.parent_path).unwrap();
+            let (subs, sfx) = compile_sound_effects_file(
+                &sfx_file,
+                &project.instruments_and_samples,
+                samples.pitch_table(),
+            )
+            .unwrap();
+            let sfx =
+                combine_sound_effects(&sfx, &project.sfx_export_order, project.default_sfx_flags)
+                    .unwrap();
+            (subs, sfx)
+        }
+        None => (
+            CompiledSfxSubroutines::blank(),
+            blank_compiled_sound_effects(),
+        ),
+    };
+    let n_sfx = project.sfx_export_order.export_order.len();
+
+    let common_audio_data = build_common_audio_data(&samples, &sfx_subs, &sfx).unwrap();
+
+    let songs: Vec<SongData> = project
+        .songs
+        .list()
+        .iter()
+        .map(|song| {
+            let mml_file = load_text_file_with_limit(&song.source, &project.parent_path).unwrap();
+
+            compile_mml(
+                &mml_file,
+                Some(song.name.clone()),
+                &project.instruments_and_samples,
+                samples.pitch_table(),
+            )
+            .unwrap()
+        })
+        .collect();
+
+    scenario("boot", || {
+        for song in &songs {
+            Driver::boot(&common_audio_data, song, false);
+            Driver::boot(&common_audio_data, song, true);
+        }
+    });
+
+    scenario("playback", || {
+        for song in &songs {
+            Driver::boot(&common_audio_data, song, true).play(args.seconds, |_| ());
+        }
+    });
+
+    scenario("echo", || {
+        for song in songs
+            .iter()
+            .filter(|s| s.metadata().echo_buffer.edl_register() > 0)
+        {
+            Driver::boot(&common_audio_data, song, true).play(args.seconds * 2, |_| ());
+        }
+    });
+
+    if n_sfx > 0 {
+        scenario("sfx storm", || {
+            for song in songs.iter().take(SFX_STORM_SONGS) {
+                let mut sfx_id = 0;
+                let mut pan = 0;
+
+                Driver::boot(&common_audio_data, song, true).play(args.seconds, |d| {
+                    if d.try_send_command(io_commands::PLAY_SOUND_EFFECT, sfx_id, pan) {
+                        sfx_id = ((usize::from(sfx_id) + 1) % n_sfx) as u8;
+                        pan = pan.wrapping_add(37) % 129;
+                    }
+                });
+            }
+        });
+    }
+}
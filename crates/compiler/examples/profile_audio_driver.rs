@@ -0,0 +1,139 @@
+//! Audio driver profiler
+//!
+//! Plays every song in a project (or a single song) with the S-SMP profiler enabled and prints
+//! the S-SMP cycles spent in each audio driver routine.
+//!
+//! Each instruction's cycles are added to the closest driver code symbol at or before the
+//! instruction.  Cycles spent outside of the audio driver code are added to `(outside driver)`.
+//!
+//! This is an example and not a test as profile_audio_driver requires command line input
+//! parameters (the project file and an optional song name).
+//!
+//! Run with `cargo run --release --example profile_audio_driver examples/example-project.terrificaudio [song]`.
+
+mod common;
+
+use compiler::{
+    common_audio_data::{build_common_audio_data, CommonAudioData},
+    data::{load_project_file, load_text_file_with_limit, validate_project_file_names},
+    driver_constants::{driver_code_symbol, LoaderDataType},
+    mml::compile_mml,
+    samples::build_sample_and_instrument_data,
+    songs::SongData,
+    sound_effects::{blank_compiled_sound_effects, CompiledSfxSubroutines},
+};
+use shvc_sound_emu::ShvcSoundEmu;
+
+use std::collections::HashMap;
+use std::path::PathBuf;
+
+/// Number of audio buffers to emulate per song (approximately 60 seconds)
+const BUFFERS_TO_PROFILE: usize = 7500;
+
+const OUTSIDE_DRIVER: &str = "(outside driver)";
+
+fn load_song(
+    common_audio_data: &CommonAudioData,
+    song: &SongData,
+    stereo_flag: bool,
+) -> ShvcSoundEmu {
+    common::boot_song(
+        common_audio_data,
+        song,
+        &LoaderDataType {
+            stereo_flag,
+            play_song: true,
+            skip_echo_buffer_reset: false,
+            tick_budget: false,
+        },
+    )
+}
+
+/// Adds the S-SMP clocks in the profiler histogram to the driver code symbols
+fn add_profile(symbols: &mut HashMap<&'static str, u64>, profile: &[u64]) {
+    for (addr, &clocks) in profile.iter().enumerate() {
+        if clocks > 0 {
+            let name = match driver_code_symbol(addr as u16) {
+                Some((name, _offset)) => name,
+                None => OUTSIDE_DRIVER,
+            };
+            *symbols.entry(name).or_default() += clocks;
+        }
+    }
+}
+
+fn profile_song(common_audio_data: &CommonAudioData, song: &SongData) -> Vec<u64> {
+    const STEREO_FLAG: bool = true;
+
+    let mut emu = load_song(common_audio_data, song, STEREO_FLAG);
+    emu.set_profiler_enabled(true);
+
+    for _ in 0..BUFFERS_TO_PROFILE {
+        emu.emulate();
+    }
+
+    emu.profile().unwrap().to_vec()
+}
+
+fn print_profile(symbols: HashMap<&'static str, u64>) {
+    let total: u64 = symbols.values().sum();
+
+    let mut symbols: Vec<_> = symbols.into_iter().collect();
+    symbols.sort_by(|a, b| b.1.cmp(&a.1).then(a.0.cmp(b.0)));
+
+    println!("{:>14} {:>7}  symbol", "S-SMP cycles", "%");
+    for (name, clocks) in symbols {
+        // 2 clocks per S-SMP cycle
+        let cycles = clocks / 2;
+        let percent = clocks as f64 * 100.0 / total as f64;
+        println!("{cycles:>14} {percent:>6.2}%  {name}");
+    }
+}
+
+fn main() {
+    let mut args = std::env::args_os();
+
+    if args.len() != 2 && args.len() != 3 {
+        panic!("Expected arguments: project file [song name]");
+    }
+    let pf_path = PathBuf::from(args.nth(1).unwrap());
+    let song_name = args.next().map(|s| s.to_string_lossy().into_owned());
+
+    let project = load_project_file(&pf_path).unwrap();
+    let project = validate_project_file_names(project).unwrap();
+
+    let samples = build_sample_and_instrument_data(&project).unwrap();
+
+    let sfx_subs = CompiledSfxSubroutines::blank();
+    let sfx = blank_compiled_sound_effects();
+
+    let common_audio_data = build_common_audio_data(&samples, &sfx_subs, &sfx).unwrap();
+
+    let mut symbols = HashMap::new();
+
+    for song in project.songs.list() {
+        if song_name.as_ref().is_some_and(|n| n != song.name.as_str()) {
+            continue;
+        }
+
+        eprintln!("Profiling song: {}", song.name);
+
+        let mml_file = load_text_file_with_limit(&song.source, &project.parent_path).unwrap();
+
+        let song_data = compile_mml(
+            &mml_file,
+            Some(song.name.clone()),
+            &project.instruments_and_samples,
+            samples.pitch_table(),
+        )
+        .unwrap();
+
+        add_profile(&mut symbols, &profile_song(&common_audio_data, &song_data));
+    }
+
+    if symbols.is_empty() {
+        panic!("No songs profiled");
+    }
+
+    print_profile(symbols);
+}
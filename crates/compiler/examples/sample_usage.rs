@@ -0,0 +1,204 @@
+//! Sample usage
+//!
+//! Plays every song of one or more projects in the emulator (until the end of the song's first
+//! loop or `--seconds` if the song does not loop) and counts the keyons and decoded BRR blocks of
+//! every instrument and sample (see `ShvcSoundEmu::take_source_usage()`).
+//! Prints the usage of each instrument and sample and the names of the instruments and samples
+//! no song uses as JSON (to stdout).
+//!
+//! Instruments and samples with identical BRR data share a source number and are counted
+//! together.  Sound effects are not played.
+//!
+//! This is an example and not a test as it requires project files.
+//!
+//! Run with `cargo run --release --example sample_usage -- [--seconds N] PROJECT_FILE...`.
+
+mod common;
+
+use compiler::{
+    common_audio_data::{build_common_audio_data, CommonAudioData},
+    data::{
+        load_project_file, load_text_file_with_limit, validate_project_file_names,
+        InstrumentOrSample,
+    },
+    driver_constants::{addresses, LoaderDataType},
+    mml::compile_mml,
+    samples::build_sample_and_instrument_data,
+    songs::SongData,
+    sound_effects::{blank_compiled_sound_effects, CompiledSfxSubroutines},
+};
+use serde::Serialize;
+use shvc_sound_emu::{ShvcSoundEmu, SourceUsage};
+
+use std::path::PathBuf;
+
+/// Maximum number of seconds to play a song that does not loop
+const DEFAULT_SECONDS: u32 = 300;
+
+/// Maximum number of ticks to search for a song loop (approximately 10 minutes at the default
+/// tick clock)
+const MAX_LOOP_TICKS: u32 = 100_000;
+
+#[derive(Serialize)]
+struct InstrumentUsage {
+    /// Instruments and samples using the source number
+    names: Vec<String>,
+    source: u8,
+    key_ons: u64,
+    brr_blocks: u64,
+    /// Songs that key on the source number
+    songs: Vec<String>,
+}
+
+#[derive(Serialize)]
+struct ProjectUsage {
+    project: String,
+    instruments_and_samples: Vec<InstrumentUsage>,
+    unused: Vec<String>,
+}
+
+struct Args {
+    seconds: u32,
+    project_files: Vec<PathBuf>,
+}
+
+fn parse_args() -> Args {
+    let mut args = Args {
+        seconds: DEFAULT_SECONDS,
+        project_files: Vec::new(),
+    };
+
+    let mut it = std::env::args_os().skip(1);
+    while let Some(a) = it.next() {
+        match a.to_str() {
+            Some("--seconds") => {
+                args.seconds = it
+                    .next()
+                    .and_then(|v| v.to_str()?.parse().ok())
+                    .expect("--seconds expects an integer");
+            }
+            _ => args.project_files.push(PathBuf::from(a)),
+        }
+    }
+
+    if args.project_files.is_empty() {
+        panic!("Expected at least one project file");
+    }
+
+    args
+}
+
+fn load_song(common_audio_data: &CommonAudioData, song: &SongData) -> ShvcSoundEmu {
+    common::boot_song(
+        common_audio_data,
+        song,
+        &LoaderDataType {
+            stereo_flag: true,
+            play_song: true,
+            skip_echo_buffer_reset: false,
+            tick_budget: false,
+        },
+    )
+}
+
+fn song_source_usage(
+    common_audio_data: &CommonAudioData,
+    song: &SongData,
+    args: &Args,
+) -> SourceUsage {
+    let mut emu = load_song(common_audio_data, song);
+
+    let lp = emu.clone().find_loop(
+        addresses::PROCESS_MUSIC_CHANNELS_CODE,
+        &addresses::driver_state_ranges(),
+        MAX_LOOP_TICKS,
+    );
+    let smp_clocks = match lp {
+        Some(lp) => lp.start_smp_clocks + lp.length_smp_clocks,
+        None => u64::from(args.seconds) * ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+    };
+
+    emu.fast_forward(smp_clocks);
+    emu.take_source_usage()
+}
+
+fn project_usage(pf_path: PathBuf, args: &Args) -> ProjectUsage {
+    let project = load_project_file(&pf_path).unwrap();
+    let project = validate_project_file_names(project).unwrap();
+
+    let samples = build_sample_and_instrument_data(&project).unwrap();
+
+    let sfx_subs = CompiledSfxSubroutines::blank();
+    let sfx = blank_compiled_sound_effects();
+
+    let common_audio_data = build_common_audio_data(&samples, &sfx_subs, &sfx).unwrap();
+
+    let mut usage: Vec<InstrumentUsage> = Vec::new();
+    for (inst, &source) in project
+        .instruments_and_samples
+        .list()
+        .iter()
+        .zip(common_audio_data.instruments_soa_scrn())
+    {
+        let name = match inst {
+            InstrumentOrSample::Instrument(i) => i.name.as_str().to_owned(),
+            InstrumentOrSample::Sample(s) => s.name.as_str().to_owned(),
+        };
+        match usage.iter_mut().find(|u| u.source == source) {
+            Some(u) => u.names.push(name),
+            None => usage.push(InstrumentUsage {
+                names: vec![name],
+                source,
+                key_ons: 0,
+                brr_blocks: 0,
+                songs: Vec::new(),
+            }),
+        }
+    }
+
+    for song in project.songs.list() {
+        let mml_file = load_text_file_with_limit(&song.source, &project.parent_path).unwrap();
+        let song_data = compile_mml(
+            &mml_file,
+            Some(song.name.clone()),
+            &project.instruments_and_samples,
+            samples.pitch_table(),
+        )
+        .unwrap();
+
+        let su = song_source_usage(&common_audio_data, &song_data, args);
+
+        for u in &mut usage {
+            let s = usize::from(u.source);
+            if su.key_ons[s] > 0 {
+                u.key_ons += u64::from(su.key_ons[s]);
+                u.brr_blocks += u64::from(su.brr_blocks[s]);
+                u.songs.push(song.name.as_str().to_owned());
+            }
+        }
+    }
+
+    let unused = usage
+        .iter()
+        .filter(|u| u.key_ons == 0)
+        .flat_map(|u| u.names.iter().cloned())
+        .collect();
+
+    ProjectUsage {
+        project: pf_path.display().to_string(),
+        instruments_and_samples: usage,
+        unused,
+    }
+}
+
+fn main() {
+    let args = parse_args();
+
+    let results: Vec<ProjectUsage> = args
+        .project_files
+        .iter()
+        .map(|p| project_usage(p.clone(), &args))
+        .collect();
+
+    println!("{}", serde_json::to_string_pretty(&results).unwrap());
+}
@@ -0,0 +1,454 @@
+//! Sound effect collision sweep
+//!
+//! Plays every ordered pair of a project's sound effects (and optionally every ordered triple of
+//! a list of sound effects) at several frame offsets and reports which combinations drop or cut
+//! off a sound effect.
+//!
+//! The audio driver is booted once with the blank song.  The first sound effects are split
+//! between the threads of `compiler::parallel`, each thread loads the warm driver's
+//! `save_state()` and plays every sequence on a fork (`ShvcSoundEmu::clone()`) of it.
+//! Sequences that share a prefix share its emulation, so a pair only costs a fork and a single
+//! command.
+//!
+//! Like `Tad_Process`, a command is not sent until the previous command has been acknowledged.
+//! The offsets are the number of frames between a command's acknowledgement and the next
+//! command.
+//!
+//! After a `PLAY_SOUND_EFFECT` command is acknowledged the playing sound effect is read from the
+//! sound effect channels' instruction pointers (as in `tests/sfx_dropout_tests.rs`):
+//!  * A sound effect is dropped if no channel was moved to the start of the sound effect.
+//!    (A sound effect restarted on a channel that has not played a tick of the same sound
+//!    effect is also reported as dropped.)
+//!  * A sound effect is cut off if its channel was moved to a later sound effect while it was
+//!    still playing.
+//!
+//! Prints a summary and every sequence that dropped or cut off a sound effect as JSON (to
+//! stdout).
+//!
+//! This is an example and not a test as it requires project files.
+//!
+//! Run with `cargo run --release --example sfx_collisions -- [--offsets N,N,...]
+//! [--triples SFX,SFX,...] PROJECT_FILE`
+
+// SPDX-FileCopyrightText: © 2025 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+mod common;
+
+use compiler::{
+    audio_driver,
+    common_audio_data::{build_common_audio_data, CommonAudioData},
+    data::{load_project_file, validate_project_file_names},
+    driver_constants::{
+        addresses, io_commands, LoaderDataType, FIRST_SFX_CHANNEL, IO_COMMAND_I_MASK,
+        IO_COMMAND_MASK, N_SFX_CHANNELS,
+    },
+    parallel::{available_threads, parallel_map},
+    samples::build_sample_and_instrument_data,
+    sfx_file::load_sound_effects_file,
+    sound_effects::{combine_sound_effects, compile_sound_effects_file, SfxExportOrder},
+    Pan,
+};
+use serde::Serialize;
+use shvc_sound_emu::ShvcSoundEmu;
+
+use std::path::PathBuf;
+
+const DEFAULT_OFFSETS: [u32; 7] = [0, 1, 2, 4, 8, 16, 32];
+
+/// NTSC frame rate
+const FRAMES_PER_SECOND: f64 = 60.0988;
+
+/// Number of frames emulated after the audio driver has started, before the snapshot is taken
+const WARM_UP_FRAMES: u32 = 4;
+
+const ACK_POLL_SMP_CLOCKS: u64 = 64;
+const ACK_TIMEOUT_SMP_CLOCKS: u64 = ShvcSoundEmu::SMP_CLOCKS_PER_SECOND;
+
+#[derive(Clone, Copy, Serialize)]
+struct CutOff {
+    /// `Collision::sound_effects` index of the sound effect that was cut off
+    sound_effect: usize,
+    /// `Collision::sound_effects` index of the sound effect that took its channel
+    by: usize,
+}
+
+/// A sequence of sound effects (and, once played, the sound effects it dropped or cut off)
+#[derive(Clone, Default)]
+struct Sequence {
+    sound_effects: Vec<u8>,
+    frames_between: Vec<u32>,
+    /// `sound_effects` indexes
+    dropped: Vec<usize>,
+    cut_off: Vec<CutOff>,
+}
+
+#[derive(Serialize)]
+struct Collision {
+    /// In play order
+    sound_effects: Vec<String>,
+    /// Frames between a command's acknowledgement and the next command
+    frames_between: Vec<u32>,
+    /// `sound_effects` indexes of the sound effects that did not start
+    dropped: Vec<usize>,
+    cut_off: Vec<CutOff>,
+}
+
+#[derive(Serialize)]
+struct Report {
+    sound_effects: usize,
+    sequences: u64,
+    /// Number of sequences that dropped a sound effect
+    dropped: u64,
+    /// Number of sequences that cut off a sound effect
+    cut_off: u64,
+    collisions: Vec<Collision>,
+}
+
+#[derive(Default)]
+struct SweepResult {
+    sequences: u64,
+    collisions: Vec<Sequence>,
+}
+
+struct Args {
+    offsets: Vec<u32>,
+    triples: Option<Vec<String>>,
+    project_file: PathBuf,
+}
+
+fn parse_args() -> Args {
+    let mut offsets = DEFAULT_OFFSETS.to_vec();
+    let mut triples = None;
+    let mut positional = Vec::new();
+
+    let mut it = std::env::args_os().skip(1);
+    while let Some(a) = it.next() {
+        match a.to_str() {
+            Some("--offsets") => {
+                offsets = it
+                    .next()
+                    .and_then(|v| {
+                        v.to_str()?
+                            .split(',')
+                            .map(|o| o.trim().parse().ok())
+                            .collect()
+                    })
+                    .expect("--offsets expects a comma separated list of integers");
+            }
+            Some("--triples") => {
+                triples = Some(
+                    it.next()
+                        .and_then(|v| {
+                            Some(
+                                v.to_str()?
+                                    .split(',')
+                                    .map(|s| s.trim().to_owned())
+                                    .collect(),
+                            )
+                        })
+                        .expect("--triples expects a comma separated list of sound effects"),
+                );
+            }
+            _ => positional.push(a),
+        }
+    }
+
+    let [project_file] =
+        <[_; 1]>::try_from(positional).unwrap_or_else(|_| panic!("Expected a project file"));
+
+    // Sorted, the forks are emulated forwards from one offset to the next
+    offsets.sort_unstable();
+    offsets.dedup();
+    assert!(!offsets.is_empty(), "No offsets");
+
+    Args {
+        offsets,
+        triples,
+        project_file: PathBuf::from(project_file),
+    }
+}
+
+fn frame_clocks() -> u64 {
+    (ShvcSoundEmu::SMP_CLOCKS_PER_SECOND as f64 / FRAMES_PER_SECOND) as u64
+}
+
+/// Sound effect bytecode addresses (with the end of the sound effect bytecode)
+struct SfxAddresses(Vec<u16>);
+
+impl SfxAddresses {
+    fn new(common_audio_data: &CommonAudioData) -> Self {
+        let mut addrs = common_audio_data.sound_effect_addresses();
+        addrs.push(common_audio_data.sfx_bytecode_addr_range().end);
+
+        assert!(addrs.windows(2).all(|w| w[0] <= w[1]));
+
+        Self(addrs)
+    }
+
+    fn start(&self, sfx_id: u8) -> u16 {
+        self.0[usize::from(sfx_id)]
+    }
+
+    /// The sound effect a channel is playing
+    fn sfx_id(&self, inst_ptr: u16) -> Option<u8> {
+        if inst_ptr < addresses::COMMON_DATA {
+            return None;
+        }
+        let i = match self.0.binary_search(&inst_ptr) {
+            Ok(i) => i,
+            Err(i) => i.saturating_sub(1),
+        };
+        i.try_into().ok()
+    }
+}
+
+#[derive(Clone)]
+struct Player {
+    emu: ShvcSoundEmu,
+    previous_command: u8,
+    /// The `Sequence::sound_effects` index of the sound effect last started on each channel
+    owners: [Option<usize>; N_SFX_CHANNELS],
+}
+
+impl Player {
+    /// Boots the audio driver with the blank song
+    fn new(common_audio_data: &CommonAudioData) -> Self {
+        let mut emu = common::boot_driver(
+            common_audio_data,
+            audio_driver::BLANK_SONG,
+            0xff,
+            0,
+            &LoaderDataType {
+                stereo_flag: true,
+                play_song: true,
+                skip_echo_buffer_reset: true,
+                tick_budget: false,
+            },
+        );
+
+        let r = emu.run_until_pc(
+            addresses::MAINLOOP_CODE,
+            ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+        );
+        assert!(r.hit, "audio driver did not start");
+
+        let previous_command = emu.read_io_ports()[0];
+
+        let mut p = Self {
+            emu,
+            previous_command,
+            owners: [None; N_SFX_CHANNELS],
+        };
+        p.advance(WARM_UP_FRAMES);
+        p
+    }
+
+    fn load(state: &[u8], previous_command: u8) -> Self {
+        let mut emu = ShvcSoundEmu::new(&[0; 64]);
+        emu.load_state(state).unwrap();
+
+        Self {
+            emu,
+            previous_command,
+            owners: [None; N_SFX_CHANNELS],
+        }
+    }
+
+    fn advance(&mut self, frames: u32) {
+        self.emu.fast_forward(u64::from(frames) * frame_clocks());
+        assert!(!self.emu.halted(), "audio driver halted");
+    }
+
+    fn instruction_ptrs(&self) -> [u16; N_SFX_CHANNELS] {
+        let apuram = self.emu.apuram();
+
+        std::array::from_fn(|i| {
+            let read_soa = |addr| apuram[usize::from(addr) + FIRST_SFX_CHANNEL + i];
+
+            u16::from_le_bytes([
+                read_soa(addresses::CHANNEL_INSTRUCTION_PTR_L),
+                read_soa(addresses::CHANNEL_INSTRUCTION_PTR_H),
+            ])
+        })
+    }
+
+    /// Sends a command and emulates until it is acknowledged
+    fn send_command(&mut self, command: u8, parameter0: u8, parameter1: u8) {
+        let command =
+            ((self.previous_command ^ u8::MAX) & IO_COMMAND_I_MASK) | (command & IO_COMMAND_MASK);
+
+        self.emu
+            .write_io_ports([command, parameter0, parameter1, 0]);
+        self.previous_command = command;
+
+        let mut clocks = 0;
+        while self.emu.read_io_ports()[0] != command {
+            assert!(
+                clocks < ACK_TIMEOUT_SMP_CLOCKS,
+                "audio driver did not acknowledge the command"
+            );
+            clocks += self.emu.fast_forward(ACK_POLL_SMP_CLOCKS);
+        }
+    }
+
+    /// Plays a sound effect and records if it was dropped or cut off a sound effect in `seq`
+    fn play_sound_effect(&mut self, addrs: &SfxAddresses, seq: &mut Sequence, sfx_id: u8) {
+        let before = self.instruction_ptrs();
+        self.send_command(io_commands::PLAY_SOUND_EFFECT, sfx_id, Pan::CENTER.as_u8());
+        let after = self.instruction_ptrs();
+
+        let index = seq.sound_effects.len();
+        seq.sound_effects.push(sfx_id);
+
+        let start = addrs.start(sfx_id);
+
+        match (0..N_SFX_CHANNELS).find(|&c| after[c] == start && before[c] != start) {
+            Some(c) => {
+                if let Some(owner) = self.owners[c] {
+                    // The channel's previous sound effect may have already finished
+                    if addrs.sfx_id(before[c]) == Some(seq.sound_effects[owner]) {
+                        seq.cut_off.push(CutOff {
+                            sound_effect: owner,
+                            by: index,
+                        });
+                    }
+                }
+                self.owners[c] = Some(index);
+            }
+            None => seq.dropped.push(index),
+        }
+    }
+}
+
+/// Plays every sequence that starts with `seq` and continues with a sound effect of each
+/// `candidates` list, at every `offsets` frame offset.
+fn sweep(
+    player: &Player,
+    seq: &Sequence,
+    candidates: &[Vec<u8>],
+    offsets: &[u32],
+    addrs: &SfxAddresses,
+    out: &mut SweepResult,
+) {
+    let Some((next, rest)) = candidates.split_first() else {
+        out.sequences += 1;
+        if !seq.dropped.is_empty() || !seq.cut_off.is_empty() {
+            out.collisions.push(seq.clone());
+        }
+        return;
+    };
+
+    let mut timeline = player.clone();
+    let mut frame = 0;
+
+    for &offset in offsets {
+        timeline.advance(offset - frame);
+        frame = offset;
+
+        for &sfx_id in next {
+            let mut p = timeline.clone();
+            let mut s = seq.clone();
+            s.frames_between.push(offset);
+            p.play_sound_effect(addrs, &mut s, sfx_id);
+
+            sweep(&p, &s, rest, offsets, addrs, out);
+        }
+    }
+}
+
+fn main() {
+    let args = parse_args();
+
+    let project = load_project_file(&args.project_file).unwrap();
+    let project = validate_project_file_names(project).unwrap();
+
+    let samples = build_sample_and_instrument_data(&project).unwrap();
+
+    let source = project
+        .sound_effect_file
+        .as_ref()
+        .expect("Project has no sound effects file");
+    let sfx_file = load_sound_effects_file(source, &project.parent_path).unwrap();
+    let (sfx_subs, sfx) = compile_sound_effects_file(
+        &sfx_file,
+        &project.instruments_and_samples,
+        samples.pitch_table(),
+    )
+    .unwrap();
+    let sfx =
+        combine_sound_effects(&sfx, &project.sfx_export_order, project.default_sfx_flags).unwrap();
+
+    let common_audio_data = build_common_audio_data(&samples, &sfx_subs, &sfx).unwrap();
+
+    let names: Vec<String> = project
+        .sfx_export_order
+        .export_order()
+        .iter()
+        .map(|n| n.as_str().to_owned())
+        .collect();
+
+    let all: Vec<u8> = (0..names.len())
+        .map(|i| u8::try_from(i).expect("too many sound effects"))
+        .collect();
+
+    let addrs = SfxAddresses::new(&common_audio_data);
+    let warm = Player::new(&common_audio_data);
+    let warm_state = warm.emu.save_state();
+
+    // (first sound effect, candidates for the rest of the sequence)
+    let jobs: Vec<(u8, Vec<Vec<u8>>)> = match &args.triples {
+        None => all.iter().map(|&a| (a, vec![all.clone()])).collect(),
+        Some(list) => {
+            let set: Vec<u8> = list
+                .iter()
+                .map(|name| {
+                    let i = names
+                        .iter()
+                        .position(|n| n == name)
+                        .unwrap_or_else(|| panic!("Cannot find sound effect: {name}"));
+                    all[i]
+                })
+                .collect();
+            set.iter()
+                .map(|&a| (a, vec![set.clone(), set.clone()]))
+                .collect()
+        }
+    };
+
+    let results = parallel_map(&jobs, available_threads(), |(first, candidates)| {
+        let mut player = Player::load(&warm_state, warm.previous_command);
+        let mut seq = Sequence::default();
+        player.play_sound_effect(&addrs, &mut seq, *first);
+
+        let mut out = SweepResult::default();
+        sweep(&player, &seq, candidates, &args.offsets, &addrs, &mut out);
+        out
+    });
+
+    let collisions: Vec<Collision> = results
+        .iter()
+        .flat_map(|r| &r.collisions)
+        .map(|s| Collision {
+            sound_effects: s
+                .sound_effects
+                .iter()
+                .map(|&i| names[usize::from(i)].clone())
+                .collect(),
+            frames_between: s.frames_between.clone(),
+            dropped: s.dropped.clone(),
+            cut_off: s.cut_off.clone(),
+        })
+        .collect();
+
+    let report = Report {
+        sound_effects: names.len(),
+        sequences: results.iter().map(|r| r.sequences).sum(),
+        dropped: collisions.iter().filter(|c| !c.dropped.is_empty()).count() as u64,
+        cut_off: collisions.iter().filter(|c| !c.cut_off.is_empty()).count() as u64,
+        collisions,
+    };
+
+    println!("{}", serde_json::to_string_pretty(&report).unwrap());
+}
@@ -0,0 +1,672 @@
+//! Audio driver soak test
+//!
+//! Plays every song in a project for (emulated) hours or days with randomised pause, unpause,
+//! sound effect, volume, music channel and tempo commands, looking for the rare hangs and timing
+//! bugs that only show up after a long time (ie, when the 16-bit `songTickCounter` wraps).
+//!
+//! The songs are played in order, each for `--song-minutes` minutes, until `--hours` hours have
+//! been emulated.  The emulator is fast forwarded (audio is not mixed) with the fast paths and the
+//! BRR cache enabled.  Like `io_command_fuzz`, at most one command is sent per frame and a command
+//! is not sent until the previous command has been acknowledged.
+//!
+//! The soak test stops with an error if:
+//!  * the audio driver halts,
+//!  * an IO command is not acknowledged within a second,
+//!  * the song tick counter does not change for a second while the music is playing,
+//!  * the audio driver's stack grows past `STACK_BOTTOM_ADDR`,
+//!  * the echo buffer overwrites the song or common audio data.
+//!
+//! The emulator state hash is recorded every emulated minute and combined into `hash_chain`.
+//! The soak test is reproducible from the seed, two runs with the same arguments (with or
+//! without `--no-fast-paths`) have the same `hash_chain`.
+//!
+//! If `--checkpoint-dir` is set, the hashes are written to `DIR/hashes.txt` and a save state is
+//! written every `--checkpoint-minutes` minutes to `DIR/checkpoint-<n>.state`, rotating through
+//! `--checkpoints` files.  On error, the emulator state is written to `DIR/failure.state`.
+//! The `.json` file next to every state records the song, the emulated time and the state hash.
+//!
+//! Prints a JSON report (to stdout) with the emulated hours per wall clock second, the number of
+//! song ticks and song tick counter wraps, the deepest stack usage, the largest
+//! `maxTimerCounter` and the S-DSP echo saturation counters (the main and final output are
+//! not mixed when fast forwarding).  Exits with an error code if the soak test failed.
+//!
+//! This is an example and not a test as it requires project files and takes a long time.
+//!
+//! Run with `cargo run --release --example soak_test -- [--hours N] [--song-minutes N]
+//! [--seed N] [--checkpoint-dir DIR] [--checkpoint-minutes N] [--checkpoints N]
+//! [--no-fast-paths] PROJECT_FILE`
+
+mod common;
+
+use compiler::{
+    common_audio_data::{build_common_audio_data, CommonAudioData},
+    data::{load_project_file, load_text_file_with_limit, validate_project_file_names},
+    driver_constants::{
+        addresses, driver_code_symbol, io_commands, LoaderDataType, IO_COMMAND_I_MASK,
+        IO_COMMAND_MASK,
+    },
+    fnv1a::Fnv1a,
+    mml::compile_mml,
+    samples::build_sample_and_instrument_data,
+    sfx_file::load_sound_effects_file,
+    songs::SongData,
+    sound_effects::{
+        blank_compiled_sound_effects, combine_sound_effects, compile_sound_effects_file,
+        CompiledSfxSubroutines,
+    },
+};
+use serde::Serialize;
+use shvc_sound_emu::{ClippingCounters, ShvcSoundEmu};
+
+use std::path::{Path, PathBuf};
+use std::time::Instant;
+
+/// IO commands not in `driver_constants::io_commands`
+const PAUSE_MUSIC_PLAY_SFX: u8 = 2;
+const SET_MAIN_VOLUME: u8 = 10;
+const SET_MUSIC_CHANNELS: u8 = 12;
+const SET_SONG_TEMPO: u8 = 14;
+
+/// audio-driver MIN_TICK_CLOCK
+const MIN_TICK_CLOCK: u8 = 64;
+
+/// MUST match `STACK_BOTTOM_ADDR` in `audio-driver/src/common_memmap.wiz`
+const STACK_BOTTOM_ADDR: u16 = 0x1e0;
+
+const DEFAULT_HOURS: f64 = 24.0;
+const DEFAULT_SONG_MINUTES: u64 = 60;
+const DEFAULT_SEED: u64 = 0x7ad;
+const DEFAULT_CHECKPOINT_MINUTES: u64 = 10;
+const DEFAULT_CHECKPOINTS: u32 = 4;
+
+/// NTSC frame rate
+const FRAMES_PER_SECOND: f64 = 60.0988;
+
+/// The average number of frames between two commands
+const MEAN_FRAMES_BETWEEN_COMMANDS: u64 = 8;
+
+/// The hang and guard checks are run every emulated second
+const CHECK_INTERVAL: u64 = ShvcSoundEmu::SMP_CLOCKS_PER_SECOND;
+
+/// The state hash is recorded every emulated minute
+const HASH_INTERVAL: u64 = 60 * ShvcSoundEmu::SMP_CLOCKS_PER_SECOND;
+
+/// Progress is printed (to stderr) every emulated hour
+const PROGRESS_INTERVAL: u64 = 60 * 60 * ShvcSoundEmu::SMP_CLOCKS_PER_SECOND;
+
+struct Args {
+    hours: f64,
+    song_minutes: u64,
+    seed: u64,
+    checkpoint_dir: Option<PathBuf>,
+    checkpoint_minutes: u64,
+    checkpoints: u32,
+    fast_paths: bool,
+    project_file: PathBuf,
+}
+
+fn parse_args() -> Args {
+    let mut hours = DEFAULT_HOURS;
+    let mut song_minutes = DEFAULT_SONG_MINUTES;
+    let mut seed = DEFAULT_SEED;
+    let mut checkpoint_dir = None;
+    let mut checkpoint_minutes = DEFAULT_CHECKPOINT_MINUTES;
+    let mut checkpoints = DEFAULT_CHECKPOINTS;
+    let mut fast_paths = true;
+    let mut positional = Vec::new();
+
+    let mut it = std::env::args_os().skip(1);
+    while let Some(a) = it.next() {
+        match a.to_str() {
+            Some("--hours") => {
+                hours = it
+                    .next()
+                    .and_then(|v| v.to_str()?.parse().ok())
+                    .expect("--hours expects a number");
+            }
+            Some("--song-minutes") => {
+                song_minutes = it
+                    .next()
+                    .and_then(|v| v.to_str()?.parse().ok())
+                    .filter(|&m| m > 0)
+                    .expect("--song-minutes expects a positive integer");
+            }
+            Some("--seed") => {
+                seed = it
+                    .next()
+                    .and_then(|v| v.to_str()?.parse().ok())
+                    .expect("--seed expects an integer");
+            }
+            Some("--checkpoint-dir") => {
+                checkpoint_dir = Some(PathBuf::from(
+                    it.next().expect("--checkpoint-dir expects a directory"),
+                ));
+            }
+            Some("--checkpoint-minutes") => {
+                checkpoint_minutes = it
+                    .next()
+                    .and_then(|v| v.to_str()?.parse().ok())
+                    .filter(|&m| m > 0)
+                    .expect("--checkpoint-minutes expects a positive integer");
+            }
+            Some("--checkpoints") => {
+                checkpoints = it
+                    .next()
+                    .and_then(|v| v.to_str()?.parse().ok())
+                    .filter(|&n| n > 0)
+                    .expect("--checkpoints expects a positive integer");
+            }
+            Some("--no-fast-paths") => fast_paths = false,
+            _ => positional.push(a),
+        }
+    }
+
+    let [project_file] =
+        <[_; 1]>::try_from(positional).unwrap_or_else(|_| panic!("Expected a project file"));
+
+    Args {
+        hours,
+        song_minutes,
+        seed,
+        checkpoint_dir,
+        checkpoint_minutes,
+        checkpoints,
+        fast_paths,
+        project_file: PathBuf::from(project_file),
+    }
+}
+
+/// SplitMix64 (the soak test must be reproducible from the seed alone)
+struct Rng(u64);
+
+impl Rng {
+    fn next(&mut self) -> u64 {
+        self.0 = self.0.wrapping_add(0x9e3779b97f4a7c15);
+        let mut z = self.0;
+        z = (z ^ (z >> 30)).wrapping_mul(0xbf58476d1ce4e5b9);
+        z = (z ^ (z >> 27)).wrapping_mul(0x94d049bb133111eb);
+        z ^ (z >> 31)
+    }
+
+    fn below(&mut self, n: u64) -> u64 {
+        self.next() % n
+    }
+
+    fn byte(&mut self) -> u8 {
+        self.next() as u8
+    }
+}
+
+/// Returns a new IO command with a different command id
+fn next_command(previous: u8, command: u8) -> u8 {
+    ((previous ^ u8::MAX) & IO_COMMAND_I_MASK) | (command & IO_COMMAND_MASK)
+}
+
+fn frame_clocks() -> u64 {
+    (ShvcSoundEmu::SMP_CLOCKS_PER_SECOND as f64 / FRAMES_PER_SECOND) as u64
+}
+
+fn seconds(smp_clocks: u64) -> f64 {
+    smp_clocks as f64 / ShvcSoundEmu::SMP_CLOCKS_PER_SECOND as f64
+}
+
+fn pc_string(pc: u16) -> String {
+    match driver_code_symbol(pc) {
+        Some((name, offset)) => format!("0x{pc:04x} ({name}+{offset})"),
+        None => format!("0x{pc:04x} (outside the audio driver)"),
+    }
+}
+
+fn song_tick_counter(emu: &ShvcSoundEmu) -> u16 {
+    let stc = usize::from(addresses::SONG_TICK_COUNTER);
+    u16::from_le_bytes([emu.apuram()[stc], emu.apuram()[stc + 1]])
+}
+
+/// Returns a random `[command, parameter0, parameter1]`.
+///
+/// Sound effects are not played while everything is paused.
+fn random_command(rng: &mut Rng, n_sound_effects: usize, paused: bool) -> [u8; 3] {
+    match rng.below(10) {
+        0 => [io_commands::PAUSE, 0, 0],
+        1 => [PAUSE_MUSIC_PLAY_SFX, 0, 0],
+        2 => [io_commands::UNPAUSE, 0, 0],
+        3..=5 if n_sound_effects > 0 && !paused => [
+            io_commands::PLAY_SOUND_EFFECT,
+            rng.below(n_sound_effects as u64) as u8,
+            rng.below(129) as u8,
+        ],
+        6 => [io_commands::STOP_SOUND_EFFECTS, 0, 0],
+        7 => [SET_MAIN_VOLUME, rng.byte(), 0],
+        8 => [SET_MUSIC_CHANNELS, rng.byte(), 0],
+        _ => [SET_SONG_TEMPO, rng.byte().max(MIN_TICK_CLOCK), 0],
+    }
+}
+
+fn load_song(
+    common_audio_data: &CommonAudioData,
+    song: &SongData,
+    stereo_flag: bool,
+    fast_paths: bool,
+) -> ShvcSoundEmu {
+    let mut emu = ShvcSoundEmu::new(&[0; 64]);
+
+    // The fastest emulator configuration
+    emu.set_fast_paths(fast_paths);
+    emu.set_brr_cache_enabled(true);
+
+    let song_data = song.data();
+    let song_data_addr = common_audio_data.song_data_addr();
+
+    common::write_driver_to_apuram(
+        emu.apuram_mut(),
+        common_audio_data,
+        song_data,
+        &LoaderDataType {
+            stereo_flag,
+            play_song: true,
+            skip_echo_buffer_reset: false,
+            tick_budget: false,
+        },
+    );
+    emu.reset(common::song_reset_registers(song));
+
+    let protected_end = usize::from(song_data_addr) + song_data.len() - 1;
+    emu.set_echo_guard(addresses::COMMON_DATA..=protected_end as u16);
+
+    emu
+}
+
+#[derive(Default, Serialize)]
+struct Clipping {
+    echo: u64,
+    fir: u64,
+    feedback: u64,
+}
+
+impl Clipping {
+    fn add(&mut self, c: &ClippingCounters) {
+        let sum = |s: [u32; 2]| u64::from(s[0]) + u64::from(s[1]);
+
+        self.echo += sum(c.echo);
+        self.fir += sum(c.fir);
+        self.feedback += sum(c.feedback);
+    }
+}
+
+#[derive(Default, Serialize)]
+struct Report {
+    seed: u64,
+    fast_paths: bool,
+    emulated_hours: f64,
+    wall_seconds: f64,
+    emulated_hours_per_wall_second: f64,
+    songs_played: u64,
+    commands: u64,
+    song_ticks: u64,
+    song_tick_counter_wraps: u64,
+    /// The lowest stack address pushed to
+    lowest_stack_addr: u16,
+    max_timer_counter: u8,
+    clipping: Clipping,
+    hash_chain: String,
+    checkpoints_written: u64,
+    failure: Option<String>,
+}
+
+#[derive(Serialize)]
+struct StateInfo<'a> {
+    song: &'a str,
+    /// Emulated seconds since the soak test started
+    seconds: f64,
+    /// Emulated seconds since the song started
+    song_seconds: f64,
+    state_hash: String,
+}
+
+/// Writes the emulator state and a `.json` description to `DIR/<name>.state`
+fn write_state(dir: &Path, name: &str, emu: &ShvcSoundEmu, info: &StateInfo) {
+    let state_path = dir.join(format!("{name}.state"));
+    std::fs::write(&state_path, emu.save_state())
+        .unwrap_or_else(|e| panic!("Cannot write {}: {e}", state_path.display()));
+
+    let info_path = dir.join(format!("{name}.json"));
+    std::fs::write(&info_path, serde_json::to_string_pretty(info).unwrap())
+        .unwrap_or_else(|e| panic!("Cannot write {}: {e}", info_path.display()));
+}
+
+struct Soak<'a> {
+    args: &'a Args,
+    rng: Rng,
+    report: Report,
+    hash_log: Option<std::fs::File>,
+    hash_chain: Fnv1a,
+
+    /// Emulated S-SMP clocks since the soak test started
+    clock: u64,
+}
+
+impl Soak<'_> {
+    fn state_info<'s>(&self, song: &'s str, song_clock: u64, emu: &ShvcSoundEmu) -> StateInfo<'s> {
+        StateInfo {
+            song,
+            seconds: seconds(self.clock),
+            song_seconds: seconds(song_clock),
+            state_hash: format!("{:#018x}", emu.state_hash()),
+        }
+    }
+
+    fn record_hash(&mut self, song: &str, emu: &ShvcSoundEmu) {
+        use std::io::Write;
+
+        let hash = emu.state_hash();
+
+        self.hash_chain.write(&hash.to_le_bytes());
+
+        if let Some(f) = &mut self.hash_log {
+            writeln!(f, "{:.0} {song} {hash:#018x}", seconds(self.clock))
+                .expect("Cannot write hash log");
+        }
+    }
+
+    fn checkpoint(&mut self, song: &str, song_clock: u64, emu: &ShvcSoundEmu) {
+        if let Some(dir) = &self.args.checkpoint_dir {
+            let n = self.report.checkpoints_written % u64::from(self.args.checkpoints);
+            let info = self.state_info(song, song_clock, emu);
+            write_state(dir, &format!("checkpoint-{n}"), emu, &info);
+
+            self.report.checkpoints_written += 1;
+        }
+    }
+
+    /// Plays a song for `smp_clocks` S-SMP clocks, sending random commands.
+    ///
+    /// The emulator state is written to `DIR/failure.state` if the song fails.
+    fn play_song(
+        &mut self,
+        name: &str,
+        common_audio_data: &CommonAudioData,
+        song: &SongData,
+        n_sound_effects: usize,
+        smp_clocks: u64,
+    ) -> Result<(), String> {
+        const STEREO_FLAG: bool = true;
+
+        let mut emu = load_song(common_audio_data, song, STEREO_FLAG, self.args.fast_paths);
+        let mut song_clock = 0;
+
+        let r = self.run_song(name, &mut emu, n_sound_effects, smp_clocks, &mut song_clock);
+
+        if r.is_err() {
+            if let Some(dir) = &self.args.checkpoint_dir {
+                let info = self.state_info(name, song_clock, &emu);
+                write_state(dir, "failure", &emu, &info);
+            }
+        }
+        r
+    }
+
+    fn run_song(
+        &mut self,
+        name: &str,
+        emu: &mut ShvcSoundEmu,
+        n_sound_effects: usize,
+        smp_clocks: u64,
+        song_clock: &mut u64,
+    ) -> Result<(), String> {
+        let r = emu.run_until_pc(
+            addresses::MAINLOOP_CODE,
+            ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+        );
+        if !r.hit {
+            return Err(format!("{name}: audio driver did not start"));
+        }
+
+        let start = emu.counters().smp_clocks;
+        let frame_clocks = frame_clocks();
+        let checkpoint_interval =
+            self.args.checkpoint_minutes * 60 * ShvcSoundEmu::SMP_CLOCKS_PER_SECOND;
+
+        // The audio driver starts with the PAUSE command id (`play_song` starts the song)
+        let mut previous_command = io_commands::PAUSE;
+        // S-SMP clock (relative to `start`) of the unacknowledged command
+        let mut command_sent: Option<u64> = None;
+
+        let mut paused = false;
+        let mut music_paused = false;
+        // S-SMP clock (relative to `start`) of the last pause or unpause command
+        let mut paused_changed = 0;
+
+        let mut tick_counter = song_tick_counter(emu);
+        // S-SMP clock (relative to `start`) of the last song tick counter change
+        let mut last_tick = 0;
+
+        while *song_clock < smp_clocks {
+            let prev_clock = *song_clock;
+
+            if emu.read_io_ports()[0] == previous_command {
+                command_sent = None;
+
+                if self.rng.below(MEAN_FRAMES_BETWEEN_COMMANDS) == 0 {
+                    let [command, parameter0, parameter1] =
+                        random_command(&mut self.rng, n_sound_effects, paused);
+
+                    match command {
+                        io_commands::PAUSE => (paused, music_paused) = (true, true),
+                        PAUSE_MUSIC_PLAY_SFX => (paused, music_paused) = (false, true),
+                        io_commands::UNPAUSE => (paused, music_paused) = (false, false),
+                        _ => (),
+                    }
+                    if matches!(
+                        command,
+                        io_commands::PAUSE | PAUSE_MUSIC_PLAY_SFX | io_commands::UNPAUSE
+                    ) {
+                        paused_changed = prev_clock;
+                    }
+
+                    previous_command = next_command(previous_command, command);
+
+                    let at = prev_clock + self.rng.below(frame_clocks);
+                    emu.schedule_port_write(
+                        start + at,
+                        [previous_command, parameter0, parameter1, 0],
+                    );
+                    command_sent = Some(at);
+                    self.report.commands += 1;
+                }
+            }
+
+            let frame = emu.fast_forward(frame_clocks);
+            *song_clock += frame;
+            self.clock += frame;
+
+            if emu.halted() {
+                return Err(format!(
+                    "{name}: audio driver halted (SLEEP or STOP) (PC = {})",
+                    pc_string(emu.program_counter())
+                ));
+            }
+
+            let stc = song_tick_counter(emu);
+            if stc != tick_counter {
+                let ticks = stc.wrapping_sub(tick_counter);
+                if stc < tick_counter {
+                    self.report.song_tick_counter_wraps += 1;
+                }
+                self.report.song_ticks += u64::from(ticks);
+                tick_counter = stc;
+                last_tick = *song_clock;
+            }
+
+            if *song_clock / CHECK_INTERVAL != prev_clock / CHECK_INTERVAL {
+                if let Some(sent) = command_sent {
+                    if *song_clock > sent + CHECK_INTERVAL {
+                        return Err(format!(
+                            "{name}: IO command 0x{previous_command:02x} not acknowledged within a second (PC = {})",
+                            pc_string(emu.program_counter())
+                        ));
+                    }
+                }
+
+                let playing_since = last_tick.max(paused_changed);
+                if !music_paused && *song_clock > playing_since + CHECK_INTERVAL {
+                    return Err(format!(
+                        "{name}: audio driver hang, no song tick within a second (song tick counter = {tick_counter}, PC = {})",
+                        pc_string(emu.program_counter())
+                    ));
+                }
+
+                let lowest = 0x101 + u16::from(emu.stack_min());
+                self.report.lowest_stack_addr = self.report.lowest_stack_addr.min(lowest);
+                if lowest < STACK_BOTTOM_ADDR {
+                    return Err(format!(
+                        "{name}: stack overflow, the audio driver pushed to ${lowest:04x}"
+                    ));
+                }
+
+                if let Some(h) = emu.take_echo_guard_hit() {
+                    return Err(format!(
+                        "{name}: echo buffer overwrote song or common audio data at 0x{:04x}",
+                        h.address
+                    ));
+                }
+
+                let max_timer_counter = emu.apuram()[usize::from(addresses::MAX_TIMER_COUNTER)];
+                self.report.max_timer_counter =
+                    self.report.max_timer_counter.max(max_timer_counter);
+
+                self.report.clipping.add(&emu.take_clipping());
+            }
+
+            if *song_clock / HASH_INTERVAL != prev_clock / HASH_INTERVAL {
+                self.record_hash(name, emu);
+            }
+            if self.clock / checkpoint_interval != (self.clock - frame) / checkpoint_interval {
+                self.checkpoint(name, *song_clock, emu);
+            }
+        }
+
+        Ok(())
+    }
+}
+
+fn main() {
+    let args = parse_args();
+
+    let project = load_project_file(&args.project_file).unwrap();
+    let project = validate_project_file_names(project).unwrap();
+
+    let samples = build_sample_and_instrument_data(&project).unwrap();
+
+    let (sfx_subs, sfx, n_sound_effects) = match &project.sound_effect_file {
+        Some(source) => {
+            let sfx_file = load_sound_effects_file(source, &project.parent_path).unwrap();
+            let (subs, sfx) = compile_sound_effects_file(
+                &sfx_file,
+                &project.instruments_and_samples,
+                samples.pitch_table(),
+            )
+            .unwrap();
+            let sfx =
+                combine_sound_effects(&sfx, &project.sfx_export_order, project.default_sfx_flags)
+                    .unwrap();
+            (subs, sfx, project.sfx_export_order.n_sound_effects())
+        }
+        None => (
+            CompiledSfxSubroutines::blank(),
+            blank_compiled_sound_effects(),
+            0,
+        ),
+    };
+
+    let common_audio_data = build_common_audio_data(&samples, &sfx_subs, &sfx).unwrap();
+
+    let songs: Vec<(String, SongData)> = project
+        .songs
+        .list()
+        .iter()
+        .map(|song| {
+            let mml_file = load_text_file_with_limit(&song.source, &project.parent_path).unwrap();
+            let song_data = compile_mml(
+                &mml_file,
+                Some(song.name.clone()),
+                &project.instruments_and_samples,
+                samples.pitch_table(),
+            )
+            .unwrap();
+
+            (song.name.as_str().to_owned(), song_data)
+        })
+        .collect();
+
+    if songs.is_empty() {
+        panic!("No songs");
+    }
+
+    let hash_log = args.checkpoint_dir.as_ref().map(|dir| {
+        std::fs::create_dir_all(dir)
+            .unwrap_or_else(|e| panic!("Cannot create {}: {e}", dir.display()));
+
+        let path = dir.join("hashes.txt");
+        std::fs::File::create(&path)
+            .unwrap_or_else(|e| panic!("Cannot create {}: {e}", path.display()))
+    });
+
+    let mut soak = Soak {
+        args: &args,
+        rng: Rng(args.seed),
+        report: Report {
+            seed: args.seed,
+            fast_paths: args.fast_paths,
+            lowest_stack_addr: 0x1ff,
+            ..Default::default()
+        },
+        hash_log,
+        hash_chain: Fnv1a::new(),
+        clock: 0,
+    };
+
+    let total_clocks =
+        (args.hours * 60.0 * 60.0 * ShvcSoundEmu::SMP_CLOCKS_PER_SECOND as f64) as u64;
+    let song_clocks = args.song_minutes * 60 * ShvcSoundEmu::SMP_CLOCKS_PER_SECOND;
+
+    let wall_start = Instant::now();
+
+    for (name, song) in songs.iter().cycle() {
+        if soak.clock >= total_clocks {
+            break;
+        }
+        let smp_clocks = song_clocks.min(total_clocks - soak.clock);
+        let progress = soak.clock / PROGRESS_INTERVAL;
+
+        soak.report.songs_played += 1;
+
+        if let Err(e) = soak.play_song(name, &common_audio_data, song, n_sound_effects, smp_clocks)
+        {
+            soak.report.failure = Some(e);
+            break;
+        }
+
+        if soak.clock / PROGRESS_INTERVAL != progress {
+            let hours = seconds(soak.clock) / (60.0 * 60.0);
+            eprintln!(
+                "{hours:.1} hours emulated ({:.2} emulated hours per second)",
+                hours / wall_start.elapsed().as_secs_f64()
+            );
+        }
+    }
+
+    let wall_seconds = wall_start.elapsed().as_secs_f64();
+    let hours = seconds(soak.clock) / (60.0 * 60.0);
+
+    soak.report.emulated_hours = hours;
+    soak.report.wall_seconds = wall_seconds;
+    soak.report.emulated_hours_per_wall_second = hours / wall_seconds;
+    soak.report.hash_chain = format!("{:#018x}", soak.hash_chain.finish());
+
+    println!("{}", serde_json::to_string_pretty(&soak.report).unwrap());
+
+    if let Some(e) = &soak.report.failure {
+        eprintln!("{e}");
+        std::process::exit(1);
+    }
+}
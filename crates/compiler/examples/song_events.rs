@@ -0,0 +1,159 @@
+//! Song event timing table
+//!
+//! Plays a song in the emulator and records every voice key-on, voice key-off and audio driver
+//! tick with `ShvcSoundEmu::start_event_log()`, draining the log after every audio buffer.
+//!
+//! Prints the events as a CSV timing table (to stdout), which can be converted into a table of
+//! musical events for game-side synchronisation (ie, rhythm or cutscene timing).
+//!
+//! The `sample` column is the 32000Hz sample index from the start of the song.
+//! `source` and `pitch` are the voice's SRCN and PITCH registers at key-on and
+//! `voice` is the number of timer 0 outputs read by the tick.
+//!
+//! This is an example and not a test as it requires project files.
+//!
+//! Run with `cargo run --release --example song_events -- [--seconds N] [--no-ticks] PROJECT_FILE SONG`.
+
+mod common;
+
+use compiler::{
+    common_audio_data::{build_common_audio_data, CommonAudioData},
+    data::{load_project_file, load_text_file_with_limit, validate_project_file_names},
+    driver_constants::LoaderDataType,
+    mml::compile_mml,
+    samples::build_sample_and_instrument_data,
+    songs::SongData,
+    sound_effects::{blank_compiled_sound_effects, CompiledSfxSubroutines},
+};
+use shvc_sound_emu::{ShvcSoundEmu, SoundEvent, SoundEventKind};
+
+use std::fmt::Write;
+use std::path::PathBuf;
+
+const DEFAULT_SECONDS: u32 = 60;
+
+/// S-SMP clocks per sample (32000Hz)
+const SMP_CLOCKS_PER_SAMPLE: u64 = 64;
+
+/// Events to preallocate per audio buffer
+const EVENT_LOG_CAPACITY: usize = 256;
+
+struct Args {
+    seconds: u32,
+    ticks: bool,
+    project_file: PathBuf,
+    song: String,
+}
+
+fn parse_args() -> Args {
+    let mut seconds = DEFAULT_SECONDS;
+    let mut ticks = true;
+    let mut positional = Vec::new();
+
+    let mut it = std::env::args_os().skip(1);
+    while let Some(a) = it.next() {
+        match a.to_str() {
+            Some("--seconds") => {
+                seconds = it
+                    .next()
+                    .and_then(|v| v.to_str()?.parse().ok())
+                    .expect("--seconds expects an integer");
+            }
+            Some("--no-ticks") => ticks = false,
+            _ => positional.push(a),
+        }
+    }
+
+    let [project_file, song] = <[_; 2]>::try_from(positional)
+        .unwrap_or_else(|_| panic!("Expected a project file and a song name"));
+
+    Args {
+        seconds,
+        ticks,
+        project_file: PathBuf::from(project_file),
+        song: song.into_string().expect("Invalid song name"),
+    }
+}
+
+fn load_song(common_audio_data: &CommonAudioData, song: &SongData) -> ShvcSoundEmu {
+    common::boot_song(
+        common_audio_data,
+        song,
+        &LoaderDataType {
+            stereo_flag: true,
+            play_song: true,
+            skip_echo_buffer_reset: false,
+            tick_budget: false,
+        },
+    )
+}
+
+fn write_event(out: &mut String, e: &SoundEvent, first_sample: u64) {
+    let kind = match e.kind {
+        SoundEventKind::KeyOn => "key-on",
+        SoundEventKind::KeyOff => "key-off",
+        SoundEventKind::Tick => "tick",
+        _ => "unknown",
+    };
+    writeln!(
+        out,
+        "{},{kind},{},{},{}",
+        e.sample_index() - first_sample,
+        e.voice,
+        e.source,
+        e.pitch
+    )
+    .unwrap();
+}
+
+fn main() {
+    let args = parse_args();
+
+    let project = load_project_file(&args.project_file).unwrap();
+    let project = validate_project_file_names(project).unwrap();
+
+    let samples = build_sample_and_instrument_data(&project).unwrap();
+
+    let sfx_subs = CompiledSfxSubroutines::blank();
+    let sfx = blank_compiled_sound_effects();
+
+    let common_audio_data = build_common_audio_data(&samples, &sfx_subs, &sfx).unwrap();
+
+    let song = project
+        .songs
+        .get(&args.song)
+        .unwrap_or_else(|| panic!("Cannot find song: {}", args.song));
+    let mml_file = load_text_file_with_limit(&song.source, &project.parent_path).unwrap();
+    let song_data = compile_mml(
+        &mml_file,
+        Some(song.name.clone()),
+        &project.instruments_and_samples,
+        samples.pitch_table(),
+    )
+    .unwrap();
+
+    let mut emu = load_song(&common_audio_data, &song_data);
+
+    let first_sample = emu.dsp_clock() / SoundEvent::DSP_CLOCKS_PER_SAMPLE;
+    let n_buffers = (u64::from(args.seconds) * ShvcSoundEmu::SMP_CLOCKS_PER_SECOND)
+        .div_ceil(ShvcSoundEmu::AUDIO_BUFFER_SAMPLES as u64 * SMP_CLOCKS_PER_SAMPLE);
+
+    let mut out = String::new();
+    writeln!(out, "sample,kind,voice,source,pitch").unwrap();
+
+    emu.start_event_log(EVENT_LOG_CAPACITY);
+
+    for _ in 0..n_buffers {
+        emu.emulate();
+
+        for e in emu.take_event_log() {
+            if args.ticks || e.kind != SoundEventKind::Tick {
+                write_event(&mut out, &e, first_sample);
+            }
+        }
+    }
+
+    emu.stop_event_log();
+
+    print!("{out}");
+}
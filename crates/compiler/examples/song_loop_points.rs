@@ -0,0 +1,208 @@
+//! Song loop points
+//!
+//! Plays every song of one or more projects in the emulator and finds the first tick where the
+//! audio driver's variables and the S-DSP voice state repeat (see `ShvcSoundEmu::find_loop()`).
+//! Prints the loop start and length of each song (in ticks and samples) as JSON (to stdout).
+//!
+//! A song that does not loop is detected as a 1 tick loop once every voice is silent.
+//!
+//! `--render DIR` renders the intro and one loop of each song to `DIR/<song name>.wav`, which can
+//! be looped gaplessly from the loop start sample.
+//!
+//! The echo buffer and S-DSP echo state are not compared, a loop can start before an echo tail
+//! from the intro has fully decayed.
+//!
+//! This is an example and not a test as it requires project files.
+//!
+//! Run with `cargo run --release --example song_loop_points -- [--max-ticks N] [--render DIR] PROJECT_FILE...`.
+
+mod common;
+
+use compiler::{
+    common_audio_data::{build_common_audio_data, CommonAudioData},
+    data::{load_project_file, load_text_file_with_limit, validate_project_file_names},
+    driver_constants::{addresses, LoaderDataType},
+    mml::compile_mml,
+    samples::build_sample_and_instrument_data,
+    songs::SongData,
+    sound_effects::{blank_compiled_sound_effects, CompiledSfxSubroutines},
+};
+use serde::Serialize;
+use shvc_sound_emu::ShvcSoundEmu;
+
+use std::path::PathBuf;
+
+/// Default maximum number of ticks to search (approximately 10 minutes at the default tick clock)
+const DEFAULT_MAX_TICKS: u32 = 100_000;
+
+#[derive(Serialize)]
+struct SongLoop {
+    name: String,
+    looped: bool,
+    start_tick: u32,
+    length_ticks: u32,
+    start_sample: u64,
+    length_samples: u64,
+    /// The rendered WAV file (if `--render` is used)
+    wav_file: Option<String>,
+}
+
+#[derive(Serialize)]
+struct ProjectLoops {
+    project: String,
+    songs: Vec<SongLoop>,
+}
+
+struct Args {
+    max_ticks: u32,
+    render_dir: Option<PathBuf>,
+    project_files: Vec<PathBuf>,
+}
+
+fn parse_args() -> Args {
+    let mut args = Args {
+        max_ticks: DEFAULT_MAX_TICKS,
+        render_dir: None,
+        project_files: Vec::new(),
+    };
+
+    let mut it = std::env::args_os().skip(1);
+    while let Some(a) = it.next() {
+        match a.to_str() {
+            Some("--max-ticks") => {
+                args.max_ticks = it
+                    .next()
+                    .and_then(|v| v.to_str()?.parse().ok())
+                    .expect("--max-ticks expects an integer");
+            }
+            Some("--render") => {
+                args.render_dir = Some(PathBuf::from(
+                    it.next().expect("--render expects a directory"),
+                ));
+            }
+            _ => args.project_files.push(PathBuf::from(a)),
+        }
+    }
+
+    if args.project_files.is_empty() {
+        panic!("Expected at least one project file");
+    }
+
+    args
+}
+
+fn load_song(
+    common_audio_data: &CommonAudioData,
+    song: &SongData,
+    stereo_flag: bool,
+) -> ShvcSoundEmu {
+    common::boot_song(
+        common_audio_data,
+        song,
+        &LoaderDataType {
+            stereo_flag,
+            play_song: true,
+            skip_echo_buffer_reset: false,
+            tick_budget: false,
+        },
+    )
+}
+
+fn find_song_loop(
+    name: &str,
+    common_audio_data: &CommonAudioData,
+    song: &SongData,
+    args: &Args,
+) -> SongLoop {
+    let mut emu = load_song(common_audio_data, song, true);
+    let start = emu.clone();
+
+    let lp = emu.find_loop(
+        addresses::PROCESS_MUSIC_CHANNELS_CODE,
+        &addresses::driver_state_ranges(),
+        args.max_ticks,
+    );
+
+    let wav_file = match (&args.render_dir, lp) {
+        (Some(dir), Some(lp)) => {
+            let path = dir.join(format!("{name}.wav"));
+            let mut emu = start;
+            emu.render_to_file(&path, lp.start_smp_clocks + lp.length_smp_clocks, None)
+                .unwrap_or_else(|e| panic!("{}: {e}", path.display()));
+            Some(path.display().to_string())
+        }
+        _ => None,
+    };
+
+    match lp {
+        Some(lp) => SongLoop {
+            name: name.to_owned(),
+            looped: true,
+            start_tick: lp.start_tick,
+            length_ticks: lp.length_ticks,
+            start_sample: lp.start_samples(),
+            length_samples: lp.length_samples(),
+            wav_file,
+        },
+        None => SongLoop {
+            name: name.to_owned(),
+            looped: false,
+            start_tick: 0,
+            length_ticks: 0,
+            start_sample: 0,
+            length_samples: 0,
+            wav_file,
+        },
+    }
+}
+
+fn project_loops(pf_path: PathBuf, args: &Args) -> ProjectLoops {
+    let project = load_project_file(&pf_path).unwrap();
+    let project = validate_project_file_names(project).unwrap();
+
+    let samples = build_sample_and_instrument_data(&project).unwrap();
+
+    let sfx_subs = CompiledSfxSubroutines::blank();
+    let sfx = blank_compiled_sound_effects();
+
+    let common_audio_data = build_common_audio_data(&samples, &sfx_subs, &sfx).unwrap();
+
+    let songs = project
+        .songs
+        .list()
+        .iter()
+        .map(|song| {
+            let mml_file = load_text_file_with_limit(&song.source, &project.parent_path).unwrap();
+            let song_data = compile_mml(
+                &mml_file,
+                Some(song.name.clone()),
+                &project.instruments_and_samples,
+                samples.pitch_table(),
+            )
+            .unwrap();
+
+            find_song_loop(song.name.as_str(), &common_audio_data, &song_data, args)
+        })
+        .collect();
+
+    ProjectLoops {
+        project: pf_path.display().to_string(),
+        songs,
+    }
+}
+
+fn main() {
+    let args = parse_args();
+
+    if let Some(dir) = &args.render_dir {
+        std::fs::create_dir_all(dir).unwrap();
+    }
+
+    let results: Vec<ProjectLoops> = args
+        .project_files
+        .iter()
+        .map(|p| project_loops(p.clone(), &args))
+        .collect();
+
+    println!("{}", serde_json::to_string_pretty(&results).unwrap());
+}
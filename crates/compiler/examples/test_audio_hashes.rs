@@ -0,0 +1,250 @@
+//! Audio hash regression test
+//!
+//! Plays the first few seconds of every song in one or more projects (with the emulator fast
+//! paths enabled) and compares a hash of every 1 second window of audio against a manifest, so
+//! audio regressions can be detected without storing WAV files.
+//!
+//! On a mismatch the first mismatching window of each song is printed.
+//!
+//! The manifest is a text file with one line per song:
+//! `<song name> <window 0 hash> <window 1 hash> ...` (64 bit FNV-1a hashes of the interleaved
+//! little-endian stereo samples, in hex).
+//!
+//! `--update` writes the manifest instead of testing it.
+//! It must be run (and the manifest committed) whenever the audio output is intentionally changed.
+//!
+//! The songs are emulated in parallel with `run_emulator_jobs()`.
+//!
+//! This is an example and not a test as it requires command line input parameters
+//! (the manifest and the project files).
+//!
+//! Run with `cargo run --release --example test_audio_hashes -- [--update] MANIFEST PROJECT_FILE...`.
+
+mod common;
+
+use compiler::{
+    common_audio_data::{build_common_audio_data, CommonAudioData},
+    data::{load_project_file, load_text_file_with_limit, validate_project_file_names},
+    driver_constants::LoaderDataType,
+    fnv1a::Fnv1a,
+    mml::compile_mml,
+    samples::build_sample_and_instrument_data,
+    songs::SongData,
+    sound_effects::{blank_compiled_sound_effects, CompiledSfxSubroutines},
+};
+use shvc_sound_emu::{run_emulator_jobs, EmulatorJob, ShvcSoundEmu};
+
+use std::collections::HashMap;
+use std::fmt::Write;
+use std::path::PathBuf;
+
+/// Number of seconds to emulate per song
+const SECONDS: usize = 10;
+
+/// Number of `i16` values in a 1 second window
+const WINDOW_SIZE: usize = ShvcSoundEmu::SAMPLE_RATE as usize * 2;
+
+const MANIFEST_HEADER: &str = "# test_audio_hashes manifest, regenerate with `--update`";
+
+struct Args {
+    update: bool,
+    manifest: PathBuf,
+    project_files: Vec<PathBuf>,
+}
+
+fn parse_args() -> Args {
+    let mut update = false;
+    let mut paths = Vec::new();
+
+    for a in std::env::args_os().skip(1) {
+        match a.to_str() {
+            Some("--update") => update = true,
+            _ => paths.push(PathBuf::from(a)),
+        }
+    }
+
+    if paths.len() < 2 {
+        panic!("Expected arguments: [--update] MANIFEST PROJECT_FILE...");
+    }
+    let manifest = paths.remove(0);
+
+    Args {
+        update,
+        manifest,
+        project_files: paths,
+    }
+}
+
+fn song_job(
+    common_audio_data: &CommonAudioData,
+    song: &SongData,
+    stereo_flag: bool,
+) -> EmulatorJob {
+    let mut apuram = vec![0; 0x10000];
+    common::write_driver_to_apuram(
+        &mut apuram,
+        common_audio_data,
+        song.data(),
+        &LoaderDataType {
+            stereo_flag,
+            play_song: true,
+            skip_echo_buffer_reset: false,
+            tick_budget: false,
+        },
+    );
+
+    EmulatorJob {
+        apuram,
+        registers: common::song_reset_registers(song),
+        fast_paths: true,
+        port_writes: Vec::new(),
+        smp_clocks: SECONDS as u64 * ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+        output_audio: true,
+    }
+}
+
+/// 64 bit FNV-1a hash of the little-endian samples
+fn hash_window(samples: &[i16]) -> u64 {
+    let mut h = Fnv1a::new();
+    for s in samples {
+        h.write(&s.to_le_bytes());
+    }
+    h.finish()
+}
+
+/// Returns the (song name, window hashes) of every song in a project
+fn hash_project(pf_path: PathBuf) -> Vec<(String, Vec<u64>)> {
+    let project = load_project_file(&pf_path).unwrap();
+    let project = validate_project_file_names(project).unwrap();
+
+    let samples = build_sample_and_instrument_data(&project).unwrap();
+
+    let sfx_subs = CompiledSfxSubroutines::blank();
+    let sfx = blank_compiled_sound_effects();
+
+    let common_audio_data = build_common_audio_data(&samples, &sfx_subs, &sfx).unwrap();
+
+    const STEREO_FLAG: bool = true;
+
+    let mut names = Vec::new();
+    let mut jobs = Vec::new();
+
+    for song in project.songs.list() {
+        let mml_file = load_text_file_with_limit(&song.source, &project.parent_path).unwrap();
+
+        let song_data = compile_mml(
+            &mml_file,
+            Some(song.name.clone()),
+            &project.instruments_and_samples,
+            samples.pitch_table(),
+        )
+        .unwrap();
+
+        names.push(song.name.as_str().to_owned());
+        jobs.push(song_job(&common_audio_data, &song_data, STEREO_FLAG));
+    }
+
+    let results = run_emulator_jobs(&jobs, 0);
+
+    names
+        .into_iter()
+        .zip(results)
+        .map(|(name, r)| {
+            (
+                name,
+                r.samples.chunks(WINDOW_SIZE).map(hash_window).collect(),
+            )
+        })
+        .collect()
+}
+
+fn write_manifest(args: &Args, songs: &[(String, Vec<u64>)]) {
+    let mut out = String::new();
+
+    writeln!(out, "{MANIFEST_HEADER}").unwrap();
+    for (name, hashes) in songs {
+        write!(out, "{name}").unwrap();
+        for h in hashes {
+            write!(out, " {h:016x}").unwrap();
+        }
+        writeln!(out).unwrap();
+    }
+
+    std::fs::write(&args.manifest, out).unwrap();
+
+    println!("Wrote {} songs to {}", songs.len(), args.manifest.display());
+}
+
+fn read_manifest(args: &Args) -> HashMap<String, Vec<u64>> {
+    let text = std::fs::read_to_string(&args.manifest).unwrap_or_else(|e| {
+        panic!("Cannot read manifest {}: {e}", args.manifest.display());
+    });
+
+    text.lines()
+        .filter(|l| !l.is_empty() && !l.starts_with('#'))
+        .map(|l| {
+            let mut it = l.split_ascii_whitespace();
+            let name = it.next().unwrap().to_owned();
+            let hashes = it
+                .map(|h| u64::from_str_radix(h, 16).expect("invalid hash in manifest"))
+                .collect();
+            (name, hashes)
+        })
+        .collect()
+}
+
+fn test_manifest(args: &Args, songs: &[(String, Vec<u64>)]) {
+    let mut manifest = read_manifest(args);
+    let mut failures = 0;
+
+    for (name, hashes) in songs {
+        println!("Testing song: {name}");
+
+        let expected = match manifest.remove(name) {
+            Some(e) => e,
+            None => {
+                println!("  {name}: not in manifest");
+                failures += 1;
+                continue;
+            }
+        };
+
+        let first_mismatch =
+            (0..hashes.len().max(expected.len())).find(|&i| hashes.get(i) != expected.get(i));
+
+        if let Some(w) = first_mismatch {
+            println!(
+                "  {name}: audio mismatch in window {w} ({w}s to {}s)",
+                w + 1
+            );
+            failures += 1;
+        }
+    }
+
+    let mut missing: Vec<_> = manifest.into_keys().collect();
+    missing.sort();
+    for name in missing {
+        println!("  {name}: in manifest but not in any project");
+        failures += 1;
+    }
+
+    if failures > 0 {
+        panic!("{failures} songs do not match the manifest (use `--update` if the change is intentional)");
+    }
+}
+
+fn main() {
+    let args = parse_args();
+
+    let songs: Vec<_> = args
+        .project_files
+        .iter()
+        .flat_map(|p| hash_project(p.clone()))
+        .collect();
+
+    if args.update {
+        write_manifest(&args, &songs);
+    } else {
+        test_manifest(&args, &songs);
+    }
+}
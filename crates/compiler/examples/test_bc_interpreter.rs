@@ -5,7 +5,7 @@
 //!
 //! This is an example and not a test as:
 //!    * test_bc_interpreter requires a command line input parameter (currently there are no MML examples in the repo)
-//!    * test_bc_interpreter is slow and thorough, emulating the first few minutes of every song in the project file.
+//!    * test_bc_interpreter is slow and thorough, emulating every song in the project file in full.
 
 use compiler::{
     audio_driver,
@@ -67,6 +67,7 @@ fn load_song(
         stereo_flag,
         play_song: false,
         skip_echo_buffer_reset: true,
+        tick_budget: false,
     }
     .driver_value();
 
@@ -81,6 +82,9 @@ fn load_song(
         edl: echo_buffer.edl_register(),
     });
 
+    // Only the audio driver variables are tested, the voices do not need to be emulated
+    emu.set_logic_only(true);
+
     emu
 }
 
@@ -305,6 +309,8 @@ fn assert_bc_intrepreter_matches_emu(
     test_range(addresses::ECHO_VARIABLES, ECHO_VARIABLES_SIZE, "echo");
 
     test_byte(addresses::MAX_EDL, "maxEdl");
+
+    test_byte(addresses::ACTIVE_MUSIC_CHANNELS, "activeMusicChannels");
 }
 
 fn read_ptrs(apuram: &[u8; 0x10000], addr_l: u16, addr_h: u16) -> [Option<u16>; N_MUSIC_CHANNELS] {
@@ -350,49 +356,69 @@ fn song_ticks(song: &SongData) -> TickCounter {
 
 fn test_bc_intrepreter(song: &SongData, common_audio_data: &CommonAudioData) {
     const STEREO_FLAG: bool = true;
+    const TICKS_BETWEEN_TESTS: u32 = 31;
 
-    // Clamp to ensure 16 bit tick_counter does not overflow
     // +30 ticks to test for song looping
-    let ticks_to_test = song_ticks(song).clamp(TickCounter::new(192), TickCounter::new(0x8000))
-        + TickCounter::new(30);
+    let ticks_to_test = song_ticks(song).max(TickCounter::new(192)) + TickCounter::new(30);
 
     let mut emu = load_song(common_audio_data, song, STEREO_FLAG);
 
-    // Wait for the audio-driver to finish initialization
-    emu.emulate();
-    emu.emulate();
+    // Wait for the audio-driver to finish initialization and process the first tick
+    let r = emu.run_until_pc(
+        addresses::PROCESS_MUSIC_CHANNELS_CODE,
+        ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+    );
+    assert!(r.hit, "audio driver did not finish initialization");
+    while !addresses::MAIN_LOOP_CODE_RANGE.contains(&emu.program_counter()) {
+        emu.run_until_pc(
+            addresses::MAINLOOP_CODE,
+            ShvcSoundEmu::SMP_CLOCKS_PER_SAMPLE,
+        );
+    }
 
     let dummy_emu_init = Box::from(DummyEmu {
         apuram: *emu.apuram(),
     });
 
-    // Add a second limit, so it doesn't emulate a very very long (119 minute) song
-    for _ in 0..1000 {
-        emu.write_io_ports([io_commands::UNPAUSE, 0, 0, 0]);
-        for _ in 0..17 {
-            emu.emulate();
-        }
+    emu.write_io_ports([io_commands::UNPAUSE, 0, 0, 0]);
 
-        // Pausing the emulator ensures all bytecode instructions have completed
-        emu.write_io_ports([io_commands::PAUSE, 0, 0, 0]);
-        emu.emulate();
-        emu.emulate();
+    const STC: usize = addresses::SONG_TICK_COUNTER as usize;
+    let read_song_tick_counter =
+        |emu: &ShvcSoundEmu| u16::from_le_bytes(emu.apuram()[STC..STC + 2].try_into().unwrap());
 
-        // Confirm previous command was acknowledged by the audio driver.
-        assert_eq!(
-            emu.read_io_ports()[0],
-            io_commands::PAUSE,
-            "audio driver not paused"
-        );
+    // The interpreter is advanced alongside the emulator (instead of being restarted on every
+    // test), the whole song is tested in linear time.
+    //
+    // The audio driver's song tick counter is 16 bits, the tick count is tracked here so long
+    // songs can be tested.
+    let mut tick_count = TickCounter::new(read_song_tick_counter(&emu).into());
+
+    let mut interpreter = SongInterpreter::new(common_audio_data, song, STEREO_FLAG);
+    let valid = interpreter.process_ticks(tick_count);
+    assert!(valid, "SongIntreperter time out");
+
+    for i in 0.. {
+        // Vary the number of ticks between tests
+        let ticks = 1 + i % TICKS_BETWEEN_TESTS;
 
-        const STC: usize = addresses::SONG_TICK_COUNTER as usize;
-        let tick_count = u16::from_le_bytes(emu.apuram()[STC..STC + 2].try_into().unwrap());
+        // Stops at the start of the next tick, after all bytecode instructions have completed
+        let r = emu.run_ticks(
+            ticks,
+            addresses::PROCESS_MUSIC_CHANNELS_CODE,
+            ShvcSoundEmu::SMP_CLOCKS_PER_SECOND * 60,
+        );
+        assert!(r.hit, "audio driver did not process {ticks} ticks");
 
-        let tick_count = TickCounter::new(tick_count.into());
+        tick_count += TickCounter::new(ticks);
+        assert_eq!(
+            read_song_tick_counter(&emu),
+            tick_count.value() as u16,
+            "audio driver song tick counter mismatch"
+        );
 
-        let mut interpreter = SongInterpreter::new(common_audio_data, song, STEREO_FLAG);
-        let valid = interpreter.process_ticks(tick_count);
+        let valid = interpreter.process_ticks(TickCounter::new(ticks));
         assert!(valid, "SongIntreperter time out");
+        assert_eq!(interpreter.tick_counter(), tick_count);
         assert_bc_intrepreter_matches_emu(&interpreter, &dummy_emu_init, &emu, tick_count);
 
         if tick_count > ticks_to_test {
@@ -0,0 +1,214 @@
+//! Emulator differential test
+//!
+//! Steps a reference (fast paths disabled) and an optimised (fast paths and BRR cache enabled)
+//! emulator in lockstep over every song in one or more projects, comparing the audio and
+//! `state_hash()` after every audio buffer (256 samples).
+//!
+//! On the first mismatch the buffer is replayed sample by sample to find the first divergent
+//! sample, then the S-SMP instructions the reference emulator executed during that sample are
+//! printed.
+//!
+//! Unlike test_emu_fast_paths (which only compares the end state), this test locates where the
+//! emulators diverge.
+//!
+//! This is an example and not a test as:
+//!    * test_emu_differential requires command line input parameters (the project files)
+//!    * test_emu_differential is slow, hashing the emulator state after every audio buffer.
+//!
+//! Run with `cargo run --release --example test_emu_differential examples/*.terrificaudio`.
+
+mod common;
+
+use compiler::{
+    common_audio_data::{build_common_audio_data, CommonAudioData},
+    data::{load_project_file, load_text_file_with_limit, validate_project_file_names},
+    driver_constants::LoaderDataType,
+    mml::compile_mml,
+    samples::build_sample_and_instrument_data,
+    songs::SongData,
+    sound_effects::{blank_compiled_sound_effects, CompiledSfxSubroutines},
+};
+use shvc_sound_emu::ShvcSoundEmu;
+
+use std::path::PathBuf;
+
+/// Number of audio buffers to emulate per song (approximately 16 seconds)
+const BUFFERS_TO_TEST: usize = 2000;
+
+struct Divergence {
+    sample: u64,
+    audio: bool,
+    state: bool,
+    /// Program counter and the 3 bytes at the program counter of each instruction
+    trace: Vec<(u16, [u8; 3])>,
+}
+
+fn load_song(
+    common_audio_data: &CommonAudioData,
+    song: &SongData,
+    stereo_flag: bool,
+) -> ShvcSoundEmu {
+    common::boot_song(
+        common_audio_data,
+        song,
+        &LoaderDataType {
+            stereo_flag,
+            play_song: true,
+            skip_echo_buffer_reset: false,
+            tick_budget: false,
+        },
+    )
+}
+
+/// Returns the S-SMP instructions executed while emulating the next sample
+fn trace_sample(mut emu: ShvcSoundEmu) -> Vec<(u16, [u8; 3])> {
+    let mut trace = Vec::new();
+    let mut clocks = 0;
+
+    while clocks < ShvcSoundEmu::SMP_CLOCKS_PER_SAMPLE {
+        let pc = emu.program_counter();
+        let apuram = emu.apuram();
+        let bytes = std::array::from_fn(|i| apuram[usize::from(pc.wrapping_add(i as u16))]);
+        trace.push((pc, bytes));
+
+        // Executes a single instruction
+        clocks += emu.fast_forward(1);
+    }
+
+    trace
+}
+
+/// Emulates both emulators sample by sample until they diverge
+fn find_divergence(
+    mut reference: ShvcSoundEmu,
+    mut optimised: ShvcSoundEmu,
+    first_sample: u64,
+) -> Divergence {
+    let mut sample = first_sample;
+
+    loop {
+        let previous = reference.clone();
+
+        let mut expected = [0; 2];
+        let mut samples = [0; 2];
+        reference.emulate_into(&mut expected);
+        optimised.emulate_into(&mut samples);
+
+        let audio = expected != samples;
+        let state = reference.state_hash() != optimised.state_hash();
+
+        if audio || state {
+            return Divergence {
+                sample,
+                audio,
+                state,
+                trace: trace_sample(previous),
+            };
+        }
+
+        sample += 1;
+
+        if sample >= first_sample + ShvcSoundEmu::AUDIO_BUFFER_SAMPLES as u64 {
+            // The emulators only diverge when a whole buffer is emulated
+            return Divergence {
+                sample: first_sample,
+                audio: true,
+                state: true,
+                trace: Vec::new(),
+            };
+        }
+    }
+}
+
+fn test_song(name: &str, common_audio_data: &CommonAudioData, song: &SongData) -> bool {
+    const STEREO_FLAG: bool = true;
+
+    let mut reference = load_song(common_audio_data, song, STEREO_FLAG);
+    reference.set_fast_paths(false);
+
+    let mut optimised = reference.clone();
+    optimised.set_fast_paths(true);
+    optimised.set_brr_cache_enabled(true);
+
+    for buffer in 0..BUFFERS_TO_TEST {
+        let checkpoint = (reference.clone(), optimised.clone());
+
+        let expected = *reference.emulate();
+        let samples = *optimised.emulate();
+
+        if expected != samples || reference.state_hash() != optimised.state_hash() {
+            let first_sample = (buffer * ShvcSoundEmu::AUDIO_BUFFER_SAMPLES) as u64;
+            let d = find_divergence(checkpoint.0, checkpoint.1, first_sample);
+
+            let what = match (d.audio, d.state) {
+                (true, true) => "audio and emulator state",
+                (true, false) => "audio",
+                (false, _) => "emulator state",
+            };
+            println!(
+                "{name}: {what} mismatch at sample {} (S-SMP clock {})",
+                d.sample,
+                d.sample * ShvcSoundEmu::SMP_CLOCKS_PER_SAMPLE
+            );
+            println!("  reference S-SMP instructions:");
+            for (pc, bytes) in &d.trace {
+                println!(
+                    "    {pc:04x}: {:02x} {:02x} {:02x}",
+                    bytes[0], bytes[1], bytes[2]
+                );
+            }
+
+            return false;
+        }
+    }
+
+    true
+}
+
+fn test_project(pf_path: PathBuf) -> usize {
+    let project = load_project_file(&pf_path).unwrap();
+    let project = validate_project_file_names(project).unwrap();
+
+    let samples = build_sample_and_instrument_data(&project).unwrap();
+
+    let sfx_subs = CompiledSfxSubroutines::blank();
+    let sfx = blank_compiled_sound_effects();
+
+    let common_audio_data = build_common_audio_data(&samples, &sfx_subs, &sfx).unwrap();
+
+    let mut failures = 0;
+
+    for song in project.songs.list() {
+        println!("Testing song: {}", song.name);
+
+        let mml_file = load_text_file_with_limit(&song.source, &project.parent_path).unwrap();
+
+        let song_data = compile_mml(
+            &mml_file,
+            Some(song.name.clone()),
+            &project.instruments_and_samples,
+            samples.pitch_table(),
+        )
+        .unwrap();
+
+        if !test_song(song.name.as_str(), &common_audio_data, &song_data) {
+            failures += 1;
+        }
+    }
+
+    failures
+}
+
+fn main() {
+    let args = std::env::args_os();
+
+    if args.len() < 2 {
+        panic!("Expected arguments: project files");
+    }
+
+    let failures: usize = args.skip(1).map(|a| test_project(PathBuf::from(a))).sum();
+
+    if failures > 0 {
+        panic!("{failures} songs diverged");
+    }
+}
@@ -0,0 +1,144 @@
+//! Emulator fast path test
+//!
+//! Tests the shvc-sound-emu fast paths output identical audio and emulator state to the reference
+//! (fast paths disabled) emulator by playing every song in a project with both emulators.
+//!
+//! The songs are emulated in parallel with `run_emulator_jobs()`.
+//!
+//! This is an example and not a test as:
+//!    * test_emu_fast_paths requires a command line input parameter (the project file)
+//!    * test_emu_fast_paths is slow, emulating the first few seconds of every song twice.
+
+mod common;
+
+use compiler::{
+    common_audio_data::{build_common_audio_data, CommonAudioData},
+    data::{load_project_file, load_text_file_with_limit, validate_project_file_names},
+    driver_constants::LoaderDataType,
+    mml::compile_mml,
+    samples::build_sample_and_instrument_data,
+    songs::SongData,
+    sound_effects::{blank_compiled_sound_effects, CompiledSfxSubroutines},
+};
+use shvc_sound_emu::{run_emulator_jobs, EmulatorJob, EmulatorJobResult, ShvcSoundEmu};
+
+use std::path::PathBuf;
+
+/// Number of audio buffers to emulate per song (approximately 4 seconds)
+const BUFFERS_TO_TEST: usize = 500;
+
+fn song_job(
+    common_audio_data: &CommonAudioData,
+    song: &SongData,
+    stereo_flag: bool,
+    fast_paths: bool,
+) -> EmulatorJob {
+    let mut apuram = vec![0; 0x10000];
+    common::write_driver_to_apuram(
+        &mut apuram,
+        common_audio_data,
+        song.data(),
+        &LoaderDataType {
+            stereo_flag,
+            play_song: true,
+            skip_echo_buffer_reset: false,
+            tick_budget: false,
+        },
+    );
+
+    EmulatorJob {
+        apuram,
+        registers: common::song_reset_registers(song),
+        fast_paths,
+        port_writes: Vec::new(),
+        smp_clocks: (BUFFERS_TO_TEST * ShvcSoundEmu::AUDIO_BUFFER_SAMPLES) as u64
+            * ShvcSoundEmu::SMP_CLOCKS_PER_SAMPLE,
+        output_audio: true,
+    }
+}
+
+fn test_fast_paths(name: &str, reference: &EmulatorJobResult, emu: &EmulatorJobResult) {
+    let buffers = reference
+        .samples
+        .chunks(ShvcSoundEmu::AUDIO_BUFFER_SIZE)
+        .zip(emu.samples.chunks(ShvcSoundEmu::AUDIO_BUFFER_SIZE));
+
+    for (i, (expected, samples)) in buffers.enumerate() {
+        assert_eq!(expected, samples, "{name}: audio mismatch (buffer {i})");
+    }
+    assert_eq!(
+        reference.samples.len(),
+        emu.samples.len(),
+        "{name}: audio length mismatch"
+    );
+
+    let mut reference_emu = ShvcSoundEmu::new(&[0; 64]);
+    let mut fast_paths_emu = ShvcSoundEmu::new(&[0; 64]);
+    reference_emu.load_state(&reference.state).unwrap();
+    fast_paths_emu.load_state(&emu.state).unwrap();
+
+    assert_eq!(
+        reference_emu.apuram(),
+        fast_paths_emu.apuram(),
+        "{name}: Audio-RAM mismatch"
+    );
+    assert_eq!(
+        reference_emu.dsp_registers(),
+        fast_paths_emu.dsp_registers(),
+        "{name}: S-DSP register mismatch"
+    );
+    assert_eq!(
+        reference_emu.state_hash(),
+        fast_paths_emu.state_hash(),
+        "{name}: emulator state mismatch"
+    );
+}
+
+fn main() {
+    let mut args = std::env::args_os();
+
+    if args.len() != 2 {
+        panic!("Expected a single argument: project file");
+    }
+    let pf_path = PathBuf::from(args.nth(1).unwrap());
+
+    let project = load_project_file(&pf_path).unwrap();
+    let project = validate_project_file_names(project).unwrap();
+
+    let samples = build_sample_and_instrument_data(&project).unwrap();
+
+    let sfx_subs = CompiledSfxSubroutines::blank();
+    let sfx = blank_compiled_sound_effects();
+
+    let common_audio_data = build_common_audio_data(&samples, &sfx_subs, &sfx).unwrap();
+
+    const STEREO_FLAG: bool = true;
+
+    let mut names = Vec::new();
+    let mut jobs = Vec::new();
+
+    for song in project.songs.list() {
+        let mml_file = load_text_file_with_limit(&song.source, &project.parent_path).unwrap();
+
+        let song_data = compile_mml(
+            &mml_file,
+            Some(song.name.clone()),
+            &project.instruments_and_samples,
+            samples.pitch_table(),
+        )
+        .unwrap();
+
+        names.push(song.name.clone());
+        jobs.push(song_job(&common_audio_data, &song_data, STEREO_FLAG, false));
+        jobs.push(song_job(&common_audio_data, &song_data, STEREO_FLAG, true));
+    }
+
+    // Emulate every song (with and without fast paths) in parallel
+    let results = run_emulator_jobs(&jobs, 0);
+
+    for (name, r) in names.iter().zip(results.chunks_exact(2)) {
+        println!("Testing song: {name}");
+
+        test_fast_paths(name.as_str(), &r[0], &r[1]);
+    }
+}
@@ -0,0 +1,514 @@
+//! Trace timeline
+//!
+//! Loads a project's audio driver, common audio data and song with
+//! `ShvcSoundEmu::simulate_loader_transfers()`, plays the song in the emulator and prints a
+//! Chrome trace-event JSON file (to stdout) that can be opened in `chrome://tracing` or
+//! <https://ui.perfetto.dev>.
+//!
+//! The trace contains:
+//!  * Loader transfers as slices,
+//!  * Music ticks (`process_music_channels()` calls) as slices,
+//!  * IO commands as flow events, from the S-CPU port write to the driver reading the command
+//!    and to the driver acknowledging it,
+//!  * KON and KOFF S-DSP writes as instant events on each voice's track.
+//!
+//! Timestamps are S-SMP clocks (converted to microseconds) since the emulator was reset.
+//!
+//! `--sfx NAME@SECONDS` sends a play sound effect IO command at `SECONDS` (can be used multiple
+//! times).  Like the S-CPU API, a command is not sent until the previous command has been
+//! acknowledged.
+//!
+//! This is an example and not a test as it requires project files.
+//!
+//! Run with `cargo run --release --example trace_timeline -- [--seconds N] [--sfx NAME@SECONDS]... PROJECT_FILE SONG > trace.json`.
+
+use compiler::{
+    audio_driver,
+    common_audio_data::build_common_audio_data,
+    data::{load_project_file, load_text_file_with_limit, validate_project_file_names},
+    driver_constants::{
+        addresses, io_commands, LoaderDataType, IO_COMMAND_I_MASK, IO_COMMAND_MASK,
+    },
+    mml::compile_mml,
+    samples::build_sample_and_instrument_data,
+    sfx_file::load_sound_effects_file,
+    sound_effects::{
+        blank_compiled_sound_effects, combine_sound_effects, compile_sound_effects_file,
+        CompiledSfxSubroutines,
+    },
+};
+use serde_json::{json, Value};
+use shvc_sound_emu::{LoaderTransfer, ScpuLoaderTiming, ShvcSoundEmu};
+
+use std::collections::VecDeque;
+use std::io::Write;
+use std::path::PathBuf;
+
+/// LoaderDataType.CODE
+const LOADER_DATA_TYPE_CODE: u8 = 0;
+/// LoaderDataType.COMMON_DATA
+const LOADER_DATA_TYPE_COMMON_DATA: u8 = 1;
+/// LoaderDataType.FAST_TRANSFER_BIT
+const FAST_TRANSFER_FLAG: u8 = 1 << 4;
+
+/// TAD_DEFAULT_TRANSFER_PER_FRAME
+const BYTES_PER_FRAME: u32 = 256;
+
+const DEFAULT_SECONDS: u32 = 10;
+
+/// Centre pan
+const SFX_PAN: u8 = 128;
+
+const IO_PORT_0: u16 = 0x00f4;
+
+const KON_ADDR: u8 = 0x4c;
+const KOFF_ADDR: u8 = 0x5c;
+
+const WATCHPOINT_LOG_SIZE: usize = 0x4000;
+const DSP_LOG_CAPACITY: usize = 0x1000;
+
+/// Trace thread ids
+const SCPU_TID: u32 = 1;
+const LOADER_TID: u32 = 2;
+const DRIVER_TID: u32 = 3;
+const FIRST_VOICE_TID: u32 = 10;
+
+struct SfxCommand {
+    name: String,
+    smp_clock: u64,
+}
+
+struct Args {
+    seconds: u32,
+    sfx: Vec<SfxCommand>,
+    project_file: PathBuf,
+    song: String,
+}
+
+fn parse_args() -> Args {
+    let mut seconds = DEFAULT_SECONDS;
+    let mut sfx = Vec::new();
+    let mut positional = Vec::new();
+
+    let mut it = std::env::args_os().skip(1);
+    while let Some(a) = it.next() {
+        match a.to_str() {
+            Some("--seconds") => {
+                seconds = it
+                    .next()
+                    .and_then(|v| v.to_str()?.parse().ok())
+                    .expect("--seconds expects an integer");
+            }
+            Some("--sfx") => {
+                let v = it.next();
+                let (name, time) = v
+                    .as_ref()
+                    .and_then(|v| v.to_str()?.split_once('@'))
+                    .expect("--sfx expects NAME@SECONDS");
+                let time: f64 = time.parse().expect("--sfx expects NAME@SECONDS");
+
+                sfx.push(SfxCommand {
+                    name: name.to_owned(),
+                    smp_clock: (time * ShvcSoundEmu::SMP_CLOCKS_PER_SECOND as f64) as u64,
+                });
+            }
+            _ => positional.push(a),
+        }
+    }
+
+    let [project_file, song] = <[_; 2]>::try_from(positional)
+        .unwrap_or_else(|_| panic!("Expected a project file and a song name"));
+
+    sfx.sort_by_key(|s| s.smp_clock);
+
+    Args {
+        seconds,
+        sfx,
+        project_file: PathBuf::from(project_file),
+        song: song.into_string().expect("Invalid song name"),
+    }
+}
+
+/// Converts S-SMP clocks to trace-event microseconds
+fn ts(smp_clock: u64) -> f64 {
+    smp_clock as f64 * 1_000_000.0 / ShvcSoundEmu::SMP_CLOCKS_PER_SECOND as f64
+}
+
+#[derive(Default)]
+struct Trace {
+    events: Vec<Value>,
+}
+
+impl Trace {
+    fn thread_name(&mut self, tid: u32, name: &str) {
+        self.events.push(json!({
+            "ph": "M", "pid": 1, "tid": tid, "name": "thread_name", "args": { "name": name }
+        }));
+        self.events.push(json!({
+            "ph": "M", "pid": 1, "tid": tid, "name": "thread_sort_index", "args": { "sort_index": tid }
+        }));
+    }
+
+    fn slice(&mut self, tid: u32, name: &str, start: u64, end: u64, args: Value) {
+        self.events.push(json!({
+            "ph": "X", "pid": 1, "tid": tid, "name": name,
+            "ts": ts(start), "dur": ts(end.saturating_sub(start)), "args": args
+        }));
+    }
+
+    fn instant(&mut self, tid: u32, name: &str, clock: u64) {
+        self.events.push(json!({
+            "ph": "i", "s": "t", "pid": 1, "tid": tid, "name": name, "ts": ts(clock)
+        }));
+    }
+
+    /// `ph` is "s" (start), "t" (step) or "f" (end)
+    fn flow(&mut self, ph: &str, tid: u32, name: &str, id: u64, clock: u64) {
+        self.events.push(json!({
+            "ph": ph, "bp": "e", "cat": "io", "pid": 1, "tid": tid, "name": name, "id": id,
+            "ts": ts(clock)
+        }));
+    }
+}
+
+struct PendingCommand {
+    id: u64,
+    name: String,
+    command: u8,
+    sent: u64,
+    received: Option<u64>,
+}
+
+struct Timeline {
+    emu: ShvcSoundEmu,
+    trace: Trace,
+    previous_command: u8,
+    next_flow_id: u64,
+    pending: Option<PendingCommand>,
+    /// `smp_clock - dsp_clock * 2` (the S-SMP runs at twice the S-DSP clock rate)
+    dsp_clock_offset: u64,
+}
+
+impl Timeline {
+    fn transfer(&mut self, name: &str, timing: &ScpuLoaderTiming, data_type: u8, data: &[u8]) {
+        let start = self.emu.counters().smp_clocks;
+
+        let r = match self
+            .emu
+            .simulate_loader_transfers(
+                timing,
+                &[LoaderTransfer {
+                    data_type,
+                    data: data.to_vec(),
+                }],
+            )
+            .first()
+        {
+            Some(r) if r.ok => *r,
+            _ => panic!("{name}: loader timeout"),
+        };
+
+        let end = self.emu.counters().smp_clocks;
+        self.trace.slice(
+            LOADER_TID,
+            name,
+            start,
+            end,
+            json!({ "bytes": data.len(), "frames": r.frames, "handshakes": r.handshakes }),
+        );
+    }
+
+    /// Schedules an IO command if the previous command has been acknowledged
+    fn try_send_command(&mut self, name: &str, command: u8, param: u8, smp_clock: u64) -> bool {
+        if self.pending.is_some() || self.emu.read_io_ports()[0] != self.previous_command {
+            return false;
+        }
+
+        let command =
+            ((self.previous_command ^ u8::MAX) & IO_COMMAND_I_MASK) | (command & IO_COMMAND_MASK);
+        let sent = smp_clock.max(self.emu.counters().smp_clocks);
+
+        self.emu
+            .schedule_port_write(sent, [command, param, SFX_PAN, 0]);
+        self.previous_command = command;
+
+        let id = self.next_flow_id;
+        self.next_flow_id += 1;
+
+        self.trace.slice(
+            SCPU_TID,
+            name,
+            sent,
+            sent + 1,
+            json!({ "command": command }),
+        );
+        self.trace.flow("s", SCPU_TID, name, id, sent);
+
+        self.pending = Some(PendingCommand {
+            id,
+            name: name.to_owned(),
+            command,
+            sent,
+            received: None,
+        });
+        true
+    }
+
+    fn process_io_port_hits(&mut self) {
+        for h in self.emu.take_watchpoint_hits() {
+            let p = match &mut self.pending {
+                Some(p) if h.smp_clock >= p.sent && h.data == p.command => p,
+                _ => continue,
+            };
+            match h.kind {
+                ShvcSoundEmu::WATCH_READ if p.received.is_none() => {
+                    p.received = Some(h.smp_clock);
+                }
+                ShvcSoundEmu::WATCH_WRITE => {
+                    let received = p.received.unwrap_or(h.smp_clock);
+                    let (id, name) = (p.id, std::mem::take(&mut p.name));
+
+                    self.trace.slice(
+                        DRIVER_TID,
+                        &name,
+                        received,
+                        h.smp_clock,
+                        json!({ "latency_us": ts(h.smp_clock - p.sent) }),
+                    );
+                    self.trace.flow("t", DRIVER_TID, &name, id, received);
+                    self.trace.flow("f", DRIVER_TID, &name, id, h.smp_clock);
+                    self.pending = None;
+                }
+                _ => (),
+            }
+        }
+    }
+
+    fn process_dsp_log(&mut self) {
+        // Audio-RAM writes are not traced
+        self.emu.take_apuram_write_log();
+
+        for w in self.emu.take_dsp_register_log() {
+            let name = match w.address {
+                KON_ADDR => "KON",
+                KOFF_ADDR => "KOFF",
+                _ => continue,
+            };
+            let clock = w.dsp_clock * 2 + self.dsp_clock_offset;
+            for v in 0..8 {
+                if w.value & (1 << v) != 0 {
+                    self.trace.instant(FIRST_VOICE_TID + v, name, clock);
+                }
+            }
+        }
+    }
+
+    /// Emulates a single music tick, returns false if the driver stopped processing ticks
+    fn music_tick(&mut self, tick: u32) -> bool {
+        let r = self.emu.run_ticks(
+            1,
+            addresses::PROCESS_MUSIC_CHANNELS_CODE,
+            ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+        );
+        if !r.hit || self.emu.halted() {
+            return false;
+        }
+        let start = self.emu.counters().smp_clocks;
+
+        // `process_music_channels()` is called, the return address is on the stack
+        let sp = usize::from(self.emu.smp_registers().sp);
+        let stack = &self.emu.apuram()[0x100..0x200];
+        let return_addr = u16::from_le_bytes([stack[(sp + 1) & 0xff], stack[(sp + 2) & 0xff]]);
+
+        let r = self
+            .emu
+            .run_until_pc(return_addr, ShvcSoundEmu::SMP_CLOCKS_PER_SECOND);
+        if !r.hit {
+            return false;
+        }
+        let end = self.emu.counters().smp_clocks;
+
+        self.trace.slice(
+            DRIVER_TID,
+            "music tick",
+            start,
+            end,
+            json!({ "tick": tick, "smp_clocks": end - start }),
+        );
+        true
+    }
+}
+
+fn main() {
+    let args = parse_args();
+
+    let project = load_project_file(&args.project_file).unwrap();
+    let project = validate_project_file_names(project).unwrap();
+
+    let samples = build_sample_and_instrument_data(&project).unwrap();
+
+    let (sfx_subs, sfx) = match &project.sound_effect_file {
+        Some(source) => {
+            let sfx_file = load_sound_effects_file(source, &project.parent_path).unwrap();
+            let (subs, sfx) = compile_sound_effects_file(
+                &sfx_file,
+                &project.instruments_and_samples,
+                samples.pitch_table(),
+            )
+            .unwrap();
+            let sfx =
+                combine_sound_effects(&sfx, &project.sfx_export_order, project.default_sfx_flags)
+                    .unwrap();
+            (subs, sfx)
+        }
+        None => (
+            CompiledSfxSubroutines::blank(),
+            blank_compiled_sound_effects(),
+        ),
+    };
+
+    let common_audio_data = build_common_audio_data(&samples, &sfx_subs, &sfx).unwrap();
+
+    let song = project
+        .songs
+        .get(&args.song)
+        .unwrap_or_else(|| panic!("Cannot find song: {}", args.song));
+    let mml_file = load_text_file_with_limit(&song.source, &project.parent_path).unwrap();
+    let song_data = compile_mml(
+        &mml_file,
+        Some(song.name.clone()),
+        &project.instruments_and_samples,
+        samples.pitch_table(),
+    )
+    .unwrap();
+
+    let mut sfx_queue: VecDeque<(String, u8, u64)> = args
+        .sfx
+        .iter()
+        .map(|s| {
+            let (id, _) = project
+                .sfx_export_order
+                .export_order
+                .get_with_index(&s.name)
+                .unwrap_or_else(|| panic!("Cannot find sound effect: {}", s.name));
+            let id = u8::try_from(id).expect("sound effect id out of range");
+            (s.name.clone(), id, s.smp_clock)
+        })
+        .collect();
+
+    let mut emu = ShvcSoundEmu::new(&[0; 64]);
+
+    let loader_addr = usize::from(addresses::LOADER);
+    emu.apuram_mut()[loader_addr..loader_addr + audio_driver::LOADER.len()]
+        .copy_from_slice(audio_driver::LOADER);
+
+    emu.reset(shvc_sound_emu::ResetRegisters {
+        pc: addresses::LOADER,
+        a: 0,
+        x: 0,
+        y: 0,
+        psw: 0,
+        sp: 0xff,
+        esa: 0,
+        edl: 0,
+    });
+
+    let mut tl = Timeline {
+        emu,
+        trace: Trace::default(),
+        // The audio driver starts paused
+        previous_command: io_commands::PAUSE,
+        next_flow_id: 1,
+        pending: None,
+        dsp_clock_offset: 0,
+    };
+
+    tl.trace.thread_name(SCPU_TID, "S-CPU");
+    tl.trace.thread_name(LOADER_TID, "Loader");
+    tl.trace.thread_name(DRIVER_TID, "Audio driver");
+    for v in 0..8 {
+        tl.trace
+            .thread_name(FIRST_VOICE_TID + v, &format!("Voice {v}"));
+    }
+
+    // `Tad_Init` transfers the audio driver with a blocking fast transfer
+    tl.transfer(
+        "audio driver",
+        &ScpuLoaderTiming::ntsc(0),
+        LOADER_DATA_TYPE_CODE | FAST_TRANSFER_FLAG,
+        audio_driver::AUDIO_DRIVER,
+    );
+
+    let timing = ScpuLoaderTiming::ntsc(BYTES_PER_FRAME);
+    tl.transfer(
+        "common audio data",
+        &timing,
+        LOADER_DATA_TYPE_COMMON_DATA,
+        common_audio_data.data(),
+    );
+
+    let data_type = LoaderDataType {
+        stereo_flag: true,
+        play_song: true,
+        skip_echo_buffer_reset: false,
+        tick_budget: false,
+    }
+    .driver_value();
+    tl.transfer(
+        song.name.as_str(),
+        &timing,
+        data_type | FAST_TRANSFER_FLAG,
+        song_data.data(),
+    );
+
+    tl.emu.add_watchpoint(
+        IO_PORT_0..=IO_PORT_0,
+        ShvcSoundEmu::WATCH_READ | ShvcSoundEmu::WATCH_WRITE,
+    );
+    tl.emu.set_watchpoint_log_size(WATCHPOINT_LOG_SIZE);
+    tl.emu.start_dsp_log(DSP_LOG_CAPACITY);
+
+    let c = tl.emu.counters();
+    tl.dsp_clock_offset = c.smp_clocks.saturating_sub(c.dsp_clocks * 2);
+
+    // Wait for the audio driver to initialise before unpausing it
+    let r = tl.emu.run_until_pc(
+        addresses::MAINLOOP_CODE,
+        ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+    );
+    assert!(r.hit, "audio driver did not start");
+    assert!(tl.try_send_command("UNPAUSE", io_commands::UNPAUSE, 0, 0));
+
+    let end_clock = u64::from(args.seconds) * ShvcSoundEmu::SMP_CLOCKS_PER_SECOND;
+    let mut tick = 0;
+
+    while tl.emu.counters().smp_clocks < end_clock {
+        if let Some((name, id, clock)) = sfx_queue.front() {
+            if tl.try_send_command(name, io_commands::PLAY_SOUND_EFFECT, *id, *clock) {
+                sfx_queue.pop_front();
+            }
+        }
+
+        let ok = tl.music_tick(tick);
+
+        tl.process_io_port_hits();
+        tl.process_dsp_log();
+
+        if !ok {
+            eprintln!(
+                "audio driver stopped processing music ticks (PC = 0x{:04x})",
+                tl.emu.program_counter()
+            );
+            break;
+        }
+        tick += 1;
+    }
+
+    let mut out = std::io::BufWriter::new(std::io::stdout().lock());
+    serde_json::to_writer(
+        &mut out,
+        &json!({ "traceEvents": tl.trace.events, "displayTimeUnit": "ns" }),
+    )
+    .unwrap();
+    writeln!(out).unwrap();
+}
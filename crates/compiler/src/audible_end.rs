@@ -0,0 +1,279 @@
+//! One-shot sample audible end analysis
+//!
+//! Finds the BRR block where a non-looping sample, played with its envelope, drops below a
+//! threshold and stays below it until the end of the sample.
+
+// SPDX-FileCopyrightText: © 2025 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+use crate::data::{Instrument, Sample};
+use crate::notes::Note;
+use crate::pitch_table::PITCH_REGISTER_MAX;
+use crate::samples::{test_instrument_pitches, InstrumentSampleData, SampleSampleData};
+
+use brr::{decode_brr_data, BrrSample, BYTES_PER_BRR_BLOCK, SAMPLES_PER_BLOCK};
+
+/// Default audible threshold in decibels relative to full scale
+pub const DEFAULT_AUDIBLE_THRESHOLD_DB: f64 = -60.0;
+
+/// S-DSP envelope rate periods (in 32000Hz samples), indexed by rate.
+/// (Rate 0 never changes the envelope)
+const RATE_PERIODS: [u32; 32] = [
+    0, 2048, 1536, 1280, 1024, 768, 640, 512, 384, 320, 256, 192, 160, 128, 96, 80, 64, 48, 40, 32,
+    24, 20, 16, 12, 10, 8, 6, 5, 4, 3, 2, 1,
+];
+
+/// Maximum S-DSP envelope value
+const ENVELOPE_MAX: i32 = 0x7ff;
+
+/// Number of source samples read by the gaussian interpolation
+const GAUSSIAN_SAMPLES: usize = 4;
+
+/// S-DSP output sample rate
+const SAMPLE_RATE: u64 = 32000;
+
+/// S-DSP pitch register value that plays the source sample at `SAMPLE_RATE`
+const PITCH_SCALE: u64 = 0x1000;
+
+/// Limits the number of output samples simulated (10 minutes)
+const MAX_OUTPUT_SAMPLES: u64 = SAMPLE_RATE * 60 * 10;
+
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct AudibleEnd {
+    /// Number of BRR blocks that are played above the threshold
+    pub audible_blocks: usize,
+    /// Number of BRR blocks in the sample
+    pub n_blocks: usize,
+}
+
+impl AudibleEnd {
+    /// Number of bytes that would be saved if the sample ended at the audible end
+    pub fn bytes_saved(&self) -> usize {
+        (self.n_blocks - self.audible_blocks) * BYTES_PER_BRR_BLOCK
+    }
+}
+
+#[derive(Clone, Copy, PartialEq)]
+enum EnvelopeMode {
+    Attack,
+    Decay,
+    Sustain,
+}
+
+/// Simulates the S-DSP envelope of a voice that is never keyed-off
+struct EnvelopeEngine {
+    adsr1: u8,
+    adsr2_or_gain: u8,
+    mode: EnvelopeMode,
+    envelope: i32,
+    hidden_envelope: i32,
+}
+
+impl EnvelopeEngine {
+    fn new(adsr1: u8, adsr2_or_gain: u8) -> Self {
+        Self {
+            adsr1,
+            adsr2_or_gain,
+            mode: EnvelopeMode::Attack,
+            envelope: 0,
+            hidden_envelope: 0,
+        }
+    }
+
+    /// Returns the envelope after processing output sample `sample`
+    fn process(&mut self, sample: u64) -> i32 {
+        let mut env = self.envelope;
+
+        let rate = if self.adsr1 & 0x80 != 0 {
+            let adsr2 = self.adsr2_or_gain;
+
+            if self.mode == EnvelopeMode::Attack {
+                let rate = (self.adsr1 & 0x0f) * 2 + 1;
+                env += if rate < 31 { 0x20 } else { 0x400 };
+                rate
+            } else {
+                env -= 1;
+                env -= env >> 8;
+                match self.mode {
+                    EnvelopeMode::Decay => ((self.adsr1 >> 3) & 0x0e) + 0x10,
+                    _ => adsr2 & 0x1f,
+                }
+            }
+        } else {
+            let gain = self.adsr2_or_gain;
+
+            match gain >> 5 {
+                0..=3 => {
+                    env = i32::from(gain) * 0x10;
+                    31
+                }
+                4 => {
+                    env -= 0x20;
+                    gain & 0x1f
+                }
+                5 => {
+                    env -= 1;
+                    env -= env >> 8;
+                    gain & 0x1f
+                }
+                6 => {
+                    env += 0x20;
+                    gain & 0x1f
+                }
+                _ => {
+                    env += match self.hidden_envelope >= 0x600 {
+                        true => 0x08,
+                        false => 0x20,
+                    };
+                    gain & 0x1f
+                }
+            }
+        };
+
+        if self.adsr1 & 0x80 != 0
+            && self.mode == EnvelopeMode::Decay
+            && (env >> 8) == i32::from(self.adsr2_or_gain >> 5)
+        {
+            self.mode = EnvelopeMode::Sustain;
+        }
+
+        self.hidden_envelope = env;
+
+        if !(0..=ENVELOPE_MAX).contains(&env) {
+            env = env.clamp(0, ENVELOPE_MAX);
+            if self.mode == EnvelopeMode::Attack {
+                self.mode = EnvelopeMode::Decay;
+            }
+        }
+
+        let period = RATE_PERIODS[usize::from(rate)];
+        if period != 0 && sample % u64::from(period) == 0 {
+            self.envelope = env;
+        }
+
+        self.envelope
+    }
+
+    /// Returns true if the envelope is 0 and can never increase
+    fn is_silent(&self) -> bool {
+        if self.envelope != 0 {
+            return false;
+        }
+
+        match self.adsr1 & 0x80 != 0 {
+            // The ADSR envelope only increases in the attack mode
+            true => self.mode != EnvelopeMode::Attack,
+            // Fixed or decreasing GAIN
+            false => self.adsr2_or_gain >> 5 <= 5,
+        }
+    }
+}
+
+/// Finds the audible end of a non-looping sample played with the given envelope.
+///
+/// The envelope is simulated from key-on (the voice is never keyed-off) and the sample is played
+/// at `max_pitch`, the fastest the sample is played, which has the least envelope decay at every
+/// sample position.
+///
+/// The gaussian interpolation output is bounded by the largest of the 4 source samples it reads
+/// (the gaussian kernel is non-negative and sums to 1.0), which is used instead of the gaussian
+/// kernel so the result applies to every pitch offset.
+///
+/// Returns None if the sample loops.
+pub fn audible_end(
+    brr: &BrrSample,
+    adsr1: u8,
+    adsr2_or_gain: u8,
+    max_pitch: u16,
+    threshold_db: f64,
+) -> Option<AudibleEnd> {
+    if brr.is_looping() {
+        return None;
+    }
+
+    let samples = decode_brr_data(brr.brr_data());
+    let n_blocks = brr.n_brr_blocks();
+
+    let threshold = f64::from(i16::MAX) * 10.0_f64.powf(threshold_db / 20.0);
+    let threshold = threshold.max(1.0) as i32;
+
+    let pitch = u64::from(max_pitch.clamp(1, PITCH_REGISTER_MAX));
+
+    let mut envelope = EnvelopeEngine::new(adsr1, adsr2_or_gain);
+    let mut audible_end = 0;
+
+    for t in 0..MAX_OUTPUT_SAMPLES {
+        let pos = usize::try_from(t * pitch / PITCH_SCALE).unwrap_or(usize::MAX);
+        if pos >= samples.len() {
+            break;
+        }
+
+        let env = envelope.process(t);
+        if envelope.is_silent() {
+            break;
+        }
+
+        let peak = samples[pos..(pos + GAUSSIAN_SAMPLES).min(samples.len())]
+            .iter()
+            .map(|s| i32::from(*s).abs())
+            .max()
+            .unwrap_or(0);
+
+        if (peak * env) >> 11 >= threshold {
+            audible_end = pos + GAUSSIAN_SAMPLES;
+        }
+    }
+
+    let audible_blocks = audible_end.div_ceil(SAMPLES_PER_BLOCK).max(1).min(n_blocks);
+
+    Some(AudibleEnd {
+        audible_blocks,
+        n_blocks,
+    })
+}
+
+/// Finds the audible end of a non-looping instrument, played at the highest note in the
+/// instrument's octave range.
+pub fn instrument_audible_end(
+    inst: &Instrument,
+    data: &InstrumentSampleData,
+    threshold_db: f64,
+) -> Option<AudibleEnd> {
+    let last_note = usize::from(Note::last_note_for_octave(inst.last_octave).note_id());
+
+    let max_pitch = test_instrument_pitches(data)
+        .and_then(|p| p.into_iter().take(last_note + 1).max())
+        .unwrap_or(PITCH_REGISTER_MAX);
+
+    audible_end(
+        data.brr_sample(),
+        data.adsr1(),
+        data.adsr2_or_gain(),
+        max_pitch,
+        threshold_db,
+    )
+}
+
+/// Finds the audible end of a non-looping sample, played at its highest sample rate.
+pub fn sample_audible_end(
+    sample: &Sample,
+    data: &SampleSampleData,
+    threshold_db: f64,
+) -> Option<AudibleEnd> {
+    let max_pitch = sample
+        .sample_rates
+        .iter()
+        .map(|&r| u64::from(r) * PITCH_SCALE / SAMPLE_RATE)
+        .max()
+        .and_then(|p| u16::try_from(p).ok())
+        .unwrap_or(PITCH_REGISTER_MAX);
+
+    audible_end(
+        data.brr_sample(),
+        data.adsr1(),
+        data.adsr2_or_gain(),
+        max_pitch,
+        threshold_db,
+    )
+}
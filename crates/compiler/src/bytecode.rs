@@ -970,6 +970,8 @@ pub struct State {
     pub(crate) early_release:
         IeState<Option<(EarlyReleaseTicks, EarlyReleaseMinTicks, OptionalGain)>>,
     pub(crate) detune: IeState<DetuneValue>,
+    pub(crate) volume: IeState<Volume>,
+    pub(crate) pan: IeState<Pan>,
     pub(crate) vibrato: VibratoState,
     pub(crate) prev_slurred_note: SlurredNoteState,
 
@@ -1004,6 +1006,8 @@ impl State {
         self.prev_temp_gain = IeState::Unknown;
         self.early_release = IeState::Unknown;
         self.detune = IeState::Unknown;
+        self.volume = IeState::Unknown;
+        self.pan = IeState::Unknown;
 
         self.vibrato = VibratoState::Unknown;
 
@@ -1019,6 +1023,8 @@ impl State {
         self.prev_temp_gain.demote_to_maybe();
         self.early_release.demote_to_maybe();
         self.detune.demote_to_maybe();
+        self.volume.demote_to_maybe();
+        self.pan.demote_to_maybe();
 
         self.vibrato = VibratoState::Unknown;
 
@@ -1032,6 +1038,8 @@ impl State {
         self.prev_temp_gain.merge_skip_last_loop(s.prev_temp_gain);
         self.early_release.merge_skip_last_loop(s.early_release);
         self.detune.merge_skip_last_loop(s.detune);
+        self.volume.merge_skip_last_loop(s.volume);
+        self.pan.merge_skip_last_loop(s.pan);
 
         // Ok - vibrato state is unknown at the start of the loop
         self.vibrato = s.vibrato;
@@ -1046,6 +1054,8 @@ impl State {
         self.prev_temp_gain.promote_to_known();
         self.early_release.promote_to_known();
         self.detune.promote_to_known();
+        self.volume.promote_to_known();
+        self.pan.promote_to_known();
 
         // No maybe vibrato state
         // No maybe prev_slurred_note state
@@ -1059,6 +1069,8 @@ impl State {
         self.prev_temp_gain.merge_subroutine(&s.prev_temp_gain);
         self.early_release.merge_subroutine(&s.early_release);
         self.detune.merge_subroutine(&s.detune);
+        self.volume.merge_subroutine(&s.volume);
+        self.pan.merge_subroutine(&s.pan);
 
         match &s.vibrato {
             VibratoState::Unchanged => (),
@@ -1085,6 +1097,8 @@ struct SkipLastLoop {
     prev_temp_gain: IeState<TempGain>,
     early_release: IeState<Option<(EarlyReleaseTicks, EarlyReleaseMinTicks, OptionalGain)>>,
     detune: IeState<DetuneValue>,
+    volume: IeState<Volume>,
+    pan: IeState<Pan>,
     vibrato: VibratoState,
     prev_slurred_note: SlurredNoteState,
 }
@@ -1152,6 +1166,8 @@ impl<'a> Bytecode<'a> {
                     BytecodeContext::SfxSubroutine => IeState::Unset,
                     BytecodeContext::MmlPrefix => IeState::Unset,
                 },
+                volume: IeState::Unset,
+                pan: IeState::Unset,
                 vibrato: match &context {
                     BytecodeContext::SoundEffect => VibratoState::Disabled,
                     BytecodeContext::SongChannel { .. } => VibratoState::Disabled,
@@ -1716,22 +1732,28 @@ impl<'a> Bytecode<'a> {
     }
 
     pub fn adjust_volume(&mut self, v: RelativeVolume) {
+        self.state.volume = IeState::Unknown;
         emit_bytecode!(self, opcodes::ADJUST_VOLUME, v.as_i8());
     }
 
     pub fn set_volume(&mut self, volume: Volume) {
+        self.state.volume = IeState::Known(volume);
         emit_bytecode!(self, opcodes::SET_VOLUME, volume.as_u8());
     }
 
     pub fn adjust_pan(&mut self, p: RelativePan) {
+        self.state.pan = IeState::Unknown;
         emit_bytecode!(self, opcodes::ADJUST_PAN, p.as_i8());
     }
 
     pub fn set_pan(&mut self, pan: Pan) {
+        self.state.pan = IeState::Known(pan);
         emit_bytecode!(self, opcodes::SET_PAN, pan.as_u8());
     }
 
     pub fn set_pan_and_volume(&mut self, pan: Pan, volume: Volume) {
+        self.state.pan = IeState::Known(pan);
+        self.state.volume = IeState::Known(volume);
         emit_bytecode!(
             self,
             opcodes::SET_PAN_AND_VOLUME,
@@ -1773,6 +1795,8 @@ impl<'a> Bytecode<'a> {
     pub fn volume_slide(&mut self, amount: VolumeSlideAmount, ticks: VolumeSlideTicks) {
         let opt = self._pan_vol_slide_offset_per_tick(amount, ticks);
 
+        self.state.volume = IeState::Unknown;
+
         let opcode = match amount.is_negative() {
             false => opcodes::VOLUME_SLIDE_UP,
             true => opcodes::VOLUME_SLIDE_DOWN,
@@ -1784,6 +1808,8 @@ impl<'a> Bytecode<'a> {
     pub fn pan_slide(&mut self, amount: PanSlideAmount, ticks: PanSlideTicks) {
         let opt = self._pan_vol_slide_offset_per_tick(amount, ticks);
 
+        self.state.pan = IeState::Unknown;
+
         let opcode = match amount.is_negative() {
             false => opcodes::PAN_SLIDE_UP,
             true => opcodes::PAN_SLIDE_DOWN,
@@ -1827,6 +1853,7 @@ impl<'a> Bytecode<'a> {
         amplitude: TremoloAmplitude,
         quarter_wavelength_ticks: TremoloQuarterWavelengthInTicks,
     ) {
+        self.state.volume = IeState::Unknown;
         self._tremolo_panbrello(opcodes::TREMOLO, amplitude, quarter_wavelength_ticks);
     }
 
@@ -1835,6 +1862,7 @@ impl<'a> Bytecode<'a> {
         amplitude: PanbrelloAmplitude,
         quarter_wavelength_ticks: PanbrelloQuarterWavelengthInTicks,
     ) {
+        self.state.pan = IeState::Unknown;
         self._tremolo_panbrello(opcodes::PANBRELLO, amplitude, quarter_wavelength_ticks);
     }
 
@@ -1929,6 +1957,8 @@ impl<'a> Bytecode<'a> {
             prev_temp_gain: self.state.prev_temp_gain,
             early_release: self.state.early_release,
             detune: self.state.detune,
+            volume: self.state.volume,
+            pan: self.state.pan,
             vibrato: self.state.vibrato,
             prev_slurred_note: self.state.prev_slurred_note.clone(),
         });
@@ -0,0 +1,40 @@
+//! Audio driver S-SMP cycle costs
+//!
+//! Regenerate with `cargo run --release --example bytecode_cycle_costs -- --rust PROJECT_FILE...`
+//! whenever the audio driver changes.
+//!
+//! NOTE: These are initial estimates and have not been measured.
+//!       `BC_UNKNOWN_INSTRUCTION_CYCLES` is used for opcodes that are not in
+//!       `BC_INSTRUCTION_CYCLES`.
+
+// SPDX-FileCopyrightText: © 2023 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+/// Bytecode dispatch S-SMP cycles per instruction (min, max, mean)
+pub const BC_DISPATCH_CYCLES: (u32, u32, u32) = (32, 40, 36);
+
+/// S-SMP cycles per music channel per tick, excluding bytecode (min, max, mean)
+pub const BC_CHANNEL_OVERHEAD_CYCLES: (u32, u32, u32) = (40, 420, 120);
+
+/// S-SMP cycles of an instruction that is not in `BC_INSTRUCTION_CYCLES` (the maximum of all instructions)
+pub const BC_UNKNOWN_INSTRUCTION_CYCLES: u32 = 380;
+
+/// S-SMP cycles per bytecode instruction, excluding dispatch (opcode, min, max, mean)
+/// (play-note instructions use `FIRST_PLAY_NOTE_INSTRUCTION`)
+pub const BC_INSTRUCTION_CYCLES: &[(u8, u32, u32, u32)] = &[
+    (0x01, 250, 330, 290), // portamento_down
+    (0x02, 250, 330, 290), // portamento_up
+    (0x05, 40, 40, 40),    // set_vibrato
+    (0x06, 300, 380, 340), // set_vibrato_depth_and_play_note
+    (0x09, 30, 30, 30),    // wait
+    (0x0a, 40, 40, 40),    // rest
+    (0x0b, 150, 200, 170), // set_instrument
+    (0x0c, 170, 220, 190), // set_instrument_and_adsr_or_gain
+    (0x29, 90, 90, 90),    // call_subroutine_and_disable_vibrato
+    (0x2a, 80, 80, 80),    // call_subroutine
+    (0x36, 60, 90, 75),    // end_loop
+    (0x37, 70, 70, 70),    // return_from_subroutine_and_disable_vibrato
+    (0x38, 60, 60, 60),    // return_from_subroutine
+    (0x40, 230, 300, 260), // play_note
+];
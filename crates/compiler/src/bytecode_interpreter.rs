@@ -1447,8 +1447,25 @@ where
         }
     }
 
+    /// Processes the next `ticks` ticks.
+    ///
+    /// Can be called repeatedly to advance the interpreter, `process_ticks(a)` followed by
+    /// `process_ticks(b)` is the same as `process_ticks(a + b)`.
+    ///
     /// Returns false if there was a timeout
     pub fn process_ticks(&mut self, ticks: TickCounter) -> bool {
+        self.process_ticks_inspect(ticks, |_, _| ())
+    }
+
+    /// Same as `process_ticks()`, but calls `on_instruction` with the channel's tick counter and
+    /// the opcode of every bytecode instruction before it is processed.
+    ///
+    /// Returns false if there was a timeout
+    pub fn process_ticks_inspect(
+        &mut self,
+        ticks: TickCounter,
+        mut on_instruction: impl FnMut(TickCounter, u8),
+    ) -> bool {
         // Prevent infinite loops by limiting the number of processed instructions
         let mut watchdog_counter: u32 = 2_000_000;
 
@@ -1456,12 +1473,19 @@ where
 
         let target_ticks = self.tick_counter + ticks;
 
+        let mut inspect = |c: &ChannelState| {
+            if let Some(&opcode) = song_data.get(usize::from(c.instruction_ptr)) {
+                on_instruction(c.ticks, opcode);
+            }
+        };
+
         while let Some((c, next_channel_ticks)) =
             Self::next_channel_to_process(&mut self.channels, target_ticks)
         {
             debug_assert!(next_channel_ticks >= c.ticks);
             debug_assert!(next_channel_ticks <= target_ticks);
 
+            inspect(c);
             c.process_next_bytecode(&mut self.global, song_data);
             watchdog_counter -= 1;
             if watchdog_counter == 0 {
@@ -1469,6 +1493,7 @@ where
             }
 
             while c.ticks < next_channel_ticks {
+                inspect(c);
                 c.process_next_bytecode(&mut self.global, song_data);
 
                 watchdog_counter -= 1;
@@ -1526,6 +1551,11 @@ where
         self.global.echo.edl
     }
 
+    /// Writes the interpreter state to the emulator.
+    ///
+    /// NOTE: The tick budget guard (`LoaderDataType::tick_budget`) is disabled.  The interpreter
+    /// does not model the vibrato ticks skipped by the guard, the vibrato phase will not match a
+    /// song that played with the guard enabled.
     pub fn write_to_emulator(&self, emu: &mut impl Emulator) {
         let common = CommonAudioDataSoA::new(&self.common_audio_data, self.stereo_flag);
 
@@ -1924,6 +1954,10 @@ impl InterpreterOutput {
             .enumerate()
             .fold(0, |acc, (i, c)| acc | (u8::from(c.dsp.echo) << i));
 
+        let active_channels: u8 = self.channels.iter().enumerate().fold(0, |acc, (i, c)| {
+            acc | (u8::from(c.soa.instruction_ptr > 0xff) << i)
+        });
+
         // write to apuram
         {
             let apuram: &mut [u8; 0x10000] = emu.apuram_mut();
@@ -1957,11 +1991,13 @@ impl InterpreterOutput {
                     stereo_flag: self.stereo_flag,
                     play_song: false,
                     skip_echo_buffer_reset: false,
+                    tick_budget: false,
                 }
                 .driver_value(),
             );
 
             apu_write(addresses::VOICE_CHANNELS_DIRTY_MUSIC, 0xff);
+            apu_write(addresses::ACTIVE_MUSIC_CHANNELS, active_channels);
 
             apu_write(addresses::KEYON_SHADOW_MUSIC, key_on_shadow);
             apu_write(addresses::KEYON_MASK_MUSIC, !key_on_shadow);
@@ -558,6 +558,18 @@ impl<'a> ChannelBcGenerator<'a> {
         }
     }
 
+    fn set_volume_if_changed(&mut self, volume: Volume) {
+        if !self.bc.get_state().volume.is_known_and_eq(&volume) {
+            self.bc.set_volume(volume);
+        }
+    }
+
+    fn set_pan_if_changed(&mut self, pan: Pan) {
+        if !self.bc.get_state().pan.is_known_and_eq(&pan) {
+            self.bc.set_pan(pan);
+        }
+    }
+
     fn play_note_or_pitch_with_detune(
         &mut self,
         note: NoteOrPitch,
@@ -1737,11 +1749,20 @@ impl<'a> ChannelBcGenerator<'a> {
 
             &Command::ChangePanAndOrVolume(pan, volume) => match (pan, volume) {
                 (Some(PanCommand::Absolute(p)), Some(VolumeCommand::Absolute(v))) => {
-                    self.bc.set_pan_and_volume(p, v);
+                    let state = self.bc.get_state();
+                    match (
+                        state.pan.is_known_and_eq(&p),
+                        state.volume.is_known_and_eq(&v),
+                    ) {
+                        (true, true) => (),
+                        (true, false) => self.bc.set_volume(v),
+                        (false, true) => self.bc.set_pan(p),
+                        (false, false) => self.bc.set_pan_and_volume(p, v),
+                    }
                 }
                 (pan, volume) => {
                     match volume {
-                        Some(VolumeCommand::Absolute(v)) => self.bc.set_volume(v),
+                        Some(VolumeCommand::Absolute(v)) => self.set_volume_if_changed(v),
                         Some(VolumeCommand::Relative(v)) => {
                             match RelativeVolume::try_from(v) {
                                 Ok(v) => self.bc.adjust_volume(v),
@@ -1766,7 +1787,7 @@ impl<'a> ChannelBcGenerator<'a> {
                         None => (),
                     }
                     match pan {
-                        Some(PanCommand::Absolute(p)) => self.bc.set_pan(p),
+                        Some(PanCommand::Absolute(p)) => self.set_pan_if_changed(p),
                         Some(PanCommand::Relative(p)) => self.bc.adjust_pan(p),
                         None => (),
                     }
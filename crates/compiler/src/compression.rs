@@ -0,0 +1,414 @@
+//! LZ compression for data decompressed by the loader
+
+// SPDX-FileCopyrightText: © 2024 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+// MUST match `Compressed data format` in `audio-driver/src/io-commands.wiz`
+//
+// A stream of tokens:
+//      0nnnnnnn <n bytes>                  - literal: copy the next `n` (1 - 127) bytes
+//      1nnnnnnn <offset_l> <offset_h>      - match: copy `n + MIN_MATCH_LENGTH` (n = 0 - 126)
+//                                            bytes from `output + offset` (offset is a negative u16)
+//      11111111 <addr_l> <addr_h>          - set destination (used by patches)
+//      00000000                            - end of data
+
+const END_TOKEN: u8 = 0;
+const MATCH_BIT: u8 = 0x80;
+const SET_DEST_TOKEN: u8 = 0xff;
+
+const MAX_LITERAL_LENGTH: usize = 0x7f;
+
+const MIN_MATCH_LENGTH: usize = 4;
+const MAX_MATCH_LENGTH: usize = 0x7e + MIN_MATCH_LENGTH;
+const MAX_MATCH_DISTANCE: usize = u16::MAX as usize;
+
+/// Unchanged bytes between two changes are included in a patch if the gap is shorter than this
+/// value (a set destination token is 3 bytes long).
+const MIN_PATCH_GAP: usize = 4;
+
+/// Maximum number of previous positions tested when searching for a match
+const MAX_CHAIN_LENGTH: usize = 256;
+
+const HASH_BITS: u32 = 12;
+
+const NO_POSITION: u32 = u32::MAX;
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum DecompressError {
+    UnexpectedEndOfData,
+    InvalidMatchOffset(usize),
+    InvalidDestination(u16),
+}
+
+fn hash(d: &[u8]) -> usize {
+    let v = u32::from_le_bytes([d[0], d[1], d[2], d[3]]);
+    (v.wrapping_mul(0x9E37_79B1) >> (32 - HASH_BITS)) as usize
+}
+
+fn insert(input: &[u8], pos: usize, head: &mut [u32], prev: &mut [u32]) {
+    if pos + MIN_MATCH_LENGTH <= input.len() {
+        let h = hash(&input[pos..]);
+        prev[pos] = head[h];
+        head[h] = pos as u32;
+    }
+}
+
+fn write_literals(out: &mut Vec<u8>, literals: &[u8]) {
+    for chunk in literals.chunks(MAX_LITERAL_LENGTH) {
+        out.push(chunk.len() as u8);
+        out.extend_from_slice(chunk);
+    }
+}
+
+/// Compresses `data` for the loader.
+///
+/// The loader only works with even addresses.  If `data` is an odd number of bytes, the
+/// decompressed data is padded with a zero byte.
+pub fn compress(data: &[u8]) -> Vec<u8> {
+    compress_patch(&[], data, 0)
+}
+
+/// Creates a compressed patch that changes `base` into `data` when it is decompressed to
+/// Audio-RAM `addr` (which MUST contain `base`).
+///
+/// Only the bytes that differ from `base` are included in the patch.  Matches can reference
+/// any byte before the current position, including unchanged bytes.
+///
+/// The loader only works with even addresses.  If `data` is an odd number of bytes, the
+/// patched data is padded with a zero byte.
+pub fn compress_patch(base: &[u8], data: &[u8], addr: u16) -> Vec<u8> {
+    let mut input = data.to_vec();
+    if input.len() % 2 != 0 {
+        input.push(0);
+    }
+    let input = input.as_slice();
+
+    let to_encode = changed_bytes(base, input);
+
+    let mut out = Vec::with_capacity(input.len() + input.len() / MAX_LITERAL_LENGTH + 2);
+
+    let mut head = vec![NO_POSITION; 1 << HASH_BITS];
+    let mut prev = vec![NO_POSITION; input.len()];
+
+    // The position of the next byte written by the decompressor
+    let mut dest = 0;
+
+    let mut literal_start = 0;
+    let mut pos = 0;
+
+    while pos < input.len() {
+        if !to_encode[pos] {
+            write_literals(&mut out, &input[literal_start..pos]);
+            insert(input, pos, &mut head, &mut prev);
+            pos += 1;
+            literal_start = pos;
+            continue;
+        }
+
+        if dest != pos {
+            write_set_dest(&mut out, addr, pos);
+        }
+
+        let mut best_length = 0;
+        let mut best_distance = 0;
+
+        if pos + MIN_MATCH_LENGTH <= input.len() {
+            let max_length = (input.len() - pos).min(MAX_MATCH_LENGTH);
+
+            let mut candidate = head[hash(&input[pos..])];
+            let mut chain = 0;
+
+            while candidate != NO_POSITION && chain < MAX_CHAIN_LENGTH {
+                let c = candidate as usize;
+                let distance = pos - c;
+                if distance > MAX_MATCH_DISTANCE {
+                    break;
+                }
+
+                // Matches can overlap the output
+                let length = (0..max_length)
+                    .take_while(|&i| input[c + i] == input[pos + i])
+                    .count();
+
+                if length > best_length {
+                    best_length = length;
+                    best_distance = distance;
+
+                    if length == max_length {
+                        break;
+                    }
+                }
+
+                candidate = prev[c];
+                chain += 1;
+            }
+        }
+
+        if best_length >= MIN_MATCH_LENGTH {
+            write_literals(&mut out, &input[literal_start..pos]);
+
+            let offset = (best_distance as u16).wrapping_neg();
+
+            out.push(MATCH_BIT | (best_length - MIN_MATCH_LENGTH) as u8);
+            out.extend_from_slice(&offset.to_le_bytes());
+
+            for p in pos..pos + best_length {
+                insert(input, p, &mut head, &mut prev);
+            }
+            pos += best_length;
+            literal_start = pos;
+        } else {
+            insert(input, pos, &mut head, &mut prev);
+            pos += 1;
+        }
+        dest = pos;
+    }
+
+    write_literals(&mut out, &input[literal_start..]);
+
+    // The loader uses the end of the data as the song address
+    if dest != input.len() {
+        write_set_dest(&mut out, addr, input.len());
+    }
+    out.push(END_TOKEN);
+
+    out
+}
+
+/// Returns a list of the bytes in `data` that are written by a patch.
+fn changed_bytes(base: &[u8], data: &[u8]) -> Vec<bool> {
+    let mut changed: Vec<bool> = data
+        .iter()
+        .enumerate()
+        .map(|(i, d)| base.get(i) != Some(d))
+        .collect();
+
+    // Include small gaps of unchanged bytes (as a literal is smaller than a set destination token)
+    let mut last_change = None;
+    for i in 0..changed.len() {
+        if changed[i] {
+            if let Some(l) = last_change {
+                if i - l <= MIN_PATCH_GAP {
+                    changed[l..i].fill(true);
+                }
+            }
+            last_change = Some(i);
+        }
+    }
+
+    changed
+}
+
+fn write_set_dest(out: &mut Vec<u8>, addr: u16, pos: usize) {
+    let d = addr.wrapping_add(pos as u16);
+
+    out.push(SET_DEST_TOKEN);
+    out.extend_from_slice(&d.to_le_bytes());
+}
+
+/// Decompresses data created by `compress()`.
+///
+/// Used to test the compressor, the loader decompresses the data in Audio-RAM.
+pub fn decompress(data: &[u8]) -> Result<Vec<u8>, DecompressError> {
+    decompress_patch(&[], data, 0)
+}
+
+/// Applies a patch created by `compress_patch()` to `base` (which is at Audio-RAM `addr`).
+///
+/// The output ends at the last byte written by the patch (the song address).
+///
+/// Used to test the compressor, the loader decompresses the data in Audio-RAM.
+pub fn decompress_patch(base: &[u8], data: &[u8], addr: u16) -> Result<Vec<u8>, DecompressError> {
+    let mut out = base.to_vec();
+    let mut pos = 0;
+
+    let write = |out: &mut Vec<u8>, pos: &mut usize, b: u8| {
+        match out.get_mut(*pos) {
+            Some(o) => *o = b,
+            None => out.push(b),
+        }
+        *pos += 1;
+    };
+
+    let mut iter = data.iter().copied();
+    let mut next = || iter.next().ok_or(DecompressError::UnexpectedEndOfData);
+
+    loop {
+        match next()? {
+            END_TOKEN => {
+                out.truncate(pos);
+                return Ok(out);
+            }
+            SET_DEST_TOKEN => {
+                let d = u16::from_le_bytes([next()?, next()?]);
+                let p = usize::from(d.wrapping_sub(addr));
+                if p > out.len() {
+                    return Err(DecompressError::InvalidDestination(d));
+                }
+                pos = p;
+            }
+            t if t & MATCH_BIT == 0 => {
+                for _ in 0..t {
+                    write(&mut out, &mut pos, next()?);
+                }
+            }
+            t => {
+                let length = usize::from(t & !MATCH_BIT) + MIN_MATCH_LENGTH;
+                let offset = u16::from_le_bytes([next()?, next()?]);
+                let distance = usize::from(offset.wrapping_neg());
+
+                if distance == 0 || distance > pos {
+                    return Err(DecompressError::InvalidMatchOffset(pos));
+                }
+
+                let start = pos - distance;
+                for i in 0..length {
+                    let b = out[start + i];
+                    write(&mut out, &mut pos, b);
+                }
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use super::*;
+
+    fn test_round_trip(data: &[u8]) -> Vec<u8> {
+        let c = compress(data);
+        let d = decompress(&c).unwrap();
+
+        assert_eq!(d.len() % 2, 0);
+        assert_eq!(&d[..data.len()], data);
+        assert!(d[data.len()..].iter().all(|&b| b == 0));
+
+        c
+    }
+
+    #[test]
+    fn empty() {
+        assert_eq!(test_round_trip(&[]), [END_TOKEN]);
+    }
+
+    #[test]
+    fn odd_length_is_padded() {
+        assert_eq!(test_round_trip(&[1, 2, 3]), [4, 1, 2, 3, 0, END_TOKEN]);
+    }
+
+    #[test]
+    fn long_literals() {
+        let data: Vec<u8> = (0..1000_usize).map(|i| (i * 7 + i / 256) as u8).collect();
+        test_round_trip(&data);
+    }
+
+    #[test]
+    fn overlapping_match() {
+        let c = test_round_trip(&[0xaa; 64]);
+        assert_eq!(c, [1, 0xaa, MATCH_BIT | (63 - 4), 0xff, 0xff, END_TOKEN]);
+    }
+
+    #[test]
+    fn long_match() {
+        let mut data: Vec<u8> = (0..=255).collect();
+        data.extend_from_within(..);
+        data.extend_from_within(..);
+
+        let c = test_round_trip(&data);
+        // 256 bytes of literals and 6 matches
+        assert_eq!(c.len(), 256 + 3 + 6 * 3 + 1);
+    }
+
+    #[test]
+    fn repeated_pattern() {
+        let mut data = Vec::new();
+        for i in 0..2000_u32 {
+            data.extend_from_slice(&[(i % 13) as u8, (i % 7) as u8, 0x10, 0x20]);
+        }
+        let c = test_round_trip(&data);
+        assert!(c.len() < data.len() / 4);
+    }
+
+    #[test]
+    fn max_match_length() {
+        let c = test_round_trip(&[0x55; 2 + MAX_MATCH_LENGTH]);
+        assert_eq!(
+            c,
+            [1, 0x55, MATCH_BIT | 126, 0xff, 0xff, 1, 0x55, END_TOKEN]
+        );
+        assert_ne!(c[2], SET_DEST_TOKEN);
+    }
+
+    fn test_patch(base: &[u8], data: &[u8]) -> Vec<u8> {
+        const ADDR: u16 = 0x1234;
+
+        let c = compress_patch(base, data, ADDR);
+        let d = decompress_patch(base, &c, ADDR).unwrap();
+
+        assert_eq!(d.len(), data.len().next_multiple_of(2));
+        assert_eq!(&d[..data.len()], data);
+
+        c
+    }
+
+    #[test]
+    fn patch_unchanged() {
+        let data: Vec<u8> = (0..1000_usize).map(|i| (i * 7 + i / 256) as u8).collect();
+        let c = test_patch(&data, &data);
+        assert_eq!(c, [SET_DEST_TOKEN, 0x1c, 0x16, END_TOKEN]);
+    }
+
+    #[test]
+    fn patch_small_changes() {
+        let base: Vec<u8> = (0..4000_usize).map(|i| (i * 7 + i / 256) as u8).collect();
+
+        let mut data = base.clone();
+        data[10] = 0;
+        data[12] = 0;
+        data[2000..2100].fill(0xaa);
+        data[3998] = 1;
+
+        let c = test_patch(&base, &data);
+        assert!(c.len() < 40);
+    }
+
+    #[test]
+    fn patch_matches_unchanged_data() {
+        let base: Vec<u8> = (0..1024_usize).map(|i| (i * 7 + i / 256) as u8).collect();
+
+        let mut data = base.clone();
+        data.copy_within(0..200, 600);
+
+        let c = test_patch(&base, &data);
+        assert!(c.len() < 20);
+    }
+
+    #[test]
+    fn patch_resize() {
+        let base: Vec<u8> = (0..1024_usize).map(|i| (i * 7 + i / 256) as u8).collect();
+
+        test_patch(&base, &base[..500]);
+        test_patch(&base, &base[..501]);
+        test_patch(&base[..500], &base);
+        test_patch(&base[..501], &base);
+        test_patch(&[], &base);
+    }
+
+    #[test]
+    fn invalid_data() {
+        assert_eq!(decompress(&[]), Err(DecompressError::UnexpectedEndOfData));
+        assert_eq!(
+            decompress(&[2, 1]),
+            Err(DecompressError::UnexpectedEndOfData)
+        );
+        assert_eq!(
+            decompress(&[1, 5, MATCH_BIT, 0xfe, 0xff, END_TOKEN]),
+            Err(DecompressError::InvalidMatchOffset(1))
+        );
+        assert_eq!(
+            decompress(&[2, 1, 2, SET_DEST_TOKEN, 3, 0, END_TOKEN]),
+            Err(DecompressError::InvalidDestination(3))
+        );
+    }
+}
@@ -15,7 +15,7 @@ mod _symbols {
 }
 
 pub mod addresses {
-    use std::ops::Range;
+    use std::ops::{Range, RangeInclusive};
 
     use super::_symbols;
 
@@ -31,6 +31,9 @@ pub mod addresses {
         DRIVER_CODE,
         MAINLOOP_CODE,
         PROCESS_MUSIC_CHANNELS_CODE,
+        PROCESS_BYTECODE_CODE,
+        PROCESS_NEXT_BYTECODE_CODE,
+        INSTRUCTION_PTR,
         LOADER,
         SONG_PTR,
         LOADER_DATA_TYPE,
@@ -42,8 +45,10 @@ pub mod addresses {
         EON_SHADOW_SFX,
         SONG_TICK_COUNTER,
         IO_MUSIC_CHANNELS_MASK,
+        MAX_TIMER_COUNTER,
         BYTECODE_STACK,
         VOICE_CHANNELS_DIRTY_MUSIC,
+        ACTIVE_MUSIC_CHANNELS,
         CHANNEL_VC_VOL_L,
         CHANNEL_VC_VOL_R,
         CHANNEL_VC_PITCH_L,
@@ -122,12 +127,53 @@ pub mod addresses {
         "mainloop() must be before process_music_channels()"
     );
     pub const MAIN_LOOP_CODE_RANGE: Range<u16> = MAINLOOP_CODE..PROCESS_MUSIC_CHANNELS_CODE;
+
+    /// The Audio-RAM holding the audio driver's variables.
+    ///
+    /// Everything below the common audio data, excluding the song tick counter (which never
+    /// repeats) and the S-SMP IO registers.
+    /// Used to detect when a song has looped in an emulator.
+    pub fn driver_state_ranges() -> Vec<RangeInclusive<u16>> {
+        let stc = SONG_TICK_COUNTER..=SONG_TICK_COUNTER + 1;
+
+        let mut out = Vec::new();
+        for r in [0x0000..=0x00ef, 0x0100..=COMMON_DATA - 1] {
+            if r.contains(stc.start()) || r.contains(stc.end()) {
+                if *stc.start() > *r.start() {
+                    out.push(*r.start()..=stc.start() - 1);
+                }
+                if *stc.end() < *r.end() {
+                    out.push(stc.end() + 1..=*r.end());
+                }
+            } else {
+                out.push(r);
+            }
+        }
+        out
+    }
 }
 
 pub const ECHO_VARIABLES_SIZE: usize = (addresses::ECHO_DIRTY - addresses::ECHO_VARIABLES) as usize;
 
 pub const TAD_IO_VERSION: usize = _symbols::TAD_IO_VERSION;
 
+/// Every symbol inside the audio driver code (address and name), sorted by address
+pub const DRIVER_CODE_SYMBOLS: &[(u16, &str)] = _symbols::DRIVER_CODE_SYMBOLS;
+
+/// Returns the audio driver code symbol containing `addr` and the offset of `addr` from the symbol,
+/// or `None` if `addr` is outside the audio driver code.
+pub fn driver_code_symbol(addr: u16) -> Option<(&'static str, u16)> {
+    let code_end = addresses::DRIVER_CODE as usize + crate::audio_driver::AUDIO_DRIVER.len();
+    if usize::from(addr) >= code_end {
+        return None;
+    }
+
+    let i = DRIVER_CODE_SYMBOLS.partition_point(|(a, _)| *a <= addr);
+    let (symbol_addr, name) = DRIVER_CODE_SYMBOLS[..i].last()?;
+
+    Some((name, addr - symbol_addr))
+}
+
 pub const N_MUSIC_CHANNELS: usize = 8;
 pub const N_SFX_CHANNELS: usize = 2;
 pub const N_CHANNELS: usize = N_MUSIC_CHANNELS + N_SFX_CHANNELS;
@@ -185,6 +231,12 @@ pub struct LoaderDataType {
     // NOTE: `SkipEchoBufferReset` can corrupt memory if the internal S-DSP echo buffer state
     // does not match the song's echo EDL/ESA register values.
     pub skip_echo_buffer_reset: bool,
+
+    // Skips the vibrato and portamento of the remaining channels if a tick is over budget.
+    //
+    // NOTE: Not modelled by `bytecode_interpreter`, the pitch of a channel will not match the
+    // interpreter after an over budget tick.
+    pub tick_budget: bool,
 }
 
 impl LoaderDataType {
@@ -201,6 +253,9 @@ impl LoaderDataType {
         if self.skip_echo_buffer_reset {
             o |= 1 << 3;
         }
+        if self.tick_budget {
+            o |= 1 << 2;
+        }
 
         o
     }
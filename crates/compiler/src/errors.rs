@@ -663,6 +663,8 @@ pub struct SongTooLargeError {
     pub common_data_size: usize,
     pub song_data_size: usize,
     pub echo_buffer_size: usize,
+    /// Name and size of the largest channels and subroutines (largest first)
+    pub largest_bytecode_blocks: Vec<(String, usize)>,
 }
 
 #[derive(Debug)]
@@ -2316,7 +2318,16 @@ impl Display for SongTooLargeErrorIndentedDisplay<'_> {
                 "\n  echo buffer: {:>22} bytes"
             ],
             e.too_large_by, e.common_data_size, e.song_data_size, e.echo_buffer_size
-        )
+        )?;
+
+        if !e.largest_bytecode_blocks.is_empty() {
+            write!(f, "\n  largest bytecode:")?;
+            for (name, size) in &e.largest_bytecode_blocks {
+                write!(f, "\n    {:<20} {:>6} bytes", name, size)?;
+            }
+        }
+
+        Ok(())
     }
 }
 
@@ -14,11 +14,13 @@ pub use self::tass64::{Tass64Exporter, Tass64MemoryMap};
 
 use crate::audio_driver;
 use crate::common_audio_data::CommonAudioData;
+use crate::compression::compress;
 use crate::data::UniqueNamesProjectFile;
 use crate::driver_constants::MAX_N_SONGS;
 use crate::errors::{ExportError, ExportSegmentType};
 use crate::songs::SongData;
 
+use std::borrow::Cow;
 use std::ops::Range;
 use std::path::Path;
 
@@ -60,6 +62,8 @@ impl MemoryMapMode {
 pub struct ExportedBinFile {
     data: Vec<u8>,
     n_songs: usize,
+    compressed: bool,
+    data_sizes: Vec<u16>,
 }
 
 impl ExportedBinFile {
@@ -77,6 +81,8 @@ impl ExportedBinFile {
         "[u24 ; N_DATA_ITEMS] - table of PRG ROM offsets (from the start of the first Audio Data segment)";
     pub const DATA_TABLE_FOOTER_DOCSTRING: &'static str =
         "u16 footer - 16 bit clipped `bin_data_offset + bin_file.len()` (used to determine the size of the last item)";
+    pub const DATA_SIZES_DOCSTRING: &'static str =
+        "Number of bytes the loader transfers for each data item (0 = common audio data, 1.. = song_id)";
 
     pub fn data(&self) -> &[u8] {
         &self.data
@@ -86,6 +92,21 @@ impl ExportedBinFile {
         self.n_songs
     }
 
+    /// True if the common audio data and songs are compressed.
+    ///
+    /// The loader, audio driver and blank song are never compressed.
+    pub fn compressed(&self) -> bool {
+        self.compressed
+    }
+
+    /// Size of the common audio data followed by the size of each song.
+    ///
+    /// This is the number of bytes the loader transfers when the data is loaded, which (with the
+    /// transfer size) can be used to estimate the load time before the load starts.
+    pub fn data_sizes(&self) -> &[u16] {
+        &self.data_sizes
+    }
+
     pub fn data_table_size(&self) -> usize {
         (self.n_songs + 1) * Self::DATA_TABLE_ELEMENT_SIZE + Self::DATA_TABLE_FOOTER_SIZE
     }
@@ -95,6 +116,7 @@ fn export_bin_file(
     common_audio_data: &CommonAudioData,
     songs: &[SongData],
     bin_data_offset: usize,
+    compressed: bool,
 ) -> Result<ExportedBinFile, ExportError> {
     if songs.len() > MAX_N_SONGS {
         return Err(ExportError::TooManySongs(songs.len()));
@@ -102,10 +124,17 @@ fn export_bin_file(
 
     let data_table_size = 3 * (1 + songs.len()) + 2;
 
+    let audio_data: Vec<Cow<[u8]>> = std::iter::once(common_audio_data.data())
+        .chain(songs.iter().map(|s| s.data()))
+        .map(|d| match compressed {
+            true => compress(d).into(),
+            false => d.into(),
+        })
+        .collect();
+
     let bin_file_size = ExportedBinFile::DATA_TABLE_OFFSET
         + data_table_size
-        + common_audio_data.data().len()
-        + songs.iter().map(|s| s.data().len()).sum::<usize>();
+        + audio_data.iter().map(|d| d.len()).sum::<usize>();
 
     if bin_file_size > MAX_BIN_FILE {
         return Err(ExportError::BinFileTooLarge(bin_file_size));
@@ -127,8 +156,10 @@ fn export_bin_file(
     bin_file.resize(data_table_range.end, 0);
 
     let mut data_table: Vec<u8> = Vec::with_capacity(data_table_size);
+    let mut data_sizes: Vec<u16> = Vec::with_capacity(audio_data.len());
     let mut add_data = |d: &[u8]| {
         assert!(d.len() < u16::MAX.into());
+        data_sizes.push(d.len().try_into().unwrap());
 
         let offset_le_bytes = u32::try_from(bin_data_offset + bin_file.len())
             .unwrap()
@@ -140,9 +171,8 @@ fn export_bin_file(
     };
 
     // Populate with data
-    add_data(common_audio_data.data());
-    for s in songs {
-        add_data(s.data());
+    for d in &audio_data {
+        add_data(d);
     }
 
     // Add data table footer (16 bit clipped value end of binary file)
@@ -158,6 +188,8 @@ fn export_bin_file(
     let out = ExportedBinFile {
         data: bin_file,
         n_songs: songs.len(),
+        compressed,
+        data_sizes,
     };
     assert!(out.data.len() == bin_file_size);
     assert!(out.data_table_size() == data_table_size);
@@ -192,7 +224,7 @@ pub fn bin_include_path(
 pub trait Exporter {
     type MemoryMap;
 
-    fn generate_include_file(pf: UniqueNamesProjectFile) -> Result<String, std::fmt::Error>;
+    fn generate_include_file(pf: &UniqueNamesProjectFile) -> Result<String, std::fmt::Error>;
 
     fn generate_asm_file(
         bin_data: &ExportedBinFile,
@@ -206,8 +238,14 @@ pub trait Exporter {
         common_audio_data: &CommonAudioData,
         songs: &[SongData],
         memory_map: &Self::MemoryMap,
+        compressed: bool,
     ) -> Result<ExportedBinFile, ExportError> {
-        export_bin_file(common_audio_data, songs, Self::bin_data_offset(memory_map))
+        export_bin_file(
+            common_audio_data,
+            songs,
+            Self::bin_data_offset(memory_map),
+            compressed,
+        )
     }
 }
 
@@ -51,7 +51,7 @@ impl Exporter for Ca65Exporter {
         }
     }
 
-    fn generate_include_file(pf: UniqueNamesProjectFile) -> Result<String, std::fmt::Error> {
+    fn generate_include_file(pf: &UniqueNamesProjectFile) -> Result<String, std::fmt::Error> {
         let sfx = &pf.sfx_export_order;
 
         let mut out = String::with_capacity(4096);
@@ -150,6 +150,18 @@ impl Exporter for Ca65Exporter {
         writeln!(out, "AUDIO_DATA_BANK = .bankbyte({FIRST_BLOCK})")?;
         writeln!(out)?;
 
+        writeln!(out, ";; {}", ExportedBinFile::DATA_SIZES_DOCSTRING)?;
+        for (i, size) in bin_data.data_sizes().iter().enumerate() {
+            writeln!(out, ";;   {i:3}: {size}")?;
+        }
+        writeln!(out)?;
+
+        if bin_data.compressed() {
+            writeln!(out, ";; The common audio data and songs are compressed.")?;
+            writeln!(out, ";; `Tad_UseCompressedAudioData` MUST be called after `Tad_Init`.")?;
+            writeln!(out)?;
+        }
+
         // Add an assert to ensure TAD_IO_VERSION in the audio driver matches the one is `tad-audio.s`
         writeln!(out, ".import TAD_IO_VERSION")?;
         writeln!(out, ".assert TAD_IO_VERSION = {}, lderror, \"TAD_IO_VERSION in audio driver does not match TAD_IO_VERSION in tad-audio.s\"", TAD_IO_VERSION)?;
@@ -41,7 +41,7 @@ impl Exporter for PvExporter {
         0
     }
 
-    fn generate_include_file(pf: UniqueNamesProjectFile) -> Result<String, std::fmt::Error> {
+    fn generate_include_file(pf: &UniqueNamesProjectFile) -> Result<String, std::fmt::Error> {
         let sfx = &pf.sfx_export_order;
 
         let mut out = String::with_capacity(4096);
@@ -139,6 +139,18 @@ impl Exporter for PvExporter {
         writeln!(out, "N_DATA_ITEMS = {}", n_data_items)?;
         writeln!(out)?;
 
+        writeln!(out, ";; {}", ExportedBinFile::DATA_SIZES_DOCSTRING)?;
+        for (i, size) in bin_data.data_sizes().iter().enumerate() {
+            writeln!(out, ";;   {i:3}: {size}")?;
+        }
+        writeln!(out)?;
+
+        if bin_data.compressed() {
+            writeln!(out, ";; The common audio data and songs are compressed.")?;
+            writeln!(out, ";; `tad_useCompressedAudioData()` MUST be called after `tad_init()`.")?;
+            writeln!(out)?;
+        }
+
         // I cannot export the first byte as a single block and `.export` custom `Tad_AudioData__0 + n` constants.
         // For some unknown reason the bank byte is missing.
         {
@@ -51,7 +51,7 @@ impl Exporter for Tass64Exporter {
         }
     }
 
-    fn generate_include_file(pf: UniqueNamesProjectFile) -> Result<String, std::fmt::Error> {
+    fn generate_include_file(pf: &UniqueNamesProjectFile) -> Result<String, std::fmt::Error> {
         let sfx = &pf.sfx_export_order;
 
         let mut out = String::with_capacity(4096);
@@ -203,6 +203,18 @@ impl Exporter for Tass64Exporter {
         writeln!(out, "AUDIO_DATA_BANK = `{FIRST_BLOCK}")?;
         writeln!(out)?;
 
+        writeln!(out, ";; {}", ExportedBinFile::DATA_SIZES_DOCSTRING)?;
+        for (i, size) in bin_data.data_sizes().iter().enumerate() {
+            writeln!(out, ";;   {i:3}: {size}")?;
+        }
+        writeln!(out)?;
+
+        if bin_data.compressed() {
+            writeln!(out, ";; The common audio data and songs are compressed.")?;
+            writeln!(out, ";; `Tad_UseCompressedAudioData` MUST be called after `Tad_Init`.")?;
+            writeln!(out)?;
+        }
+
         writeln!(out, ".cerror (Tad_DataTable >> 16) != ((Tad_DataTable + Tad_DataTable_SIZE) >> 16), \"Tad_DataTable does not fit in a single bank\"")?;
         writeln!(out)?;
 
@@ -7,22 +7,27 @@
 #![forbid(unsafe_code)]
 
 mod bytecode;
+mod bytecode_cycles;
 mod channel_bc_generator;
 mod file_pos;
 mod value_newtypes;
 
+pub mod audible_end;
 pub mod bytecode_assembler;
 pub mod bytecode_interpreter;
 pub mod common_audio_data;
+pub mod compression;
 pub mod data;
 pub mod driver_constants;
 pub mod echo;
 pub mod envelope;
 pub mod errors;
 pub mod export;
+pub mod fnv1a;
 pub mod invert_flags;
 pub mod mml;
 pub mod notes;
+pub mod parallel;
 pub mod path;
 pub mod pitch_table;
 pub mod samples;
@@ -30,7 +35,9 @@ pub mod sfx_file;
 pub mod songs;
 pub mod sound_effects;
 pub mod spc_file_export;
+pub mod subroutine_candidates;
 pub mod subroutines;
+pub mod tick_cost;
 pub mod time;
 
 pub use bytecode::opcodes;
@@ -28,6 +28,7 @@ use self::metadata::parse_headers;
 use bc_generator::parse_and_compile_mml_prefix;
 pub(crate) use identifier::{IdentifierBuf, IdentifierStr};
 use line_splitter::split_mml_sfx_subroutines_header_lines;
+pub(crate) use song_duration::sorted_tempo_changes;
 use tokenizer::MmlTokens;
 
 use crate::data::{self, TextFile, UniqueNamesList};
@@ -147,6 +147,9 @@ pub(super) fn split_mml_song_lines(
 
     let mut subroutine_name_map: HashMap<IdentifierStr, usize> = HashMap::new();
 
+    // Reused for every multi-channel line to prevent an allocation per line
+    let mut multi_channel_tokens = MmlTokens::new();
+
     let mut line_splitter = split_lines(mml_text);
 
     while let Some(entire_line) = line_splitter.next() {
@@ -224,7 +227,8 @@ pub(super) fn split_mml_song_lines(
                                 &mut line_splitter,
                             );
                         } else {
-                            let tokens = MmlTokens::new_with_line(
+                            multi_channel_tokens.clear();
+                            multi_channel_tokens.parse_line(
                                 line,
                                 entire_line.index_range(),
                                 &mut line_splitter,
@@ -238,7 +242,7 @@ pub(super) fn split_mml_song_lines(
                                 let index = usize::try_from(index).unwrap();
 
                                 if unused[index] {
-                                    channels[index].extend(&tokens);
+                                    channels[index].extend(&multi_channel_tokens);
                                     unused[index] = false;
                                 }
                             }
@@ -13,6 +13,21 @@ use crate::time::{TickClock, TickCounter, TIMER_HZ};
 
 use std::time::Duration;
 
+/// Returns the tempo changes of every channel, sorted by tick
+pub fn sorted_tempo_changes(
+    channels: &[Option<Channel>; N_MUSIC_CHANNELS],
+) -> Vec<(TickCounter, TickClock)> {
+    let mut tempo_changes: Vec<(TickCounter, TickClock)> = channels
+        .iter()
+        .filter_map(|c| c.as_ref())
+        .flat_map(|c| &c.tempo_changes)
+        .cloned()
+        .collect();
+    tempo_changes.sort_by_key(|(tc, _tempo)| tc.value());
+
+    tempo_changes
+}
+
 pub fn calc_song_duration(
     metadata: &MetaData,
     channels: &[Option<Channel>; N_MUSIC_CHANNELS],
@@ -31,13 +46,7 @@ pub fn calc_song_duration(
         .max()
         .unwrap_or(0);
 
-    let mut tempo_changes: Vec<(TickCounter, TickClock)> = channels
-        .iter()
-        .filter_map(|c| c.as_ref())
-        .flat_map(|c| &c.tempo_changes)
-        .cloned()
-        .collect();
-    tempo_changes.sort_by_key(|(tc, _tempo)| tc.value());
+    let tempo_changes = sorted_tempo_changes(channels);
 
     let mut out: u64 = 0;
     let mut prev_ticks = 0;
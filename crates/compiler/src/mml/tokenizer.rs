@@ -751,6 +751,12 @@ impl<'a> MmlTokens<'a> {
         self.end_pos = tokens.end_pos;
     }
 
+    /// Removes all tokens, keeping the allocated memory
+    pub fn clear(&mut self) {
+        self.tokens.clear();
+        self.end_pos = blank_pos();
+    }
+
     pub fn parse_line(
         &mut self,
         line: Line<'a>,
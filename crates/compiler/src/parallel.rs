@@ -0,0 +1,62 @@
+//! Parallel compilation helpers
+
+// SPDX-FileCopyrightText: © 2023 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+/// Calls `f` on every item in parallel, on up to `n_threads` threads.
+///
+/// The results are in the same order as `items`.
+pub fn parallel_map<T, R, F>(items: &[T], n_threads: usize, f: F) -> Vec<R>
+where
+    T: Sync,
+    R: Send,
+    F: Fn(&T) -> R + Sync,
+{
+    let n_threads = n_threads.min(items.len());
+
+    if n_threads <= 1 {
+        return items.iter().map(f).collect();
+    }
+
+    // Items are taken in order by the next idle thread (items vary in size)
+    let next_item = AtomicUsize::new(0);
+
+    let mut results: Vec<(usize, R)> = std::thread::scope(|scope| {
+        let threads: Vec<_> = (0..n_threads)
+            .map(|_| {
+                scope.spawn(|| {
+                    let mut out = Vec::new();
+                    loop {
+                        let i = next_item.fetch_add(1, Ordering::Relaxed);
+                        match items.get(i) {
+                            Some(item) => out.push((i, f(item))),
+                            None => return out,
+                        }
+                    }
+                })
+            })
+            .collect();
+
+        threads
+            .into_iter()
+            .flat_map(|t| match t.join() {
+                Ok(r) => r,
+                Err(e) => std::panic::resume_unwind(e),
+            })
+            .collect()
+    });
+
+    results.sort_by_key(|(i, _)| *i);
+
+    results.into_iter().map(|(_, r)| r).collect()
+}
+
+/// The number of threads to use when compiling in parallel
+pub fn available_threads() -> usize {
+    std::thread::available_parallelism()
+        .map(|n| n.get())
+        .unwrap_or(1)
+}
@@ -4,10 +4,12 @@
 //
 // SPDX-License-Identifier: MIT
 
+use crate::bytecode::InstrumentId;
 use crate::data::{
     BrrEvaluator, Instrument, InstrumentOrSample, LoopSetting, Sample, UniqueNamesProjectFile,
 };
 use crate::errors::{BrrError, SampleAndInstrumentDataError, SampleError, TaggedSampleError};
+use crate::fnv1a::Fnv1a;
 use crate::notes::{Note, Octave, LAST_NOTE_ID};
 use crate::path::{ParentPathBuf, SourcePathBuf};
 use crate::pitch_table::{
@@ -22,8 +24,10 @@ use brr::{
 
 use std::collections::HashMap;
 use std::fs;
-use std::io::Read;
+use std::io::{BufReader, Read};
 use std::ops::RangeInclusive;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicUsize, Ordering};
 use std::sync::Arc;
 
 const MAX_BRR_SAMPLE_LOAD: u64 = 16 * 1024;
@@ -33,6 +37,13 @@ const MAX_WAV_SAMPLES: usize =
 pub const WAV_EXTENSION: &str = "wav";
 pub const BRR_EXTENSION: &str = "brr";
 
+/// Environment variable containing the path of the on-disk BRR encode cache directory
+/// (the directory is created if it does not exist).
+pub const BRR_CACHE_DIR_ENV_VAR: &str = "TAD_BRR_CACHE_DIR";
+
+/// Incremented whenever the BRR encoder output changes
+const BRR_CACHE_VERSION: u64 = 1;
+
 fn read_file_limited(
     source: &SourcePathBuf,
     parent: &ParentPathBuf,
@@ -57,10 +68,19 @@ fn read_file_limited(
     Ok(buffer)
 }
 
+type EncodedWavFile = (LoopSetting, BrrEvaluator, Result<BrrSample, BrrError>);
+
 pub struct SampleFileCache {
     parent_path: ParentPathBuf,
     brr_files: HashMap<SourcePathBuf, Result<ValidBrrFile, BrrError>>,
     wav_files: HashMap<SourcePathBuf, Result<MonoPcm16WaveFile, BrrError>>,
+
+    // BRR encoding is slow, cache the encoded samples for every loop setting and evaluator
+    // (so editing an instrument or song does not re-encode its sample)
+    encoded_wav_files: HashMap<SourcePathBuf, Vec<EncodedWavFile>>,
+
+    // On-disk BRR encode cache (shared between runs, the compiler and the GUI)
+    brr_cache_dir: Option<PathBuf>,
 }
 
 impl SampleFileCache {
@@ -69,17 +89,113 @@ impl SampleFileCache {
             parent_path,
             brr_files: HashMap::new(),
             wav_files: HashMap::new(),
+            encoded_wav_files: HashMap::new(),
+            brr_cache_dir: std::env::var_os(BRR_CACHE_DIR_ENV_VAR)
+                .filter(|d| !d.is_empty())
+                .map(PathBuf::from),
         }
     }
 
     pub fn clear_cache(&mut self) {
         self.brr_files.clear();
         self.wav_files.clear();
+        self.encoded_wav_files.clear();
     }
 
     pub fn remove_path(&mut self, source: &SourcePathBuf) {
         self.brr_files.remove(source);
         self.wav_files.remove(source);
+        self.encoded_wav_files.remove(source);
+    }
+
+    /// Encodes the uncached `.wav` samples on all available cores.
+    ///
+    /// The encoded samples are stored in the cache, `load_sample_for_instrument()` and
+    /// `load_sample_for_sample()` will not encode them again.
+    pub fn encode_wav_files_in_parallel<'a>(
+        &mut self,
+        samples: impl Iterator<Item = (&'a SourcePathBuf, &'a LoopSetting, BrrEvaluator)>,
+    ) {
+        let mut to_encode: Vec<(&SourcePathBuf, &LoopSetting, BrrEvaluator)> = Vec::new();
+
+        for (source, loop_setting, evaluator) in samples {
+            if source.extension() != Some(WAV_EXTENSION) {
+                continue;
+            }
+            let cached = self.encoded_wav_files.get(source).is_some_and(|v| {
+                v.iter()
+                    .any(|(ls, e, _)| ls == loop_setting && *e == evaluator)
+            });
+            let duplicate = to_encode
+                .iter()
+                .any(|(s, ls, e)| *s == source && *ls == loop_setting && *e == evaluator);
+
+            if !cached && !duplicate {
+                // Loads the wav file (sequentially)
+                let _ = self.load_wav_file(source);
+                to_encode.push((source, loop_setting, evaluator));
+            }
+        }
+
+        let n_threads = std::thread::available_parallelism()
+            .map(|n| n.get())
+            .unwrap_or(1)
+            .min(to_encode.len());
+
+        if n_threads <= 1 {
+            // Encoded by `load_sample_for_instrument()` and `load_sample_for_sample()`
+            return;
+        }
+
+        let wav_files = &self.wav_files;
+        let brr_cache_dir = self.brr_cache_dir.as_deref();
+
+        // Samples are taken in order by the next idle thread (samples vary in length)
+        let next = AtomicUsize::new(0);
+
+        let encoded: Vec<(usize, Result<BrrSample, BrrError>)> = std::thread::scope(|scope| {
+            let threads: Vec<_> = (0..n_threads)
+                .map(|_| {
+                    scope.spawn(|| {
+                        let mut out = Vec::new();
+                        loop {
+                            let i = next.fetch_add(1, Ordering::Relaxed);
+                            let Some((source, loop_setting, evaluator)) = to_encode.get(i) else {
+                                return out;
+                            };
+                            if let Some(Ok(wav)) = wav_files.get(*source) {
+                                out.push((
+                                    i,
+                                    encode_wav_samples(
+                                        source,
+                                        wav,
+                                        loop_setting,
+                                        *evaluator,
+                                        brr_cache_dir,
+                                    ),
+                                ));
+                            }
+                        }
+                    })
+                })
+                .collect();
+
+            threads
+                .into_iter()
+                .flat_map(|t| match t.join() {
+                    Ok(r) => r,
+                    Err(e) => std::panic::resume_unwind(e),
+                })
+                .collect()
+        });
+
+        for (i, b) in encoded {
+            let (source, loop_setting, evaluator) = to_encode[i];
+            self.encoded_wav_files
+                .entry(source.to_owned())
+                .or_default()
+                .push((loop_setting.clone(), evaluator, b));
+        }
     }
 
     fn load_brr_file(&mut self, source: &SourcePathBuf) -> &Result<ValidBrrFile, BrrError> {
@@ -101,13 +217,15 @@ impl SampleFileCache {
         self.wav_files.entry(source.to_owned()).or_insert_with(|| {
             let p = &source.to_path(&self.parent_path);
             match fs::File::open(p) {
-                Ok(mut file) => match read_mono_pcm_wave_file(&mut file, MAX_WAV_SAMPLES) {
-                    Ok(w) => Ok(w),
-                    Err(e) => Err(BrrError::WaveFileError(Arc::from((
-                        source.to_path_string(),
-                        e,
-                    )))),
-                },
+                Ok(file) => {
+                    match read_mono_pcm_wave_file(&mut BufReader::new(file), MAX_WAV_SAMPLES) {
+                        Ok(w) => Ok(w),
+                        Err(e) => Err(BrrError::WaveFileError(Arc::from((
+                            source.to_path_string(),
+                            e,
+                        )))),
+                    }
+                }
                 Err(e) => Err(BrrError::IoError(Arc::from((source.to_path_string(), e)))),
             }
         })
@@ -120,11 +238,97 @@ fn encode_wave_file(
     loop_setting: &LoopSetting,
     evaluator: BrrEvaluator,
 ) -> Result<BrrSample, BrrError> {
-    let wav = match cache.load_wav_file(source) {
-        Ok(w) => w,
-        Err(e) => return Err(e.clone()),
-    };
+    if let Some(encoded) = cache.encoded_wav_files.get(source) {
+        if let Some((_, _, b)) = encoded
+            .iter()
+            .find(|(ls, e, _)| ls == loop_setting && *e == evaluator)
+        {
+            return b.clone();
+        }
+    }
 
+    let b = encode_wave_file_uncached(source, cache, loop_setting, evaluator);
+
+    cache
+        .encoded_wav_files
+        .entry(source.to_owned())
+        .or_default()
+        .push((loop_setting.clone(), evaluator, b.clone()));
+
+    b
+}
+
+/// Returns the file name of the sample in the on-disk BRR encode cache
+fn brr_cache_file_name(
+    samples: &[i16],
+    loop_setting: &LoopSetting,
+    evaluator: BrrEvaluator,
+) -> Option<String> {
+    let options = serde_json::to_string(&(loop_setting, evaluator)).ok()?;
+
+    let mut h = Fnv1a::new();
+    h.write(&BRR_CACHE_VERSION.to_le_bytes());
+    h.write(&(samples.len() as u64).to_le_bytes());
+    for s in samples {
+        h.write(&s.to_le_bytes());
+    }
+    h.write(options.as_bytes());
+
+    Some(format!(
+        "{:016x}-{}.{}",
+        h.finish(),
+        samples.len(),
+        BRR_EXTENSION
+    ))
+}
+
+fn read_brr_cache_file(path: &Path) -> Option<BrrSample> {
+    let data = fs::read(path).ok()?;
+    parse_brr_file(&data).ok()?.into_brr_sample(None).ok()
+}
+
+// Errors are ignored, the cache is optional
+fn write_brr_cache_file(dir: &Path, file_name: &str, brr: &BrrSample) {
+    if fs::create_dir_all(dir).is_err() {
+        return;
+    }
+
+    // Write to a temporary file so another process never reads a partially written file
+    let tmp_path = dir.join(format!("{}.{}.tmp", file_name, std::process::id()));
+    if fs::write(&tmp_path, brr.brr_with_loop_header()).is_ok()
+        && fs::rename(&tmp_path, dir.join(file_name)).is_err()
+    {
+        let _ = fs::remove_file(&tmp_path);
+    }
+}
+
+fn encode_wave_file_uncached(
+    source: &SourcePathBuf,
+    cache: &mut SampleFileCache,
+    loop_setting: &LoopSetting,
+    evaluator: BrrEvaluator,
+) -> Result<BrrSample, BrrError> {
+    let brr_cache_dir = cache.brr_cache_dir.clone();
+
+    match cache.load_wav_file(source) {
+        Ok(wav) => encode_wav_samples(
+            source,
+            wav,
+            loop_setting,
+            evaluator,
+            brr_cache_dir.as_deref(),
+        ),
+        Err(e) => Err(e.clone()),
+    }
+}
+
+fn encode_wav_samples(
+    source: &SourcePathBuf,
+    wav: &MonoPcm16WaveFile,
+    loop_setting: &LoopSetting,
+    evaluator: BrrEvaluator,
+    brr_cache_dir: Option<&Path>,
+) -> Result<BrrSample, BrrError> {
     let (loop_point, dupe_block_hack, loop_filter) = match loop_setting {
         LoopSetting::None => (None, None, None),
         LoopSetting::OverrideBrrLoopPoint(_) => {
@@ -141,6 +345,18 @@ fn encode_wave_file(
         LoopSetting::DupeBlockHackFilter3(dbh) => (None, Some(*dbh), Some(BrrFilter::Filter3)),
     };
 
+    let disk_cache = match brr_cache_dir {
+        Some(dir) => brr_cache_file_name(&wav.samples, loop_setting, evaluator)
+            .map(|file_name| (dir, file_name)),
+        None => None,
+    };
+
+    if let Some((dir, file_name)) = &disk_cache {
+        if let Some(b) = read_brr_cache_file(&dir.join(file_name)) {
+            return Ok(b);
+        }
+    }
+
     match encode_brr(
         &wav.samples,
         evaluator.to_evaluator(),
@@ -148,7 +364,12 @@ fn encode_wave_file(
         dupe_block_hack,
         loop_filter,
     ) {
-        Ok(b) => Ok(b),
+        Ok(b) => {
+            if let Some((dir, file_name)) = &disk_cache {
+                write_brr_cache_file(dir, file_name, &b);
+            }
+            Ok(b)
+        }
         Err(e) => Err(BrrError::BrrEncodeError(source.to_path_string(), e)),
     }
 }
@@ -202,6 +423,18 @@ impl<PitchT> SampleData<PitchT> {
     pub fn sample_size(&self) -> usize {
         self.brr_sample.brr_data().len()
     }
+
+    pub fn brr_sample(&self) -> &BrrSample {
+        &self.brr_sample
+    }
+
+    pub fn adsr1(&self) -> u8 {
+        self.adsr1
+    }
+
+    pub fn adsr2_or_gain(&self) -> u8 {
+        self.adsr2_or_gain
+    }
 }
 
 pub type InstrumentSampleData = SampleData<InstrumentPitch>;
@@ -302,6 +535,21 @@ fn compile_samples(
 
     let mut cache = SampleFileCache::new(project.parent_path.clone());
 
+    cache.encode_wav_files_in_parallel(
+        project
+            .instruments
+            .list()
+            .iter()
+            .map(|i| (&i.source, &i.loop_setting, i.evaluator))
+            .chain(
+                project
+                    .samples
+                    .list()
+                    .iter()
+                    .map(|s| (&s.source, &s.loop_setting, s.evaluator)),
+            ),
+    );
+
     let mut instruments = Vec::new();
     for (i, inst) in project.instruments.list().iter().enumerate() {
         match load_sample_for_instrument(inst, &mut cache) {
@@ -338,48 +586,89 @@ struct BrrDirectory {
     instruments_scrn: Vec<u8>,
 }
 
+/// Returns the index of the BRR sample whose data ends with `samples[index]`'s data.
+///
+/// BRR data cannot share a prefix (the last block of a sample has the end flag set), but a
+/// sample can start in the middle of a longer sample if the two samples end with the same blocks.
+///
+/// Returns the longest sample (lowest index if the data is identical) so the returned sample
+/// is never stored inside another sample.
+fn brr_data_parent(samples: &[&BrrSample], index: usize) -> Option<usize> {
+    let data = samples[index].brr_data();
+
+    samples
+        .iter()
+        .enumerate()
+        .filter(|(i, s)| {
+            let d = s.brr_data();
+            *i != index
+                && d.ends_with(data)
+                && (d.len() > data.len() || (d.len() == data.len() && *i < index))
+        })
+        .max_by_key(|(i, s)| (s.brr_data().len(), std::cmp::Reverse(*i)))
+        .map(|(i, _)| i)
+}
+
 // NOTE: Does not check the size of the directory.
 fn build_brr_directroy(
     instruments: &(impl CompiledDataList<Item = InstrumentSampleData> + ?Sized),
     samples: &(impl CompiledDataList<Item = SampleSampleData> + ?Sized),
 ) -> BrrDirectory {
-    let mut brr_data = Vec::new();
-    let mut brr_directory_offsets = Vec::new();
     let mut instruments_scrn =
         Vec::with_capacity(instruments.expected_len() + samples.expected_len());
 
+    // Identical samples share a directory item
     let mut sample_map: HashMap<&BrrSample, u8> = HashMap::new();
+    let mut dir_samples: Vec<&BrrSample> = Vec::new();
 
     let instruments = instruments.data_iter().map(|s| &s.brr_sample);
     let samples = samples.data_iter().map(|s| &s.brr_sample);
 
     for brr in instruments.chain(samples) {
-        let scrn = match sample_map.get(&brr) {
-            Some(o) => *o,
+        let scrn = *sample_map.entry(brr).or_insert_with(|| {
+            let scrn = u8::try_from(dir_samples.len() & 0xff).unwrap();
+            dir_samples.push(brr);
+            scrn
+        });
 
-            None => {
-                let start = brr_data.len();
-                let loop_point = start + usize::from(brr.loop_offset().unwrap_or(0));
+        instruments_scrn.push(scrn);
+    }
 
-                // Size checking preformed in `build_sample_and_instrument_data()`.
-                let dir_item = BrrDirectoryOffset {
-                    start: u16::try_from(start & 0xffff).unwrap(),
-                    loop_point: u16::try_from(loop_point & 0xffff).unwrap(),
-                };
+    // Samples with the same data (ie, the same BRR data with a different loop point) or that
+    // end with another sample's data are stored in the other sample
+    let parents: Vec<Option<usize>> = (0..dir_samples.len())
+        .map(|i| brr_data_parent(&dir_samples, i))
+        .collect();
 
-                let scrn = u8::try_from(brr_directory_offsets.len() & 0xff).unwrap();
+    let mut brr_data = Vec::new();
+    let mut starts = vec![0; dir_samples.len()];
 
-                brr_directory_offsets.push(dir_item);
-                brr_data.extend(brr.brr_data());
+    for (i, brr) in dir_samples.iter().enumerate() {
+        if parents[i].is_none() {
+            starts[i] = brr_data.len();
+            brr_data.extend(brr.brr_data());
+        }
+    }
+    for (i, brr) in dir_samples.iter().enumerate() {
+        if let Some(p) = parents[i] {
+            let parent = dir_samples[p].brr_data();
+            starts[i] = starts[p] + parent.len() - brr.brr_data().len();
+        }
+    }
 
-                sample_map.insert(brr, scrn);
+    let brr_directory_offsets = dir_samples
+        .iter()
+        .zip(starts)
+        .map(|(brr, start)| {
+            let loop_point = start + usize::from(brr.loop_offset().unwrap_or(0));
 
-                scrn
+            // Size checking preformed in `build_sample_and_instrument_data()`.
+            BrrDirectoryOffset {
+                start: u16::try_from(start & 0xffff).unwrap(),
+                loop_point: u16::try_from(loop_point & 0xffff).unwrap(),
             }
-        };
-
-        instruments_scrn.push(scrn);
-    }
+        })
+        .collect();
 
     BrrDirectory {
         brr_data,
@@ -430,6 +719,24 @@ pub fn create_test_instrument_data(
     Some((data, max_octave))
 }
 
+/// Returns the S-DSP pitch of every note the sample can play without the first/last octave
+/// limits (indexed by note id).
+pub fn test_instrument_pitches(sample: &InstrumentSampleData) -> Option<Vec<u16>> {
+    let (data, max_octave) = create_test_instrument_data(sample)?;
+    let inst = InstrumentId::try_from(0_u8).ok()?;
+
+    let last_note = Note::last_note_for_octave(max_octave).note_id();
+
+    let pitches = (0..=last_note)
+        .map(|n| {
+            let note = Note::from_note_id_usize(n.into()).unwrap();
+            data.pitch_table().pitch_for_note(inst, note)
+        })
+        .collect();
+
+    Some(pitches)
+}
+
 /// Panics if instrument/samples `data_iter().count()` != `expected_len()`.
 pub fn combine_samples(
     instruments: &(impl CompiledDataList<Item = InstrumentSampleData> + ?Sized),
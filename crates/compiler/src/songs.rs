@@ -178,6 +178,98 @@ impl SongData {
     }
 }
 
+/// The first difference between two compiles of a song (see `song_diff()`)
+#[cfg(feature = "mml_tracking")]
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub struct SongDiff {
+    /// Offset of the first song data byte that differs
+    pub offset: usize,
+    /// The earliest tick that could read a changed byte.
+    /// The audio driver processes the ticks before `tick` identically with both songs.
+    pub tick: TickCounter,
+}
+
+/// Compares two compiles of a song.
+///
+/// Returns `None` if the song data is identical.
+///
+/// The returned tick is 0 if the song header or a subroutine changed, a channel's bytecode moved
+/// or either song has no bytecode tracking data.
+/// Changes that do not move a channel (ie, changing notes) or changes to the last channel are
+/// mapped to the tick of the first changed instruction.
+#[cfg(feature = "mml_tracking")]
+pub fn song_diff(old: &SongData, new: &SongData) -> Option<SongDiff> {
+    let (old_data, new_data) = (old.data(), new.data());
+    if old_data == new_data {
+        return None;
+    }
+
+    let offset = old_data
+        .iter()
+        .zip(new_data)
+        .position(|(a, b)| a != b)
+        .unwrap_or(min(old_data.len(), new_data.len()));
+
+    let from_start = SongDiff {
+        offset,
+        tick: TickCounter::new(0),
+    };
+
+    let (Some(tracking), Some(_)) = (old.tracking(), new.tracking()) else {
+        return Some(from_start);
+    };
+
+    // The header and channel offsets are unchanged if the first change is in a channel
+    if offset < usize::from(tracking.first_channel_bc_offset) {
+        return Some(from_start);
+    }
+
+    let mut starts: Vec<usize> = old
+        .channels()
+        .iter()
+        .flatten()
+        .map(|c| usize::from(c.bytecode_offset))
+        .collect();
+    starts.sort_unstable();
+
+    let mut tick = TickCounter::MAX;
+
+    for (i, &start) in starts.iter().enumerate() {
+        let old_end = starts.get(i + 1).copied().unwrap_or(old_data.len());
+        let new_end = starts.get(i + 1).copied().unwrap_or(new_data.len());
+
+        let (Some(o), Some(n)) = (old_data.get(start..old_end), new_data.get(start..new_end))
+        else {
+            return Some(from_start);
+        };
+        if o == n {
+            continue;
+        }
+        let changed = start
+            + o.iter()
+                .zip(n)
+                .position(|(a, b)| a != b)
+                .unwrap_or(min(o.len(), n.len()));
+
+        // The instruction containing the changed byte
+        let bc = &tracking.bytecode;
+        let inst = bc.partition_point(|b| usize::from(b.bc_end_pos) <= changed);
+        let cursor = bc
+            .get(inst)
+            .and_then(|b| tracking.cursor_tracker.find(b.char_index));
+
+        match cursor {
+            Some((_, c)) => tick = min(tick, c.ticks.ticks),
+            None => return Some(from_start),
+        }
+    }
+
+    if tick == TickCounter::MAX {
+        return Some(from_start);
+    }
+    Some(SongDiff { offset, tick })
+}
+
 pub fn song_header_size(n_subroutines: usize) -> usize {
     SONG_HEADER_SIZE + n_subroutines * 2
 }
@@ -422,6 +514,53 @@ pub fn song_duration_string(duration: Option<Duration>) -> String {
     }
 }
 
+/// Maximum number of bytecode blocks listed in a `SongTooLargeError`
+const MAX_LARGEST_BYTECODE_BLOCKS: usize = 5;
+
+/// Returns the name and size of the song's largest channels and subroutines (largest first).
+///
+/// Channel and subroutine bytecode is stored contiguously in the song data, the size of a block
+/// is the distance to the next block.
+fn largest_bytecode_blocks(song: &SongData, n_blocks: usize) -> Vec<(String, usize)> {
+    let mut blocks: Vec<(String, usize)> = song
+        .channels()
+        .iter()
+        .flatten()
+        .map(|c| {
+            (
+                format!("channel {}", c.name),
+                usize::from(c.bytecode_offset),
+            )
+        })
+        .chain(song.subroutines().iter().map(|s| {
+            (
+                format!("!{}", s.identifier.as_str()),
+                usize::from(s.bytecode_offset),
+            )
+        }))
+        .filter(|(_, o)| *o < song.data().len())
+        .collect();
+
+    blocks.sort_by_key(|(_, o)| *o);
+
+    let ends: Vec<usize> = blocks
+        .iter()
+        .skip(1)
+        .map(|(_, o)| *o)
+        .chain(std::iter::once(song.data().len()))
+        .collect();
+
+    let mut sizes: Vec<(String, usize)> = blocks
+        .into_iter()
+        .zip(ends)
+        .map(|((name, start), end)| (name, end - start))
+        .collect();
+
+    sizes.sort_by(|a, b| b.1.cmp(&a.1));
+    sizes.truncate(n_blocks);
+    sizes
+}
+
 pub fn validate_song_size(
     song: &SongData,
     common_data_size: usize,
@@ -446,6 +585,7 @@ pub fn validate_song_size(
             common_data_size,
             song_data_size,
             echo_buffer_size,
+            largest_bytecode_blocks: largest_bytecode_blocks(song, MAX_LARGEST_BYTECODE_BLOCKS),
         })
     }
 }
@@ -19,6 +19,7 @@ use crate::errors::{
 };
 use crate::file_pos::{blank_file_range, split_lines};
 use crate::mml;
+use crate::parallel::{available_threads, parallel_map};
 use crate::pitch_table::PitchTable;
 use crate::sfx_file::SoundEffectsFile;
 use crate::subroutines::{FindSubroutineResult, Subroutine, SubroutineStore};
@@ -286,11 +287,29 @@ pub fn compile_sound_effects_file(
         }
     };
 
+    // Sound effects are independent of each other and are compiled in parallel
+    let compiled = parallel_map(
+        &sfx_file.sound_effects,
+        available_threads(),
+        |sfx| match &sfx.sfx {
+            SoundEffectText::BytecodeAssembly(text) => {
+                compile_bytecode_sound_effect(text, inst_map, &subroutines, sfx.flags.clone())
+            }
+            SoundEffectText::Mml(text) => compile_mml_sound_effect(
+                text,
+                inst_map,
+                pitch_table,
+                &subroutines,
+                sfx.flags.clone(),
+            ),
+        },
+    );
+
     let mut sound_effects = HashMap::with_capacity(sfx_file.sound_effects.len());
 
     let mut errors = Vec::new();
 
-    for sfx in &sfx_file.sound_effects {
+    for (sfx, r) in sfx_file.sound_effects.iter().zip(compiled) {
         let mut other_errors = Vec::new();
 
         let name = match sfx.name.parse::<Name>() {
@@ -306,18 +325,6 @@ pub fn compile_sound_effects_file(
             }
         };
 
-        let r = match &sfx.sfx {
-            SoundEffectText::BytecodeAssembly(text) => {
-                compile_bytecode_sound_effect(text, inst_map, &subroutines, sfx.flags.clone())
-            }
-            SoundEffectText::Mml(text) => compile_mml_sound_effect(
-                text,
-                inst_map,
-                pitch_table,
-                &subroutines,
-                sfx.flags.clone(),
-            ),
-        };
         match r {
             Ok(s) => {
                 sound_effects.insert(name, s);
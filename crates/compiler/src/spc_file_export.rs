@@ -15,6 +15,9 @@ use crate::songs::SongData;
 
 const SPC_FILE_SIZE: usize = 0x10200;
 
+const ID666_SONG_LENGTH_ADDR: usize = 0xa9;
+const ID666_SONG_LENGTH_SIZE: usize = 3;
+
 const AUDIO_RAM_SIZE: usize = 1 << 16;
 
 pub const MAX_SONG_LENGTH: u32 = 999;
@@ -135,7 +138,12 @@ pub fn export_spc_file(
 
         // Song length in seconds
         let song_length = song_length(song_duration, metadata);
-        write_id666_number_safe(header, 0xa9, 3, song_length);
+        write_id666_number_safe(
+            header,
+            ID666_SONG_LENGTH_ADDR,
+            ID666_SONG_LENGTH_SIZE,
+            song_length,
+        );
 
         // Fadeout length in milliseconds
         let fadeout_length = metadata
@@ -167,6 +175,7 @@ pub fn export_spc_file(
             stereo_flag: true,
             play_song: true,
             skip_echo_buffer_reset: true,
+            tick_budget: false,
         }
         .driver_value();
 
@@ -188,3 +197,12 @@ pub fn export_spc_file(
 
     Ok(out)
 }
+
+/// Replaces the song length ID666 tag of a .spc file created by `export_spc_file()`.
+///
+/// Writes 0 if `seconds` is greater than `MAX_SONG_LENGTH`.
+pub fn set_spc_song_length(spc: &mut [u8], seconds: u64) {
+    assert!(spc.len() == SPC_FILE_SIZE);
+
+    write_id666_number_safe(spc, ID666_SONG_LENGTH_ADDR, ID666_SONG_LENGTH_SIZE, seconds);
+}
@@ -0,0 +1,389 @@
+//! Repeated bytecode sequence detection
+//!
+//! Finds instruction sequences that are repeated in a song's bytecode and estimates how many
+//! bytes would be saved if each sequence was moved into a subroutine.
+
+// SPDX-FileCopyrightText: © 2025 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+use crate::bytecode::opcodes;
+use crate::driver_constants::MAX_SUBROUTINES;
+use crate::songs::SongData;
+use crate::tick_cost::worst_case_instruction_cycles;
+
+use std::collections::HashMap;
+use std::ops::Range;
+
+/// Size of a `call_subroutine` instruction
+const CALL_SUBROUTINE_SIZE: usize = 2;
+/// Size of a `return_from_subroutine` instruction
+const RETURN_FROM_SUBROUTINE_SIZE: usize = 1;
+/// Size of a subroutine table entry in the song header
+const SUBROUTINE_TABLE_ENTRY_SIZE: usize = 2;
+
+/// Maximum number of instructions in a candidate
+const MAX_SEQUENCE_LENGTH: usize = 64;
+
+/// Minimum number of instructions in a candidate
+const MIN_SEQUENCE_LENGTH: usize = 2;
+
+/// A repeated sequence of bytecode instructions that could be moved into a subroutine
+#[derive(Debug, Clone, PartialEq)]
+pub struct SubroutineCandidate {
+    /// Song data offset of every (non-overlapping) occurrence of the sequence
+    pub offsets: Vec<u16>,
+    /// Number of instructions in the sequence
+    pub n_instructions: usize,
+    /// Size of the sequence in bytes
+    pub size: usize,
+    /// Number of song data bytes saved if every occurrence is replaced by a `call_subroutine`
+    /// instruction (includes the `return_from_subroutine` instruction and the subroutine table
+    /// entry)
+    pub bytes_saved: usize,
+    /// Worst-case S-SMP cycles added to every occurrence (`call_subroutine` and
+    /// `return_from_subroutine`)
+    pub call_cycles: u32,
+}
+
+/// Returns the size of a bytecode instruction
+fn instruction_size(opcode: u8) -> usize {
+    match opcode {
+        opcodes::FIRST_PLAY_NOTE_INSTRUCTION.. => 2,
+
+        opcodes::RESERVED_FOR_CUSTOM_USE => 1,
+        opcodes::PORTAMENTO_DOWN | opcodes::PORTAMENTO_UP => 4,
+        opcodes::PORTAMENTO_PITCH_DOWN | opcodes::PORTAMENTO_PITCH_UP => 5,
+        opcodes::SET_VIBRATO => 3,
+        opcodes::SET_VIBRATO_DEPTH_AND_PLAY_NOTE => 4,
+        opcodes::PLAY_PITCH => 4,
+        opcodes::PLAY_NOISE => 3,
+        opcodes::WAIT => 2,
+        opcodes::REST => 2,
+        opcodes::SET_INSTRUMENT => 2,
+        opcodes::SET_INSTRUMENT_AND_ADSR_OR_GAIN => 4,
+        opcodes::SET_ADSR => 3,
+        opcodes::SET_GAIN => 2,
+        opcodes::SET_TEMP_GAIN => 2,
+        opcodes::SET_TEMP_GAIN_AND_WAIT => 3,
+        opcodes::SET_TEMP_GAIN_AND_REST => 3,
+        opcodes::REUSE_TEMP_GAIN_AND_WAIT => 2,
+        opcodes::REUSE_TEMP_GAIN_AND_REST => 2,
+        opcodes::SET_EARLY_RELEASE => 4,
+        opcodes::SET_EARLY_RELEASE_NO_MINIMUM => 3,
+        opcodes::SET_DETUNE_I16 => 3,
+        opcodes::SET_DETUNE_P8 => 2,
+        opcodes::SET_DETUNE_N8 => 2,
+        opcodes::ADJUST_PAN => 2,
+        opcodes::SET_PAN => 2,
+        opcodes::SET_PAN_AND_VOLUME => 3,
+        opcodes::ADJUST_VOLUME => 2,
+        opcodes::SET_VOLUME => 2,
+        opcodes::SET_CHANNEL_INVERT => 2,
+        opcodes::VOLUME_SLIDE_UP => 4,
+        opcodes::VOLUME_SLIDE_DOWN => 4,
+        opcodes::TREMOLO => 4,
+        opcodes::PAN_SLIDE_UP => 4,
+        opcodes::PAN_SLIDE_DOWN => 4,
+        opcodes::PANBRELLO => 4,
+        opcodes::SET_SONG_TICK_CLOCK => 2,
+        opcodes::START_LOOP => 2,
+        opcodes::SKIP_LAST_LOOP_U8 => 2,
+        opcodes::SKIP_LAST_LOOP_U16BE => 3,
+        opcodes::CALL_SUBROUTINE_AND_DISABLE_VIBRATO => 2,
+        opcodes::CALL_SUBROUTINE => 2,
+        opcodes::GOTO_RELATIVE => 3,
+        opcodes::SET_ECHO_VOLUME => 2,
+        opcodes::SET_STEREO_ECHO_VOLUME => 3,
+        opcodes::ADJUST_ECHO_VOLUME => 2,
+        opcodes::ADJUST_STEREO_ECHO_VOLUME => 3,
+        opcodes::SET_FIR_FILTER => 9,
+        opcodes::SET_ECHO_I8 => 3,
+        opcodes::ADJUST_ECHO_I8 => 3,
+        opcodes::ADJUST_ECHO_I8_LIMIT => 4,
+        opcodes::SET_ECHO_INVERT => 2,
+        opcodes::SET_ECHO_DELAY => 2,
+        opcodes::END_LOOP => 1,
+        opcodes::RETURN_FROM_SUBROUTINE_AND_DISABLE_VIBRATO => 1,
+        opcodes::RETURN_FROM_SUBROUTINE => 1,
+        opcodes::DISABLE_NOISE => 1,
+        opcodes::ENABLE_PMOD => 1,
+        opcodes::DISABLE_PMOD => 1,
+        opcodes::ENABLE_ECHO => 1,
+        opcodes::DISABLE_ECHO => 1,
+        opcodes::REUSE_TEMP_GAIN => 1,
+        opcodes::DISABLE_CHANNEL => 1,
+    }
+}
+
+/// Returns true if the instruction cannot be moved into a subroutine.
+///
+/// Loops, branches and calls are not moved as moving them changes the stack depth or
+/// invalidates their offsets.
+fn is_barrier(opcode: u8) -> bool {
+    matches!(
+        opcode,
+        opcodes::RESERVED_FOR_CUSTOM_USE
+            | opcodes::START_LOOP
+            | opcodes::SKIP_LAST_LOOP_U8
+            | opcodes::SKIP_LAST_LOOP_U16BE
+            | opcodes::END_LOOP
+            | opcodes::CALL_SUBROUTINE_AND_DISABLE_VIBRATO
+            | opcodes::CALL_SUBROUTINE
+            | opcodes::GOTO_RELATIVE
+            | opcodes::RETURN_FROM_SUBROUTINE_AND_DISABLE_VIBRATO
+            | opcodes::RETURN_FROM_SUBROUTINE
+            | opcodes::DISABLE_CHANNEL
+    )
+}
+
+/// The channel and subroutine bytecode blocks of a song (sorted by offset).
+///
+/// Channel and subroutine bytecode is stored contiguously in the song data, a block ends at the
+/// start of the next block.
+fn bytecode_blocks(song: &SongData) -> Vec<Range<usize>> {
+    let data_len = song.data().len();
+
+    let mut starts: Vec<usize> = song
+        .channels()
+        .iter()
+        .flatten()
+        .map(|c| usize::from(c.bytecode_offset))
+        .chain(
+            song.subroutines()
+                .iter()
+                .map(|s| usize::from(s.bytecode_offset)),
+        )
+        .filter(|&o| o < data_len)
+        .collect();
+
+    starts.sort_unstable();
+    starts.dedup();
+
+    let ends = starts
+        .iter()
+        .skip(1)
+        .copied()
+        .chain(std::iter::once(data_len));
+
+    starts.iter().zip(ends).map(|(&s, e)| s..e).collect()
+}
+
+struct Instruction {
+    offset: usize,
+    size: usize,
+    /// Instructions with the same bytes have the same id
+    id: u32,
+    /// The instruction cannot be part of a candidate
+    barrier: bool,
+    /// A candidate cannot continue past this instruction
+    ends_run: bool,
+}
+
+fn decode_instructions(song: &SongData) -> Vec<Instruction> {
+    let data = song.data();
+
+    // The target of a channel's song loop `goto_relative` instruction must not be moved
+    let loop_points: Vec<usize> = song
+        .channels()
+        .iter()
+        .flatten()
+        .filter_map(|c| c.loop_point.map(|lp| lp.bytecode_offset))
+        .collect();
+
+    let mut ids: HashMap<&[u8], u32> = HashMap::new();
+    let mut out: Vec<Instruction> = Vec::new();
+
+    for block in bytecode_blocks(song) {
+        let mut pos = block.start;
+
+        while pos < block.end {
+            let opcode = data[pos];
+            let size = instruction_size(opcode);
+            if pos + size > block.end {
+                break;
+            }
+
+            let bytes = &data[pos..pos + size];
+            let next_id = ids.len() as u32;
+            let id = *ids.entry(bytes).or_insert(next_id);
+
+            if loop_points.contains(&pos) {
+                // Prevents a candidate from crossing the loop point
+                if let Some(prev) = out.last_mut() {
+                    prev.ends_run = true;
+                }
+            }
+
+            out.push(Instruction {
+                offset: pos,
+                size,
+                id,
+                barrier: is_barrier(opcode),
+                ends_run: false,
+            });
+
+            pos += size;
+        }
+
+        // Prevents a candidate from crossing a block boundary
+        if let Some(last) = out.last_mut() {
+            last.ends_run = true;
+        }
+    }
+
+    out
+}
+
+/// Returns the non-overlapping start indexes of `indexes` whose instructions match `indexes[0]`
+fn non_overlapping_matches(
+    instructions: &[Instruction],
+    indexes: &[usize],
+    length: usize,
+) -> Vec<usize> {
+    let first = indexes[0];
+    let first_ids = || instructions[first..first + length].iter().map(|i| i.id);
+
+    let mut out = Vec::new();
+    let mut next_free = 0;
+
+    for &i in indexes {
+        if i >= next_free
+            && instructions[i..i + length]
+                .iter()
+                .map(|i| i.id)
+                .eq(first_ids())
+        {
+            out.push(i);
+            next_free = i + length;
+        }
+    }
+    out
+}
+
+fn bytes_saved(n_occurrences: usize, size: usize) -> usize {
+    let before = n_occurrences * size;
+    let after = n_occurrences * CALL_SUBROUTINE_SIZE
+        + size
+        + RETURN_FROM_SUBROUTINE_SIZE
+        + SUBROUTINE_TABLE_ENTRY_SIZE;
+
+    before.saturating_sub(after)
+}
+
+/// Finds repeated bytecode sequences in the song's channels and subroutines.
+///
+/// Candidates are found greedily (the largest saving first) and do not overlap.  Sequences
+/// cannot contain loops, subroutine calls or branches, cannot cross a song loop point and must
+/// save at least `min_bytes_saved` bytes.
+///
+/// Returns at most `max_candidates` candidates (limited by the number of unused subroutines),
+/// with the largest saving first.
+pub fn find_subroutine_candidates(
+    song: &SongData,
+    min_bytes_saved: usize,
+    max_candidates: usize,
+) -> Vec<SubroutineCandidate> {
+    const HASH_MULTIPLIER: u64 = 0x100_0000_01b3;
+
+    let call_cycles = worst_case_instruction_cycles(opcodes::CALL_SUBROUTINE)
+        + worst_case_instruction_cycles(opcodes::RETURN_FROM_SUBROUTINE);
+
+    let max_candidates =
+        max_candidates.min(MAX_SUBROUTINES.saturating_sub(song.subroutines().len()));
+
+    let mut instructions = decode_instructions(song);
+    let n = instructions.len();
+
+    let mut out = Vec::new();
+
+    while out.len() < max_candidates {
+        // Maximum number of instructions in a candidate starting at `i`
+        let mut run_length = vec![0; n + 1];
+        for i in (0..n).rev() {
+            let inst = &instructions[i];
+            run_length[i] = match (inst.barrier, inst.ends_run) {
+                (true, _) => 0,
+                (false, true) => 1,
+                (false, false) => run_length[i + 1] + 1,
+            };
+        }
+
+        // (start index, length, occurrences, bytes saved)
+        let mut best: Option<(usize, usize, Vec<usize>, usize)> = None;
+
+        // Rolling hash of the sequence of `length` instructions starting at each instruction
+        let mut hashes: Vec<u64> = vec![0; n];
+        let mut sizes: Vec<usize> = vec![0; n];
+
+        for length in 1..=MAX_SEQUENCE_LENGTH {
+            let mut windows: HashMap<u64, Vec<usize>> = HashMap::new();
+
+            for i in 0..n {
+                if run_length[i] < length {
+                    continue;
+                }
+                let last = &instructions[i + length - 1];
+                hashes[i] = hashes[i]
+                    .wrapping_mul(HASH_MULTIPLIER)
+                    .wrapping_add(u64::from(last.id) + 1);
+                sizes[i] += last.size;
+
+                if length >= MIN_SEQUENCE_LENGTH {
+                    windows.entry(hashes[i]).or_default().push(i);
+                }
+            }
+
+            if length < MIN_SEQUENCE_LENGTH {
+                continue;
+            }
+            if windows.is_empty() {
+                break;
+            }
+
+            for indexes in windows.values().filter(|v| v.len() > 1) {
+                let size = sizes[indexes[0]];
+                if bytes_saved(indexes.len(), size) <= best.as_ref().map_or(0, |b| b.3) {
+                    continue;
+                }
+
+                let matches = non_overlapping_matches(&instructions, indexes, length);
+                let saved = bytes_saved(matches.len(), size);
+
+                if saved > best.as_ref().map_or(0, |b| b.3) {
+                    best = Some((indexes[0], length, matches, saved));
+                }
+            }
+        }
+
+        let (start, length, matches, saved) = match best {
+            Some(b) if b.3 >= min_bytes_saved => b,
+            _ => break,
+        };
+
+        let size = instructions[start..start + length]
+            .iter()
+            .map(|i| i.size)
+            .sum();
+
+        // Occurrences cannot be reused by another candidate
+        for &m in &matches {
+            for i in &mut instructions[m..m + length] {
+                i.barrier = true;
+            }
+        }
+
+        out.push(SubroutineCandidate {
+            offsets: matches
+                .iter()
+                .map(|&m| u16::try_from(instructions[m].offset).unwrap_or(u16::MAX))
+                .collect(),
+            n_instructions: length,
+            size,
+            bytes_saved: saved,
+            call_cycles,
+        });
+    }
+
+    out
+}
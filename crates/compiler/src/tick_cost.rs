@@ -0,0 +1,265 @@
+//! Song tick S-SMP cycle estimates and measurements
+//!
+//! NOTE: The cycle table in `bytecode_cycles.rs` has not been measured.  The estimates are only
+//!       shown next to the emulator measured cycles in `tad-compiler tick-report` and MUST NOT
+//!       be used to warn about or reject songs until the table is generated by
+//!       `bytecode_cycle_costs --rust`.
+
+// SPDX-FileCopyrightText: © 2023 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+use crate::bytecode::opcodes;
+use crate::bytecode_cycles::{
+    BC_CHANNEL_OVERHEAD_CYCLES, BC_DISPATCH_CYCLES, BC_INSTRUCTION_CYCLES,
+    BC_UNKNOWN_INSTRUCTION_CYCLES,
+};
+use crate::bytecode_interpreter::SongInterpreter;
+use crate::common_audio_data::CommonAudioData;
+use crate::driver_constants::{addresses, N_MUSIC_CHANNELS};
+use crate::mml::sorted_tempo_changes;
+use crate::songs::SongData;
+use crate::time::{TickClock, TickCounter};
+
+/// S-SMP cycles per timer 0 clock (8000 Hz)
+pub const CYCLES_PER_TIMER_CLOCK: u32 = 128;
+
+/// Maximum number of ticks to estimate (prevents a very long song from using too much memory)
+const MAX_TICKS: u32 = 0x100_000;
+
+/// Maximum number of S-SMP clocks a measured song tick can take (1 second)
+/// (a song tick that takes longer than this has almost certainly crashed the driver)
+pub const MAX_TICK_SMP_CLOCKS: u64 = 2_048_000;
+
+/// Worst-case S-SMP cycles of a bytecode instruction (including dispatch)
+pub fn worst_case_instruction_cycles(opcode: u8) -> u32 {
+    let opcode = opcode.min(opcodes::FIRST_PLAY_NOTE_INSTRUCTION);
+
+    let c = match BC_INSTRUCTION_CYCLES.iter().find(|(o, ..)| *o == opcode) {
+        Some((_, _min, max, _mean)) => *max,
+        None => BC_UNKNOWN_INSTRUCTION_CYCLES,
+    };
+
+    c + BC_DISPATCH_CYCLES.1
+}
+
+/// The number of S-SMP cycles between song ticks
+pub fn tick_budget(tick_clock: TickClock) -> u32 {
+    u32::from(tick_clock.as_u8()) * CYCLES_PER_TIMER_CLOCK
+}
+
+/// A run of consecutive song ticks whose estimated cycles exceeds the tick budget
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct OverBudgetWindow {
+    pub first_tick: TickCounter,
+    pub last_tick: TickCounter,
+    /// The largest estimated tick cost in the window
+    pub peak_cycles: u32,
+    /// The tick budget at `peak_cycles`
+    pub budget: u32,
+}
+
+/// The estimated worst-case S-SMP cycles of every song tick
+pub struct TickCostEstimate {
+    /// Estimated worst-case `process_music_channels()` cycles, indexed by song tick
+    pub cycles: Vec<u32>,
+    /// Tick budget, indexed by song tick
+    pub budgets: Vec<u32>,
+}
+
+impl TickCostEstimate {
+    pub fn over_budget_windows(&self) -> Vec<OverBudgetWindow> {
+        let mut out: Vec<OverBudgetWindow> = Vec::new();
+        let mut prev_over = false;
+
+        for (tick, (&cycles, &budget)) in self.cycles.iter().zip(&self.budgets).enumerate() {
+            let over = cycles > budget;
+            let tick = TickCounter::new(tick as u32);
+
+            if over {
+                match out.last_mut() {
+                    Some(w) if prev_over => {
+                        w.last_tick = tick;
+                        if cycles > w.peak_cycles {
+                            w.peak_cycles = cycles;
+                            w.budget = budget;
+                        }
+                    }
+                    _ => out.push(OverBudgetWindow {
+                        first_tick: tick,
+                        last_tick: tick,
+                        peak_cycles: cycles,
+                        budget,
+                    }),
+                }
+            }
+            prev_over = over;
+        }
+
+        out
+    }
+}
+
+/// Estimates the worst-case S-SMP cycles of every music tick of a song (without emulating the
+/// audio driver).
+///
+/// Every channel that has not ended costs `BC_CHANNEL_OVERHEAD_CYCLES` per tick and every
+/// bytecode instruction costs its worst-case cycles in the tick it is executed.
+/// Looping songs are estimated until the end of their first loop.
+///
+/// Returns None if the bytecode interpreter timed out.
+pub fn estimate_tick_costs(
+    common_audio_data: &CommonAudioData,
+    song: &SongData,
+) -> Option<TickCostEstimate> {
+    let channels = song.channels();
+
+    let song_ticks = channels
+        .iter()
+        .flatten()
+        .map(|c| c.tick_counter.value())
+        .max()
+        .unwrap_or(0)
+        .min(MAX_TICKS);
+
+    let n_ticks = song_ticks as usize + 1;
+
+    let mut cycles = vec![0; n_ticks];
+
+    for c in channels.iter().flatten() {
+        let end = match c.loop_point {
+            Some(_) => n_ticks,
+            None => (c.tick_counter.value() as usize).min(n_ticks),
+        };
+        for t in &mut cycles[..end] {
+            *t += BC_CHANNEL_OVERHEAD_CYCLES.1;
+        }
+    }
+
+    let mut interpreter = SongInterpreter::new(common_audio_data, song, true);
+    let ok = interpreter.process_ticks_inspect(TickCounter::new(song_ticks + 1), |tick, opcode| {
+        if let Some(t) = cycles.get_mut(tick.value() as usize) {
+            *t += worst_case_instruction_cycles(opcode);
+        }
+    });
+    if !ok {
+        return None;
+    }
+
+    let mut budgets = Vec::with_capacity(n_ticks);
+    let mut tick_clock = song.metadata().tick_clock;
+    let mut tempo_changes = sorted_tempo_changes(channels).into_iter().peekable();
+
+    for tick in 0..n_ticks {
+        while let Some((_, tc)) = tempo_changes.next_if(|(t, _)| t.value() as usize <= tick) {
+            tick_clock = tc;
+        }
+        budgets.push(tick_budget(tick_clock));
+    }
+
+    Some(TickCostEstimate { cycles, budgets })
+}
+
+/// Converts emulator S-SMP clocks to S-SMP cycles
+pub fn smp_clocks_to_cycles(smp_clocks: u64) -> u64 {
+    // 2 clocks per S-SMP cycle
+    smp_clocks / 2
+}
+
+/// The part of a song tick the next S-SMP instruction is in
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum TickStep {
+    /// `process_music_channels()`, outside of `process_bytecode()`
+    ChannelOverhead,
+    /// `process_bytecode()` (and the bytecode instructions) of music channel `channel`
+    Bytecode { channel: usize },
+    /// `process_music_channels()` has returned
+    Ended,
+    /// The song tick took more than `MAX_TICK_SMP_CLOCKS`
+    TimedOut,
+}
+
+/// Follows an emulated S-SMP through a single song tick (one `process_music_channels()` call).
+///
+/// The compiler does not depend on an emulator.  The caller single-steps the emulator, calling
+/// `next_instruction()` before and `add_clocks()` after every instruction.
+pub struct TickTracker {
+    tick_return_sp: u8,
+
+    /// The channel index and return stack pointer of the `process_bytecode()` call that is being
+    /// processed
+    bytecode: Option<(usize, u8)>,
+
+    smp_clocks: u64,
+    overhead_smp_clocks: u64,
+    bytecode_smp_clocks: [u64; N_MUSIC_CHANNELS],
+}
+
+impl TickTracker {
+    /// ASSUMES: the program counter is `addresses::PROCESS_MUSIC_CHANNELS_CODE`
+    pub fn new(sp: u8) -> Self {
+        Self {
+            // `process_music_channels()` and `process_bytecode()` are called.
+            // They have returned when the stack pointer is above their return address.
+            tick_return_sp: sp.wrapping_add(2),
+            bytecode: None,
+            smp_clocks: 0,
+            overhead_smp_clocks: 0,
+            bytecode_smp_clocks: [0; N_MUSIC_CHANNELS],
+        }
+    }
+
+    /// Returns where the instruction at `pc` is, using the S-SMP registers before the instruction
+    /// is executed.
+    pub fn next_instruction(&mut self, pc: u16, sp: u8, x: u8) -> TickStep {
+        if sp == self.tick_return_sp {
+            return TickStep::Ended;
+        }
+        if self.smp_clocks >= MAX_TICK_SMP_CLOCKS {
+            return TickStep::TimedOut;
+        }
+
+        match self.bytecode {
+            Some((_, return_sp)) if sp == return_sp => self.bytecode = None,
+            None if pc == addresses::PROCESS_BYTECODE_CODE => {
+                // Bytecode instructions MUST NOT modify X
+                self.bytecode = Some((usize::from(x), sp.wrapping_add(2)));
+            }
+            _ => (),
+        }
+
+        match self.bytecode {
+            Some((channel, _)) => TickStep::Bytecode { channel },
+            None => TickStep::ChannelOverhead,
+        }
+    }
+
+    /// Adds the S-SMP clocks of the instruction after the last `next_instruction()` call.
+    pub fn add_clocks(&mut self, smp_clocks: u64) {
+        self.smp_clocks += smp_clocks;
+
+        match self.bytecode {
+            Some((channel, _)) => {
+                if let Some(b) = self.bytecode_smp_clocks.get_mut(channel) {
+                    *b += smp_clocks;
+                }
+            }
+            None => self.overhead_smp_clocks += smp_clocks,
+        }
+    }
+
+    /// S-SMP clocks used by the song tick
+    pub fn smp_clocks(&self) -> u64 {
+        self.smp_clocks
+    }
+
+    /// S-SMP clocks used outside of `process_bytecode()`
+    pub fn overhead_smp_clocks(&self) -> u64 {
+        self.overhead_smp_clocks
+    }
+
+    /// S-SMP clocks used by each music channel's bytecode
+    pub fn bytecode_smp_clocks(&self) -> [u64; N_MUSIC_CHANNELS] {
+        self.bytecode_smp_clocks
+    }
+}
@@ -133,6 +133,79 @@ fn merge_pan_and_volume() {
     merge_mml_commands_test("V-10 || p+5", &["adjust_volume -10", "adjust_pan +5"]);
 }
 
+#[test]
+fn volume_and_pan_deduplication() {
+    assert_line_matches_line("V10 a V10 b V10 c", "V10 a b c");
+    assert_line_matches_line("p20 a p20 b px-44 c", "p20 a b c");
+    assert_line_matches_line("V10 p20 a V10 p20 b", "V10 p20 a b");
+
+    assert_line_matches_bytecode(
+        "V10 p20 a V10 p30 b V20 p30 c",
+        &[
+            "set_pan_and_volume 20 10",
+            "play_note a4 24",
+            "set_pan 30",
+            "play_note b4 24",
+            "set_volume 20",
+            "play_note c4 24",
+        ],
+    );
+
+    // Relative volume and pan changes can saturate
+    assert_line_matches_bytecode(
+        "V10 a V+5 b V15 c",
+        &[
+            "set_volume 10",
+            "play_note a4 24",
+            "adjust_volume +5",
+            "play_note b4 24",
+            "set_volume 15",
+            "play_note c4 24",
+        ],
+    );
+
+    // Slides and tremolo change the volume
+    assert_line_matches_bytecode(
+        "V10 a Vs+5,10 b V10 c",
+        &[
+            "set_volume 10",
+            "play_note a4 24",
+            "volume_slide +5 10",
+            "play_note b4 24",
+            "set_volume 10",
+            "play_note c4 24",
+        ],
+    );
+
+    assert_line_matches_bytecode(
+        "V10 [a V10 b]5 V10",
+        &[
+            "set_volume 10",
+            "start_loop",
+            "play_note a4 24",
+            "set_volume 10",
+            "play_note b4 24",
+            "end_loop 5",
+            // V10 deduplicated
+        ],
+    );
+
+    assert_line_matches_bytecode(
+        "p10 [p10 a : p20 b]5 p20",
+        &[
+            "set_pan 10",
+            "start_loop",
+            "set_pan 10",
+            "play_note a4 24",
+            "skip_last_loop",
+            "set_pan 20",
+            "play_note b4 24",
+            "end_loop 5",
+            "set_pan 20",
+        ],
+    );
+}
+
 #[test]
 fn large_adjust_volume() {
     assert_line_matches_bytecode("V+127", &["adjust_volume +127"]);
@@ -6,24 +6,33 @@
 
 use std::collections::HashMap;
 use std::ops::Range;
+use std::path::Path;
 use std::str::FromStr;
 use std::sync::OnceLock;
 
 use compiler::audio_driver;
 use compiler::common_audio_data::{build_common_audio_data, CommonAudioData};
 use compiler::data;
-use compiler::data::{validate_sfx_export_order, DefaultSfxFlags, Instrument, Name};
+use compiler::data::{
+    load_project_file, validate_project_file_names, validate_sfx_export_order, DefaultSfxFlags,
+    Instrument, InstrumentOrSample, Name, TextFile, UniqueNamesList,
+};
 use compiler::driver_constants::{
     addresses, io_commands, LoaderDataType, FIRST_SFX_CHANNEL, IO_COMMAND_I_MASK, IO_COMMAND_MASK,
-    N_SFX_CHANNELS,
+    N_MUSIC_CHANNELS, N_SFX_CHANNELS,
 };
 use compiler::envelope::{Envelope, Gain};
+use compiler::mml::compile_mml;
 use compiler::notes::Octave;
-use compiler::samples::combine_samples;
+use compiler::samples::{
+    build_sample_and_instrument_data, combine_samples, SampleAndInstrumentData,
+};
+use compiler::songs::SongData;
 use compiler::sound_effects::{
     combine_sound_effects, compile_sfx_subroutines, compile_sound_effect_input, SfxFlags,
     SfxSubroutinesMml, SoundEffectInput, SoundEffectText,
 };
+use compiler::spc_file_export::S_DSP_ESA_REGISTER;
 use compiler::Pan;
 
 use shvc_sound_emu::ShvcSoundEmu;
@@ -56,6 +65,32 @@ enum Sfx {
 
 const NO_SFX: u8 = 0xff;
 
+/// Loader flags of the test emulators
+const LOADER_FLAGS: LoaderDataType = LoaderDataType {
+    stereo_flag: true,
+    play_song: true,
+    skip_echo_buffer_reset: true,
+    tick_budget: false,
+};
+
+/// Project file containing the instruments used by the song tests
+const EXAMPLE_PROJECT: &str = concat!(
+    env!("CARGO_MANIFEST_DIR"),
+    "/../../examples/example-project.terrificaudio"
+);
+
+/// A song that takes longer than the tick budget to process.
+///
+/// Every channel starts a note (with vibrato) or a portamento every 2 to 4 ticks, at the shortest
+/// tick clock (8ms).
+const OVERLOADED_SONG: &str = r#"
+#Timer 64
+
+@1 sine
+
+ABCDEFGH @1 o4 ~40,1 L {cg}%4 c%2 d%2 e%2 f%2
+"#;
+
 #[rustfmt::skip]
 const HIGH_PRIORITY_SFX: &[TestSoundEffect] = &[
     TestSoundEffect { name: "HighPriority",                     ticks: 100, interruptible: true,  one_channel: false },
@@ -201,6 +236,25 @@ fn two_interruptible_sfx_2() {
     assert_sfx_channels!(emu, Interruptible, LongInterruptible);
 }
 
+#[test]
+fn two_interruptible_sfx_forked() {
+    let mut emu = test_emu();
+
+    emu.play_sound_effect_command(Sfx::LongInterruptible);
+    emu.play_sound_effect_command(Sfx::ShortInterruptible);
+    assert_sfx_channels!(emu, ShortInterruptible, LongInterruptible);
+
+    // the sfx that finishes first is dropped (tested on a fork of the same emulator state)
+    for sfx in [Sfx::Interruptible, Sfx::Uninterruptible, Sfx::HighPriority] {
+        let mut fork = emu.clone();
+        fork.play_sound_effect_command(sfx);
+        assert_sfx_channels(&fork, Some(sfx), Some(Sfx::LongInterruptible));
+    }
+
+    // The forks do not modify the original emulator
+    assert_sfx_channels!(emu, ShortInterruptible, LongInterruptible);
+}
+
 #[test]
 fn two_uninterruptible_sfx_1() {
     let mut emu = test_emu();
@@ -396,7 +450,370 @@ fn low_priority_one_channel_uninterruptible() {
     _one_channel_tests(Sfx::LowPriorityOneUninterruptible, false);
 }
 
+#[test]
+fn io_command_ack_latency() {
+    // 4ms (a quarter of a frame)
+    const MAX_ACK_CLOCKS: u64 = ShvcSoundEmu::SMP_CLOCKS_PER_SECOND / 250;
+
+    let mut emu = test_emu();
+    emu.emu
+        .start_io_latency(IO_COMMAND_MASK, io_commands::PLAY_SOUND_EFFECT);
+
+    for s in [
+        Sfx::ShortInterruptible,
+        Sfx::LongInterruptible,
+        Sfx::Uninterruptible,
+    ] {
+        emu.play_sound_effect_command(s);
+        emu.emulate(2);
+    }
+    emu.pause_command();
+
+    let latency = emu.emu.io_latency();
+    assert_eq!(latency.ack.count, 4);
+    assert_eq!(latency.unacknowledged, 0);
+    assert!(
+        latency.ack.max_clocks < MAX_ACK_CLOCKS,
+        "IO command took {} clocks to acknowledge",
+        latency.ack.max_clocks
+    );
+}
+
+/// Runs an `OVERLOADED_SONG` emulator to the start of a music tick
+fn overloaded_song_at_music_tick() -> Emu {
+    let mut emu = song_test_emu(OVERLOADED_SONG, LOADER_FLAGS);
+
+    // Start the vibrato and portamento
+    let r = emu.emu.run_ticks(
+        8,
+        addresses::PROCESS_MUSIC_CHANNELS_CODE,
+        ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+    );
+    assert!(r.hit, "music ticks not processed");
+
+    emu
+}
+
+/// Music channel state read by `__process_channels()`
+fn music_channel_state(emu: &Emu) -> Vec<u8> {
+    let apuram = emu.emu.apuram();
+
+    let mut out = Vec::new();
+    for addr in [
+        addresses::CHANNEL_INSTRUCTION_PTR_L,
+        addresses::CHANNEL_INSTRUCTION_PTR_H,
+        addresses::CHANNEL_COUNTDOWN_TIMER,
+        addresses::CHANNEL_VC_PITCH_L,
+        addresses::CHANNEL_VC_PITCH_H,
+        addresses::CHANNEL_VIBRATO_DIRECTION,
+        addresses::CHANNEL_VIBRATO_TICK_COUNTER,
+    ] {
+        let addr = usize::from(addr);
+        out.extend_from_slice(&apuram[addr..addr + N_MUSIC_CHANNELS]);
+    }
+    out.extend_from_slice(&emu.song_tick_counter().to_le_bytes());
+    out
+}
+
+#[test]
+fn sfx_command_ack_latency_in_music_tick() {
+    const MUSIC_HEADROOM_PORT: usize = 2;
+
+    let mut emu = overloaded_song_at_music_tick();
+    let state = emu.emu.save_state();
+
+    // `process_music_channels()` writes the headroom after the `__process_channels()` loop
+    let r = emu.emu.run_until_port_write(
+        1 << MUSIC_HEADROOM_PORT,
+        ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+    );
+    assert!(r.hit, "music tick not processed");
+    let music_tick_clocks = r.smp_clocks;
+
+    emu.emu.load_state(&state).unwrap();
+    emu.emu
+        .start_io_latency(IO_COMMAND_MASK, io_commands::PLAY_SOUND_EFFECT);
+
+    emu.send_command(
+        io_commands::PLAY_SOUND_EFFECT,
+        Sfx::Interruptible as u8,
+        Pan::CENTER.as_u8(),
+    );
+    let r = emu
+        .emu
+        .run_until_port_write(1 << 0, ShvcSoundEmu::SMP_CLOCKS_PER_SECOND);
+    assert!(r.hit, "IO command not acknowledged");
+
+    // The sound effect must not wait for the music tick to finish
+    let latency = emu.emu.io_latency();
+    assert_eq!(latency.ack.count, 1);
+    assert!(
+        latency.ack.max_clocks < music_tick_clocks,
+        "IO command took {} clocks to acknowledge (music tick is {} clocks)",
+        latency.ack.max_clocks,
+        music_tick_clocks
+    );
+
+    assert!(emu.is_io_command_acknowledged());
+    assert_sfx_channels!(emu, None, Interruptible);
+}
+
+#[test]
+fn sfx_command_in_music_tick_preserves_music_channels() {
+    const MUSIC_HEADROOM_PORT: usize = 2;
+    const TICKS: u32 = 16;
+
+    let run_ticks = |emu: &mut Emu| {
+        let r = emu.emu.run_ticks(
+            TICKS,
+            addresses::PROCESS_MUSIC_CHANNELS_CODE,
+            ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+        );
+        assert!(r.hit, "music ticks not processed");
+    };
+
+    let mut emu = overloaded_song_at_music_tick();
+    let state = emu.emu.save_state();
+    let previous_command = emu.previous_command;
+
+    // Sound effect started by `process_sfx_command_mid_tick()` inside the music
+    // `__process_channels()` loop.
+    emu.send_command(
+        io_commands::PLAY_SOUND_EFFECT,
+        Sfx::Interruptible as u8,
+        Pan::CENTER.as_u8(),
+    );
+    run_ticks(&mut emu);
+    assert_sfx_channels!(emu, None, Interruptible);
+    let mid_tick = music_channel_state(&emu);
+
+    emu.emu.load_state(&state).unwrap();
+    emu.previous_command = previous_command;
+
+    // Sound effect started by the main loop, after the music tick
+    let r = emu.emu.run_until_port_write(
+        1 << MUSIC_HEADROOM_PORT,
+        ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+    );
+    assert!(r.hit, "music tick not processed");
+    emu.send_command(
+        io_commands::PLAY_SOUND_EFFECT,
+        Sfx::Interruptible as u8,
+        Pan::CENTER.as_u8(),
+    );
+    run_ticks(&mut emu);
+    assert_sfx_channels!(emu, None, Interruptible);
+    let after_tick = music_channel_state(&emu);
+
+    // `play_sound_effect()` must not clobber the loop temporaries
+    // (`zpTmp*`, `*_tmp` and `channelIndexEndLoop`).
+    assert_eq!(mid_tick, after_tick, "music channel state mismatch");
+}
+
+#[test]
+fn tick_budget_overloaded_song() {
+    const MUSIC_HEADROOM_PORT: usize = 2;
+    const SFX_HEADROOM_PORT: usize = 3;
+
+    // MUST match `MAX_HEADROOM` in `audio-driver/src/io-commands.wiz`
+    const MAX_HEADROOM: u8 = 7;
+    // MUST match `LOADER_READY_L` and `LOADER_READY_H` in `audio-driver/src/io-commands.wiz`
+    const LOADER_READY: [u8; 2] = [b'L', b'D'];
+
+    // `OVERLOADED_SONG` ticks every 8ms
+    const TICKS_PER_SECOND: u16 = 125;
+
+    let mut emu = song_test_emu(
+        OVERLOADED_SONG,
+        LoaderDataType {
+            tick_budget: true,
+            ..LOADER_FLAGS
+        },
+    );
+
+    // An overloaded tick is a song and two sound effects
+    emu.play_sound_effect_command(Sfx::Interruptible);
+    emu.play_sound_effect_command(Sfx::LongInterruptible);
+    assert_sfx_channels!(emu, LongInterruptible, Interruptible);
+
+    let start_tick = emu.song_tick_counter();
+
+    let mut over_budget_ticks = 0;
+    let mut clocks = 0;
+    while clocks < ShvcSoundEmu::SMP_CLOCKS_PER_SECOND {
+        let r = emu.emu.run_until_port_write(
+            1 << MUSIC_HEADROOM_PORT,
+            ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+        );
+        assert!(r.hit, "music tick not processed");
+        clocks += r.smp_clocks;
+
+        let ports = emu.emu.read_io_ports();
+        if ports[MUSIC_HEADROOM_PORT] == 0 {
+            over_budget_ticks += 1;
+        }
+
+        // The headroom ports are the loader's ready signal ports
+        assert!(
+            ports[MUSIC_HEADROOM_PORT] <= MAX_HEADROOM && ports[SFX_HEADROOM_PORT] <= MAX_HEADROOM,
+            "invalid headroom: {ports:?}"
+        );
+        assert_ne!(
+            ports[MUSIC_HEADROOM_PORT..=SFX_HEADROOM_PORT],
+            LOADER_READY,
+            "headroom matches the loader ready signal"
+        );
+    }
+
+    let ticks = emu.song_tick_counter().wrapping_sub(start_tick);
+
+    assert!(
+        over_budget_ticks > 0,
+        "OVERLOADED_SONG did not exceed the tick budget"
+    );
+    // 1 tick of tolerance for the `run_until_port_write()` boundaries
+    assert!(
+        ticks >= TICKS_PER_SECOND - 1,
+        "overloaded ticks delayed the song ({ticks} ticks in 1 second, {over_budget_ticks} over budget)"
+    );
+
+    // Both sound effects are still playing
+    assert_sfx_channels!(emu, LongInterruptible, Interruptible);
+}
+
+#[test]
+fn echo_buffer_clear() {
+    const SONG: &str = r#"
+#MaxEchoLength 240
+#EchoLength 240
+
+@1 sine
+
+A @1 o4 c
+"#;
+
+    let mut emu = song_test_emu(
+        SONG,
+        LoaderDataType {
+            skip_echo_buffer_reset: false,
+            ..LOADER_FLAGS
+        },
+    );
+
+    let esa = usize::from(emu.emu.dsp_registers()[S_DSP_ESA_REGISTER]);
+    let echo_buffer = esa << 8..0x10000;
+
+    emu.emu.apuram_mut()[echo_buffer.clone()].fill(0xaa);
+
+    let r = emu.emu.run_until_pc(
+        addresses::MAINLOOP_CODE,
+        ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+    );
+    assert!(r.hit, "audio driver did not start");
+
+    let apuram = emu.emu.apuram();
+    let not_cleared = echo_buffer.filter(|&a| apuram[a] != 0).count();
+    assert_eq!(not_cleared, 0, "echo buffer not cleared");
+}
+
+#[test]
+fn disabled_music_channels() {
+    const SONG: &str = r#"
+#Timer 64
+
+@1 sine
+
+A @1 o4 c%8
+B @1 o4 c%250
+"#;
+
+    let mut emu = song_test_emu(SONG, LOADER_FLAGS);
+
+    let r = emu.emu.run_ticks(
+        32,
+        addresses::PROCESS_MUSIC_CHANNELS_CODE,
+        ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+    );
+    assert!(r.hit, "music ticks not processed");
+
+    // Channel A has finished, channel B is still playing
+    let active = emu.emu.apuram()[usize::from(addresses::ACTIVE_MUSIC_CHANNELS)];
+    assert_eq!(active, 0b10, "activeMusicChannels mismatch");
+}
+
+#[test]
+fn vibrato_only_writes_pitch_registers() {
+    const SONG: &str = r#"
+#Timer 64
+
+@1 sine
+
+A @1 o4 ~40,4 c%250
+"#;
+
+    // S-DSP voice 0 registers (excluding ENVX and OUTX)
+    const VOICE_0_REGISTERS: u128 = 0xff;
+    // S-DSP voice 0 PITCH_L and PITCH_H registers
+    const PITCH_REGISTERS: u128 = 0b1100;
+
+    let mut emu = song_test_emu(SONG, LOADER_FLAGS);
+
+    let run_tick = |emu: &mut Emu| {
+        let r = emu.emu.run_ticks(
+            1,
+            addresses::PROCESS_MUSIC_CHANNELS_CODE,
+            ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+        );
+        assert!(r.hit, "music tick not processed");
+    };
+
+    // Play the note (vibrato starts on the tick after the play-note instruction)
+    for _ in 0..4 {
+        run_tick(&mut emu);
+    }
+
+    for _ in 0..16 {
+        emu.emu.take_dsp_register_changes();
+        run_tick(&mut emu);
+
+        let changes = emu.emu.take_dsp_register_changes() & VOICE_0_REGISTERS;
+        assert_eq!(
+            changes, PITCH_REGISTERS,
+            "vibrato wrote voice registers other than PITCH"
+        );
+    }
+}
+
+#[test]
+fn stack_usage() {
+    // MUST match `STACK_BOTTOM_ADDR` in `audio-driver/src/common_memmap.wiz`
+    const STACK_BOTTOM_ADDR: u16 = 0x1e0;
+
+    let mut emu = test_emu();
+
+    for s in [
+        Sfx::HighPriority,
+        Sfx::Interruptible,
+        Sfx::OneUninterruptible,
+        Sfx::LowPriority,
+    ] {
+        emu.play_sound_effect_command(s);
+        emu.emulate(2);
+    }
+    emu.pause_command();
+
+    let stack_min = emu.emu.stack_min();
+
+    // The lowest stack byte written is `$0101 + stack_min`
+    let lowest = 0x101 + u16::from(stack_min);
+    assert!(
+        lowest >= STACK_BOTTOM_ADDR,
+        "stack overflow, the audio driver pushed to ${lowest:04x}"
+    );
+}
+
 /// Audio driver emulator
+#[derive(Clone)]
 struct Emu {
     emu: ShvcSoundEmu,
     sfx_addrs: Vec<u16>,
@@ -404,15 +821,44 @@ struct Emu {
 }
 
 impl Emu {
-    const STEREO_FLAG: bool = true;
-
     pub fn new(common_audio_data: &CommonAudioData) -> Emu {
+        Self::load(
+            common_audio_data,
+            audio_driver::BLANK_SONG,
+            0xff,
+            0,
+            &LOADER_FLAGS,
+        )
+    }
+
+    pub fn with_song(
+        common_audio_data: &CommonAudioData,
+        song: &SongData,
+        loader_flags: &LoaderDataType,
+    ) -> Emu {
+        let echo_buffer = &song.metadata().echo_buffer;
+
+        Self::load(
+            common_audio_data,
+            song.data(),
+            echo_buffer.esa_register(),
+            echo_buffer.edl_register(),
+            loader_flags,
+        )
+    }
+
+    fn load(
+        common_audio_data: &CommonAudioData,
+        song_data: &[u8],
+        esa: u8,
+        edl: u8,
+        loader_flags: &LoaderDataType,
+    ) -> Emu {
         const LOADER_DATA_TYPE_ADDR: usize = addresses::LOADER_DATA_TYPE as usize;
 
         let mut emu = ShvcSoundEmu::new(&[0; 64]);
 
         let common_data = common_audio_data.data();
-        let song_data = audio_driver::BLANK_SONG;
         let song_data_addr = common_audio_data.song_data_addr();
 
         let apuram = emu.apuram_mut();
@@ -431,12 +877,7 @@ impl Emu {
         write_spc_ram(song_data_addr, song_data);
 
         // Set loader flags
-        apuram[LOADER_DATA_TYPE_ADDR] = LoaderDataType {
-            stereo_flag: Self::STEREO_FLAG,
-            play_song: true,
-            skip_echo_buffer_reset: true,
-        }
-        .driver_value();
+        apuram[LOADER_DATA_TYPE_ADDR] = loader_flags.driver_value();
 
         emu.reset(shvc_sound_emu::ResetRegisters {
             pc: addresses::DRIVER_CODE,
@@ -445,10 +886,13 @@ impl Emu {
             y: 0,
             psw: 0,
             sp: 0xff,
-            esa: 0xff,
-            edl: 0,
+            esa,
+            edl,
         });
 
+        // The tests only read the audio driver's variables
+        emu.set_logic_only(true);
+
         let mut sfx_addrs = common_audio_data.sound_effect_addresses();
         sfx_addrs.push(common_audio_data.sfx_bytecode_addr_range().end);
 
@@ -505,26 +949,40 @@ impl Emu {
         })
     }
 
+    pub fn song_tick_counter(&self) -> u16 {
+        const STC: usize = addresses::SONG_TICK_COUNTER as usize;
+
+        let apuram = self.emu.apuram();
+        u16::from_le_bytes([apuram[STC], apuram[STC + 1]])
+    }
+
+    /// Emulates `count` audio buffers of time, without outputting audio
     pub fn emulate(&mut self, count: usize) {
-        for _ in 0..count {
-            self.emu.emulate();
-        }
+        const CLOCKS_PER_BUFFER: u64 =
+            ShvcSoundEmu::AUDIO_BUFFER_SAMPLES as u64 * ShvcSoundEmu::SMP_CLOCKS_PER_SAMPLE;
+
+        self.emu.fast_forward(count as u64 * CLOCKS_PER_BUFFER);
     }
 
     fn is_io_command_acknowledged(&self) -> bool {
         self.emu.read_io_ports()[0] == self.previous_command
     }
 
-    fn emu_and_send_command(&mut self, command: u8, param1: u8, param2: u8) {
-        while !self.is_io_command_acknowledged() {
-            self.emu.emulate();
-        }
-
+    /// Writes an IO command to the IO ports without waiting for the acknowledgement
+    fn send_command(&mut self, command: u8, param1: u8, param2: u8) {
         let command =
             ((self.previous_command ^ u8::MAX) & IO_COMMAND_I_MASK) | (command & IO_COMMAND_MASK);
 
         self.emu.write_io_ports([command, param1, param2, 0]);
         self.previous_command = command;
+    }
+
+    fn emu_and_send_command(&mut self, command: u8, param1: u8, param2: u8) {
+        while !self.is_io_command_acknowledged() {
+            self.emu.emulate();
+        }
+
+        self.send_command(command, param1, param2);
 
         while !self.is_io_command_acknowledged() {
             self.emu.emulate();
@@ -551,10 +1009,36 @@ fn test_emu() -> Emu {
     Emu::new(cad)
 }
 
+/// Common audio data with the example project's instruments
+struct SongTestData {
+    instruments_and_samples: UniqueNamesList<InstrumentOrSample>,
+    samples: SampleAndInstrumentData,
+    common_audio_data: CommonAudioData,
+}
+
+/// Compiles and plays a song that uses the example project's instruments
+fn song_test_emu(mml: &str, loader_flags: LoaderDataType) -> Emu {
+    static LOCK: OnceLock<SongTestData> = OnceLock::new();
+    let d = LOCK.get_or_init(_build_song_test_data);
+
+    let song = compile_mml(
+        &TextFile {
+            contents: mml.to_owned(),
+            path: None,
+            file_name: "test_song".to_owned(),
+        },
+        None,
+        &d.instruments_and_samples,
+        d.samples.pitch_table(),
+    )
+    .unwrap();
+
+    Emu::with_song(&d.common_audio_data, &song, &loader_flags)
+}
+
 // Should only be called once
 fn _build_test_common_audio_data() -> CommonAudioData {
     let samples = combine_samples([].as_slice(), [].as_slice()).unwrap();
-    let pitch_table = samples.pitch_table();
 
     // Required to prevent a `ProjectFileErrors([InstrumentOrSample(Empty)])` error
     let dummy_instrument = Instrument {
@@ -574,9 +1058,33 @@ fn _build_test_common_audio_data() -> CommonAudioData {
         data::validate_instrument_and_sample_names([dummy_instrument].iter(), std::iter::empty())
             .unwrap();
 
+    _build_common_audio_data(&samples, &instruments_and_samples)
+}
+
+// Should only be called once
+fn _build_song_test_data() -> SongTestData {
+    let project = load_project_file(Path::new(EXAMPLE_PROJECT)).unwrap();
+    let project = validate_project_file_names(project).unwrap();
+
+    let samples = build_sample_and_instrument_data(&project).unwrap();
+    let common_audio_data = _build_common_audio_data(&samples, &project.instruments_and_samples);
+
+    SongTestData {
+        instruments_and_samples: project.instruments_and_samples,
+        samples,
+        common_audio_data,
+    }
+}
+
+fn _build_common_audio_data(
+    samples: &SampleAndInstrumentData,
+    instruments_and_samples: &UniqueNamesList<InstrumentOrSample>,
+) -> CommonAudioData {
+    let pitch_table = samples.pitch_table();
+
     let subroutines = compile_sfx_subroutines(
         &SfxSubroutinesMml(String::new()),
-        &instruments_and_samples,
+        instruments_and_samples,
         pitch_table,
     )
     .unwrap();
@@ -595,7 +1103,7 @@ fn _build_test_common_audio_data() -> CommonAudioData {
             };
             let compiled_sfx = compile_sound_effect_input(
                 &sfx,
-                &instruments_and_samples,
+                instruments_and_samples,
                 pitch_table,
                 &subroutines,
             )
@@ -622,5 +1130,5 @@ fn _build_test_common_audio_data() -> CommonAudioData {
 
     let sfx = combine_sound_effects(&sfx_map, &export_order, default_flags).unwrap();
 
-    build_common_audio_data(&samples, &subroutines, &sfx).unwrap()
+    build_common_audio_data(samples, &subroutines, &sfx).unwrap()
 }
@@ -1,11 +1,83 @@
 fn main() {
-    cxx_build::bridge("src/lib.rs")
+    let mut build = cxx_build::bridge("src/lib.rs");
+
+    build
         .file("src/shvc-sound-emu.cpp")
         .cpp(true)
         .std("c++17")
         .include("src")
-        .warnings(false)
-        .compile("cxx-apu");
+        .warnings(false);
+
+    // The runtime selected SIMD kernels (`simd-kernels.cpp`) must return the same results as the
+    // scalar reference, the compiler must not fuse the scalar multiplies and adds into FMAs.
+    build.flag_if_supported("-ffp-contract=off");
+
+    if std::env::var_os("CARGO_FEATURE_INSTRUMENTATION").is_none() {
+        build.define("SHVC_SOUND_EMU_NO_INSTRUMENTATION", None);
+    }
+
+    if std::env::var_os("CARGO_FEATURE_ACCESS_MAP").is_some() {
+        build.define("SHVC_SOUND_EMU_ACCESS_MAP", None);
+    }
+
+    if std::env::var_os("CARGO_FEATURE_SHARED_MEMORY").is_some() {
+        build.define("SHVC_SOUND_EMU_SHARED_MEMORY", None);
+
+        // `shm_open()` is in librt on older glibc releases
+        if std::env::var("CARGO_CFG_TARGET_OS").as_deref() == Ok("linux") {
+            println!("cargo:rustc-link-lib=rt");
+        }
+    }
+
+    if std::env::var_os("CARGO_FEATURE_GDB_SERVER").is_some() {
+        build.define("SHVC_SOUND_EMU_GDB_SERVER", None);
+
+        if std::env::var("CARGO_CFG_TARGET_OS").as_deref() == Ok("windows") {
+            println!("cargo:rustc-link-lib=ws2_32");
+        }
+    }
+
+    // Optional profile-guided optimization (GCC and Clang only), see the README.
+    //
+    // `SHVC_SOUND_EMU_PGO_GENERATE=DIR` builds an instrumented library that writes profiles to `DIR`.
+    // `SHVC_SOUND_EMU_PGO_USE=PATH` optimises the library with the profiles (a directory for GCC,
+    // a merged `.profdata` file for Clang).
+    println!("cargo:rerun-if-env-changed=SHVC_SOUND_EMU_PGO_GENERATE");
+    println!("cargo:rerun-if-env-changed=SHVC_SOUND_EMU_PGO_USE");
+
+    let pgo_generate = std::env::var("SHVC_SOUND_EMU_PGO_GENERATE")
+        .ok()
+        .filter(|s| !s.is_empty());
+    let pgo_use = std::env::var("SHVC_SOUND_EMU_PGO_USE")
+        .ok()
+        .filter(|s| !s.is_empty());
+
+    if pgo_generate.is_some() || pgo_use.is_some() {
+        let compiler = build.get_compiler();
+        let gcc = compiler.is_like_gnu();
+
+        if !gcc && !compiler.is_like_clang() {
+            println!("cargo:warning=profile-guided optimization requires GCC or Clang");
+        } else if let Some(dir) = pgo_generate {
+            build.flag(&format!("-fprofile-generate={dir}"));
+
+            // Clang's profile runtime is linked by rustc (`RUSTFLAGS=-Cprofile-generate=DIR`)
+            if gcc {
+                println!("cargo:rustc-link-lib=gcov");
+            }
+        } else if let Some(path) = pgo_use {
+            build.flag(&format!("-fprofile-use={path}"));
+
+            // The training workload does not run every function
+            if gcc {
+                build.flag("-fprofile-partial-training");
+                build.flag("-fprofile-correction");
+            }
+            println!("cargo:rerun-if-changed={path}");
+        }
+    }
+
+    build.compile("cxx-apu");
 
     println!("cargo:rerun-if-changed=src/")
 }
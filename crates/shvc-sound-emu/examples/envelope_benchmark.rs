@@ -0,0 +1,121 @@
+//! S-DSP envelope and noise counter microbenchmark
+//!
+//! Emulates a minute of audio with all 8 voices running ADSR or GAIN envelopes (at different
+//! rates) and noise, while the S-SMP idles in a branch loop, and prints the time taken.
+//!
+//! The envelope and noise rates are polled every sample by every voice, this benchmark is used to
+//! measure changes to the S-DSP rate counters.
+//!
+//! Run with `cargo run --release --example envelope_benchmark`.
+
+use shvc_sound_emu::{ResetRegisters, ShvcSoundEmu};
+
+use std::time::{Duration, Instant};
+
+const SECONDS_TO_EMULATE: u64 = 60;
+const ITERATIONS: usize = 5;
+
+const CODE_ADDR: u16 = 0x0200;
+const DIR_PAGE: u8 = 0x30;
+const BRR_ADDR: u16 = 0x3100;
+
+const FLG: u8 = 0x6c;
+const KON: u8 = 0x4c;
+const NON: u8 = 0x3d;
+const DIR: u8 = 0x5d;
+const MVOLL: u8 = 0x0c;
+const MVOLR: u8 = 0x1c;
+
+fn setup_emulator() -> ShvcSoundEmu {
+    let mut emu = ShvcSoundEmu::new(&[0; 64]);
+
+    let apuram = emu.apuram_mut();
+
+    // `bra $fe` (infinite loop)
+    let code_addr = usize::from(CODE_ADDR);
+    apuram[code_addr..code_addr + 2].copy_from_slice(&[0x2f, 0xfe]);
+
+    // Sample 0: a single looping BRR block
+    let dir_addr = usize::from(DIR_PAGE) << 8;
+    apuram[dir_addr..dir_addr + 2].copy_from_slice(&BRR_ADDR.to_le_bytes());
+    apuram[dir_addr + 2..dir_addr + 4].copy_from_slice(&BRR_ADDR.to_le_bytes());
+
+    let brr_addr = usize::from(BRR_ADDR);
+    apuram[brr_addr..brr_addr + 9]
+        .copy_from_slice(&[0xb3, 0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0]);
+
+    emu.reset(ResetRegisters {
+        pc: CODE_ADDR,
+        a: 0,
+        x: 0,
+        y: 0,
+        psw: 0,
+        sp: 0xff,
+        esa: 0xff,
+        edl: 0,
+    });
+
+    // Echo writes disabled, noise enabled
+    emu.write_dsp_register(FLG, 0x20 | 0x10);
+    emu.write_dsp_register(DIR, DIR_PAGE);
+    emu.write_dsp_register(MVOLL, 0x7f);
+    emu.write_dsp_register(MVOLR, 0x7f);
+
+    for v in 0..8u8 {
+        let base = v << 4;
+
+        emu.write_dsp_register(base | 0x0, 0x40);
+        emu.write_dsp_register(base | 0x1, 0x40);
+        emu.write_dsp_register(base | 0x2, 0x00);
+        emu.write_dsp_register(base | 0x3, 0x10);
+        emu.write_dsp_register(base | 0x4, 0);
+
+        if v < 6 {
+            // ADSR
+            emu.write_dsp_register(base | 0x5, 0x80 | ((v & 7) << 4) | (v + 8));
+            emu.write_dsp_register(base | 0x6, (v << 5) | (v * 5 + 1));
+        } else {
+            // GAIN (linear increase and exponential decrease)
+            emu.write_dsp_register(base | 0x5, 0x00);
+            emu.write_dsp_register(base | 0x7, if v == 6 { 0xc0 | 0x12 } else { 0xa0 | 0x1a });
+        }
+    }
+
+    emu.write_dsp_register(NON, 0x80);
+
+    emu
+}
+
+fn emulate(emu: &mut ShvcSoundEmu) {
+    let buffers_per_second = 32000 / ShvcSoundEmu::AUDIO_BUFFER_SAMPLES as u64;
+
+    for _ in 0..SECONDS_TO_EMULATE {
+        // Restart the envelopes every second
+        emu.write_dsp_register(KON, 0xff);
+
+        for _ in 0..buffers_per_second {
+            emu.emulate();
+        }
+    }
+}
+
+fn main() {
+    let mut best: Option<Duration> = None;
+
+    for i in 0..ITERATIONS {
+        let mut emu = setup_emulator();
+
+        let start = Instant::now();
+        emulate(&mut emu);
+        let elapsed = start.elapsed();
+
+        println!("Iteration {i}: {elapsed:?}");
+
+        best = Some(best.map_or(elapsed, |b| b.min(elapsed)));
+    }
+
+    if let Some(best) = best {
+        let per_second = best / SECONDS_TO_EMULATE as u32;
+        println!("Best: {best:?} ({per_second:?} per emulated second)");
+    }
+}
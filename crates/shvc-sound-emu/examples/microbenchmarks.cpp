@@ -0,0 +1,318 @@
+//S-DSP and SPC700 kernel microbenchmarks
+//
+//a standalone C++ program built from the same sources as the cxx-apu library (without Rust or
+//the cxx bridge), so kernel changes can be measured in isolation and profiled with perf.
+//
+//build and run from this directory with:
+//  g++ -std=c++17 -O2 -I../src microbenchmarks.cpp -o microbenchmarks && ./microbenchmarks
+//(add -fno-inline -g to profile each stage as a separate function)
+//
+//`./microbenchmarks <name>` only runs the benchmarks whose name contains <name>.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <nall/platform.hpp>
+#include <nall/endian.hpp>
+#include <nall/literals.hpp>
+#include <nall/memory.hpp>
+#include <nall/primitives.hpp>
+
+using namespace nall;
+using namespace nall::primitives;
+
+#include "types.hpp"
+#include "instrumentation.hpp"
+
+#include "sample-buffer.hpp"
+
+#include "spc700/spc700.hpp"
+#include "dsp/dsp.hpp"
+#include "smp/smp.hpp"
+
+#include "spc700/spc700.cpp"
+#include "smp/smp.cpp"
+#include "dsp/dsp.cpp"
+
+namespace shvc_sound_emu {
+
+//deterministic pseudo-random inputs (xorshift32)
+struct Random {
+  u32 state = 0x12345678;
+
+  auto operator()() -> u32 {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+};
+
+//the result of every benchmark is written here so the benchmarked code is not optimised out
+static volatile s64 sink;
+
+struct DSPMicrobenchmarks {
+  static constexpr u32 Iterations = 10'000'000;
+
+  //BRR blocks with every filter and a realistic range of scales, echo buffer at $8000
+  DSPMicrobenchmarks() {
+    dsp.power(false);
+
+    Random random;
+    for(auto& b : dsp.apuram) b = random();
+    for(u32 address = 0; address < 0x8000; address += 9) {
+      u8 header = dsp.apuram[address];
+      dsp.apuram[address] = (header & 0x0c) | (4 + (header >> 4) % 9) << 4;
+    }
+
+    dsp.write(0x6c, 0x00);  //FLG: echo writes enabled
+    dsp.write(0x6d, 0x80);  //ESA
+    dsp.write(0x7d, 0x04);  //EDL
+    dsp.write(0x0d, 0x40);  //EFB
+    dsp.write(0x2c, 0x30);  //EVOLL
+    dsp.write(0x3c, 0xd0);  //EVOLR
+    const u8 fir[8] = {0x0c, 0x21, 0x2b, 0x2b, 0x13, 0xfe, 0xf3, 0xf9};  //low-pass
+    for(u32 n : range(8)) dsp.write(n << 4 | 0x0f, fir[n]);
+    dsp.resetEchoBuffer();
+
+    //a mix of ADSR attack/decay/sustain, release and GAIN envelopes
+    for(u32 n : range(8)) {
+      auto& v = dsp.voice[n];
+      v.adsr0 = n < 5 ? 0x80 | n << 4 | (n * 3 + 1) : 0x00;
+      v.adsr1 = n << 5 | (n * 4 + 3);
+      v.gain = std::array<u8, 8>{0x40, 0x9c, 0xa8, 0xc0 | 0x12, 0xe0 | 0x1a, 0x8a, 0x7f, 0xdf}[n];
+      v.envelopeMode = n % 4;
+      v.envelope = n * 0xf0;
+    }
+  }
+
+  auto brrDecode() -> s64 {
+    auto& v = dsp.voice[0];
+    s64 sum = 0;
+    for(u32 i : range(Iterations)) {
+      v.brrAddress = (i * 9) & 0x7fff;
+      v.brrOffset = 1 + (i & 3) * 2;
+      dsp.brr._header = dsp.apuram[v.brrAddress];
+      dsp.brr._byte = dsp.apuram[n16(v.brrAddress + v.brrOffset)];
+      dsp.brrDecode(v);
+      sum += v.buffer[v.bufferOffset];
+    }
+    return sum;
+  }
+
+  //a looping 8 block sample, decoded in order with the voice's previous samples
+  auto brrDecodeLoop(bool cache) -> s64 {
+    auto& v = dsp.voice[0];
+    if(cache) dsp.brrCache.resize(DSP::BRRCacheSize);
+    for(auto& s : v.buffer) s = 0;
+    v.bufferOffset = 0;
+
+    s64 sum = 0;
+    for(u32 i : range(Iterations)) {
+      v.brrAddress = 0x1000 + (i >> 2 & 7) * 9;
+      v.brrOffset = 1 + (i & 3) * 2;
+      dsp.brr._header = dsp.apuram[v.brrAddress];
+      dsp.brr._byte = dsp.apuram[n16(v.brrAddress + v.brrOffset)];
+      dsp.brrDecode(v);
+      sum += v.buffer[v.bufferOffset];
+    }
+    dsp.brrCache = {};
+    return sum;
+  }
+
+  auto gaussianInterpolate() -> s64 {
+    auto& v = dsp.voice[0];
+    Random random;
+    for(u32 n : range(12)) v.buffer[n] = v.buffer[n + 12] = s16(random()) >> 1;
+
+    s64 sum = 0;
+    for(u32 i : range(Iterations)) {
+      v.gaussianOffset = (i * 0x0d37) & 0x7fff;
+      v.bufferOffset = i % 12;
+      sum += dsp.gaussianInterpolate(v);
+    }
+    return sum;
+  }
+
+  //one counter tick and eight envelope updates per sample, as in the S-DSP
+  auto envelopeRun() -> s64 {
+    s64 sum = 0;
+    for(u32 i : range(Iterations / 8)) {
+      (void)i;
+      dsp.counterTick();
+      for(auto& v : dsp.voice) {
+        dsp.latch.adsr0 = v.adsr0;
+        dsp.envelopeRun(v);
+        sum += v.envelope;
+      }
+    }
+    return sum;
+  }
+
+  //echo22() to echo30(), one sample per iteration
+  auto echo() -> s64 {
+    s64 sum = 0;
+    for(u32 i : range(Iterations / 8)) {
+      dsp.echo.input[0] = s16(i * 0x1357);
+      dsp.echo.input[1] = s16(i * 0x2468);
+      dsp.echo22();
+      dsp.echo23();
+      dsp.echo24();
+      dsp.echo25();
+      dsp.echo26();
+      dsp.echo27();
+      dsp.echo28();
+      dsp.echo29();
+      dsp.echo30();
+      sum += dsp.echo.output[0] + dsp.echo.output[1];
+    }
+    return sum;
+  }
+
+  //every stage of a sample, as run when the SMP does not access the DSP (eight voices playing)
+  auto mainSample() -> s64 {
+    for(u32 n : range(8)) {
+      dsp.write(n << 4 | 0x00, 0x60 - n * 0x10);  //VOLL
+      dsp.write(n << 4 | 0x01, 0x10 + n * 0x10);  //VOLR
+      dsp.write(n << 4 | 0x02, n * 0x31);         //PITCHL
+      dsp.write(n << 4 | 0x03, 0x04 + n);         //PITCHH
+    }
+    dsp.write(0x0c, 0x7f);  //MVOLL
+    dsp.write(0x1c, 0x7f);  //MVOLR
+    dsp.write(0x4d, 0xa5);  //EON
+    dsp.write(0x5d, 0x10);  //DIR
+    dsp.write(0x4c, 0xff);  //KON
+
+    s64 sum = 0;
+    for(u32 i : range(Iterations / 32)) {
+      (void)i;
+      dsp.sampleBuffer.reset();
+      dsp.mainSample();
+      sum += dsp.sampleBuffer.samples()[0];
+    }
+    return sum;
+  }
+
+  //echo() with a silent, write-protected echo buffer
+  //(modifies the echo buffer, run after echo())
+  auto echoIdle() -> s64 {
+    dsp.write(0x6c, 0x20);  //FLG: echo writes disabled
+    memory::fill<u8>(&dsp.apuram[0x8000], 0x800 * 4);
+    dsp.resetEchoBuffer();
+    return echo();
+  }
+
+  DSP dsp;
+};
+
+struct SPC700Microbenchmarks {
+  static constexpr u32 Iterations = 10'000'000;
+
+  //a loop of driver-like instructions: direct page and indexed accesses, ALU operations,
+  //S-DSP register writes and branches
+  SPC700Microbenchmarks() {
+    smp.iplrom = {};
+    smp.power(false);
+
+    const u8 code[] = {
+      0xcd, 0x00,        //$0200 mov x, #$00
+      0xf4, 0x20,        //$0202 mov a, $20+x
+      0x60,              //$0204 clrc
+      0x88, 0x13,        //$0205 adc a, #$13
+      0xd4, 0x20,        //$0207 mov $20+x, a
+      0x8f, 0x0c, 0xf2,  //$0209 mov $f2, #$0c
+      0xc4, 0xf3,        //$020c mov $f3, a
+      0x1c,              //$020e asl a
+      0x3d,              //$020f inc x
+      0xc8, 0x08,        //$0210 cmp x, #$08
+      0xd0, 0xee,        //$0212 bne $0202
+      0x5f, 0x00, 0x02,  //$0214 jmp $0200
+    };
+    memory::copy(&smp.dsp.apuram[0x0200], code, sizeof(code));
+
+    //zero page and stack writes, with DIR and ESA at their power-on value of $00 every one of
+    //them is to a page shared with the S-DSP (the sample directory is $0000-$03ff)
+    const u8 sharedPageCode[] = {
+      0xcd, 0x00,        //$0400 mov x, #$00
+      0xd4, 0x30,        //$0402 mov $30+x, a
+      0x2d,              //$0404 push a
+      0xae,              //$0405 pop a
+      0xbc,              //$0406 inc a
+      0xc4, 0x40,        //$0407 mov $40, a
+      0x3d,              //$0409 inc x
+      0xc8, 0x10,        //$040a cmp x, #$10
+      0xd0, 0xf4,        //$040c bne $0402
+      0x5f, 0x00, 0x04,  //$040e jmp $0400
+    };
+    memory::copy(&smp.dsp.apuram[0x0400], sharedPageCode, sizeof(sharedPageCode));
+    smp.r.s = 0xff;
+  }
+
+  //includes the bus, timer and S-DSP catch-up cost of each instruction
+  auto instruction() -> s64 {
+    return run(0x0200);
+  }
+
+  //includes the S-DSP synchronization and sharedPages cost of writes to shared pages
+  auto sharedPageWrites() -> s64 {
+    return run(0x0400);
+  }
+
+  auto run(u16 pc) -> s64 {
+    smp.r.pc.w = pc;
+    for(u32 i : range(Iterations)) {
+      (void)i;
+      smp.instruction();
+    }
+    return smp.clock();
+  }
+
+  SMP smp;
+};
+
+template<typename F>
+static auto benchmark(const char* filter, const char* name, u32 iterations, F&& f) -> void {
+  if(filter && !strstr(name, filter)) return;
+
+  auto start = std::chrono::steady_clock::now();
+  sink = f();
+  auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+
+  printf("%-20s %10u iterations %8.2f ns/iteration\n", name, iterations, elapsed.count() / iterations);
+}
+
+}
+
+auto main(int argc, char** argv) -> int {
+  using namespace shvc_sound_emu;
+
+  const char* filter = argc > 1 ? argv[1] : nullptr;
+
+  //the emulators are large, do not allocate them on the stack
+  auto dsp = std::make_unique<DSPMicrobenchmarks>();
+  auto spc700 = std::make_unique<SPC700Microbenchmarks>();
+
+  using D = DSPMicrobenchmarks;
+  benchmark(filter, "brrDecode", D::Iterations, [&] { return dsp->brrDecode(); });
+  benchmark(filter, "brrDecodeLoop", D::Iterations, [&] { return dsp->brrDecodeLoop(false); });
+  benchmark(filter, "brrDecodeLoopCached", D::Iterations, [&] { return dsp->brrDecodeLoop(true); });
+  benchmark(filter, "gaussianInterpolate", D::Iterations, [&] { return dsp->gaussianInterpolate(); });
+  benchmark(filter, "envelopeRun", D::Iterations, [&] { return dsp->envelopeRun(); });
+  benchmark(filter, "echo", D::Iterations / 8, [&] { return dsp->echo(); });
+  benchmark(filter, "echoIdle", D::Iterations / 8, [&] { return dsp->echoIdle(); });
+  benchmark(filter, "mainSample", D::Iterations / 32, [&] { return dsp->mainSample(); });
+
+  using S = SPC700Microbenchmarks;
+  benchmark(filter, "instruction", S::Iterations, [&] { return spc700->instruction(); });
+  benchmark(filter, "sharedPageWrites", S::Iterations, [&] { return spc700->sharedPageWrites(); });
+
+  return 0;
+}
@@ -0,0 +1,572 @@
+//headless scenario runner
+//
+//loads an Audio-RAM image (64 KiB), a .spc file or a `ShvcSoundEmu::save_state()` file and runs a
+//scenario file on a selectable emulator core, so performance issues and bugs can be reproduced
+//(and shared as two files) without tad-gui.
+//
+//tad-gui records its playback sessions as scenario files (see `crates/tad-gui/src/session_recorder.rs`),
+//a recording is replayed with `./scenario_runner DIR/initial.state DIR/session.scenario`.
+//
+//a standalone C++ program built from the same sources as the cxx-apu library (like
+//microbenchmarks.cpp).  build and run from this directory with:
+//  g++ -std=c++17 -O2 -I../src scenario_runner.cpp -o scenario_runner
+//  ./scenario_runner [--core reference|fast|instrumented] IMAGE SCENARIO
+//
+//cores:
+//  reference     `dsp.fastPaths` disabled, the S-DSP is stepped every cycle
+//  fast          the fast paths enabled (the default, same as tad-gui)
+//  instrumented  the fast paths and the profiler enabled, prints the S-SMP profile at the end
+//
+//scenario file, one command per line (numbers are decimal or 0x prefixed hex, # starts a comment):
+//  registers pc=N a=N x=N y=N psw=N sp=N  set the S-SMP registers (any subset)
+//  dsp ADDR VALUE                          write a S-DSP register
+//  ports P0 P1 P2 P3                       write the S-CPU to S-SMP IO ports
+//  at CLOCK ports P0 P1 P2 P3              schedule an IO port write at an S-SMP clock
+//  apuram ADDR BYTE...                     write bytes to Audio-RAM
+//  load-state FILE                         load a `ShvcSoundEmu::save_state()` file
+//  run CLOCKS                              emulate for CLOCKS S-SMP clocks
+//  run-until CLOCK                         emulate until the S-SMP clock (since the image was loaded)
+//  run-until-tick TICKS                    emulate until timer 0 has output TICKS times
+//  run-until-pc PC                         emulate until the S-SMP program counter is PC
+//  print                                   print the S-SMP clock, registers and IO ports
+//  dump-state FILE                         write the Audio-RAM, S-DSP and S-SMP registers as a .spc file
+//  dump-audio FILE                         write the audio emulated since the previous dump-audio (WAV)
+//  check-hash HASH                         fail if `ShvcSoundEmu::state_hash()` is not HASH
+//
+//S-SMP clocks are relative to the start of the image or the most recently loaded state.
+//the FILE of load-state is relative to the scenario file's directory.
+//the run commands output audio, and stop early if the S-SMP halts.
+//the run-until-tick and run-until-pc commands give up after 60 emulated seconds.
+//a raw Audio-RAM image starts at the reset vector ($fffe) with SP=$ff and every S-DSP register 0.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <nall/platform.hpp>
+#include <nall/endian.hpp>
+#include <nall/literals.hpp>
+#include <nall/memory.hpp>
+#include <nall/primitives.hpp>
+#include <nall/hash/crc64.hpp>
+
+using namespace nall;
+using namespace nall::primitives;
+
+#include "types.hpp"
+#include "instrumentation.hpp"
+
+#include "sample-buffer.hpp"
+
+#include "spc700/spc700.hpp"
+#include "dsp/dsp.hpp"
+#include "smp/smp.hpp"
+
+#include "spc700/spc700.cpp"
+#include "smp/smp.cpp"
+#include "dsp/dsp.cpp"
+
+namespace shvc_sound_emu {
+
+static constexpr u32 SampleRate = 32000;
+static constexpr u64 ClocksPerSample = 64;
+static constexpr u64 ClocksPerSecond = SampleRate * ClocksPerSample;
+
+//the run-until commands give up after this many S-SMP clocks
+static constexpr u64 RunUntilTimeout = 60 * ClocksPerSecond;
+
+//same as `ShvcSoundEmu` (the save state format is the Audio-RAM followed by `SMP::serialize()`)
+static constexpr u32 StateSignature = 0x53564853;
+static constexpr u32 StateVersion = 2;
+
+enum class Core { Reference, Fast, Instrumented };
+
+[[noreturn]] static auto fatal(const char* format, const char* argument = "") -> void {
+  fprintf(stderr, "error: ");
+  fprintf(stderr, format, argument);
+  fprintf(stderr, "\n");
+  exit(1);
+}
+
+static auto readFile(const char* path) -> std::vector<u8> {
+  FILE* f = fopen(path, "rb");
+  if(!f) fatal("cannot open %s", path);
+
+  std::vector<u8> data;
+  u8 buffer[4096];
+  while(size_t n = fread(buffer, 1, sizeof(buffer), f)) data.insert(data.end(), buffer, buffer + n);
+  fclose(f);
+  return data;
+}
+
+static auto writeFile(const std::string& path, const std::vector<u8>& data) -> void {
+  FILE* f = fopen(path.c_str(), "wb");
+  if(!f || fwrite(data.data(), 1, data.size(), f) != data.size()) fatal("cannot write %s", path.c_str());
+  fclose(f);
+}
+
+static auto append16(std::vector<u8>& out, u16 value) -> void {
+  out.push_back(value);
+  out.push_back(value >> 8);
+}
+
+static auto append32(std::vector<u8>& out, u32 value) -> void {
+  append16(out, value);
+  append16(out, value >> 16);
+}
+
+struct Runner {
+  Runner(Core core) : core(core) {
+    smp.power(false);
+    smp.dsp.fastPaths = core != Core::Reference;
+    smp.fastPathsChanged();
+    if(core == Core::Instrumented) {
+      if(!Instrumentation::enabled) fatal("the instrumented core requires a build with instrumentation");
+      smp.profile.assign(0x10000, 0);
+    }
+  }
+
+  auto load(const std::vector<u8>& image) -> void {
+    if(image.size() >= 4 && (image[0] | image[1] << 8 | image[2] << 16 | (u32)image[3] << 24) == StateSignature) {
+      if(!loadState(image)) fatal("unsupported save state (wrong size or version)");
+      return;
+    }
+
+    //same as ShvcSoundEmu::load_spc()
+    constexpr size_t RAM_OFFSET = 0x100;
+    constexpr size_t DSP_OFFSET = 0x10100;
+    constexpr size_t IPLRAM_OFFSET = 0x101c0;
+    static const char SIGNATURE[] = "SNES-SPC700 Sound File Data";
+
+    auto& apuram = smp.dsp.apuram;
+
+    if(image.size() >= DSP_OFFSET + 0x80 && memory::compare(image.data(), SIGNATURE, sizeof(SIGNATURE) - 1) == 0) {
+      const u8* header = image.data();
+      const u8* ram = image.data() + RAM_OFFSET;
+
+      memory::copy(apuram.data(), ram, apuram.size());
+      if((ram[0xf1] & 0x80) && image.size() >= IPLRAM_OFFSET + 0x40) {
+        memory::copy(&apuram[0xffc0], image.data() + IPLRAM_OFFSET, 0x40);
+      }
+
+      smp.r.pc.byte.l = header[0x25];
+      smp.r.pc.byte.h = header[0x26];
+      smp.r.ya.byte.l = header[0x27];
+      smp.r.x = header[0x28];
+      smp.r.ya.byte.h = header[0x29];
+      smp.r.p = header[0x2a];
+      smp.r.s = header[0x2b];
+
+      std::array<uint8_t, 128> dspRegisters;
+      memory::copy(dspRegisters.data(), image.data() + DSP_OFFSET, dspRegisters.size());
+      smp.dsp.loadRegisters(dspRegisters);
+      smp.dsp.resetEchoBuffer();
+
+      smp.loadIO(ram + 0xf0);
+      portWrites.push_back({0, {ram[0xf4], ram[0xf5], ram[0xf6], ram[0xf7]}});
+    } else if(image.size() == apuram.size()) {
+      memory::copy(apuram.data(), image.data(), apuram.size());
+      smp.r.pc.w = apuram[0xfffe] | apuram[0xffff] << 8;
+      smp.r.s = 0xff;
+      portWrites.push_back({0, {}});
+    } else {
+      fatal("the image is not a .spc file or a 64 KiB Audio-RAM image");
+    }
+
+    smp.dsp.dirtyPages.fill(true);
+    smp.dsp.updateSharedPages();
+    smp.synchronizeDSP();
+    startClock = smp.clock();
+  }
+
+  auto serializeState(serializer& s) -> void {
+    u32 signature = StateSignature;
+    u32 version = StateVersion;
+    s(signature);
+    s(version);
+    for(auto& byte : smp.dsp.apuram) s(byte);
+    smp.serialize(s);
+  }
+
+  //same as ShvcSoundEmu::load_state(), returns false if the state is not supported
+  auto loadState(const std::vector<u8>& state) -> bool {
+    serializer size;
+    serializeState(size);
+    if(state.size() != size.size()) return false;
+
+    serializer s(state.data(), state.size());
+    u32 signature = 0;
+    u32 version = 0;
+    s(signature);
+    s(version);
+    if(signature != StateSignature || version != StateVersion) return false;
+
+    previousClocks = emulatedClocks();
+
+    for(auto& byte : smp.dsp.apuram) s(byte);
+    smp.serialize(s);
+
+    smp.dsp.dirtyPages.fill(true);
+    smp.dsp.changedRegisters.fill(0xff);
+    smp.dsp.updateSharedPages();
+
+    //the save state does not contain the scheduled IO port writes
+    smp.clearScheduledPortWrites();
+    portWrites.clear();
+    portWrites.push_back({smp.clock(), {}});
+    for(u32 n : range(4)) portWrites.back().ports[n] = smp.portWritten(n);
+
+    startClock = smp.clock();
+    return true;
+  }
+
+  //same as ShvcSoundEmu::state_hash() (after the S-DSP has been synchronized)
+  auto stateHash() -> u64 {
+    smp.synchronizeDSP();
+    smp.synchronizeTimers();
+
+    serializer s;
+    serializeState(s);
+    return Hash::CRC64({s.data(), s.size()}).value();
+  }
+
+  //S-SMP clocks emulated since the first image was loaded
+  auto emulatedClocks() const -> u64 {
+    return previousClocks + smp.clock() - startClock;
+  }
+
+  //writes the S-CPU to S-SMP IO ports now or at a later S-SMP clock
+  auto writePorts(u64 clock, const std::array<u8, 4>& ports) -> void {
+    if(clock <= smp.clock()) {
+      clock = smp.clock();
+      for(u32 n : range(4)) smp.portWrite(n, ports[n]);
+    } else {
+      smp.schedulePortWrite(clock, ports);
+    }
+
+    auto it = std::upper_bound(portWrites.begin(), portWrites.end(), clock, [](u64 c, const auto& w) { return c < w.clock; });
+    portWrites.insert(it, {clock, ports});
+  }
+
+  //the S-CPU to S-SMP IO ports (the S-SMP cannot read them without side effects)
+  auto inputPorts() const -> std::array<u8, 4> {
+    auto it = std::upper_bound(portWrites.begin(), portWrites.end(), smp.clock(), [](u64 c, const auto& w) { return c < w.clock; });
+    return std::prev(it)->ports;
+  }
+
+  //emulates until `until` (S-SMP clock) or done() returns true, appending the audio to `audio`
+  //(idle loops are only skipped if `done` is empty)
+  auto run(u64 until, const std::function<bool()>& done = {}) -> void {
+    constexpr size_t ChunkFrames = 4096;
+    auto& buffer = smp.dsp.sampleBuffer;
+    std::array<int16_t, ChunkFrames * 2> chunk;
+
+    smp.synchronizeDSP();
+    smp.dsp.updateSharedPages();
+    smp.resetIdleLoop();
+
+    auto finished = [&] { return smp.clock() >= until || smp.halted() || (done && done()); };
+
+    while(!finished()) {
+      buffer.reset(chunk.data(), ChunkFrames);
+      while(!buffer.isFull() && !finished()) {
+        smp.idleLoopSkipUntil = !done && buffer.space() > 2 * SMP::DSPBatchSamples ? until : 0;
+        smp.main();
+        if(buffer.space() <= SMP::DSPBatchSamples) smp.synchronizeDSP();
+      }
+      smp.idleLoopSkipUntil = 0;
+      smp.synchronizeDSP();
+
+      const size_t frames = ChunkFrames - buffer.space();
+      audio.insert(audio.end(), chunk.begin(), chunk.begin() + frames * 2);
+      buffer.reset(chunk.data(), 0);
+    }
+  }
+
+  auto print() -> void {
+    const auto in = inputPorts();
+    printf("clock %llu  PC=$%04x A=$%02x X=$%02x Y=$%02x SP=$%02x PSW=$%02x  timer 0 ticks %llu"
+           "  ports in %02x %02x %02x %02x out %02x %02x %02x %02x%s\n",
+           (unsigned long long)(smp.clock() - startClock), (u32)smp.r.pc.w, (u32)smp.r.ya.byte.l, (u32)smp.r.x,
+           (u32)smp.r.ya.byte.h, (u32)smp.r.s, (u32)smp.r.p, (unsigned long long)smp.timer0Outputs(),
+           in[0], in[1], in[2], in[3],
+           (u32)smp.portRead(0), (u32)smp.portRead(1), (u32)smp.portRead(2), (u32)smp.portRead(3),
+           smp.halted() ? "  (halted)" : "");
+  }
+
+  //the IO registers are stored as the values last written to them (IO writes also write Audio-RAM),
+  //except the IO ports, which are stored as the S-CPU to S-SMP ports (as the S-SMP reads them)
+  auto dumpState(const std::string& path) -> void {
+    static const char SIGNATURE[] = "SNES-SPC700 Sound File Data v0.30";
+    smp.synchronizeDSP();
+
+    std::vector<u8> out(0x10200, 0);
+    memory::copy(out.data(), SIGNATURE, sizeof(SIGNATURE) - 1);
+    out[0x21] = 0x1a;
+    out[0x22] = 0x1a;
+    out[0x23] = 0x1b;  //no ID666 tag
+    out[0x24] = 30;
+    out[0x25] = smp.r.pc.byte.l;
+    out[0x26] = smp.r.pc.byte.h;
+    out[0x27] = smp.r.ya.byte.l;
+    out[0x28] = smp.r.x;
+    out[0x29] = smp.r.ya.byte.h;
+    out[0x2a] = (u32)smp.r.p;
+    out[0x2b] = smp.r.s;
+    memory::copy(&out[0x100], smp.dsp.apuram.data(), 0x10000);
+    memory::copy(&out[0x10100], smp.dsp.registers.data(), 128);
+    memory::copy(&out[0x101c0], &smp.dsp.apuram[0xffc0], 0x40);
+    const auto in = inputPorts();
+    memory::copy(&out[0x100 + 0xf4], in.data(), in.size());
+
+    writeFile(path, out);
+  }
+
+  auto dumpAudio(const std::string& path) -> void {
+    std::vector<u8> out;
+    const u32 dataSize = audio.size() * 2;
+
+    out.insert(out.end(), {'R', 'I', 'F', 'F'});
+    append32(out, 36 + dataSize);
+    out.insert(out.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+    append32(out, 16);
+    append16(out, 1);  //PCM
+    append16(out, 2);
+    append32(out, SampleRate);
+    append32(out, SampleRate * 4);
+    append16(out, 4);
+    append16(out, 16);
+    out.insert(out.end(), {'d', 'a', 't', 'a'});
+    append32(out, dataSize);
+    for(auto s : audio) append16(out, s);
+
+    writeFile(path, out);
+    audio.clear();
+  }
+
+  auto writeApuram(u16 address, const std::vector<u8>& data) -> void {
+    //same as ShvcSoundEmu::apply_batch()
+    memory::copy(&smp.dsp.apuram[address], data.data(), data.size());
+    for(u32 page = address >> 8; page <= (address + data.size() - 1) >> 8; page++) {
+      smp.dsp.dirtyPages[page] = true;
+    }
+  }
+
+  auto printProfile() -> void {
+    constexpr u32 Entries = 16;
+
+    std::vector<u32> pcs;
+    for(u32 pc : range(smp.profile.size())) {
+      if(smp.profile[pc]) pcs.push_back(pc);
+    }
+    std::sort(pcs.begin(), pcs.end(), [&](u32 a, u32 b) { return smp.profile[a] > smp.profile[b]; });
+
+    u64 total = 0;
+    for(auto c : smp.profile) total += c;
+
+    printf("S-SMP profile (clocks spent at each instruction):\n");
+    for(u32 i : range(std::min<size_t>(pcs.size(), Entries))) {
+      const u32 pc = pcs[i];
+      printf("  $%04x %12llu %6.2f%%\n", pc, (unsigned long long)smp.profile[pc], 100.0 * smp.profile[pc] / total);
+    }
+  }
+
+  struct PortWrite {
+    u64 clock;
+    std::array<u8, 4> ports;
+  };
+
+  Core core;
+  SMP smp;
+  u64 startClock = 0;
+  u64 previousClocks = 0;  //emulated before `startClock`
+  std::vector<PortWrite> portWrites;  //sorted by clock
+  std::vector<int16_t> audio;
+};
+
+struct Scenario {
+  Scenario(Runner& runner, const char* path) : runner(runner), path(path) {}
+
+  auto run(const std::vector<u8>& text) -> void {
+    std::string line;
+    for(size_t i = 0; i <= text.size(); i++) {
+      if(i == text.size() || text[i] == '\n') {
+        lineNumber++;
+        command(line);
+        line.clear();
+      } else {
+        line.push_back(text[i]);
+      }
+    }
+  }
+
+private:
+  [[noreturn]] auto error(const char* message) -> void {
+    fprintf(stderr, "%s:%u: %s\n", path, lineNumber, message);
+    exit(1);
+  }
+
+  //`file` relative to the directory of the scenario file
+  auto relativePath(const std::string& file) const -> std::string {
+    const std::string scenario = path;
+    const size_t slash = scenario.find_last_of("/\\");
+    if(slash == std::string::npos || file.empty() || file[0] == '/') return file;
+    return scenario.substr(0, slash + 1) + file;
+  }
+
+  auto number(const std::string& s, u64 max) -> u64 {
+    char* end = nullptr;
+    errno = 0;
+    u64 n = strtoull(s.c_str(), &end, 0);
+    if(s.empty() || *end || errno || n > max) error("invalid number");
+    return n;
+  }
+
+  auto command(std::string line) -> void {
+    line = line.substr(0, line.find('#'));
+
+    std::vector<std::string> args;
+    size_t p = 0;
+    while((p = line.find_first_not_of(" \t\r", p)) != std::string::npos) {
+      size_t e = line.find_first_of(" \t\r", p);
+      args.push_back(line.substr(p, e - p));
+      p = e;
+    }
+    if(args.empty()) return;
+
+    auto& smp = runner.smp;
+    const std::string& c = args[0];
+    auto expect = [&](size_t n) { if(args.size() != n + 1) error("wrong number of arguments"); };
+
+    auto ports = [&](size_t first) {
+      std::array<u8, 4> ports;
+      for(u32 n : range(4)) ports[n] = number(args[first + n], 0xff);
+      return ports;
+    };
+
+    if(c == "registers") {
+      for(size_t i = 1; i < args.size(); i++) {
+        const size_t eq = args[i].find('=');
+        if(eq == std::string::npos) error("expected REGISTER=VALUE");
+        const std::string name = args[i].substr(0, eq);
+        const std::string value = args[i].substr(eq + 1);
+
+        if(name == "pc") smp.r.pc.w = number(value, 0xffff);
+        else if(name == "a") smp.r.ya.byte.l = number(value, 0xff);
+        else if(name == "x") smp.r.x = number(value, 0xff);
+        else if(name == "y") smp.r.ya.byte.h = number(value, 0xff);
+        else if(name == "psw") smp.r.p = number(value, 0xff);
+        else if(name == "sp") smp.r.s = number(value, 0xff);
+        else error("unknown register");
+      }
+    } else if(c == "dsp") {
+      expect(2);
+      smp.synchronizeDSP();
+      smp.dsp.write(number(args[1], 0x7f), number(args[2], 0xff));
+    } else if(c == "ports") {
+      expect(4);
+      runner.writePorts(smp.clock(), ports(1));
+    } else if(c == "at") {
+      if(args.size() != 7 || args[2] != "ports") error("expected: at CLOCK ports P0 P1 P2 P3");
+      runner.writePorts(runner.startClock + number(args[1], ~0ull >> 1), ports(3));
+    } else if(c == "apuram") {
+      if(args.size() < 3) error("expected: apuram ADDR BYTE...");
+      const u16 address = number(args[1], 0xffff);
+      if(args.size() - 2 > 0x10000 - size_t(address)) error("the data does not fit in Audio-RAM");
+      std::vector<u8> data;
+      for(size_t i = 2; i < args.size(); i++) data.push_back(number(args[i], 0xff));
+      runner.writeApuram(address, data);
+    } else if(c == "load-state") {
+      expect(1);
+      if(!runner.loadState(readFile(relativePath(args[1]).c_str()))) error("unsupported save state (wrong size or version)");
+    } else if(c == "run") {
+      expect(1);
+      runner.run(smp.clock() + number(args[1], ~0ull >> 1));
+    } else if(c == "run-until") {
+      expect(1);
+      runner.run(runner.startClock + number(args[1], ~0ull >> 1));
+    } else if(c == "run-until-tick") {
+      expect(1);
+      const u64 ticks = number(args[1], ~0ull >> 1);
+      runner.run(smp.clock() + RunUntilTimeout, [&] { return smp.timer0Outputs() >= ticks; });
+      if(smp.timer0Outputs() < ticks) error("timer 0 did not reach the tick");
+    } else if(c == "run-until-pc") {
+      expect(1);
+      const u16 pc = number(args[1], 0xffff);
+      runner.run(smp.clock() + RunUntilTimeout, [&] { return smp.r.pc.w == pc; });
+      if(smp.r.pc.w != pc) error("the program counter did not reach the address");
+    } else if(c == "print") {
+      expect(0);
+      runner.print();
+    } else if(c == "dump-state") {
+      expect(1);
+      runner.dumpState(args[1]);
+    } else if(c == "dump-audio") {
+      expect(1);
+      runner.dumpAudio(args[1]);
+    } else if(c == "check-hash") {
+      expect(1);
+      const u64 hash = runner.stateHash();
+      if(hash != number(args[1], ~0ull)) {
+        fprintf(stderr, "%s:%u: state hash mismatch, expected %s got 0x%016llx\n", path, lineNumber, args[1].c_str(), (unsigned long long)hash);
+        exit(1);
+      }
+    } else {
+      error("unknown command");
+    }
+  }
+
+  Runner& runner;
+  const char* path;
+  u32 lineNumber = 0;
+};
+
+}
+
+auto main(int argc, char** argv) -> int {
+  using namespace shvc_sound_emu;
+
+  Core core = Core::Fast;
+  std::vector<const char*> paths;
+
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--core") == 0 && i + 1 < argc) {
+      const char* name = argv[++i];
+      if(strcmp(name, "reference") == 0) core = Core::Reference;
+      else if(strcmp(name, "fast") == 0) core = Core::Fast;
+      else if(strcmp(name, "instrumented") == 0) core = Core::Instrumented;
+      else fatal("unknown core: %s", name);
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if(paths.size() != 2) fatal("expected arguments: [--core reference|fast|instrumented] IMAGE SCENARIO");
+
+  //the emulator is large, do not allocate it on the stack
+  auto runner = std::make_unique<Runner>(core);
+  runner->load(readFile(paths[0]));
+
+  Scenario scenario(*runner, paths[1]);
+
+  auto start = std::chrono::steady_clock::now();
+  scenario.run(readFile(paths[1]));
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  const double emulated = double(runner->emulatedClocks()) / ClocksPerSecond;
+  printf("emulated %.3f seconds in %.3f seconds (%.1fx real time)\n", emulated, elapsed, emulated / elapsed);
+
+  if(core == Core::Instrumented) runner->printProfile();
+
+  return 0;
+}
@@ -0,0 +1,220 @@
+//S-SMP fast path differential fuzzer
+//
+//runs random instruction streams from random Audio-RAM, S-SMP and S-DSP register states on two
+//S-SMPs: the reference (`dsp.fastPaths` disabled, the DSP is synchronized after every
+//instruction) and the fast paths (memory map, batched DSP synchronization, idle loop skipping).
+//the registers, clock, Audio-RAM and DSP registers are compared after every instruction.
+//
+//a standalone C++ program built from the same sources as the cxx-apu library (like
+//microbenchmarks.cpp).  build and run from this directory with:
+//  g++ -std=c++17 -O2 -I../src spc700_fuzzer.cpp -o spc700_fuzzer && ./spc700_fuzzer [iterations]
+//or as a libFuzzer target with:
+//  clang++ -std=c++17 -O1 -g -fsanitize=fuzzer,address -DLIBFUZZER -I../src spc700_fuzzer.cpp -o spc700_fuzzer
+//
+//a mismatch prints the instruction and the first difference, then aborts.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <nall/platform.hpp>
+#include <nall/endian.hpp>
+#include <nall/literals.hpp>
+#include <nall/memory.hpp>
+#include <nall/primitives.hpp>
+
+using namespace nall;
+using namespace nall::primitives;
+
+#include "types.hpp"
+#include "instrumentation.hpp"
+
+#include "sample-buffer.hpp"
+
+#include "spc700/spc700.hpp"
+#include "dsp/dsp.hpp"
+#include "smp/smp.hpp"
+
+#include "spc700/spc700.cpp"
+#include "smp/smp.cpp"
+#include "dsp/dsp.cpp"
+
+namespace shvc_sound_emu {
+
+//xorshift32
+struct Random {
+  u32 state;
+
+  auto operator()() -> u32 {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+};
+
+struct Fuzzer {
+  //instructions executed per input
+  static constexpr u32 Instructions = 2000;
+  //length of the idle loop skip test at the end of each input
+  static constexpr u64 IdleLoopClocks = 64 * 1024;
+
+  //input layout:
+  //  0-6: A, X, Y, S, PSW, PC (little endian)
+  //  7:   bit 0 = randomise the S-DSP registers
+  //  8-:  code (copied to PC), the rest of Audio-RAM is filled from a hash of the input
+  auto run(const u8* data, size_t size) -> void {
+    if(size < 8) return;
+
+    u32 hash = 0x811c9dc5;
+    for(auto i : range(size)) hash = (hash ^ data[i]) * 0x01000193;
+    //new S-SMPs for every input, as power() does not reset the S-DSP counter or sample parity.
+    //both start with the same random state
+    reference = std::make_unique<SMP>();
+    fast = std::make_unique<SMP>();
+    const Random random{hash | 1};
+    setup(*reference, false, data, size, random);
+    setup(*fast, true, data, size, random);
+
+    for(auto i : range(Instructions)) {
+      (void)i;
+      if(reference->halted()) break;
+
+      const u16 pc = reference->r.pc.w;
+      const u8 opcode = reference->dsp.apuram[pc];
+
+      reference->main();
+      fast->main();
+      reference->synchronizeDSP();
+      fast->synchronizeDSP();
+
+      compare(pc, opcode);
+    }
+
+    //skipped idle loop iterations must leave the S-SMP in the state it would be in had they
+    //been executed (the loop above does not skip, `idleLoopSkipUntil` is 0)
+    if(!reference->halted()) {
+      fast->idleLoopSkipUntil = fast->clock() + IdleLoopClocks;
+      while(fast->clock() < fast->idleLoopSkipUntil && !fast->halted()) fast->main();
+      fast->idleLoopSkipUntil = 0;
+
+      while(reference->clock() < fast->clock() && !reference->halted()) reference->main();
+      if(reference->halted() || fast->halted()) return;
+
+      reference->synchronizeDSP();
+      fast->synchronizeDSP();
+      compare(fast->r.pc.w, 0);
+    }
+  }
+
+private:
+  static auto setup(SMP& smp, bool fastPaths, const u8* data, size_t size, Random random) -> void {
+    smp.iplrom = {};
+    smp.dsp.fastPaths = fastPaths;
+    smp.power(false);
+
+    for(auto& b : smp.dsp.apuram) b = random();
+
+    const u16 pc = data[5] | data[6] << 8;
+    for(auto i : range(size - 8)) smp.dsp.apuram[(u16)(pc + i)] = data[8 + i];
+
+    if(data[7] & 1) {
+      for(auto a : range(128)) {
+        //FLG soft reset and mute are cleared so the voices and echo buffer are active
+        u8 value = random();
+        if(a == 0x6c) value &= 0x1f;
+        smp.dsp.write(a, value);
+      }
+    }
+
+    smp.r.ya.byte.l = data[0];
+    smp.r.x = data[1];
+    smp.r.ya.byte.h = data[2];
+    smp.r.s = data[3];
+    smp.r.p = data[4];
+    smp.r.pc.w = pc;
+
+    smp.fastPathsChanged();
+    smp.dsp.updateSharedPages();
+    smp.resetIdleLoop();
+  }
+
+  auto compare(u16 pc, u8 opcode) -> void {
+    auto fail = [&](const char* what, u32 r, u32 f) {
+      fprintf(stderr, "fast path mismatch after $%04x (opcode $%02x): %s reference=$%x fast=$%x\n",
+              pc, opcode, what, r, f);
+      abort();
+    };
+
+    if(reference->clock() != fast->clock()) fail("clock", reference->clock(), fast->clock());
+    if(reference->r.pc.w != fast->r.pc.w) fail("PC", reference->r.pc.w, fast->r.pc.w);
+    if(reference->r.ya.w != fast->r.ya.w) fail("YA", reference->r.ya.w, fast->r.ya.w);
+    if(reference->r.x != fast->r.x) fail("X", reference->r.x, fast->r.x);
+    if(reference->r.s != fast->r.s) fail("S", reference->r.s, fast->r.s);
+    if((u32)reference->r.p != (u32)fast->r.p) fail("PSW", (u32)reference->r.p, (u32)fast->r.p);
+    if(reference->halted() != fast->halted()) fail("halted", reference->halted(), fast->halted());
+    if(reference->timer0Outputs() != fast->timer0Outputs()) {
+      fail("timer 0 outputs", reference->timer0Outputs(), fast->timer0Outputs());
+    }
+
+    if(memory::compare(reference->dsp.apuram.data(), fast->dsp.apuram.data(), 0x10000)) {
+      for(auto a : range(0x10000)) {
+        if(reference->dsp.apuram[a] != fast->dsp.apuram[a]) {
+          fprintf(stderr, "(Audio-RAM $%04x)\n", (u32)a);
+          fail("Audio-RAM", reference->dsp.apuram[a], fast->dsp.apuram[a]);
+        }
+      }
+    }
+    for(auto a : range(128)) {
+      if(reference->dsp.registers[a] != fast->dsp.registers[a]) {
+        fprintf(stderr, "(S-DSP register $%02x)\n", (u32)a);
+        fail("S-DSP register", reference->dsp.registers[a], fast->dsp.registers[a]);
+      }
+    }
+  }
+
+  std::unique_ptr<SMP> reference;
+  std::unique_ptr<SMP> fast;
+};
+
+}
+
+#if defined(LIBFUZZER)
+
+extern "C" auto LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) -> int {
+  static auto fuzzer = std::make_unique<shvc_sound_emu::Fuzzer>();
+  fuzzer->run(data, size);
+  return 0;
+}
+
+#else
+
+auto main(int argc, char** argv) -> int {
+  using namespace shvc_sound_emu;
+
+  const u32 iterations = argc > 1 ? atoi(argv[1]) : 1'000;
+
+  auto fuzzer = std::make_unique<Fuzzer>();
+  Random random{0x12345678};
+  std::vector<u8> input;
+
+  for(auto i : range(iterations)) {
+    input.resize(8 + random() % 512);
+    for(auto& b : input) b = random();
+    fuzzer->run(input.data(), input.size());
+
+    if((i + 1) % 1000 == 0) printf("%u inputs\n", (u32)i + 1);
+  }
+
+  printf("no mismatches in %u inputs\n", iterations);
+  return 0;
+}
+
+#endif
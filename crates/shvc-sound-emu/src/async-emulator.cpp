@@ -0,0 +1,221 @@
+namespace shvc_sound_emu {
+
+struct AsyncEmulator::Command {
+  Op op = Op::Reset;
+  uint16_t address = 0;
+  uint64_t frames = 0;
+  std::array<uint8_t, 4> ports = {};
+  ResetRegisters registers = {};
+  std::vector<uint8_t> data;
+};
+
+struct AsyncEmulator::Output {
+  uint64_t ticket = 0;
+  bool ok = true;
+  std::vector<int16_t> samples;
+  std::vector<uint8_t> state;
+};
+
+auto new_async_emulator(const std::array<uint8_t, 64>& iplrom) -> std::unique_ptr<AsyncEmulator>
+{
+  return std::make_unique<AsyncEmulator>(iplrom);
+}
+
+AsyncEmulator::AsyncEmulator(const std::array<uint8_t, 64>& iplrom)
+  : emu(iplrom), queue(std::make_unique<Command[]>(QueueSize))
+{
+  thread = std::thread([this] { worker(); });
+}
+
+AsyncEmulator::~AsyncEmulator() {
+  quit = true;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+  }
+  pushed.notify_one();
+  thread.join();
+}
+
+auto AsyncEmulator::load_apuram(uint16_t address, rust::Slice<const uint8_t> data) -> uint64_t {
+  Command c;
+  c.address = address;
+  c.data.assign(data.begin(), data.end());
+  return push(Op::LoadApuram, std::move(c));
+}
+
+auto AsyncEmulator::load_state(rust::Slice<const uint8_t> state) -> uint64_t {
+  Command c;
+  c.data.assign(state.begin(), state.end());
+  return push(Op::LoadState, std::move(c));
+}
+
+auto AsyncEmulator::reset(ResetRegisters r) -> uint64_t {
+  Command c;
+  c.registers = r;
+  return push(Op::Reset, std::move(c));
+}
+
+auto AsyncEmulator::write_io_ports(std::array<uint8_t, 4> ports) -> uint64_t {
+  Command c;
+  c.ports = ports;
+  return push(Op::WriteIoPorts, std::move(c));
+}
+
+auto AsyncEmulator::render(size_t frames) -> uint64_t {
+  Command c;
+  c.frames = frames;
+  return push(Op::Render, std::move(c));
+}
+
+auto AsyncEmulator::snapshot() -> uint64_t {
+  return push(Op::Snapshot, {});
+}
+
+auto AsyncEmulator::completed() const -> uint64_t {
+  return head.load(std::memory_order_acquire);
+}
+
+auto AsyncEmulator::wait(uint64_t ticket) -> void {
+  // Commands that have not been pushed never complete
+  if(ticket >= tail.load(std::memory_order_relaxed)) return;
+  if(head.load(std::memory_order_acquire) > ticket) return;
+
+  // `hostWaiting` and `head` are sequentially consistent, either the worker sees `hostWaiting`
+  // or the predicate sees the completed command.
+  hostWaiting = true;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    processed.wait(lock, [&] { return head.load() > ticket; });
+  }
+  hostWaiting = false;
+}
+
+auto AsyncEmulator::take_result(AsyncEmulatorResult& out) -> bool {
+  std::unique_ptr<Output> o;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(outputs.empty()) return false;
+    o = std::move(outputs.front());
+    outputs.pop_front();
+  }
+
+  out.ticket = o->ticket;
+  out.ok = o->ok;
+
+  out.samples.clear();
+  out.samples.reserve(o->samples.size());
+  for(auto s : o->samples) out.samples.push_back(s);
+
+  out.state.clear();
+  out.state.reserve(o->state.size());
+  for(auto b : o->state) out.state.push_back(b);
+
+  return true;
+}
+
+auto AsyncEmulator::push(Op op, Command&& command) -> uint64_t {
+  const uint64_t t = tail.load(std::memory_order_relaxed);
+
+  // Wait for a free slot
+  if(t - head.load(std::memory_order_acquire) >= QueueSize) {
+    hostWaiting = true;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      processed.wait(lock, [&] { return t - head.load() < QueueSize; });
+    }
+    hostWaiting = false;
+  }
+
+  command.op = op;
+  queue[t % QueueSize] = std::move(command);
+
+  // `tail` and `workerIdle` are sequentially consistent, either the host sees `workerIdle`
+  // or the worker sees the new command before it sleeps.
+  tail = t + 1;
+  if(workerIdle) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+    }
+    pushed.notify_one();
+  }
+
+  return t;
+}
+
+auto AsyncEmulator::process(uint64_t ticket, Command& c) -> void {
+  std::unique_ptr<Output> out;
+
+  switch(c.op) {
+  case Op::LoadApuram: {
+    auto& apuram = emu.apuram_mut();
+    uint16_t address = c.address;
+    for(auto b : c.data) apuram[address++] = b;
+    break;
+  }
+
+  case Op::LoadState: {
+    out = std::make_unique<Output>();
+    out->ok = emu.load_state(c.data.data(), c.data.size());
+    break;
+  }
+
+  case Op::Reset: {
+    emu.reset(c.registers);
+    break;
+  }
+
+  case Op::WriteIoPorts: {
+    emu.write_io_ports(c.ports);
+    break;
+  }
+
+  case Op::Render: {
+    out = std::make_unique<Output>();
+    out->samples.resize(c.frames * 2);
+    emu.emulate_into(out->samples.data(), c.frames);
+    break;
+  }
+
+  case Op::Snapshot: {
+    out = std::make_unique<Output>();
+    out->state = std::move(*emu.save_state());
+    break;
+  }
+  }
+
+  if(out) {
+    out->ticket = ticket;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    outputs.push_back(std::move(out));
+  }
+}
+
+auto AsyncEmulator::worker() -> void {
+  while(!quit) {
+    const uint64_t h = head.load(std::memory_order_relaxed);
+
+    if(tail.load(std::memory_order_acquire) == h) {
+      std::unique_lock<std::mutex> lock(mutex);
+      workerIdle = true;
+      pushed.wait(lock, [&] { return quit || tail.load() != h; });
+      workerIdle = false;
+      continue;
+    }
+
+    auto& c = queue[h % QueueSize];
+    process(h, c);
+    // Frees the command's data
+    c = {};
+
+    head = h + 1;
+    if(hostWaiting) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+      }
+      processed.notify_all();
+    }
+  }
+}
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+namespace shvc_sound_emu {
+
+struct AsyncEmulatorResult;
+
+// An emulator that runs on its own thread.
+//
+// Commands are pushed to a lock-free single producer, single consumer queue and are processed in
+// order.  Each command returns a ticket (the number of commands pushed before it), the command has
+// completed when `completed()` is greater than its ticket.
+// `load_state()`, `render()` and `snapshot()` output a result, which is taken with `take_result()`.
+//
+// The host methods must not be called by more than one thread at a time.
+struct AsyncEmulator {
+  // Maximum number of commands waiting to be processed, pushing a command to a full queue blocks.
+  constexpr static uint32_t QueueSize = 256;
+
+  AsyncEmulator(const std::array<uint8_t, 64>& iplrom);
+  AsyncEmulator(const AsyncEmulator&) = delete;
+  auto operator=(const AsyncEmulator&) -> AsyncEmulator& = delete;
+  // Waits for the current command to complete, the remaining commands are discarded.
+  ~AsyncEmulator();
+
+  // Copies `data` to Audio-RAM at `address` (wrapping at the end of Audio-RAM).
+  auto load_apuram(uint16_t address, rust::Slice<const uint8_t> data) -> uint64_t;
+  // Restores a state saved by `ShvcSoundEmu::save_state()` (the result is not ok if it failed).
+  auto load_state(rust::Slice<const uint8_t> state) -> uint64_t;
+  auto reset(ResetRegisters r) -> uint64_t;
+  auto write_io_ports(std::array<uint8_t, 4> ports) -> uint64_t;
+  // Emulates `frames` stereo samples (the result contains the interleaved samples).
+  auto render(size_t frames) -> uint64_t;
+  // Saves the emulator state (the result contains the state).
+  auto snapshot() -> uint64_t;
+
+  // Number of completed commands.
+  auto completed() const -> uint64_t;
+  // Blocks until the command with `ticket` has completed.
+  auto wait(uint64_t ticket) -> void;
+  // Moves the oldest completed result into `out`.
+  // Returns false if there are no results.
+  auto take_result(AsyncEmulatorResult& out) -> bool;
+
+private:
+  enum class Op : uint8_t {
+    LoadApuram,
+    LoadState,
+    Reset,
+    WriteIoPorts,
+    Render,
+    Snapshot,
+  };
+
+  struct Command;
+  struct Output;
+
+  auto push(Op op, Command&& command) -> uint64_t;
+  auto process(uint64_t ticket, Command& command) -> void;
+  auto worker() -> void;
+
+  ShvcSoundEmu emu;
+
+  // Only written by the host
+  std::unique_ptr<Command[]> queue;
+  alignas(64) std::atomic<uint64_t> tail = 0;  // Commands pushed
+
+  // Only written by the worker
+  alignas(64) std::atomic<uint64_t> head = 0;  // Commands processed
+
+  // The mutex is only locked to sleep, wake or pass results between the threads
+  std::mutex mutex;
+  std::condition_variable pushed;     // Notified when a command is pushed (if the worker is idle)
+  std::condition_variable processed;  // Notified when a command has completed (if the host is waiting)
+  std::atomic<bool> workerIdle = false;
+  std::atomic<bool> hostWaiting = false;
+  std::atomic<bool> quit = false;
+  std::deque<std::unique_ptr<Output>> outputs;
+
+  std::thread thread;
+};
+
+auto new_async_emulator(const std::array<uint8_t, 64>& iplrom) -> std::unique_ptr<AsyncEmulator>;
+
+}
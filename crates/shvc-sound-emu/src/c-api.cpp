@@ -0,0 +1,98 @@
+#include "shvc-sound-emu.h"
+
+// The emulator and every buffer used by the real-time functions are allocated when the instance is
+// created.
+struct shvc_emu {
+  // Stereo samples converted per `shvc_emu_process_f32()` chunk
+  constexpr static size_t ConvertFrames = 256;
+
+  shvc_emu(const std::array<uint8_t, 64>& iplrom) : emu(iplrom) {}
+  shvc_emu(const shvc_emu& source) : emu(source.emu) {}
+
+  shvc_sound_emu::ShvcSoundEmu emu;
+  std::array<int16_t, ConvertFrames * 2> convert = {};
+};
+
+static_assert((int)SHVC_EMU_RESAMPLER_LINEAR == (int)shvc_sound_emu::ResamplerQuality::Linear);
+static_assert((int)SHVC_EMU_RESAMPLER_CUBIC == (int)shvc_sound_emu::ResamplerQuality::Cubic);
+static_assert((int)SHVC_EMU_RESAMPLER_SINC == (int)shvc_sound_emu::ResamplerQuality::Sinc);
+static_assert(SHVC_EMU_MIN_OUTPUT_SAMPLE_RATE == shvc_sound_emu::OutputResampler::MinOutputRate);
+static_assert(SHVC_EMU_MAX_OUTPUT_SAMPLE_RATE == shvc_sound_emu::OutputResampler::MaxOutputRate);
+
+extern "C" {
+
+shvc_emu* shvc_emu_create(const uint8_t iplrom[64]) {
+  std::array<uint8_t, 64> rom;
+  memory::copy(rom.data(), iplrom, rom.size());
+
+  try {
+    return new shvc_emu(rom);
+  } catch(...) {
+    return nullptr;
+  }
+}
+
+shvc_emu* shvc_emu_clone(const shvc_emu* emu) {
+  try {
+    return new shvc_emu(*emu);
+  } catch(...) {
+    return nullptr;
+  }
+}
+
+void shvc_emu_destroy(shvc_emu* emu) {
+  delete emu;
+}
+
+bool shvc_emu_load_spc(shvc_emu* emu, const uint8_t* data, size_t size) {
+  try {
+    return emu->emu.load_spc(data, size);
+  } catch(...) {
+    return false;
+  }
+}
+
+bool shvc_emu_set_output_sample_rate(shvc_emu* emu, uint32_t rate, shvc_emu_resampler_quality quality) {
+  try {
+    return emu->emu.set_output_sample_rate(rate, (shvc_sound_emu::ResamplerQuality)quality);
+  } catch(...) {
+    return false;
+  }
+}
+
+uint32_t shvc_emu_output_sample_rate(const shvc_emu* emu) {
+  return emu->emu.output_sample_rate();
+}
+
+void shvc_emu_process(shvc_emu* emu, int16_t* out, size_t frames) {
+  if(frames > 0) emu->emu.emulate_resampled(out, frames);
+}
+
+void shvc_emu_process_f32(shvc_emu* emu, float* left, float* right, size_t frames) {
+  constexpr float Scale = 1.0f / 32768.0f;
+
+  while(frames > 0) {
+    const size_t n = std::min(frames, shvc_emu::ConvertFrames);
+    emu->emu.emulate_resampled(emu->convert.data(), n);
+
+    for(auto i : range(n)) {
+      left[i] = emu->convert[i * 2 + 0] * Scale;
+      right[i] = emu->convert[i * 2 + 1] * Scale;
+    }
+
+    left += n;
+    right += n;
+    frames -= n;
+  }
+}
+
+void shvc_emu_read_io_ports(const shvc_emu* emu, uint8_t ports[4]) {
+  const auto p = emu->emu.read_io_ports();
+  memory::copy(ports, p.data(), p.size());
+}
+
+void shvc_emu_write_io_ports(shvc_emu* emu, const uint8_t ports[4]) {
+  emu->emu.write_io_ports({ports[0], ports[1], ports[2], ports[3]});
+}
+
+}
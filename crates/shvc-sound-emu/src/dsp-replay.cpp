@@ -0,0 +1,70 @@
+namespace shvc_sound_emu {
+
+// Drives the S-DSP from a log recorded by `ShvcSoundEmu::start_dsp_log()`, without the S-SMP.
+//
+// The S-DSP is emulated up to the clock of the next logged write, the write is applied and
+// emulation resumes.  Between writes the S-DSP takes its whole sample fast path.
+struct DspReplay {
+  DspReplay(DSP& dsp, rust::Slice<const DspRegisterWrite> registers, rust::Slice<const ApuramWrite> apuram)
+    : dsp(dsp), registers(registers), apuram(apuram)
+  {
+    // Writes before the current clock were applied by a previous replay
+    auto before = [](const auto& w, u64 clock) { return w.dsp_clock < clock; };
+    nextRegister = std::lower_bound(registers.begin(), registers.end(), dsp.clocks(), before) - registers.begin();
+    nextApuram = std::lower_bound(apuram.begin(), apuram.end(), dsp.clocks(), before) - apuram.begin();
+  }
+
+  auto run(int16_t* out, size_t frames) -> void {
+    // Replayed writes are not logged again
+    const bool logWrites = dsp.logWrites;
+    dsp.logWrites = false;
+
+    dsp.sampleBuffer.reset(out, frames);
+
+    while(!dsp.sampleBuffer.isFull()) {
+      const u64 clock = dsp.clocks();
+
+      while(nextRegister < registers.size() && registers[nextRegister].dsp_clock <= clock) {
+        const auto& w = registers[nextRegister++];
+        dsp.write(w.address & 0x7f, w.value);
+      }
+      while(nextApuram < apuram.size() && apuram[nextApuram].dsp_clock <= clock) {
+        const auto& w = apuram[nextApuram++];
+        dsp.apuram[w.address] = w.value;
+        dsp.dirtyPages[w.address >> 8] = true;
+      }
+
+      // Stop on the clock that outputs the last sample
+      u64 until = clock + (SampleOutputPhase - clock) % 32;
+      if(until == clock) until += 32;
+      until += (dsp.sampleBuffer.space() - 1) * 32;
+
+      if(nextRegister < registers.size()) until = std::min(until, registers[nextRegister].dsp_clock);
+      if(nextApuram < apuram.size()) until = std::min(until, apuram[nextApuram].dsp_clock);
+
+      dsp.smpStepped((until - clock) * SMP_CLOCKS_PER_DSP_CLOCK);
+    }
+
+    dsp.logWrites = logWrites;
+  }
+
+private:
+  // The phase echo27() outputs the sample on
+  static constexpr u64 SampleOutputPhase = 27;
+  static constexpr u64 SMP_CLOCKS_PER_DSP_CLOCK = 2;
+
+  DSP& dsp;
+  rust::Slice<const DspRegisterWrite> registers;
+  rust::Slice<const ApuramWrite> apuram;
+  size_t nextRegister;
+  size_t nextApuram;
+};
+
+auto ShvcSoundEmu::replay_dsp_log(rust::Slice<const DspRegisterWrite> registers, rust::Slice<const ApuramWrite> apuram,
+                                  int16_t* out, size_t frames) -> void {
+  if(frames == 0) return;
+
+  DspReplay(smp.dsp, registers, apuram).run(out, frames);
+}
+
+}
@@ -1,60 +1,125 @@
+//BRR nybbles shifted by the header's range, indexed by [range][nybble]
+//generated with: s = sign-extended nybble; range <= 12 ? (s << range) >> 1 : s & ~0x7ff
+const s16 DSP::BRRScaleTable[16][16] = {
+  {     0,      0,      1,      1,      2,      2,      3,      3,     -4,     -4,     -3,     -3,     -2,     -2,     -1,     -1},
+  {     0,      1,      2,      3,      4,      5,      6,      7,     -8,     -7,     -6,     -5,     -4,     -3,     -2,     -1},
+  {     0,      2,      4,      6,      8,     10,     12,     14,    -16,    -14,    -12,    -10,     -8,     -6,     -4,     -2},
+  {     0,      4,      8,     12,     16,     20,     24,     28,    -32,    -28,    -24,    -20,    -16,    -12,     -8,     -4},
+  {     0,      8,     16,     24,     32,     40,     48,     56,    -64,    -56,    -48,    -40,    -32,    -24,    -16,     -8},
+  {     0,     16,     32,     48,     64,     80,     96,    112,   -128,   -112,    -96,    -80,    -64,    -48,    -32,    -16},
+  {     0,     32,     64,     96,    128,    160,    192,    224,   -256,   -224,   -192,   -160,   -128,    -96,    -64,    -32},
+  {     0,     64,    128,    192,    256,    320,    384,    448,   -512,   -448,   -384,   -320,   -256,   -192,   -128,    -64},
+  {     0,    128,    256,    384,    512,    640,    768,    896,  -1024,   -896,   -768,   -640,   -512,   -384,   -256,   -128},
+  {     0,    256,    512,    768,   1024,   1280,   1536,   1792,  -2048,  -1792,  -1536,  -1280,  -1024,   -768,   -512,   -256},
+  {     0,    512,   1024,   1536,   2048,   2560,   3072,   3584,  -4096,  -3584,  -3072,  -2560,  -2048,  -1536,  -1024,   -512},
+  {     0,   1024,   2048,   3072,   4096,   5120,   6144,   7168,  -8192,  -7168,  -6144,  -5120,  -4096,  -3072,  -2048,  -1024},
+  {     0,   2048,   4096,   6144,   8192,  10240,  12288,  14336, -16384, -14336, -12288, -10240,  -8192,  -6144,  -4096,  -2048},
+  {     0,      0,      0,      0,      0,      0,      0,      0,  -2048,  -2048,  -2048,  -2048,  -2048,  -2048,  -2048,  -2048},
+  {     0,      0,      0,      0,      0,      0,      0,      0,  -2048,  -2048,  -2048,  -2048,  -2048,  -2048,  -2048,  -2048},
+  {     0,      0,      0,      0,      0,      0,      0,      0,  -2048,  -2048,  -2048,  -2048,  -2048,  -2048,  -2048,  -2048},
+};
+
 auto DSP::brrDecode(Voice& v) -> void {
   //brr._byte = apuram[v.brrAddress + v.brrOffset] cached from previous clock cycle
   s32 nybbles = brr._byte << 8 | apuram[n16(v.brrAddress + v.brrOffset + 1)];
+  markAccess(n16(v.brrAddress + v.brrOffset + 1), AccessRead);
+
+  if(!brrCache.empty()) return brrDecodeCached(v, nybbles);
+  brrDecodeSamples(v, nybbles);
+}
+
+//the decoded samples only depend on the header, the data and the previous two samples
+auto DSP::brrDecodeCached(Voice& v, s32 nybbles) -> void {
+  u32 offset = v.bufferOffset;
+  s32 p1 = v.buffer[offset + 11];
+  s32 p2 = v.buffer[offset + 10];
+  if((brr._header & 0x0c) == 0) p1 = p2 = 0;  //filter 0 does not use them
+
+  n16 address = v.brrAddress + v.brrOffset;
+  u32 hash = ((u32)address * 0x9e3779b1u) ^ (u16)p1 * 0x85ebca6bu ^ (u16)p2;
+  auto& entry = brrCache[(hash ^ hash >> 16) & (BRRCacheSize - 1)];
+
+  if(entry.valid && entry.header == brr._header && entry.nybbles == (u16)nybbles
+  && entry.p1 == p1 && entry.p2 == p2) {
+    for(u32 n : range(4)) {
+      v.buffer[offset] = v.buffer[offset + 12] = entry.samples[n];
+      if(++offset >= 12) offset = 0;
+    }
+    v.bufferOffset = offset;
+    return;
+  }
+
+  brrDecodeSamples(v, nybbles);
+
+  entry.nybbles = nybbles;
+  entry.header = brr._header;
+  entry.valid = true;
+  entry.p1 = p1;
+  entry.p2 = p2;
+  for(u32 n : range(4)) {
+    entry.samples[n] = v.buffer[offset];
+    if(++offset >= 12) offset = 0;
+  }
+}
+
+auto DSP::brrDecodeSamples(Voice& v, s32 nybbles) -> void {
+  const s16* scaled = BRRScaleTable[brr._header >> 4];
+
+  switch(brr._header >> 2 & 3) {
+  case 0: return brrDecodeFilter<0>(v, nybbles, scaled);
+  case 1: return brrDecodeFilter<1>(v, nybbles, scaled);
+  case 2: return brrDecodeFilter<2>(v, nybbles, scaled);
+  case 3: return brrDecodeFilter<3>(v, nybbles, scaled);
+  }
+}
 
-  const s32 filter = brr._header.bit(2,3);
-  const s32 scale  = brr._header.bit(4,7);
+//Filter is a constant, the filter is resolved at compile time
+template<u32 Filter> inline auto DSP::brrDecodeFilter(Voice& v, s32 nybbles, const s16* scaled) -> void {
+  //the previous two decoded samples, read from the buffer once
+  u32 offset = v.bufferOffset;
+  s32 p1 = v.buffer[offset + 11];
+  s32 p2 = v.buffer[offset + 10];
 
   //decode four samples
   for(u32 n : range(4)) {
-    //bits 12-15 = current nybble; sign extend, then shift right to 4-bit precision
-    //result: s = 4-bit sign-extended sample value
-    s32 s = (i16)nybbles >> 12;
+    //bits 12-15 = current nybble
+    s32 s = scaled[nybbles >> 12 & 15];
     nybbles <<= 4; //slide nybble so that on next loop iteration, bits 12-15 = current nybble
 
-    if(scale <= 12) {
-      s <<= scale;
-      s >>= 1;
-    } else {
-      s &= ~0x7ff;
-    }
+    p2 >>= 1;  //p2 is only used at half precision
 
     //apply IIR filter (2 is the most commonly used)
-    s32 offset = v.bufferOffset;
-    if(--offset < 0) offset = 11; const s32 p1 = v.buffer[offset];
-    if(--offset < 0) offset = 11; const s32 p2 = v.buffer[offset] >> 1;
-
-    switch(filter) {
-    case 0:
-      break;
-
-    case 1:
+    if constexpr(Filter == 1) {
       //s += p1 * 0.46875
       s += p1 >> 1;
       s += (-p1) >> 5;
-      break;
+    }
 
-    case 2:
+    if constexpr(Filter == 2) {
       //s += p1 * 0.953125 - p2 * 0.46875
       s += p1;
       s -= p2;
       s += p2 >> 4;
       s += (p1 * -3) >> 6;
-      break;
+    }
 
-    case 3:
+    if constexpr(Filter == 3) {
       //s += p1 * 0.8984375 - p2 * 0.40625
       s += p1;
       s -= p2;
       s += (p1 * -13) >> 7;
       s += (p2 * 3) >> 4;
-      break;
     }
 
     //adjust and write sample (mirror the written sample for wrapping)
     s = sclamp<16>(s);
     s = (i16)(s << 1);
-    v.buffer[v.bufferOffset] = s;
-    if(++v.bufferOffset >= 12) v.bufferOffset = 0;
+    v.buffer[offset] = v.buffer[offset + 12] = s;
+    if(++offset >= 12) offset = 0;
+
+    p2 = p1;
+    p1 = s;
   }
+
+  v.bufferOffset = offset;
 }
@@ -35,14 +35,37 @@ const n16 DSP::CounterOffset[32] = {
        0,
 };
 
+//each rate remembers the tick of its next event, so polling is a comparison instead of a division
+//(all rates evenly divide the counter range, so the events of a rate are always CounterRate ticks apart)
+
+inline auto DSP::counterReset() -> void {
+  clock.ticks = 0;
+  for(u32 rate : range(1, 32)) {
+    clock.nextTick[rate] = (clock.counter + CounterOffset[rate]) % CounterRate[rate];
+  }
+}
+
 inline auto DSP::counterTick() -> void {
   if(!clock.counter) clock.counter = 2048 * 5 * 3;  //30720 (0x7800)
   clock.counter--;
+  clock.ticks++;
 }
 
 //return true if counter event should trigger
 
 inline auto DSP::counterPoll(u32 rate) -> bool {
   if(rate == 0) return false;
-  return (clock.counter + CounterOffset[rate]) % CounterRate[rate] == 0;
+  counterAdvance(rate);
+  return clock.ticks == clock.nextTick[rate];
+}
+
+//if the last event has passed, advance to the next one
+//(more than one period behind only if the rate was not polled for a while)
+inline auto DSP::counterAdvance(u32 rate) -> void {
+  u64& next = clock.nextTick[rate];
+  if(clock.ticks > next) {
+    u64 period = CounterRate[rate];
+    u64 late = clock.ticks - next;
+    next += late <= period ? period : (late + period - 1) / period * period;
+  }
 }
@@ -1,3 +1,7 @@
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+  #include <arm_neon.h>
+#endif
+
 namespace shvc_sound_emu {
 
 #include "memory.cpp"
@@ -8,19 +12,29 @@ namespace shvc_sound_emu {
 #include "misc.cpp"
 #include "voice.cpp"
 #include "echo.cpp"
+#include "serialization.cpp"
 
 auto DSP::smpStepped(u32 clocks) -> void {
   timing.pendingSmpClocks += clocks;
 
   while(timing.pendingSmpClocks >= 2) {
+    //run whole samples in a single straight-line step
+    if(timing.pendingSmpClocks >= 64 && (timing.clock + 1) % 32 == 0) {
+      timing.pendingSmpClocks -= 64;
+      timing.clock += 32;
+      mainSample();
+      continue;
+    }
+
     timing.pendingSmpClocks -= 2;
     timing.clock++;
     main(timing.clock % 32);
   }
 }
 
-auto DSP::main(u32 phase) -> void {
-  switch(phase) {
+//Phase is a constant, the switch is resolved at compile time
+template<u32 Phase> inline auto DSP::clockPhase() -> void {
+  switch(Phase) {
   case 0:
     voice5(voice[0]);
     voice2(voice[1]);
@@ -152,6 +166,7 @@ auto DSP::main(u32 phase) -> void {
     break;
 
   case 22:
+    if(mix.deferred) mixVoices();
     voice3a(voice[0]);
     voice9(voice[6]);
     voice6(voice[7]);
@@ -206,31 +221,193 @@ auto DSP::main(u32 phase) -> void {
   }
 }
 
+template<u32... Phases> inline auto DSP::clockPhases(std::integer_sequence<u32, Phases...>) -> void {
+  (clockPhase<Phases>(), ...);
+}
+
+auto DSP::main(u32 phase) -> void {
+  if(logicOnly) return logicPhase(phase);
+
+  #define p(n) case n: return clockPhase<n>();
+  switch(phase) {
+  p( 0) p( 1) p( 2) p( 3) p( 4) p( 5) p( 6) p( 7)
+  p( 8) p( 9) p(10) p(11) p(12) p(13) p(14) p(15)
+  p(16) p(17) p(18) p(19) p(20) p(21) p(22) p(23)
+  p(24) p(25) p(26) p(27) p(28) p(29) p(30) p(31)
+  }
+  #undef p
+}
+
+//runs all 32 phases of a sample, starting at phase 0
+auto DSP::mainSample() -> void {
+  if(logicOnly) return logicSample();
+
+  const bool written = sleep.written;
+  sleep.written = false;
+
+  if(fastPaths && sleep.asleep && !written) return sleepSample();
+
+  //every voice outputs between phase 0 and 21 (except voice 0's left output in phase 31)
+  mix.deferred = fastPaths;
+  clockPhases(std::make_integer_sequence<u32, 32>());
+
+  //the latches read by the next sample were all set without a register write in between
+  sleep.asleep = fastPaths && !written && canSleep();
+}
+
+//true if every voice is idle: keyed off with a zero envelope, no key-on pending and nothing
+//left to mix (idle voices stay idle until a register is written)
+auto DSP::canSleep() const -> bool {
+  if(flags._keylatch || flags._keyon || latch.output) return false;
+
+  for(auto& v : voice) {
+    if(v.envelope || v.envelopeMode != Envelope::Release || v.keyonDelay) return false;
+  }
+
+  if(Instrumentation::enabled) {
+    for(auto& tap : taps) {
+      if(tap.buffer) return false;
+    }
+  }
+
+  return true;
+}
+
+//a sample with every voice idle (see canSleep()), with the same result as mainSample().
+//the silent voices do not change the output or echo totals, so they are not mixed and each
+//voice's stages run in one go (BRR decoding continues as it updates ENDX and the decode
+//history used after the next KON).  the echo and misc stages run as in mainSample().
+auto DSP::sleepSample() -> void {
+  //voice 0's stages in phases 0 and 1 to 4 follow its voice4 of the previous sample
+  voiceSleepEnd(voice[0]);
+  for(u32 n : range(1, 8)) {
+    voiceSleepStart(voice[n]);
+    voiceSleepEnd(voice[n]);
+  }
+
+  echo22();
+  echo23();
+  echo24();
+  echo25();
+  echo26();
+  misc27();
+  echo27();
+  misc28();
+  echo28();
+  misc29();
+  echo29();
+  misc30();
+  echo30();
+
+  voiceSleepStart(voice[0]);
+
+  //the directory latches left by voice1 of voices 1 and 2 (phases 20 and 31)
+  brr._address = (brr._bank << 8) + (voice[1].source << 2);
+  brr._source = voice[2].source;
+}
+
+//a single phase in logicOnly mode: each voice's logic runs in the phase of its voice3c stage, the echo and
+//misc stages run as in main()
+auto DSP::logicPhase(u32 phase) -> void {
+  switch(phase) {
+  case 22: echo22(); break;
+  case 23: echo23(); break;
+  case 24: echo24(); break;
+  case 25: echo25(); break;
+  case 26: echo26(); break;
+  case 27: misc27(); echo27(); break;
+  case 28: misc28(); echo28(); break;
+  case 29: misc29(); echo29(); break;
+  case 30: misc30(); voiceLogic(voice[0]); echo30(); break;
+  default:
+    //voice n's voice3c stage is in phase 3n - 2 (voices 1 to 7)
+    if(phase < 20 && phase % 3 == 1) voiceLogic(voice[phase / 3 + 1]);
+    break;
+  }
+}
+
+//all 32 phases of a sample in logicOnly mode, in the same order as logicPhase()
+auto DSP::logicSample() -> void {
+  for(u32 n : range(1, 8)) voiceLogic(voice[n]);
+
+  echo22();
+  echo23();
+  echo24();
+  echo25();
+  echo26();
+  misc27();
+  echo27();
+  misc28();
+  echo28();
+  misc29();
+  echo29();
+  misc30();
+  voiceLogic(voice[0]);
+  echo30();
+}
+
 auto DSP::sample(i16 left, i16 right) -> void {
+  if(!sampleBuffer.isFull()) timing.samplesOutput++;
   sampleBuffer.write(left, right);
 }
 
+auto DSP::quiescent(u32 echoThreshold) const -> bool {
+  if(flags._keylatch || flags._keyon) return false;
+
+  for(auto& v : voice) {
+    if(v.envelope || v.envelopeMode != Envelope::Release || v.keyonDelay) return false;
+  }
+
+  //the echo buffer is not heard while both echo volumes are zero
+  if(!echo.volume[0] && !echo.volume[1]) return true;
+
+  auto decayed = [&](s32 sample) { return (u32)abs(sample) <= echoThreshold; };
+
+  for(u32 channel : range(2)) {
+    for(auto sample : echo.history[channel]) {
+      if(!decayed(sample)) return false;
+    }
+  }
+
+  //the echo buffer keeps its old length until the echo offset wraps
+  u32 length = max(u32(echo._length), u32(echo.delay << 11), 4u);
+  n16 address = echo._page << 8;
+  for(u32 i = 0; i < length; i += 2) {
+    n8 lo = apuram[address++];
+    n8 hi = apuram[address++];
+    if(!decayed((i16)((hi << 8) + lo) >> 1)) return false;
+  }
+
+  return true;
+}
+
 auto DSP::power(bool reset) -> void {
   if(!reset) {
     apuram.fill(0);
     registers.fill(0);
   }
+  dirtyPages.fill(true);
+  changedRegisters.fill(0xff);
 
   sampleBuffer.reset();
 
   timing = {};
+  meters = {};
+
+  counterReset();
 
   mainvol = {};
   echo = {};
   noise = {};
   brr = {};
+  flags = {};
   latch = {};
+  mix = {};
+  sleep = {};
   for(u32 n : range(8)) {
     voice[n] = {};
     voice[n].index = n << 4;
   }
-
-  gaussianConstructTable();
 }
 
 }
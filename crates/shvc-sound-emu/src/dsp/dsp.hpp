@@ -2,29 +2,17 @@
 
 namespace shvc_sound_emu {
 
-struct DSP {
-  std::array<uint8_t, 64_KiB> apuram;
+//the state used every sample is declared first (packed into as few cache lines as possible),
+//followed by the host facing state and the Audio-RAM
+struct alignas(64) DSP {
   std::array<uint8_t, 128> registers;
 
-  SampleBuffer sampleBuffer;
-
-  auto mute() const -> bool { return mainvol.mute; }
-
-  auto power(bool reset) -> void;
-
-  auto smpStepped(u32 clocks) -> void;
-
-  //memory.cpp
-  auto read(n7 address) -> n8;
-  auto write(n7 address, n8 data) -> void;
-
-  //echo.cpp
-  auto resetEchoBuffer() -> void;
-
 private:
   struct Timing {
     i32 pendingSmpClocks;
     u64 clock;
+    u64 sharedPagesUntil;  //clock sharedPages is valid until
+    u64 samplesOutput;     //not part of the state
   } timing;
 
   struct Envelope { enum : u32 {
@@ -34,115 +22,379 @@ private:
     Sustain,
   };};
 
+  //S-DSP state field types
+  //the state is stored in native integers, masked only where the hardware wraps;
+  //define SHVC_SOUND_EMU_NALL_DSP_STATE to store it in bit-exact nall integers instead
+  //(used to compare the two layouts, both must emulate identically)
+  #if defined(SHVC_SOUND_EMU_NALL_DSP_STATE)
+  using dn1  = n1;  using dn2  = n2;  using dn3  = n3;  using dn4  = n4;
+  using dn5  = n5;  using dn7  = n7;  using dn8  = n8;  using dn11 = n11;
+  using dn14 = n14; using dn15 = n15; using dn16 = n16;
+  using di8  = i8;  using di16 = i16; using di17 = i17; using di32 = i32;
+  #else
+  using dn1  = bool; using dn2  = u8;  using dn3  = u8;  using dn4  = u8;
+  using dn5  = u8;   using dn7  = u8;  using dn8  = u8;  using dn11 = u16;
+  using dn14 = u16;  using dn15 = u16; using dn16 = u16;
+  using di8  = s8;   using di16 = s16; using di17 = s32; using di32 = s32;
+  #endif
+
   struct Clock {
-    n15 counter;
-    n1  sample = 1;
+    dn15 counter = 0;
+    dn1  sample = 1;
+    u64  ticks;          //counter ticks since power-on or reset
+    u64  nextTick[32];   //tick of the next (or last polled) event of each rate
   } clock;
 
   struct MainVol {
-    n1  reset = 1;
-    n1  mute = 1;
-    i8  volume[2];
-    i17 output[2];
+    dn1  reset = 1;
+    dn1  mute = 1;
+    di8  volume[2];
+    di17 output[2];
   } mainvol;
 
   struct Echo {
-    i8  feedback;
-    i8  volume[2];
-    i8  fir[8];
-    i16 history[2][8];
-    n8  page;
-    n4  delay;
-    n1  readonly = 1;
-    i17 input[2];
-    i17 output[2];
-
-    n8  _page;
-    n1  _readonly;
-    n16 _address;
-    n16 _offset;  //offset from ESA into echo buffer
-    n16 _length;  //number of bytes that echo offset will stop at
-    n3  _historyOffset;
+    di8  feedback;
+    di8  volume[2];
+    di8  fir[8];
+    di16 history[2][16];  //each sample is stored twice so the eight FIR taps are contiguous
+    dn8  page;
+    dn4  delay;
+    dn1  readonly = 1;
+    di17 input[2];
+    di17 output[2];
+
+    dn8  _page;
+    dn1  _readonly;
+    dn16 _address;
+    dn16 _offset;  //offset from ESA into echo buffer
+    dn16 _length;  //number of bytes that echo offset will stop at
+    dn3  _historyOffset;
+    s32  _firTaps[2][8];  //FIR tap outputs, calculated in echo22
+
+    //fast path (not part of the state): while every history sample of a channel is the same
+    //(ie, a silent or readonly echo buffer), _firTaps do not change and echo22 skips the FIR
+    s32  _lastRead[2];      //last sample read from the echo buffer
+    u8   _repeatedReads[2]; //consecutive reads of _lastRead (saturates at 8)
+    bool _firTapsConstant;  //set if _firTaps were calculated from constant histories
   } echo;
 
   struct Noise {
-    n5  frequency;
-    n15 lfsr = 0x4000;
+    dn5  frequency;
+    dn15 lfsr = 0x4000;
   } noise;
 
   struct BRR {
-    n8  bank;
-
-    n8  _bank;
-    n8  _source;
-    n16 _address;
-    n16 _nextAddress;
-    n8  _header;
-    n8  _byte;
+    dn8  bank;
+
+    dn8  _bank;
+    dn8  _source;
+    dn16 _address;
+    dn16 _nextAddress;
+    dn8  _header;
+    dn8  _byte;
   } brr;
 
+  //voice flags, stored as the hardware registers are (bit n = voice n)
+  struct VoiceFlags {
+    dn8  keyon;     //KON
+    dn8  keyoff;    //KOFF
+    dn8  modulate;  //PMON: 0 = normal, 1 = modulate by previous voice pitch
+    dn8  noise;     //NON: 0 = BRR, 1 = noise
+    dn8  echo;      //EON: 0 = direct, 1 = echo
+    dn8  end;       //0 = keyed on, 1 = BRR end bit encountered
+
+    //internal latches
+    dn8  _keylatch;
+    dn8  _keyon;
+    dn8  _keyoff;
+    dn8  _modulate;
+    dn8  _noise;
+    dn8  _echo;
+    dn8  _end;      //ENDX
+  } flags;
+
   struct Latch {
-    n8  adsr0;
-    n8  envx;
-    n8  outx;
-    n15 pitch;
-    i16 output;
+    dn8  adsr0;
+    dn8  envx;
+    dn8  outx;
+    dn15 pitch;
+    di16 output;
   } latch;
 
-  struct Voice {
-    n7  index;  //voice channel register index: 0x00 for voice 0, 0x10 for voice 1, etc
-
-    i8  volume[2];
-    n14 pitch;
-    n8  source;
-    n8  adsr0;
-    n8  adsr1;
-    n8  gain;
-    n8  envx;
-    n1  keyon;
-    n1  keyoff;
-    n1  modulate;  //0 = normal, 1 = modulate by previous voice pitch
-    n1  noise;     //0 = BRR, 1 = noise
-    n1  echo;      //0 = direct, 1 = echo
-    n1  end;       //0 = keyed on, 1 = BRR end bit encountered
-
-    i16 buffer[12];      //12 decoded samples (mirrored for wrapping)
-    n4  bufferOffset;    //place in buffer where next samples will be decoded
-    n16 gaussianOffset;  //relative fractional position in sample (0x1000 = 1.0)
-    n16 brrAddress;      //address of current BRR block
-    n4  brrOffset = 1;   //current decoding offset in BRR block (1-8)
-    n3  keyonDelay;      //KON delay/current setup phase
-    n2  envelopeMode;
-    n11 envelope;        //current envelope level (0-2047)
+  //fast path (not part of the state): mainSample() records the voice outputs of the sample and
+  //mixVoices() applies the volumes of all eight voices at once, in structure of arrays layout
+  struct Mix {
+    bool deferred;                //set while voiceOutput() records instead of mixing
+    alignas(16) s16 output[8];    //latch.output of each voice
+    alignas(16) s16 volume[2][8]; //copy of each voice's VxVOLL and VxVOLR
+  } mix;
 
-    //internal latches
-    i32 _envelope;       //used by GAIN mode 7, very obscure quirk
-    n1  _keylatch;
-    n1  _keyon;
-    n1  _keyoff;
-    n1  _modulate;
-    n1  _noise;
-    n1  _echo;
-    n1  _end;
-    n1  _looped;
+  //fast path (not part of the state): while asleep, mainSample() runs sleepSample() instead of
+  //the 32 phases (set by a sample with every voice idle and no register writes, see canSleep())
+  struct Sleep {
+    bool asleep;
+    bool written;  //a register was written since the last sample started
+  } sleep;
+
+  //ordered so the fields used every sample come first, two cache lines per voice
+  struct alignas(64) Voice {
+    di32 _envelope;       //used by GAIN mode 7, very obscure quirk
+    di16 buffer[24];      //12 decoded samples (mirrored for wrapping)
+    dn16 gaussianOffset;  //relative fractional position in sample (0x1000 = 1.0)
+    dn16 brrAddress;      //address of current BRR block
+    dn14 pitch;
+    dn11 envelope;        //current envelope level (0-2047)
+    di8  volume[2];
+    dn4  bufferOffset;    //place in buffer where next samples will be decoded
+    dn4  brrOffset = 1;   //current decoding offset in BRR block (1-8)
+    dn3  keyonDelay;      //KON delay/current setup phase
+    dn2  envelopeMode;
+    dn8  adsr0;
+    dn8  adsr1;
+    dn8  gain;
+    dn8  envx;
+    dn8  source;
+
+    //internal latches (the other voice flags are in DSP::flags)
+    dn1  _looped;
+
+    dn7  index;  //voice channel register index: 0x00 for voice 0, 0x10 for voice 1, etc
+
+    //fast path (not part of the state): set if the last envelopeRun changed nothing and would not
+    //change anything on any counter event, cleared when its inputs are modified
+    bool _envelopeStable;
   } voice[8];
+  static_assert(sizeof(Voice) == 128);
+
+public:
+  SampleBuffer sampleBuffer;
+
+  //when set, main volume mixing and sample output are skipped
+  //(all S-SMP observable state, including echo buffer writes, is still emulated)
+  bool fastForward = false;
+
+  //when clear, every stage is emulated and the DSP runs in lockstep with the SMP
+  //(used to test the fast paths match the reference path)
+  bool fastPaths = true;
+
+  //when set, only the S-DSP logic the audio driver depends on is emulated (not part of the state):
+  //the registers, the KON/KOFF latches, ENDX clearing on KON, the counter, noise and echo buffer.
+  //voices are not decoded, enveloped or mixed (ENVX, OUTX and the BRR end ENDX bits are not updated and
+  //the echo input is silent), for tests that only read the audio driver's variables
+  bool logicOnly = false;
+
+  //must be called after the voice taps are changed (a sleeping DSP does not write them)
+  auto wake() -> void { sleep.asleep = false; }
+
+  //apuram pages the DSP may access within the next SharedPagesWindow samples
+  static constexpr u32 SharedPagesWindow = 64;
+  std::array<bool, 256> sharedPages;
+
+  //apuram pages written since the host last cleared them (used to build save state deltas)
+  std::array<bool, 256> dirtyPages;
+
+  //registers changed since the host last took them (bit n & 7 of byte n >> 3, not part of the state)
+  //every write() marks its register, the ENVX, OUTX and ENDX updates made by the voices are only
+  //marked if trackVoiceRegisterChanges is set (and the value changed)
+  std::array<u8, 16> changedRegisters;
+  bool trackVoiceRegisterChanges = false;
+  auto registerChanged(u32 address) -> void { changedRegisters[address >> 3 & 15] |= 1 << (address & 7); }
+
+  //when set, every register write is appended to registerLog and every SMP apuram write to apuramLog
+  //(the DSP can be replayed from the logs without running the SMP)
+  struct LoggedWrite {
+    u64 clock;
+    u16 address;
+    u8  data;
+  };
+  bool logWrites = false;
+  std::vector<LoggedWrite> registerLog;
+  std::vector<LoggedWrite> apuramLog;
+
+  //when set, every voice KON, every voice KOFF (that releases the voice) and every non-zero T0OUT read
+  //(an audio driver tick) is appended to eventLog (not part of the state)
+  enum : u8 { EventKeyOn, EventKeyOff, EventTick };
+  struct Event {
+    u64 clock;
+    u8  kind;
+    u8  voice;   //the T0OUT value of EventTick
+    u8  source;  //SRCN at KON
+    u16 pitch;   //VxPITCH at KON
+  };
+  bool logEvents = false;
+  std::vector<Event> eventLog;
+
+  //apuram access map (compiled out unless AccessMap::enabled, not part of the state)
+  //while not empty, accessMap[address] accumulates the AccessRead, AccessWrite and AccessExecute bits of
+  //every S-SMP access and of every DSP sample directory, BRR and echo buffer access to the byte
+  enum : u8 { AccessRead = 1, AccessWrite = 2, AccessExecute = 4 };
+  std::vector<u8> accessMap;
+  auto markAccess(n16 address, u8 kind) -> void {
+    if constexpr(AccessMap::enabled) {
+      if(!accessMap.empty()) accessMap[address] |= kind;
+    }
+  }
+
+  //echo buffer overwrite guard (not part of the state)
+  //records the first echo buffer write to a byte in [begin, begin + size), disabled if size is 0
+  struct EchoGuard {
+    u16 begin = 0;
+    u32 size = 0;
+    bool hit = false;
+    n16 address;  //first guarded byte written
+    u64 clock;    //S-DSP clock of the write
+  } echoGuard;
+  auto echoGuarded(n16 address) const -> bool { return u16(address - echoGuard.begin) < echoGuard.size; }
+
+  //peak and sum of squares of every voice's output (after the envelope, before volume) and of the
+  //main output, accumulated while audio is output until the host reads them (not part of the state)
+  struct Meters {
+    u32 voicePeak[8];
+    u64 voiceSquares[8];
+    u32 peak[2];
+    u64 squares[2];
+    u32 samples;
+  } meters = {};
+
+  //number of samples saturated by each 16-bit clamp of the mixer (left, right), accumulated until
+  //the host takes them (not part of the state)
+  struct Clipping {
+    u32 main[2];      //voice outputs added to the main output (not counted when fast-forwarding)
+    u32 echo[2];      //voice outputs added to the echo input
+    u32 fir[2];       //echo FIR filter output
+    u32 feedback[2];  //echo feedback added to the echo buffer sample
+    u32 output[2];    //main output + echo output (not counted when fast-forwarding)
+  } clipping = {};
+
+  //16-bit saturation, counting the clipped samples in `counter`
+  static auto clip(s32 x, u32& counter) -> s32 {
+    s32 y = sclamp<16>(x);
+    if constexpr(Instrumentation::enabled) counter += y != x;
+    return y;
+  }
+
+  //keyons and decoded BRR blocks per source number (the SRCN of the voice when it was keyed on),
+  //accumulated until the host takes them (not part of the state)
+  struct SourceUsage {
+    u32 keyOns[256];
+    u32 brrBlocks[256];
+    u8  voiceSource[8];  //SRCN of each voice at its last KON
+  } sourceUsage = {};
+
+  //optional per-voice output taps, each voice's output after the voice volume (before mixing) is
+  //written to a host owned ring buffer of interleaved stereo samples (not part of the state)
+  struct Tap {
+    int16_t* buffer = nullptr;  //disabled if null
+    u32 frames = 0;
+    u32 offset = 0;   //frame written next
+    u64 written = 0;  //frames written since the tap was set
+  } taps[8];
 
+  //debug voice muting, bit n drops voice n from the main and echo output (not part of the state)
+  //if skipMutedInterpolation is set, muted voices also output 0 to OUTX and to pitch modulation
+  u8 muteMask = 0;
+  bool skipMutedInterpolation = false;
+
+  //optional cache of decoded BRR samples, keyed by data address and the previous two samples
+  //(empty if disabled, not part of the state)
+  //entries store the header and data they were decoded from and are only used if they still match,
+  //so apuram writes (by the SMP, the echo buffer or the host) never leave a stale entry
+  struct BRRCacheEntry {
+    u16 nybbles;
+    u8  header;
+    u8  valid;
+    i16 p1;
+    i16 p2;
+    i16 samples[4];
+  };
+  static constexpr u32 BRRCacheSize = 4096;
+  std::vector<BRRCacheEntry> brrCache;
+
+  auto mute() const -> bool { return mainvol.mute; }
+
+  //S-DSP clocks since power-on or reset (32 per sample)
+  auto clocks() const -> u64 { return timing.clock; }
+
+  //samples written to sampleBuffer since power-on or reset
+  auto samplesOutput() const -> u64 { return timing.samplesOutput; }
+
+  //voice state read by the host (ie, to display the voices in a GUI)
+  auto voicePitch(u32 n) const -> u16 { return voice[n & 7].pitch; }
+  auto voiceEnvelope(u32 n) const -> u16 { return voice[n & 7].envelope; }
+  auto voiceKeyedOn(u32 n) const -> bool { return voice[n & 7].envelopeMode != Envelope::Release; }
+
+  //true if the output will stay silent until the S-SMP writes a register: every voice is keyed off
+  //with a zero envelope, no key-on is pending and the echo buffer and FIR history are within
+  //echoThreshold of zero (the feedback rounds towards negative infinity and can leave a residue)
+  auto quiescent(u32 echoThreshold) const -> bool;
+
+  auto power(bool reset) -> void;
+
+  auto smpStepped(u32 clocks) -> void;
+
+  //envelope.cpp
+  //the envelope registers of a voice traced by traceEnvelopes()
+  struct EnvelopeTrace {
+    u8  adsr0;         //ADSR1 register
+    u8  adsr1;         //ADSR2 register
+    u8  gain;
+    u32 keyOffSample;  //the voice is keyed off before this sample (never if >= the traced samples)
+  };
+  static auto traceEnvelopes(const EnvelopeTrace* traces, u32 count, u32 samples, u16* out) -> void;
+
+  //gaussian.cpp
+  //a BRR sample played at a list of pitches, scanned by scanGaussianOverflow()
+  struct GaussianOverflowScan {
+    const u8*  brr;
+    u32        size;        //in bytes, a multiple of 9
+    bool       looping;
+    u32        loopOffset;  //in bytes, a multiple of 9 (ignored if !looping)
+    u32        loops;       //number of times the loop is scanned (ignored if !looping)
+    const u16* pitches;
+    u32        pitchCount;
+  };
+  static auto scanGaussianOverflow(const GaussianOverflowScan& scan) -> bool;
+
+  //memory.cpp
+  auto read(n7 address) -> n8;
+  auto write(n7 address, n8 data) -> void;
+  auto loadRegisters(const std::array<uint8_t, 128>& data) -> void;
+  auto updateSharedPages() -> void;
+  auto refreshSharedPages(u32 samples) -> void;
+  auto sharedPagesDependOn(n16 address) const -> bool;
+
+  //echo.cpp
+  auto resetEchoBuffer() -> void;
+
+  //serialization.cpp
+  auto serialize(serializer&) -> void;
+  auto serializeVoices(serializer&) -> void;
+
+  //declared last so the 64 KiB array does not separate the hot state from the SMP state
+  alignas(64) std::array<uint8_t, 64_KiB> apuram;
+
+private:
   //gaussian.cpp
-  i16 gaussianTable[512];
-  auto gaussianConstructTable() -> void;
+  alignas(8) static const s16 GaussianTaps[256][4];
   auto gaussianInterpolate(const Voice& v) -> s32;
 
   //counter.cpp
   static const n16 CounterRate[32];
   static const n16 CounterOffset[32];
+  auto counterReset() -> void;
   auto counterTick() -> void;
   auto counterPoll(u32 rate) -> bool;
+  auto counterAdvance(u32 rate) -> void;
 
   //envelope.cpp
   auto envelopeRun(Voice& v) -> void;
 
   //brr.cpp
+  static const s16 BRRScaleTable[16][16];
   auto brrDecode(Voice& v) -> void;
+  auto brrDecodeCached(Voice& v, s32 nybbles) -> void;
+  auto brrDecodeSamples(Voice& v, s32 nybbles) -> void;
+  template<u32 Filter> auto brrDecodeFilter(Voice& v, s32 nybbles, const s16* scaled) -> void;
 
   //misc.cpp
   auto misc27() -> void;
@@ -152,6 +404,7 @@ private:
 
   //voice.cpp
   auto voiceOutput(Voice& v, n1 channel) -> void;
+  auto mixVoices() -> void;
   auto voice1 (Voice& v) -> void;
   auto voice2 (Voice& v) -> void;
   auto voice3 (Voice& v) -> void;
@@ -164,10 +417,15 @@ private:
   auto voice7 (Voice& v) -> void;
   auto voice8 (Voice& v) -> void;
   auto voice9 (Voice& v) -> void;
+  auto brrAdvance(Voice& v) -> void;
+  auto voiceSleepStart(Voice& v) -> void;
+  auto voiceSleepEnd(Voice& v) -> void;
+  auto voiceLogic(Voice& v) -> void;
 
   //echo.cpp
   auto calculateFIR(n1 channel, s32 index) -> s32;
-  auto echoOutput(n1 channel) const -> i16;
+  auto calculateFIRTaps() -> void;
+  auto echoOutput(n1 channel) -> i16;
   auto echoRead(n1 channel) -> void;
   auto echoWrite(n1 channel) -> void;
   auto echo22() -> void;
@@ -181,8 +439,18 @@ private:
   auto echo30() -> void;
 
   //dsp.cpp
+  template<u32 Phase> auto clockPhase() -> void;
+  template<u32... Phases> auto clockPhases(std::integer_sequence<u32, Phases...>) -> void;
   auto main(u32 phase) -> void;
+  auto mainSample() -> void;
+  auto canSleep() const -> bool;
+  auto sleepSample() -> void;
+  auto logicPhase(u32 phase) -> void;
+  auto logicSample() -> void;
   auto sample(i16 left, i16 right) -> void;
+
+  //times the private stages directly (examples/microbenchmarks.cpp)
+  friend struct DSPMicrobenchmarks;
 };
 
 }
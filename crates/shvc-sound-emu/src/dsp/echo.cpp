@@ -1,50 +1,99 @@
 auto DSP::calculateFIR(n1 channel, s32 index) -> s32 {
-  s32 sample = echo.history[channel][(n3)(echo._historyOffset + index + 1)];
+  s32 sample = echo.history[channel][echo._historyOffset + index + 1];
   return (sample * echo.fir[index]) >> 6;
 }
 
-auto DSP::echoOutput(n1 channel) const -> i16 {
+//calculates every tap of both channels at once
+//(tap 7 depends on the right sample read in echo23 and is recalculated in echo25)
+auto DSP::calculateFIRTaps() -> void {
+  #if !defined(SHVC_SOUND_EMU_NALL_DSP_STATE) && (defined(__SSE2__) || defined(_M_AMD64))
+  __m128i fir = _mm_loadl_epi64((const __m128i*)echo.fir);
+  fir = _mm_srai_epi16(_mm_unpacklo_epi8(fir, fir), 8);
+  for(u32 channel : range(2)) {
+    __m128i history = _mm_loadu_si128((const __m128i*)&echo.history[channel][echo._historyOffset + 1]);
+    __m128i lo = _mm_mullo_epi16(history, fir);
+    __m128i hi = _mm_mulhi_epi16(history, fir);
+    _mm_storeu_si128((__m128i*)&echo._firTaps[channel][0], _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 6));
+    _mm_storeu_si128((__m128i*)&echo._firTaps[channel][4], _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 6));
+  }
+  #elif !defined(SHVC_SOUND_EMU_NALL_DSP_STATE) && (defined(__ARM_NEON) || defined(_M_ARM64))
+  int16x8_t fir = vmovl_s8(vld1_s8(echo.fir));
+  for(u32 channel : range(2)) {
+    int16x8_t history = vld1q_s16(&echo.history[channel][echo._historyOffset + 1]);
+    vst1q_s32(&echo._firTaps[channel][0], vshrq_n_s32(vmull_s16(vget_low_s16 (history), vget_low_s16 (fir)), 6));
+    vst1q_s32(&echo._firTaps[channel][4], vshrq_n_s32(vmull_s16(vget_high_s16(history), vget_high_s16(fir)), 6));
+  }
+  #else
+  for(u32 channel : range(2)) {
+    for(u32 index : range(8)) echo._firTaps[channel][index] = calculateFIR(channel, index);
+  }
+  #endif
+}
+
+auto DSP::echoOutput(n1 channel) -> i16 {
   i16 mainvolOutput = mainvol.output[channel] * mainvol.volume[channel] >> 7;
     i16 echoOutput =    echo.input[channel] *   echo.volume[channel] >> 7;
-  return sclamp<16>(mainvolOutput + echoOutput);
+  return clip(mainvolOutput + echoOutput, clipping.output[channel]);
 }
 
 auto DSP::echoRead(n1 channel) -> void {
   n16 address = echo._address + channel * 2;
+  markAccess(address, AccessRead);
+  markAccess(n16(address + 1), AccessRead);
   n8 lo = apuram[address++];
   n8 hi = apuram[address++];
   s32 s = (i16)((hi << 8) + lo);
-  echo.history[channel][echo._historyOffset] = s >> 1;
+  if(s != echo._lastRead[channel]) {
+    echo._lastRead[channel] = s;
+    echo._repeatedReads[channel] = 0;
+    echo._firTapsConstant = false;
+  }
+  if(echo._repeatedReads[channel] < 8) echo._repeatedReads[channel]++;
+  echo.history[channel][echo._historyOffset + 0] = s >> 1;
+  echo.history[channel][echo._historyOffset + 8] = s >> 1;
 }
 
 auto DSP::echoWrite(n1 channel) -> void {
   if(!echo._readonly) {
     n16 address = echo._address + channel * 2;
     auto sample = echo.output[channel];
-    apuram[address++] = sample.byte(0);
-    apuram[address++] = sample.byte(1);
+    dirtyPages[address >> 8] = true;  //echo samples are word aligned
+    if(!echoGuard.hit && (echoGuarded(address) || echoGuarded(address + 1))) {
+      echoGuard.hit = true;
+      echoGuard.address = echoGuarded(address) ? address : n16(address + 1);
+      echoGuard.clock = timing.clock;
+    }
+    markAccess(address, AccessWrite);
+    markAccess(n16(address + 1), AccessWrite);
+    apuram[address++] = n8(sample >> 0);
+    apuram[address++] = n8(sample >> 8);
   }
   echo.output[channel] = 0;
 }
 
 auto DSP::echo22() -> void {
   //history
-  echo._historyOffset++;
+  echo._historyOffset = echo._historyOffset + 1 & 7;
 
   echo._address = (echo._page << 8) + echo._offset;
   echoRead(0);
 
   //FIR
-  s32 l = calculateFIR(0, 0);
-  s32 r = calculateFIR(1, 0);
+  //(the taps do not change while both histories are constant)
+  if(!fastPaths || !echo._firTapsConstant) {
+    calculateFIRTaps();
+    echo._firTapsConstant = echo._repeatedReads[0] >= 8 && echo._repeatedReads[1] >= 8;
+  }
+  s32 l = echo._firTaps[0][0];
+  s32 r = echo._firTaps[1][0];
 
   echo.input[0] = l;
   echo.input[1] = r;
 }
 
 auto DSP::echo23() -> void {
-  s32 l = calculateFIR(0, 1) + calculateFIR(0, 2);
-  s32 r = calculateFIR(1, 1) + calculateFIR(1, 2);
+  s32 l = echo._firTaps[0][1] + echo._firTaps[0][2];
+  s32 r = echo._firTaps[1][1] + echo._firTaps[1][2];
 
   echo.input[0] += l;
   echo.input[1] += r;
@@ -53,16 +102,16 @@ auto DSP::echo23() -> void {
 }
 
 auto DSP::echo24() -> void {
-  s32 l = calculateFIR(0, 3) + calculateFIR(0, 4) + calculateFIR(0, 5);
-  s32 r = calculateFIR(1, 3) + calculateFIR(1, 4) + calculateFIR(1, 5);
+  s32 l = echo._firTaps[0][3] + echo._firTaps[0][4] + echo._firTaps[0][5];
+  s32 r = echo._firTaps[1][3] + echo._firTaps[1][4] + echo._firTaps[1][5];
 
   echo.input[0] += l;
   echo.input[1] += r;
 }
 
 auto DSP::echo25() -> void {
-  s32 l = echo.input[0] + calculateFIR(0, 6);
-  s32 r = echo.input[1] + calculateFIR(1, 6);
+  s32 l = echo.input[0] + echo._firTaps[0][6];
+  s32 r = echo.input[1] + echo._firTaps[1][6];
 
   l = (i16)l;
   r = (i16)r;
@@ -70,24 +119,27 @@ auto DSP::echo25() -> void {
   l += (i16)calculateFIR(0, 7);
   r += (i16)calculateFIR(1, 7);
 
-  echo.input[0] = sclamp<16>(l) & ~1;
-  echo.input[1] = sclamp<16>(r) & ~1;
+  echo.input[0] = clip(l, clipping.fir[0]) & ~1;
+  echo.input[1] = clip(r, clipping.fir[1]) & ~1;
 }
 
 auto DSP::echo26() -> void {
   //left output volumes
   //(save sample for next clock so we can output both together)
-  mainvol.output[0] = echoOutput(0);
+  if(!fastForward) mainvol.output[0] = echoOutput(0);
 
   //echo feedback
   s32 l = echo.output[0] + i16(echo.input[0] * echo.feedback >> 7);
   s32 r = echo.output[1] + i16(echo.input[1] * echo.feedback >> 7);
 
-  echo.output[0] = sclamp<16>(l) & ~1;
-  echo.output[1] = sclamp<16>(r) & ~1;
+  echo.output[0] = clip(l, clipping.feedback[0]) & ~1;
+  echo.output[1] = clip(r, clipping.feedback[1]) & ~1;
 }
 
 auto DSP::echo27() -> void {
+  //main volume output is not mixed when fast-forwarding
+  if(fastForward) return;
+
   s32 outl = mainvol.output[0];
   s32 outr = echoOutput(1);
   mainvol.output[0] = 0;
@@ -100,6 +152,14 @@ auto DSP::echo27() -> void {
     outr = 0;
   }
 
+  if constexpr(Instrumentation::enabled) {
+    meters.peak[0] = max(meters.peak[0], (u32)abs(outl));
+    meters.peak[1] = max(meters.peak[1], (u32)abs(outr));
+    meters.squares[0] += outl * outl;
+    meters.squares[1] += outr * outr;
+    meters.samples++;
+  }
+
   //output sample to DAC
   sample(outl, outr);
 }
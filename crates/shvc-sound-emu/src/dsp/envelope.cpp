@@ -1,25 +1,32 @@
 auto DSP::envelopeRun(Voice& v) -> void {
+  //parked envelope (sustain or GAIN rate 0, direct GAIN, GAIN at a limit, release at 0)
+  if(fastPaths && v._envelopeStable) return;
+
   s32 envelope = v.envelope;
 
   if(v.envelopeMode == Envelope::Release) {  //60%
     envelope -= 0x8;
     if(envelope < 0) envelope = 0;
+    v._envelopeStable = envelope == v.envelope;
     v.envelope = envelope;
     return;
   }
 
+  const u32 mode = v.envelopeMode;
+  const s32 previous = v._envelope;
+
   s32 rate;
   s32 envelopeData = v.adsr1;
-  if(latch.adsr0.bit(7)) {  //99% ADSR
+  if(latch.adsr0 & 0x80) {  //99% ADSR
     if(v.envelopeMode >= Envelope::Decay) {  //99%
       envelope--;
       envelope -= envelope >> 8;
       rate = envelopeData & 0x1f;
       if(v.envelopeMode == Envelope::Decay) {  //1%
-        rate = latch.adsr0.bit(4,6) * 2 + 16;
+        rate = (latch.adsr0 >> 4 & 7) * 2 + 16;
       }
     } else {  //env_attack
-      rate = latch.adsr0.bit(0,3) * 2 + 1;
+      rate = (latch.adsr0 & 0x0f) * 2 + 1;
       envelope += rate < 31 ? 0x20 : 0x400;
     }
   } else {  //GAIN
@@ -56,5 +63,70 @@ auto DSP::envelopeRun(Voice& v) -> void {
     if(v.envelopeMode == Envelope::Attack) v.envelopeMode = Envelope::Decay;
   }
 
+  //the next run has the same inputs and the same result if nothing changed,
+  //whether or not the counter event triggers
+  v._envelopeStable = (rate == 0 || envelope == v.envelope) && v.envelopeMode == mode
+                   && v._envelope == previous && latch.adsr0 == v.adsr0;
+
   if(counterPoll(rate)) v.envelope = envelope;
 }
+
+//traces the envelopes of voices keyed on at sample 0, running only the KON delay, envelopeRun
+//and the counter (the BRR decoder, mixer and echo are not emulated).
+//writes `samples` envelope levels (0-2047, the level applied to each output sample) per trace to
+//`out` (trace-major).
+//
+//up to eight traces share each pass over the counter, as the voices of a S-DSP do.
+//the counter starts at its power-on value: during playback the phase of the counter at key-on
+//depends on when the voice was keyed on, which can delay the first event of a rate by up to a
+//period.  KOFF is only read every other sample during playback, the trace keys off at exactly
+//`keyOffSample`.
+auto DSP::traceEnvelopes(const EnvelopeTrace* traces, u32 count, u32 samples, u16* out) -> void {
+  if(!count || !samples) return;
+
+  auto dsp = std::make_unique<DSP>();
+
+  for(u32 first = 0; first < count; first += 8) {
+    const u32 n = std::min<u32>(8, count - first);
+
+    dsp->clock = {};
+    dsp->counterReset();
+
+    for(u32 i : range(n)) {
+      auto& v = dsp->voice[i];
+      const auto& t = traces[first + i];
+      v = {};
+      v.adsr0 = t.adsr0;
+      v.adsr1 = t.adsr1;
+      v.gain = t.gain;
+      v.keyonDelay = 5;
+      v.envelopeMode = Envelope::Attack;
+      v._envelopeStable = false;
+    }
+
+    for(u32 sample : range(samples)) {
+      dsp->counterTick();
+
+      for(u32 i : range(n)) {
+        auto& v = dsp->voice[i];
+        const auto& t = traces[first + i];
+
+        //envelope is never run during KON (see voice3c)
+        if(v.keyonDelay) {
+          v.envelope = 0;
+          v._envelope = 0;
+          v.keyonDelay--;
+        }
+        out[(u64)(first + i) * samples + sample] = v.envelope;
+
+        if(sample + 1 == t.keyOffSample && v.envelopeMode != Envelope::Release) {
+          v.envelopeMode = Envelope::Release;
+          v._envelopeStable = false;
+        }
+
+        dsp->latch.adsr0 = v.adsr0;
+        if(!v.keyonDelay) dsp->envelopeRun(v);
+      }
+    }
+  }
+}
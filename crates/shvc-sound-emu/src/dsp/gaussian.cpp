@@ -1,39 +1,177 @@
-auto DSP::gaussianConstructTable() -> void {
-  f64 table[512];
-  for(u32 n : range(512)) {
-    f64 k = 0.5 + n;
-    f64 s = (sin(Math::Pi * k * 1.280 / 1024));
-    f64 t = (cos(Math::Pi * k * 2.000 / 1023) - 1) * 0.50;
-    f64 u = (cos(Math::Pi * k * 4.000 / 1023) - 1) * 0.08;
-    f64 r = s * (t + u + 1.0) / k;
-    table[511 - n] = r;
-  }
-  for(u32 phase : range(128)) {
-    f64 sum = 0.0;
-    sum += table[phase +   0];
-    sum += table[phase + 256];
-    sum += table[511 - phase];
-    sum += table[255 - phase];
-    f64 scale = 2048.0 / sum;
-    gaussianTable[phase +   0] = i16(table[phase +   0] * scale + 0.5);
-    gaussianTable[phase + 256] = i16(table[phase + 256] * scale + 0.5);
-    gaussianTable[511 - phase] = i16(table[511 - phase] * scale + 0.5);
-    gaussianTable[255 - phase] = i16(table[255 - phase] * scale + 0.5);
-  }
-}
+//gaussian interpolation kernel, shared by every DSP instance
+//generated with: for n in 0..511: k = 0.5 + n; s = sin(pi * k * 1.280 / 1024);
+//  t = (cos(pi * k * 2.000 / 1023) - 1) * 0.50; u = (cos(pi * k * 4.000 / 1023) - 1) * 0.08;
+//  table[511 - n] = s * (t + u + 1.0) / k;
+//then each group of four taps {phase, phase + 256, 511 - phase, 255 - phase} is scaled to sum to 2048 and rounded
+//and packed in the order they are applied: GaussianTaps[phase] = {table[255 - phase], table[511 - phase],
+//  table[256 + phase], table[phase]}
+
+alignas(8) const s16 DSP::GaussianTaps[256][4] = {
+  { 370, 1305,  374,    0}, { 366, 1305,  378,    0}, { 362, 1304,  381,    0}, { 358, 1304,  385,    0},
+  { 354, 1304,  389,    0}, { 351, 1304,  393,    0}, { 347, 1304,  397,    0}, { 343, 1303,  401,    0},
+  { 339, 1303,  405,    0}, { 336, 1303,  410,    0}, { 332, 1302,  414,    0}, { 328, 1302,  418,    0},
+  { 325, 1301,  422,    0}, { 321, 1300,  426,    0}, { 318, 1300,  430,    0}, { 314, 1299,  434,    0},
+  { 311, 1298,  439,    1}, { 307, 1297,  443,    1}, { 304, 1297,  447,    1}, { 300, 1296,  451,    1},
+  { 297, 1295,  456,    1}, { 293, 1294,  460,    1}, { 290, 1293,  464,    1}, { 286, 1292,  469,    1},
+  { 283, 1291,  473,    1}, { 280, 1290,  477,    1}, { 276, 1288,  482,    1}, { 273, 1287,  486,    2},
+  { 270, 1286,  491,    2}, { 267, 1284,  495,    2}, { 263, 1283,  499,    2}, { 260, 1282,  504,    2},
+  { 257, 1280,  508,    2}, { 254, 1279,  513,    2}, { 251, 1277,  517,    3}, { 248, 1275,  522,    3},
+  { 245, 1274,  527,    3}, { 242, 1272,  531,    3}, { 239, 1270,  536,    3}, { 236, 1269,  540,    4},
+  { 233, 1267,  545,    4}, { 230, 1265,  550,    4}, { 227, 1263,  554,    4}, { 224, 1261,  559,    4},
+  { 221, 1259,  563,    5}, { 218, 1257,  568,    5}, { 215, 1255,  573,    5}, { 212, 1253,  577,    5},
+  { 210, 1251,  582,    6}, { 207, 1248,  587,    6}, { 204, 1246,  592,    6}, { 201, 1244,  596,    6},
+  { 199, 1241,  601,    7}, { 196, 1239,  606,    7}, { 193, 1237,  611,    7}, { 191, 1234,  615,    8},
+  { 188, 1232,  620,    8}, { 186, 1229,  625,    8}, { 183, 1227,  630,    9}, { 180, 1224,  635,    9},
+  { 178, 1221,  640,    9}, { 175, 1219,  644,   10}, { 173, 1216,  649,   10}, { 171, 1213,  654,   10},
+  { 168, 1210,  659,   11}, { 166, 1207,  664,   11}, { 163, 1205,  669,   11}, { 161, 1202,  674,   12},
+  { 159, 1199,  678,   12}, { 156, 1196,  683,   13}, { 154, 1193,  688,   13}, { 152, 1190,  693,   14},
+  { 150, 1186,  698,   14}, { 147, 1183,  703,   15}, { 145, 1180,  708,   15}, { 143, 1177,  713,   15},
+  { 141, 1174,  718,   16}, { 139, 1170,  723,   16}, { 137, 1167,  728,   17}, { 134, 1164,  732,   17},
+  { 132, 1160,  737,   18}, { 130, 1157,  742,   19}, { 128, 1153,  747,   19}, { 126, 1150,  752,   20},
+  { 124, 1146,  757,   20}, { 122, 1143,  762,   21}, { 120, 1139,  767,   21}, { 118, 1136,  772,   22},
+  { 117, 1132,  777,   23}, { 115, 1128,  782,   23}, { 113, 1125,  787,   24}, { 111, 1121,  792,   24},
+  { 109, 1117,  797,   25}, { 107, 1113,  802,   26}, { 106, 1109,  806,   27}, { 104, 1106,  811,   27},
+  { 102, 1102,  816,   28}, { 100, 1098,  821,   29}, {  99, 1094,  826,   29}, {  97, 1090,  831,   30},
+  {  95, 1086,  836,   31}, {  94, 1082,  841,   32}, {  92, 1078,  846,   32}, {  90, 1074,  851,   33},
+  {  89, 1070,  855,   34}, {  87, 1066,  860,   35}, {  86, 1061,  865,   36}, {  84, 1057,  870,   36},
+  {  83, 1053,  875,   37}, {  81, 1049,  880,   38}, {  80, 1045,  884,   39}, {  78, 1040,  889,   40},
+  {  77, 1036,  894,   41}, {  76, 1032,  899,   42}, {  74, 1027,  904,   43}, {  73, 1023,  908,   44},
+  {  71, 1019,  913,   45}, {  70, 1014,  918,   46}, {  69, 1010,  923,   47}, {  67, 1005,  927,   48},
+  {  66, 1001,  932,   49}, {  65,  997,  937,   50}, {  64,  992,  941,   51}, {  62,  988,  946,   52},
+  {  61,  983,  951,   53}, {  60,  978,  955,   54}, {  59,  974,  960,   55}, {  58,  969,  965,   56},
+  {  56,  965,  969,   58}, {  55,  960,  974,   59}, {  54,  955,  978,   60}, {  53,  951,  983,   61},
+  {  52,  946,  988,   62}, {  51,  941,  992,   64}, {  50,  937,  997,   65}, {  49,  932, 1001,   66},
+  {  48,  927, 1005,   67}, {  47,  923, 1010,   69}, {  46,  918, 1014,   70}, {  45,  913, 1019,   71},
+  {  44,  908, 1023,   73}, {  43,  904, 1027,   74}, {  42,  899, 1032,   76}, {  41,  894, 1036,   77},
+  {  40,  889, 1040,   78}, {  39,  884, 1045,   80}, {  38,  880, 1049,   81}, {  37,  875, 1053,   83},
+  {  36,  870, 1057,   84}, {  36,  865, 1061,   86}, {  35,  860, 1066,   87}, {  34,  855, 1070,   89},
+  {  33,  851, 1074,   90}, {  32,  846, 1078,   92}, {  32,  841, 1082,   94}, {  31,  836, 1086,   95},
+  {  30,  831, 1090,   97}, {  29,  826, 1094,   99}, {  29,  821, 1098,  100}, {  28,  816, 1102,  102},
+  {  27,  811, 1106,  104}, {  27,  806, 1109,  106}, {  26,  802, 1113,  107}, {  25,  797, 1117,  109},
+  {  24,  792, 1121,  111}, {  24,  787, 1125,  113}, {  23,  782, 1128,  115}, {  23,  777, 1132,  117},
+  {  22,  772, 1136,  118}, {  21,  767, 1139,  120}, {  21,  762, 1143,  122}, {  20,  757, 1146,  124},
+  {  20,  752, 1150,  126}, {  19,  747, 1153,  128}, {  19,  742, 1157,  130}, {  18,  737, 1160,  132},
+  {  17,  732, 1164,  134}, {  17,  728, 1167,  137}, {  16,  723, 1170,  139}, {  16,  718, 1174,  141},
+  {  15,  713, 1177,  143}, {  15,  708, 1180,  145}, {  15,  703, 1183,  147}, {  14,  698, 1186,  150},
+  {  14,  693, 1190,  152}, {  13,  688, 1193,  154}, {  13,  683, 1196,  156}, {  12,  678, 1199,  159},
+  {  12,  674, 1202,  161}, {  11,  669, 1205,  163}, {  11,  664, 1207,  166}, {  11,  659, 1210,  168},
+  {  10,  654, 1213,  171}, {  10,  649, 1216,  173}, {  10,  644, 1219,  175}, {   9,  640, 1221,  178},
+  {   9,  635, 1224,  180}, {   9,  630, 1227,  183}, {   8,  625, 1229,  186}, {   8,  620, 1232,  188},
+  {   8,  615, 1234,  191}, {   7,  611, 1237,  193}, {   7,  606, 1239,  196}, {   7,  601, 1241,  199},
+  {   6,  596, 1244,  201}, {   6,  592, 1246,  204}, {   6,  587, 1248,  207}, {   6,  582, 1251,  210},
+  {   5,  577, 1253,  212}, {   5,  573, 1255,  215}, {   5,  568, 1257,  218}, {   5,  563, 1259,  221},
+  {   4,  559, 1261,  224}, {   4,  554, 1263,  227}, {   4,  550, 1265,  230}, {   4,  545, 1267,  233},
+  {   4,  540, 1269,  236}, {   3,  536, 1270,  239}, {   3,  531, 1272,  242}, {   3,  527, 1274,  245},
+  {   3,  522, 1275,  248}, {   3,  517, 1277,  251}, {   2,  513, 1279,  254}, {   2,  508, 1280,  257},
+  {   2,  504, 1282,  260}, {   2,  499, 1283,  263}, {   2,  495, 1284,  267}, {   2,  491, 1286,  270},
+  {   2,  486, 1287,  273}, {   1,  482, 1288,  276}, {   1,  477, 1290,  280}, {   1,  473, 1291,  283},
+  {   1,  469, 1292,  286}, {   1,  464, 1293,  290}, {   1,  460, 1294,  293}, {   1,  456, 1295,  297},
+  {   1,  451, 1296,  300}, {   1,  447, 1297,  304}, {   1,  443, 1297,  307}, {   1,  439, 1298,  311},
+  {   0,  434, 1299,  314}, {   0,  430, 1300,  318}, {   0,  426, 1300,  321}, {   0,  422, 1301,  325},
+  {   0,  418, 1302,  328}, {   0,  414, 1302,  332}, {   0,  410, 1303,  336}, {   0,  405, 1303,  339},
+  {   0,  401, 1303,  343}, {   0,  397, 1304,  347}, {   0,  393, 1304,  351}, {   0,  389, 1304,  354},
+  {   0,  385, 1304,  358}, {   0,  381, 1304,  362}, {   0,  378, 1305,  366}, {   0,  374, 1305,  370},
+};
 
 auto DSP::gaussianInterpolate(const Voice& v) -> s32 {
-  //make pointers into gaussian table based on fractional position between samples
-  n8 offset = v.gaussianOffset >> 4;
-  const i16* forward = gaussianTable + 255 - offset;
-  const i16* reverse = gaussianTable       + offset;  //mirror left half of gaussian table
+  //select the kernel and the four samples it is applied to based on fractional position between samples
+  //(the buffer is mirrored, the four samples are always contiguous)
+  const s16* taps = GaussianTaps[v.gaussianOffset >> 4 & 0xff];
+  const auto* samples = &v.buffer[(v.bufferOffset + (v.gaussianOffset >> 12)) % 12];
 
-  offset = (v.bufferOffset + (v.gaussianOffset >> 12)) % 12;
+  //each product is shifted before it is added, the sum of the first three wraps to 16 bits
   s32 output;
-  output  = forward[  0] * v.buffer[offset] >> 11; if(++offset >= 12) offset = 0;
-  output += forward[256] * v.buffer[offset] >> 11; if(++offset >= 12) offset = 0;
-  output += reverse[256] * v.buffer[offset] >> 11; if(++offset >= 12) offset = 0;
+  #if !defined(SHVC_SOUND_EMU_NALL_DSP_STATE) && (defined(__SSE2__) || defined(_M_AMD64))
+  __m128i t = _mm_loadl_epi64((const __m128i*)taps);
+  __m128i x = _mm_loadl_epi64((const __m128i*)samples);
+  __m128i p = _mm_srai_epi32(_mm_unpacklo_epi16(_mm_mullo_epi16(t, x), _mm_mulhi_epi16(t, x)), 11);
+  __m128i p01 = _mm_add_epi32(p, _mm_shuffle_epi32(p, _MM_SHUFFLE(3, 3, 3, 1)));
+  output  = _mm_cvtsi128_si32(p01) + _mm_cvtsi128_si32(_mm_shuffle_epi32(p, _MM_SHUFFLE(3, 3, 3, 2)));
+  output  = i16(output);
+  output += _mm_cvtsi128_si32(_mm_shuffle_epi32(p, _MM_SHUFFLE(3, 3, 3, 3)));
+  #elif !defined(SHVC_SOUND_EMU_NALL_DSP_STATE) && (defined(__ARM_NEON) || defined(_M_ARM64))
+  int32x4_t p = vshrq_n_s32(vmull_s16(vld1_s16(taps), vld1_s16(samples)), 11);
+  output  = vgetq_lane_s32(p, 0) + vgetq_lane_s32(p, 1) + vgetq_lane_s32(p, 2);
   output  = i16(output);
-  output += reverse[  0] * v.buffer[offset] >> 11;
+  output += vgetq_lane_s32(p, 3);
+  #else
+  output  = taps[0] * samples[0] >> 11;
+  output += taps[1] * samples[1] >> 11;
+  output += taps[2] * samples[2] >> 11;
+  output  = i16(output);
+  output += taps[3] * samples[3] >> 11;
+  #endif
   return sclamp<16>(output) & ~1;
 }
+
+//decodes the sample with brrDecodeSamples() and applies gaussianInterpolate() at every position a
+//voice playing the sample at each pitch would interpolate, returning true if the sum of the first
+//three products wraps (the overflow glitch) at any of them.
+//
+//the position starts at 0 after the KON delay and advances by the pitch every sample (as it does
+//without pitch modulation).  only the positions where the first three samples are loud enough to
+//wrap are interpolated.
+auto DSP::scanGaussianOverflow(const GaussianOverflowScan& scan) -> bool {
+  if(scan.size < 9 || !scan.pitchCount) return false;
+
+  //the KON delay decodes the first three quads before the first output sample, so the first
+  //output interpolates samples 0-3 (at fractional position 0)
+  std::vector<s16> samples;
+  samples.reserve((scan.size / 9) * 16 * (1 + (scan.looping ? scan.loops : 0)));
+  {
+    auto dsp = std::make_unique<DSP>();
+    Voice& v = dsp->voice[0];
+    v = {};
+
+    auto decode = [&](u32 from) {
+      for(u32 b = from; b + 9 <= scan.size; b += 9) {
+        dsp->brr._header = scan.brr[b];
+        for(u32 n = 1; n < 9; n += 2) {
+          const u32 offset = v.bufferOffset;
+          dsp->brrDecodeSamples(v, scan.brr[b + n] << 8 | scan.brr[b + n + 1]);
+          for(u32 i : range(4)) samples.push_back(v.buffer[offset + i]);
+        }
+      }
+    };
+    decode(0);
+    if(scan.looping && scan.loopOffset < scan.size) {
+      for(u32 l : range(scan.loops)) { (void)l; decode(scan.loopOffset); }
+    }
+  }
+
+  //the windows where the first three products can wrap (every tap set sums to about 2048)
+  std::vector<u32> windows;
+  for(u32 i = 0; i + 3 < samples.size(); i++) {
+    const s32 c = std::abs(samples[i]) + std::abs(samples[i + 1]) + std::abs(samples[i + 2]);
+    if(c >= 0x7fe0) windows.push_back(i);
+  }
+  if(windows.empty()) return false;
+
+  auto dsp = std::make_unique<DSP>();
+  Voice& v = dsp->voice[0];
+  v = {};
+
+  for(u32 p : range(scan.pitchCount)) {
+    const u64 pitch = scan.pitches[p] & 0x3fff;
+    if(!pitch) continue;
+
+    for(u32 w : windows) {
+      //the outputs whose integer sample position is w
+      for(u64 k = ((u64)w << 12) / pitch; k * pitch < (u64)(w + 1) << 12; k++) {
+        const u64 position = k * pitch;
+        if(position >> 12 != w) continue;
+
+        for(u32 i : range(4)) v.buffer[i] = samples[w + i];
+        v.bufferOffset = 0;
+        v.gaussianOffset = position & 0xfff;
+
+        const s16* taps = GaussianTaps[v.gaussianOffset >> 4 & 0xff];
+        s32 expected = 0;
+        for(u32 i : range(4)) expected += taps[i] * samples[w + i] >> 11;
+        if(dsp->gaussianInterpolate(v) != (sclamp<16>(expected) & ~1)) return true;
+      }
+    }
+  }
+
+  return false;
+}
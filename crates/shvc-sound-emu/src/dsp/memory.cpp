@@ -3,7 +3,11 @@ auto DSP::read(n7 address) -> n8 {
 }
 
 auto DSP::write(n7 address, n8 data) -> void {
+  if(logWrites) registerLog.push_back({timing.clock, (u16)address, (u8)data});
+
   registers[address] = data;
+  registerChanged(address);
+  sleep.written = true;
 
   switch(address) {
   case 0x0c:  //MVOLL
@@ -19,11 +23,11 @@ auto DSP::write(n7 address, n8 data) -> void {
     echo.volume[1] = data;
     break;
   case 0x4c:  //KON
-    for(u32 n : range(8)) voice[n].keyon = data.bit(n);
-    for(u32 n : range(8)) voice[n]._keylatch = data.bit(n);
+    flags.keyon = data;
+    flags._keylatch = data;
     break;
   case 0x5c:  //KOFF
-    for(u32 n : range(8)) voice[n].keyoff = data.bit(n);
+    flags.keyoff = data;
     break;
   case 0x6c:  //FLG
     noise.frequency = data.bit(0,4);
@@ -32,21 +36,20 @@ auto DSP::write(n7 address, n8 data) -> void {
     mainvol.reset    = data.bit(7);
     break;
   case 0x7c:  //ENDX
-    for(u32 n : range(8)) voice[n]._end = 0;
+    flags._end = 0;
     registers[0x7c] = 0;  //always cleared, regardless of data written
     break;
   case 0x0d:  //EFB
     echo.feedback = data;
     break;
   case 0x2d:  //PMON
-    for(u32 n : range(8)) voice[n].modulate = data.bit(n);
-    voice[0].modulate = 0;  //voice 0 does not support modulation
+    flags.modulate = data & ~1;  //voice 0 does not support modulation
     break;
   case 0x3d:  //NON
-    for(u32 n : range(8)) voice[n].noise = data.bit(n);
+    flags.noise = data;
     break;
   case 0x4d:  //EON
-    for(u32 n : range(8)) voice[n].echo = data.bit(n);
+    flags.echo = data;
     break;
   case 0x5d:  //DIR
     brr.bank = data;
@@ -63,27 +66,32 @@ auto DSP::write(n7 address, n8 data) -> void {
   switch((n4)address) {
   case 0x00:  //VxVOLL
     voice[n].volume[0] = data;
+    mix.volume[0][n] = (s8)data;
     break;
   case 0x01:  //VxVOLR
     voice[n].volume[1] = data;
+    mix.volume[1][n] = (s8)data;
     break;
   case 0x02:  //VxPITCHL
-    voice[n].pitch.bit(0,7) = data.bit(0,7);
+    voice[n].pitch = voice[n].pitch & 0x3f00 | data;
     break;
   case 0x03:  //VxPITCHH
-    voice[n].pitch.bit(8,13) = data.bit(0,5);
+    voice[n].pitch = voice[n].pitch & 0x00ff | (data & 0x3f) << 8;
     break;
   case 0x04:  //VxSRCN
     voice[n].source = data;
     break;
   case 0x05:  //VxADSR0
     voice[n].adsr0 = data;
+    voice[n]._envelopeStable = false;
     break;
   case 0x06:  //VxADSR1
     voice[n].adsr1 = data;
+    voice[n]._envelopeStable = false;
     break;
   case 0x07:  //VxGAIN
     voice[n].gain = data;
+    voice[n]._envelopeStable = false;
     break;
   case 0x08:  //VxENVX
     latch.envx = data;
@@ -93,6 +101,87 @@ auto DSP::write(n7 address, n8 data) -> void {
     break;
   case 0x0f:  //FIRx
     echo.fir[n] = data;
+    echo._firTapsConstant = false;
+    //the taps are cached for the whole sample, keep them in sync with mid-sample writes
+    echo._firTaps[0][n] = calculateFIR(0, n);
+    echo._firTaps[1][n] = calculateFIR(1, n);
     break;
   }
 }
+
+//restores every register from a snapshot (such as a .spc file)
+//ENDX is restored instead of cleared, KON is written like any other register
+auto DSP::loadRegisters(const std::array<uint8_t, 128>& data) -> void {
+  for(u32 address : range(128)) write(address, data[address]);
+
+  registers[0x7c] = data[0x7c];
+  flags._end = data[0x7c];
+}
+
+//the SMP runs ahead of the DSP and only synchronizes it before accessing a shared page,
+//so this must cover every apuram access the DSP can make in the next SharedPagesWindow samples.
+//with pitch modulation a voice can decode at most 8 BRR samples (half a block) per sample.
+auto DSP::updateSharedPages() -> void {
+  static constexpr u32 BRRWindow = (SharedPagesWindow / 2 + 2) * 9;
+
+  sharedPages.fill(false);
+  timing.sharedPagesUntil = timing.clock + SharedPagesWindow * 32;
+
+  auto mark = [&](u32 address, u32 length) {
+    for(u32 page = address >> 8; page <= (address + length - 1) >> 8; page++) {
+      sharedPages[page & 0xff] = true;
+    }
+  };
+
+  //echo buffer
+  u32 length = max(4u, max((u32)echo._length, (u32)echo.delay << 11));
+  mark(echo.page << 8, length);
+  mark(echo._page << 8, length);
+
+  //logicOnly voices do not access apuram
+  if(logicOnly) return;
+
+  //sample directory and everything reachable from the start/loop blocks of every source in use
+  for(u32 bank : {(u32)brr.bank, (u32)brr._bank}) {
+    mark(bank << 8, 0x400);
+
+    auto markSource = [&](u32 source) {
+      n16 entry = (bank << 8) + (source << 2);
+      for(u32 n : range(2)) {
+        n16 address = apuram[entry] | apuram[n16(entry + 1)] << 8;
+        mark(address, BRRWindow);
+        entry += 2;
+      }
+    };
+    for(auto& v : voice) markSource(v.source);
+    markSource(brr._source);
+  }
+
+  //the blocks following the current block of every voice
+  for(auto& v : voice) mark(v.brrAddress, BRRWindow);
+  mark(brr._nextAddress, BRRWindow);
+}
+
+//update sharedPages if it does not cover the next `samples` samples
+auto DSP::refreshSharedPages(u32 samples) -> void {
+  if(timing.clock + samples * 32 > timing.sharedPagesUntil) updateSharedPages();
+}
+
+//true if writing to `address` can change sharedPages.
+//the echo buffer and the current BRR blocks are only moved by S-DSP register writes and the DSP
+//itself, the only apuram bytes sharedPages reads are the directory entries of the sources in use.
+auto DSP::sharedPagesDependOn(n16 address) const -> bool {
+  if(logicOnly) return false;
+
+  for(u32 bank : {(u32)brr.bank, (u32)brr._bank}) {
+    n16 offset = address - (bank << 8);
+    if(offset >= 0x400) continue;
+
+    u32 source = offset >> 2;
+    if(source == brr._source) return true;
+    for(auto& v : voice) {
+      if(source == v.source) return true;
+    }
+  }
+  return false;
+}
@@ -1,22 +1,24 @@
 auto DSP::misc27() -> void {
-  for(auto& v : voice) v._modulate = v.modulate;
+  flags._modulate = flags.modulate;
 }
 
 auto DSP::misc28() -> void {
-  for(auto& v : voice) v._noise = v.noise, v._echo  = v.echo;
+  flags._noise = flags.noise;
+  flags._echo  = flags.echo;
   brr._bank = brr.bank;
 }
 
 auto DSP::misc29() -> void {
   clock.sample = !clock.sample;
   if(clock.sample) {  //clears KON 63 clocks after it was last read
-    for(auto& v : voice) v._keylatch &= !v._keyon;
+    flags._keylatch &= ~flags._keyon;
   }
 }
 
 auto DSP::misc30() -> void {
   if(clock.sample) {
-    for(auto& v : voice) v._keyon = v._keylatch, v._keyoff = v.keyoff;
+    flags._keyon  = flags._keylatch;
+    flags._keyoff = flags.keyoff;
   }
 
   counterTick();
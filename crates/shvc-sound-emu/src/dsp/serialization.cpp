@@ -0,0 +1,117 @@
+auto DSP::serialize(serializer& s) -> void {
+  for(auto& byte : registers) s(byte);
+
+  s(timing.pendingSmpClocks);
+  s(timing.clock);
+
+  s(clock.counter);
+  s(clock.sample);
+  s(clock.ticks);
+  //the events are advanced lazily, advance them all so the state does not depend on which rates
+  //were polled (skipped envelope updates do not poll)
+  if(s.writing()) {
+    for(u32 rate : range(1, 32)) counterAdvance(rate);
+  }
+  s(clock.nextTick);
+
+  s(mainvol.reset);
+  s(mainvol.mute);
+  s(mainvol.volume);
+  s(mainvol.output);
+
+  s(echo.feedback);
+  s(echo.volume);
+  s(echo.fir);
+  s(echo.history);
+  s(echo.page);
+  s(echo.delay);
+  s(echo.readonly);
+  s(echo.input);
+  s(echo.output);
+  s(echo._page);
+  s(echo._readonly);
+  s(echo._address);
+  s(echo._offset);
+  s(echo._length);
+  s(echo._historyOffset);
+  s(echo._firTaps);
+  if(s.reading()) {
+    //the loaded history may not be constant
+    echo._repeatedReads[0] = 0;
+    echo._repeatedReads[1] = 0;
+    echo._firTapsConstant = false;
+  }
+
+  s(noise.frequency);
+  s(noise.lfsr);
+
+  s(brr.bank);
+  s(brr._bank);
+  s(brr._source);
+  s(brr._address);
+  s(brr._nextAddress);
+  s(brr._header);
+  s(brr._byte);
+
+  s(latch.adsr0);
+  s(latch.envx);
+  s(latch.outx);
+  s(latch.pitch);
+  s(latch.output);
+
+  serializeVoices(s);
+
+  if(s.reading()) sleep = {};
+}
+
+//the internal voice state (the voice registers are not serialized)
+auto DSP::serializeVoices(serializer& s) -> void {
+  for(auto& v : voice) {
+    s(v._envelope);
+    for(u32 n : range(12)) s(v.buffer[n]);
+    if(s.reading()) {
+      for(u32 n : range(12)) v.buffer[n + 12] = v.buffer[n];
+    }
+    s(v.gaussianOffset);
+    s(v.brrAddress);
+    s(v.pitch);
+    s(v.envelope);
+    s(v.volume);
+    if(s.reading()) {
+      mix.volume[0][&v - voice] = v.volume[0];
+      mix.volume[1][&v - voice] = v.volume[1];
+    }
+    s(v.bufferOffset);
+    s(v.brrOffset);
+    s(v.keyonDelay);
+    s(v.envelopeMode);
+    s(v.adsr0);
+    s(v.adsr1);
+    s(v.gain);
+    s(v.envx);
+    s(v.source);
+    //the voice flags are serialized per voice
+    const u32 n = &v - voice;
+    auto flag = [&](dn8& mask) {
+      dn1 bit = mask >> n & 1;
+      s(bit);
+      if(s.reading()) mask = mask & ~(1 << n) | (u32)bit << n;
+    };
+    flag(flags._keylatch);
+    flag(flags._keyon);
+    flag(flags._keyoff);
+    flag(flags._modulate);
+    flag(flags._noise);
+    flag(flags._echo);
+    flag(flags._end);
+    s(v._looped);
+    flag(flags.keyon);
+    flag(flags.keyoff);
+    flag(flags.modulate);
+    flag(flags.noise);
+    flag(flags.echo);
+    flag(flags.end);
+    s(v.index);
+    if(s.reading()) v._envelopeStable = false;
+  }
+}
@@ -1,18 +1,112 @@
 inline auto DSP::voiceOutput(Voice& v, n1 channel) -> void {
+  const u32 n = v.index >> 4;
+
+  //both channels are output from the same latch.output, mixed later by mixVoices()
+  if(mix.deferred) {
+    if(channel == 1) mix.output[n] = latch.output;
+    return;
+  }
+
+  //silent voices are also tapped
+  if(Instrumentation::enabled && taps[n].buffer && !fastForward) {
+    auto& tap = taps[n];
+    //-32768 * -128 is the only contribution that does not fit
+    tap.buffer[tap.offset * 2 + channel] = sclamp<16>(latch.output * v.volume[channel] >> 7);
+    if(channel == 1) {
+      if(++tap.offset == tap.frames) tap.offset = 0;
+      tap.written++;
+    }
+  }
+
+  //a silent voice does not change the output totals
+  if(fastPaths && latch.output == 0) return;
+
+  //channel is a constant, metered once per sample
+  if(Instrumentation::enabled && channel == 0 && !fastForward) {
+    const s32 output = latch.output;
+    meters.voicePeak[n] = max(meters.voicePeak[n], (u32)abs(output));
+    meters.voiceSquares[n] += output * output;
+  }
+
+  //muted voices are still tapped and metered
+  if(muteMask >> n & 1) return;
+
   //apply left/right volume
   s32 amp = latch.output * v.volume[channel] >> 7;
 
   //add to output total
-  mainvol.output[channel] += amp;
-  mainvol.output[channel] = sclamp<16>(mainvol.output[channel]);
+  if(!fastForward) {
+    mainvol.output[channel] += amp;
+    mainvol.output[channel] = clip(mainvol.output[channel], clipping.main[channel]);
+  }
 
   //optionally add to echo total
-  if(v._echo) {
+  if(flags._echo >> n & 1) {
     echo.output[channel] += amp;
-    echo.output[channel] = sclamp<16>(echo.output[channel]);
+    echo.output[channel] = clip(echo.output[channel], clipping.echo[channel]);
   }
 }
 
+//mixes the outputs recorded during mainSample() with the same results as voiceOutput(), including
+//the saturation after every voice (voice 0's left output was mixed by voiceOutput() in the previous sample)
+auto DSP::mixVoices() -> void {
+  mix.deferred = false;
+
+  //amplitude of every voice in both channels
+  alignas(16) s32 amp[2][8];
+  #if defined(__SSE2__) || defined(_M_AMD64)
+  __m128i output = _mm_load_si128((const __m128i*)mix.output);
+  for(u32 channel : range(2)) {
+    __m128i volume = _mm_load_si128((const __m128i*)mix.volume[channel]);
+    __m128i lo = _mm_mullo_epi16(output, volume);
+    __m128i hi = _mm_mulhi_epi16(output, volume);
+    _mm_store_si128((__m128i*)&amp[channel][0], _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 7));
+    _mm_store_si128((__m128i*)&amp[channel][4], _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 7));
+  }
+  #elif defined(__ARM_NEON) || defined(_M_ARM64)
+  int16x8_t output = vld1q_s16(mix.output);
+  for(u32 channel : range(2)) {
+    int16x8_t volume = vld1q_s16(mix.volume[channel]);
+    vst1q_s32(&amp[channel][0], vshrq_n_s32(vmull_s16(vget_low_s16 (output), vget_low_s16 (volume)), 7));
+    vst1q_s32(&amp[channel][4], vshrq_n_s32(vmull_s16(vget_high_s16(output), vget_high_s16(volume)), 7));
+  }
+  #else
+  for(u32 channel : range(2)) {
+    for(u32 n : range(8)) amp[channel][n] = mix.output[n] * mix.volume[channel][n] >> 7;
+  }
+  #endif
+
+  if(Instrumentation::enabled && !fastForward) {
+    for(u32 n : range(8)) {
+      if(auto& tap = taps[n]; tap.buffer) {
+        if(n) tap.buffer[tap.offset * 2 + 0] = sclamp<16>(amp[0][n]);
+        tap.buffer[tap.offset * 2 + 1] = sclamp<16>(amp[1][n]);
+        if(++tap.offset == tap.frames) tap.offset = 0;
+        tap.written++;
+      }
+      if(n) {
+        const s32 output = mix.output[n];
+        meters.voicePeak[n] = max(meters.voicePeak[n], (u32)abs(output));
+        meters.voiceSquares[n] += output * output;
+      }
+    }
+  }
+
+  //muted voices are not mixed (silent voices add 0 and do not change the totals)
+  s32 main[2] = {mainvol.output[0], mainvol.output[1]};
+  s32 echoed[2] = {echo.output[0], echo.output[1]};
+  for(u32 channel : range(2)) {
+    for(u32 n : range(channel == 0, 8)) {
+      const s32 a = muteMask >> n & 1 ? 0 : amp[channel][n];
+      if(!fastForward) main[channel] = clip(main[channel] + a, clipping.main[channel]);
+      echoed[channel] = clip(echoed[channel] + (flags._echo >> n & 1 ? a : 0), clipping.echo[channel]);
+    }
+  }
+  if(!fastForward) mainvol.output[0] = main[0], mainvol.output[1] = main[1];
+  echo.output[0] = echoed[0];
+  echo.output[1] = echoed[1];
+}
+
 auto DSP::voice1(Voice& v) -> void {
   brr._address = (brr._bank << 8) + (brr._source << 2);
   brr._source = v.source;
@@ -22,8 +116,11 @@ auto DSP::voice2(Voice& v) -> void {
   //read sample pointer (ignored if not needed)
   n16 address = brr._address;
   if(!v.keyonDelay) address += 2;
-  brr._nextAddress.byte(0) = apuram[address++];
-  brr._nextAddress.byte(1) = apuram[address++];
+  markAccess(address, AccessRead);
+  markAccess(n16(address + 1), AccessRead);
+  n8 lo = apuram[address++];
+  n8 hi = apuram[address++];
+  brr._nextAddress = hi << 8 | lo;
   latch.adsr0 = v.adsr0;
 
   //read pitch, spread over two clocks
@@ -43,13 +140,15 @@ auto DSP::voice3a(Voice& v) -> void {
 auto DSP::voice3b(Voice& v) -> void {
   brr._byte   = apuram[n16(v.brrAddress + v.brrOffset)];
   brr._header = apuram[n16(v.brrAddress)];
+  markAccess(n16(v.brrAddress + v.brrOffset), AccessRead);
+  markAccess(v.brrAddress, AccessRead);
 }
 
 auto DSP::voice3c(Voice& v) -> void {
   //pitch modulation using previous voice's output
 
-  if(v._modulate) {
-    latch.pitch += (latch.output >> 5) * latch.pitch >> 10;
+  if(flags._modulate >> (v.index >> 4) & 1) {
+    latch.pitch = latch.pitch + ((latch.output >> 5) * latch.pitch >> 10) & 0x7fff;
   }
 
   if(v.keyonDelay) {
@@ -64,6 +163,7 @@ auto DSP::voice3c(Voice& v) -> void {
     //envelope is never run during KON
     v.envelope = 0;
     v._envelope = 0;
+    v._envelopeStable = false;
 
     //disable BRR decoding until last three samples
     v.gaussianOffset = 0;
@@ -74,34 +174,50 @@ auto DSP::voice3c(Voice& v) -> void {
     latch.pitch = 0;
   }
 
-  //gaussian interpolation
-  s32 output = gaussianInterpolate(v);
+  if((fastPaths && v.envelope == 0) || (skipMutedInterpolation && muteMask >> (v.index >> 4) & 1)) {
+    //idle voice: the envelope silences the output, no need to interpolate
+    latch.output = 0;
+  } else {
+    //gaussian interpolation
+    s32 output = gaussianInterpolate(v);
 
-  //noise
-  if(v._noise) {
-    output = (i16)(noise.lfsr << 1);
-  }
+    //noise
+    if(flags._noise >> (v.index >> 4) & 1) {
+      output = (i16)(noise.lfsr << 1);
+    }
 
-  //apply envelope
-  latch.output = output * v.envelope >> 11 & ~1;
+    //apply envelope
+    latch.output = output * v.envelope >> 11 & ~1;
+  }
   v.envx = v.envelope >> 4;
 
   //immediate silence due to end of sample or soft reset
-  if(mainvol.reset || brr._header.bit(0,1) == 1) {
+  if(mainvol.reset || (brr._header & 3) == 1) {
+    if(v.envelopeMode != Envelope::Release || v.envelope) v._envelopeStable = false;
     v.envelopeMode = Envelope::Release;
     v.envelope = 0;
   }
 
   if(clock.sample) {
     //KOFF
-    if(v._keyoff) {
+    if(flags._keyoff >> (v.index >> 4) & 1) {
+      if(v.envelopeMode != Envelope::Release) {
+        v._envelopeStable = false;
+        if(logEvents) eventLog.push_back({timing.clock, EventKeyOff, (u8)(v.index >> 4), 0, 0});
+      }
       v.envelopeMode = Envelope::Release;
     }
 
     //KON
-    if(v._keyon) {
+    if(flags._keyon >> (v.index >> 4) & 1) {
+      if(Instrumentation::enabled) {
+        sourceUsage.voiceSource[v.index >> 4] = v.source;
+        sourceUsage.keyOns[v.source]++;
+      }
+      if(logEvents) eventLog.push_back({timing.clock, EventKeyOn, (u8)(v.index >> 4), (u8)v.source, (u16)v.pitch});
       v.keyonDelay = 5;
       v.envelopeMode = Envelope::Attack;
+      v._envelopeStable = false;
     }
   }
 
@@ -110,15 +226,24 @@ auto DSP::voice3c(Voice& v) -> void {
 }
 
 auto DSP::voice4(Voice& v) -> void {
+  brrAdvance(v);
+
+  //output left
+  voiceOutput(v, 0);
+}
+
+inline auto DSP::brrAdvance(Voice& v) -> void {
   //decode BRR
   v._looped = 0;
   if(v.gaussianOffset >= 0x4000) {
     brrDecode(v);
     v.brrOffset += 2;
     if(v.brrOffset >= 9) {
+      if(Instrumentation::enabled) sourceUsage.brrBlocks[sourceUsage.voiceSource[v.index >> 4]]++;
+
       //start decoding next BRR block
       v.brrAddress = n16(v.brrAddress + 9);
-      if(brr._header.bit(0)) {
+      if(brr._header & 1) {
         v.brrAddress = brr._nextAddress;
         v._looped = 1;
       }
@@ -131,9 +256,6 @@ auto DSP::voice4(Voice& v) -> void {
 
   //keep from getting too far ahead (when using pitch modulation)
   if(v.gaussianOffset > 0x7fff) v.gaussianOffset = 0x7fff;
-
-  //output left
-  voiceOutput(v, 0);
 }
 
 auto DSP::voice5(Voice& v) -> void {
@@ -141,10 +263,11 @@ auto DSP::voice5(Voice& v) -> void {
   voiceOutput(v, 1);
 
   //ENDX, OUTX, ENVX won't update if you wrote to them 1-2 clocks earlier
-  v._end |= v._looped;
+  const u32 n = v.index >> 4;
+  flags._end |= v._looped << n;
 
   //clear bit in ENDX if KON just began
-  if(v.keyonDelay == 5) v._end = 0;
+  if(v.keyonDelay == 5) flags._end &= ~(1 << n);
 }
 
 auto DSP::voice6(Voice& v) -> void {
@@ -152,17 +275,84 @@ auto DSP::voice6(Voice& v) -> void {
 }
 
 auto DSP::voice7(Voice& v) -> void {
-  n8 r7c = registers[0x7c];
-  for(u32 n : range(8)) r7c.bit(n) = voice[n]._end;
-  registers[0x7c] = r7c;
+  if(trackVoiceRegisterChanges && registers[0x7c] != flags._end) registerChanged(0x7c);
+  registers[0x7c] = flags._end;
 
   latch.envx = v.envx;
 }
 
 auto DSP::voice8(Voice& v) -> void {
+  if(trackVoiceRegisterChanges && registers[v.index | 0x09] != latch.outx) registerChanged(v.index | 0x09);
   registers[v.index | 0x09] = latch.outx;
 }
 
 auto DSP::voice9(Voice& v) -> void {
+  if(trackVoiceRegisterChanges && registers[v.index | 0x08] != latch.envx) registerChanged(v.index | 0x08);
   registers[v.index | 0x08] = latch.envx;
 }
+
+//the stages of an idle voice in sleepSample(), voice1 to voice4 without the output.
+//the voice is keyed off with a zero envelope: the output, ENVX and OUTX are zero and the end of
+//the sample, soft reset and KOFF do not change it, but BRR decoding continues
+inline auto DSP::voiceSleepStart(Voice& v) -> void {
+  brr._address = (brr._bank << 8) + (v.source << 2);
+  voice2(v);
+  voice3a(v);
+  voice3b(v);
+
+  //pitch modulation by a silent voice does not change the pitch
+  latch.pitch &= 0x7fff;
+  latch.output = 0;
+  v.envx = 0;
+  envelopeRun(v);
+
+  brrAdvance(v);
+}
+
+//the stages of an idle voice in sleepSample(), voice5 to voice9 without the output
+inline auto DSP::voiceSleepEnd(Voice& v) -> void {
+  flags._end |= v._looped << (v.index >> 4);
+  voice6(v);
+  voice7(v);
+  voice8(v);
+  voice9(v);
+}
+
+//the KON, KOFF, soft reset and ENDX logic of voice3c and voice5, without BRR decoding or the envelope
+//(logicOnly mode, the voice is silent)
+inline auto DSP::voiceLogic(Voice& v) -> void {
+  const u32 n = v.index >> 4;
+
+  if(v.keyonDelay) v.keyonDelay--;
+
+  if(mainvol.reset) v.envelopeMode = Envelope::Release;
+
+  if(clock.sample) {
+    //KOFF
+    if(flags._keyoff >> n & 1) {
+      if(v.envelopeMode != Envelope::Release && logEvents) {
+        eventLog.push_back({timing.clock, EventKeyOff, (u8)n, 0, 0});
+      }
+      v.envelopeMode = Envelope::Release;
+    }
+
+    //KON
+    if(flags._keyon >> n & 1) {
+      if(Instrumentation::enabled) {
+        sourceUsage.voiceSource[n] = v.source;
+        sourceUsage.keyOns[v.source]++;
+      }
+      if(logEvents) eventLog.push_back({timing.clock, EventKeyOn, (u8)n, (u8)v.source, (u16)v.pitch});
+      v.keyonDelay = 5;
+      v.envelopeMode = Envelope::Attack;
+    }
+  }
+
+  v.envelope = 0;
+  v._envelopeStable = false;
+
+  //clear bit in ENDX if KON just began
+  if(v.keyonDelay == 5) flags._end &= ~(1 << n);
+  if(trackVoiceRegisterChanges && registers[0x7c] != flags._end) registerChanged(0x7c);
+  registers[0x7c] = flags._end;
+}
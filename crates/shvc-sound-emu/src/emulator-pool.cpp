@@ -0,0 +1,122 @@
+#include <atomic>
+#include <thread>
+
+namespace shvc_sound_emu {
+
+// Independent emulator jobs, run in parallel.
+//
+// The jobs are unrelated and similar in length, so the workers share a single job counter instead
+// of stealing work from per-thread queues.
+//
+// The jobs can share a read-only base Audio-RAM image, which each job overwrites with its own
+// (usually much smaller) Audio-RAM, so a sweep of similar jobs does not hold a 64 KiB image per job.
+// Only one emulator per worker is alive at a time.
+//
+// Each job is a separate ShvcSoundEmu.  Running the DSPs of several jobs in lockstep (one SIMD lane
+// per job) is not possible: the S-SMP reads ENDX, ENVX, OUTX and the echo buffer mid-sample, which
+// forces each lane's DSP to synchronize at a different clock, and the voices branch on
+// per-lane BRR headers, envelope modes and KON/KOFF timing.
+struct EmulatorPool {
+  struct Output {
+    std::vector<int16_t> samples;
+    std::unique_ptr<std::vector<uint8_t>> state;
+  };
+
+  EmulatorPool(rust::Slice<const uint8_t> baseApuram, rust::Slice<const EmulatorJob> jobs)
+    : baseApuram(baseApuram), jobs(jobs), outputs(jobs.size())
+  {}
+
+  auto run(uint32_t nThreads) -> void {
+    if(nThreads == 0) nThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    nThreads = std::min<size_t>(nThreads, jobs.size());
+
+    std::vector<std::thread> workers;
+    for(auto i : range(nThreads)) {
+      (void)i;
+      workers.emplace_back([this] { worker(); });
+    }
+    for(auto& w : workers) w.join();
+  }
+
+  auto results() -> rust::Vec<EmulatorJobResult> {
+    rust::Vec<EmulatorJobResult> out;
+    out.reserve(outputs.size());
+
+    for(auto& o : outputs) {
+      EmulatorJobResult r;
+      r.samples.reserve(o.samples.size());
+      for(auto s : o.samples) r.samples.push_back(s);
+      r.state.reserve(o.state->size());
+      for(auto b : *o.state) r.state.push_back(b);
+      out.push_back(std::move(r));
+    }
+    return out;
+  }
+
+private:
+  auto worker() -> void {
+    while(true) {
+      const size_t i = nextJob.fetch_add(1, std::memory_order_relaxed);
+      if(i >= jobs.size()) return;
+      outputs[i] = runJob(baseApuram, jobs[i]);
+    }
+  }
+
+  static auto runJob(rust::Slice<const uint8_t> base, const EmulatorJob& job) -> Output {
+    // No IPL ROM
+    ShvcSoundEmu emu({});
+
+    auto& apuram = emu.apuram_mut();
+    std::copy_n(base.data(), std::min(base.size(), apuram.size()), apuram.begin());
+    std::copy_n(job.apuram.data(), std::min(job.apuram.size(), apuram.size()), apuram.begin());
+
+    emu.reset(job.registers);
+    emu.set_fast_paths(job.fast_paths);
+
+    Output out;
+    const auto& writes = job.port_writes;
+    size_t nextWrite = 0;
+    uint64_t clock = 0;
+
+    while(clock < job.smp_clocks) {
+      while(nextWrite < writes.size() && writes[nextWrite].smp_clock <= clock) {
+        emu.write_io_ports(writes[nextWrite++].ports);
+      }
+
+      uint64_t until = job.smp_clocks;
+      if(nextWrite < writes.size()) until = std::min(until, writes[nextWrite].smp_clock);
+
+      if(job.output_audio) {
+        const size_t frames = (until - clock + SMP_CLOCKS_PER_SAMPLE - 1) / SMP_CLOCKS_PER_SAMPLE;
+        const size_t offset = out.samples.size();
+        out.samples.resize(offset + frames * 2);
+        emu.emulate_into(out.samples.data() + offset, frames);
+        clock += frames * SMP_CLOCKS_PER_SAMPLE;
+      } else {
+        clock += emu.fast_forward(until - clock);
+      }
+    }
+
+    out.state = emu.save_state();
+    return out;
+  }
+
+  static constexpr uint64_t SMP_CLOCKS_PER_SAMPLE = 64;
+
+  rust::Slice<const uint8_t> baseApuram;
+  rust::Slice<const EmulatorJob> jobs;
+  std::vector<Output> outputs;
+  std::atomic<size_t> nextJob = 0;
+};
+
+auto run_emulator_jobs(rust::Slice<const EmulatorJob> jobs, uint32_t n_threads) -> rust::Vec<EmulatorJobResult> {
+  return run_emulator_jobs_with_base({}, jobs, n_threads);
+}
+
+auto run_emulator_jobs_with_base(rust::Slice<const uint8_t> base_apuram, rust::Slice<const EmulatorJob> jobs, uint32_t n_threads) -> rust::Vec<EmulatorJobResult> {
+  EmulatorPool pool(base_apuram, jobs);
+  pool.run(n_threads);
+  return pool.results();
+}
+
+}
@@ -0,0 +1,141 @@
+//! `ShvcSoundEmu` method call counters and timers (`ffi-stats` feature)
+
+// SPDX-FileCopyrightText: © 2025 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::Mutex;
+use std::time::Instant;
+
+/// Number of calls and cumulative time of a `ShvcSoundEmu` method
+#[derive(Debug, Clone)]
+pub struct FfiMethodStats {
+    pub name: &'static str,
+    pub calls: u64,
+    /// Cumulative wall time spent in the method (including the C++ call), in nanoseconds
+    pub nanoseconds: u64,
+}
+
+impl FfiMethodStats {
+    /// Average nanoseconds per call
+    pub fn average_nanoseconds(&self) -> u64 {
+        self.nanoseconds.checked_div(self.calls).unwrap_or(0)
+    }
+}
+
+/// `ShvcSoundEmu` method statistics of every emulator in the process.
+///
+/// Only methods that have been called are listed, sorted by cumulative time (descending).
+#[derive(Debug, Clone, Default)]
+pub struct FfiStats {
+    pub methods: Vec<FfiMethodStats>,
+}
+
+impl FfiStats {
+    pub fn total_calls(&self) -> u64 {
+        self.methods.iter().map(|m| m.calls).sum()
+    }
+
+    pub fn total_nanoseconds(&self) -> u64 {
+        self.methods.iter().map(|m| m.nanoseconds).sum()
+    }
+}
+
+impl std::fmt::Display for FfiStats {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        writeln!(
+            f,
+            "{:<40} {:>10} {:>14} {:>10}",
+            "method", "calls", "total ns", "avg ns"
+        )?;
+        for m in &self.methods {
+            writeln!(
+                f,
+                "{:<40} {:>10} {:>14} {:>10}",
+                m.name,
+                m.calls,
+                m.nanoseconds,
+                m.average_nanoseconds()
+            )?;
+        }
+        Ok(())
+    }
+}
+
+/// Counters of a single method (one static per instrumented method, see `ffi_stats!`)
+#[doc(hidden)]
+pub struct MethodCounters {
+    name: &'static str,
+    registered: AtomicBool,
+    calls: AtomicU64,
+    nanoseconds: AtomicU64,
+}
+
+static REGISTERED: Mutex<Vec<&'static MethodCounters>> = Mutex::new(Vec::new());
+
+impl MethodCounters {
+    pub const fn new(name: &'static str) -> Self {
+        Self {
+            name,
+            registered: AtomicBool::new(false),
+            calls: AtomicU64::new(0),
+            nanoseconds: AtomicU64::new(0),
+        }
+    }
+
+    pub fn start(&'static self) -> CallTimer {
+        if !self.registered.swap(true, Ordering::Relaxed) {
+            REGISTERED.lock().unwrap().push(self);
+        }
+        CallTimer {
+            counters: self,
+            start: Instant::now(),
+        }
+    }
+}
+
+/// Adds the call and the time since `MethodCounters::start()` to the counters when dropped
+#[doc(hidden)]
+pub struct CallTimer {
+    counters: &'static MethodCounters,
+    start: Instant,
+}
+
+impl Drop for CallTimer {
+    fn drop(&mut self) {
+        let nanos = u64::try_from(self.start.elapsed().as_nanos()).unwrap_or(u64::MAX);
+
+        self.counters.calls.fetch_add(1, Ordering::Relaxed);
+        self.counters
+            .nanoseconds
+            .fetch_add(nanos, Ordering::Relaxed);
+    }
+}
+
+/// Returns the method statistics accumulated since the last `reset_ffi_stats()` call
+pub fn ffi_stats() -> FfiStats {
+    let registered = REGISTERED.lock().unwrap();
+
+    let mut methods: Vec<FfiMethodStats> = registered
+        .iter()
+        .map(|c| FfiMethodStats {
+            name: c.name,
+            calls: c.calls.load(Ordering::Relaxed),
+            nanoseconds: c.nanoseconds.load(Ordering::Relaxed),
+        })
+        .filter(|m| m.calls > 0)
+        .collect();
+
+    methods.sort_by(|a, b| b.nanoseconds.cmp(&a.nanoseconds));
+
+    FfiStats { methods }
+}
+
+/// Clears the method statistics (calls in progress on other threads may be partially counted)
+pub fn reset_ffi_stats() {
+    for c in REGISTERED.lock().unwrap().iter() {
+        c.calls.store(0, Ordering::Relaxed);
+        c.nanoseconds.store(0, Ordering::Relaxed);
+    }
+}
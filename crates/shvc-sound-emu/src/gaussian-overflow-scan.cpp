@@ -0,0 +1,44 @@
+#include <atomic>
+#include <thread>
+
+namespace shvc_sound_emu {
+
+// Gaussian overflow scans of independent BRR samples, run in parallel.
+//
+// Each scan is small and independent (no emulator is created), so the workers share a single
+// scan counter like `EmulatorPool`.
+auto scan_gaussian_overflow(rust::Slice<const GaussianOverflowScan> scans, uint32_t n_threads) -> rust::Vec<bool> {
+  std::vector<uint8_t> results(scans.size());
+  std::atomic<size_t> nextScan = 0;
+
+  auto worker = [&] {
+    while(true) {
+      const size_t i = nextScan.fetch_add(1, std::memory_order_relaxed);
+      if(i >= scans.size()) return;
+
+      const auto& s = scans[i];
+      results[i] = DSP::scanGaussianOverflow({
+        s.brr_data.data(), (u32)s.brr_data.size(),
+        s.looping, s.loop_offset, s.n_loops,
+        s.pitches.data(), (u32)s.pitches.size(),
+      });
+    }
+  };
+
+  if(n_threads == 0) n_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  n_threads = std::min<size_t>(n_threads, scans.size());
+
+  std::vector<std::thread> workers;
+  for(auto i : range(n_threads)) {
+    (void)i;
+    workers.emplace_back(worker);
+  }
+  for(auto& w : workers) w.join();
+
+  rust::Vec<bool> out;
+  out.reserve(results.size());
+  for(auto r : results) out.push_back(r);
+  return out;
+}
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+namespace shvc_sound_emu {
+
+//compile-time instrumentation policy
+//the profiler, watchpoints, audio meters, voice taps, source usage and clipping counters are guarded by
+//`if constexpr(Instrumentation::enabled)`,
+//define SHVC_SOUND_EMU_NO_INSTRUMENTATION to compile them away (their API calls are then ignored)
+struct NoInstrumentation {
+  static constexpr bool enabled = false;
+};
+
+struct FullInstrumentation {
+  static constexpr bool enabled = true;
+};
+
+#if defined(SHVC_SOUND_EMU_NO_INSTRUMENTATION)
+using Instrumentation = NoInstrumentation;
+#else
+using Instrumentation = FullInstrumentation;
+#endif
+
+//the apuram access map (DSP::accessMap) is not part of the default instrumentation as it adds a test to
+//every DSP apuram access, define SHVC_SOUND_EMU_ACCESS_MAP to compile it in
+struct AccessMap {
+#if defined(SHVC_SOUND_EMU_ACCESS_MAP)
+  static constexpr bool enabled = true;
+#else
+  static constexpr bool enabled = false;
+#endif
+};
+
+#if defined(SHVC_SOUND_EMU_GDB_SERVER) && defined(SHVC_SOUND_EMU_NO_INSTRUMENTATION)
+#error "the GDB server requires the watchpoints"
+#endif
+
+}
@@ -3,8 +3,31 @@
 extern crate cxx;
 use cxx::UniquePtr;
 
+use std::ops::RangeInclusive;
+
+mod snapshot_buffer;
+pub use snapshot_buffer::{snapshot_buffer, SnapshotReader, SnapshotWriter};
+
+#[cfg(feature = "ffi-stats")]
+mod ffi_stats;
+#[cfg(feature = "ffi-stats")]
+pub use ffi_stats::{ffi_stats, reset_ffi_stats, FfiMethodStats, FfiStats};
+
+/// Counts and times the enclosing `ShvcSoundEmu` method until the end of the method
+/// (compiled out without the `ffi-stats` feature).
+macro_rules! ffi_stats {
+    ($name:literal) => {
+        #[cfg(feature = "ffi-stats")]
+        let _timer = {
+            static COUNTERS: ffi_stats::MethodCounters = ffi_stats::MethodCounters::new($name);
+            COUNTERS.start()
+        };
+    };
+}
+
 #[cxx::bridge(namespace = "shvc_sound_emu")]
 mod ffi {
+    #[derive(Clone, Copy)]
     pub struct ResetRegisters {
         pub pc: u16,
         pub a: u8,
@@ -18,99 +41,2350 @@ mod ffi {
         pub edl: u8,
     }
 
+    /// S-SMP registers returned by `ShvcSoundEmu::smp_registers()`
+    #[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+    pub struct SmpRegisters {
+        pub pc: u16,
+        pub a: u8,
+        pub x: u8,
+        pub y: u8,
+        pub psw: u8,
+        pub sp: u8,
+    }
+
+    /// Result of a `run_until_*()` call
+    #[derive(Debug, Clone, Copy)]
+    pub struct RunResult {
+        /// Number of S-SMP clocks emulated
+        pub smp_clocks: u64,
+        /// True if the stop condition was reached before the clock limit
+        /// (false if the S-SMP halted, see `ShvcSoundEmu::halted()`)
+        pub hit: bool,
+    }
+
+    /// Result of a `render_to_file()` call
+    #[derive(Debug, Clone, Copy)]
+    pub struct RenderResult {
+        /// Number of stereo samples written
+        pub frames: u64,
+        /// False if the file could not be opened or written
+        pub ok: bool,
+    }
+
+    /// Audio levels returned by `ShvcSoundEmu::meters()`
+    #[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+    pub struct AudioMeters {
+        /// Peak absolute output of each voice (after the envelope, before the voice volume)
+        pub voice_peak: [u16; 8],
+        /// RMS output of each voice (after the envelope, before the voice volume)
+        pub voice_rms: [u16; 8],
+        /// Peak absolute main output (left, right)
+        pub peak: [u16; 2],
+        /// RMS main output (left, right)
+        pub rms: [u16; 2],
+    }
+
+    /// Saturated S-DSP mixer samples returned by `ShvcSoundEmu::take_clipping()`
+    ///
+    /// Each field is the number of samples clipped to 16 bits at a mixer stage (left, right).
+    #[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+    pub struct ClippingCounters {
+        /// Voice outputs added to the main output
+        pub main: [u32; 2],
+        /// Voice outputs added to the echo input
+        pub echo: [u32; 2],
+        /// Echo FIR filter output
+        pub fir: [u32; 2],
+        /// Echo feedback added to the echo buffer sample
+        pub feedback: [u32; 2],
+        /// Final output (main output + echo output)
+        pub output: [u32; 2],
+    }
+
+    /// S-DSP source number usage returned by `ShvcSoundEmu::take_source_usage()`
+    #[derive(Debug, Clone, Copy, PartialEq, Eq)]
+    pub struct SourceUsage {
+        /// Number of keyons of each source number (the voice's SRCN at KON)
+        pub key_ons: [u32; 256],
+        /// Number of BRR blocks decoded by voices keyed on with each source number
+        pub brr_blocks: [u32; 256],
+    }
+
+    /// Counters returned by `ShvcSoundEmu::counters()`
+    #[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+    pub struct EmulatorCounters {
+        /// S-SMP clocks emulated (see `ShvcSoundEmu::SMP_CLOCKS_PER_SECOND`)
+        pub smp_clocks: u64,
+        /// S-SMP instructions executed (including skipped idle loop iterations)
+        pub smp_instructions: u64,
+        /// S-DSP clocks emulated (32 per sample)
+        pub dsp_clocks: u64,
+        /// Stereo samples output (fast forwarded samples are not output)
+        pub dsp_samples: u64,
+    }
+
+    /// Audio-RAM addresses of the audio driver variables read by `ShvcSoundEmu::monitor_snapshot()`
+    ///
+    /// The channel fields are the addresses of structure of arrays variables (one byte per
+    /// channel).
+    #[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+    pub struct MonitorLayout {
+        /// Little-endian word
+        pub song_ptr: u16,
+        /// Little-endian word
+        pub song_tick_counter: u16,
+        pub music_channels_mask: u16,
+        pub instruction_ptr_l: u16,
+        pub instruction_ptr_h: u16,
+        pub volume: u16,
+        pub pan: u16,
+    }
+
+    /// Audio driver channel and S-DSP voice state returned by `ShvcSoundEmu::monitor_snapshot()`
+    #[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+    pub struct MonitorSnapshot {
+        /// `MonitorSnapshot::VERSION` (0 if the snapshot has not been written)
+        pub version: u32,
+        /// S-SMP clock when the snapshot was taken (see `EmulatorCounters::smp_clocks`)
+        pub smp_clock: u64,
+        pub song_ptr: u16,
+        pub song_tick_counter: u16,
+        pub music_channels_mask: u8,
+        pub instruction_ptrs: [u16; 10],
+        pub volume: [u8; 10],
+        pub pan: [u8; 10],
+        pub voice_pitch: [u16; 8],
+        /// Envelope level of each voice (0-2047)
+        pub voice_envelope: [u16; 8],
+        /// Bit n is set if voice n's envelope is not in the release state
+        pub voice_key_on: u8,
+    }
+
+    /// An echo buffer write returned by `ShvcSoundEmu::take_echo_guard_hit()`
+    #[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+    pub struct EchoGuardHit {
+        /// False if the S-DSP has not written to the guarded addresses
+        pub hit: bool,
+        /// The first guarded address written
+        pub address: u16,
+        /// S-DSP clock of the write (see `EmulatorCounters::dsp_clocks`)
+        pub dsp_clock: u64,
+    }
+
+    /// A watchpoint access recorded by `ShvcSoundEmu::set_watchpoint_log_size()`
+    #[derive(Debug, Clone, Copy, PartialEq, Eq)]
+    pub struct WatchpointHit {
+        /// S-SMP clock of the access
+        pub smp_clock: u64,
+        /// Address of the instruction that accessed the watchpoint
+        pub pc: u16,
+        pub address: u16,
+        /// `ShvcSoundEmu::WATCH_READ`, `WATCH_WRITE` or `WATCH_EXECUTE`
+        pub kind: u8,
+        /// The byte read, the byte written or the opcode executed
+        pub data: u8,
+    }
+
+    /// An instruction recorded by `ShvcSoundEmu::set_trace_size()`
+    ///
+    /// The registers are the values before the instruction was executed.
+    #[derive(Debug, Clone, Copy, PartialEq, Eq)]
+    pub struct TraceEntry {
+        /// S-SMP clock at the start of the instruction
+        pub smp_clock: u64,
+        pub pc: u16,
+        pub opcode: u8,
+        pub operand1: u8,
+        pub operand2: u8,
+        pub a: u8,
+        pub x: u8,
+        pub y: u8,
+        pub psw: u8,
+        pub sp: u8,
+    }
+
+    /// A S-DSP register write recorded by `ShvcSoundEmu::start_dsp_log()`
+    #[derive(Debug, Clone, Copy, PartialEq, Eq)]
+    pub struct DspRegisterWrite {
+        /// S-DSP clock of the write (see `ShvcSoundEmu::dsp_clock()`)
+        pub dsp_clock: u64,
+        pub address: u8,
+        pub value: u8,
+    }
+
+    /// A S-SMP Audio-RAM write recorded by `ShvcSoundEmu::start_dsp_log()`
+    #[derive(Debug, Clone, Copy, PartialEq, Eq)]
+    pub struct ApuramWrite {
+        /// S-DSP clock of the write (see `ShvcSoundEmu::dsp_clock()`)
+        pub dsp_clock: u64,
+        pub address: u16,
+        pub value: u8,
+    }
+
+    /// The kind of a `SoundEvent`
+    #[derive(Debug)]
+    #[repr(u8)]
+    pub enum SoundEventKind {
+        /// A voice was keyed on
+        KeyOn,
+        /// A voice was keyed off (only recorded if the voice was not already releasing)
+        KeyOff,
+        /// The S-SMP read a non-zero T0OUT value (an audio driver tick)
+        Tick,
+    }
+
+    /// A S-DSP voice or audio driver event recorded by `ShvcSoundEmu::start_event_log()`
+    #[derive(Debug, Clone, Copy, PartialEq, Eq)]
+    pub struct SoundEvent {
+        /// S-DSP clock of the event (see `ShvcSoundEmu::dsp_clock()`)
+        pub dsp_clock: u64,
+        pub kind: SoundEventKind,
+        /// The S-DSP voice (the number of timer 0 outputs read for `Tick` events)
+        pub voice: u8,
+        /// The voice's SRCN at key-on (0 if not `KeyOn`)
+        pub source: u8,
+        /// The voice's PITCH register at key-on (0 if not `KeyOn`)
+        pub pitch: u16,
+    }
+
+    /// A histogram of IO command latencies (see `ShvcSoundEmu::start_io_latency()`)
+    #[derive(Debug, Clone, Copy, PartialEq, Eq)]
+    pub struct LatencyHistogram {
+        /// Number of measured latencies
+        pub count: u64,
+        /// Sum of the measured latencies (S-SMP clocks)
+        pub total_clocks: u64,
+        pub min_clocks: u64,
+        pub max_clocks: u64,
+        /// Bucket n counts latencies of `2^n..2^(n+1)` S-SMP clocks (bucket 0 includes 0)
+        pub buckets: [u32; 24],
+    }
+
+    /// IO command latencies recorded by `ShvcSoundEmu::start_io_latency()`
+    #[derive(Debug, Clone, Copy, PartialEq, Eq)]
+    pub struct IoLatency {
+        /// S-SMP clocks between the S-CPU writing a command to port 0 and the S-SMP writing the
+        /// same value to port 0
+        pub ack: LatencyHistogram,
+        /// S-SMP clocks between the S-CPU writing a key-on command to port 0 and the next KON write
+        pub key_on: LatencyHistogram,
+        /// Number of commands replaced by a new command before they were acknowledged
+        pub unacknowledged: u64,
+    }
+
+    /// An IO port write performed at a given time by `run_emulator_jobs()`
+    #[derive(Debug, Clone, Copy)]
+    pub struct IoPortWrite {
+        /// Number of S-SMP clocks after reset
+        pub smp_clock: u64,
+        pub ports: [u8; 4],
+    }
+
+    /// An emulator run performed by `run_emulator_jobs()`
+    #[derive(Clone)]
+    pub struct EmulatorJob {
+        /// Initial Audio-RAM (up to 64 KiB, missing bytes are zero or copied from the base image
+        /// of `run_emulator_jobs_with_base()`)
+        pub apuram: Vec<u8>,
+        pub registers: ResetRegisters,
+        pub fast_paths: bool,
+        /// MUST be sorted by `smp_clock`
+        pub port_writes: Vec<IoPortWrite>,
+        /// The job stops after this many S-SMP clocks
+        pub smp_clocks: u64,
+        /// If true, the job outputs audio and `smp_clock` values are rounded up to the next
+        /// sample.
+        pub output_audio: bool,
+    }
+
+    /// The kind of a `BatchOp`
+    #[repr(u8)]
+    pub enum BatchOpKind {
+        ApuramWrite,
+        DspRegisterWrite,
+        SmpRegisterWrite,
+        IoPortsWrite,
+    }
+
+    /// Interpolation used by `ShvcSoundEmu::emulate_resampled()`
+    #[repr(u8)]
+    pub enum ResamplerQuality {
+        /// Linear interpolation (lowest cost, for live playback)
+        Linear,
+        /// Catmull-Rom cubic interpolation
+        Cubic,
+        /// 32 tap Kaiser windowed sinc (for offline renders)
+        Sinc,
+    }
+
+    /// Instruction set of the emulator's runtime selected SIMD kernels (see `simd_level()`)
+    #[repr(u8)]
+    pub enum SimdLevel {
+        /// Scalar reference kernels
+        Scalar,
+        Sse2,
+        Avx2,
+        Neon,
+    }
+
+    /// An inclusive Audio-RAM address range hashed by `ShvcSoundEmu::state_hash_ranges()`
+    #[derive(Clone, Copy)]
+    pub struct ApuramRange {
+        pub first: u16,
+        pub last: u16,
+    }
+
+    /// An operation of an `EmulatorBatch`
+    #[derive(Clone, Copy)]
+    pub struct BatchOp {
+        pub kind: BatchOpKind,
+        pub address: u16,
+        /// Location of the operation's bytes within the batch data
+        pub data_offset: u32,
+        pub data_size: u32,
+    }
+
+    pub struct EmulatorJobResult {
+        /// Interleaved stereo samples (empty if `output_audio` was false)
+        pub samples: Vec<i16>,
+        /// Emulator state at the end of the job (see `ShvcSoundEmu::save_state()`)
+        pub state: Vec<u8>,
+    }
+
+    /// A 16 bit Audio-RAM value tested by `render_sound_effects()`
+    /// (ie, a sound effect channel's instruction pointer)
+    #[derive(Debug, Clone, Copy)]
+    pub struct IdleWatch {
+        /// Address of the low byte
+        pub addr_l: u16,
+        /// Address of the high byte
+        pub addr_h: u16,
+        /// The value is idle while it is less than `active_min`
+        pub active_min: u16,
+    }
+
+    /// The stop condition of `render_sound_effects()`
+    #[derive(Debug, Clone, Copy)]
+    pub struct SfxRenderSettings {
+        /// Samples with an absolute value less than or equal to this are silent
+        pub silence_threshold: u16,
+        /// Number of consecutive silent samples (with every `IdleWatch` idle) before the render
+        /// stops
+        pub silence_samples: u32,
+        /// The render stops after this many S-SMP clocks, even if it is not silent
+        pub max_smp_clocks: u64,
+    }
+
+    /// A render performed by `render_sound_effects()`
+    #[derive(Clone)]
+    pub struct SfxRenderJob {
+        /// The port writes that play the sound effect.
+        /// `smp_clock` is the number of S-SMP clocks after the save state.
+        /// MUST be sorted by `smp_clock`
+        pub port_writes: Vec<IoPortWrite>,
+    }
+
+    pub struct SfxRenderResult {
+        /// Interleaved stereo samples (without the trailing silence if `stopped` is true)
+        pub samples: Vec<i16>,
+        /// False if the render did not stop before `SfxRenderSettings::max_smp_clocks`
+        /// (ie, a looping sound effect)
+        pub stopped: bool,
+    }
+
+    /// A result output by an `AsyncEmulator` command
+    #[derive(Debug, Default, Clone)]
+    pub struct AsyncEmulatorResult {
+        /// Ticket of the command that output the result
+        pub ticket: u64,
+        /// False if `AsyncEmulator::load_state()` failed
+        pub ok: bool,
+        /// Interleaved stereo samples output by `AsyncEmulator::render()`
+        pub samples: Vec<i16>,
+        /// Emulator state output by `AsyncEmulator::snapshot()`
+        pub state: Vec<u8>,
+    }
+
+    /// Timing of a S-CPU API loader transfer loop (in S-CPU master clocks)
+    #[derive(Debug, Clone, Copy)]
+    pub struct LoaderHandshakeTiming {
+        /// From the start of the transfer call to the first spinlock write
+        pub setup_clocks: u32,
+        /// From a spinlock write to the first spinlock poll
+        pub pre_poll_clocks: u32,
+        /// Spinlock poll loop period
+        pub poll_clocks: u32,
+        /// From the poll that reads the acknowledgement to the next spinlock write
+        pub post_poll_clocks: u32,
+        /// From the poll that reads the last acknowledgement to the `SPINLOCK_COMPLETE` write
+        pub complete_clocks: u32,
+    }
+
+    /// S-CPU timing used by `ShvcSoundEmu::simulate_loader_transfers()`
+    #[derive(Debug, Clone, Copy)]
+    pub struct ScpuLoaderTiming {
+        pub master_clocks_per_second: u64,
+        /// S-CPU master clocks per frame (`Tad_Process` is called at the start of every frame)
+        pub frame_clocks: u32,
+        /// The maximum number of bytes transferred per `Tad_Process` call
+        /// (0 = transfer everything in a single blocking call)
+        pub bytes_per_frame: u32,
+        /// Timing of the 2 byte transfer loop
+        pub normal: LoaderHandshakeTiming,
+        /// Timing of the 3 byte transfer loop
+        pub fast: LoaderHandshakeTiming,
+    }
+
+    /// A transfer performed by `ShvcSoundEmu::simulate_loader_transfers()`
+    #[derive(Clone)]
+    pub struct LoaderTransfer {
+        /// The LoaderDataType sent to the loader (including the fast transfer and compressed flags)
+        pub data_type: u8,
+        pub data: Vec<u8>,
+    }
+
+    /// Result of a `ShvcSoundEmu::simulate_loader_transfers()` transfer
+    #[derive(Debug, Default, Clone, Copy)]
+    pub struct LoaderTransferResult {
+        /// False if the loader timed out
+        pub ok: bool,
+        /// Number of frames from the `Tad_Process` call that sent the LoaderDataType to the call that
+        /// ended the transfer (inclusive)
+        pub frames: u64,
+        /// Number of spinlock writes
+        pub handshakes: u32,
+        /// S-CPU master clocks spent in the transfer calls
+        pub busy_clocks: u64,
+        /// S-CPU master clocks spent waiting for the loader to acknowledge a spinlock
+        pub wait_clocks: u64,
+        /// S-SMP clocks from the first ready signal test to the end of the transfer
+        pub smp_clocks: u64,
+    }
+
+    /// An envelope traced by `trace_envelopes()`
+    #[derive(Debug, Clone, Copy, PartialEq, Eq)]
+    pub struct EnvelopeTraceConfig {
+        /// ADSR1 register
+        pub adsr1: u8,
+        /// ADSR2 register
+        pub adsr2: u8,
+        pub gain: u8,
+        /// The voice is keyed off before this sample (`u32::MAX` = never)
+        pub key_off_sample: u32,
+    }
+
+    /// A BRR sample scanned by `scan_gaussian_overflow()`
+    #[derive(Debug, Clone, PartialEq, Eq)]
+    pub struct GaussianOverflowScan {
+        /// BRR data (a multiple of 9 bytes)
+        pub brr_data: Vec<u8>,
+        pub looping: bool,
+        /// Loop offset in bytes (ignored if `looping` is false)
+        pub loop_offset: u32,
+        /// Number of times the loop is scanned (ignored if `looping` is false)
+        pub n_loops: u32,
+        /// The S-DSP pitch register values the sample is played at
+        pub pitches: Vec<u16>,
+    }
+
     unsafe extern "C++" {
         include!("shvc-sound-emu.hpp");
 
         type ShvcSoundEmu;
 
         fn new_emulator(iplrom: &[u8; 64]) -> UniquePtr<ShvcSoundEmu>;
+        fn clone_emulator(emu: &ShvcSoundEmu) -> UniquePtr<ShvcSoundEmu>;
+
+        fn run_emulator_jobs(jobs: &[EmulatorJob], n_threads: u32) -> Vec<EmulatorJobResult>;
+        fn run_emulator_jobs_with_base(
+            base_apuram: &[u8],
+            jobs: &[EmulatorJob],
+            n_threads: u32,
+        ) -> Vec<EmulatorJobResult>;
+
+        fn render_sound_effects(
+            state: &[u8],
+            watches: &[IdleWatch],
+            settings: &SfxRenderSettings,
+            jobs: &[SfxRenderJob],
+            n_threads: u32,
+        ) -> Vec<SfxRenderResult>;
+
+        type AsyncEmulator;
+
+        fn new_async_emulator(iplrom: &[u8; 64]) -> UniquePtr<AsyncEmulator>;
+
+        fn load_apuram(self: Pin<&mut AsyncEmulator>, address: u16, data: &[u8]) -> u64;
+        fn load_state(self: Pin<&mut AsyncEmulator>, state: &[u8]) -> u64;
+        fn reset(self: Pin<&mut AsyncEmulator>, registers: ResetRegisters) -> u64;
+        fn write_io_ports(self: Pin<&mut AsyncEmulator>, ports: [u8; 4]) -> u64;
+        fn render(self: Pin<&mut AsyncEmulator>, frames: usize) -> u64;
+        fn snapshot(self: Pin<&mut AsyncEmulator>) -> u64;
+
+        fn completed(self: &AsyncEmulator) -> u64;
+        fn wait(self: Pin<&mut AsyncEmulator>, ticket: u64);
+        fn take_result(self: Pin<&mut AsyncEmulator>, out: &mut AsyncEmulatorResult) -> bool;
+
+        type SharedStateView;
+
+        fn new_shared_state_view(name: &str) -> UniquePtr<SharedStateView>;
+        fn publish(
+            self: Pin<&mut SharedStateView>,
+            emu: Pin<&mut ShvcSoundEmu>,
+            layout: &MonitorLayout,
+        );
+
+        fn disassemble_trace_entry(entry: &TraceEntry) -> String;
+
+        fn trace_envelopes(configs: &[EnvelopeTraceConfig], samples: u32) -> Vec<u16>;
+
+        fn scan_gaussian_overflow(scans: &[GaussianOverflowScan], n_threads: u32) -> Vec<bool>;
+
+        fn simd_level() -> SimdLevel;
+        fn set_simd_level(level: SimdLevel) -> bool;
+
+        fn simulate_loader_transfers(
+            emu: Pin<&mut ShvcSoundEmu>,
+            timing: &ScpuLoaderTiming,
+            transfers: &[LoaderTransfer],
+        ) -> Vec<LoaderTransferResult>;
 
         fn reset(self: Pin<&mut ShvcSoundEmu>, registers: ResetRegisters);
 
+        /// SAFETY: `data` must point to at least `size` readable bytes
+        unsafe fn load_spc(self: Pin<&mut ShvcSoundEmu>, data: *const u8, size: usize) -> bool;
+
         fn iplrom(self: &ShvcSoundEmu) -> &[u8; 64];
         fn iplrom_mut(self: Pin<&mut ShvcSoundEmu>) -> &mut [u8; 64];
 
         fn apuram(self: &ShvcSoundEmu) -> &[u8; 65536];
         fn apuram_mut(self: Pin<&mut ShvcSoundEmu>) -> &mut [u8; 65536];
 
+        fn dirty_apuram_pages(self: &ShvcSoundEmu) -> [u8; 32];
+        fn clear_dirty_apuram_pages(self: Pin<&mut ShvcSoundEmu>);
+
         fn dsp_registers(self: &ShvcSoundEmu) -> &[u8; 128];
+        fn take_dsp_register_changes(self: Pin<&mut ShvcSoundEmu>) -> [u8; 16];
+        fn set_track_voice_register_changes(self: Pin<&mut ShvcSoundEmu>, enabled: bool);
 
         fn write_dsp_register(self: Pin<&mut ShvcSoundEmu>, addr: u8, value: u8);
         fn write_smp_register(self: Pin<&mut ShvcSoundEmu>, addr: u8, value: u8);
 
+        fn dsp_clock(self: &ShvcSoundEmu) -> u64;
+
+        fn counters(self: Pin<&mut ShvcSoundEmu>) -> EmulatorCounters;
+        fn monitor_snapshot(
+            self: Pin<&mut ShvcSoundEmu>,
+            layout: &MonitorLayout,
+        ) -> MonitorSnapshot;
+
+        fn start_dsp_log(self: Pin<&mut ShvcSoundEmu>, capacity: usize);
+        fn stop_dsp_log(self: Pin<&mut ShvcSoundEmu>);
+        fn take_dsp_register_log(self: Pin<&mut ShvcSoundEmu>) -> Vec<DspRegisterWrite>;
+        fn take_apuram_write_log(self: Pin<&mut ShvcSoundEmu>) -> Vec<ApuramWrite>;
+
+        fn start_event_log(self: Pin<&mut ShvcSoundEmu>, capacity: usize);
+        fn stop_event_log(self: Pin<&mut ShvcSoundEmu>);
+        fn take_event_log(self: Pin<&mut ShvcSoundEmu>) -> Vec<SoundEvent>;
+
+        /// SAFETY: `out` must point to at least `frames * 2` writable `i16` samples
+        unsafe fn replay_dsp_log(
+            self: Pin<&mut ShvcSoundEmu>,
+            registers: &[DspRegisterWrite],
+            apuram: &[ApuramWrite],
+            out: *mut i16,
+            frames: usize,
+        );
+
         fn read_io_ports(self: &ShvcSoundEmu) -> [u8; 4];
         fn write_io_ports(self: Pin<&mut ShvcSoundEmu>, ports: [u8; 4]);
+        fn schedule_port_write(self: Pin<&mut ShvcSoundEmu>, smp_clock: u64, ports: [u8; 4]);
+        fn clear_scheduled_port_writes(self: Pin<&mut ShvcSoundEmu>);
+        fn scheduled_port_writes(self: &ShvcSoundEmu) -> usize;
+
+        fn start_io_latency(self: Pin<&mut ShvcSoundEmu>, key_on_mask: u8, key_on_command: u8);
+        fn stop_io_latency(self: Pin<&mut ShvcSoundEmu>);
+        fn io_latency(self: &ShvcSoundEmu) -> IoLatency;
 
         fn program_counter(self: &ShvcSoundEmu) -> u16;
+        fn halted(self: &ShvcSoundEmu) -> bool;
+        fn dsp_quiescent(self: &ShvcSoundEmu, echo_threshold: u32) -> bool;
+        fn stack_min(self: &ShvcSoundEmu) -> u8;
+        fn reset_stack_min(self: Pin<&mut ShvcSoundEmu>);
+        fn smp_registers(self: &ShvcSoundEmu) -> SmpRegisters;
+
+        fn apply_batch(self: Pin<&mut ShvcSoundEmu>, ops: &[BatchOp], data: &[u8]);
+
+        fn save_state(self: &ShvcSoundEmu) -> UniquePtr<CxxVector<u8>>;
+
+        /// SAFETY: `data` must point to at least `size` readable bytes
+        unsafe fn load_state(self: Pin<&mut ShvcSoundEmu>, data: *const u8, size: usize) -> bool;
+
+        fn state_hash(self: &ShvcSoundEmu) -> u64;
+        fn state_hash_ranges(self: &ShvcSoundEmu, ranges: &[ApuramRange]) -> u64;
+
+        fn set_fast_paths(self: Pin<&mut ShvcSoundEmu>, enabled: bool);
+
+        fn set_brr_cache_enabled(self: Pin<&mut ShvcSoundEmu>, enabled: bool);
+
+        fn set_logic_only(self: Pin<&mut ShvcSoundEmu>, enabled: bool);
 
         fn emulate(self: Pin<&mut ShvcSoundEmu>) -> &[i16; 512];
+
+        fn set_output_sample_rate(
+            self: Pin<&mut ShvcSoundEmu>,
+            rate: u32,
+            quality: ResamplerQuality,
+        ) -> bool;
+        fn output_sample_rate(self: &ShvcSoundEmu) -> u32;
+
+        /// SAFETY: `out` must point to at least `frames * 2` writable `i16` samples
+        unsafe fn emulate_resampled(self: Pin<&mut ShvcSoundEmu>, out: *mut i16, frames: usize);
+
+        fn set_voice_mute_mask(self: Pin<&mut ShvcSoundEmu>, mask: u8, skip_interpolation: bool);
+
+        /// SAFETY: `buffer` must be null or point to `frames * 2` writable `i16` samples that
+        /// outlive the tap
+        unsafe fn set_voice_tap(
+            self: Pin<&mut ShvcSoundEmu>,
+            voice: u8,
+            buffer: *mut i16,
+            frames: usize,
+        );
+        fn voice_tap_position(self: &ShvcSoundEmu, voice: u8) -> u64;
+
+        fn set_profiler_enabled(self: Pin<&mut ShvcSoundEmu>, enabled: bool);
+        fn profile(self: &ShvcSoundEmu) -> &[u64];
+
+        fn set_access_map_enabled(self: Pin<&mut ShvcSoundEmu>, enabled: bool);
+        fn access_map(self: &ShvcSoundEmu) -> &[u8];
+
+        fn set_echo_guard(self: Pin<&mut ShvcSoundEmu>, first: u16, last: u16);
+        fn clear_echo_guard(self: Pin<&mut ShvcSoundEmu>);
+        fn take_echo_guard_hit(self: Pin<&mut ShvcSoundEmu>) -> EchoGuardHit;
+
+        fn add_watchpoint(self: Pin<&mut ShvcSoundEmu>, first: u16, last: u16, kinds: u8);
+        fn clear_watchpoints(self: Pin<&mut ShvcSoundEmu>);
+        fn set_watchpoint_log_size(self: Pin<&mut ShvcSoundEmu>, capacity: usize);
+        fn take_watchpoint_hits(self: Pin<&mut ShvcSoundEmu>) -> Vec<WatchpointHit>;
+        fn watchpoint_hit_count(self: &ShvcSoundEmu) -> u64;
+
+        fn set_trace_size(self: Pin<&mut ShvcSoundEmu>, entries: usize);
+        fn trace(self: &ShvcSoundEmu) -> Vec<TraceEntry>;
+        fn trace_count(self: &ShvcSoundEmu) -> u64;
+        fn disassemble(self: &ShvcSoundEmu, address: u16) -> String;
+
+        fn start_gdb_server(self: Pin<&mut ShvcSoundEmu>, port: u16) -> bool;
+        fn stop_gdb_server(self: Pin<&mut ShvcSoundEmu>);
+
+        fn meters(self: Pin<&mut ShvcSoundEmu>) -> AudioMeters;
+        fn take_source_usage(self: Pin<&mut ShvcSoundEmu>) -> SourceUsage;
+        fn take_clipping(self: Pin<&mut ShvcSoundEmu>) -> ClippingCounters;
+
+        /// SAFETY: `out` must point to at least `frames * 2` writable `i16` samples
+        unsafe fn emulate_into(self: Pin<&mut ShvcSoundEmu>, out: *mut i16, frames: usize);
+
+        /// SAFETY: `left` and `right` must each point to at least `frames` writable `i16` samples
+        unsafe fn emulate_planar_into(
+            self: Pin<&mut ShvcSoundEmu>,
+            left: *mut i16,
+            right: *mut i16,
+            frames: usize,
+        );
+
+        /// SAFETY: `out` must point to at least `frames` writable `i16` samples
+        unsafe fn emulate_mono_into(self: Pin<&mut ShvcSoundEmu>, out: *mut i16, frames: usize);
+
+        /// SAFETY: `out` must point to at least `bins * 2` writable `i16` samples
+        unsafe fn emulate_waveform_overview(
+            self: Pin<&mut ShvcSoundEmu>,
+            out: *mut i16,
+            bins: usize,
+            bin_frames: u32,
+        );
+
+        /// SAFETY: `out` must point to at least `frames * 2` writable `i16` samples
+        unsafe fn emulate_for(
+            self: Pin<&mut ShvcSoundEmu>,
+            out: *mut i16,
+            frames: usize,
+            max_smp_clocks: u64,
+        ) -> usize;
+
+        fn fast_forward(self: Pin<&mut ShvcSoundEmu>, smp_clocks: u64) -> u64;
+
+        fn run_until_pc(self: Pin<&mut ShvcSoundEmu>, pc: u16, max_smp_clocks: u64) -> RunResult;
+        fn run_until_port_write(
+            self: Pin<&mut ShvcSoundEmu>,
+            port_mask: u8,
+            max_smp_clocks: u64,
+        ) -> RunResult;
+        fn run_until_watchpoint(self: Pin<&mut ShvcSoundEmu>, max_smp_clocks: u64) -> RunResult;
+        fn run_ticks(
+            self: Pin<&mut ShvcSoundEmu>,
+            ticks: u32,
+            tick_pc: u16,
+            max_smp_clocks: u64,
+        ) -> RunResult;
+
+        fn render_to_file(
+            self: Pin<&mut ShvcSoundEmu>,
+            path: &str,
+            smp_clocks: u64,
+            stop_after_silence: u32,
+        ) -> RenderResult;
     }
 }
 
+pub use ffi::ApuramWrite;
+pub use ffi::AsyncEmulatorResult;
+pub use ffi::AudioMeters;
+pub use ffi::ClippingCounters;
+pub use ffi::DspRegisterWrite;
+pub use ffi::EchoGuardHit;
+pub use ffi::EmulatorCounters;
+pub use ffi::EmulatorJob;
+pub use ffi::EmulatorJobResult;
+pub use ffi::EnvelopeTraceConfig;
+pub use ffi::GaussianOverflowScan;
+pub use ffi::IdleWatch;
+pub use ffi::IoLatency;
+pub use ffi::IoPortWrite;
+pub use ffi::LatencyHistogram;
+pub use ffi::LoaderHandshakeTiming;
+pub use ffi::LoaderTransfer;
+pub use ffi::LoaderTransferResult;
+pub use ffi::MonitorLayout;
+pub use ffi::MonitorSnapshot;
+pub use ffi::RenderResult;
+pub use ffi::ResamplerQuality;
 pub use ffi::ResetRegisters;
+pub use ffi::RunResult;
+pub use ffi::ScpuLoaderTiming;
+pub use ffi::SfxRenderJob;
+pub use ffi::SfxRenderResult;
+pub use ffi::SfxRenderSettings;
+pub use ffi::SimdLevel;
+pub use ffi::SmpRegisters;
+pub use ffi::SoundEvent;
+pub use ffi::SoundEventKind;
+pub use ffi::SourceUsage;
+pub use ffi::TraceEntry;
+pub use ffi::WatchpointHit;
+
+/// Traces the exact S-DSP envelope of each config, from key-on, for `samples` samples.
+///
+/// Only the S-DSP key-on delay, envelope and counter logic are emulated, so this is cheap
+/// enough to call whenever an envelope is edited.  Up to eight configs are traced in a single
+/// pass over the counter (as the eight S-DSP voices are).
+///
+/// The counter starts at its power-on value.  During playback the counter phase at key-on
+/// depends on when the voice was keyed on, which can delay the first envelope step of a rate by
+/// up to one period.
+///
+/// Returns `samples` 11-bit envelope levels per config (config-major).
+pub fn trace_envelopes(configs: &[EnvelopeTraceConfig], samples: u32) -> Vec<u16> {
+    ffi::trace_envelopes(configs, samples)
+}
+
+/// Tests BRR samples for the S-DSP gaussian interpolation overflow glitch in parallel.
+///
+/// Each sample is decoded with the emulator's BRR decoder and interpolated with the emulator's
+/// gaussian interpolation kernel at every position a voice playing the sample at each of its
+/// `pitches` would interpolate.  Unlike `BrrSample::test_for_gaussian_overflow_glitch_n_loops()`,
+/// which rejects any run of three maximum negative samples, a sample is only reported if the
+/// interpolation wraps at one of the pitches it is played at.
+///
+/// The pitch is assumed to be constant from key-on (no vibrato, portamento or pitch modulation).
+///
+/// The scans are run on `n_threads` worker threads (0 = one thread per CPU core).
+/// Returns true for each sample that overflows, in the same order as `scans`.
+pub fn scan_gaussian_overflow(scans: &[GaussianOverflowScan], n_threads: u32) -> Vec<bool> {
+    ffi::scan_gaussian_overflow(scans, n_threads)
+}
+
+/// Returns the instruction set of the SIMD kernels used by every emulator in the process.
+///
+/// Defaults to the best instruction set supported by the host CPU (detected at startup), so
+/// the library does not need to be built for the host CPU to use AVX2.
+pub fn simd_level() -> SimdLevel {
+    ffi::simd_level()
+}
+
+/// Selects the SIMD kernels used by every emulator in the process.
+///
+/// Every kernel produces the same output, this is used to compare the vector kernels with the
+/// `SimdLevel::Scalar` reference kernels.
+///
+/// Returns `Err` (and leaves the kernels unchanged) if the host CPU does not support `level`.
+pub fn set_simd_level(level: SimdLevel) -> Result<(), UnsupportedSimdLevel> {
+    match ffi::set_simd_level(level) {
+        true => Ok(()),
+        false => Err(UnsupportedSimdLevel),
+    }
+}
+
+/// Runs independent emulator jobs in parallel.
+///
+/// Each job is run on a new emulator (with no IPL ROM) on one of `n_threads` worker threads
+/// (0 = one thread per CPU core).
+///
+/// Returns the results in the same order as `jobs`.
+pub fn run_emulator_jobs(jobs: &[EmulatorJob], n_threads: u32) -> Vec<EmulatorJobResult> {
+    ffi::run_emulator_jobs(jobs, n_threads)
+}
+
+/// Runs independent emulator jobs that share a base Audio-RAM image in parallel.
+///
+/// Each job's initial Audio-RAM is `base_apuram` (up to 64 KiB, missing bytes are zero)
+/// overwritten by the start of the job's `apuram`, which can be empty.
+/// The base image is shared by every job, a sweep of similar jobs (ie, testing every sound
+/// effect with the same audio driver and common audio data) does not need a 64 KiB `apuram` per
+/// job.
+///
+/// Returns the results in the same order as `jobs`.
+pub fn run_emulator_jobs_with_base(
+    base_apuram: &[u8],
+    jobs: &[EmulatorJob],
+    n_threads: u32,
+) -> Vec<EmulatorJobResult> {
+    ffi::run_emulator_jobs_with_base(base_apuram, jobs, n_threads)
+}
+
+/// Renders sound effects in parallel, starting every render from the same save state
+/// (see `ShvcSoundEmu::save_state()`).
+///
+/// Each job's port writes are applied at their S-SMP clock and the render stops once every port
+/// write has been applied, the output has been silent (see `SfxRenderSettings`) for
+/// `settings.silence_samples` samples and every `watches` value is idle.  The trailing silence
+/// is not output.
+///
+/// The jobs are run on `n_threads` worker threads (0 = one thread per CPU core).
+/// Returns the results in the same order as `jobs`.
+pub fn render_sound_effects(
+    state: &[u8],
+    watches: &[IdleWatch],
+    settings: &SfxRenderSettings,
+    jobs: &[SfxRenderJob],
+    n_threads: u32,
+) -> Result<Vec<SfxRenderResult>, InvalidSaveState> {
+    ShvcSoundEmu::new(&[0; 64]).load_state(state)?;
+
+    Ok(ffi::render_sound_effects(
+        state, watches, settings, jobs, n_threads,
+    ))
+}
+
+impl MonitorSnapshot {
+    /// Incremented whenever the `MonitorSnapshot` fields change
+    /// (must match `ShvcSoundEmu::MONITOR_SNAPSHOT_VERSION` in the C++ code)
+    pub const VERSION: u32 = 1;
+
+    /// Number of audio driver channels in a snapshot
+    pub const N_CHANNELS: usize = 10;
+}
+
+impl SoundEvent {
+    /// S-DSP clocks per sample
+    pub const DSP_CLOCKS_PER_SAMPLE: u64 = 32;
+
+    /// Returns the index of the sample the event occurred in (`dsp_clock / 32`)
+    pub fn sample_index(&self) -> u64 {
+        self.dsp_clock / Self::DSP_CLOCKS_PER_SAMPLE
+    }
+}
+
+impl LatencyHistogram {
+    /// Returns the mean latency in S-SMP clocks (or `None` if no latencies were measured)
+    pub fn mean_clocks(&self) -> Option<f64> {
+        match self.count {
+            0 => None,
+            c => Some(self.total_clocks as f64 / c as f64),
+        }
+    }
+
+    /// Returns the range of S-SMP clocks counted by `buckets[i]`
+    pub fn bucket_range(i: usize) -> std::ops::Range<u64> {
+        match i {
+            0 => 0..2,
+            i => (1 << i)..(1 << (i + 1)),
+        }
+    }
+}
+
+impl TraceEntry {
+    /// Disassembles the traced instruction
+    pub fn disassemble(&self) -> String {
+        ffi::disassemble_trace_entry(self)
+    }
+}
+
+impl ScpuLoaderTiming {
+    /// S-CPU master clocks per S-CPU cycle (SlowROM)
+    const CYCLE: u32 = 8;
+
+    /// Approximate timing of the ca65 API transfer loops on a NTSC console
+    /// (`_Tad_Loader_TransferData` and `_Tad_Loader_TransferDataFast`).
+    ///
+    /// `bytes_per_frame` is the `Tad_SetTransferSize()` value (0 = `Tad_FinishLoadingData()`).
+    pub const fn ntsc(bytes_per_frame: u32) -> Self {
+        Self {
+            master_clocks_per_second: 21_477_272,
+            frame_clocks: 357_366,
+            bytes_per_frame,
+            normal: LoaderHandshakeTiming {
+                setup_clocks: 90 * Self::CYCLE,
+                pre_poll_clocks: 8 * Self::CYCLE,
+                poll_clocks: 6 * Self::CYCLE,
+                post_poll_clocks: 34 * Self::CYCLE,
+                complete_clocks: 12 * Self::CYCLE,
+            },
+            fast: LoaderHandshakeTiming {
+                setup_clocks: 90 * Self::CYCLE,
+                pre_poll_clocks: 14 * Self::CYCLE,
+                poll_clocks: 6 * Self::CYCLE,
+                post_poll_clocks: 48 * Self::CYCLE,
+                complete_clocks: 12 * Self::CYCLE,
+            },
+        }
+    }
+}
+
+impl std::fmt::Display for TraceEntry {
+    fn fmt(&self, f: &mut std::fmt::Formatter) -> std::fmt::Result {
+        write!(
+            f,
+            "{:>12} {:04x}  {:<20} A:{:02x} X:{:02x} Y:{:02x} SP:{:02x} PSW:{:02x}",
+            self.smp_clock,
+            self.pc,
+            self.disassemble(),
+            self.a,
+            self.x,
+            self.y,
+            self.sp,
+            self.psw
+        )
+    }
+}
+
+/// Error returned by `ShvcSoundEmu::load_state()`
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct InvalidSaveState;
+
+impl std::fmt::Display for InvalidSaveState {
+    fn fmt(&self, f: &mut std::fmt::Formatter) -> std::fmt::Result {
+        write!(f, "invalid or incompatible emulator save state")
+    }
+}
+
+impl std::error::Error for InvalidSaveState {}
+
+/// Error returned by `ShvcSoundEmu::load_spc()`
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct InvalidSpcFile;
+
+impl std::fmt::Display for InvalidSpcFile {
+    fn fmt(&self, f: &mut std::fmt::Formatter) -> std::fmt::Result {
+        write!(f, "invalid .spc file")
+    }
+}
+
+impl std::error::Error for InvalidSpcFile {}
+
+/// Error returned by `ShvcSoundEmu::render_to_file()`
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct RenderError;
+
+impl std::fmt::Display for RenderError {
+    fn fmt(&self, f: &mut std::fmt::Formatter) -> std::fmt::Result {
+        write!(f, "cannot write WAV file")
+    }
+}
+
+impl std::error::Error for RenderError {}
+
+/// Error returned by `ShvcSoundEmu::set_output_sample_rate()`
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct InvalidSampleRate;
+
+impl std::fmt::Display for InvalidSampleRate {
+    fn fmt(&self, f: &mut std::fmt::Formatter) -> std::fmt::Result {
+        write!(f, "output sample rate out of range")
+    }
+}
+
+impl std::error::Error for InvalidSampleRate {}
+
+/// Error returned by `set_simd_level()`
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct UnsupportedSimdLevel;
+
+impl std::fmt::Display for UnsupportedSimdLevel {
+    fn fmt(&self, f: &mut std::fmt::Formatter) -> std::fmt::Result {
+        write!(f, "SIMD level not supported by this CPU")
+    }
+}
+
+impl std::error::Error for UnsupportedSimdLevel {}
+
+/// Error returned by `ShvcSoundEmu::start_dsp_audition()`
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct SampleTooLarge;
+
+impl std::fmt::Display for SampleTooLarge {
+    fn fmt(&self, f: &mut std::fmt::Formatter) -> std::fmt::Result {
+        write!(f, "BRR sample is too large for a DSP audition")
+    }
+}
+
+impl std::error::Error for SampleTooLarge {}
+
+/// S-DSP voice registers used by `ShvcSoundEmu::start_dsp_audition()`
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct DspAuditionVoice {
+    /// S-DSP pitch register (0x1000 plays the sample at 32000 Hz)
+    pub pitch: u16,
+    pub adsr1: u8,
+    pub adsr2: u8,
+    pub gain: u8,
+    pub vol_l: i8,
+    pub vol_r: i8,
+}
+
+impl DspAuditionVoice {
+    /// Plays the sample at 32000 Hz and full volume (GAIN mode, fixed envelope)
+    pub const BRR_SAMPLE_RATE: Self = Self {
+        pitch: 0x1000,
+        adsr1: 0,
+        adsr2: 0,
+        gain: 0x7f,
+        vol_l: 0x7f,
+        vol_r: 0x7f,
+    };
+}
+
+/// A repeat of the hashed emulator state found by `ShvcSoundEmu::find_loop()`
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct LoopPoint {
+    /// Number of ticks between the `find_loop()` call and the start of the loop
+    pub start_tick: u32,
+    /// Number of ticks in the loop
+    pub length_ticks: u32,
+    /// Number of S-SMP clocks between the `find_loop()` call and the start of the loop
+    pub start_smp_clocks: u64,
+    /// Number of S-SMP clocks in the loop
+    pub length_smp_clocks: u64,
+}
+
+impl LoopPoint {
+    /// Number of stereo samples between the `find_loop()` call and the start of the loop
+    pub fn start_samples(&self) -> u64 {
+        self.start_smp_clocks / ShvcSoundEmu::SMP_CLOCKS_PER_SAMPLE
+    }
+
+    /// Number of stereo samples in the loop
+    ///
+    /// Rounded to the nearest sample (the ticks are not aligned to the sample clock).
+    pub fn length_samples(&self) -> u64 {
+        (self.length_smp_clocks + ShvcSoundEmu::SMP_CLOCKS_PER_SAMPLE / 2)
+            / ShvcSoundEmu::SMP_CLOCKS_PER_SAMPLE
+    }
+}
+
+/// Audio-RAM, register and IO port writes applied by a single `ShvcSoundEmu::apply_batch()` call.
+///
+/// The writes are applied in order.
+#[derive(Default, Clone)]
+pub struct EmulatorBatch {
+    ops: Vec<ffi::BatchOp>,
+    data: Vec<u8>,
+}
+
+impl EmulatorBatch {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.ops.is_empty()
+    }
+
+    pub fn clear(&mut self) {
+        self.ops.clear();
+        self.data.clear();
+    }
+
+    fn push(&mut self, kind: ffi::BatchOpKind, address: u16, data: &[u8]) {
+        self.ops.push(ffi::BatchOp {
+            kind,
+            address,
+            data_offset: self.data.len().try_into().unwrap(),
+            data_size: data.len().try_into().unwrap(),
+        });
+        self.data.extend_from_slice(data);
+    }
+
+    /// Panics if `data` does not fit in Audio-RAM at `addr`
+    pub fn write_apuram(&mut self, addr: u16, data: &[u8]) {
+        assert!(usize::from(addr) + data.len() <= 0x10000);
+
+        if !data.is_empty() {
+            self.push(ffi::BatchOpKind::ApuramWrite, addr, data);
+        }
+    }
+
+    /// This method is not reccomended for the `ESA` and `EDL` registers.
+    pub fn write_dsp_register(&mut self, addr: u8, value: u8) {
+        self.push(ffi::BatchOpKind::DspRegisterWrite, addr.into(), &[value]);
+    }
+
+    pub fn write_smp_register(&mut self, addr: u8, value: u8) {
+        self.push(ffi::BatchOpKind::SmpRegisterWrite, addr.into(), &[value]);
+    }
+
+    pub fn write_io_ports(&mut self, ports: [u8; 4]) {
+        self.push(ffi::BatchOpKind::IoPortsWrite, 0, &ports);
+    }
+}
+
+/// A set of 256 byte Audio-RAM pages
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct ApuramPages([u8; 32]);
+
+impl ApuramPages {
+    pub const ALL: Self = Self([0xff; 32]);
+
+    pub fn contains(&self, page: u8) -> bool {
+        self.0[usize::from(page >> 3)] & (1 << (page & 7)) != 0
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.0.iter().all(|&b| b == 0)
+    }
+}
 
 pub struct ShvcSoundEmu {
+    // MUST be dropped before `voice_taps`
     emu: UniquePtr<ffi::ShvcSoundEmu>,
+
+    /// Ring buffers written by the S-DSP (see `enable_voice_tap()`)
+    voice_taps: [Option<Vec<i16>>; Self::N_VOICES],
+}
+
+/// Forks the emulator.
+///
+/// The clone is a deep copy of the entire emulator state (including the fast path setting).
+/// Voice taps are not cloned.
+impl Clone for ShvcSoundEmu {
+    fn clone(&self) -> Self {
+        let emu = ffi::clone_emulator(&self.emu);
+        if emu.is_null() {
+            panic!("clone_emulator() returned null");
+        }
+        Self {
+            emu,
+            voice_taps: Default::default(),
+        }
+    }
 }
 
+/// `start_dsp_audition()` Audio-RAM layout
+const DSP_AUDITION_DIR_ADDR: u16 = 0x0200;
+const DSP_AUDITION_IDLE_LOOP_ADDR: u16 = 0x0204;
+const DSP_AUDITION_SAMPLE_ADDR: u16 = 0x0206;
+
+// SAFETY: The C++ emulator has no thread affinity and does not share mutable state with other
+// emulators (clones are deep copies and the GDB server is only attached to one emulator).
+// It can be moved to and used by another thread.
+unsafe impl Send for ffi::ShvcSoundEmu {}
+
 impl ShvcSoundEmu {
     pub const AUDIO_BUFFER_SAMPLES: usize = 256;
     pub const AUDIO_BUFFER_SIZE: usize = Self::AUDIO_BUFFER_SAMPLES * 2;
 
+    pub const N_VOICES: usize = 8;
+
+    /// Number of S-SMP clocks per second (2 clocks per S-SMP cycle)
+    pub const SMP_CLOCKS_PER_SECOND: u64 = 2_048_000;
+    /// Number of S-SMP clocks per stereo sample output by the S-DSP
+    pub const SMP_CLOCKS_PER_SAMPLE: u64 = 64;
+
+    /// Sample rate of the S-DSP output
+    pub const SAMPLE_RATE: u32 = 32000;
+    /// Range of `set_output_sample_rate()` sample rates
+    pub const OUTPUT_SAMPLE_RATES: RangeInclusive<u32> = 8000..=192000;
+
+    /// Largest echo buffer sample (15 bit, as read by the FIR filter) `dsp_quiescent()` treats as
+    /// silent (about -66dBFS before the echo volume)
+    pub const QUIESCENT_ECHO_THRESHOLD: u32 = 8;
+
+    /// True if the profiler, watchpoints, audio meters, voice taps, source usage and clipping
+    /// counters are compiled in (the `instrumentation` feature, enabled by default).
+    ///
+    /// Without instrumentation the profiler cannot be enabled, watchpoints are never hit, the
+    /// meters are silent, the voice taps are not written and the usage and clipping counters
+    /// are 0.
+    pub const INSTRUMENTATION: bool = cfg!(feature = "instrumentation");
+
+    /// True if the Audio-RAM access map is compiled in (the `access-map` feature, disabled by
+    /// default).
+    pub const ACCESS_MAP: bool = cfg!(feature = "access-map");
+
+    /// `add_watchpoint()` access kinds
+    pub const WATCH_READ: u8 = 1 << 0;
+    pub const WATCH_WRITE: u8 = 1 << 1;
+    pub const WATCH_EXECUTE: u8 = 1 << 2;
+
+    /// Maximum size of a `start_dsp_audition()` BRR sample
+    pub const MAX_DSP_AUDITION_SAMPLE_SIZE: usize = 0x10000 - DSP_AUDITION_SAMPLE_ADDR as usize;
+
+    /// Offset of the 64 KiB Audio-RAM within a `save_state()` state
+    pub const STATE_APURAM_OFFSET: usize = 8;
+
     #[allow(clippy::new_without_default)]
     pub fn new(iplrom: &[u8; 64]) -> Self {
+        ffi_stats!("new");
         let emu = ffi::new_emulator(iplrom);
         if emu.is_null() {
             panic!("new_emulator() returned null");
         }
-        Self { emu }
+        Self {
+            emu,
+            voice_taps: Default::default(),
+        }
     }
 
     /// CAUTION: also resets S-DSP and S-SMP registers
     pub fn reset(&mut self, registers: ResetRegisters) {
+        ffi_stats!("reset");
         self.emu.pin_mut().reset(registers);
     }
 
+    /// Restores the Audio-RAM, S-DSP registers, S-SMP registers, timers, IO ports and IPL ROM
+    /// enable flag from the contents of a .spc file.
+    ///
+    /// The ID666 tags are ignored.
+    /// The emulator is unchanged if `spc` is not a .spc file.
+    pub fn load_spc(&mut self, spc: &[u8]) -> Result<(), InvalidSpcFile> {
+        ffi_stats!("load_spc");
+        // SAFETY: `spc` contains `spc.len()` bytes
+        let ok = unsafe { self.emu.pin_mut().load_spc(spc.as_ptr(), spc.len()) };
+        match ok {
+            true => Ok(()),
+            false => Err(InvalidSpcFile),
+        }
+    }
+
     pub fn iplrom(&self) -> &[u8; 64] {
+        ffi_stats!("iplrom");
         self.emu.iplrom()
     }
     pub fn iplrom_mut(&mut self) -> &mut [u8; 64] {
+        ffi_stats!("iplrom_mut");
         self.emu.pin_mut().iplrom_mut()
     }
 
     pub fn apuram(&self) -> &[u8; 65536] {
+        ffi_stats!("apuram");
         self.emu.apuram()
     }
+    /// CAUTION: marks every Audio-RAM page as dirty
     pub fn apuram_mut(&mut self) -> &mut [u8; 65536] {
+        ffi_stats!("apuram_mut");
         self.emu.pin_mut().apuram_mut()
     }
 
+    /// Returns the Audio-RAM pages written since the last `clear_dirty_apuram_pages()` call.
+    ///
+    /// Every page is dirty after `apuram_mut()`, `reset()` and `load_state()`.
+    pub fn dirty_apuram_pages(&self) -> ApuramPages {
+        ffi_stats!("dirty_apuram_pages");
+        ApuramPages(self.emu.dirty_apuram_pages())
+    }
+
+    pub fn clear_dirty_apuram_pages(&mut self) {
+        ffi_stats!("clear_dirty_apuram_pages");
+        self.emu.pin_mut().clear_dirty_apuram_pages()
+    }
+
     pub fn dsp_registers(&self) -> &[u8; 128] {
+        ffi_stats!("dsp_registers");
         self.emu.dsp_registers()
     }
 
+    /// Returns a bitmask of the S-DSP registers changed since the last call
+    /// (bit `n` is set if register `n` changed) and clears it.
+    ///
+    /// Every register write is a change (even if the value is unchanged).
+    /// Every register is changed after `reset()`, `load_spc()` and `load_state()`.
+    /// The ENVX, OUTX and ENDX values written by the S-DSP voices are only tracked if enabled by
+    /// `set_track_voice_register_changes()`.
+    pub fn take_dsp_register_changes(&mut self) -> u128 {
+        ffi_stats!("take_dsp_register_changes");
+        u128::from_le_bytes(self.emu.pin_mut().take_dsp_register_changes())
+    }
+
+    /// Enables or disables tracking the ENVX, OUTX and ENDX values written by the S-DSP voices in
+    /// `take_dsp_register_changes()` (disabled by default).
+    pub fn set_track_voice_register_changes(&mut self, enabled: bool) {
+        ffi_stats!("set_track_voice_register_changes");
+        self.emu.pin_mut().set_track_voice_register_changes(enabled)
+    }
+
     /// This method is not reccomended for the `ESA` and `EDL` registers.
     pub fn write_dsp_register(self: &mut ShvcSoundEmu, addr: u8, value: u8) {
+        ffi_stats!("write_dsp_register");
         self.emu.pin_mut().write_dsp_register(addr, value)
     }
 
     pub fn write_smp_register(self: &mut ShvcSoundEmu, addr: u8, value: u8) {
+        ffi_stats!("write_smp_register");
         self.emu.pin_mut().write_smp_register(addr, value)
     }
 
+    /// Resets the emulator and plays a BRR sample on S-DSP voice 0, with the S-SMP in an idle
+    /// loop.
+    ///
+    /// Unlike booting the audio driver, this is near-instant and still emulates the S-DSP's
+    /// BRR decoder, gaussian interpolation, pitch and envelope.
+    /// The echo buffer, noise and pitch modulation are disabled.
+    ///
+    /// `loop_offset` is the byte offset of the loop point within `brr_data` (ignored if the
+    /// sample does not loop).
+    ///
+    /// The voice plays until it reaches the end of a non-looping sample or
+    /// `release_dsp_audition()` is called.
+    pub fn start_dsp_audition(
+        &mut self,
+        brr_data: &[u8],
+        loop_offset: u16,
+        voice: &DspAuditionVoice,
+    ) -> Result<(), SampleTooLarge> {
+        if brr_data.len() > Self::MAX_DSP_AUDITION_SAMPLE_SIZE {
+            return Err(SampleTooLarge);
+        }
+
+        const BRA_OPCODE: u8 = 0x2f;
+
+        let dir = usize::from(DSP_AUDITION_DIR_ADDR);
+        let idle_loop = usize::from(DSP_AUDITION_IDLE_LOOP_ADDR);
+        let sample = usize::from(DSP_AUDITION_SAMPLE_ADDR);
+        let loop_addr = DSP_AUDITION_SAMPLE_ADDR.wrapping_add(loop_offset);
+
+        let apuram = self.apuram_mut();
+        apuram[dir..dir + 2].copy_from_slice(&DSP_AUDITION_SAMPLE_ADDR.to_le_bytes());
+        apuram[dir + 2..dir + 4].copy_from_slice(&loop_addr.to_le_bytes());
+        apuram[idle_loop..idle_loop + 2].copy_from_slice(&[BRA_OPCODE, 0xfe]);
+        apuram[sample..sample + brr_data.len()].copy_from_slice(brr_data);
+
+        self.reset(ResetRegisters {
+            pc: DSP_AUDITION_IDLE_LOOP_ADDR,
+            a: 0,
+            x: 0,
+            y: 0,
+            psw: 0,
+            sp: 0xff,
+            esa: 0,
+            edl: 0,
+        });
+
+        // `reset()` does not clear the S-DSP registers
+        for addr in 0..0x80 {
+            let value = match addr {
+                // FLG: echo writes disabled (mute and soft reset cleared)
+                0x6c => 0x20,
+                // MVOL
+                0x0c | 0x1c => 0x7f,
+                // DIR
+                0x5d => (DSP_AUDITION_DIR_ADDR >> 8) as u8,
+                // Key on is written last
+                0x4c => continue,
+                // ESA and EDL are set by reset()
+                0x6d | 0x7d => continue,
+
+                0x00 => voice.vol_l as u8,
+                0x01 => voice.vol_r as u8,
+                0x02 => voice.pitch.to_le_bytes()[0],
+                0x03 => voice.pitch.to_le_bytes()[1],
+                0x05 => voice.adsr1,
+                0x06 => voice.adsr2,
+                0x07 => voice.gain,
+                _ => 0,
+            };
+            self.write_dsp_register(addr, value);
+        }
+        self.write_dsp_register(0x4c, 0x01);
+
+        Ok(())
+    }
+
+    /// Keys off the `start_dsp_audition()` voice
+    pub fn release_dsp_audition(&mut self) {
+        self.write_dsp_register(0x5c, 0x01);
+    }
+
+    /// Returns the number of S-DSP clocks since power-on or reset (32 clocks per sample).
+    pub fn dsp_clock(&self) -> u64 {
+        ffi_stats!("dsp_clock");
+        self.emu.dsp_clock()
+    }
+
+    /// Returns the S-SMP clock, S-SMP instruction, S-DSP clock and output sample counters.
+    ///
+    /// The counters increase monotonically from power-on or reset and are not part of the save
+    /// state.
+    pub fn counters(&mut self) -> EmulatorCounters {
+        ffi_stats!("counters");
+        self.emu.pin_mut().counters()
+    }
+
+    /// Copies the audio driver channel variables (at the `layout` addresses), the S-DSP voice
+    /// pitches, envelopes and key-on state in a single call.
+    ///
+    /// Intended to be called once per emulated chunk and published with a `snapshot_buffer()`
+    /// so another thread can display the channels without reading Audio-RAM.
+    pub fn monitor_snapshot(&mut self, layout: &MonitorLayout) -> MonitorSnapshot {
+        ffi_stats!("monitor_snapshot");
+        self.emu.pin_mut().monitor_snapshot(layout)
+    }
+
+    /// Starts recording every S-DSP register write (including `write_dsp_register()` writes) and
+    /// every S-SMP Audio-RAM write.
+    ///
+    /// Space for `capacity` writes of each kind is preallocated, the logs grow if it is exceeded.
+    /// Previously recorded writes are discarded.
+    /// `apuram_mut()` writes are not recorded and the logs are not part of the save state.
+    ///
+    /// The S-SMP emulation is slower while recording.
+    pub fn start_dsp_log(&mut self, capacity: usize) {
+        ffi_stats!("start_dsp_log");
+        self.emu.pin_mut().start_dsp_log(capacity)
+    }
+
+    pub fn stop_dsp_log(&mut self) {
+        ffi_stats!("stop_dsp_log");
+        self.emu.pin_mut().stop_dsp_log()
+    }
+
+    /// Returns and clears the recorded S-DSP register writes.
+    ///
+    /// Recording continues if `stop_dsp_log()` has not been called.
+    pub fn take_dsp_register_log(&mut self) -> Vec<DspRegisterWrite> {
+        ffi_stats!("take_dsp_register_log");
+        self.emu.pin_mut().take_dsp_register_log()
+    }
+
+    /// Returns and clears the recorded S-SMP Audio-RAM writes.
+    ///
+    /// Recording continues if `stop_dsp_log()` has not been called.
+    pub fn take_apuram_write_log(&mut self) -> Vec<ApuramWrite> {
+        ffi_stats!("take_apuram_write_log");
+        self.emu.pin_mut().take_apuram_write_log()
+    }
+
+    /// Starts recording every voice key-on, every voice key-off that releases a voice and every
+    /// audio driver tick (a non-zero T0OUT read) with the S-DSP clock it occurred on.
+    ///
+    /// Space for `capacity` events is preallocated, the log grows if it is exceeded.
+    /// Previously recorded events are discarded.
+    /// The log is not part of the save state.
+    ///
+    /// Unlike `start_dsp_log()`, recording does not slow down the S-SMP emulation.
+    /// Drain the log with `take_event_log()` after every emulated chunk.
+    pub fn start_event_log(&mut self, capacity: usize) {
+        ffi_stats!("start_event_log");
+        self.emu.pin_mut().start_event_log(capacity)
+    }
+
+    pub fn stop_event_log(&mut self) {
+        ffi_stats!("stop_event_log");
+        self.emu.pin_mut().stop_event_log()
+    }
+
+    /// Returns and clears the recorded events (in the order they occurred).
+    ///
+    /// Recording continues if `stop_event_log()` has not been called.
+    pub fn take_event_log(&mut self) -> Vec<SoundEvent> {
+        ffi_stats!("take_event_log");
+        self.emu.pin_mut().take_event_log()
+    }
+
+    /// Emulates the S-DSP alone (without the S-SMP), applying the writes recorded by
+    /// `start_dsp_log()` on the S-DSP clock they occurred on.
+    ///
+    /// The emulator MUST start in the state it was in when the log was started (see
+    /// `save_state()`).
+    /// Writes before the current `dsp_clock()` are skipped, so a log can be replayed in chunks.
+    ///
+    /// Afterwards the S-SMP and timers are no longer in sync with the S-DSP, the emulator state
+    /// must be restored before emulating the S-SMP again.
+    pub fn replay_dsp_log(
+        &mut self,
+        registers: &[DspRegisterWrite],
+        apuram: &[ApuramWrite],
+        out: &mut [i16],
+    ) {
+        ffi_stats!("replay_dsp_log");
+        assert!(
+            out.len() % 2 == 0,
+            "out must contain an even number of samples"
+        );
+
+        // SAFETY: `out` contains `out.len() / 2` stereo frames
+        unsafe {
+            self.emu
+                .pin_mut()
+                .replay_dsp_log(registers, apuram, out.as_mut_ptr(), out.len() / 2)
+        }
+    }
+
     pub fn read_io_ports(&self) -> [u8; 4] {
+        ffi_stats!("read_io_ports");
         self.emu.read_io_ports()
     }
 
     pub fn write_io_ports(&mut self, ports: [u8; 4]) {
+        ffi_stats!("write_io_ports");
         self.emu.pin_mut().write_io_ports(ports)
     }
 
+    /// Queues an IO port write that is applied before the first S-SMP instruction at or after
+    /// `smp_clock` (S-SMP clocks since reset, see `counters()`), without stopping the emulation.
+    ///
+    /// Writes with the same `smp_clock` are applied in the order they were scheduled, writes in
+    /// the past are applied before the next instruction.
+    /// The queue is cleared by `reset()` and is not part of the save state.
+    pub fn schedule_port_write(&mut self, smp_clock: u64, ports: [u8; 4]) {
+        ffi_stats!("schedule_port_write");
+        self.emu.pin_mut().schedule_port_write(smp_clock, ports)
+    }
+
+    pub fn clear_scheduled_port_writes(&mut self) {
+        ffi_stats!("clear_scheduled_port_writes");
+        self.emu.pin_mut().clear_scheduled_port_writes()
+    }
+
+    /// Returns the number of scheduled port writes that have not been applied
+    pub fn scheduled_port_writes(&self) -> usize {
+        ffi_stats!("scheduled_port_writes");
+        self.emu.scheduled_port_writes()
+    }
+
+    /// Clears the IO command latency histograms and starts measuring IO command latencies.
+    ///
+    /// Every S-CPU write that changes port 0 (`write_io_ports()`, `schedule_port_write()` or a
+    /// batch) starts a measurement.  The clocks until the S-SMP writes the same value to port 0
+    /// are added to the `ack` histogram.  If `command & key_on_mask == key_on_command`, the
+    /// clocks until the next non-zero KON write are added to the `key_on` histogram.
+    ///
+    /// A command replaced before it is acknowledged is counted in `unacknowledged`.
+    /// The histograms are not part of the save state.
+    pub fn start_io_latency(&mut self, key_on_mask: u8, key_on_command: u8) {
+        ffi_stats!("start_io_latency");
+        self.emu
+            .pin_mut()
+            .start_io_latency(key_on_mask, key_on_command)
+    }
+
+    pub fn stop_io_latency(&mut self) {
+        ffi_stats!("stop_io_latency");
+        self.emu.pin_mut().stop_io_latency()
+    }
+
+    /// Returns the IO command latencies recorded since `start_io_latency()` was called
+    pub fn io_latency(&self) -> IoLatency {
+        ffi_stats!("io_latency");
+        self.emu.io_latency()
+    }
+
     pub fn program_counter(self: &ShvcSoundEmu) -> u16 {
+        ffi_stats!("program_counter");
         self.emu.program_counter()
     }
 
+    /// Returns true if the S-SMP has executed a `SLEEP` or `STOP` instruction.
+    ///
+    /// A halted S-SMP will not execute another instruction until `reset()` (the S-DSP keeps
+    /// outputting audio).
+    /// The `run_until_*()` and `run_ticks()` methods return immediately (with `hit` false) if
+    /// the S-SMP is halted and `render_to_file()` stops once a halted emulator is silent.
+    pub fn halted(&self) -> bool {
+        ffi_stats!("halted");
+        self.emu.halted()
+    }
+
+    /// Returns true if the S-DSP will output silence until the S-SMP writes to a S-DSP register.
+    ///
+    /// The S-DSP is quiescent when every voice has been keyed-off and its envelope is zero,
+    /// no key-on is pending and the echo buffer and FIR history have decayed to within
+    /// `QUIESCENT_ECHO_THRESHOLD` of zero (or both echo volumes are zero).
+    ///
+    /// The echo feedback rounds towards negative infinity and can leave a small residue in the
+    /// echo buffer that never decays to zero.
+    pub fn dsp_quiescent(&self) -> bool {
+        ffi_stats!("dsp_quiescent");
+        self.emu.dsp_quiescent(Self::QUIESCENT_ECHO_THRESHOLD)
+    }
+
+    /// Returns the lowest S-SMP stack pointer reached by a push (including calls and
+    /// interrupts) since the last `reset()`, `load_spc()`, `load_state()` or
+    /// `reset_stack_min()` call.
+    ///
+    /// The stack bytes at `$0100` to `$0100 + stack_min()` have not been pushed to.
+    /// `MOV SP, X` does not change the stack minimum.
+    pub fn stack_min(&self) -> u8 {
+        ffi_stats!("stack_min");
+        self.emu.stack_min()
+    }
+
+    /// Sets the stack minimum to the current stack pointer (see `stack_min()`)
+    pub fn reset_stack_min(&mut self) {
+        ffi_stats!("reset_stack_min");
+        self.emu.pin_mut().reset_stack_min()
+    }
+
+    /// Returns the S-SMP registers (on an instruction boundary).
+    pub fn smp_registers(&self) -> SmpRegisters {
+        ffi_stats!("smp_registers");
+        self.emu.smp_registers()
+    }
+
+    /// Applies every write in `batch` with a single call into the emulator.
+    ///
+    /// Unlike `apuram_mut()`, only the Audio-RAM pages written by the batch are marked dirty.
+    pub fn apply_batch(&mut self, batch: &EmulatorBatch) {
+        ffi_stats!("apply_batch");
+        self.emu.pin_mut().apply_batch(&batch.ops, &batch.data)
+    }
+
+    /// Saves the S-SMP, S-DSP, timer, IO port and Audio-RAM state (including the IPL ROM).
+    ///
+    /// The state is a versioned binary blob that can only be loaded by the same emulator version.
+    pub fn save_state(&self) -> Vec<u8> {
+        ffi_stats!("save_state");
+        self.emu.save_state().as_slice().to_vec()
+    }
+
+    /// Restores a state saved by `save_state()`.
+    ///
+    /// The fast path setting is not part of the state.
+    /// The emulator is unchanged if `state` is invalid.
+    pub fn load_state(&mut self, state: &[u8]) -> Result<(), InvalidSaveState> {
+        ffi_stats!("load_state");
+        // SAFETY: `state` contains `state.len()` bytes
+        let ok = unsafe { self.emu.pin_mut().load_state(state.as_ptr(), state.len()) };
+        match ok {
+            true => Ok(()),
+            false => Err(InvalidSaveState),
+        }
+    }
+
+    /// Returns a hash of the entire emulator state (the state saved by `save_state()`).
+    ///
+    /// Emulators with the same S-SMP, S-DSP, timer, IO port and Audio-RAM state have the same
+    /// hash, regardless of the fast path setting.
+    pub fn state_hash(&self) -> u64 {
+        ffi_stats!("state_hash");
+        self.emu.state_hash()
+    }
+
+    /// Returns a hash of the Audio-RAM `ranges`, the S-DSP registers and the internal S-DSP voice
+    /// state.
+    ///
+    /// Unlike `state_hash()`, the S-SMP registers, timers, S-DSP echo state, noise generator and
+    /// envelope rate counter are not hashed.
+    pub fn state_hash_ranges(&self, ranges: &[RangeInclusive<u16>]) -> u64 {
+        ffi_stats!("state_hash_ranges");
+        let ranges: Vec<ffi::ApuramRange> = ranges
+            .iter()
+            .map(|r| ffi::ApuramRange {
+                first: *r.start(),
+                last: *r.end(),
+            })
+            .collect();
+
+        self.emu.state_hash_ranges(&ranges)
+    }
+
+    /// Emulates the audio driver one tick at a time (see `run_ticks()`) until the
+    /// `state_hash_ranges()` hash at the start of a tick matches the hash of an earlier tick.
+    ///
+    /// `ranges` MUST NOT contain variables that never repeat (ie, a song tick counter).
+    ///
+    /// Returns `None` if the state did not repeat within `max_ticks` ticks or the audio driver
+    /// did not reach `tick_pc` within a second.
+    pub fn find_loop(
+        &mut self,
+        tick_pc: u16,
+        ranges: &[RangeInclusive<u16>],
+        max_ticks: u32,
+    ) -> Option<LoopPoint> {
+        let mut seen: std::collections::HashMap<u64, (u32, u64)> = std::collections::HashMap::new();
+
+        let mut smp_clocks = 0;
+
+        for tick in 0..max_ticks {
+            let r = self.run_ticks(1, tick_pc, Self::SMP_CLOCKS_PER_SECOND);
+            if !r.hit {
+                return None;
+            }
+            smp_clocks += r.smp_clocks;
+
+            let hash = self.state_hash_ranges(ranges);
+            if let Some(&(start_tick, start_smp_clocks)) = seen.get(&hash) {
+                return Some(LoopPoint {
+                    start_tick,
+                    length_ticks: tick - start_tick,
+                    start_smp_clocks,
+                    length_smp_clocks: smp_clocks - start_smp_clocks,
+                });
+            }
+            seen.insert(hash, (tick, smp_clocks));
+        }
+
+        None
+    }
+
+    /// Enables or disables the emulator fast paths (enabled by default).
+    ///
+    /// The fast paths output identical audio and S-SMP visible state.
+    /// Disabling them is only useful when testing the fast paths.
+    pub fn set_fast_paths(&mut self, enabled: bool) {
+        ffi_stats!("set_fast_paths");
+        self.emu.pin_mut().set_fast_paths(enabled)
+    }
+
+    /// Enables or disables the decoded BRR sample cache (disabled by default).
+    ///
+    /// The cache outputs identical audio and state.  It speeds up songs that repeatedly decode
+    /// the same looping samples, but it costs a lookup for every BRR decode and 64 KiB of memory
+    /// (which is copied when the emulator is cloned).
+    pub fn set_brr_cache_enabled(&mut self, enabled: bool) {
+        ffi_stats!("set_brr_cache_enabled");
+        self.emu.pin_mut().set_brr_cache_enabled(enabled)
+    }
+
+    /// Enables or disables the S-DSP logic only mode (disabled by default).
+    ///
+    /// In logic only mode the S-DSP registers, the KON/KOFF latches, `ENDX` clearing on KON,
+    /// the noise generator and the echo buffer writes are emulated, but the voices are not
+    /// decoded, enveloped or mixed.  The `ENVX`, `OUTX` and `ENDX` BRR end bits are not updated
+    /// and the output only contains the echo feedback.
+    ///
+    /// Unlike `fast_forward()`, the S-SMP visible S-DSP state is not accurate.  It is intended
+    /// for tests that only read the audio driver's variables and is not part of the save state
+    /// (the state hash of a logic only emulator will not match a regular emulator).
+    pub fn set_logic_only(&mut self, enabled: bool) {
+        ffi_stats!("set_logic_only");
+        self.emu.pin_mut().set_logic_only(enabled)
+    }
+
     pub fn emulate(&mut self) -> &[i16; Self::AUDIO_BUFFER_SIZE] {
+        ffi_stats!("emulate");
         self.emu.pin_mut().emulate()
     }
+
+    /// Mutes the S-DSP voices in `mask` (bit `n` = voice `n`) without changing the audio driver's
+    /// behaviour.
+    ///
+    /// Muted voices are not added to the main or echo output, they are still emulated, metered
+    /// and tapped.  If `skip_interpolation` is true, muted voices are not interpolated either,
+    /// which silences their meters, taps, `OUTX` register and the pitch modulation of the next
+    /// voice.
+    ///
+    /// The mask is a debug setting, it is not part of the save state.
+    pub fn set_voice_mute_mask(&mut self, mask: u8, skip_interpolation: bool) {
+        ffi_stats!("set_voice_mute_mask");
+        self.emu
+            .pin_mut()
+            .set_voice_mute_mask(mask, skip_interpolation)
+    }
+
+    /// Starts writing the output of `voice` (after the voice volume, before mixing) to a ring
+    /// buffer of `frames` stereo samples.
+    ///
+    /// The tap costs nothing while it is disabled.  Fast forwarded audio is not tapped.
+    ///
+    /// Panics if `voice` >= `N_VOICES` or `frames` is 0.
+    pub fn enable_voice_tap(&mut self, voice: usize, frames: usize) {
+        ffi_stats!("enable_voice_tap");
+        assert!(voice < Self::N_VOICES);
+        assert!(frames > 0);
+
+        let buffer = self.voice_taps[voice].insert(vec![0; frames * 2]);
+
+        // SAFETY: `buffer` contains `frames * 2` samples and is not resized or dropped until the
+        // tap is changed or the emulator is dropped.
+        unsafe {
+            self.emu
+                .pin_mut()
+                .set_voice_tap(voice as u8, buffer.as_mut_ptr(), frames)
+        }
+    }
+
+    pub fn disable_voice_tap(&mut self, voice: usize) {
+        ffi_stats!("disable_voice_tap");
+        assert!(voice < Self::N_VOICES);
+
+        // SAFETY: a null buffer disables the tap
+        unsafe {
+            self.emu
+                .pin_mut()
+                .set_voice_tap(voice as u8, std::ptr::null_mut(), 0)
+        }
+        self.voice_taps[voice] = None;
+    }
+
+    /// Returns the ring buffer of an enabled voice tap and the number of stereo samples written
+    /// to it since it was enabled.
+    ///
+    /// Stereo sample `n` is stored at `buffer[(n % frames) * 2..][..2]`.
+    pub fn voice_tap(&self, voice: usize) -> Option<(&[i16], u64)> {
+        ffi_stats!("voice_tap");
+        let buffer = self.voice_taps.get(voice)?.as_deref()?;
+        Some((buffer, self.emu.voice_tap_position(voice as u8)))
+    }
+
+    /// Enables or disables the S-SMP profiler.
+    ///
+    /// The profiler adds the S-SMP clocks spent executing each instruction to a 64K-entry
+    /// histogram indexed by the instruction's address.  Skipped idle loop iterations are added to
+    /// the loop's backward branch.
+    ///
+    /// Enabling the profiler clears the histogram.
+    /// The histogram is not part of the save state and is not cloned.
+    pub fn set_profiler_enabled(&mut self, enabled: bool) {
+        ffi_stats!("set_profiler_enabled");
+        self.emu.pin_mut().set_profiler_enabled(enabled)
+    }
+
+    /// Returns the profiler histogram (S-SMP clocks per instruction address) or `None` if the
+    /// profiler is disabled.
+    pub fn profile(&self) -> Option<&[u64; 0x10000]> {
+        ffi_stats!("profile");
+        self.emu.profile().try_into().ok()
+    }
+
+    /// Enables or disables the Audio-RAM access map.
+    ///
+    /// The access map records which Audio-RAM bytes are read (`WATCH_READ`), written
+    /// (`WATCH_WRITE`) and executed (`WATCH_EXECUTE`) by the S-SMP and which bytes the S-DSP
+    /// reads (sample directory, BRR and echo buffer) and writes (echo buffer).
+    /// The S-SMP memory fast paths are disabled while the access map is enabled.
+    ///
+    /// Enabling the access map clears it.  Ignored if `ACCESS_MAP` is false.
+    /// The access map is not part of the save state, it is cloned with the emulator.
+    pub fn set_access_map_enabled(&mut self, enabled: bool) {
+        ffi_stats!("set_access_map_enabled");
+        self.emu.pin_mut().set_access_map_enabled(enabled)
+    }
+
+    /// Returns the access kinds of every Audio-RAM byte or `None` if the access map is disabled.
+    pub fn access_map(&self) -> Option<&[u8; 0x10000]> {
+        ffi_stats!("access_map");
+        self.emu.access_map().try_into().ok()
+    }
+
+    /// Guards the Audio-RAM `addresses` against S-DSP echo buffer writes (ie, the song and
+    /// sample data if the echo buffer is misconfigured), replacing the previous guard.
+    ///
+    /// The first echo buffer write to a guarded address is recorded (see
+    /// `take_echo_guard_hit()`), the write is not blocked.
+    /// The guard is not part of the save state, it is cloned with the emulator.
+    pub fn set_echo_guard(&mut self, addresses: RangeInclusive<u16>) {
+        ffi_stats!("set_echo_guard");
+        self.emu
+            .pin_mut()
+            .set_echo_guard(*addresses.start(), *addresses.end())
+    }
+
+    pub fn clear_echo_guard(&mut self) {
+        ffi_stats!("clear_echo_guard");
+        self.emu.pin_mut().clear_echo_guard()
+    }
+
+    /// Returns the first echo buffer write to the `set_echo_guard()` addresses since the guard
+    /// was set or the previous `take_echo_guard_hit()` call, then rearms the guard.
+    pub fn take_echo_guard_hit(&mut self) -> Option<EchoGuardHit> {
+        ffi_stats!("take_echo_guard_hit");
+        Some(self.emu.pin_mut().take_echo_guard_hit()).filter(|h| h.hit)
+    }
+
+    /// Adds a watchpoint on the Audio-RAM `addresses`.
+    ///
+    /// `kinds` is a bitmask of the accesses to watch (`WATCH_READ`, `WATCH_WRITE` and
+    /// `WATCH_EXECUTE`).  Instruction fetches are reads, execute watchpoints are only tested
+    /// against the opcode address.
+    ///
+    /// Only accesses to the 256 byte pages containing a read or write watchpoint are slowed down.
+    pub fn add_watchpoint(&mut self, addresses: RangeInclusive<u16>, kinds: u8) {
+        ffi_stats!("add_watchpoint");
+        self.emu
+            .pin_mut()
+            .add_watchpoint(*addresses.start(), *addresses.end(), kinds)
+    }
+
+    pub fn clear_watchpoints(&mut self) {
+        ffi_stats!("clear_watchpoints");
+        self.emu.pin_mut().clear_watchpoints()
+    }
+
+    /// Records the last `capacity` watchpoint hits in a ring buffer (0 only counts the hits).
+    ///
+    /// Previously recorded hits are discarded.
+    pub fn set_watchpoint_log_size(&mut self, capacity: usize) {
+        ffi_stats!("set_watchpoint_log_size");
+        self.emu.pin_mut().set_watchpoint_log_size(capacity)
+    }
+
+    /// Returns (oldest first) and clears the recorded watchpoint hits that have not been
+    /// overwritten.
+    pub fn take_watchpoint_hits(&mut self) -> Vec<WatchpointHit> {
+        ffi_stats!("take_watchpoint_hits");
+        self.emu.pin_mut().take_watchpoint_hits()
+    }
+
+    /// Returns the number of watchpoint hits since the log size was set (including overwritten
+    /// hits).
+    pub fn watchpoint_hit_count(&self) -> u64 {
+        ffi_stats!("watchpoint_hit_count");
+        self.emu.watchpoint_hit_count()
+    }
+
+    /// Records the last `entries` (rounded up to a power of two) executed S-SMP instructions in a
+    /// ring buffer (0 disables the trace).
+    ///
+    /// Previously recorded instructions are discarded.  Skipped idle loop iterations are not
+    /// recorded.  The trace is not part of the save state and is not cloned.
+    pub fn set_trace_size(&mut self, entries: usize) {
+        ffi_stats!("set_trace_size");
+        self.emu.pin_mut().set_trace_size(entries)
+    }
+
+    /// Returns the recorded instructions (oldest first) that have not been overwritten.
+    pub fn trace(&self) -> Vec<TraceEntry> {
+        ffi_stats!("trace");
+        self.emu.trace()
+    }
+
+    /// Returns the number of instructions recorded since the trace size was set (including
+    /// overwritten instructions).
+    pub fn trace_count(&self) -> u64 {
+        ffi_stats!("trace_count");
+        self.emu.trace_count()
+    }
+
+    /// Disassembles the instruction at `address`.
+    pub fn disassemble(&self, address: u16) -> String {
+        ffi_stats!("disassemble");
+        self.emu.disassemble(address)
+    }
+
+    /// Starts a GDB remote protocol server on localhost `port` that debugs this emulator.
+    ///
+    /// Only one emulator can be debugged at a time.  The debugger's commands are processed by
+    /// the emulate and run functions, which block while the debugger has halted the S-SMP.
+    ///
+    /// Registers (in `g` packet order): `pc` (16 bits, little endian), `a`, `x`, `y`, `sp`, `psw`.
+    ///
+    /// Returns false if the server could not be started or shvc-sound-emu was built without the
+    /// `gdb-server` feature.
+    pub fn start_gdb_server(&mut self, port: u16) -> bool {
+        ffi_stats!("start_gdb_server");
+        self.emu.pin_mut().start_gdb_server(port)
+    }
+
+    /// Stops the GDB server (if it is debugging this emulator).
+    pub fn stop_gdb_server(&mut self) {
+        ffi_stats!("stop_gdb_server");
+        self.emu.pin_mut().stop_gdb_server()
+    }
+
+    /// Returns the peak and RMS levels of every voice and of the main output since the previous
+    /// `meters()` call, then resets them.
+    ///
+    /// The levels are accumulated while emulating, fast forwarded audio is not metered.
+    pub fn meters(&mut self) -> AudioMeters {
+        ffi_stats!("meters");
+        self.emu.pin_mut().meters()
+    }
+
+    /// Returns the number of keyons and decoded BRR blocks of each S-DSP source number since the
+    /// previous `take_source_usage()` call, then resets them.
+    ///
+    /// A voice's BRR blocks are counted against its SRCN when it was keyed on (including
+    /// fast forwarded audio).
+    pub fn take_source_usage(&mut self) -> SourceUsage {
+        ffi_stats!("take_source_usage");
+        self.emu.pin_mut().take_source_usage()
+    }
+
+    /// Returns the number of samples saturated by each S-DSP mixer stage since the previous
+    /// `take_clipping()` call, then resets them.
+    ///
+    /// The `main` and `output` stages are not mixed (or counted) when fast forwarding.
+    pub fn take_clipping(&mut self) -> ClippingCounters {
+        ffi_stats!("take_clipping");
+        self.emu.pin_mut().take_clipping()
+    }
+
+    /// Emulates at least `smp_clocks` S-SMP clocks without mixing or outputting audio.
+    ///
+    /// All S-SMP observable state (including the S-DSP `ENVX`, `OUTX` and `ENDX` registers and
+    /// echo buffer writes) is emulated.
+    ///
+    /// Returns the number of S-SMP clocks emulated.
+    pub fn fast_forward(&mut self, smp_clocks: u64) -> u64 {
+        ffi_stats!("fast_forward");
+        self.emu.pin_mut().fast_forward(smp_clocks)
+    }
+
+    /// Emulates S-SMP instructions until the program counter is `pc` or `max_smp_clocks`
+    /// have elapsed.
+    ///
+    /// The program counter is only tested on instruction boundaries.
+    /// Audio is not mixed or output (see `fast_forward()`).
+    pub fn run_until_pc(&mut self, pc: u16, max_smp_clocks: u64) -> RunResult {
+        ffi_stats!("run_until_pc");
+        self.emu.pin_mut().run_until_pc(pc, max_smp_clocks)
+    }
+
+    /// Emulates S-SMP instructions until the S-SMP writes to an IO port in `port_mask`
+    /// (bit 0 = port 0, bit 3 = port 3) or `max_smp_clocks` have elapsed.
+    ///
+    /// Stops on the instruction boundary after the write.
+    /// Audio is not mixed or output (see `fast_forward()`).
+    pub fn run_until_port_write(&mut self, port_mask: u8, max_smp_clocks: u64) -> RunResult {
+        ffi_stats!("run_until_port_write");
+        self.emu
+            .pin_mut()
+            .run_until_port_write(port_mask, max_smp_clocks)
+    }
+
+    /// Emulates S-SMP instructions until a watchpoint is hit or `max_smp_clocks` have elapsed.
+    ///
+    /// Stops on the instruction boundary after the access.
+    /// Audio is not mixed or output (see `fast_forward()`).
+    pub fn run_until_watchpoint(&mut self, max_smp_clocks: u64) -> RunResult {
+        ffi_stats!("run_until_watchpoint");
+        self.emu.pin_mut().run_until_watchpoint(max_smp_clocks)
+    }
+
+    /// Emulates S-SMP instructions until the program counter has reached `tick_pc` `ticks`
+    /// times or `max_smp_clocks` have elapsed.
+    ///
+    /// A `tick_pc` hit is only counted if timer 0 has output since the previous counted hit (or
+    /// since the call), so a driver routine that is called once per timer tick (ie,
+    /// `process_music_channels()`) can be stepped exactly one tick at a time.
+    /// `tick_pc` must not be inside an idle loop, as idle loops are skipped.
+    ///
+    /// Stops on the instruction boundary at `tick_pc`, before the tick is processed.
+    /// Audio is not mixed or output (see `fast_forward()`).
+    pub fn run_ticks(&mut self, ticks: u32, tick_pc: u16, max_smp_clocks: u64) -> RunResult {
+        ffi_stats!("run_ticks");
+        self.emu.pin_mut().run_ticks(ticks, tick_pc, max_smp_clocks)
+    }
+
+    /// Transfers data to the loader with the timing of the S-CPU APIs' transfer loops.
+    ///
+    /// The loader MUST be running (or about to run) when this method is called.
+    /// The transfers are performed in order and each transfer waits for the loader's ready signal.
+    /// Stops after the first transfer that timed out.
+    ///
+    /// Returns a result for each transfer that was started.
+    pub fn simulate_loader_transfers(
+        &mut self,
+        timing: &ScpuLoaderTiming,
+        transfers: &[LoaderTransfer],
+    ) -> Vec<LoaderTransferResult> {
+        ffi_stats!("simulate_loader_transfers");
+        ffi::simulate_loader_transfers(self.emu.pin_mut(), timing, transfers)
+    }
+
+    /// Emulates `smp_clocks` S-SMP clocks and streams the audio to a 16 bit stereo WAV file.
+    ///
+    /// The audio is rendered and written entirely in C++ (with a large write buffer).
+    /// A `path` of `-` writes the WAV file to stdout.
+    ///
+    /// If `stop_after_silence` is `Some`, rendering stops after that many consecutive silent
+    /// samples.
+    /// Rendering also stops early if the S-SMP has halted (see `halted()`) and the output is
+    /// silent.
+    ///
+    /// Returns the number of stereo samples written.
+    pub fn render_to_file(
+        &mut self,
+        path: &std::path::Path,
+        smp_clocks: u64,
+        stop_after_silence: Option<u32>,
+    ) -> Result<u64, RenderError> {
+        ffi_stats!("render_to_file");
+        let path = path.to_str().ok_or(RenderError)?;
+
+        let r =
+            self.emu
+                .pin_mut()
+                .render_to_file(path, smp_clocks, stop_after_silence.unwrap_or(0));
+        match r.ok {
+            true => Ok(r.frames),
+            false => Err(RenderError),
+        }
+    }
+
+    /// Emulates until `out` is full of interleaved stereo samples.
+    ///
+    /// Panics if `out` does not contain an even number of samples.
+    pub fn emulate_into(&mut self, out: &mut [i16]) {
+        ffi_stats!("emulate_into");
+        assert!(
+            out.len() % 2 == 0,
+            "out must contain an even number of samples"
+        );
+
+        // SAFETY: `out` contains `out.len() / 2` stereo frames
+        unsafe {
+            self.emu
+                .pin_mut()
+                .emulate_into(out.as_mut_ptr(), out.len() / 2)
+        }
+    }
+
+    /// Sets the sample rate of `emulate_resampled()` (see `OUTPUT_SAMPLE_RATES`) and how the
+    /// S-DSP output is interpolated to it.
+    ///
+    /// `Linear` and `Cubic` are cheap enough for live previews, `Sinc` is intended for offline
+    /// renders.  The output sample rate defaults to `SAMPLE_RATE`.
+    ///
+    /// Clears the resampler history.  The resampler is copied when the emulator is cloned, it is
+    /// not part of the save state (`reset()` and `load_state()` clear its history).
+    pub fn set_output_sample_rate(
+        &mut self,
+        rate: u32,
+        quality: ResamplerQuality,
+    ) -> Result<(), InvalidSampleRate> {
+        ffi_stats!("set_output_sample_rate");
+        match self.emu.pin_mut().set_output_sample_rate(rate, quality) {
+            true => Ok(()),
+            false => Err(InvalidSampleRate),
+        }
+    }
+
+    pub fn output_sample_rate(&self) -> u32 {
+        ffi_stats!("output_sample_rate");
+        self.emu.output_sample_rate()
+    }
+
+    /// Emulates until `out` is full of interleaved stereo samples at the output sample rate.
+    ///
+    /// The resampler keeps its position between calls, the output is continuous no matter how
+    /// `out` is sized.
+    ///
+    /// Panics if `out` does not contain an even number of samples.
+    pub fn emulate_resampled(&mut self, out: &mut [i16]) {
+        ffi_stats!("emulate_resampled");
+        assert!(
+            out.len() % 2 == 0,
+            "out must contain an even number of samples"
+        );
+
+        // SAFETY: `out` contains `out.len() / 2` stereo frames
+        unsafe {
+            self.emu
+                .pin_mut()
+                .emulate_resampled(out.as_mut_ptr(), out.len() / 2)
+        }
+    }
+
+    /// Emulates until `left` and `right` are full of the left and right channel samples.
+    ///
+    /// Panics if `left` and `right` are not the same length.
+    pub fn emulate_planar_into(&mut self, left: &mut [i16], right: &mut [i16]) {
+        ffi_stats!("emulate_planar_into");
+        assert_eq!(
+            left.len(),
+            right.len(),
+            "left and right must be the same length"
+        );
+
+        // SAFETY: `left` and `right` contain `left.len()` samples
+        unsafe {
+            self.emu.pin_mut().emulate_planar_into(
+                left.as_mut_ptr(),
+                right.as_mut_ptr(),
+                left.len(),
+            )
+        }
+    }
+
+    /// Emulates until `out` is full of mono samples (the average of the left and right channels,
+    /// rounded down).
+    pub fn emulate_mono_into(&mut self, out: &mut [i16]) {
+        ffi_stats!("emulate_mono_into");
+        // SAFETY: `out` contains `out.len()` samples
+        unsafe {
+            self.emu
+                .pin_mut()
+                .emulate_mono_into(out.as_mut_ptr(), out.len())
+        }
+    }
+
+    /// Emulates `out.len() * bin_frames` samples and writes the `[minimum, maximum]` sample (of
+    /// both channels) of every `bin_frames` samples to `out`.
+    ///
+    /// The samples are mixed but not stored, a whole-song waveform overview only costs the
+    /// emulation and `out`.
+    ///
+    /// Panics if `bin_frames` is 0.
+    pub fn emulate_waveform_overview(&mut self, out: &mut [[i16; 2]], bin_frames: u32) {
+        ffi_stats!("emulate_waveform_overview");
+        assert!(bin_frames > 0, "bin_frames must not be 0");
+
+        // SAFETY: `out` contains `out.len()` pairs of `i16` samples
+        unsafe {
+            self.emu.pin_mut().emulate_waveform_overview(
+                out.as_mut_ptr().cast(),
+                out.len(),
+                bin_frames,
+            )
+        }
+    }
+
+    /// Emulates until `out` is full of interleaved stereo samples or `max_smp_clocks` have
+    /// elapsed (overshooting by at most one S-SMP instruction), whichever comes first.
+    ///
+    /// Returns the number of stereo samples written to the start of `out`.
+    /// A partially emulated sample is completed by the next emulate call, so a deadline-aware
+    /// caller can emulate in small slices without dropping or duplicating samples.
+    ///
+    /// Panics if `out` does not contain an even number of samples.
+    pub fn emulate_for(&mut self, out: &mut [i16], max_smp_clocks: u64) -> usize {
+        ffi_stats!("emulate_for");
+        assert!(
+            out.len() % 2 == 0,
+            "out must contain an even number of samples"
+        );
+
+        // SAFETY: `out` contains `out.len() / 2` stereo frames
+        unsafe {
+            self.emu
+                .pin_mut()
+                .emulate_for(out.as_mut_ptr(), out.len() / 2, max_smp_clocks)
+        }
+    }
+}
+
+/// Identifies a command pushed to an `AsyncEmulator`
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash)]
+pub struct CommandTicket(pub u64);
+
+/// An emulator that runs on its own thread.
+///
+/// Commands are queued and processed in order by the emulator thread, each command returns a
+/// `CommandTicket` that can be polled with `is_complete()` or waited on with `wait()`.
+/// `load_state()`, `render()` and `snapshot()` output an `AsyncEmulatorResult`, which is taken
+/// with `take_result()`.
+///
+/// The command methods only block if 256 commands are waiting to be processed.
+pub struct AsyncEmulator {
+    emu: UniquePtr<ffi::AsyncEmulator>,
+}
+
+// SAFETY: The host end of the C++ async emulator can be used by any thread, one thread at a time.
+unsafe impl Send for ffi::AsyncEmulator {}
+
+impl AsyncEmulator {
+    #[allow(clippy::new_without_default)]
+    pub fn new(iplrom: &[u8; 64]) -> Self {
+        let emu = ffi::new_async_emulator(iplrom);
+        if emu.is_null() {
+            panic!("new_async_emulator() returned null");
+        }
+        Self { emu }
+    }
+
+    /// Copies `data` to Audio-RAM at `address` (wrapping at the end of Audio-RAM)
+    pub fn load_apuram(&mut self, address: u16, data: &[u8]) -> CommandTicket {
+        CommandTicket(self.emu.pin_mut().load_apuram(address, data))
+    }
+
+    /// Restores a state saved by `ShvcSoundEmu::save_state()` or `snapshot()`.
+    ///
+    /// Outputs a result, which is not `ok` if the state is invalid.
+    pub fn load_state(&mut self, state: &[u8]) -> CommandTicket {
+        CommandTicket(self.emu.pin_mut().load_state(state))
+    }
+
+    /// CAUTION: also resets S-DSP and S-SMP registers
+    pub fn reset(&mut self, registers: ResetRegisters) -> CommandTicket {
+        CommandTicket(self.emu.pin_mut().reset(registers))
+    }
+
+    pub fn write_io_ports(&mut self, ports: [u8; 4]) -> CommandTicket {
+        CommandTicket(self.emu.pin_mut().write_io_ports(ports))
+    }
+
+    /// Emulates `frames` stereo samples.
+    ///
+    /// Outputs a result containing the interleaved stereo samples.
+    pub fn render(&mut self, frames: usize) -> CommandTicket {
+        CommandTicket(self.emu.pin_mut().render(frames))
+    }
+
+    /// Outputs a result containing the emulator state (see `ShvcSoundEmu::save_state()`)
+    pub fn snapshot(&mut self) -> CommandTicket {
+        CommandTicket(self.emu.pin_mut().snapshot())
+    }
+
+    /// Returns true if the command has been processed
+    /// (its result, if any, is available to `take_result()`).
+    pub fn is_complete(&self, ticket: CommandTicket) -> bool {
+        self.emu.completed() > ticket.0
+    }
+
+    /// Blocks until the command has been processed
+    pub fn wait(&mut self, ticket: CommandTicket) {
+        self.emu.pin_mut().wait(ticket.0)
+    }
+
+    /// Returns the oldest result that has not been taken, or None if there are no results.
+    pub fn take_result(&mut self) -> Option<AsyncEmulatorResult> {
+        let mut out = AsyncEmulatorResult::default();
+        match self.emu.pin_mut().take_result(&mut out) {
+            true => Some(out),
+            false => None,
+        }
+    }
+}
+
+/// Publishes the Audio-RAM, S-DSP registers and a `MonitorSnapshot` to a named shared memory
+/// segment, so external tools (visualizers, memory viewers) can observe playback.
+///
+/// The segment starts with a header containing a seqlock sequence and the offset of each block,
+/// see `shared-state-view.hpp` for the layout.  Readers do not block the publisher.
+pub struct SharedStateView {
+    view: UniquePtr<ffi::SharedStateView>,
+}
+
+// SAFETY: The view only contains the shared memory mapping, it can be used by any thread, one
+// thread at a time.
+unsafe impl Send for ffi::SharedStateView {}
+
+impl SharedStateView {
+    /// Creates the shared memory segment `name`.
+    ///
+    /// Returns None if the segment could not be created or shvc-sound-emu was built without the
+    /// `shared-memory` feature.
+    pub fn new(name: &str) -> Option<Self> {
+        let view = ffi::new_shared_state_view(name);
+        match view.is_null() {
+            true => None,
+            false => Some(Self { view }),
+        }
+    }
+
+    /// Copies the emulator's Audio-RAM, S-DSP registers and `monitor_snapshot(layout)` to the
+    /// shared memory segment
+    pub fn publish(&mut self, emu: &mut ShvcSoundEmu, layout: &MonitorLayout) {
+        self.view.pin_mut().publish(emu.emu.pin_mut(), layout)
+    }
 }
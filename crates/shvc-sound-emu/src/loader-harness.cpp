@@ -0,0 +1,196 @@
+namespace shvc_sound_emu {
+
+LoaderHarness::LoaderHarness(ShvcSoundEmu& emu, const ScpuLoaderTiming& timing)
+  : emu(emu), timing(timing)
+{
+  origin = emu.counters().smp_clocks;
+}
+
+auto LoaderHarness::smpClock(uint64_t masterClock) const -> uint64_t {
+  return origin + masterClock * SmpClocksPerSecond / timing.master_clocks_per_second;
+}
+
+// Rounded up, the S-CPU cannot see a port write before it happens
+auto LoaderHarness::masterClock(uint64_t smpClock) const -> uint64_t {
+  const uint64_t c = smpClock - origin;
+  return (c * timing.master_clocks_per_second + SmpClocksPerSecond - 1) / SmpClocksPerSecond;
+}
+
+auto LoaderHarness::now() -> uint64_t {
+  return masterClock(emu.counters().smp_clocks);
+}
+
+auto LoaderHarness::nextCall(uint64_t masterClock) const -> uint64_t {
+  if(timing.bytes_per_frame == 0) return masterClock;
+
+  const uint64_t f = timing.frame_clocks;
+  return (masterClock + f - 1) / f * f;
+}
+
+auto LoaderHarness::frameOf(uint64_t masterClock) const -> uint64_t {
+  return masterClock / timing.frame_clocks;
+}
+
+auto LoaderHarness::emulateUntil(uint64_t masterClock) -> void {
+  const uint64_t target = smpClock(masterClock);
+  const uint64_t current = emu.counters().smp_clocks;
+  if(target > current) emu.fast_forward(target - current);
+}
+
+auto LoaderHarness::writePorts(uint64_t masterClock) -> void {
+  emu.schedule_port_write(smpClock(masterClock), ports);
+}
+
+auto LoaderHarness::waitForPort3(uint8_t value) -> bool {
+  while(emu.read_io_ports()[3] != value) {
+    if(!emu.run_until_port_write(1 << 3, TimeoutSmpClocks).hit) return false;
+  }
+  return true;
+}
+
+auto LoaderHarness::pollAck(const LoaderHandshakeTiming& h, uint64_t writeClock, uint8_t spinlock, LoaderTransferResult& r) -> uint64_t {
+  if(!waitForPort3(spinlock)) return 0;
+  const uint64_t ack = now();
+
+  const uint64_t firstPoll = writeClock + h.pre_poll_clocks;
+  uint64_t poll = firstPoll;
+  if(poll < ack) {
+    poll += (ack - poll + h.poll_clocks - 1) / h.poll_clocks * h.poll_clocks;
+  }
+  r.wait_clocks += poll - firstPoll;
+
+  return poll;
+}
+
+auto LoaderHarness::transfer(const LoaderTransfer& t) -> LoaderTransferResult {
+  LoaderTransferResult r{};
+
+  const bool blocking = timing.bytes_per_frame == 0;
+  const uint64_t timeoutFrames = TimeoutSmpClocks * timing.master_clocks_per_second / SmpClocksPerSecond / timing.frame_clocks;
+
+  // The compressed stream is read 2 bytes at a time
+  const bool fast = (t.data_type & FastTransferFlag) && !(t.data_type & CompressedFlag);
+  const LoaderHandshakeTiming& h = fast ? timing.fast : timing.normal;
+  const uint32_t bytesPerHandshake = fast ? 3 : 2;
+
+  const uint64_t startSmpClock = smpClock(nextCall(clock));
+
+  // Wait for the loader's ready signal
+  uint64_t call = nextCall(clock);
+  const uint64_t firstCall = call;
+  while(true) {
+    emulateUntil(call);
+    const auto in = emu.read_io_ports();
+    if(in[2] == LoaderReadyL && in[3] == LoaderReadyH) break;
+
+    if(blocking) {
+      if(!emu.run_until_port_write(0b1100, TimeoutSmpClocks).hit) return r;
+      call = now();
+    } else {
+      call += timing.frame_clocks;
+      if(frameOf(call) - frameOf(firstCall) > timeoutFrames) return r;
+    }
+  }
+
+  // Send the LoaderDataType (port 0 is unchanged)
+  ports[1] = t.data_type;
+  ports[2] = LoaderReadyL;
+  ports[3] = LoaderReadyH;
+  writePorts(call);
+
+  const uint64_t dataTypeCall = call;
+  r.busy_clocks += h.setup_clocks;
+  call = nextCall(call + h.setup_clocks);
+
+  // The loader acknowledges the LoaderDataType with a 0 spinlock
+  uint8_t spinlock = 0;
+
+  const size_t size = t.data.size();
+  size_t pos = 0;
+
+  while(true) {
+    // `_Tad_Loader_TransferData` returns early if the loader has not acknowledged the previous spinlock
+    emulateUntil(call);
+    if(emu.read_io_ports()[3] != spinlock) {
+      if(blocking) {
+        if(!waitForPort3(spinlock)) return r;
+        call = now();
+      } else {
+        call += timing.frame_clocks;
+        if(frameOf(call) - frameOf(dataTypeCall) > timeoutFrames) return r;
+      }
+      continue;
+    }
+
+    size_t n = size - pos;
+    if(!blocking) n = std::min<size_t>(n, timing.bytes_per_frame);
+    const size_t handshakes = std::max<size_t>((n + bytesPerHandshake - 1) / bytesPerHandshake, 1);
+
+    uint64_t write = call + h.setup_clocks;
+    for(size_t i : range(handshakes)) {
+      // The S-CPU APIs read past the end of the data
+      std::array<uint8_t, 3> d = {};
+      for(auto j : range(bytesPerHandshake)) {
+        if(pos < size) d[j] = t.data[pos++];
+      }
+      if(fast) {
+        ports[0] = d[0];
+        ports[1] = d[1];
+        ports[2] = d[2];
+      } else {
+        ports[1] = d[0];
+        ports[2] = d[1];
+      }
+
+      // Never 0 and never the previous spinlock
+      spinlock = (spinlocks++ & 7) + 1;
+      ports[3] = spinlock;
+      writePorts(write);
+      r.handshakes++;
+
+      if(i + 1 == handshakes) break;
+
+      const uint64_t poll = pollAck(h, write, spinlock, r);
+      if(poll == 0) return r;
+      write = poll + h.post_poll_clocks;
+    }
+
+    if(pos >= size) {
+      // Wait for the loader to acknowledge the last write and end the transfer
+      const uint64_t poll = pollAck(h, write, spinlock, r);
+      if(poll == 0) return r;
+
+      const uint64_t end = poll + h.complete_clocks;
+      ports[3] = SpinlockComplete;
+      writePorts(end);
+      r.busy_clocks += end - call;
+
+      if(!waitForPort3(SpinlockComplete)) return r;
+
+      r.ok = true;
+      r.frames = frameOf(end) - frameOf(dataTypeCall) + 1;
+      r.smp_clocks = emu.counters().smp_clocks - startSmpClock;
+
+      clock = end;
+      return r;
+    }
+
+    r.busy_clocks += write - call;
+    call = nextCall(write + 1);
+  }
+}
+
+auto simulate_loader_transfers(ShvcSoundEmu& emu, const ScpuLoaderTiming& timing, rust::Slice<const LoaderTransfer> transfers) -> rust::Vec<LoaderTransferResult> {
+  rust::Vec<LoaderTransferResult> out;
+  out.reserve(transfers.size());
+
+  LoaderHarness harness(emu, timing);
+  for(const auto& t : transfers) {
+    const auto r = harness.transfer(t);
+    out.push_back(r);
+    if(!r.ok) break;
+  }
+  return out;
+}
+
+}
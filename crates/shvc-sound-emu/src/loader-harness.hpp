@@ -0,0 +1,75 @@
+#pragma once
+
+namespace shvc_sound_emu {
+
+struct ScpuLoaderTiming;
+struct LoaderHandshakeTiming;
+struct LoaderTransfer;
+struct LoaderTransferResult;
+
+// Models the S-CPU side of the loader protocol (see `audio-driver/src/io-commands.wiz`) and
+// drives the loader running on a ShvcSoundEmu.
+//
+// The S-CPU is not emulated.  The transfer loops of the S-CPU APIs are reduced to the time between
+// their spinlock writes and spinlock polls (in S-CPU master clocks), and every IO port write is
+// scheduled at the S-SMP clock the S-CPU would have written it.  The loader sees the same port
+// timing it would see on a console and any time the S-CPU waits for the loader is measured.
+//
+// `Tad_Process` is called at the start of every frame.  The first call that sees the loader's ready
+// signal sends the LoaderDataType, the following calls transfer up to `bytes_per_frame` bytes each.
+// A call that does not end before the next frame delays the next call (a lag frame).
+// If `bytes_per_frame` is 0 the data is transferred by one blocking call (`Tad_Init` and
+// `Tad_FinishLoadingData`), which does not wait for the next frame.
+struct LoaderHarness {
+  // Gives up if the loader does not respond within a second.
+  constexpr static uint64_t TimeoutSmpClocks = 2'048'000;
+
+  // The time and frame counters start at the emulator's current S-SMP clock.
+  LoaderHarness(ShvcSoundEmu& emu, const ScpuLoaderTiming& timing);
+
+  // Waits for the loader, sends the LoaderDataType and transfers `t.data`.
+  // The emulator is stopped after the loader acknowledges the end of the transfer.
+  // The result is not ok if the loader timed out (the harness must not be used afterwards).
+  auto transfer(const LoaderTransfer& t) -> LoaderTransferResult;
+
+private:
+  constexpr static uint64_t SmpClocksPerSecond = 2'048'000;
+
+  constexpr static uint8_t LoaderReadyL = 'L';
+  constexpr static uint8_t LoaderReadyH = 'D';
+  constexpr static uint8_t FastTransferFlag = 1 << 4;
+  constexpr static uint8_t CompressedFlag = 1 << 5;
+  constexpr static uint8_t SpinlockComplete = 0x80;
+
+  auto smpClock(uint64_t masterClock) const -> uint64_t;
+  auto masterClock(uint64_t smpClock) const -> uint64_t;
+  auto now() -> uint64_t;
+
+  // Start of the first `Tad_Process` call at or after `masterClock`
+  auto nextCall(uint64_t masterClock) const -> uint64_t;
+  auto frameOf(uint64_t masterClock) const -> uint64_t;
+
+  auto emulateUntil(uint64_t masterClock) -> void;
+  auto writePorts(uint64_t masterClock) -> void;
+  auto waitForPort3(uint8_t value) -> bool;
+  // Returns the master clock of the spinlock poll that reads the acknowledgement of a spinlock
+  // written at `writeClock`, or 0 on a timeout.
+  auto pollAck(const LoaderHandshakeTiming& h, uint64_t writeClock, uint8_t spinlock, LoaderTransferResult& r) -> uint64_t;
+
+  ShvcSoundEmu& emu;
+  const ScpuLoaderTiming& timing;
+
+  // S-SMP clock at master clock 0
+  uint64_t origin = 0;
+  // Master clock the S-CPU finished the previous transfer
+  uint64_t clock = 0;
+  // The last value written to each IO port by the S-CPU
+  std::array<uint8_t, 4> ports = {};
+  // Spinlock writes since construction
+  uint32_t spinlocks = 0;
+};
+
+// Runs the transfers in order on a new LoaderHarness, stopping after the first failed transfer.
+auto simulate_loader_transfers(ShvcSoundEmu& emu, const ScpuLoaderTiming& timing, rust::Slice<const LoaderTransfer> transfers) -> rust::Vec<LoaderTransferResult>;
+
+}
@@ -80,6 +80,9 @@ class Server : public nall::TCPText::Server {
     
     auto getPcOverride() const { return pcOverride; };
 
+    auto getWatchpointsRead() const -> const vector<Watchpoint>& { return watchpointRead; }
+    auto getWatchpointsWrite() const -> const vector<Watchpoint>& { return watchpointWrite; }
+
     auto updateLoop() -> void;
     auto getStatusText(u32 port, bool useIPv4) -> string;
 
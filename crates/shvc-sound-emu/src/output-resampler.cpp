@@ -0,0 +1,134 @@
+namespace shvc_sound_emu {
+
+// Zeroth order modified Bessel function of the first kind (for the Kaiser window)
+static auto besselI0(double x) -> double {
+  double sum = 1.0;
+  double term = 1.0;
+  for(u32 k = 1; k < 32; k++) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+auto OutputResampler::configure(uint32_t outputRate, ResamplerQuality quality) -> bool {
+  if(outputRate < MinOutputRate || outputRate > MaxOutputRate) return false;
+
+  switch(quality) {
+  case ResamplerQuality::Linear:
+  case ResamplerQuality::Cubic:
+  case ResamplerQuality::Sinc:
+    break;
+  default:
+    return false;
+  }
+
+  _outputRate = outputRate;
+  _quality = quality;
+  step = (uint64_t(InputRate) << 32) / outputRate;
+
+  sincKernel.clear();
+  if(quality == ResamplerQuality::Sinc) {
+    constexpr double Pi = 3.14159265358979323846;
+    constexpr double Beta = 7.0;  // Approximately 70 dB stopband attenuation
+    constexpr double HalfWidth = SincTaps / 2;
+
+    // Cutoff in cycles per input sample, below the Nyquist frequency of both sample rates
+    const double cutoff = 0.45 * std::min(1.0, double(outputRate) / InputRate);
+
+    sincKernel.resize((SincPhases + 1) * SincTaps);
+    for(u32 p : range(SincPhases + 1)) {
+      float* row = &sincKernel[p * SincTaps];
+      const double mu = double(p) / SincPhases;
+
+      double sum = 0.0;
+      for(u32 k : range(SincTaps)) {
+        // Distance from the output sample to tap `k` (the output is between taps HalfWidth - 1 and HalfWidth)
+        const double t = HalfWidth - 1 + mu - k;
+        const double x = 2.0 * cutoff * t;
+        const double sinc = x == 0.0 ? 1.0 : std::sin(Pi * x) / (Pi * x);
+        const double w = t / HalfWidth;
+        const double window = std::abs(w) >= 1.0 ? 0.0 : besselI0(Beta * std::sqrt(1.0 - w * w)) / besselI0(Beta);
+        row[k] = float(sinc * window);
+        sum += row[k];
+      }
+      // Unity gain at every phase
+      for(u32 k : range(SincTaps)) row[k] = float(row[k] / sum);
+    }
+  }
+
+  reset();
+  return true;
+}
+
+auto OutputResampler::reset() -> void {
+  position = 0;
+  historyOffset = 0;
+  for(auto& h : history) h.fill(0.0f);
+}
+
+auto OutputResampler::inputFrames(size_t frames) const -> size_t {
+  if(frames == 0) return 0;
+  return size_t((position + (frames - 1) * step) >> 32);
+}
+
+inline auto OutputResampler::push(const int16_t* frame) -> void {
+  for(u32 c : range(2)) {
+    history[c][historyOffset] = frame[c];
+    history[c][historyOffset + SincTaps] = frame[c];
+  }
+  if(++historyOffset == SincTaps) historyOffset = 0;
+}
+
+// `h` is the history of a single channel (oldest first), the output sample is `fraction / 2^32`
+// of the way from the second newest sample to the newest sample (Linear), from the third newest
+// sample (Cubic) or from the `SincTaps / 2 + 1`th newest sample (Sinc).
+inline auto OutputResampler::interpolate(const float* h, uint32_t fraction, SincDotProducts sincDotProducts) const -> float {
+  switch(_quality) {
+  case ResamplerQuality::Linear:
+  default: {
+    const float mu = fraction * (1.0f / One);
+    return h[SincTaps - 2] + (h[SincTaps - 1] - h[SincTaps - 2]) * mu;
+  }
+
+  case ResamplerQuality::Cubic: {
+    // Catmull-Rom spline
+    const float mu = fraction * (1.0f / One);
+    const float s0 = h[SincTaps - 4], s1 = h[SincTaps - 3], s2 = h[SincTaps - 2], s3 = h[SincTaps - 1];
+    return s1 + 0.5f * mu * (s2 - s0 + mu * (2.0f * s0 - 5.0f * s1 + 4.0f * s2 - s3 + mu * (3.0f * (s1 - s2) + s3 - s0)));
+  }
+
+  case ResamplerQuality::Sinc: {
+    // Linearly interpolated between the two closest kernel phases
+    constexpr u32 PhaseShift = 32 - 8;
+    static_assert(SincPhases == 1 << 8);
+
+    const float* row = &sincKernel[(fraction >> PhaseShift) * SincTaps];
+    const float mu = (fraction & ((1 << PhaseShift) - 1)) * (1.0f / (1 << PhaseShift));
+
+    float dot[2];
+    sincDotProducts(h, row, dot);
+    return dot[0] + (dot[1] - dot[0]) * mu;
+  }
+  }
+}
+
+auto OutputResampler::process(const int16_t* in, int16_t* out, size_t frames) -> void {
+  const SincDotProducts sincDotProducts = simdKernels().sincDotProducts;
+
+  for(size_t i : range(frames)) {
+    while(position >= One) {
+      push(in);
+      in += 2;
+      position -= One;
+    }
+
+    for(u32 c : range(2)) {
+      const float sample = interpolate(&history[c][historyOffset], uint32_t(position), sincDotProducts);
+      out[i * 2 + c] = sclamp<16>(std::lrint(sample));
+    }
+    position += step;
+  }
+}
+
+}
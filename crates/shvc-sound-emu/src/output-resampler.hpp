@@ -0,0 +1,67 @@
+#pragma once
+
+namespace shvc_sound_emu {
+
+enum class ResamplerQuality : uint8_t;
+
+// Converts the 32000 Hz S-DSP output to the host's sample rate.
+//
+// The position of the next output sample is a 32.32 fixed point input sample count, so the number
+// of input samples required for any number of output samples is known before they are emulated.
+struct OutputResampler {
+  constexpr static uint32_t InputRate = 32000;
+  constexpr static uint32_t MinOutputRate = 8000;
+  constexpr static uint32_t MaxOutputRate = 192000;
+
+  // Output samples converted per emulated input chunk
+  constexpr static uint32_t OutputChunkFrames = 256;
+  // Input samples required by `OutputChunkFrames` output samples at `MinOutputRate`
+  constexpr static uint32_t InputChunkFrames = OutputChunkFrames * (InputRate / MinOutputRate) + 1;
+
+  constexpr static uint32_t SincTaps = 32;
+  constexpr static uint32_t SincPhases = 256;
+
+  // Returns false (and leaves the resampler unchanged) if `outputRate` is out of range.
+  auto configure(uint32_t outputRate, ResamplerQuality quality) -> bool;
+  // Clears the history (the output is silent until the history is refilled).
+  auto reset() -> void;
+
+  auto outputRate() const -> uint32_t { return _outputRate; }
+
+  // Number of input samples consumed by the next `frames` output samples.
+  auto inputFrames(size_t frames) const -> size_t;
+
+  // Writes `frames` interleaved stereo samples to `out`, consuming `inputFrames(frames)`
+  // interleaved stereo samples from `in`.
+  auto process(const int16_t* in, int16_t* out, size_t frames) -> void;
+
+  // Scratch buffer for the emulated input samples of a chunk
+  std::array<int16_t, InputChunkFrames * 2> input;
+
+private:
+  constexpr static uint64_t One = 1ull << 32;
+
+  using SincDotProducts = decltype(SimdKernels::sincDotProducts);
+
+  auto push(const int16_t* frame) -> void;
+  auto interpolate(const float* h, uint32_t fraction, SincDotProducts sincDotProducts) const -> float;
+
+  uint32_t _outputRate = InputRate;
+  ResamplerQuality _quality{};  // Linear
+
+  // Input samples per output sample
+  uint64_t step = One;
+  // Position of the next output sample in input samples, the integer part is the number of input
+  // samples to add to the history before it is output
+  uint64_t position = 0;
+
+  // The last `SincTaps` input samples of each channel, oldest first from `historyOffset`
+  // (mirrored so the taps are never split)
+  uint32_t historyOffset = 0;
+  std::array<std::array<float, SincTaps * 2>, 2> history = {};
+
+  // `SincPhases + 1` rows of `SincTaps` windowed sinc coefficients, empty unless the quality is Sinc
+  std::vector<float> sincKernel;
+};
+
+}
@@ -0,0 +1,188 @@
+#include <cstdio>
+#include <string>
+
+#if defined(_WIN32)
+  #include <fcntl.h>
+  #include <io.h>
+#endif
+
+namespace shvc_sound_emu {
+
+// Destination of rendered audio.
+struct RenderSink {
+  virtual ~RenderSink() = default;
+
+  virtual auto write(const void* data, size_t size) -> bool = 0;
+
+  // Overwrites `size` bytes at `offset`, then continues writing at the end of the output.
+  // Returns false if the sink cannot seek (ie, a pipe).
+  virtual auto rewrite(size_t offset, const void* data, size_t size) -> bool = 0;
+};
+
+// A file (with a large write buffer) or stdout.
+struct FileRenderSink : RenderSink {
+  static constexpr size_t BufferSize = 1 << 20;
+
+  // "-" writes to stdout
+  FileRenderSink(const std::string& path) {
+    if(path == "-") {
+      #if defined(_WIN32)
+      _setmode(_fileno(stdout), _O_BINARY);
+      #endif
+      // The stdout buffer cannot be changed after it has been used
+      fp = stdout;
+      ownsFile = false;
+    } else {
+      fp = fopen(path.c_str(), "wb");
+      ownsFile = true;
+
+      if(fp) {
+        buffer = std::make_unique<char[]>(BufferSize);
+        setvbuf(fp, buffer.get(), _IOFBF, BufferSize);
+      }
+    }
+  }
+
+  ~FileRenderSink() {
+    close();
+  }
+
+  auto isOpen() const -> bool { return fp != nullptr; }
+
+  auto write(const void* data, size_t size) -> bool override {
+    return fp && fwrite(data, 1, size, fp) == size;
+  }
+
+  auto rewrite(size_t offset, const void* data, size_t size) -> bool override {
+    if(!fp || fseek(fp, (long)offset, SEEK_SET) != 0) return false;
+    bool ok = write(data, size);
+    return fseek(fp, 0, SEEK_END) == 0 && ok;
+  }
+
+  // Returns false if the buffered data could not be written
+  auto close() -> bool {
+    if(!fp) return true;
+
+    bool ok = fflush(fp) == 0;
+    if(ownsFile) ok &= fclose(fp) == 0;
+    fp = nullptr;
+    return ok;
+  }
+
+private:
+  FILE* fp = nullptr;
+  bool ownsFile = false;
+  std::unique_ptr<char[]> buffer;
+};
+
+// 16 bit stereo PCM WAV file header
+struct WavHeader {
+  static constexpr size_t Size = 44;
+  static constexpr uint32_t SampleRate = 32040;
+  static constexpr uint32_t FrameSize = 4;
+
+  // Streamed files with an unknown length use the maximum size
+  static auto build(uint64_t frames) -> std::array<uint8_t, Size> {
+    const uint64_t maxDataSize = 0xffffffffull - (Size - 8);
+    const uint32_t dataSize = std::min(frames * FrameSize, maxDataSize);
+
+    std::array<uint8_t, Size> h = {};
+    auto tag   = [&](size_t o, const char* s) { memory::copy(&h[o], s, 4); };
+    auto word  = [&](size_t o, uint16_t v) { h[o + 0] = v; h[o + 1] = v >> 8; };
+    auto dword = [&](size_t o, uint32_t v) { word(o, v); word(o + 2, v >> 16); };
+
+    tag  ( 0, "RIFF");
+    dword( 4, dataSize + (Size - 8));
+    tag  ( 8, "WAVE");
+    tag  (12, "fmt ");
+    dword(16, 16);
+    word (20, 1);  // PCM
+    word (22, 2);  // channels
+    dword(24, SampleRate);
+    dword(28, SampleRate * FrameSize);
+    word (32, FrameSize);
+    word (34, 16);  // bits per sample
+    tag  (36, "data");
+    dword(40, dataSize);
+    return h;
+  }
+};
+
+// Emulates into a reusable buffer and streams the audio to a `RenderSink`.
+struct Renderer {
+  static constexpr size_t ChunkFrames = 8192;
+
+  Renderer(ShvcSoundEmu& emu, RenderSink& sink) : emu(emu), sink(sink) {}
+
+  auto render(uint64_t smp_clocks, uint32_t stop_after_silence) -> RenderResult {
+    const uint64_t maxFrames = (smp_clocks + SMP_CLOCKS_PER_SAMPLE - 1) / SMP_CLOCKS_PER_SAMPLE;
+
+    auto header = WavHeader::build(maxFrames);
+    if(!sink.write(header.data(), header.size())) return {0, false};
+
+    std::vector<int16_t> buffer(ChunkFrames * 2);
+    uint64_t frames = 0;
+    uint64_t silentFrames = 0;
+    bool stopped = false;
+
+    while(frames < maxFrames && !stopped) {
+      size_t n = std::min<uint64_t>(ChunkFrames, maxFrames - frames);
+      emu.emulate_into(buffer.data(), n);
+
+      if(stop_after_silence) {
+        for(auto i : range(n)) {
+          if(buffer[i * 2] || buffer[i * 2 + 1]) {
+            silentFrames = 0;
+          } else if(++silentFrames >= stop_after_silence) {
+            n = i + 1;
+            stopped = true;
+            break;
+          }
+        }
+      }
+
+      if(!writeSamples(buffer.data(), n * 2)) return {frames, false};
+      frames += n;
+
+      // A halted S-SMP cannot key-on another voice, the rest of the render would be silent
+      if(emu.halted()) {
+        bool silent = true;
+        for(auto i : range(n * 2)) silent &= buffer[i] == 0;
+        if(silent) break;
+      }
+    }
+
+    if(frames != maxFrames) {
+      // Streamed output keeps the maximum length
+      header = WavHeader::build(frames);
+      sink.rewrite(0, header.data(), header.size());
+    }
+
+    return {frames, true};
+  }
+
+private:
+  auto writeSamples(int16_t* samples, size_t count) -> bool {
+    // WAV samples are little endian
+    #if defined(ENDIAN_BIG)
+    for(auto i : range(count)) samples[i] = (int16_t)bswap16((uint16_t)samples[i]);
+    #endif
+    return sink.write(samples, count * sizeof(int16_t));
+  }
+
+  static constexpr uint64_t SMP_CLOCKS_PER_SAMPLE = 64;
+
+  ShvcSoundEmu& emu;
+  RenderSink& sink;
+};
+
+auto ShvcSoundEmu::render_to_file(rust::Str path, uint64_t smp_clocks, uint32_t stop_after_silence) -> RenderResult {
+  FileRenderSink sink{std::string(path)};
+  if(!sink.isOpen()) return {0, false};
+
+  auto result = Renderer(*this, sink).render(smp_clocks, stop_after_silence);
+  result.ok &= sink.close();
+  return result;
+}
+
+}
@@ -4,23 +4,94 @@ namespace shvc_sound_emu {
 
 struct SampleBuffer {
   constexpr static u32 N_SAMPLES = 256;
-  constexpr static u32 MASK = N_SAMPLES * 2 - 2;
 
+  //writes the next N_SAMPLES stereo samples to the internal buffer
   auto reset() -> void {
-    pos = 0;
+    reset(buffer.data(), N_SAMPLES);
+  }
+
+  //writes the next `frames` stereo samples to a caller-owned buffer
+  //(`out` must hold at least `frames * 2` samples and outlive the emulation)
+  auto reset(int16_t* out, size_t frames) -> void {
+    format = Format::Interleaved;
+    output = out;
+    remaining = frames;
+  }
+
+  //writes the left and right channels of the next `frames` samples to two caller-owned buffers
+  //(each must hold at least `frames` samples and outlive the emulation)
+  auto resetPlanar(int16_t* left, int16_t* right, size_t frames) -> void {
+    format = Format::Planar;
+    output = left;
+    outputRight = right;
+    remaining = frames;
+  }
+
+  //writes the next `frames` samples downmixed to mono (the average of both channels, rounded down)
+  //to a caller-owned buffer (`out` must hold at least `frames` samples and outlive the emulation)
+  auto resetMono(int16_t* out, size_t frames) -> void {
+    format = Format::Mono;
+    output = out;
+    remaining = frames;
+  }
+
+  //writes the minimum and maximum sample (of both channels) of each of the next `bins` groups of
+  //`binFrames` samples to a caller-owned buffer (`out` must hold at least `bins * 2` samples and
+  //outlive the emulation, `binFrames` must not be 0)
+  auto resetPeaks(int16_t* out, size_t bins, u32 binFrames) -> void {
+    format = Format::Peaks;
+    output = out;
+    remaining = bins * binFrames;
+    peaks.binFrames = binFrames;
+    peaks.binRemaining = binFrames;
+    peaks.min = INT16_MAX;
+    peaks.max = INT16_MIN;
   }
 
   auto write(i16 left, i16 right) -> void {
-    pos &= MASK;
+    //samples output after the buffer is full are dropped
+    if(!remaining) return;
 
-    buffer.at(pos) = left;
-    buffer.at(pos + 1) = right;
+    switch(format) {
+    case Format::Interleaved:
+      output[0] = left;
+      output[1] = right;
+      output += 2;
+      break;
 
-    pos += 2;
+    case Format::Planar:
+      *output++ = left;
+      *outputRight++ = right;
+      break;
+
+    case Format::Mono:
+      *output++ = (left + right) >> 1;
+      break;
+
+    case Format::Peaks:
+      peaks.min = min(peaks.min, min(left, right));
+      peaks.max = max(peaks.max, max(left, right));
+      if(--peaks.binRemaining == 0) {
+        output[0] = peaks.min;
+        output[1] = peaks.max;
+        output += 2;
+        peaks.binRemaining = peaks.binFrames;
+        peaks.min = INT16_MAX;
+        peaks.max = INT16_MIN;
+      }
+      break;
+    }
+
+    remaining--;
   }
 
-  auto isFull() -> bool {
-    return pos > MASK;
+  auto isFull() const -> bool {
+    return remaining == 0;
+  }
+
+  //number of stereo samples that can still be written
+  auto space() const -> size_t {
+    return remaining;
   }
 
   auto samples() const -> const std::array<int16_t, N_SAMPLES * 2>& {
@@ -28,8 +99,21 @@ struct SampleBuffer {
   }
 
 private:
+  enum class Format : u8 { Interleaved, Planar, Mono, Peaks };
+
   std::array<int16_t, N_SAMPLES * 2> buffer;
-  u32 pos = MASK;
+  Format format = Format::Interleaved;
+  int16_t* output = buffer.data();
+  int16_t* outputRight = nullptr;  //right channel (Planar only)
+  size_t remaining = 0;
+
+  //the bin being accumulated (Peaks only)
+  struct Peaks {
+    u32 binFrames;
+    u32 binRemaining;
+    i16 min;
+    i16 max;
+  } peaks = {};
 };
 
 }
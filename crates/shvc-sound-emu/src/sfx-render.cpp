@@ -0,0 +1,137 @@
+#include <atomic>
+#include <thread>
+
+namespace shvc_sound_emu {
+
+// Sound effect renders, run in parallel.
+//
+// Every render starts from the same save state (a warm audio driver), so the workers share a single
+// job counter like `EmulatorPool` and each worker reuses a single emulator.
+//
+// A render stops once every port write has been applied, the output has been silent for
+// `silence_samples` samples and every `IdleWatch` is idle.  The idle watches are tested every
+// `ChunkFrames` samples.
+struct SfxRenderPool {
+  static constexpr size_t ChunkFrames = 32;
+
+  SfxRenderPool(rust::Slice<const uint8_t> state, rust::Slice<const IdleWatch> watches, const SfxRenderSettings& settings, rust::Slice<const SfxRenderJob> jobs)
+    : state(state), watches(watches), settings(settings), jobs(jobs), outputs(jobs.size())
+  {}
+
+  auto run(uint32_t nThreads) -> void {
+    if(nThreads == 0) nThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    nThreads = std::min<size_t>(nThreads, jobs.size());
+
+    std::vector<std::thread> workers;
+    for(auto i : range(nThreads)) {
+      (void)i;
+      workers.emplace_back([this] { worker(); });
+    }
+    for(auto& w : workers) w.join();
+  }
+
+  auto results() -> rust::Vec<SfxRenderResult> {
+    rust::Vec<SfxRenderResult> out;
+    out.reserve(outputs.size());
+
+    for(auto& o : outputs) {
+      SfxRenderResult r;
+      r.samples.reserve(o.samples.size());
+      for(auto s : o.samples) r.samples.push_back(s);
+      r.stopped = o.stopped;
+      out.push_back(std::move(r));
+    }
+    return out;
+  }
+
+private:
+  struct Output {
+    std::vector<int16_t> samples;
+    bool stopped = false;
+  };
+
+  auto worker() -> void {
+    // No IPL ROM
+    ShvcSoundEmu emu({});
+
+    while(true) {
+      const size_t i = nextJob.fetch_add(1, std::memory_order_relaxed);
+      if(i >= jobs.size()) return;
+
+      // The state is validated by the caller
+      if(!emu.load_state(state.data(), state.size())) continue;
+      outputs[i] = render(emu, jobs[i]);
+    }
+  }
+
+  auto idle(const ShvcSoundEmu& emu) const -> bool {
+    const auto& apuram = emu.apuram();
+    for(const auto& w : watches) {
+      const uint16_t value = apuram[w.addr_l] | apuram[w.addr_h] << 8;
+      if(value >= w.active_min) return false;
+    }
+    return true;
+  }
+
+  auto render(ShvcSoundEmu& emu, const SfxRenderJob& job) const -> Output {
+    const uint64_t maxFrames = (settings.max_smp_clocks + SMP_CLOCKS_PER_SAMPLE - 1) / SMP_CLOCKS_PER_SAMPLE;
+    const int threshold = settings.silence_threshold;
+
+    Output out;
+    const auto& writes = job.port_writes;
+    size_t nextWrite = 0;
+    uint64_t frames = 0;
+    // Number of frames up to and including the last audible sample
+    uint64_t audibleEnd = 0;
+
+    while(frames < maxFrames) {
+      const uint64_t clock = frames * SMP_CLOCKS_PER_SAMPLE;
+      while(nextWrite < writes.size() && writes[nextWrite].smp_clock <= clock) {
+        emu.write_io_ports(writes[nextWrite++].ports);
+      }
+
+      uint64_t n = std::min<uint64_t>(ChunkFrames, maxFrames - frames);
+      if(nextWrite < writes.size()) {
+        const uint64_t until = writes[nextWrite].smp_clock - clock;
+        n = std::min(n, (until + SMP_CLOCKS_PER_SAMPLE - 1) / SMP_CLOCKS_PER_SAMPLE);
+      }
+
+      out.samples.resize((frames + n) * 2);
+      int16_t* samples = out.samples.data() + frames * 2;
+      emu.emulate_into(samples, n);
+
+      for(auto i : range(n)) {
+        if(std::abs((int)samples[i * 2]) > threshold || std::abs((int)samples[i * 2 + 1]) > threshold) {
+          audibleEnd = frames + i + 1;
+        }
+      }
+      frames += n;
+
+      if(nextWrite == writes.size() && frames - audibleEnd >= settings.silence_samples && idle(emu)) {
+        // The trailing silence is not output
+        out.samples.resize(audibleEnd * 2);
+        out.stopped = true;
+        break;
+      }
+    }
+
+    return out;
+  }
+
+  static constexpr uint64_t SMP_CLOCKS_PER_SAMPLE = 64;
+
+  rust::Slice<const uint8_t> state;
+  rust::Slice<const IdleWatch> watches;
+  const SfxRenderSettings& settings;
+  rust::Slice<const SfxRenderJob> jobs;
+  std::vector<Output> outputs;
+  std::atomic<size_t> nextJob = 0;
+};
+
+auto render_sound_effects(rust::Slice<const uint8_t> state, rust::Slice<const IdleWatch> watches, const SfxRenderSettings& settings, rust::Slice<const SfxRenderJob> jobs, uint32_t n_threads) -> rust::Vec<SfxRenderResult> {
+  SfxRenderPool pool(state, watches, settings, jobs);
+  pool.run(n_threads);
+  return pool.results();
+}
+
+}
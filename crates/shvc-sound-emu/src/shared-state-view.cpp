@@ -0,0 +1,60 @@
+namespace shvc_sound_emu {
+
+namespace SharedStateLayout {
+  constexpr uint32_t Apuram = SharedStateView::HeaderSize;
+  constexpr uint32_t DspRegisters = Apuram + 0x10000;
+  constexpr uint32_t MonitorSnapshot = DspRegisters + 128;
+  constexpr uint32_t Size = MonitorSnapshot + sizeof(shvc_sound_emu::MonitorSnapshot);
+}
+
+auto SharedStateView::create(const char* name) -> bool {
+  #if defined(SHVC_SOUND_EMU_SHARED_MEMORY)
+  static_assert(std::atomic<uint32_t>::is_always_lock_free);
+  static_assert(sizeof(Header) <= HeaderSize);
+
+  header = nullptr;
+  if(!segment.create(name, SharedStateLayout::Size)) return false;
+
+  // `create()` zero fills the segment, the sequence is 0 (not written)
+  header = new(segment.acquire()) Header{};
+  segment.release();
+
+  header->magic = Magic;
+  header->version = Version;
+  header->monitorSnapshotVersion = ShvcSoundEmu::MONITOR_SNAPSHOT_VERSION;
+  header->apuramOffset = SharedStateLayout::Apuram;
+  header->dspRegistersOffset = SharedStateLayout::DspRegisters;
+  header->monitorSnapshotOffset = SharedStateLayout::MonitorSnapshot;
+  header->monitorSnapshotSize = sizeof(MonitorSnapshot);
+  return true;
+  #else
+  (void)name;
+  return false;
+  #endif
+}
+
+auto SharedStateView::publish(ShvcSoundEmu& emu, const MonitorLayout& layout) -> void {
+  if(!header) return;
+
+  const auto snapshot = emu.monitor_snapshot(layout);
+  auto* data = (uint8_t*)header;
+
+  const uint32_t sequence = header->sequence.load(std::memory_order_relaxed);
+  header->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  header->dspClock = emu.dsp_clock();
+  memory::copy(data + SharedStateLayout::Apuram, emu.apuram().data(), 0x10000);
+  memory::copy(data + SharedStateLayout::DspRegisters, emu.dsp_registers().data(), 128);
+  memory::copy(data + SharedStateLayout::MonitorSnapshot, &snapshot, sizeof(snapshot));
+
+  header->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+auto new_shared_state_view(rust::Str name) -> std::unique_ptr<SharedStateView> {
+  auto view = std::make_unique<SharedStateView>();
+  if(!view->create(std::string(name).c_str())) return {};
+  return view;
+}
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#if defined(SHVC_SOUND_EMU_SHARED_MEMORY)
+#include <nall/shared-memory.hpp>
+#endif
+
+namespace shvc_sound_emu {
+
+// Publishes the Audio-RAM, S-DSP registers and a `MonitorSnapshot` to a named shared memory
+// segment, so external tools can observe the emulator without copying or locking.
+//
+// On POSIX systems the segment is `/nall-<name>` (see `nall::shared_memory`).
+//
+// Segment layout (native endian):
+//    0: u32 magic (`Magic`)
+//    4: u32 version (`Version`)
+//    8: u32 sequence (odd while the data is being written)
+//   12: u32 `MonitorSnapshot` version
+//   16: u64 S-DSP clock when the data was published
+//   24: u32 Audio-RAM offset (65536 bytes)
+//   28: u32 S-DSP registers offset (128 bytes)
+//   32: u32 `MonitorSnapshot` offset
+//   36: u32 `MonitorSnapshot` size
+//
+// Readers use the sequence as a seqlock: read the sequence (retry if it is odd), copy the data,
+// then retry if the sequence has changed.
+struct SharedStateView {
+  constexpr static uint32_t Magic = 0x56444154;  // "TADV"
+  constexpr static uint32_t Version = 1;
+  constexpr static uint32_t HeaderSize = 64;
+
+  SharedStateView() = default;
+  SharedStateView(const SharedStateView&) = delete;
+  auto operator=(const SharedStateView&) -> SharedStateView& = delete;
+
+  // Returns false if the segment could not be created or shvc-sound-emu was built without the
+  // `shared-memory` feature.
+  auto create(const char* name) -> bool;
+
+  // Copies the emulator state to the segment.
+  auto publish(ShvcSoundEmu& emu, const MonitorLayout& layout) -> void;
+
+private:
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<uint32_t> sequence;
+    uint32_t monitorSnapshotVersion;
+    uint64_t dspClock;
+    uint32_t apuramOffset;
+    uint32_t dspRegistersOffset;
+    uint32_t monitorSnapshotOffset;
+    uint32_t monitorSnapshotSize;
+  };
+
+  #if defined(SHVC_SOUND_EMU_SHARED_MEMORY)
+  nall::shared_memory segment;
+  #endif
+  Header* header = nullptr;
+};
+
+auto new_shared_state_view(rust::Str name) -> std::unique_ptr<SharedStateView>;
+
+}
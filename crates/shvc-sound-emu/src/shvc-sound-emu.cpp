@@ -6,6 +6,24 @@
 #include "smp/smp.cpp"
 #include "dsp/dsp.cpp"
 
+#include "emulator-pool.cpp"
+#include "gaussian-overflow-scan.cpp"
+#include "async-emulator.cpp"
+#include "render.cpp"
+#include "sfx-render.cpp"
+#include "dsp-replay.cpp"
+#include "simd-kernels.cpp"
+#include "output-resampler.cpp"
+#include "loader-harness.cpp"
+#include "c-api.cpp"
+#include "shared-state-view.cpp"
+
+#if defined(SHVC_SOUND_EMU_GDB_SERVER)
+#include <nall/tcptext/tcp-socket.cpp>
+#include <nall/tcptext/tcptext-server.cpp>
+#include <nall/gdb/server.cpp>
+#endif
+
 namespace shvc_sound_emu {
 
 auto new_emulator(const std::array<uint8_t, 64>& iplrom) -> std::unique_ptr<ShvcSoundEmu>
@@ -13,6 +31,11 @@ auto new_emulator(const std::array<uint8_t, 64>& iplrom) -> std::unique_ptr<Shvc
     return std::make_unique<ShvcSoundEmu>(iplrom);
 }
 
+auto clone_emulator(const ShvcSoundEmu& emu) -> std::unique_ptr<ShvcSoundEmu>
+{
+    return std::make_unique<ShvcSoundEmu>(emu);
+}
+
 ShvcSoundEmu::ShvcSoundEmu(const std::array<uint8_t, 64>& iplrom)
   : smp()
 {
@@ -20,7 +43,30 @@ ShvcSoundEmu::ShvcSoundEmu(const std::array<uint8_t, 64>& iplrom)
   smp.power(false);
 }
 
-ShvcSoundEmu::~ShvcSoundEmu() = default;
+ShvcSoundEmu::ShvcSoundEmu(const ShvcSoundEmu& source)
+  : smp(source.smp)
+  , resampler(source.resampler)
+{
+  smp.copied();
+
+  // The tap buffers belong to the source
+  for(auto& tap : smp.dsp.taps) tap = {};
+
+  // Profiling and tracing are not copied
+  smp.profile = {};
+  smp.trace = {};
+
+  #if defined(SHVC_SOUND_EMU_GDB_SERVER)
+  smp.gdbCopied();
+  #endif
+}
+
+ShvcSoundEmu::~ShvcSoundEmu()
+{
+  #if defined(SHVC_SOUND_EMU_GDB_SERVER)
+  smp.gdbServerStop();
+  #endif
+}
 
 auto ShvcSoundEmu::reset(ResetRegisters r) -> void {
   constexpr uint8_t ESA_REG = 0x6d;
@@ -34,12 +80,69 @@ auto ShvcSoundEmu::reset(ResetRegisters r) -> void {
   smp.r.ya.byte.h = r.y;
   smp.r.p = r.psw;
   smp.r.s = r.sp;
+  reset_stack_min();
 
   smp.dsp.write(ESA_REG, r.esa);
   smp.dsp.write(EDL_REG, r.edl);
 
   // Echo buffer address/offset/length changes are not instant when the ESA and EDL registers change.
   smp.dsp.resetEchoBuffer();
+
+  // The resampled output does not depend on the samples emulated before the reset
+  resampler.reset();
+
+  smp.synchronizeDSP();
+}
+
+auto ShvcSoundEmu::load_spc(const uint8_t* data, size_t size) -> bool {
+  constexpr size_t RAM_OFFSET = 0x100;
+  constexpr size_t DSP_OFFSET = 0x10100;
+  // Audio-RAM underneath the IPL ROM (optional)
+  constexpr size_t IPLRAM_OFFSET = 0x101c0;
+  constexpr size_t MIN_SIZE = DSP_OFFSET + 0x80;
+
+  static const char SIGNATURE[] = "SNES-SPC700 Sound File Data";
+
+  if(size < MIN_SIZE || memory::compare(data, SIGNATURE, sizeof(SIGNATURE) - 1) != 0) return false;
+
+  const uint8_t* header = data;
+  const uint8_t* ram = data + RAM_OFFSET;
+
+  smp.power(true);
+
+  auto& apuram = smp.dsp.apuram;
+  memory::copy(apuram.data(), ram, apuram.size());
+
+  const bool iplromEnabled = ram[0xf1] & 0x80;
+  if(iplromEnabled && size >= IPLRAM_OFFSET + 0x40) {
+    memory::copy(&apuram[0xffc0], data + IPLRAM_OFFSET, 0x40);
+  }
+
+  smp.r.pc.byte.l = header[0x25];
+  smp.r.pc.byte.h = header[0x26];
+  smp.r.ya.byte.l = header[0x27];
+  smp.r.x = header[0x28];
+  smp.r.ya.byte.h = header[0x29];
+  smp.r.p = header[0x2a];
+  smp.r.s = header[0x2b];
+  reset_stack_min();
+
+  std::array<uint8_t, 128> dspRegisters;
+  memory::copy(dspRegisters.data(), data + DSP_OFFSET, dspRegisters.size());
+  smp.dsp.loadRegisters(dspRegisters);
+
+  // Same as `reset()`, the echo buffer starts at ESA with a length of EDL.
+  smp.dsp.resetEchoBuffer();
+
+  smp.loadIO(ram + 0xf0);
+
+  smp.dsp.dirtyPages.fill(true);
+  smp.dsp.updateSharedPages();
+  smp.synchronizeDSP();
+
+  resampler.reset();
+
+  return true;
 }
 
 auto ShvcSoundEmu::iplrom() const -> const std::array<uint8_t, 64>& {
@@ -55,13 +158,42 @@ auto ShvcSoundEmu::apuram() const -> const std::array<uint8_t, 65536>& {
 }
 
 auto ShvcSoundEmu::apuram_mut () -> std::array<uint8_t, 65536>& {
+  // The caller can write anywhere
+  smp.dsp.dirtyPages.fill(true);
   return smp.dsp.apuram;
 }
 
+auto ShvcSoundEmu::dirty_apuram_pages() const -> std::array<uint8_t, 32> {
+  std::array<uint8_t, 32> out = {};
+  for(auto page : range(256)) {
+    if(smp.dsp.dirtyPages[page]) out[page >> 3] |= 1 << (page & 7);
+  }
+  return out;
+}
+
+auto ShvcSoundEmu::clear_dirty_apuram_pages() -> void {
+  smp.dsp.dirtyPages.fill(false);
+}
+
 auto ShvcSoundEmu::dsp_registers() const -> const std::array<uint8_t, 128>& {
   return smp.dsp.registers;
 }
 
+auto ShvcSoundEmu::take_dsp_register_changes() -> std::array<uint8_t, 16> {
+  // The DSP runs behind the SMP
+  smp.synchronizeDSP();
+
+  std::array<uint8_t, 16> out;
+  for(auto i : range(16)) out[i] = smp.dsp.changedRegisters[i];
+  smp.dsp.changedRegisters.fill(0);
+  return out;
+}
+
+auto ShvcSoundEmu::set_track_voice_register_changes(bool enabled) -> void {
+  smp.synchronizeDSP();
+  smp.dsp.trackVoiceRegisterChanges = enabled;
+}
+
 auto ShvcSoundEmu::write_dsp_register(uint8_t addr, uint8_t value) -> void {
   if(addr < smp.dsp.registers.size()) {
     smp.dsp.write(addr, value);
@@ -71,7 +203,121 @@ auto ShvcSoundEmu::write_dsp_register(uint8_t addr, uint8_t value) -> void {
 auto ShvcSoundEmu::write_smp_register(uint8_t addr, uint8_t value) -> void {
   if(addr > 0xf0 && addr < 0x100) {
     smp.write(addr, value);
+    smp.synchronizeDSP();
+  }
+}
+
+auto ShvcSoundEmu::dsp_clock() const -> uint64_t {
+  return smp.dsp.clocks();
+}
+
+auto ShvcSoundEmu::counters() -> EmulatorCounters {
+  // The DSP runs behind the SMP
+  smp.synchronizeDSP();
+
+  EmulatorCounters c;
+  c.smp_clocks = smp.clock();
+  c.smp_instructions = smp.instructions();
+  c.dsp_clocks = smp.dsp.clocks();
+  c.dsp_samples = smp.dsp.samplesOutput();
+  return c;
+}
+
+auto ShvcSoundEmu::monitor_snapshot(const MonitorLayout& layout) -> MonitorSnapshot {
+  // The DSP runs behind the SMP
+  smp.synchronizeDSP();
+
+  const auto& apuram = smp.dsp.apuram;
+  auto read16 = [&](uint16_t addr) -> uint16_t {
+    return apuram[addr] | (apuram[uint16_t(addr + 1)] << 8);
+  };
+
+  MonitorSnapshot m;
+  m.version = MONITOR_SNAPSHOT_VERSION;
+  m.smp_clock = smp.clock();
+  m.song_ptr = read16(layout.song_ptr);
+  m.song_tick_counter = read16(layout.song_tick_counter);
+  m.music_channels_mask = apuram[layout.music_channels_mask];
+
+  for(uint32_t i = 0; i < m.instruction_ptrs.size(); i++) {
+    m.instruction_ptrs[i] = apuram[uint16_t(layout.instruction_ptr_l + i)]
+                          | (apuram[uint16_t(layout.instruction_ptr_h + i)] << 8);
+    m.volume[i] = apuram[uint16_t(layout.volume + i)];
+    m.pan[i] = apuram[uint16_t(layout.pan + i)];
+  }
+
+  m.voice_key_on = 0;
+  for(uint32_t v = 0; v < 8; v++) {
+    m.voice_pitch[v] = smp.dsp.voicePitch(v);
+    m.voice_envelope[v] = smp.dsp.voiceEnvelope(v);
+    if(smp.dsp.voiceKeyedOn(v)) m.voice_key_on |= 1 << v;
   }
+
+  return m;
+}
+
+auto ShvcSoundEmu::start_dsp_log(size_t capacity) -> void {
+  auto& dsp = smp.dsp;
+  dsp.registerLog.clear();
+  dsp.registerLog.reserve(capacity);
+  dsp.apuramLog.clear();
+  dsp.apuramLog.reserve(capacity);
+  dsp.logWrites = true;
+  smp.loggingChanged();
+}
+
+auto ShvcSoundEmu::stop_dsp_log() -> void {
+  smp.dsp.logWrites = false;
+  smp.loggingChanged();
+}
+
+auto ShvcSoundEmu::take_dsp_register_log() -> rust::Vec<DspRegisterWrite> {
+  auto& log = smp.dsp.registerLog;
+
+  rust::Vec<DspRegisterWrite> out;
+  out.reserve(log.size());
+  for(const auto& w : log) out.push_back({w.clock, (uint8_t)w.address, w.data});
+
+  // Keeps the preallocated capacity
+  log.clear();
+  return out;
+}
+
+auto ShvcSoundEmu::take_apuram_write_log() -> rust::Vec<ApuramWrite> {
+  auto& log = smp.dsp.apuramLog;
+
+  rust::Vec<ApuramWrite> out;
+  out.reserve(log.size());
+  for(const auto& w : log) out.push_back({w.clock, w.address, w.data});
+
+  // Keeps the preallocated capacity
+  log.clear();
+  return out;
+}
+
+auto ShvcSoundEmu::start_event_log(size_t capacity) -> void {
+  auto& dsp = smp.dsp;
+  dsp.eventLog.clear();
+  dsp.eventLog.reserve(capacity);
+  dsp.logEvents = true;
+}
+
+auto ShvcSoundEmu::stop_event_log() -> void {
+  smp.dsp.logEvents = false;
+}
+
+auto ShvcSoundEmu::take_event_log() -> rust::Vec<SoundEvent> {
+  auto& log = smp.dsp.eventLog;
+
+  rust::Vec<SoundEvent> out;
+  out.reserve(log.size());
+  for(const auto& e : log) {
+    out.push_back({e.clock, (SoundEventKind)e.kind, e.voice, e.source, e.pitch});
+  }
+
+  // Keeps the preallocated capacity
+  log.clear();
+  return out;
 }
 
 auto ShvcSoundEmu::read_io_ports() const -> std::array<uint8_t, 4> {
@@ -88,18 +334,673 @@ auto ShvcSoundEmu::write_io_ports(std::array<uint8_t, 4> ports) -> void {
   }
 }
 
+auto ShvcSoundEmu::schedule_port_write(uint64_t smp_clock, std::array<uint8_t, 4> ports) -> void {
+  smp.schedulePortWrite(smp_clock, {ports[0], ports[1], ports[2], ports[3]});
+}
+
+auto ShvcSoundEmu::clear_scheduled_port_writes() -> void {
+  smp.clearScheduledPortWrites();
+}
+
+auto ShvcSoundEmu::scheduled_port_writes() const -> size_t {
+  return smp.scheduledPortWrites();
+}
+
+auto ShvcSoundEmu::start_io_latency(uint8_t key_on_mask, uint8_t key_on_command) -> void {
+  smp.ioLatency = {};
+  smp.ioLatency.enabled = true;
+  smp.ioLatency.keyOnMask = key_on_mask;
+  smp.ioLatency.keyOnCommand = key_on_command & key_on_mask;
+}
+
+auto ShvcSoundEmu::stop_io_latency() -> void {
+  smp.ioLatency.enabled = false;
+  smp.ioLatency.waitingAck = false;
+  smp.ioLatency.waitingKeyOn = false;
+}
+
+auto ShvcSoundEmu::io_latency() const -> IoLatency {
+  static_assert(std::tuple_size_v<decltype(LatencyHistogram::buckets)> == SMP::LatencyHistogram::Buckets);
+
+  auto histogram = [](const SMP::LatencyHistogram& h) {
+    LatencyHistogram out;
+    out.count = h.count;
+    out.total_clocks = h.total;
+    out.min_clocks = h.count ? h.min : 0;
+    out.max_clocks = h.max;
+    for(auto i : range(SMP::LatencyHistogram::Buckets)) out.buckets[i] = h.buckets[i];
+    return out;
+  };
+
+  const auto& l = smp.ioLatency;
+  return {histogram(l.ack), histogram(l.keyOn), l.unacknowledged};
+}
+
+auto ShvcSoundEmu::apply_batch(rust::Slice<const BatchOp> ops, rust::Slice<const uint8_t> data) -> void {
+  for(const auto& op : ops) {
+    if(op.data_offset > data.size() || op.data_size > data.size() - op.data_offset) continue;
+    const uint8_t* d = data.data() + op.data_offset;
+
+    switch(op.kind) {
+    case BatchOpKind::ApuramWrite: {
+      auto& apuram = smp.dsp.apuram;
+      if(op.data_size == 0 || op.data_size > apuram.size() - op.address) break;
+
+      memory::copy(&apuram[op.address], d, op.data_size);
+      for(u32 page = op.address >> 8; page <= (op.address + op.data_size - 1) >> 8; page++) {
+        smp.dsp.dirtyPages[page] = true;
+      }
+      break;
+    }
+    case BatchOpKind::DspRegisterWrite:
+      if(op.data_size == 1 && op.address <= 0xff) write_dsp_register(op.address, d[0]);
+      break;
+    case BatchOpKind::SmpRegisterWrite:
+      if(op.data_size == 1 && op.address <= 0xff) write_smp_register(op.address, d[0]);
+      break;
+    case BatchOpKind::IoPortsWrite:
+      if(op.data_size == 4) write_io_ports({d[0], d[1], d[2], d[3]});
+      break;
+    }
+  }
+}
+
 auto ShvcSoundEmu::program_counter() const -> uint16_t {
   return smp.r.pc.w;
 }
 
+auto ShvcSoundEmu::halted() const -> bool {
+  return smp.halted();
+}
+
+auto ShvcSoundEmu::dsp_quiescent(uint32_t echo_threshold) const -> bool {
+  return smp.dsp.quiescent(echo_threshold);
+}
+
+auto ShvcSoundEmu::stack_min() const -> uint8_t {
+  return smp.stackMin;
+}
+
+auto ShvcSoundEmu::reset_stack_min() -> void {
+  smp.stackMin = smp.r.s;
+}
+
+auto ShvcSoundEmu::smp_registers() const -> SmpRegisters {
+  SmpRegisters r;
+  r.pc = smp.r.pc.w;
+  r.a = smp.r.ya.byte.l;
+  r.x = smp.r.x;
+  r.y = smp.r.ya.byte.h;
+  r.psw = smp.r.p;
+  r.sp = smp.r.s;
+  return r;
+}
+
+// "SHVS" (little endian)
+static constexpr uint32_t STATE_SIGNATURE = 0x53564853;
+
+auto ShvcSoundEmu::serializeState(serializer& s, SMP& smp) -> void {
+  uint32_t signature = STATE_SIGNATURE;
+  uint32_t version = STATE_VERSION;
+  s(signature);
+  s(version);
+
+  // Audio-RAM is stored at STATE_APURAM_OFFSET
+  for(auto& byte : smp.dsp.apuram) s(byte);
+
+  smp.serialize(s);
+}
+
+auto ShvcSoundEmu::save_state() const -> std::unique_ptr<std::vector<uint8_t>> {
+  // The serializer requires mutable access, write the state from a copy of the S-SMP
+  auto copy = std::make_unique<SMP>(smp);
+
+  serializer s;
+  serializeState(s, *copy);
+
+  return std::make_unique<std::vector<uint8_t>>(s.data(), s.data() + s.size());
+}
+
+auto ShvcSoundEmu::load_state(const uint8_t* data, size_t size) -> bool {
+  // The state size is the same for every state
+  static const size_t stateSize = [this] {
+    serializer s;
+    serializeState(s, smp);
+    return s.size();
+  }();
+
+  if(size != stateSize) return false;
+
+  serializer s(data, size);
+  uint32_t signature = 0;
+  uint32_t version = 0;
+  s(signature);
+  s(version);
+  if(signature != STATE_SIGNATURE || version != STATE_VERSION) return false;
+
+  for(auto& byte : smp.dsp.apuram) s(byte);
+  smp.serialize(s);
+
+  smp.dsp.dirtyPages.fill(true);
+  smp.dsp.changedRegisters.fill(0xff);
+  resampler.reset();
+  reset_stack_min();
+
+  return true;
+}
+
+auto ShvcSoundEmu::state_hash() const -> uint64_t {
+  auto& emu = const_cast<ShvcSoundEmu&>(*this);
+
+  // The timers are stepped lazily, the stored timer state depends on when they were last read.
+  // Stepping the timers does not modify the emulator.
+  emu.smp.synchronizeTimers();
+
+  serializer s;
+  serializeState(s, emu.smp);
+
+  return Hash::CRC64({s.data(), s.size()}).value();
+}
+
+auto ShvcSoundEmu::state_hash_ranges(rust::Slice<const ApuramRange> ranges) const -> uint64_t {
+  auto& emu = const_cast<ShvcSoundEmu&>(*this);
+
+  // The DSP runs behind the SMP.
+  // Synchronizing the DSP does not modify the emulator.
+  emu.smp.synchronizeDSP();
+
+  serializer s;
+  for(const auto& r : ranges) {
+    if(r.first > r.last) continue;
+    for(uint32_t a = r.first; a <= r.last; a++) s(emu.smp.dsp.apuram[a]);
+  }
+  for(auto& byte : emu.smp.dsp.registers) s(byte);
+  emu.smp.dsp.serializeVoices(s);
+
+  return Hash::CRC64({s.data(), s.size()}).value();
+}
+
+auto ShvcSoundEmu::set_fast_paths(bool enabled) -> void {
+  smp.dsp.fastPaths = enabled;
+  smp.fastPathsChanged();
+  smp.synchronizeDSP();
+}
+
+auto ShvcSoundEmu::set_logic_only(bool enabled) -> void {
+  // The pending clocks are emulated in the previous mode
+  smp.synchronizeDSP();
+  smp.dsp.logicOnly = enabled;
+  // The voices may have been keyed on while the DSP was asleep
+  smp.dsp.wake();
+  // logicOnly voices do not access Audio-RAM
+  smp.dsp.updateSharedPages();
+}
+
+auto ShvcSoundEmu::set_brr_cache_enabled(bool enabled) -> void {
+  smp.synchronizeDSP();
+  if(enabled) {
+    if(smp.dsp.brrCache.empty()) smp.dsp.brrCache.resize(DSP::BRRCacheSize);
+  } else {
+    smp.dsp.brrCache = {};
+  }
+}
+
+// The caller can modify Audio-RAM and the S-DSP registers between runs
+auto ShvcSoundEmu::beginRun() -> void {
+  smp.synchronizeDSP();
+  smp.dsp.updateSharedPages();
+  smp.resetIdleLoop();
+
+  #if defined(SHVC_SOUND_EMU_GDB_SERVER)
+  smp.gdbUpdate();
+  #endif
+}
+
 auto ShvcSoundEmu::emulate() -> const std::array<int16_t, AUDIO_BUFFER_SIZE>& {
   smp.dsp.sampleBuffer.reset();
+  emulateSamples();
+
+  return smp.dsp.sampleBuffer.samples();
+}
+
+auto ShvcSoundEmu::set_output_sample_rate(uint32_t rate, ResamplerQuality quality) -> bool {
+  return resampler.configure(rate, quality);
+}
+
+auto ShvcSoundEmu::output_sample_rate() const -> uint32_t {
+  return resampler.outputRate();
+}
+
+auto ShvcSoundEmu::emulate_resampled(int16_t* out, size_t frames) -> void {
+  while(frames > 0) {
+    const size_t chunk = std::min<size_t>(frames, OutputResampler::OutputChunkFrames);
+    const size_t input = resampler.inputFrames(chunk);
+
+    if(input > 0) {
+      smp.dsp.sampleBuffer.reset(resampler.input.data(), input);
+      emulateSamples();
+    }
+    resampler.process(resampler.input.data(), out, chunk);
+
+    out += chunk * 2;
+    frames -= chunk;
+  }
+}
+
+auto ShvcSoundEmu::set_voice_mute_mask(uint8_t mask, bool skip_interpolation) -> void {
+  smp.synchronizeDSP();
+  smp.dsp.muteMask = mask;
+  smp.dsp.skipMutedInterpolation = skip_interpolation;
+}
+
+auto ShvcSoundEmu::set_voice_tap(uint8_t voice, int16_t* buffer, size_t frames) -> void {
+  if(voice >= 8) return;
+
+  auto& tap = smp.dsp.taps[voice];
+  tap = {};
+  if(buffer && frames > 0) {
+    tap.buffer = buffer;
+    tap.frames = frames;
+  }
+  smp.dsp.wake();
+}
+
+auto ShvcSoundEmu::voice_tap_position(uint8_t voice) const -> uint64_t {
+  return voice < 8 ? smp.dsp.taps[voice].written : 0;
+}
+
+auto ShvcSoundEmu::set_profiler_enabled(bool enabled) -> void {
+  constexpr size_t PROFILE_SIZE = 0x10000;
+
+  auto& profile = smp.profile;
+  if(enabled && Instrumentation::enabled) {
+    profile.assign(PROFILE_SIZE, 0);
+  } else {
+    profile.clear();
+    profile.shrink_to_fit();
+  }
+}
+
+auto ShvcSoundEmu::profile() const -> rust::Slice<const uint64_t> {
+  return {smp.profile.data(), smp.profile.size()};
+}
+
+auto ShvcSoundEmu::set_access_map_enabled(bool enabled) -> void {
+  auto& map = smp.dsp.accessMap;
+  if(enabled && AccessMap::enabled) {
+    map.assign(64_KiB, 0);
+  } else {
+    map.clear();
+    map.shrink_to_fit();
+  }
+  smp.accessMapChanged();
+}
+
+auto ShvcSoundEmu::access_map() const -> rust::Slice<const uint8_t> {
+  return {smp.dsp.accessMap.data(), smp.dsp.accessMap.size()};
+}
+
+auto ShvcSoundEmu::set_echo_guard(uint16_t first, uint16_t last) -> void {
+  if(first > last) return clear_echo_guard();
+
+  smp.dsp.echoGuard = {};
+  smp.dsp.echoGuard.begin = first;
+  smp.dsp.echoGuard.size = u32(last - first) + 1;
+}
+
+auto ShvcSoundEmu::clear_echo_guard() -> void {
+  smp.dsp.echoGuard = {};
+}
+
+auto ShvcSoundEmu::take_echo_guard_hit() -> EchoGuardHit {
+  // The DSP runs behind the SMP
+  smp.synchronizeDSP();
+
+  auto& g = smp.dsp.echoGuard;
+
+  EchoGuardHit out;
+  out.hit = g.hit;
+  out.address = g.hit ? u16(g.address) : 0;
+  out.dsp_clock = g.hit ? g.clock : 0;
+
+  g.hit = false;
+  return out;
+}
+
+auto ShvcSoundEmu::add_watchpoint(uint16_t first, uint16_t last, uint8_t kinds) -> void {
+  kinds &= SMP::WatchRead | SMP::WatchWrite | SMP::WatchExecute;
+  if(!Instrumentation::enabled || first > last || !kinds) return;
+
+  smp.watch.watchpoints.push_back({first, last, kinds});
+  smp.watchpointsChanged();
+}
+
+auto ShvcSoundEmu::clear_watchpoints() -> void {
+  smp.watch.watchpoints.clear();
+  smp.watchpointsChanged();
+}
+
+auto ShvcSoundEmu::set_watchpoint_log_size(size_t capacity) -> void {
+  auto& watch = smp.watch;
+  watch.hits.assign(capacity, {});
+  watch.hits.shrink_to_fit();
+  watch.hitCount = 0;
+  watch.hitsTaken = 0;
+}
+
+auto ShvcSoundEmu::take_watchpoint_hits() -> rust::Vec<WatchpointHit> {
+  auto& watch = smp.watch;
+
+  rust::Vec<WatchpointHit> out;
+  if(watch.hits.empty()) return out;
+
+  const u64 first = std::max(watch.hitsTaken, watch.hitCount - std::min<u64>(watch.hitCount, watch.hits.size()));
+  out.reserve(watch.hitCount - first);
+  for(u64 i = first; i < watch.hitCount; i++) {
+    const auto& h = watch.hits[i % watch.hits.size()];
+    out.push_back({h.clock, h.pc, h.address, h.kind, h.data});
+  }
+
+  watch.hitsTaken = watch.hitCount;
+  return out;
+}
+
+auto ShvcSoundEmu::set_trace_size(size_t entries) -> void {
+  auto& trace = smp.trace;
+  trace.entries.clear();
+  trace.entries.shrink_to_fit();
+  trace.count = 0;
+  if(entries > 0 && Instrumentation::enabled) {
+    size_t size = 1;
+    while(size < entries) size <<= 1;
+    trace.entries.resize(size);
+  }
+}
+
+auto ShvcSoundEmu::trace() const -> rust::Vec<TraceEntry> {
+  const auto& trace = smp.trace;
+
+  rust::Vec<TraceEntry> out;
+  const u64 n = std::min<u64>(trace.count, trace.entries.size());
+  out.reserve(n);
+  for(u64 i = trace.count - n; i < trace.count; i++) {
+    const auto& t = trace.entries[i & (trace.entries.size() - 1)];
+    out.push_back({t.clock, t.pc, t.bytes[0], t.bytes[1], t.bytes[2], t.a, t.x, t.y, t.p, t.s});
+  }
+  return out;
+}
+
+auto ShvcSoundEmu::trace_count() const -> uint64_t {
+  return smp.trace.count;
+}
+
+auto ShvcSoundEmu::disassemble(uint16_t address) const -> rust::String {
+  const n16 a = address;
+  return SPC700::disassemble(a, {smp.readDisassembler(a), smp.readDisassembler(a + 1), smp.readDisassembler(a + 2)});
+}
+
+auto disassemble_trace_entry(const TraceEntry& entry) -> rust::String {
+  return SPC700::disassemble(entry.pc, {entry.opcode, entry.operand1, entry.operand2});
+}
+
+auto trace_envelopes(rust::Slice<const EnvelopeTraceConfig> configs, uint32_t samples) -> rust::Vec<uint16_t> {
+  std::vector<DSP::EnvelopeTrace> traces;
+  traces.reserve(configs.size());
+  for(const auto& c : configs) {
+    traces.push_back({c.adsr1, c.adsr2, c.gain, c.key_off_sample});
+  }
+
+  std::vector<uint16_t> levels(traces.size() * samples);
+  DSP::traceEnvelopes(traces.data(), traces.size(), samples, levels.data());
+
+  rust::Vec<uint16_t> out;
+  out.reserve(levels.size());
+  for(auto l : levels) out.push_back(l);
+  return out;
+}
+
+auto ShvcSoundEmu::start_gdb_server(uint16_t port) -> bool {
+  #if defined(SHVC_SOUND_EMU_GDB_SERVER)
+  return smp.gdbServerStart(port);
+  #else
+  (void)port;
+  return false;
+  #endif
+}
 
+auto ShvcSoundEmu::stop_gdb_server() -> void {
+  #if defined(SHVC_SOUND_EMU_GDB_SERVER)
+  smp.gdbServerStop();
+  #endif
+}
+
+auto ShvcSoundEmu::watchpoint_hit_count() const -> uint64_t {
+  return smp.watch.hitCount;
+}
+
+auto ShvcSoundEmu::meters() -> AudioMeters {
+  auto& m = smp.dsp.meters;
+
+  auto rms = [&](u64 squares) -> uint16_t {
+    return m.samples ? std::min(std::lround(std::sqrt(double(squares) / m.samples)), 32768l) : 0;
+  };
+
+  AudioMeters out;
+  for(auto n : range(8)) {
+    out.voice_peak[n] = m.voicePeak[n];
+    out.voice_rms[n] = rms(m.voiceSquares[n]);
+  }
+  for(auto c : range(2)) {
+    out.peak[c] = m.peak[c];
+    out.rms[c] = rms(m.squares[c]);
+  }
+
+  m = {};
+  return out;
+}
+
+auto ShvcSoundEmu::take_source_usage() -> SourceUsage {
+  auto& u = smp.dsp.sourceUsage;
+
+  SourceUsage out;
+  for(auto s : range(256)) {
+    out.key_ons[s] = u.keyOns[s];
+    out.brr_blocks[s] = u.brrBlocks[s];
+    u.keyOns[s] = 0;
+    u.brrBlocks[s] = 0;
+  }
+  return out;
+}
+
+auto ShvcSoundEmu::take_clipping() -> ClippingCounters {
+  auto& c = smp.dsp.clipping;
+
+  ClippingCounters out;
+  for(auto i : range(2)) {
+    out.main[i] = c.main[i];
+    out.echo[i] = c.echo[i];
+    out.fir[i] = c.fir[i];
+    out.feedback[i] = c.feedback[i];
+    out.output[i] = c.output[i];
+  }
+
+  c = {};
+  return out;
+}
+
+auto ShvcSoundEmu::emulate_into(int16_t* out, size_t frames) -> void {
+  smp.dsp.sampleBuffer.reset(out, frames);
+  // The sample buffer is full (and will not write to `out`) when this returns
+  emulateSamples();
+}
+
+auto ShvcSoundEmu::emulate_planar_into(int16_t* left, int16_t* right, size_t frames) -> void {
+  smp.dsp.sampleBuffer.resetPlanar(left, right, frames);
+  emulateSamples();
+}
+
+auto ShvcSoundEmu::emulate_mono_into(int16_t* out, size_t frames) -> void {
+  smp.dsp.sampleBuffer.resetMono(out, frames);
+  emulateSamples();
+}
+
+auto ShvcSoundEmu::emulate_waveform_overview(int16_t* out, size_t bins, uint32_t bin_frames) -> void {
+  if(bin_frames == 0) return;
+
+  smp.dsp.sampleBuffer.resetPeaks(out, bins, bin_frames);
+  emulateSamples();
+}
+
+auto ShvcSoundEmu::emulate_for(int16_t* out, size_t frames, uint64_t max_smp_clocks) -> size_t {
+  auto& buffer = smp.dsp.sampleBuffer;
+  const u64 start = smp.clock();
+
+  buffer.reset(out, frames);
+  beginRun();
+
+  while(!buffer.isFull() && smp.clock() - start < max_smp_clocks) {
+    const size_t space = buffer.space();
+    smp.idleLoopSkipUntil = space > 2 * SMP::DSPBatchSamples ? start + max_smp_clocks : 0;
+    smp.main();
+    if(buffer.space() <= SMP::DSPBatchSamples) smp.synchronizeDSP();
+  }
+  smp.idleLoopSkipUntil = 0;
+
+  // Outputs the samples completed by the emulated clocks
+  smp.synchronizeDSP();
+  const size_t written = frames - buffer.space();
+
+  // `out` may be freed after this returns
+  buffer.reset(out, 0);
+
+  return written;
+}
+
+auto ShvcSoundEmu::emulateSamples() -> void {
+  beginRun();
+
+  // The DSP is synchronized after every instruction near the end of the buffer so no samples are dropped.
+  // An instruction can output up to two DSP batches if it ends with an idle loop skip.
   while(!smp.dsp.sampleBuffer.isFull()) {
+    const size_t space = smp.dsp.sampleBuffer.space();
+    smp.idleLoopSkipUntil = space > 2 * SMP::DSPBatchSamples ? ~0ull : 0;
+    smp.main();
+    if(smp.dsp.sampleBuffer.space() <= SMP::DSPBatchSamples) smp.synchronizeDSP();
+  }
+  smp.idleLoopSkipUntil = 0;
+}
+
+auto ShvcSoundEmu::fast_forward(uint64_t smp_clocks) -> uint64_t {
+  const u64 start = smp.clock();
+
+  smp.dsp.fastForward = true;
+  beginRun();
+  while(smp.clock() - start < smp_clocks) {
+    smp.idleLoopSkipUntil = start + smp_clocks;
     smp.main();
   }
+  smp.idleLoopSkipUntil = 0;
+  smp.synchronizeDSP();
+  smp.dsp.fastForward = false;
 
-  return smp.dsp.sampleBuffer.samples();
+  return smp.clock() - start;
+}
+
+auto ShvcSoundEmu::run_until_pc(uint16_t pc, uint64_t max_smp_clocks) -> RunResult {
+  const u64 start = smp.clock();
+  bool hit = true;
+
+  smp.dsp.fastForward = true;
+  beginRun();
+  while(smp.r.pc.w != pc) {
+    if(smp.clock() - start >= max_smp_clocks || smp.halted()) {
+      hit = false;
+      break;
+    }
+    smp.main();
+  }
+  smp.synchronizeDSP();
+  smp.dsp.fastForward = false;
+
+  return { smp.clock() - start, hit };
+}
+
+auto ShvcSoundEmu::run_ticks(uint32_t ticks, uint16_t tick_pc, uint64_t max_smp_clocks) -> RunResult {
+  const u64 start = smp.clock();
+  bool hit = true;
+
+  smp.dsp.fastForward = true;
+  beginRun();
+  u64 timerOutputs = smp.timer0Outputs();
+  while(ticks > 0) {
+    if(smp.clock() - start >= max_smp_clocks || smp.halted()) {
+      hit = false;
+      break;
+    }
+    smp.idleLoopSkipUntil = start + max_smp_clocks;
+    smp.main();
+
+    if(smp.r.pc.w == tick_pc) {
+      const u64 outputs = smp.timer0Outputs();
+      if(outputs != timerOutputs) {
+        timerOutputs = outputs;
+        ticks--;
+      }
+    }
+  }
+  smp.idleLoopSkipUntil = 0;
+  smp.synchronizeDSP();
+  smp.dsp.fastForward = false;
+
+  return { smp.clock() - start, hit };
+}
+
+auto ShvcSoundEmu::run_until_port_write(uint8_t port_mask, uint64_t max_smp_clocks) -> RunResult {
+  const u64 start = smp.clock();
+  bool hit = true;
+
+  smp.portsWritten = 0;
+
+  smp.dsp.fastForward = true;
+  beginRun();
+  while(!(smp.portsWritten & port_mask)) {
+    if(smp.clock() - start >= max_smp_clocks || smp.halted()) {
+      hit = false;
+      break;
+    }
+    // Idle loops do not write to the ports
+    smp.idleLoopSkipUntil = start + max_smp_clocks;
+    smp.main();
+  }
+  smp.idleLoopSkipUntil = 0;
+  smp.synchronizeDSP();
+  smp.dsp.fastForward = false;
+
+  return { smp.clock() - start, hit };
+}
+
+auto ShvcSoundEmu::run_until_watchpoint(uint64_t max_smp_clocks) -> RunResult {
+  const u64 start = smp.clock();
+  bool hit = true;
+
+  smp.watch.hit = false;
+
+  smp.dsp.fastForward = true;
+  beginRun();
+  while(!smp.watch.hit) {
+    if(smp.clock() - start >= max_smp_clocks || smp.halted()) {
+      hit = false;
+      break;
+    }
+    // Idle loops that access a watchpoint are not skipped
+    smp.idleLoopSkipUntil = start + max_smp_clocks;
+    smp.main();
+  }
+  smp.idleLoopSkipUntil = 0;
+  smp.synchronizeDSP();
+  smp.dsp.fastForward = false;
+
+  return { smp.clock() - start, hit };
 }
 
 }
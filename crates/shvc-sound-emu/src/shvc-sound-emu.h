@@ -0,0 +1,72 @@
+#pragma once
+
+// C API for real-time hosts (audio plugins and game engine audio callbacks).
+//
+// The functions are compiled into the crate's C++ library (alongside the cxx bridge) and do not
+// throw exceptions.
+//
+// Real-time safe functions (marked `[real-time]`) do not allocate memory, lock or block and may be
+// called from an audio callback.  The other functions must be called outside the audio callback
+// (ie, when the plugin is activated or a song is loaded).
+//
+// An instance must not be used by more than one thread at a time.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct shvc_emu shvc_emu;
+
+// Must match `ResamplerQuality`
+typedef enum shvc_emu_resampler_quality {
+  SHVC_EMU_RESAMPLER_LINEAR = 0,
+  SHVC_EMU_RESAMPLER_CUBIC = 1,
+  SHVC_EMU_RESAMPLER_SINC = 2,
+} shvc_emu_resampler_quality;
+
+#define SHVC_EMU_MIN_OUTPUT_SAMPLE_RATE 8000
+#define SHVC_EMU_MAX_OUTPUT_SAMPLE_RATE 192000
+
+// Creates a powered-on emulator with an output sample rate of 32000 Hz.
+// Returns NULL if the instance could not be allocated.
+shvc_emu* shvc_emu_create(const uint8_t iplrom[64]);
+
+// Copies the entire emulator state and settings.
+// Returns NULL if the instance could not be allocated.
+shvc_emu* shvc_emu_clone(const shvc_emu* emu);
+
+// `emu` may be NULL.
+void shvc_emu_destroy(shvc_emu* emu);
+
+// Loads a .spc file.  Returns false (and leaves the emulator unchanged) if the file is invalid.
+bool shvc_emu_load_spc(shvc_emu* emu, const uint8_t* data, size_t size);
+
+// Sets the sample rate of `shvc_emu_process()` and `shvc_emu_process_f32()` and how the 32000 Hz
+// S-DSP output is interpolated.  The sinc kernel is allocated by this function.
+// Returns false (and leaves the resampler unchanged) if `rate` or `quality` is out of range.
+bool shvc_emu_set_output_sample_rate(shvc_emu* emu, uint32_t rate, shvc_emu_resampler_quality quality);
+
+// [real-time]
+uint32_t shvc_emu_output_sample_rate(const shvc_emu* emu);
+
+// [real-time] Writes `frames` interleaved 16 bit stereo samples at the output sample rate to `out`.
+// `frames` may be any size (including 0).
+void shvc_emu_process(shvc_emu* emu, int16_t* out, size_t frames);
+
+// [real-time] Writes `frames` samples at the output sample rate to the `left` and `right` channels
+// (-1.0 to +1.0).
+// `frames` may be any size (including 0).
+void shvc_emu_process_f32(shvc_emu* emu, float* left, float* right, size_t frames);
+
+// [real-time]
+void shvc_emu_read_io_ports(const shvc_emu* emu, uint8_t ports[4]);
+// [real-time]
+void shvc_emu_write_io_ports(shvc_emu* emu, const uint8_t ports[4]);
+
+#ifdef __cplusplus
+}
+#endif
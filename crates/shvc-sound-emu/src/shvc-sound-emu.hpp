@@ -1,21 +1,39 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #include <cstdint>
 
+#include "rust/cxx.h"
+
 #include <nall/platform.hpp>
 #include <nall/endian.hpp>
 #include <nall/literals.hpp>
 #include <nall/memory.hpp>
 #include <nall/primitives.hpp>
+#include <nall/hash/crc64.hpp>
+#if defined(SHVC_SOUND_EMU_GDB_SERVER)
+#include <nall/chrono.hpp>
+#include <nall/gdb/server.hpp>
+#endif
 
 using namespace nall;
 using namespace nall::primitives;
 
 #include "types.hpp"
+#include "instrumentation.hpp"
 
 #include "sample-buffer.hpp"
+#include "simd-kernels.hpp"
+#include "output-resampler.hpp"
 
 #include "spc700/spc700.hpp"
 #include "dsp/dsp.hpp"
@@ -24,38 +42,403 @@ using namespace nall::primitives;
 namespace shvc_sound_emu {
 
 struct ResetRegisters;
+struct SmpRegisters;
+struct RunResult;
+struct RenderResult;
+struct DspRegisterWrite;
+struct ApuramWrite;
+struct SoundEvent;
+struct AudioMeters;
+struct SourceUsage;
+struct ClippingCounters;
+struct EmulatorCounters;
+struct MonitorLayout;
+struct MonitorSnapshot;
+struct WatchpointHit;
+struct EchoGuardHit;
+struct LatencyHistogram;
+struct IoLatency;
+struct TraceEntry;
+struct BatchOp;
+struct ApuramRange;
+struct EmulatorJob;
+struct EmulatorJobResult;
+struct IdleWatch;
+struct SfxRenderSettings;
+struct SfxRenderJob;
+struct SfxRenderResult;
+struct EnvelopeTraceConfig;
+struct GaussianOverflowScan;
 
 struct ShvcSoundEmu {
   constexpr static uint32_t AUDIO_BUFFER_SAMPLES = 256;
   constexpr static uint32_t AUDIO_BUFFER_SIZE = AUDIO_BUFFER_SAMPLES * 2;
 
+  // Incremented whenever the save state format changes
+  constexpr static uint32_t STATE_VERSION = 2;
+
+  // Offset of the 64 KiB Audio-RAM within a save state
+  constexpr static uint32_t STATE_APURAM_OFFSET = 8;
+
+  // Incremented whenever the `MonitorSnapshot` fields change
+  constexpr static uint32_t MONITOR_SNAPSHOT_VERSION = 1;
+
   ShvcSoundEmu(const std::array<uint8_t, 64>& iplrom);
+  // Copies the entire emulator state and settings
+  ShvcSoundEmu(const ShvcSoundEmu& source);
+  auto operator=(const ShvcSoundEmu&) -> ShvcSoundEmu& = delete;
   ~ShvcSoundEmu();
 
   auto reset(ResetRegisters r) -> void;
 
+  // Restores the Audio-RAM, S-DSP registers, S-SMP registers, timers, CPUIO ports and IPL ROM
+  // enable flag from a .spc file.
+  // `data` is only read during the call.
+  // Returns false (and leaves the emulator unchanged) if `data` is not a .spc file.
+  auto load_spc(const uint8_t* data, size_t size) -> bool;
+
   auto iplrom() const -> const std::array<uint8_t, 64>&;
   auto iplrom_mut () -> std::array<uint8_t, 64>&;
 
   auto apuram() const -> const std::array<uint8_t, 65536>&;
   auto apuram_mut () -> std::array<uint8_t, 65536>&;
 
+  // Bitmask of the Audio-RAM pages written since the last `clear_dirty_apuram_pages()` call
+  // (bit `n & 7` of byte `n >> 3` is set if page `n` is dirty).
+  // `apuram_mut()`, `reset()` and `load_state()` mark every page as dirty.
+  auto dirty_apuram_pages() const -> std::array<uint8_t, 32>;
+  auto clear_dirty_apuram_pages() -> void;
+
   auto dsp_registers() const -> const std::array<uint8_t, 128>&;
 
+  // Returns the S-DSP registers changed since the last call and clears them
+  // (bit `n & 7` of byte `n >> 3` is set if register `n` changed).
+  // Every register is changed after power-on, `reset()`, `load_spc()` and `load_state()`.
+  auto take_dsp_register_changes() -> std::array<uint8_t, 16>;
+  // If enabled, the ENVX, OUTX and ENDX values written by the voices are also tracked
+  // (disabled by default, they change almost every sample while a voice is playing).
+  auto set_track_voice_register_changes(bool enabled) -> void;
+
   auto write_dsp_register(uint8_t addr, uint8_t value) -> void;
   auto write_smp_register(uint8_t addr, uint8_t value) -> void;
 
+  // S-DSP clocks since power-on or reset (32 per sample).
+  auto dsp_clock() const -> uint64_t;
+
+  // Returns the S-SMP clock, S-SMP instruction, S-DSP clock and output sample counters.
+  // The counters increase monotonically from power-on or reset and are not part of the save state.
+  auto counters() -> EmulatorCounters;
+
+  // Copies the audio driver channel variables at the `layout` addresses and the S-DSP voice
+  // pitch, envelope and key-on state in a single call.
+  auto monitor_snapshot(const MonitorLayout& layout) -> MonitorSnapshot;
+
+  // Starts recording every S-DSP register write (including `write_dsp_register()` writes) and every
+  // S-SMP Audio-RAM write with the S-DSP clock it occurred on.
+  // Space for `capacity` writes of each kind is preallocated, the logs grow if it is exceeded.
+  // Previously recorded writes are discarded.
+  // `apuram_mut()` writes are not recorded.
+  auto start_dsp_log(size_t capacity) -> void;
+  auto stop_dsp_log() -> void;
+
+  // Return and clear the recorded writes (recording continues if it has not been stopped).
+  auto take_dsp_register_log() -> rust::Vec<DspRegisterWrite>;
+  auto take_apuram_write_log() -> rust::Vec<ApuramWrite>;
+
+  // Starts recording every voice key-on, every voice key-off that releases a voice and every audio
+  // driver tick (a non-zero T0OUT read) with the S-DSP clock it occurred on.
+  // Space for `capacity` events is preallocated, the log grows if it is exceeded.
+  // Previously recorded events are discarded.
+  auto start_event_log(size_t capacity) -> void;
+  auto stop_event_log() -> void;
+
+  // Returns and clears the recorded events (recording continues if it has not been stopped).
+  auto take_event_log() -> rust::Vec<SoundEvent>;
+
+  // Emulates `frames` samples of the S-DSP alone, applying the logged writes on the S-DSP clock they
+  // were recorded on, and writes the interleaved stereo samples to `out`.
+  // Writes before the current S-DSP clock are skipped, so the log can be replayed in chunks.
+  // The emulator must start in the state it was in when the log started (ie, `load_state()`).
+  // The S-SMP and timers are not emulated and are no longer in sync with the S-DSP.
+  // Both logs MUST be sorted by clock (as recorded).
+  auto replay_dsp_log(rust::Slice<const DspRegisterWrite> registers, rust::Slice<const ApuramWrite> apuram,
+                      int16_t* out, size_t frames) -> void;
+
   auto read_io_ports() const -> std::array<uint8_t, 4>;
   auto write_io_ports(std::array<uint8_t, 4> ports) -> void;
 
+  // Queues an IO port write, applied before the first S-SMP instruction at or after `smp_clock`
+  // (S-SMP clocks since reset, see `counters()`) without stopping the emulation.
+  // The queue is cleared on reset and is not part of the save state.
+  auto schedule_port_write(uint64_t smp_clock, std::array<uint8_t, 4> ports) -> void;
+  auto clear_scheduled_port_writes() -> void;
+  // Number of scheduled port writes that have not been applied.
+  auto scheduled_port_writes() const -> size_t;
+
+  // Clears the IO command latency histograms and starts measuring the latency of port 0 writes.
+  // Commands with `(command & key_on_mask) == key_on_command` also measure the latency of the
+  // next KON write.
+  auto start_io_latency(uint8_t key_on_mask, uint8_t key_on_command) -> void;
+  auto stop_io_latency() -> void;
+  auto io_latency() const -> IoLatency;
+
   auto program_counter() const -> uint16_t;
+  // True if the S-SMP has executed a SLEEP or STOP instruction.
+  // A halted S-SMP does not execute another instruction until reset (the S-DSP keeps running).
+  auto halted() const -> bool;
+  // True if the S-DSP output will stay silent until the S-SMP writes to a S-DSP register.
+  // Every voice is keyed off with a zero envelope and the echo buffer has decayed to within
+  // `echo_threshold` of zero (or both echo volumes are zero).
+  auto dsp_quiescent(uint32_t echo_threshold) const -> bool;
+  auto smp_registers() const -> SmpRegisters;
+
+  // The lowest stack pointer reached by a push, call or interrupt since the last reset,
+  // `load_spc()`, `load_state()` or `reset_stack_min()` call (which sets it to the current S).
+  auto stack_min() const -> uint8_t;
+  auto reset_stack_min() -> void;
+
+  // Applies the operations in order, reading each operation's bytes from `data`.
+  // Audio-RAM writes only mark the pages they write as dirty.
+  // Invalid operations (out of bounds addresses or data) are skipped.
+  auto apply_batch(rust::Slice<const BatchOp> ops, rust::Slice<const uint8_t> data) -> void;
+
+  // Saves the S-SMP, S-DSP, timer, IO and Audio-RAM state (including the IPL ROM).
+  auto save_state() const -> std::unique_ptr<std::vector<uint8_t>>;
+
+  // Restores a state saved by `save_state()`.
+  // Returns false (and leaves the emulator unchanged) if `data` is not a valid save state.
+  // The fast path and fast forward settings are not part of the state.
+  auto load_state(const uint8_t* data, size_t size) -> bool;
+
+  // CRC64 of the state saved by `save_state()`.
+  // The hash does not depend on the fast path setting.
+  auto state_hash() const -> uint64_t;
+
+  // CRC64 of the Audio-RAM `ranges`, the S-DSP registers and the S-DSP voice state.
+  // The S-DSP echo, noise and envelope rate counter state is not hashed.
+  auto state_hash_ranges(rust::Slice<const ApuramRange> ranges) const -> uint64_t;
+
+  // Enables or disables the emulator fast paths (enabled by default).
+  // The fast paths output identical audio and state, disabling them is only useful for testing.
+  auto set_fast_paths(bool enabled) -> void;
+
+  // Enables or disables the decoded BRR sample cache (disabled by default, not part of the state).
+  // The cache outputs identical audio, it only speeds up songs that decode the same looping
+  // samples with the same history again and again.
+  auto set_brr_cache_enabled(bool enabled) -> void;
+
+  // Enables or disables the S-DSP logic only mode (disabled by default, not part of the state).
+  // The S-SMP, the S-DSP registers, KON/KOFF latching and the echo buffer writes are emulated, the
+  // voices are silent and not decoded (ENVX, OUTX and the ENDX end bits are not updated).
+  auto set_logic_only(bool enabled) -> void;
 
   auto emulate() -> const std::array<int16_t, AUDIO_BUFFER_SIZE>&;
 
+  // Sets the sample rate of `emulate_resampled()` (8000 to 192000 Hz) and how the 32000 Hz S-DSP
+  // output is interpolated.  Linear and Cubic are cheap enough for live playback, Sinc (a 32 tap
+  // windowed sinc) is intended for offline renders.
+  // Returns false (and leaves the resampler unchanged) if `rate` is out of range.
+  // Clears the resampler history.  The resampler is copied with the emulator, it is not part of
+  // the save state.
+  auto set_output_sample_rate(uint32_t rate, ResamplerQuality quality) -> bool;
+  auto output_sample_rate() const -> uint32_t;
+
+  // Emulates as many samples as required to write `frames` interleaved stereo samples at the
+  // output sample rate to `out`.
+  // `out` must hold at least `frames * 2` samples.
+  auto emulate_resampled(int16_t* out, size_t frames) -> void;
+
+  // Drops the voices in `mask` (bit n = voice n) from the main and echo output without changing
+  // the audio driver's behaviour (debug feature, not part of the save state).
+  // If `skip_interpolation` is set muted voices are not interpolated, which also silences their
+  // OUTX register and the pitch modulation of the next voice.
+  auto set_voice_mute_mask(uint8_t mask, bool skip_interpolation) -> void;
+
+  // Writes voice `voice`'s output (after the voice volume, before mixing) to a ring buffer of `frames`
+  // interleaved stereo samples, or disables the tap if `buffer` is null.
+  // `buffer` is owned by the caller and must outlive the tap.  Taps are not copied with the emulator.
+  // Fast forwarded audio is not tapped.
+  auto set_voice_tap(uint8_t voice, int16_t* buffer, size_t frames) -> void;
+
+  // Number of stereo samples written to the voice tap since it was set.
+  auto voice_tap_position(uint8_t voice) const -> uint64_t;
+
+  // Enables or disables the S-SMP profiler, which adds the S-SMP clocks spent executing each
+  // instruction to a 64K-entry histogram indexed by the instruction's address.
+  // Enabling the profiler clears the histogram.  The histogram is not copied with the emulator.
+  auto set_profiler_enabled(bool enabled) -> void;
+
+  // The profiler histogram (S-SMP clocks per instruction address), empty if the profiler is disabled.
+  auto profile() const -> rust::Slice<const uint64_t>;
+
+  // Enables or disables the Audio-RAM access map, which records the accesses (bit 0 = read,
+  // bit 1 = write, bit 2 = execute) the S-SMP and S-DSP make to each Audio-RAM byte.
+  // Ignored unless the emulator was built with SHVC_SOUND_EMU_ACCESS_MAP.
+  // Enabling the access map clears it.  The access map is copied with the emulator.
+  auto set_access_map_enabled(bool enabled) -> void;
+
+  // The access map (one byte per Audio-RAM address), empty if the access map is disabled.
+  auto access_map() const -> rust::Slice<const uint8_t>;
+
+  // Records the first S-DSP echo buffer write to the Audio-RAM addresses `first` to `last`
+  // (inclusive), replacing the previous guard and hit.  The writes are not blocked.
+  auto set_echo_guard(uint16_t first, uint16_t last) -> void;
+  auto clear_echo_guard() -> void;
+
+  // Returns the first guarded echo buffer write since the guard was set or the previous
+  // `take_echo_guard_hit()` call (`hit` is false if there was none), then rearms the guard.
+  auto take_echo_guard_hit() -> EchoGuardHit;
+
+  // Adds a watchpoint on the Audio-RAM addresses `first` to `last` (inclusive).
+  // `kinds` is a bitmask of the accesses to watch (bit 0 = read, bit 1 = write, bit 2 = execute).
+  // Instruction fetches are reads, execute watchpoints are tested against the opcode address.
+  // Only the pages containing a read or write watchpoint are slowed down.
+  auto add_watchpoint(uint16_t first, uint16_t last, uint8_t kinds) -> void;
+  auto clear_watchpoints() -> void;
+
+  // Records the last `capacity` watchpoint hits in a ring buffer (0 only counts the hits).
+  // Previously recorded hits are discarded.
+  auto set_watchpoint_log_size(size_t capacity) -> void;
+  // Returns (oldest first) and clears the recorded hits that have not been overwritten.
+  auto take_watchpoint_hits() -> rust::Vec<WatchpointHit>;
+  // Watchpoint hits since the log size was set (including overwritten hits).
+  auto watchpoint_hit_count() const -> uint64_t;
+
+  // Records the last `entries` (rounded up to a power of two) executed instructions in a ring buffer
+  // (0 disables the trace).  Previously recorded instructions are discarded.
+  // The trace is not copied with the emulator.
+  auto set_trace_size(size_t entries) -> void;
+  // Returns the recorded instructions (oldest first) that have not been overwritten.
+  auto trace() const -> rust::Vec<TraceEntry>;
+  // Instructions recorded since the trace size was set (including overwritten instructions).
+  auto trace_count() const -> uint64_t;
+
+  // Disassembles the instruction at `address` in Audio-RAM (or the IPL ROM if it is enabled).
+  auto disassemble(uint16_t address) const -> rust::String;
+
+  // Starts a GDB remote protocol server on `port` (localhost) that debugs this emulator.
+  // Only one emulator can be debugged at a time, debugger commands are processed by the emulate
+  // and run calls, which block while the debugger has halted the S-SMP.
+  // Returns false if the server could not be started or the emulator was built without
+  // SHVC_SOUND_EMU_GDB_SERVER.
+  auto start_gdb_server(uint16_t port) -> bool;
+  auto stop_gdb_server() -> void;
+
+  // Returns the peak and RMS levels of every voice and of the main output since the previous
+  // `meters()` call, then resets them.
+  // Fast forwarded audio is not metered.
+  auto meters() -> AudioMeters;
+
+  // Returns the number of keyons and decoded BRR blocks of each source number (the voice's SRCN
+  // at KON) since the previous `take_source_usage()` call, then resets them.
+  auto take_source_usage() -> SourceUsage;
+
+  // Returns the number of samples saturated by each mixer stage since the previous `take_clipping()`
+  // call, then resets them.
+  auto take_clipping() -> ClippingCounters;
+
+  // Writes `frames` interleaved stereo samples to `out`.
+  // `out` must hold at least `frames * 2` samples.
+  auto emulate_into(int16_t* out, size_t frames) -> void;
+
+  // Writes the left and right channels of `frames` samples to `left` and `right`.
+  // `left` and `right` must each hold at least `frames` samples.
+  auto emulate_planar_into(int16_t* left, int16_t* right, size_t frames) -> void;
+
+  // Writes `frames` samples downmixed to mono (the average of both channels, rounded down) to `out`.
+  // `out` must hold at least `frames` samples.
+  auto emulate_mono_into(int16_t* out, size_t frames) -> void;
+
+  // Emulates `bins * bin_frames` samples and writes the minimum and maximum sample (of both channels)
+  // of every `bin_frames` samples to `out`, without storing the samples.
+  // `out` must hold at least `bins * 2` samples.  Nothing is emulated if `bin_frames` is 0.
+  auto emulate_waveform_overview(int16_t* out, size_t bins, uint32_t bin_frames) -> void;
+
+  // Emulates until `frames` stereo samples have been written to `out` or `max_smp_clocks` have
+  // elapsed (overshooting by at most one instruction), whichever comes first.
+  // Returns the number of stereo samples written.
+  // A partially emulated sample is completed by the next emulate call.
+  auto emulate_for(int16_t* out, size_t frames, uint64_t max_smp_clocks) -> size_t;
+
+  // Emulates at least `smp_clocks` S-SMP clocks without mixing or outputting audio.
+  // Returns the number of S-SMP clocks emulated.
+  auto fast_forward(uint64_t smp_clocks) -> uint64_t;
+
+  // Emulates S-SMP instructions until the program counter is `pc` or `max_smp_clocks` have elapsed.
+  // The program counter is tested on instruction boundaries.
+  // Audio is not mixed or output (see `fast_forward()`).
+  auto run_until_pc(uint16_t pc, uint64_t max_smp_clocks) -> RunResult;
+
+  // Emulates S-SMP instructions until the program counter reaches `tick_pc` `ticks` times or
+  // `max_smp_clocks` have elapsed.
+  // A `tick_pc` hit only counts as a tick if timer 0 has output since the previous tick
+  // (or since the call), so a driver routine that is called once per timer tick can be stepped
+  // one tick at a time.  `tick_pc` must not be inside an idle loop, idle loops are skipped.
+  // Stops on the instruction boundary at `tick_pc`.
+  // Audio is not mixed or output (see `fast_forward()`).
+  auto run_ticks(uint32_t ticks, uint16_t tick_pc, uint64_t max_smp_clocks) -> RunResult;
+
+  // Emulates S-SMP instructions until the S-SMP writes to a CPUIO port in `port_mask`
+  // (bit 0 = $f4, bit 3 = $f7) or `max_smp_clocks` have elapsed.
+  // Stops on the instruction boundary after the write.
+  // Audio is not mixed or output (see `fast_forward()`).
+  auto run_until_port_write(uint8_t port_mask, uint64_t max_smp_clocks) -> RunResult;
+
+  // Emulates S-SMP instructions until a watchpoint is hit or `max_smp_clocks` have elapsed.
+  // Stops on the instruction boundary after the access.
+  // Audio is not mixed or output (see `fast_forward()`).
+  auto run_until_watchpoint(uint64_t max_smp_clocks) -> RunResult;
+
+  // Emulates `smp_clocks` S-SMP clocks (rounded up to the next sample) and streams the audio to a
+  // 16 bit stereo WAV file at `path` ("-" writes to stdout).
+  // If `stop_after_silence` is non-zero, rendering stops after that many consecutive silent samples.
+  // Streamed output that stops early keeps the header length of the entire render.
+  auto render_to_file(rust::Str path, uint64_t smp_clocks, uint32_t stop_after_silence) -> RenderResult;
+
 private:
+  static auto serializeState(serializer& s, SMP& smp) -> void;
+  auto beginRun() -> void;
+  auto emulateSamples() -> void;
+
   SMP smp;
+  OutputResampler resampler;
 };
 
 auto new_emulator(const std::array<uint8_t, 64>& iplrom) -> std::unique_ptr<ShvcSoundEmu>;
+auto clone_emulator(const ShvcSoundEmu& emu) -> std::unique_ptr<ShvcSoundEmu>;
+
+// Disassembles a traced instruction
+auto disassemble_trace_entry(const TraceEntry& entry) -> rust::String;
+
+// Traces the S-DSP envelope of each config from key-on for `samples` samples (see
+// `DSP::traceEnvelopes()`).  Returns `samples` envelope levels per config (config-major).
+auto trace_envelopes(rust::Slice<const EnvelopeTraceConfig> configs, uint32_t samples) -> rust::Vec<uint16_t>;
+
+// Tests each BRR sample for the gaussian overflow glitch at its pitches (see
+// `DSP::scanGaussianOverflow()`), using `n_threads` worker threads (0 = one per CPU core).
+// The results are in the same order as `scans`.
+auto scan_gaussian_overflow(rust::Slice<const GaussianOverflowScan> scans, uint32_t n_threads) -> rust::Vec<bool>;
+
+// The instruction set of the runtime selected kernels (see `SimdKernels`)
+auto simd_level() -> SimdLevel;
+// Selects the kernels of `level`, returns false if it is not supported by the host CPU
+auto set_simd_level(SimdLevel level) -> bool;
+
+// Runs each job on a new emulator, using `n_threads` worker threads (0 = one per CPU core).
+// The results are in the same order as `jobs`.
+auto run_emulator_jobs(rust::Slice<const EmulatorJob> jobs, uint32_t n_threads) -> rust::Vec<EmulatorJobResult>;
+
+// As `run_emulator_jobs()`, but each job's Audio-RAM is `base_apuram` (missing bytes are zero)
+// overwritten by the job's `apuram`.
+auto run_emulator_jobs_with_base(rust::Slice<const uint8_t> base_apuram, rust::Slice<const EmulatorJob> jobs, uint32_t n_threads) -> rust::Vec<EmulatorJobResult>;
+
+// Renders each job from the save state `state` until the output is silent and every `watches`
+// value is idle (see `SfxRenderPool`), using `n_threads` worker threads (0 = one per CPU core).
+// The results are in the same order as `jobs`.
+auto render_sound_effects(rust::Slice<const uint8_t> state, rust::Slice<const IdleWatch> watches, const SfxRenderSettings& settings, rust::Slice<const SfxRenderJob> jobs, uint32_t n_threads) -> rust::Vec<SfxRenderResult>;
 
 }
+
+#include "async-emulator.hpp"
+#include "loader-harness.hpp"
+#include "shared-state-view.hpp"
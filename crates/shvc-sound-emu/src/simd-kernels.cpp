@@ -0,0 +1,202 @@
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_AMD64))
+  #include <intrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+  #include <arm_neon.h>
+#endif
+
+//GCC and Clang only allow AVX2 intrinsics in functions that target AVX2, MSVC allows them anywhere
+#if defined(__GNUC__) || defined(__clang__)
+  #define SHVC_SOUND_EMU_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+  #define SHVC_SOUND_EMU_TARGET_AVX2
+#endif
+
+#if defined(__SSE2__) || defined(_M_AMD64)
+  #define SHVC_SOUND_EMU_SIMD_X86
+#endif
+
+namespace shvc_sound_emu {
+
+static_assert(SimdKernels::SincTaps == OutputResampler::SincTaps);
+static_assert(SimdKernels::SincTaps % 8 == 0);
+
+namespace simd_scalar {
+
+static auto sincDotProducts(const float* h, const float* row, float* out) -> void {
+  constexpr u32 Taps = SimdKernels::SincTaps;
+
+  for(u32 r : range(2)) {
+    float sum[8] = {};
+    for(u32 k = 0; k < Taps; k += 8) {
+      for(u32 j : range(8)) sum[j] += h[k + j] * row[r * Taps + k + j];
+    }
+    const float s0 = sum[0] + sum[4], s1 = sum[1] + sum[5], s2 = sum[2] + sum[6], s3 = sum[3] + sum[7];
+    out[r] = (s0 + s2) + (s1 + s3);
+  }
+}
+
+static constexpr SimdKernels kernels = {
+  sincDotProducts,
+};
+
+}
+
+#if defined(SHVC_SOUND_EMU_SIMD_X86)
+namespace simd_sse2 {
+
+//adds the four sums pairwise, in the same order as the scalar kernel
+static inline auto reduce(__m128 s) -> float {
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 1, 1, 1)));
+  return _mm_cvtss_f32(s);
+}
+
+static auto sincDotProducts(const float* h, const float* row, float* out) -> void {
+  constexpr u32 Taps = SimdKernels::SincTaps;
+
+  for(u32 r : range(2)) {
+    const float* k = row + r * Taps;
+    __m128 lo = _mm_setzero_ps(), hi = _mm_setzero_ps();
+    for(u32 i = 0; i < Taps; i += 8) {
+      lo = _mm_add_ps(lo, _mm_mul_ps(_mm_loadu_ps(h + i + 0), _mm_loadu_ps(k + i + 0)));
+      hi = _mm_add_ps(hi, _mm_mul_ps(_mm_loadu_ps(h + i + 4), _mm_loadu_ps(k + i + 4)));
+    }
+    out[r] = reduce(_mm_add_ps(lo, hi));
+  }
+}
+
+static constexpr SimdKernels kernels = {
+  sincDotProducts,
+};
+
+}
+
+namespace simd_avx2 {
+
+SHVC_SOUND_EMU_TARGET_AVX2
+static auto sincDotProducts(const float* h, const float* row, float* out) -> void {
+  constexpr u32 Taps = SimdKernels::SincTaps;
+
+  //the multiply and add are not fused (FMA is a separate extension), as in the other kernels
+  __m256 a = _mm256_setzero_ps(), b = _mm256_setzero_ps();
+  for(u32 i = 0; i < Taps; i += 8) {
+    const __m256 x = _mm256_loadu_ps(h + i);
+    a = _mm256_add_ps(a, _mm256_mul_ps(x, _mm256_loadu_ps(row + i)));
+    b = _mm256_add_ps(b, _mm256_mul_ps(x, _mm256_loadu_ps(row + Taps + i)));
+  }
+  out[0] = simd_sse2::reduce(_mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1)));
+  out[1] = simd_sse2::reduce(_mm_add_ps(_mm256_castps256_ps128(b), _mm256_extractf128_ps(b, 1)));
+}
+
+static constexpr SimdKernels kernels = {
+  sincDotProducts,
+};
+
+}
+
+static auto cpuSupportsAvx2() -> bool {
+  #if defined(__GNUC__) || defined(__clang__)
+  //also tests that the OS saves the AVX registers
+  //(the CPU model must be initialised manually as this is called by a static initializer)
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+  #elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if(info[0] < 7) return false;
+  __cpuid(info, 1);
+  const bool osxsave = info[2] & (1 << 27), avx = info[2] & (1 << 28);
+  if(!osxsave || !avx) return false;
+  //the OS must save the SSE and AVX registers on a context switch
+  if((_xgetbv(0) & 6) != 6) return false;
+  __cpuidex(info, 7, 0);
+  return info[1] & (1 << 5);
+  #else
+  return false;
+  #endif
+}
+#endif
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+namespace simd_neon {
+
+static auto sincDotProducts(const float* h, const float* row, float* out) -> void {
+  constexpr u32 Taps = SimdKernels::SincTaps;
+
+  for(u32 r : range(2)) {
+    const float* k = row + r * Taps;
+    float32x4_t lo = vdupq_n_f32(0.0f), hi = vdupq_n_f32(0.0f);
+    for(u32 i = 0; i < Taps; i += 8) {
+      lo = vaddq_f32(lo, vmulq_f32(vld1q_f32(h + i + 0), vld1q_f32(k + i + 0)));
+      hi = vaddq_f32(hi, vmulq_f32(vld1q_f32(h + i + 4), vld1q_f32(k + i + 4)));
+    }
+    const float32x4_t s = vaddq_f32(lo, hi);
+    const float32x2_t p = vadd_f32(vget_low_f32(s), vget_high_f32(s));
+    out[r] = vget_lane_f32(p, 0) + vget_lane_f32(p, 1);
+  }
+}
+
+static constexpr SimdKernels kernels = {
+  sincDotProducts,
+};
+
+}
+#endif
+
+static auto simdKernelsFor(SimdLevel level) -> const SimdKernels* {
+  switch(level) {
+  case SimdLevel::Scalar:
+    return &simd_scalar::kernels;
+  #if defined(SHVC_SOUND_EMU_SIMD_X86)
+  case SimdLevel::Sse2:
+    return &simd_sse2::kernels;
+  case SimdLevel::Avx2:
+    return cpuSupportsAvx2() ? &simd_avx2::kernels : nullptr;
+  #endif
+  #if defined(__ARM_NEON) || defined(_M_ARM64)
+  case SimdLevel::Neon:
+    //NEON is part of the arm64 baseline and there are no optional extensions in use yet,
+    //so the hwcaps do not need to be read
+    return &simd_neon::kernels;
+  #endif
+  default:
+    return nullptr;
+  }
+}
+
+auto detectSimdLevel() -> SimdLevel {
+  #if defined(SHVC_SOUND_EMU_SIMD_X86)
+  return cpuSupportsAvx2() ? SimdLevel::Avx2 : SimdLevel::Sse2;
+  #elif defined(__ARM_NEON) || defined(_M_ARM64)
+  return SimdLevel::Neon;
+  #else
+  return SimdLevel::Scalar;
+  #endif
+}
+
+static std::atomic<SimdLevel> activeSimdLevel{detectSimdLevel()};
+static std::atomic<const SimdKernels*> activeSimdKernels{simdKernelsFor(activeSimdLevel.load())};
+
+auto simdKernels() -> const SimdKernels& {
+  return *activeSimdKernels.load(std::memory_order_relaxed);
+}
+
+auto simd_level() -> SimdLevel {
+  return activeSimdLevel.load(std::memory_order_relaxed);
+}
+
+auto set_simd_level(SimdLevel level) -> bool {
+  const SimdKernels* kernels = simdKernelsFor(level);
+  if(!kernels) return false;
+
+  activeSimdLevel.store(level, std::memory_order_relaxed);
+  activeSimdKernels.store(kernels, std::memory_order_relaxed);
+  return true;
+}
+
+}
+
+#undef SHVC_SOUND_EMU_TARGET_AVX2
+#undef SHVC_SOUND_EMU_SIMD_X86
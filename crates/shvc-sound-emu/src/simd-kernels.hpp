@@ -0,0 +1,32 @@
+#pragma once
+
+namespace shvc_sound_emu {
+
+enum class SimdLevel : uint8_t;
+
+// Bulk kernels that are selected at runtime from the instruction sets supported by the host CPU,
+// so a library built for the baseline target still uses AVX2 when it is available.
+//
+// The per-sample S-DSP kernels (voice mixing, echo FIR, gaussian interpolation) are too small to
+// be called through a function pointer and are selected at compile time (SSE2 and NEON are part
+// of the amd64 and arm64 baselines).
+//
+// Every implementation of a kernel returns bit-identical results to the scalar reference.
+struct SimdKernels {
+  constexpr static uint32_t SincTaps = 32;
+
+  // Dot products of `SincTaps` history samples `h` with the kernel rows `row[0..SincTaps]` (out[0])
+  // and `row[SincTaps..SincTaps*2]` (out[1]).
+  //
+  // The taps are summed in eight partial sums (tap `k` is added to sum `k % 8`), which are then
+  // added pairwise, so the vector kernels produce exactly the same result as the scalar kernel.
+  void (*sincDotProducts)(const float* h, const float* row, float* out);
+};
+
+// The kernels selected by `set_simd_level()` or (by default) the best the host CPU supports
+auto simdKernels() -> const SimdKernels&;
+
+// The best instruction set supported by the host CPU (and this build)
+auto detectSimdLevel() -> SimdLevel;
+
+}
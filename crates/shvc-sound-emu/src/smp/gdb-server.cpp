@@ -0,0 +1,170 @@
+//GDB remote protocol stub (nall/gdb), only built if SHVC_SOUND_EMU_GDB_SERVER is defined
+//
+//registers (in 'g' packet order, little endian): pc (16 bits), a, x, y, sp, psw
+//breakpoints (Z0, Z1) are tested by GDB::server.reportPC() before every instruction while a client is connected.
+//watchpoints (Z2-Z4) are added to the S-SMP watchpoints, so only accesses to watched pages are tested.
+//while halted the S-SMP does not advance and the emulate call that halted blocks until the debugger resumes.
+
+namespace {
+  SMP* gdbTarget = nullptr;
+  bool gdbWatchpointsDirty = false;
+  bool gdbHadClient = false;
+}
+
+auto SMP::gdbServerStart(u16 port) -> bool {
+  if(gdbTarget) return gdbTarget == this;
+
+  auto& server = GDB::server;
+  server.reset();
+
+  server.hooks.read = [this](u64 address, u32 byteCount) -> string {
+    string out;
+    for(u64 a = address; a < address + byteCount && a <= 0xffff; a++) out.append(hex(gdbRead(a), 2, '0'));
+    return out;
+  };
+
+  server.hooks.write = [this](u64 address, u32 unitSize, u64 value) {
+    //the most significant byte of value is the first byte in memory
+    for(u32 i : range(unitSize)) {
+      if(address + i > 0xffff) break;
+      dsp.apuram[address + i] = value >> (unitSize - 1 - i) * 8;
+      dsp.dirtyPages[(address + i) >> 8] = true;
+    }
+  };
+
+  server.hooks.regRead = [this](u32 regIdx) -> string {
+    switch(regIdx) {
+    case 0: return {hex(r.pc.byte.l, 2, '0'), hex(r.pc.byte.h, 2, '0')};
+    case 1: return hex(r.ya.byte.l, 2, '0');
+    case 2: return hex(r.x, 2, '0');
+    case 3: return hex(r.ya.byte.h, 2, '0');
+    case 4: return hex(r.s, 2, '0');
+    case 5: return hex((u32)r.p, 2, '0');
+    }
+    return "00";
+  };
+
+  server.hooks.regReadGeneral = [this]() -> string {
+    string out;
+    for(u32 n : range(6)) out.append(GDB::server.hooks.regRead(n));
+    return out;
+  };
+
+  server.hooks.regWrite = [this](u32 regIdx, u64 regValue) -> bool {
+    switch(regIdx) {
+    //the hex string is in memory order
+    case 0: r.pc.byte.l = regValue >> 8; r.pc.byte.h = regValue; return true;
+    case 1: r.ya.byte.l = regValue; return true;
+    case 2: r.x = regValue; return true;
+    case 3: r.ya.byte.h = regValue; return true;
+    case 4: r.s = regValue; return true;
+    case 5: r.p = (n8)regValue; return true;
+    }
+    return false;
+  };
+
+  server.hooks.regWriteGeneral = [this](const string& regData) {
+    if(regData.size() < 14) return;
+    GDB::server.hooks.regWrite(0, regData.slice(0, 4).hex());
+    for(u32 n : range(1, 6)) GDB::server.hooks.regWrite(n, regData.slice(2 + n * 2, 2).hex());
+  };
+
+  //called after every breakpoint or watchpoint change
+  server.hooks.emuCacheInvalidate = [](u64) {
+    gdbWatchpointsDirty = true;
+  };
+
+  if(!server.open(port, true)) {
+    server.reset();
+    return false;
+  }
+
+  gdbTarget = this;
+  gdbHadClient = false;
+  return true;
+}
+
+auto SMP::gdbServerStop() -> void {
+  if(gdbTarget != this) return;
+
+  GDB::server.close();
+  GDB::server.reset();
+  gdbTarget = nullptr;
+
+  gdbWatchpoints.clear();
+  watchpointsChanged();
+}
+
+auto SMP::gdbServerAttached() const -> bool {
+  return gdbTarget == this;
+}
+
+auto SMP::gdbCopied() -> void {
+  gdbWatchpoints.clear();
+  watchpointsChanged();
+}
+
+//processes the debugger's commands (called before every run)
+auto SMP::gdbUpdate() -> void {
+  if(gdbTarget != this) return;
+
+  auto& server = GDB::server;
+  server.updateLoop();
+
+  //the server clears the breakpoints and watchpoints on connect and disconnect
+  if(server.hasClient() != gdbHadClient) {
+    gdbHadClient = server.hasClient();
+    gdbWatchpointsDirty = true;
+  }
+  if(gdbWatchpointsDirty) gdbSyncWatchpoints();
+}
+
+//returns false (after the debugger resumes) if the debugger halted before the next instruction
+inline auto SMP::gdbReportPC() -> bool {
+  if(gdbTarget != this || !GDB::server.hasClient()) return true;
+
+  //idle loops are not skipped while a debugger is connected (every instruction is tested for breakpoints)
+  idleLoop.sideEffects = true;
+
+  if(GDB::server.reportPC(r.pc.w)) return true;
+
+  do {
+    gdbUpdate();
+  } while(GDB::server.isHalted() && GDB::server.hasClient());
+
+  //the debugger may have modified the registers or memory
+  dsp.updateSharedPages();
+  resetIdleLoop();
+  return false;
+}
+
+auto SMP::gdbSyncWatchpoints() -> void {
+  gdbWatchpointsDirty = false;
+
+  gdbWatchpoints.clear();
+  auto add = [&](const GDB::Watchpoint& w, u8 kind) {
+    if(w.addressStart > 0xffff || w.addressEnd < w.addressStart) return;
+    gdbWatchpoints.push_back({(u16)w.addressStart, (u16)min(w.addressEnd, 0xffff), kind});
+  };
+  for(const auto& w : GDB::server.getWatchpointsRead()) add(w, WatchRead);
+  for(const auto& w : GDB::server.getWatchpointsWrite()) add(w, WatchWrite);
+
+  watchpointsChanged();
+}
+
+auto SMP::gdbWatchpointAccess(n16 address, u8 kind) -> void {
+  for(const auto& w : gdbWatchpoints) {
+    if(!(w.kinds & kind) || address < w.first || address > w.last) continue;
+
+    //halts before the next instruction
+    if(kind == WatchRead) GDB::server.reportMemRead(address, 1);
+    if(kind == WatchWrite) GDB::server.reportMemWrite(address, 1);
+    idleLoop.sideEffects = true;
+    return;
+  }
+}
+
+auto SMP::gdbRead(n16 address) const -> n8 {
+  if(address >= 0xffc0 && io.iplromEnable) return iplrom[address & 0x3f];
+  return dsp.apuram[address];
+}
@@ -0,0 +1,73 @@
+//polling loops (such as the audio driver main loop waiting for a timer tick or a S-CPU command)
+//repeat the exact same iteration until a timer output changes.
+//an iteration is idle if it returns to the loop start with the same registers and has no side effects
+//(no writes, no DSPDATA reads, no non-zero TnOUT reads and no reads from pages shared with the DSP)
+//and the TnOUT registers it reads are still zero.
+//the S-CPU ports only change between emulate calls, which resets the detection.
+//idle iterations are skipped by advancing the clocks in bulk.
+
+//called after every instruction that moved the program counter backwards
+inline auto SMP::idleLoopBranch() -> void {
+  auto& l = idleLoop;
+  if(idleLoopSkipUntil <= timing.clock || !dsp.fastPaths) {
+    l.observing = false;
+    return;
+  }
+
+  if(l.observing && !l.sideEffects) {
+    if(r.pc.w == l.pc) {
+      if(r.ya.w == l.ya && r.x == l.x && r.s == l.s && (u32)r.p == l.p) {
+        skipIdleLoop(timing.clock - l.clock, timing.timerClock - l.timerClock, timing.instructions - l.instructions);
+      }
+    } else if(timing.clock - l.clock < IdleLoopMaxClocks) {
+      return;  //an inner loop of the observed iteration
+    }
+  }
+
+  l.observing = true;
+  l.sideEffects = false;
+  l.timersRead = 0;
+  l.pc = r.pc.w;
+  l.ya = r.ya.w;
+  l.x = r.x;
+  l.s = r.s;
+  l.p = r.p;
+  l.clock = timing.clock;
+  l.timerClock = timing.timerClock;
+  l.instructions = timing.instructions;
+}
+
+inline auto SMP::skipIdleLoop(u64 clocks, u64 timerClocks, u64 instructions) -> void {
+  //do not exceed the caller's limit, the next scheduled port write or the DSP batch size
+  const u64 until = min(idleLoopSkipUntil, portQueue.next);
+  if(until <= timing.clock) return;
+  u64 iterations = min(until - timing.clock, (u64)(DSPBatchClocks - timing.dspClocks)) / clocks;
+  if(!iterations) return;
+
+  //every skipped iteration must read the same (zero) TnOUT values
+  synchronizeTimers();
+  auto limit = [&](const auto& timer, u32 n) {
+    if(!idleLoop.timersRead.bit(n)) return;
+    if(timer.stage3) iterations = 0;
+    else iterations = min(iterations, (timer.eventClocks(*this) - 1) / timerClocks);
+  };
+  limit(timer0, 0);
+  limit(timer1, 1);
+  limit(timer2, 2);
+  if(!iterations) return;
+
+  timing.clock += iterations * clocks;
+  timing.dspClocks += iterations * clocks;
+  timing.timerClock += iterations * timerClocks;
+  timing.instructions += iterations * instructions;
+  if(timing.dspClocks >= DSPBatchClocks) synchronizeDSP();
+}
+
+//the earliest number of timer clocks until stage 3 increments (~0 if it cannot increment)
+template<u32 Frequency> auto SMP::Timer<Frequency>::eventClocks(const SMP& smp) const -> u64 {
+  if(!enable || !smp.io.timersEnable || smp.io.timersDisable) return ~0ull;
+
+  u64 pulse = stage1 ? Frequency - stage0 : 2 * Frequency - stage0;
+  u64 pulses = n8(target - stage2 - 1) + 1;
+  return pulse + (pulses - 1) * 2 * Frequency;
+}
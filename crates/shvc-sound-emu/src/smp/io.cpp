@@ -7,12 +7,104 @@ auto SMP::portRead(n2 port) const -> n8 {
 }
 
 auto SMP::portWrite(n2 port, n8 data) -> void {
+  if(port == 0 && ioLatency.enabled && data != io.apu0) ioLatency.commandWritten(data, timing.clock);
+
   if(port == 0) io.apu0 = data;
   if(port == 1) io.apu1 = data;
   if(port == 2) io.apu2 = data;
   if(port == 3) io.apu3 = data;
 }
 
+auto SMP::portWritten(n2 port) const -> n8 {
+  if(port == 0) return io.apu0;
+  if(port == 1) return io.apu1;
+  if(port == 2) return io.apu2;
+  if(port == 3) return io.apu3;
+  unreachable;
+}
+
+auto SMP::schedulePortWrite(u64 clock, const std::array<u8, 4>& ports) -> void {
+  auto& writes = portQueue.writes;
+  auto it = std::upper_bound(writes.begin(), writes.end(), clock, [](u64 c, const auto& w) { return c < w.clock; });
+  writes.insert(it, {clock, ports});
+  portQueue.next = writes.front().clock;
+}
+
+auto SMP::clearScheduledPortWrites() -> void {
+  portQueue = {};
+}
+
+auto SMP::applyScheduledPortWrites() -> void {
+  auto& writes = portQueue.writes;
+  while(!writes.empty() && writes.front().clock <= timing.clock) {
+    for(u32 n : range(4)) portWrite(n, writes.front().ports[n]);
+    writes.pop_front();
+  }
+  portQueue.next = writes.empty() ? ~0ull : writes.front().clock;
+
+  //the ports only change between idle loop iterations
+  resetIdleLoop();
+}
+
+auto SMP::LatencyHistogram::add(u64 clocks) -> void {
+  count++;
+  total += clocks;
+  min = std::min(min, clocks);
+  max = std::max(max, clocks);
+
+  u32 bucket = 0;
+  while(bucket < Buckets - 1 && clocks >> (bucket + 1)) bucket++;
+  buckets[bucket]++;
+}
+
+auto SMP::IOLatency::commandWritten(n8 data, u64 clock) -> void {
+  if(waitingAck) unacknowledged++;
+
+  command = data;
+  written = clock;
+  waitingAck = true;
+  waitingKeyOn = (data & keyOnMask) == keyOnCommand;
+}
+
+auto SMP::IOLatency::acknowledged(u64 clock) -> void {
+  ack.add(clock - written);
+  waitingAck = false;
+}
+
+auto SMP::IOLatency::keyedOn(u64 clock) -> void {
+  keyOn.add(clock - written);
+  waitingKeyOn = false;
+}
+
+//restores the $00f1-$00ff registers from a RAM snapshot (such as a .spc file), without any side effects
+//`registers` points to the $00f0-$00ff bytes of the snapshot ($00f0 is not restored)
+//$00f4-$00f7 are the values the S-SMP reads from the CPUIO ports
+auto SMP::loadIO(const uint8_t* registers) -> void {
+  const n8 control = registers[0x01];
+
+  io.iplromEnable = control.bit(7);
+  io.dspAddress = registers[0x02];
+  io.apu0 = registers[0x04];
+  io.apu1 = registers[0x05];
+  io.apu2 = registers[0x06];
+  io.apu3 = registers[0x07];
+  io.aux4 = registers[0x08];
+  io.aux5 = registers[0x09];
+
+  auto load = [&](auto& timer, u32 n) {
+    timer.enable = control.bit(n);
+    timer.target = registers[0x0a + n];
+    timer.stage2 = 0;
+    timer.stage3 = registers[0x0d + n] & 0x0f;
+  };
+  synchronizeTimers();
+  load(timer0, 0);
+  load(timer1, 1);
+  load(timer2, 2);
+
+  updatePages();
+}
+
 inline auto SMP::readIO(n16 address) -> n8 {
   n8 data;
 
@@ -27,6 +119,8 @@ inline auto SMP::readIO(n16 address) -> n8 {
     return io.dspAddress;
 
   case 0xf3:  //DSPDATA
+    synchronizeDSP();
+    idleLoop.sideEffects = true;
     //0x80-0xff are read-only mirrors of 0x00-0x7f
     return dsp.read(io.dspAddress);
 
@@ -58,18 +152,28 @@ inline auto SMP::readIO(n16 address) -> n8 {
     return 0x00;
 
   case 0xfd:  //T0OUT (4-bit counter value)
+    synchronizeTimers();
     data = timer0.stage3;
     timer0.stage3 = 0;
+    idleLoop.timersRead |= 1 << 0;
+    if(data) idleLoop.sideEffects = true;
+    if(data && dsp.logEvents) dsp.eventLog.push_back({dsp.clocks(), DSP::EventTick, (u8)data, 0, 0});
     return data;
 
   case 0xfe:  //T1OUT (4-bit counter value)
+    synchronizeTimers();
     data = timer1.stage3;
     timer1.stage3 = 0;
+    idleLoop.timersRead |= 1 << 1;
+    if(data) idleLoop.sideEffects = true;
     return data;
 
   case 0xff:  //T2OUT (4-bit counter value)
+    synchronizeTimers();
     data = timer2.stage3;
     timer2.stage3 = 0;
+    idleLoop.timersRead |= 1 << 2;
+    if(data) idleLoop.sideEffects = true;
     return data;
   }
 
@@ -81,12 +185,14 @@ inline auto SMP::writeIO(n16 address, n8 data) -> void {
   case 0xf0:  //TEST
     if(r.p.p) break;  //writes only valid when P flag is clear
 
+    synchronizeTimers();
     io.timersDisable      = data.bit(0);
     io.ramWritable        = data.bit(1);
     io.ramDisable         = data.bit(2);
     io.timersEnable       = data.bit(3);
     io.externalWaitStates = data.bit(4,5);
     io.internalWaitStates = data.bit(6,7);
+    updatePages();
 
     timer0.synchronizeStage1(*this);
     timer1.synchronizeStage1(*this);
@@ -94,6 +200,8 @@ inline auto SMP::writeIO(n16 address, n8 data) -> void {
     break;
 
   case 0xf1:  //CONTROL
+    synchronizeTimers();
+
     //0->1 transistion resets timers
     if(timer0.enable.raise(data.bit(0))) {
       timer0.stage2 = 0;
@@ -123,6 +231,7 @@ inline auto SMP::writeIO(n16 address, n8 data) -> void {
     }
 
     io.iplromEnable = data.bit(7);
+    updatePages();
     break;
 
   case 0xf2:  //DSPADDR
@@ -131,27 +240,38 @@ inline auto SMP::writeIO(n16 address, n8 data) -> void {
 
   case 0xf3:  //DSPDATA
     if(io.dspAddress.bit(7)) break;  //0x80-0xff are read-only mirrors of 0x00-0x7f
+    synchronizeDSP();
     dsp.write(io.dspAddress, data);
+    if(io.dspAddress == 0x4c && data && ioLatency.waitingKeyOn) ioLatency.keyedOn(timing.clock);
+    //VxSRCN, DIR, ESA and EDL move the pages the DSP accesses
+    if(dsp.fastPaths && ((io.dspAddress & 0x0f) == 0x04 || io.dspAddress == 0x5d || io.dspAddress == 0x6d || io.dspAddress == 0x7d)) {
+      dsp.updateSharedPages();
+    }
     break;
 
   case 0xf4:  //CPUIO0
     // no S-CPU to synchronize with
     io.cpu0 = data;
+    portsWritten.bit(0) = 1;
+    if(ioLatency.waitingAck && data == ioLatency.command) ioLatency.acknowledged(timing.clock);
     break;
 
   case 0xf5:  //CPUIO1
     // no S-CPU to synchronize with
     io.cpu1 = data;
+    portsWritten.bit(1) = 1;
     break;
 
   case 0xf6:  //CPUIO2
     // no S-CPU to synchronize with
     io.cpu2 = data;
+    portsWritten.bit(2) = 1;
     break;
 
   case 0xf7:  //CPUIO3
     // no S-CPU to synchronize with
     io.cpu3 = data;
+    portsWritten.bit(3) = 1;
     break;
 
   case 0xf8:  //AUXIO4
@@ -163,14 +283,17 @@ inline auto SMP::writeIO(n16 address, n8 data) -> void {
     break;
 
   case 0xfa:  //T0TARGET
+    synchronizeTimers();
     timer0.target = data;
     break;
 
   case 0xfb:  //T1TARGET
+    synchronizeTimers();
     timer1.target = data;
     break;
 
   case 0xfc:  //T2TARGET
+    synchronizeTimers();
     timer2.target = data;
     break;
 
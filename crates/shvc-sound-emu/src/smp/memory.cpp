@@ -1,4 +1,67 @@
-inline auto SMP::readRAM(n16 address) -> n8 {
+auto SMP::updatePages() -> void {
+  static const auto disabledRAM = [] {
+    std::array<uint8_t, 256> page;
+    page.fill(0x5a);  //0xff on mini-SNES
+    return page;
+  }();
+
+  for(u32 n : range(256)) {
+    auto& page = pages[n];
+    page.read  = io.ramDisable ? disabledRAM.data() : &dsp.apuram[n << 8];
+    page.write = io.ramWritable && !io.ramDisable ? &dsp.apuram[n << 8] : discardedWrites.data();
+    page.ioStart = 0x100;
+    page.waitStates = io.externalWaitStates;
+  }
+  pages[0x00].ioStart = 0xf0;
+  if(io.iplromEnable) pages[0xff].ioStart = 0xc0;
+
+  //while the DSP is logging, every access takes the slow path so apuram writes can be logged
+  if(dsp.logWrites) for(auto& page : pages) page.ioStart = 0;
+
+  //while the access map is enabled, every access takes the slow path so it can be marked
+  if(AccessMap::enabled && !dsp.accessMap.empty()) for(auto& page : pages) page.ioStart = 0;
+
+  //accesses to watched pages take the slow path so they can be tested against the watchpoints
+  for(u32 n : range(256)) {
+    if(watch.pages[n] & (WatchRead | WatchWrite)) pages[n].ioStart = 0;
+  }
+
+  codePage.page = 0x100;
+}
+
+auto SMP::watchpointsChanged() -> void {
+  watch.pages = {};
+  for(const auto& w : watch.watchpoints) {
+    for(u32 n = w.first >> 8; n <= (u32)w.last >> 8; n++) watch.pages[n] |= w.kinds;
+  }
+  #if defined(SHVC_SOUND_EMU_GDB_SERVER)
+  for(const auto& w : gdbWatchpoints) {
+    for(u32 n = w.first >> 8; n <= (u32)w.last >> 8; n++) watch.pages[n] |= w.kinds;
+  }
+  #endif
+  updatePages();
+}
+
+auto SMP::watchpointAccess(n16 address, u8 kind, n8 data) -> void {
+  #if defined(SHVC_SOUND_EMU_GDB_SERVER)
+  gdbWatchpointAccess(address, kind);
+  #endif
+
+  for(const auto& w : watch.watchpoints) {
+    if(!(w.kinds & kind) || address < w.first || address > w.last) continue;
+
+    if(!watch.hits.empty()) {
+      watch.hits[watch.hitCount % watch.hits.size()] = {timing.clock, watch.pc, address, kind, data};
+    }
+    watch.hitCount++;
+    watch.hit = true;
+    //idle loops that access a watchpoint are not skipped, so every access is recorded
+    idleLoop.sideEffects = true;
+    return;
+  }
+}
+
+inline auto SMP::readRAM(n16 address) const -> n8 {
   if(address >= 0xffc0 && io.iplromEnable) return iplrom[address & 0x3f];
   if(io.ramDisable) return 0x5a;  //0xff on mini-SNES
   return dsp.apuram[address];
@@ -6,7 +69,10 @@ inline auto SMP::readRAM(n16 address) -> n8 {
 
 inline auto SMP::writeRAM(n16 address, n8 data) -> void {
   //writes to $ffc0-$ffff always go to apuram, even if the iplrom is enabled
-  if(io.ramWritable && !io.ramDisable) dsp.apuram[address] = data;
+  if(io.ramWritable && !io.ramDisable) {
+    dsp.apuram[address] = data;
+    if(dsp.logWrites) dsp.apuramLog.push_back({dsp.clocks(), (u16)address, (u8)data});
+  }
 }
 
 auto SMP::idle() -> void {
@@ -14,28 +80,96 @@ auto SMP::idle() -> void {
 }
 
 auto SMP::read(n16 address) -> n8 {
+  const Page& page = pages[address >> 8];
+  const bool shared = dsp.sharedPages[address >> 8];
+  if((n8)address < page.ioStart && !shared) {
+    waitCycle(page.waitStates, 0);
+    return page.read[(n8)address];
+  }
+
+  n8 data;
   if((address & 0xfffc) == 0x00f4) {
     //reads from $00f4-$00f7 require more time than internal reads
     wait(1, address);
-    n8 data = readRAM(address);
+    if(shared) {
+      synchronizeDSP();
+      idleLoop.sideEffects = true;
+    }
+    data = readRAM(address);
     if((address & 0xfff0) == 0x00f0) data = readIO(address);
     wait(1, address);
-    return data;
   } else {
     wait(0, address);
-    n8 data = readRAM(address);
+    if(shared) {
+      synchronizeDSP();
+      idleLoop.sideEffects = true;
+    }
+    data = readRAM(address);
     if((address & 0xfff0) == 0x00f0) data = readIO(address);
+  }
+  if constexpr(Instrumentation::enabled) {
+    if(watch.pages[address >> 8] & WatchRead) watchpointAccess(address, WatchRead, data);
+  }
+  if constexpr(AccessMap::enabled) {
+    dsp.markAccess(address, fetchingCode ? DSP::AccessExecute : DSP::AccessRead);
+  }
+  return data;
+}
+
+//code fetches have the same result and timing as read()
+//while the program counter stays within codePage, the memory map lookup is skipped
+inline auto SMP::readCode(n16 address) -> n8 {
+  if((address >> 8) == codePage.page && !dsp.sharedPages[codePage.page]) {
+    step(codePage.clocks);
+    timing.timerClock += codePage.timerClocks;
+    return codePage.data[(n8)address];
+  }
+  return readCodeSlow(address);
+}
+
+auto SMP::readCodeSlow(n16 address) -> n8 {
+  const u32 n = address >> 8;
+  const Page& page = pages[n];
+  if(dsp.fastPaths && page.ioStart == 0x100 && !dsp.sharedPages[n]) {
+    codePage.page = n;
+    codePage.data = page.read;
+    codePage.clocks = CycleWaitStates[page.waitStates];
+    codePage.timerClocks = TimerWaitStates[page.waitStates];
+  }
+  if constexpr(AccessMap::enabled) {
+    fetchingCode = true;
+    n8 data = read(address);
+    fetchingCode = false;
     return data;
   }
+  return read(address);
 }
 
 auto SMP::write(n16 address, n8 data) -> void {
+  const Page& page = pages[address >> 8];
+  const bool shared = dsp.sharedPages[address >> 8];
+  idleLoop.sideEffects = true;
+  dsp.dirtyPages[address >> 8] = true;
+  if((n8)address < page.ioStart && !shared) {
+    waitCycle(page.waitStates, 0);
+    page.write[(n8)address] = data;
+    return;
+  }
+
   wait(0, address);
+  if(shared) synchronizeDSP();
   writeRAM(address, data);  //even IO writes affect underlying RAM
   if((address & 0xfff0) == 0x00f0) writeIO(address, data);
+  if(shared && dsp.fastPaths && dsp.sharedPagesDependOn(address)) dsp.updateSharedPages();  //the write moved a sample
+  if constexpr(Instrumentation::enabled) {
+    if(watch.pages[address >> 8] & WatchWrite) watchpointAccess(address, WatchWrite, data);
+  }
+  if constexpr(AccessMap::enabled) {
+    dsp.markAccess(address, DSP::AccessWrite);
+  }
 }
 
-auto SMP::readDisassembler(n16 address) -> n8 {
+auto SMP::readDisassembler(n16 address) const -> n8 {
   if((address & 0xfff0) == 0x00f0) return 0x00;
   return readRAM(address);
 }
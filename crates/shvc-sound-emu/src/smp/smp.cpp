@@ -3,13 +3,71 @@ namespace shvc_sound_emu {
 #include "memory.cpp"
 #include "io.cpp"
 #include "timing.cpp"
+#include "idle-loop.cpp"
+#include "serialization.cpp"
+#if defined(SHVC_SOUND_EMU_GDB_SERVER)
+#include "gdb-server.cpp"
+#endif
 
 auto SMP::main() -> void {
-  // ::TODO verify Wait and Stop will advance the DSP::
-  if(r.wait) return instructionWait();
-  if(r.stop) return instructionStop();
+  if(timing.clock >= portQueue.next) applyScheduledPortWrites();
 
+  #if defined(SHVC_SOUND_EMU_GDB_SERVER)
+  if(!gdbReportPC()) return;
+  #endif
+
+  if constexpr(!Instrumentation::enabled) {
+    return execute();
+  } else {
+    if(profile.empty() && watch.watchpoints.empty() && trace.entries.empty()) return execute();
+
+    const n16 pc = r.pc.w;
+    const u64 clock = timing.clock;
+    if(!trace.entries.empty() && !r.wait && !r.stop) {
+      auto& t = trace.entries[trace.count++ & (trace.entries.size() - 1)];
+      t.clock = clock;
+      t.pc = pc;
+      t.bytes = {readDisassembler(pc), readDisassembler(pc + 1), readDisassembler(pc + 2)};
+      t.a = r.ya.byte.l;
+      t.x = r.x;
+      t.y = r.ya.byte.h;
+      t.s = r.s;
+      t.p = r.p;
+    }
+    watch.pc = pc;
+    if(watch.pages[pc >> 8] & WatchExecute && !r.wait && !r.stop) {
+      watchpointAccess(pc, WatchExecute, readDisassembler(pc));
+    }
+    execute();
+    if(!profile.empty()) profile[pc] += timing.clock - clock;
+  }
+}
+
+inline auto SMP::execute() -> void {
+  if(halted()) return executeHalted();
+
+  n16 pc = r.pc.w;
+  timing.instructions++;
   instruction();
+  if(timing.dspClocks >= DSPBatchClocks) synchronizeDSP();
+  if(r.pc.w <= pc) idleLoopBranch();
+}
+
+//every iteration of SLEEP and STOP reads the same byte and there are no interrupts to exit them,
+//so the iterations are skipped in bulk (with the same limits as an idle loop skip)
+inline auto SMP::executeHalted() -> void {
+  const u64 clock = timing.clock;
+  const u64 timerClock = timing.timerClock;
+  if(r.wait) instructionWait();
+  else instructionStop();
+  if(timing.dspClocks >= DSPBatchClocks) synchronizeDSP();
+
+  //the program counter is not in a page with IO registers or shared with the DSP
+  if(dsp.fastPaths && codePage.page == r.pc.w >> 8 && idleLoopSkipUntil > timing.clock) {
+    idleLoop.observing = false;
+    idleLoop.timersRead = 0;
+    skipIdleLoop(timing.clock - clock, timing.timerClock - timerClock, 0);
+  }
 }
 
 auto SMP::power(bool reset) -> void {
@@ -20,10 +78,19 @@ auto SMP::power(bool reset) -> void {
   r.pc.byte.l = iplrom[62];
   r.pc.byte.h = iplrom[63];
 
+  timing = {};
   io = {};
+  portsWritten = 0;
   timer0 = {};
   timer1 = {};
   timer2 = {};
+  idleLoop = {};
+  portQueue = {};
+  ioLatency.waitingAck = false;
+  ioLatency.waitingKeyOn = false;
+
+  updatePages();
+  dsp.updateSharedPages();
 }
 
 }
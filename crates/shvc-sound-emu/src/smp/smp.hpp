@@ -2,24 +2,195 @@
 
 namespace shvc_sound_emu {
 
-struct SMP : SPC700 {
+struct SMP final : SPC700 {
   // ::TODO find out what this does::
-  auto synchronizing() const -> bool override { return false; }
+  auto synchronizing() const -> bool { return false; }
 
   auto main() -> void;
   auto power(bool reset) -> void;
 
+  //serialization.cpp
+  auto serialize(serializer&) -> void;
+
+  //number of clocks emulated since power (2 clocks per S-SMP cycle)
+  auto clock() const -> u64 { return timing.clock; }
+
+  //number of instructions executed since power (including skipped idle loop iterations)
+  auto instructions() const -> u64 { return timing.instructions; }
+
+  //true if the S-SMP has executed SLEEP or STOP (it will not execute another instruction until reset)
+  auto halted() const -> bool { return r.wait || r.stop; }
+
+  //number of timer 0 outputs (stage 3 increments) since power, synchronizes the timers
+  auto timer0Outputs() -> u64 { synchronizeTimers(); return timer0.outputs; }
+
+  //the DSP is stepped in batches of at least DSPBatchClocks (tested after every instruction)
+  //or when the SMP accesses a DSP register or a page in dsp.sharedPages
+  static constexpr u32 DSPBatchClocks = 1024;
+  //longest instruction (DIV, 12 cycles of 20 clocks)
+  static constexpr u32 MaxInstructionClocks = 12 * 20;
+  //maximum number of samples the DSP can output in one batch
+  static constexpr u32 DSPBatchSamples = (DSPBatchClocks + MaxInstructionClocks + 63) / 64;
+  static_assert(DSPBatchSamples < DSP::SharedPagesWindow);
+
+  //idle loops are not skipped past this clock (set by the caller, 0 disables skipping)
+  u64 idleLoopSkipUntil = 0;
+
+  //timing.cpp
+  auto synchronizeDSP() -> void;
+  auto synchronizeTimers() -> void;
+
+  //when not empty, the clocks spent executing each instruction are added to profile[pc]
+  //(skipped idle loop iterations are added to the loop's backward branch, not part of the state)
+  std::vector<u64> profile;
+
+  //reads memory without side effects ($00f0-$00ff read as 0, memory.cpp)
+  auto readDisassembler(n16 address) const -> n8;
+
+  //instruction trace (not part of the state)
+  //when not empty, every executed instruction is recorded in a ring buffer before it is executed
+  //(skipped idle loop iterations are not recorded)
+  struct TraceEntry {
+    u64 clock;
+    u16 pc;
+    std::array<u8, 3> bytes;  //opcode and operand bytes
+    u8  a, x, y, s, p;
+  };
+  struct Trace {
+    std::vector<TraceEntry> entries;  //ring buffer, the size is a power of two
+    u64 count = 0;                    //instructions recorded since the ring buffer was resized
+  } trace;
+
+  //memory watchpoints (not part of the state)
+  //pages containing a read or write watchpoint take the slow path of read() and write(),
+  //accesses to other pages (and instructions while no watchpoints are set) are not slowed down
+  enum : u8 { WatchRead = 1, WatchWrite = 2, WatchExecute = 4 };
+  struct Watchpoint {
+    u16 first;
+    u16 last;  //inclusive
+    u8  kinds;
+  };
+  struct WatchpointHit {
+    u64 clock;
+    u16 pc;       //address of the instruction that accessed the watchpoint
+    u16 address;
+    u8  kind;
+    u8  data;     //byte read, byte written or opcode executed
+  };
+  struct Watch {
+    std::vector<Watchpoint> watchpoints;
+    std::array<u8, 256> pages = {};   //kinds watched in each page
+    std::vector<WatchpointHit> hits;  //ring buffer, hits[hitCount % hits.size()] is written next
+    u64 hitCount = 0;                 //hits since the ring buffer was resized
+    u64 hitsTaken = 0;                //hitCount when the host last took the hits
+    bool hit = false;                 //set on every hit, cleared by the caller
+    n16 pc;                           //address of the instruction being executed
+  } watch;
+
+  //must be called after watch.watchpoints changes
+  auto watchpointsChanged() -> void;
+
+  #if defined(SHVC_SOUND_EMU_GDB_SERVER)
+  //gdb-server.cpp
+  //only one SMP can be debugged at a time (nall::GDB::server is a singleton)
+  auto gdbServerStart(u16 port) -> bool;
+  auto gdbServerStop() -> void;
+  auto gdbServerAttached() const -> bool;
+  auto gdbUpdate() -> void;
+  //must be called after copying the SMP (the debugger stays attached to the source)
+  auto gdbCopied() -> void;
+  #endif
+
+  //must be called before emulating if the caller changed the emulator state
+  auto resetIdleLoop() -> void { idleLoop.observing = false; }
+
+  //must be called after copying the SMP (the memory map points into the source's apuram)
+  auto copied() -> void { updatePages(); }
+
+  //must be called after dsp.logWrites changes
+  auto loggingChanged() -> void { updatePages(); }
+
+  //must be called after dsp.fastPaths changes
+  auto fastPathsChanged() -> void { updatePages(); }
+
+  //must be called after dsp.accessMap is enabled or disabled
+  auto accessMapChanged() -> void { updatePages(); }
+
   //memory.cpp
-  auto write(n16 address, n8 data) -> void override;
+  auto write(n16 address, n8 data) -> void;
 
   //io.cpp
   auto portRead(n2 port) const -> n8;
   auto portWrite(n2 port, n8 data) -> void;
+  //the value last written to the S-CPU to S-SMP port (read without side effects)
+  auto portWritten(n2 port) const -> n8;
+  auto loadIO(const uint8_t* registers) -> void;
+
+  //S-CPU port writes applied before the first instruction at or after their clock
+  //(sorted by clock, cleared on power, not part of the state)
+  struct ScheduledPortWrite {
+    u64 clock;
+    std::array<u8, 4> ports;
+  };
+  auto schedulePortWrite(u64 clock, const std::array<u8, 4>& ports) -> void;
+  auto clearScheduledPortWrites() -> void;
+  auto scheduledPortWrites() const -> size_t { return portQueue.writes.size(); }
 
-  DSP dsp;
   std::array<uint8_t, 64> iplrom;
 
+  //bitmask of the CPUIO ports ($f4-$f7) written by the S-SMP (cleared by the caller)
+  n4 portsWritten;
+
+  //IO command latency (not part of the state, io.cpp)
+  //while enabled, every S-CPU write that changes port 0 starts a measurement that ends when the
+  //S-SMP writes the same value to CPUIO0 (ack) and, if (command & keyOnMask) == keyOnCommand,
+  //at the next non-zero KON write (keyOn); a new command abandons the previous measurement
+  struct LatencyHistogram {
+    //bucket n counts latencies of [2^n, 2^(n+1)) clocks, bucket 0 includes 0
+    static constexpr u32 Buckets = 24;
+    u64 count = 0;
+    u64 total = 0;
+    u64 min = ~0ull;
+    u64 max = 0;
+    std::array<u32, Buckets> buckets = {};
+
+    auto add(u64 clocks) -> void;
+  };
+  struct IOLatency {
+    bool enabled = false;
+    u8 keyOnMask = 0;
+    u8 keyOnCommand = 0;
+
+    n8 command;
+    u64 written = 0;  //clock of the port 0 write
+    bool waitingAck = false;
+    bool waitingKeyOn = false;
+
+    LatencyHistogram ack;
+    LatencyHistogram keyOn;
+    u64 unacknowledged = 0;  //commands replaced before they were acknowledged
+
+    auto commandWritten(n8 data, u64 clock) -> void;
+    auto acknowledged(u64 clock) -> void;
+    auto keyedOn(u64 clock) -> void;
+  } ioLatency;
+
 private:
+  struct PortQueue {
+    std::deque<ScheduledPortWrite> writes;
+    u64 next = ~0ull;  //clock of the first write
+  } portQueue;
+
+  auto applyScheduledPortWrites() -> void;
+
+  struct Timing {
+    u64 clock = 0;
+    u64 timerClock = 0;         //clocks fed to the timers since power
+    u64 timersSynchronized = 0; //timerClock the timers have been stepped to
+    u32 dspClocks = 0;          //clocks the DSP is behind the SMP
+    u64 instructions = 0;       //not part of the state
+  } timing;
+
   struct IO {
     //timing
     u32 clockCounter = 0;
@@ -56,14 +227,71 @@ private:
     n8 aux5;
   } io;
 
+  //memory map, one descriptor per 256-byte page
+  //(rebuilt by updatePages() whenever $00f0 or $00f1 is written)
+  struct Page {
+    const uint8_t* read;
+    uint8_t* write;
+    u32 ioStart;     //offset of the first IO register or IPLROM byte in the page (0x100 if none)
+    u32 waitStates;  //wait states of RAM accesses
+  };
+  std::array<Page, 256> pages;
+  std::array<uint8_t, 256> discardedWrites;  //write target of pages while the RAM is not writable
+
+  //fast path (not part of the state): the page of plain RAM the program counter is in
+  //while code is fetched from it, readCode() skips the memory map and wait state lookups
+  //the bytes are read from apuram on every fetch, so writes to code never leave stale code
+  //(invalidated by updatePages(), pages shared with the DSP are tested on every fetch)
+  struct CodePage {
+    u32 page = 0x100;  //0x100 if invalid
+    const uint8_t* data = nullptr;
+    u32 clocks = 0;
+    u32 timerClocks = 0;
+  } codePage;
+
+  //the loop iteration being observed by the idle loop detection
+  static constexpr u32 IdleLoopMaxClocks = 1024;
+  struct IdleLoop {
+    bool observing = false;
+    bool sideEffects = false;
+    n3 timersRead;  //bitmask of the TnOUT registers read
+    n16 pc;
+    n16 ya;
+    n8 x;
+    n8 s;
+    n8 p;
+    u64 clock;
+    u64 timerClock;
+    u64 instructions;
+  } idleLoop;
+
+  auto execute() -> void;
+  auto executeHalted() -> void;
+
   //memory.cpp
-  auto readRAM(n16 address) -> n8;
+  auto updatePages() -> void;
+  auto readRAM(n16 address) const -> n8;
   auto writeRAM(n16 address, n8 data) -> void;
 
-  auto idle() -> void override;
-  auto read(n16 address) -> n8 override;
+  auto idle() -> void;
+  auto read(n16 address) -> n8;
+  auto readCode(n16 address) -> n8;
+  auto readCodeSlow(n16 address) -> n8;
+
+  //set while readCodeSlow() reads an instruction byte (to mark it as executed in dsp.accessMap)
+  bool fetchingCode = false;
 
-  auto readDisassembler(n16 address) -> n8 override;
+  auto watchpointAccess(n16 address, u8 kind, n8 data) -> void;
+
+  #if defined(SHVC_SOUND_EMU_GDB_SERVER)
+  //gdb-server.cpp
+  //Z2-Z4 watchpoints (reported to the debugger, not recorded in watch.hits)
+  std::vector<Watchpoint> gdbWatchpoints;
+  auto gdbReportPC() -> bool;
+  auto gdbSyncWatchpoints() -> void;
+  auto gdbWatchpointAccess(n16 address, u8 kind) -> void;
+  auto gdbRead(n16 address) const -> n8;
+  #endif
 
   //io.cpp
   auto readIO(n16 address) -> n8;
@@ -78,20 +306,50 @@ private:
     b1 line;
     b1 enable;
     n8 target;
+    u64 outputs;  //stage 3 increments since power (not part of the state)
 
     //timing.cpp
-    auto step(const SMP& smp, u32 clocks) -> void;
+    auto step(const SMP& smp, u64 clocks) -> void;
     auto synchronizeStage1(const SMP& smp) -> void;
+
+    //idle-loop.cpp
+    auto eventClocks(const SMP& smp) const -> u64;
+
+    //serialization.cpp
+    auto serialize(serializer&) -> void;
   };
 
   Timer<128> timer0;
   Timer<128> timer1;
   Timer< 16> timer2;
 
+  //clocks and timer clocks of a cycle with {0, 1, 2, 3} wait states (see timing.cpp)
+  static constexpr u32 CycleWaitStates[4] = {2, 4, 10, 20};
+  static constexpr u32 TimerWaitStates[4] = {2, 4,  8, 16};
+
   //timing.cpp
   auto wait(bool halve, maybe<n16> address = nothing) -> void;
+  auto waitCycle(u32 waitStates, bool halve) -> void;
   auto step(u32 clocks) -> void;
-  auto stepTimers(u32 clocks) -> void;
+
+  //idle-loop.cpp
+  auto idleLoopBranch() -> void;
+  auto skipIdleLoop(u64 clocks, u64 timerClocks, u64 instructions) -> void;
+
+  friend struct SPC700;
+
+public:
+  //declared last so the SPC700 registers, IO, memory map and timers are contiguous
+  //and are followed by the DSP's hot state (see dsp.hpp)
+  DSP dsp;
 };
 
+//the SMP is the only SPC700 bus, so the bus accessors are direct (inlinable) calls instead of virtual calls
+inline auto SPC700::idle() -> void { return static_cast<SMP*>(this)->idle(); }
+inline auto SPC700::read(n16 address) -> n8 { return static_cast<SMP*>(this)->read(address); }
+inline auto SPC700::readCode(n16 address) -> n8 { return static_cast<SMP*>(this)->readCode(address); }
+inline auto SPC700::write(n16 address, n8 data) -> void { return static_cast<SMP*>(this)->write(address, data); }
+inline auto SPC700::synchronizing() const -> bool { return static_cast<const SMP*>(this)->synchronizing(); }
+inline auto SPC700::readDisassembler(n16 address) -> n8 { return static_cast<SMP*>(this)->readDisassembler(address); }
+
 }
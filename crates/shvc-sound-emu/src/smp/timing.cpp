@@ -7,37 +7,59 @@
 //other times (and more likely), the SMP will deadlock until the system is reset
 //the timers are not affected by this and advance by their expected values
 inline auto SMP::wait(bool halve, maybe<n16> address) -> void {
-  static constexpr u32 cycleWaitStates[4] = {2, 4, 10, 20};
-  static constexpr u32 timerWaitStates[4] = {2, 4,  8, 16};
-
   u32 waitStates = io.externalWaitStates;
   if(!address) waitStates = io.internalWaitStates;  //idle cycles
   else if((*address & 0xfff0) == 0x00f0) waitStates = io.internalWaitStates;  //IO registers
   else if(*address >= 0xffc0 && io.iplromEnable) waitStates = io.internalWaitStates;  //IPLROM
 
-  step(cycleWaitStates[waitStates] >> halve);
-  stepTimers(timerWaitStates[waitStates] >> halve);
+  waitCycle(waitStates, halve);
+}
+
+inline auto SMP::waitCycle(u32 waitStates, bool halve) -> void {
+  step(CycleWaitStates[waitStates] >> halve);
+  timing.timerClock += TimerWaitStates[waitStates] >> halve;
 }
 
+//in lockstep mode the DSP is stepped every cycle,
+//otherwise it is stepped in batches at the end of an instruction (see execute())
 inline auto SMP::step(u32 clocks) -> void {
-  dsp.smpStepped(clocks);
+  timing.clock += clocks;
+  timing.dspClocks += clocks;
+  if(!dsp.fastPaths) synchronizeDSP();
 }
 
-inline auto SMP::stepTimers(u32 clocks) -> void {
+inline auto SMP::synchronizeDSP() -> void {
+  if(timing.dspClocks) {
+    dsp.smpStepped(timing.dspClocks);
+    timing.dspClocks = 0;
+  }
+  if(dsp.fastPaths) dsp.refreshSharedPages(DSPBatchSamples);
+}
+
+//the timers are only observable through the timer registers,
+//so they are stepped lazily, when $00f0, $00f1 or $00fa-$00ff are accessed
+inline auto SMP::synchronizeTimers() -> void {
+  u64 clocks = timing.timerClock - timing.timersSynchronized;
+  if(!clocks) return;
+  timing.timersSynchronized = timing.timerClock;
+
   timer0.step(*this, clocks);
   timer1.step(*this, clocks);
   timer2.step(*this, clocks);
 }
 
-template<u32 Frequency> auto SMP::Timer<Frequency>::step(const SMP& smp, u32 clocks) -> void {
+//equivalent to stepping the timer one cycle at a time
+//(a cycle never advances stage 0 by more than Frequency, so stage 1 toggles at most once per cycle)
+template<u32 Frequency> auto SMP::Timer<Frequency>::step(const SMP& smp, u64 clocks) -> void {
   //stage 0 increment
-  stage0 += clocks;
-  if(stage0 < Frequency) return;
-  stage0 -= Frequency;
+  u64 total = stage0 + clocks;
+  stage0 = total % Frequency;
 
   //stage 1 increment
-  stage1 ^= 1;
-  synchronizeStage1(smp);
+  for(u64 toggles = total / Frequency; toggles; toggles--) {
+    stage1 ^= 1;
+    synchronizeStage1(smp);
+  }
 }
 
 template<u32 Frequency> auto SMP::Timer<Frequency>::synchronizeStage1(const SMP& smp) -> void {
@@ -53,4 +75,5 @@ template<u32 Frequency> auto SMP::Timer<Frequency>::synchronizeStage1(const SMP&
   //stage 3 increment
   stage2 = 0;
   stage3++;
+  outputs++;
 }
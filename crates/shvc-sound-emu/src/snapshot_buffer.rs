@@ -0,0 +1,138 @@
+//! Lock-free latest value buffer
+
+// SPDX-FileCopyrightText: © 2024 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+use std::cell::UnsafeCell;
+use std::sync::atomic::{AtomicU8, Ordering};
+use std::sync::Arc;
+
+const INDEX_MASK: u8 = 0b011;
+const FRESH_BIT: u8 = 0b100;
+
+/// A triple buffer.
+///
+/// At any time one slot is owned by the writer, one slot is owned by the reader and the third
+/// (`back`) slot holds the most recently published value.
+/// Publishing and reading swap slot ownership with a single atomic operation, neither side waits
+/// for the other.
+struct Shared<T> {
+    slots: [UnsafeCell<T>; 3],
+
+    /// Index of the back slot, `FRESH_BIT` is set if the back slot was written after the last read
+    back: AtomicU8,
+}
+
+// SAFETY: A slot is only accessed by the writer or reader that owns its index and ownership is
+// transferred with AcqRel `back` swaps.
+unsafe impl<T: Send> Sync for Shared<T> {}
+
+/// The producer half of a `snapshot_buffer()`
+pub struct SnapshotWriter<T> {
+    shared: Arc<Shared<T>>,
+    index: u8,
+}
+
+/// The consumer half of a `snapshot_buffer()`
+pub struct SnapshotReader<T> {
+    shared: Arc<Shared<T>>,
+    index: u8,
+}
+
+/// Creates a wait-free single-producer single-consumer buffer that holds the most recently
+/// written value.
+///
+/// Intended for publishing state (ie, a `MonitorSnapshot`) from the audio thread to the GUI
+/// thread.  Values written faster than they are read are dropped.
+pub fn snapshot_buffer<T: Default + Send>() -> (SnapshotWriter<T>, SnapshotReader<T>) {
+    let shared = Arc::new(Shared {
+        slots: Default::default(),
+        back: AtomicU8::new(1),
+    });
+
+    (
+        SnapshotWriter {
+            shared: shared.clone(),
+            index: 0,
+        },
+        SnapshotReader { shared, index: 2 },
+    )
+}
+
+impl<T: Send> SnapshotWriter<T> {
+    /// Publishes `value`, replacing the previously written value
+    pub fn write(&mut self, value: T) {
+        // SAFETY: The writer owns `self.index`
+        unsafe {
+            *self.shared.slots[usize::from(self.index)].get() = value;
+        }
+
+        let prev = self
+            .shared
+            .back
+            .swap(self.index | FRESH_BIT, Ordering::AcqRel);
+        self.index = prev & INDEX_MASK;
+    }
+}
+
+impl<T: Send> SnapshotReader<T> {
+    /// Returns true if a value was written after the last `read()` call
+    pub fn has_new_value(&self) -> bool {
+        self.shared.back.load(Ordering::Relaxed) & FRESH_BIT != 0
+    }
+
+    /// Returns the most recently written value
+    /// (or `T::default()` if nothing has been written yet).
+    pub fn read(&mut self) -> &T {
+        if self.has_new_value() {
+            let prev = self.shared.back.swap(self.index, Ordering::AcqRel);
+            self.index = prev & INDEX_MASK;
+        }
+
+        // SAFETY: The reader owns `self.index`
+        unsafe { &*self.shared.slots[usize::from(self.index)].get() }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn reads_latest_value() {
+        let (mut w, mut r) = snapshot_buffer::<u32>();
+
+        assert_eq!(*r.read(), 0);
+
+        w.write(1);
+        w.write(2);
+        assert!(r.has_new_value());
+        assert_eq!(*r.read(), 2);
+        assert!(!r.has_new_value());
+        assert_eq!(*r.read(), 2);
+
+        w.write(3);
+        assert_eq!(*r.read(), 3);
+    }
+
+    #[test]
+    fn threaded() {
+        let (mut w, mut r) = snapshot_buffer::<[u64; 16]>();
+
+        let t = std::thread::spawn(move || {
+            for i in 1..=100_000 {
+                w.write([i; 16]);
+            }
+        });
+
+        let mut last = 0;
+        while last < 100_000 {
+            let v = *r.read();
+            assert!(v.iter().all(|&x| x == v[0]), "torn read");
+            assert!(v[0] >= last);
+            last = v[0];
+        }
+        t.join().unwrap();
+    }
+}
@@ -0,0 +1,110 @@
+//table-driven disassembler
+//operands are '%' followed by the operand type and the index of its first instruction byte:
+//  d = direct page ($12), i = immediate (#$12), a = absolute ($1234), u = upper page ($ff12),
+//  m = absolute bit ($1234.5), r = branch target ($1234)
+//dp,dp and dp,#imm instructions encode the source operand first
+
+static const char* const DisassemblerTable[256] = {
+  "nop",            "tcall 0",        "set1 %d1.0",     "bbs %d1.0,%r2",
+  "or a,%d1",       "or a,%a1",       "or a,(x)",       "or a,[%d1+x]",
+  "or a,%i1",       "or %d2,%d1",     "or1 c,%m1",      "asl %d1",
+  "asl %a1",        "push p",         "tset1 %a1",      "brk",
+  "bpl %r1",        "tcall 1",        "clr1 %d1.0",     "bbc %d1.0,%r2",
+  "or a,%d1+x",     "or a,%a1+x",     "or a,%a1+y",     "or a,[%d1]+y",
+  "or %d2,%i1",     "or (x),(y)",     "decw %d1",       "asl %d1+x",
+  "asl a",          "dec x",          "cmp x,%a1",      "jmp [%a1+x]",
+  "clrp",           "tcall 2",        "set1 %d1.1",     "bbs %d1.1,%r2",
+  "and a,%d1",      "and a,%a1",      "and a,(x)",      "and a,[%d1+x]",
+  "and a,%i1",      "and %d2,%d1",    "or1 c,/%m1",     "rol %d1",
+  "rol %a1",        "push a",         "cbne %d1,%r2",   "bra %r1",
+  "bmi %r1",        "tcall 3",        "clr1 %d1.1",     "bbc %d1.1,%r2",
+  "and a,%d1+x",    "and a,%a1+x",    "and a,%a1+y",    "and a,[%d1]+y",
+  "and %d2,%i1",    "and (x),(y)",    "incw %d1",       "rol %d1+x",
+  "rol a",          "inc x",          "cmp x,%d1",      "call %a1",
+  "setp",           "tcall 4",        "set1 %d1.2",     "bbs %d1.2,%r2",
+  "eor a,%d1",      "eor a,%a1",      "eor a,(x)",      "eor a,[%d1+x]",
+  "eor a,%i1",      "eor %d2,%d1",    "and1 c,%m1",     "lsr %d1",
+  "lsr %a1",        "push x",         "tclr1 %a1",      "pcall %u1",
+  "bvc %r1",        "tcall 5",        "clr1 %d1.2",     "bbc %d1.2,%r2",
+  "eor a,%d1+x",    "eor a,%a1+x",    "eor a,%a1+y",    "eor a,[%d1]+y",
+  "eor %d2,%i1",    "eor (x),(y)",    "cmpw ya,%d1",    "lsr %d1+x",
+  "lsr a",          "mov x,a",        "cmp y,%a1",      "jmp %a1",
+  "clrc",           "tcall 6",        "set1 %d1.3",     "bbs %d1.3,%r2",
+  "cmp a,%d1",      "cmp a,%a1",      "cmp a,(x)",      "cmp a,[%d1+x]",
+  "cmp a,%i1",      "cmp %d2,%d1",    "and1 c,/%m1",    "ror %d1",
+  "ror %a1",        "push y",         "dbnz %d1,%r2",   "ret",
+  "bvs %r1",        "tcall 7",        "clr1 %d1.3",     "bbc %d1.3,%r2",
+  "cmp a,%d1+x",    "cmp a,%a1+x",    "cmp a,%a1+y",    "cmp a,[%d1]+y",
+  "cmp %d2,%i1",    "cmp (x),(y)",    "addw ya,%d1",    "ror %d1+x",
+  "ror a",          "mov a,x",        "cmp y,%d1",      "reti",
+  "setc",           "tcall 8",        "set1 %d1.4",     "bbs %d1.4,%r2",
+  "adc a,%d1",      "adc a,%a1",      "adc a,(x)",      "adc a,[%d1+x]",
+  "adc a,%i1",      "adc %d2,%d1",    "eor1 c,%m1",     "dec %d1",
+  "dec %a1",        "mov y,%i1",      "pop p",          "mov %d2,%i1",
+  "bcc %r1",        "tcall 9",        "clr1 %d1.4",     "bbc %d1.4,%r2",
+  "adc a,%d1+x",    "adc a,%a1+x",    "adc a,%a1+y",    "adc a,[%d1]+y",
+  "adc %d2,%i1",    "adc (x),(y)",    "subw ya,%d1",    "dec %d1+x",
+  "dec a",          "mov x,sp",       "div ya,x",       "xcn a",
+  "ei",             "tcall 10",       "set1 %d1.5",     "bbs %d1.5,%r2",
+  "sbc a,%d1",      "sbc a,%a1",      "sbc a,(x)",      "sbc a,[%d1+x]",
+  "sbc a,%i1",      "sbc %d2,%d1",    "mov1 c,%m1",     "inc %d1",
+  "inc %a1",        "cmp y,%i1",      "pop a",          "mov (x)+,a",
+  "bcs %r1",        "tcall 11",       "clr1 %d1.5",     "bbc %d1.5,%r2",
+  "sbc a,%d1+x",    "sbc a,%a1+x",    "sbc a,%a1+y",    "sbc a,[%d1]+y",
+  "sbc %d2,%i1",    "sbc (x),(y)",    "movw ya,%d1",    "inc %d1+x",
+  "inc a",          "mov sp,x",       "das a",          "mov a,(x)+",
+  "di",             "tcall 12",       "set1 %d1.6",     "bbs %d1.6,%r2",
+  "mov %d1,a",      "mov %a1,a",      "mov (x),a",      "mov [%d1+x],a",
+  "cmp x,%i1",      "mov %a1,x",      "mov1 %m1,c",     "mov %d1,y",
+  "mov %a1,y",      "mov x,%i1",      "pop x",          "mul ya",
+  "bne %r1",        "tcall 13",       "clr1 %d1.6",     "bbc %d1.6,%r2",
+  "mov %d1+x,a",    "mov %a1+x,a",    "mov %a1+y,a",    "mov [%d1]+y,a",
+  "mov %d1,x",      "mov %d1+y,x",    "movw %d1,ya",    "mov %d1+x,y",
+  "dec y",          "mov a,y",        "cbne %d1+x,%r2", "daa a",
+  "clrv",           "tcall 14",       "set1 %d1.7",     "bbs %d1.7,%r2",
+  "mov a,%d1",      "mov a,%a1",      "mov a,(x)",      "mov a,[%d1+x]",
+  "mov a,%i1",      "mov x,%a1",      "not1 %m1",       "mov y,%d1",
+  "mov y,%a1",      "notc",           "pop y",          "sleep",
+  "beq %r1",        "tcall 15",       "clr1 %d1.7",     "bbc %d1.7,%r2",
+  "mov a,%d1+x",    "mov a,%a1+x",    "mov a,%a1+y",    "mov a,[%d1]+y",
+  "mov x,%d1",      "mov x,%d1+y",    "mov %d2,%d1",    "mov y,%d1+x",
+  "inc y",          "mov y,a",        "dbnz y,%r2",     "stop",
+};
+
+auto SPC700::instructionLength(n8 opcode) -> u32 {
+  u32 length = 1;
+  for(const char* s = DisassemblerTable[opcode]; *s; s++) {
+    if(*s != '%') continue;
+    const bool word = s[1] == 'a' || s[1] == 'm';
+    length = max(length, (u32)(s[2] - '0') + 1 + word);
+    s += 2;
+  }
+  return length;
+}
+
+auto SPC700::disassemble(n16 pc, const std::array<u8, 3>& bytes) -> std::string {
+  const u32 length = instructionLength(bytes[0]);
+
+  std::string out;
+  char buffer[16];
+  for(const char* s = DisassemblerTable[bytes[0]]; *s; s++) {
+    if(*s != '%') {
+      out.push_back(*s);
+      continue;
+    }
+
+    const u32 i = s[2] - '0';
+    const u16 word = bytes[i] | bytes[(i + 1) % 3] << 8;
+    switch(s[1]) {
+    case 'd': snprintf(buffer, sizeof(buffer), "$%02x", bytes[i]); break;
+    case 'i': snprintf(buffer, sizeof(buffer), "#$%02x", bytes[i]); break;
+    case 'a': snprintf(buffer, sizeof(buffer), "$%04x", word); break;
+    case 'u': snprintf(buffer, sizeof(buffer), "$ff%02x", bytes[i]); break;
+    case 'm': snprintf(buffer, sizeof(buffer), "$%04x.%u", word & 0x1fff, word >> 13); break;
+    case 'r': snprintf(buffer, sizeof(buffer), "$%04x", (u16)(pc + length + (s8)bytes[i])); break;
+    }
+    out.append(buffer);
+    s += 2;
+  }
+  return out;
+}
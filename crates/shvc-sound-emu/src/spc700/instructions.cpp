@@ -45,14 +45,14 @@ auto SPC700::instructionAbsoluteBitSet(n3 bit, bool value) -> void {
   store(address, data);
 }
 
-auto SPC700::instructionAbsoluteRead(fpb op, n8& target) -> void {
+template<SPC700::fpb op> auto SPC700::instructionAbsoluteRead(n8& target) -> void {
   n16 address = fetch();
   address |= fetch() << 8;
   n8 data = read(address);
   target = alu(target, data);
 }
 
-auto SPC700::instructionAbsoluteModify(fps op) -> void {
+template<SPC700::fps op> auto SPC700::instructionAbsoluteModify() -> void {
   n16 address = fetch();
   address |= fetch() << 8;
   n8 data = read(address);
@@ -66,7 +66,7 @@ auto SPC700::instructionAbsoluteWrite(n8& data) -> void {
   write(address, data);
 }
 
-auto SPC700::instructionAbsoluteIndexedRead(fpb op, n8& index) -> void {
+template<SPC700::fpb op> auto SPC700::instructionAbsoluteIndexedRead(n8& index) -> void {
   n16 address = fetch();
   address |= fetch() << 8;
   idle();
@@ -136,7 +136,7 @@ auto SPC700::instructionBranchNotDirectIndexed(n8& index) -> void {
 }
 
 auto SPC700::instructionBranchNotYDecrement() -> void {
-  read(PC);
+  readCode(PC);
   idle();
   n8 displacement = fetch();
   if(--Y == 0) return;
@@ -146,7 +146,7 @@ auto SPC700::instructionBranchNotYDecrement() -> void {
 }
 
 auto SPC700::instructionBreak() -> void {
-  read(PC);
+  readCode(PC);
   push(PC >> 8);
   push(PC >> 0);
   push(P);
@@ -179,7 +179,7 @@ auto SPC700::instructionCallPage() -> void {
 }
 
 auto SPC700::instructionCallTable(n4 vector) -> void {
-  read(PC);
+  readCode(PC);
   idle();
   push(PC >> 8);
   push(PC >> 0);
@@ -191,13 +191,13 @@ auto SPC700::instructionCallTable(n4 vector) -> void {
 }
 
 auto SPC700::instructionComplementCarry() -> void {
-  read(PC);
+  readCode(PC);
   idle();
   CF = !CF;
 }
 
 auto SPC700::instructionDecimalAdjustAdd() -> void {
-  read(PC);
+  readCode(PC);
   idle();
   if(CF || A > 0x99) {
     A += 0x60;
@@ -206,12 +206,11 @@ auto SPC700::instructionDecimalAdjustAdd() -> void {
   if(HF || (A & 15) > 0x09) {
     A += 0x06;
   }
-  ZF = A == 0;
-  NF = A & 0x80;
+  P.setNZ(A);
 }
 
 auto SPC700::instructionDecimalAdjustSub() -> void {
-  read(PC);
+  readCode(PC);
   idle();
   if(!CF || A > 0x99) {
     A -= 0x60;
@@ -220,17 +219,16 @@ auto SPC700::instructionDecimalAdjustSub() -> void {
   if(!HF || (A & 15) > 0x09) {
     A -= 0x06;
   }
-  ZF = A == 0;
-  NF = A & 0x80;
+  P.setNZ(A);
 }
 
-auto SPC700::instructionDirectRead(fpb op, n8& target) -> void {
+template<SPC700::fpb op> auto SPC700::instructionDirectRead(n8& target) -> void {
   n8 address = fetch();
   n8 data = load(address);
   target = alu(target, data);
 }
 
-auto SPC700::instructionDirectModify(fps op) -> void {
+template<SPC700::fps op> auto SPC700::instructionDirectModify() -> void {
   n8 address = fetch();
   n8 data = load(address);
   store(address, alu(data));
@@ -242,7 +240,7 @@ auto SPC700::instructionDirectWrite(n8& data) -> void {
   store(address, data);
 }
 
-auto SPC700::instructionDirectDirectCompare(fpb op) -> void {
+template<SPC700::fpb op> auto SPC700::instructionDirectDirectCompare() -> void {
   n8 source = fetch();
   n8 rhs = load(source);
   n8 target = fetch();
@@ -251,7 +249,7 @@ auto SPC700::instructionDirectDirectCompare(fpb op) -> void {
   idle();
 }
 
-auto SPC700::instructionDirectDirectModify(fpb op) -> void {
+template<SPC700::fpb op> auto SPC700::instructionDirectDirectModify() -> void {
   n8 source = fetch();
   n8 rhs = load(source);
   n8 target = fetch();
@@ -267,7 +265,7 @@ auto SPC700::instructionDirectDirectWrite() -> void {
   store(target, data);
 }
 
-auto SPC700::instructionDirectImmediateCompare(fpb op) -> void {
+template<SPC700::fpb op> auto SPC700::instructionDirectImmediateCompare() -> void {
   n8 immediate = fetch();
   n8 address = fetch();
   n8 data = load(address);
@@ -275,7 +273,7 @@ auto SPC700::instructionDirectImmediateCompare(fpb op) -> void {
   idle();
 }
 
-auto SPC700::instructionDirectImmediateModify(fpb op) -> void {
+template<SPC700::fpb op> auto SPC700::instructionDirectImmediateModify() -> void {
   n8 immediate = fetch();
   n8 address = fetch();
   n8 data = load(address);
@@ -290,14 +288,14 @@ auto SPC700::instructionDirectImmediateWrite() -> void {
   store(address, immediate);
 }
 
-auto SPC700::instructionDirectCompareWord(fpw op) -> void {
+template<SPC700::fpw op> auto SPC700::instructionDirectCompareWord() -> void {
   n8 address = fetch();
   n16 data = load(address + 0);
   data |= load(address + 1) << 8;
   YA = alu(YA, data);
 }
 
-auto SPC700::instructionDirectReadWord(fpw op) -> void {
+template<SPC700::fpw op> auto SPC700::instructionDirectReadWord() -> void {
   n8 address = fetch();
   n16 data = load(address + 0);
   idle();
@@ -311,8 +309,7 @@ auto SPC700::instructionDirectModifyWord(s32 adjust) -> void {
   store(address + 0, data >> 0);
   data += load(address + 1) << 8;
   store(address + 1, data >> 8);
-  ZF = data == 0;
-  NF = data & 0x8000;
+  P.setNZ16(data);
 }
 
 auto SPC700::instructionDirectWriteWord() -> void {
@@ -322,14 +319,14 @@ auto SPC700::instructionDirectWriteWord() -> void {
   store(address + 1, Y);
 }
 
-auto SPC700::instructionDirectIndexedRead(fpb op, n8& target, n8& index) -> void {
+template<SPC700::fpb op> auto SPC700::instructionDirectIndexedRead(n8& target, n8& index) -> void {
   n8 address = fetch();
   idle();
   n8 data = load(address + index);
   target = alu(target, data);
 }
 
-auto SPC700::instructionDirectIndexedModify(fps op, n8& index) -> void {
+template<SPC700::fps op> auto SPC700::instructionDirectIndexedModify(n8& index) -> void {
   n8 address = fetch();
   idle();
   n8 data = load(address + index);
@@ -344,7 +341,7 @@ auto SPC700::instructionDirectIndexedWrite(n8& data, n8& index) -> void {
 }
 
 auto SPC700::instructionDivide() -> void {
-  read(PC);
+  readCode(PC);
   idle();
   idle();
   idle();
@@ -370,37 +367,35 @@ auto SPC700::instructionDivide() -> void {
     Y = X   + (ya - (X << 9)) % (256 - X);
   }
   //result is set based on a (quotient) only
-  ZF = A == 0;
-  NF = A & 0x80;
+  P.setNZ(A);
 }
 
 auto SPC700::instructionExchangeNibble() -> void {
-  read(PC);
+  readCode(PC);
   idle();
   idle();
   idle();
   A = A >> 4 | A << 4;
-  ZF = A == 0;
-  NF = A & 0x80;
+  P.setNZ(A);
 }
 
 auto SPC700::instructionFlagSet(bool& flag, bool value) -> void {
-  read(PC);
+  readCode(PC);
   if(&flag == &IF) idle();
   flag = value;
 }
 
-auto SPC700::instructionImmediateRead(fpb op, n8& target) -> void {
+template<SPC700::fpb op> auto SPC700::instructionImmediateRead(n8& target) -> void {
   n8 data = fetch();
   target = alu(target, data);
 }
 
-auto SPC700::instructionImpliedModify(fps op, n8& target) -> void {
-  read(PC);
+template<SPC700::fps op> auto SPC700::instructionImpliedModify(n8& target) -> void {
+  readCode(PC);
   target = alu(target);
 }
 
-auto SPC700::instructionIndexedIndirectRead(fpb op, n8& index) -> void {
+template<SPC700::fpb op> auto SPC700::instructionIndexedIndirectRead(n8& index) -> void {
   n8 indirect = fetch();
   idle();
   n16 address = load(indirect + index + 0);
@@ -418,7 +413,7 @@ auto SPC700::instructionIndexedIndirectWrite(n8& data, n8& index) -> void {
   write(address, data);
 }
 
-auto SPC700::instructionIndirectIndexedRead(fpb op, n8& index) -> void {
+template<SPC700::fpb op> auto SPC700::instructionIndirectIndexedRead(n8& index) -> void {
   n8 indirect = fetch();
   idle();
   n16 address = load(indirect + 0);
@@ -436,42 +431,41 @@ auto SPC700::instructionIndirectIndexedWrite(n8& data, n8& index) -> void {
   write(address + index, data);
 }
 
-auto SPC700::instructionIndirectXRead(fpb op) -> void {
-  read(PC);
+template<SPC700::fpb op> auto SPC700::instructionIndirectXRead() -> void {
+  readCode(PC);
   n8 data = load(X);
   A = alu(A, data);
 }
 
 auto SPC700::instructionIndirectXWrite(n8& data) -> void {
-  read(PC);
+  readCode(PC);
   load(X);
   store(X, data);
 }
 
 auto SPC700::instructionIndirectXIncrementRead(n8& data) -> void {
-  read(PC);
+  readCode(PC);
   data = load(X++);
   idle();  //quirk: consumes extra idle cycle compared to most read instructions
-  ZF = data == 0;
-  NF = data & 0x80;
+  P.setNZ(data);
 }
 
 auto SPC700::instructionIndirectXIncrementWrite(n8& data) -> void {
-  read(PC);
+  readCode(PC);
   idle();  //quirk: not a read cycle as with most write instructions
   store(X++, data);
 }
 
-auto SPC700::instructionIndirectXCompareIndirectY(fpb op) -> void {
-  read(PC);
+template<SPC700::fpb op> auto SPC700::instructionIndirectXCompareIndirectY() -> void {
+  readCode(PC);
   n8 rhs = load(Y);
   n8 lhs = load(X);
   lhs = alu(lhs, rhs);
   idle();
 }
 
-auto SPC700::instructionIndirectXWriteIndirectY(fpb op) -> void {
-  read(PC);
+template<SPC700::fpb op> auto SPC700::instructionIndirectXWriteIndirectY() -> void {
+  readCode(PC);
   n8 rhs = load(Y);
   n8 lhs = load(X);
   lhs = alu(lhs, rhs);
@@ -494,7 +488,7 @@ auto SPC700::instructionJumpIndirectX() -> void {
 }
 
 auto SPC700::instructionMultiply() -> void {
-  read(PC);
+  readCode(PC);
   idle();
   idle();
   idle();
@@ -506,40 +500,39 @@ auto SPC700::instructionMultiply() -> void {
   A = ya >> 0;
   Y = ya >> 8;
   //result is set based on y (high-byte) only
-  ZF = Y == 0;
-  NF = Y & 0x80;
+  P.setNZ(Y);
 }
 
 auto SPC700::instructionNoOperation() -> void {
-  read(PC);
+  readCode(PC);
 }
 
 auto SPC700::instructionOverflowClear() -> void {
-  read(PC);
+  readCode(PC);
   HF = 0;
   VF = 0;
 }
 
 auto SPC700::instructionPull(n8& data) -> void {
-  read(PC);
+  readCode(PC);
   idle();
   data = pull();
 }
 
 auto SPC700::instructionPullP() -> void {
-  read(PC);
+  readCode(PC);
   idle();
   P = pull();
 }
 
 auto SPC700::instructionPush(n8 data) -> void {
-  read(PC);
+  readCode(PC);
   push(data);
   idle();
 }
 
 auto SPC700::instructionReturnInterrupt() -> void {
-  read(PC);
+  readCode(PC);
   idle();
   P = pull();
   n16 address = pull();
@@ -548,43 +541,41 @@ auto SPC700::instructionReturnInterrupt() -> void {
 }
 
 auto SPC700::instructionReturnSubroutine() -> void {
-  read(PC);
+  readCode(PC);
   idle();
   n16 address = pull();
   address |= pull() << 8;
   PC = address;
 }
 
+//the S-SMP has no interrupts, STOP is never exited
+//(each call emulates one iteration, see SMP::executeHalted())
 auto SPC700::instructionStop() -> void {
   r.stop = true;
-  while(r.stop && !synchronizing()) {
-    read(PC);
-    idle();
-  }
+  readCode(PC);
+  idle();
 }
 
 auto SPC700::instructionTestSetBitsAbsolute(bool set) -> void {
   n16 address = fetch();
   address |= fetch() << 8;
   n8 data = read(address);
-  ZF = (A - data) == 0;
-  NF = (A - data) & 0x80;
+  P.setNZ(A - data);
   read(address);
   write(address, set ? data | A : data & ~A);
 }
 
 auto SPC700::instructionTransfer(n8& from, n8& to) -> void {
-  read(PC);
+  readCode(PC);
   to = from;
   if(&to == &S) return;
-  ZF = to == 0;
-  NF = to & 0x80;
+  P.setNZ(to);
 }
 
+//the S-SMP has no interrupts, SLEEP is never exited
+//(each call emulates one iteration, see SMP::executeHalted())
 auto SPC700::instructionWait() -> void {
   r.wait = true;
-  while(r.wait && !synchronizing()) {
-    read(PC);
-    idle();
-  }
+  readCode(PC);
+  idle();
 }
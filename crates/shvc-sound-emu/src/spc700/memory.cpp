@@ -1,5 +1,5 @@
 inline auto SPC700::fetch() -> n8 {
-  return read(PC++);
+  return readCode(PC++);
 }
 
 inline auto SPC700::load(n8 address) -> n8 {
@@ -15,5 +15,6 @@ inline auto SPC700::pull() -> n8 {
 }
 
 inline auto SPC700::push(n8 data) -> void {
-  return write(1 << 8 | S--, data);
+  write(1 << 8 | S--, data);
+  if(S < stackMin) stackMin = S;
 }
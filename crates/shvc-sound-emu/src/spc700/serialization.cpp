@@ -0,0 +1,21 @@
+auto SPC700::serialize(serializer& s) -> void {
+  s(PC);
+  s(YA);
+  s(X);
+  s(S);
+  //the save state stores the materialized N and Z flags
+  bool zf = ZF;
+  bool nf = NF;
+  s(CF);
+  s(zf);
+  s(IF);
+  s(HF);
+  s(BF);
+  s(PF);
+  s(VF);
+  s(nf);
+  if(s.reading()) P.setNZ(nf, zf);
+
+  s(r.wait);
+  s(r.stop);
+}
@@ -9,13 +9,13 @@ namespace shvc_sound_emu {
 #define P r.p
 
 #define CF r.p.c
-#define ZF r.p.z
+#define ZF r.p.z()
 #define IF r.p.i
 #define HF r.p.h
 #define BF r.p.b
 #define PF r.p.p
 #define VF r.p.v
-#define NF r.p.n
+#define NF r.p.n()
 
 #define alu (this->*op)
 
@@ -23,6 +23,8 @@ namespace shvc_sound_emu {
 #include "algorithms.cpp"
 #include "instructions.cpp"
 #include "instruction.cpp"
+#include "serialization.cpp"
+#include "disassembler.cpp"
 
 auto SPC700::power() -> void {
   PC = 0x0000;
@@ -2,17 +2,24 @@
 
 namespace shvc_sound_emu {
 
+struct SMP;
+
 struct SPC700 {
-  virtual auto idle() -> void = 0;
-  virtual auto read(n16 address) -> n8 = 0;
-  virtual auto write(n16 address, n8 data) -> void = 0;
-  virtual auto synchronizing() const -> bool = 0;
+  //bus interface, statically dispatched to the SMP (smp/smp.hpp)
+  auto idle() -> void;
+  auto read(n16 address) -> n8;
+  auto readCode(n16 address) -> n8;  //opcode and operand fetches
+  auto write(n16 address, n8 data) -> void;
+  auto synchronizing() const -> bool;
 
-  virtual auto readDisassembler(n16 address) -> n8 { return 0; }
+  auto readDisassembler(n16 address) -> n8;
 
   //spc700.cpp
   auto power() -> void;
 
+  //serialization.cpp
+  auto serialize(serializer&) -> void;
+
   //memory.cpp
   auto fetch() -> n8;
   auto load(n8 address) -> n8;
@@ -23,6 +30,11 @@ struct SPC700 {
   //instruction.cpp
   auto instruction() -> void;
 
+  //disassembler.cpp
+  static auto instructionLength(n8 opcode) -> u32;
+  //bytes are the opcode followed by (up to) two operand bytes
+  static auto disassemble(n16 pc, const std::array<u8, 3>& bytes) -> std::string;
+
   //algorithms.cpp
   auto algorithmADC(n8, n8) -> n8;
   auto algorithmAND(n8, n8) -> n8;
@@ -49,10 +61,10 @@ struct SPC700 {
 
   auto instructionAbsoluteBitModify(n3) -> void;
   auto instructionAbsoluteBitSet(n3, bool) -> void;
-  auto instructionAbsoluteRead(fpb, n8&) -> void;
-  auto instructionAbsoluteModify(fps) -> void;
+  template<fpb op> auto instructionAbsoluteRead(n8&) -> void;
+  template<fps op> auto instructionAbsoluteModify() -> void;
   auto instructionAbsoluteWrite(n8&) -> void;
-  auto instructionAbsoluteIndexedRead(fpb, n8&) -> void;
+  template<fpb op> auto instructionAbsoluteIndexedRead(n8&) -> void;
   auto instructionAbsoluteIndexedWrite(n8&) -> void;
   auto instructionBranch(bool) -> void;
   auto instructionBranchBit(n3, bool) -> void;
@@ -67,37 +79,37 @@ struct SPC700 {
   auto instructionComplementCarry() -> void;
   auto instructionDecimalAdjustAdd() -> void;
   auto instructionDecimalAdjustSub() -> void;
-  auto instructionDirectRead(fpb, n8&) -> void;
-  auto instructionDirectModify(fps) -> void;
+  template<fpb op> auto instructionDirectRead(n8&) -> void;
+  template<fps op> auto instructionDirectModify() -> void;
   auto instructionDirectWrite(n8&) -> void;
-  auto instructionDirectDirectCompare(fpb) -> void;
-  auto instructionDirectDirectModify(fpb) -> void;
+  template<fpb op> auto instructionDirectDirectCompare() -> void;
+  template<fpb op> auto instructionDirectDirectModify() -> void;
   auto instructionDirectDirectWrite() -> void;
-  auto instructionDirectImmediateCompare(fpb) -> void;
-  auto instructionDirectImmediateModify(fpb) -> void;
+  template<fpb op> auto instructionDirectImmediateCompare() -> void;
+  template<fpb op> auto instructionDirectImmediateModify() -> void;
   auto instructionDirectImmediateWrite() -> void;
-  auto instructionDirectCompareWord(fpw) -> void;
-  auto instructionDirectReadWord(fpw) -> void;
+  template<fpw op> auto instructionDirectCompareWord() -> void;
+  template<fpw op> auto instructionDirectReadWord() -> void;
   auto instructionDirectModifyWord(s32) -> void;
   auto instructionDirectWriteWord() -> void;
-  auto instructionDirectIndexedRead(fpb, n8&, n8&) -> void;
-  auto instructionDirectIndexedModify(fps, n8&) -> void;
+  template<fpb op> auto instructionDirectIndexedRead(n8&, n8&) -> void;
+  template<fps op> auto instructionDirectIndexedModify(n8&) -> void;
   auto instructionDirectIndexedWrite(n8&, n8&) -> void;
   auto instructionDivide() -> void;
   auto instructionExchangeNibble() -> void;
   auto instructionFlagSet(bool&, bool) -> void;
-  auto instructionImmediateRead(fpb, n8&) -> void;
-  auto instructionImpliedModify(fps, n8&) -> void;
-  auto instructionIndexedIndirectRead(fpb, n8&) -> void;
+  template<fpb op> auto instructionImmediateRead(n8&) -> void;
+  template<fps op> auto instructionImpliedModify(n8&) -> void;
+  template<fpb op> auto instructionIndexedIndirectRead(n8&) -> void;
   auto instructionIndexedIndirectWrite(n8&, n8&) -> void;
-  auto instructionIndirectIndexedRead(fpb, n8&) -> void;
+  template<fpb op> auto instructionIndirectIndexedRead(n8&) -> void;
   auto instructionIndirectIndexedWrite(n8&, n8&) -> void;
-  auto instructionIndirectXRead(fpb) -> void;
+  template<fpb op> auto instructionIndirectXRead() -> void;
   auto instructionIndirectXWrite(n8&) -> void;
   auto instructionIndirectXIncrementRead(n8&) -> void;
   auto instructionIndirectXIncrementWrite(n8&) -> void;
-  auto instructionIndirectXCompareIndirectY(fpb) -> void;
-  auto instructionIndirectXWriteIndirectY(fpb) -> void;
+  template<fpb op> auto instructionIndirectXCompareIndirectY() -> void;
+  template<fpb op> auto instructionIndirectXWriteIndirectY() -> void;
   auto instructionJumpAbsolute() -> void;
   auto instructionJumpIndirectX() -> void;
   auto instructionMultiply() -> void;
@@ -115,27 +127,37 @@ struct SPC700 {
 
   struct Flags {
     bool c;  //carry
-    bool z;  //zero
     bool i;  //interrupt disable
     bool h;  //half-carry
     bool b;  //break
     bool p;  //page
     bool v;  //overflow
-    bool n;  //negative
+
+    //the negative and zero flags are evaluated lazily from the last result that set them
+    //(N = bit 7 or bit 11 set, Z = low byte clear), so setting both is a single store
+    u32 nz;
+
+    auto z() const -> bool { return (u8)nz == 0; }
+    auto n() const -> bool { return nz & 0x880; }
+
+    //sets N and Z from an 8-bit result
+    auto setNZ(u8 result) -> void { nz = result; }
+    //sets N and Z from a 16-bit result
+    auto setNZ16(u16 result) -> void { nz = result >> 8 | ((u8)result != 0); }
+    auto setNZ(bool negative, bool zero) -> void { nz = (negative ? 0x800 : 0) | !zero; }
 
     operator u32() const {
-      return c << 0 | z << 1 | i << 2 | h << 3 | b << 4 | p << 5 | v << 6 | n << 7;
+      return c << 0 | z() << 1 | i << 2 | h << 3 | b << 4 | p << 5 | v << 6 | n() << 7;
     }
 
     auto& operator=(n8 data) {
       c = data.bit(0);
-      z = data.bit(1);
       i = data.bit(2);
       h = data.bit(3);
       b = data.bit(4);
       p = data.bit(5);
       v = data.bit(6);
-      n = data.bit(7);
+      setNZ(data.bit(7), data.bit(1));
       return *this;
     }
   };
@@ -152,6 +174,10 @@ struct SPC700 {
     bool wait = false;
     bool stop = false;
   } r;
+
+  //lowest S value reached by a push (including calls and interrupts), not part of the state
+  //(the stack bytes at $0100-$0100+stackMin have not been pushed to)
+  n8 stackMin = 0xff;
 };
 
 }
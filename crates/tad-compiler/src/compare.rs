@@ -0,0 +1,197 @@
+//! Lockstep A/B song comparison
+
+// SPDX-FileCopyrightText: © 2024 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+use compiler::driver_constants::addresses;
+use shvc_sound_emu::{InvalidSpcFile, ShvcSoundEmu};
+
+use std::fmt::Write;
+use std::sync::mpsc;
+use std::thread;
+
+/// Number of stereo samples emulated between song tick counter reads (1ms)
+const BLOCK_FRAMES: usize = 32;
+
+const FRAMES_PER_SECOND: usize = ShvcSoundEmu::SAMPLE_RATE as usize;
+const BLOCKS_PER_SECOND: usize = FRAMES_PER_SECOND / BLOCK_FRAMES;
+
+/// Number of seconds an emulator thread can be ahead of the comparison
+const CHANNEL_BOUND: usize = 2;
+
+/// One second of emulated audio
+struct Second {
+    samples: Vec<i16>,
+    /// Value of the audio driver's song tick counter at the start of every block
+    song_ticks: Vec<u16>,
+}
+
+pub struct FirstDifference {
+    /// Stereo sample index
+    pub sample: u64,
+    /// Song tick counter of the previous and current song when the sample was emulated
+    pub song_ticks: (u16, u16),
+}
+
+/// The difference between the two songs in a single second
+pub struct SecondDifference {
+    pub second: u32,
+    /// Number of stereo samples that differ
+    pub samples: u32,
+    /// Largest absolute difference between the samples
+    pub peak: u16,
+    /// Root mean square of the difference between the samples
+    pub rms: f64,
+}
+
+pub struct Comparison {
+    pub seconds: u32,
+    pub first_difference: Option<FirstDifference>,
+    /// Only the seconds containing a difference
+    pub differences: Vec<SecondDifference>,
+}
+
+fn song_tick_counter(emu: &ShvcSoundEmu) -> u16 {
+    let stc = usize::from(addresses::SONG_TICK_COUNTER);
+    u16::from_le_bytes([emu.apuram()[stc], emu.apuram()[stc + 1]])
+}
+
+fn load_spc(spc: &[u8]) -> Result<ShvcSoundEmu, String> {
+    let mut emu = ShvcSoundEmu::new(&[0; 64]);
+    emu.load_spc(spc)
+        .map_err(|InvalidSpcFile| "Invalid .spc file".to_owned())?;
+    Ok(emu)
+}
+
+/// Emulates `seconds` seconds, sending each second to `tx`.
+/// Stops early if the receiver has hung up.
+fn emulate_seconds(mut emu: ShvcSoundEmu, seconds: u32, tx: mpsc::SyncSender<Second>) {
+    for _ in 0..seconds {
+        let mut second = Second {
+            samples: vec![0; FRAMES_PER_SECOND * 2],
+            song_ticks: Vec::with_capacity(BLOCKS_PER_SECOND),
+        };
+
+        for block in second.samples.chunks_exact_mut(BLOCK_FRAMES * 2) {
+            second.song_ticks.push(song_tick_counter(&emu));
+            emu.emulate_into(block);
+        }
+
+        if tx.send(second).is_err() {
+            return;
+        }
+    }
+}
+
+/// Plays two .spc files exported by `export_spc_file()` (ie, the previous and current compile of
+/// a song) for `seconds` seconds on two lockstep emulator threads and compares their audio.
+pub fn compare_songs(previous: &[u8], current: &[u8], seconds: u32) -> Result<Comparison, String> {
+    let previous = load_spc(previous)?;
+    let current = load_spc(current)?;
+
+    let mut first_difference = None;
+    let mut differences = Vec::new();
+
+    thread::scope(|s| {
+        let (prev_tx, prev_rx) = mpsc::sync_channel(CHANNEL_BOUND);
+        let (cur_tx, cur_rx) = mpsc::sync_channel(CHANNEL_BOUND);
+
+        s.spawn(move || emulate_seconds(previous, seconds, prev_tx));
+        s.spawn(move || emulate_seconds(current, seconds, cur_tx));
+
+        for (second, (p, c)) in (0..seconds).zip(prev_rx.iter().zip(cur_rx.iter())) {
+            let mut n_samples: u32 = 0;
+            let mut peak: u16 = 0;
+            let mut sum_squares = 0.0;
+
+            for (i, (a, b)) in p
+                .samples
+                .chunks_exact(2)
+                .zip(c.samples.chunks_exact(2))
+                .enumerate()
+            {
+                if a == b {
+                    continue;
+                }
+                n_samples += 1;
+
+                if first_difference.is_none() {
+                    let block = i / BLOCK_FRAMES;
+                    first_difference = Some(FirstDifference {
+                        sample: u64::from(second) * FRAMES_PER_SECOND as u64 + i as u64,
+                        song_ticks: (p.song_ticks[block], c.song_ticks[block]),
+                    });
+                }
+
+                for (a, b) in a.iter().zip(b) {
+                    let d = a.abs_diff(*b);
+                    peak = peak.max(d);
+                    sum_squares += f64::from(d) * f64::from(d);
+                }
+            }
+
+            if n_samples > 0 {
+                differences.push(SecondDifference {
+                    second,
+                    samples: n_samples,
+                    peak,
+                    rms: (sum_squares / (FRAMES_PER_SECOND * 2) as f64).sqrt(),
+                });
+            }
+        }
+    });
+
+    Ok(Comparison {
+        seconds,
+        first_difference,
+        differences,
+    })
+}
+
+pub fn comparison_report(c: &Comparison) -> String {
+    let mut out = String::new();
+
+    let f = match &c.first_difference {
+        Some(f) => f,
+        None => {
+            writeln!(out, "Audio is identical for {} seconds", c.seconds).unwrap();
+            return out;
+        }
+    };
+
+    writeln!(
+        out,
+        "First difference at sample {} ({:.3}s), song tick {} (previous) {} (current)",
+        f.sample,
+        f.sample as f64 / f64::from(ShvcSoundEmu::SAMPLE_RATE),
+        f.song_ticks.0,
+        f.song_ticks.1
+    )
+    .unwrap();
+    writeln!(
+        out,
+        "{} of {} seconds differ",
+        c.differences.len(),
+        c.seconds
+    )
+    .unwrap();
+    writeln!(out).unwrap();
+
+    writeln!(
+        out,
+        "{:>6} {:>8} {:>6} {:>9}",
+        "second", "samples", "peak", "rms"
+    )
+    .unwrap();
+    for d in &c.differences {
+        writeln!(
+            out,
+            "{:>6} {:>8} {:>6} {:>9.2}",
+            d.second, d.samples, d.peak, d.rms
+        )
+        .unwrap();
+    }
+
+    out
+}
@@ -0,0 +1,127 @@
+//! Emulated song verification
+
+// SPDX-FileCopyrightText: © 2024 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+use compiler::common_audio_data::CommonAudioData;
+use compiler::driver_constants::{addresses, driver_code_symbol};
+use compiler::songs::SongData;
+use compiler::spc_file_export::export_spc_file;
+use shvc_sound_emu::{InvalidSpcFile, ShvcSoundEmu};
+
+use std::ops::Range;
+
+/// Number of ticks between song and common audio data corruption checks
+const CORRUPTION_CHECK_INTERVAL: u32 = 64;
+
+/// Number of S-DSP clocks per second
+const DSP_CLOCKS_PER_SECOND: f64 = 32.0 * ShvcSoundEmu::SAMPLE_RATE as f64;
+
+fn song_tick_counter(emu: &ShvcSoundEmu) -> u16 {
+    let stc = usize::from(addresses::SONG_TICK_COUNTER);
+    u16::from_le_bytes([emu.apuram()[stc], emu.apuram()[stc + 1]])
+}
+
+fn pc_string(pc: u16) -> String {
+    match driver_code_symbol(pc) {
+        Some((name, offset)) => format!("0x{pc:04x} ({name}+{offset})"),
+        None => format!("0x{pc:04x} (outside the audio driver)"),
+    }
+}
+
+fn check_echo_guard(emu: &mut ShvcSoundEmu) -> Result<(), String> {
+    match emu.take_echo_guard_hit() {
+        Some(h) => Err(format!(
+            "echo buffer overwrote song or common audio data at 0x{:04x} after {:.3} seconds",
+            h.address,
+            h.dsp_clock as f64 / DSP_CLOCKS_PER_SECOND
+        )),
+        None => Ok(()),
+    }
+}
+
+fn check_data(emu: &ShvcSoundEmu, range: &Range<usize>, expected: &[u8]) -> Result<(), String> {
+    match emu.apuram()[range.clone()]
+        .iter()
+        .zip(expected)
+        .position(|(a, b)| a != b)
+    {
+        Some(i) => Err(format!(
+            "song or common audio data overwritten at 0x{:04x} (echo buffer overlap?)",
+            range.start + i
+        )),
+        None => Ok(()),
+    }
+}
+
+/// Plays a song in the emulator (without outputting audio) for `seconds` seconds.
+///
+/// Returns an error if:
+///  * the audio driver stops processing music ticks (ie, it has crashed, hung or halted),
+///  * a music or sound effect tick was dropped (the audio driver's `maxTimerCounter` is > 1),
+///  * the echo buffer overwrites the common audio data or song data,
+///  * the common audio data or song data is modified.
+pub fn emulate_song(
+    common_audio_data: &CommonAudioData,
+    song: &SongData,
+    seconds: u32,
+) -> Result<(), String> {
+    let spc = export_spc_file(common_audio_data, song).map_err(|e| e.to_string())?;
+
+    let mut emu = ShvcSoundEmu::new(&[0; 64]);
+    emu.load_spc(&spc)
+        .map_err(|InvalidSpcFile| "Invalid .spc file".to_owned())?;
+
+    let protected = usize::from(addresses::COMMON_DATA)
+        ..usize::from(common_audio_data.song_data_addr()) + song.data().len();
+    let expected = emu.apuram()[protected.clone()].to_vec();
+
+    emu.set_echo_guard(protected.start as u16..=(protected.end - 1) as u16);
+
+    let end_clock = u64::from(seconds) * ShvcSoundEmu::SMP_CLOCKS_PER_SECOND;
+    let mut smp_clock = 0;
+    let mut tick = 0;
+
+    while smp_clock < end_clock {
+        let r = emu.run_ticks(
+            1,
+            addresses::PROCESS_MUSIC_CHANNELS_CODE,
+            ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+        );
+        if emu.halted() {
+            return Err(format!(
+                "audio driver halted (SLEEP or STOP) after {:.1} seconds (PC = {})",
+                (smp_clock + r.smp_clocks) as f64 / ShvcSoundEmu::SMP_CLOCKS_PER_SECOND as f64,
+                pc_string(emu.program_counter())
+            ));
+        }
+        if !r.hit {
+            return Err(format!(
+                "audio driver hang after {:.1} seconds, no music tick within a second (PC = {})",
+                smp_clock as f64 / ShvcSoundEmu::SMP_CLOCKS_PER_SECOND as f64,
+                pc_string(emu.program_counter())
+            ));
+        }
+        smp_clock += r.smp_clocks;
+        tick += 1;
+
+        check_echo_guard(&mut emu)?;
+
+        let max_timer_counter = emu.apuram()[usize::from(addresses::MAX_TIMER_COUNTER)];
+        if max_timer_counter > 1 {
+            return Err(format!(
+                "tick overrun at song tick {}, {} timer ticks elapsed before the tick was processed",
+                song_tick_counter(&emu),
+                max_timer_counter
+            ));
+        }
+
+        if tick % CORRUPTION_CHECK_INTERVAL == 0 {
+            check_data(&emu, &protected, &expected)?;
+        }
+    }
+
+    check_echo_guard(&mut emu)?;
+    check_data(&emu, &protected, &expected)
+}
@@ -0,0 +1,230 @@
+//! Loader transfer time report
+
+// SPDX-FileCopyrightText: © 2024 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+use compiler::audio_driver;
+use compiler::common_audio_data::CommonAudioData;
+use compiler::compression;
+use compiler::data::Name;
+use compiler::driver_constants::{addresses, LoaderDataType};
+use compiler::songs::SongData;
+use shvc_sound_emu::{LoaderTransfer, ResetRegisters, ScpuLoaderTiming, ShvcSoundEmu};
+
+use std::fmt::Write;
+
+/// LoaderDataType.CODE
+const LOADER_DATA_TYPE_CODE: u8 = 0;
+/// LoaderDataType.COMMON_DATA
+const LOADER_DATA_TYPE_COMMON_DATA: u8 = 1;
+/// LoaderDataType.FAST_TRANSFER_FLAG
+const FAST_TRANSFER_FLAG: u8 = 1 << 4;
+/// LoaderDataType.COMPRESSED_FLAG
+const COMPRESSED_FLAG: u8 = 1 << 5;
+
+/// TAD_DEFAULT_TRANSFER_PER_FRAME
+pub const DEFAULT_TRANSFER_SIZE: u32 = 256;
+/// TAD_MIN_TRANSFER_PER_FRAME
+const MIN_TRANSFER_SIZE: u32 = 32;
+/// TAD_MAX_TRANSFER_PER_FRAME
+const MAX_TRANSFER_SIZE: u32 = 800;
+
+pub struct TransferTime {
+    /// Number of bytes sent to the loader
+    pub bytes: usize,
+    /// Number of `Tad_Process` calls (frames) from the call that sent the LoaderDataType to the
+    /// call that ended the transfer (inclusive)
+    pub frames: u64,
+}
+
+pub struct LoadReport {
+    /// The `Tad_SetTransferSize()` value (after clamping)
+    pub transfer_size: u32,
+    pub compressed: bool,
+    pub common_audio_data: TransferTime,
+    pub songs: Vec<TransferTime>,
+}
+
+/// Same clamping as `Tad_SetTransferSize()`
+pub fn clamp_transfer_size(transfer_size: u32) -> u32 {
+    transfer_size.clamp(MIN_TRANSFER_SIZE, MAX_TRANSFER_SIZE)
+}
+
+fn transfer(
+    emu: &mut ShvcSoundEmu,
+    timing: &ScpuLoaderTiming,
+    data_type: u8,
+    data: &[u8],
+    compressed: bool,
+) -> Result<TransferTime, ()> {
+    let (data_type, data) = match compressed {
+        true => (data_type | COMPRESSED_FLAG, compression::compress(data)),
+        false => (data_type, data.to_vec()),
+    };
+    let bytes = data.len();
+
+    match emu
+        .simulate_loader_transfers(timing, &[LoaderTransfer { data_type, data }])
+        .first()
+    {
+        Some(r) if r.ok => Ok(TransferTime {
+            bytes,
+            frames: r.frames,
+        }),
+        _ => Err(()),
+    }
+}
+
+/// Transfers the common audio data and every song to the loader with the timing of the S-CPU
+/// APIs' transfer loops (`ShvcSoundEmu::simulate_loader_transfers()`) and measures the number of
+/// frames each transfer takes.
+///
+/// Songs are loaded after the common audio data.  The time spent waiting for the loader to start
+/// and any transfer deadline (`Tad_SetTransferDeadline()`) are not included in the report.
+pub fn measure_load_times(
+    common_audio_data: &CommonAudioData,
+    songs: &[SongData],
+    transfer_size: u32,
+    compressed: bool,
+) -> Result<LoadReport, String> {
+    let transfer_size = clamp_transfer_size(transfer_size);
+
+    let mut emu = ShvcSoundEmu::new(&[0; 64]);
+
+    let loader_addr = usize::from(addresses::LOADER);
+    emu.apuram_mut()[loader_addr..loader_addr + audio_driver::LOADER.len()]
+        .copy_from_slice(audio_driver::LOADER);
+
+    emu.reset(ResetRegisters {
+        pc: addresses::LOADER,
+        a: 0,
+        x: 0,
+        y: 0,
+        psw: 0,
+        sp: 0xff,
+        esa: 0,
+        edl: 0,
+    });
+
+    // `Tad_Init` transfers the audio driver with a blocking fast transfer
+    transfer(
+        &mut emu,
+        &ScpuLoaderTiming::ntsc(0),
+        LOADER_DATA_TYPE_CODE | FAST_TRANSFER_FLAG,
+        audio_driver::AUDIO_DRIVER,
+        false,
+    )
+    .map_err(|()| "Loader timeout while transferring the audio driver".to_owned())?;
+
+    let timing = ScpuLoaderTiming::ntsc(transfer_size);
+
+    let common = transfer(
+        &mut emu,
+        &timing,
+        LOADER_DATA_TYPE_COMMON_DATA,
+        common_audio_data.data(),
+        compressed,
+    )
+    .map_err(|()| "Loader timeout while transferring the common audio data".to_owned())?;
+
+    let state = emu.save_state();
+
+    // Uncompressed songs are sent with the fast transfer flag
+    let song_data_type = LoaderDataType {
+        stereo_flag: true,
+        play_song: true,
+        skip_echo_buffer_reset: false,
+        tick_budget: false,
+    }
+    .driver_value()
+        | match compressed {
+            true => 0,
+            false => FAST_TRANSFER_FLAG,
+        };
+
+    let songs = songs
+        .iter()
+        .map(|song| {
+            emu.load_state(&state)
+                .map_err(|_| "Cannot restore emulator state".to_owned())?;
+
+            transfer(&mut emu, &timing, song_data_type, song.data(), compressed)
+                .map_err(|()| "Loader timeout while transferring a song".to_owned())
+        })
+        .collect::<Result<Vec<_>, String>>()?;
+
+    Ok(LoadReport {
+        transfer_size,
+        compressed,
+        common_audio_data: common,
+        songs,
+    })
+}
+
+/// Returns the report and the number of songs that take more than `frame_budget` frames to load
+pub fn load_report(
+    report: &LoadReport,
+    song_names: &[&Name],
+    frame_budget: Option<u64>,
+) -> (String, usize) {
+    let mut out = String::new();
+    let mut n_over_budget = 0;
+
+    writeln!(
+        out,
+        "Transfer size: {} bytes per frame{}",
+        report.transfer_size,
+        match report.compressed {
+            true => " (compressed)",
+            false => "",
+        }
+    )
+    .unwrap();
+    if let Some(b) = frame_budget {
+        writeln!(out, "Frame budget: {b} frames").unwrap();
+    }
+    writeln!(out).unwrap();
+
+    let name_width = song_names
+        .iter()
+        .map(|n| n.as_str().len())
+        .chain(std::iter::once("common audio data".len()))
+        .max()
+        .unwrap_or(0);
+
+    writeln!(
+        out,
+        "{:<name_width$} {:>6} {:>6}",
+        "name", "bytes", "frames"
+    )
+    .unwrap();
+    writeln!(
+        out,
+        "{:<name_width$} {:>6} {:>6}",
+        "common audio data", report.common_audio_data.bytes, report.common_audio_data.frames
+    )
+    .unwrap();
+
+    for (name, t) in song_names.iter().zip(&report.songs) {
+        let over_budget = frame_budget.is_some_and(|b| t.frames > b);
+        if over_budget {
+            n_over_budget += 1;
+        }
+
+        writeln!(
+            out,
+            "{:<name_width$} {:>6} {:>6}{}",
+            name.as_str(),
+            t.bytes,
+            t.frames,
+            match over_budget {
+                true => "  OVER BUDGET",
+                false => "",
+            }
+        )
+        .unwrap();
+    }
+
+    (out, n_over_budget)
+}
@@ -6,26 +6,41 @@
 
 #![forbid(unsafe_code)]
 
+mod compare;
+mod emulation_check;
+mod load_report;
+mod render;
+mod serve;
+mod subroutine_report;
+mod tick_report;
+
 use clap::{Args, Parser, Subcommand};
 
 use compiler::{
+    audible_end::DEFAULT_AUDIBLE_THRESHOLD_DB,
     common_audio_data::{build_common_audio_data, CommonAudioData},
+    compression,
     data::{
         is_name_or_id, load_text_file_with_limit, load_text_file_with_limit_path, Name, Song,
         TextFile, UniqueNamesProjectFile,
     },
+    driver_constants::{addresses, MAX_COMMON_DATA_SIZE},
     export::{
         bin_include_path, Ca65Exporter, Ca65MemoryMap, Exporter, MemoryMapMode, PvExporter,
         PvMemoryMap, SuffixType, Tass64Exporter, Tass64MemoryMap,
     },
     mml::{compile_mml, MmlTickCountTable},
+    parallel::{available_threads, parallel_map},
     pitch_table::{build_pitch_table, PitchTable},
     samples::build_sample_and_instrument_data,
     sfx_file,
     songs::{song_duration_string, validate_song_size, SongData},
     sound_effects::{self, blank_compiled_sound_effects, CompiledSfxSubroutines, SfxExportOrder},
-    spc_file_export::export_spc_file,
+    spc_file_export::{export_spc_file, set_spc_song_length},
+    subroutine_candidates::find_subroutine_candidates,
+    tick_cost,
 };
+use shvc_sound_emu::ShvcSoundEmu;
 
 use std::ffi::{OsStr, OsString};
 use std::path::{Path, PathBuf};
@@ -57,9 +72,35 @@ enum Command {
     /// Export a MML song as a .spc file
     Song2spc(Song2SpcArgs),
 
+    /// Export every song in the project as a .spc file
+    AllSongs2spc(AllSongs2SpcArgs),
+
     /// Check the project will compile successfully and all songs fit in audio-RAM
     Check(CheckProjectArgs),
 
+    /// Emulate a MML song and print the S-SMP cycles used by the most expensive song ticks
+    TickReport(TickReportArgs),
+
+    /// Play a previous compile (.spc file) and the current compile of a MML song in lockstep and
+    /// report where their audio differs
+    Compare(CompareArgs),
+
+    /// Emulate the loader transfer of the common audio data and every song and print the number
+    /// of frames each load takes
+    LoadReport(LoadReportArgs),
+
+    /// Find repeated bytecode sequences in a MML song that could be moved into subroutines
+    SubroutineReport(SubroutineReportArgs),
+
+    /// Render the project's songs to WAV files
+    Render(RenderArgs),
+
+    /// Render the project's sound effects to WAV files, each stops once it is silent
+    RenderSfx(RenderSfxArgs),
+
+    /// Run a HTTP server that renders and checks songs, keeping compiled projects in memory
+    Serve(ServeArgs),
+
     /// Generate an ca65 include file containing songs and sound effect enums
     Ca65Enums(EnumArgs),
 
@@ -79,6 +120,9 @@ enum Command {
 
     /// Compile the project and output a PVSnesLib assembly file containing loadSongData() and .incbin statements
     PvExport(PvExportArgs),
+
+    /// Compile the project once and output assembly and binary files for multiple exporters and memory maps
+    MultiExport(MultiExportArgs),
 }
 
 #[derive(Args)]
@@ -96,6 +140,24 @@ pub struct OutputArg {
     stdout: bool,
 }
 
+#[derive(Args)]
+pub struct CompressArg {
+    #[arg(
+        long,
+        help = "Compress the output\n(the data is decompressed by the loader)"
+    )]
+    compress: bool,
+}
+
+impl CompressArg {
+    fn process<'a>(&self, data: &'a [u8]) -> std::borrow::Cow<'a, [u8]> {
+        match self.compress {
+            true => compression::compress(data).into(),
+            false => data.into(),
+        }
+    }
+}
+
 // Compile Common Audio Data
 // =========================
 
@@ -104,6 +166,17 @@ struct CompileCommonDataArgs {
     #[command(flatten)]
     output: OutputArg,
 
+    #[command(flatten)]
+    compress: CompressArg,
+
+    #[arg(
+        long,
+        value_name = "BASE_FILE",
+        conflicts_with = "compress",
+        help = "Output a compressed patch that changes the BASE_FILE common audio data into the project's common audio data\n(BASE_FILE is an uncompressed `tad-compiler common` output)"
+    )]
+    patch: Option<PathBuf>,
+
     #[arg(value_name = "PROJECT_FILE", help = "project file")]
     project_file: PathBuf,
 }
@@ -172,6 +245,17 @@ fn compile_sound_effects(
 fn compile_common_data(args: CompileCommonDataArgs) {
     let output_arg = args.output.validate();
 
+    let base = args.patch.as_ref().map(|p| {
+        let base = read_binary_file(p);
+        if base.len() > MAX_COMMON_DATA_SIZE {
+            error!(
+                "Invalid base common audio data: {} is too large",
+                p.display()
+            );
+        }
+        base
+    });
+
     let pf = load_project_file(&args.project_file);
 
     let samples = match build_sample_and_instrument_data(&pf) {
@@ -191,7 +275,12 @@ fn compile_common_data(args: CompileCommonDataArgs) {
         Err(e) => error!("{}", e.multiline_display()),
     };
 
-    write_data(output_arg, cad.data());
+    let data = match &base {
+        Some(base) => compression::compress_patch(base, cad.data(), addresses::COMMON_DATA).into(),
+        None => args.compress.process(cad.data()),
+    };
+
+    write_data(output_arg, &data);
 }
 
 //
@@ -215,6 +304,9 @@ struct CompileSongDataArgs {
     #[command(flatten)]
     output: OutputArg,
 
+    #[command(flatten)]
+    compress: CompressArg,
+
     #[arg(value_name = "PROJECT_FILE", help = "project file")]
     project_file: PathBuf,
 
@@ -302,7 +394,7 @@ fn compile_song_data(args: CompileSongDataArgs) {
     };
     let song_data = compile_song(mml_file, song_name, &args.options, &pf, &pitch_table);
 
-    write_data(output_arg, song_data.data());
+    write_data(output_arg, &args.compress.process(song_data.data()));
 }
 
 //
@@ -363,6 +455,707 @@ fn export_song_to_spc_file(args: Song2SpcArgs) {
     write_data(output_arg, &data);
 }
 
+#[derive(Args)]
+struct AllSongs2SpcArgs {
+    #[arg(value_name = "PROJECT_FILE", help = "project file")]
+    project_file: PathBuf,
+
+    #[arg(
+        short = 'o',
+        long = "output-dir",
+        value_name = "DIR",
+        help = "directory to write the .spc files to"
+    )]
+    output_dir: PathBuf,
+
+    #[arg(
+        long = "emulate-length",
+        value_name = "SECONDS",
+        num_args = 0..=1,
+        default_missing_value = "600",
+        help = "play every song in the emulator for up to SECONDS seconds (default 600) and set the song length of looping songs to the end of the first loop (songs with a #SpcSongLength header are unchanged)"
+    )]
+    emulate_length: Option<u32>,
+
+    #[arg(
+        short = 'j',
+        long = "jobs",
+        help = "number of export threads (default: one per CPU core)"
+    )]
+    jobs: Option<usize>,
+}
+
+/// Exports every song with a single common audio data compile.
+///
+/// The .spc files include the project's sound effects.
+fn export_all_songs_to_spc_files(args: AllSongs2SpcArgs) {
+    let pf = load_project_file(&args.project_file);
+    let (common_audio_data, songs) = compile_project(&pf);
+
+    if let Err(e) = std::fs::create_dir_all(&args.output_dir) {
+        error!("Cannot create {}: {}", args.output_dir.display(), e);
+    }
+
+    let jobs = args.jobs.unwrap_or_else(available_threads);
+
+    let results = parallel_map(&songs, jobs, |song_data| {
+        let mut spc = export_spc_file(&common_audio_data, song_data).map_err(|e| e.to_string())?;
+
+        let loop_point = match args.emulate_length {
+            Some(seconds) if song_data.metadata().spc_song_length.is_none() => {
+                render::find_spc_loop(&spc, seconds)?
+            }
+            _ => None,
+        };
+        if let Some(lp) = &loop_point {
+            let end = lp.start_smp_clocks + lp.length_smp_clocks;
+            set_spc_song_length(&mut spc, end.div_ceil(ShvcSoundEmu::SMP_CLOCKS_PER_SECOND));
+        }
+
+        Ok::<_, String>((spc, loop_point))
+    });
+
+    let mut n_errors = 0;
+
+    for (song, r) in pf.songs.list().iter().zip(results) {
+        let name = &song.name;
+        match r {
+            Ok((spc, loop_point)) => {
+                let path = args.output_dir.join(format!("{name}.spc"));
+                if let Err(e) = std::fs::write(&path, spc) {
+                    eprintln!("Error writing {}: {}", path.display(), e);
+                    n_errors += 1;
+                    continue;
+                }
+
+                if let Some(lp) = loop_point {
+                    let end = lp.start_smp_clocks + lp.length_smp_clocks;
+                    let seconds = end as f64 / ShvcSoundEmu::SMP_CLOCKS_PER_SECOND as f64;
+                    println!("{name}: loop ends at {seconds:.1} seconds");
+                } else if args.emulate_length.is_some() {
+                    println!("{name}: song length unchanged");
+                }
+            }
+            Err(e) => {
+                eprintln!("Error exporting {name}: {e}");
+                n_errors += 1;
+            }
+        }
+    }
+
+    if n_errors > 0 {
+        error!("{} songs failed to export", n_errors);
+    }
+}
+
+//
+// Song tick report
+// ================
+
+#[derive(Args)]
+struct TickReportArgs {
+    #[arg(value_name = "PROJECT_FILE", help = "project file")]
+    project_file: PathBuf,
+
+    #[arg(value_name = "SONG", help = "song name, song number, or MML file")]
+    song: OsString,
+
+    #[arg(
+        short = 'l',
+        long = "length",
+        value_name = "SECONDS",
+        default_value_t = 180,
+        help = "number of seconds to emulate"
+    )]
+    seconds: u32,
+
+    #[arg(
+        short = 'n',
+        long = "rows",
+        default_value_t = 20,
+        help = "number of ticks to print"
+    )]
+    rows: usize,
+}
+
+fn tick_report_command(args: TickReportArgs) {
+    let pf = load_project_file(&args.project_file);
+    let (mml_file, song_name) = load_mml_file(&args.song, &pf);
+
+    let samples = match build_sample_and_instrument_data(&pf) {
+        Ok(s) => s,
+        Err(e) => error!("{}", e.multiline_display()),
+    };
+    let sfx = blank_sfx();
+
+    let song_options = SongOptions {
+        print_tick_counts: false,
+    };
+    let song_data = compile_song(
+        mml_file,
+        song_name,
+        &song_options,
+        &pf,
+        samples.pitch_table(),
+    );
+
+    let common_audio_data = match build_common_audio_data(&samples, &sfx.0, &sfx.1) {
+        Ok(data) => data,
+        Err(e) => error!("{}", e.multiline_display()),
+    };
+
+    let spc = match export_spc_file(&common_audio_data, &song_data) {
+        Ok(d) => d,
+        Err(e) => error!("{}", e),
+    };
+
+    let ticks = match tick_report::measure_song_ticks(&spc, args.seconds) {
+        Ok(t) => t,
+        Err(e) => error!("{}", e),
+    };
+
+    let estimate = tick_cost::estimate_tick_costs(&common_audio_data, &song_data);
+
+    print!(
+        "{}",
+        tick_report::tick_report(
+            &ticks,
+            song_data.metadata().tick_clock,
+            estimate.as_ref(),
+            args.rows
+        )
+    );
+}
+
+//
+// Compare songs
+// =============
+
+#[derive(Args)]
+struct CompareArgs {
+    #[arg(value_name = "PROJECT_FILE", help = "project file")]
+    project_file: PathBuf,
+
+    #[arg(value_name = "SONG", help = "song name, song number, or MML file")]
+    song: OsString,
+
+    #[arg(
+        value_name = "PREVIOUS_SPC",
+        help = "previous compile of the song (a .spc file exported by song2spc)"
+    )]
+    previous: PathBuf,
+
+    #[arg(
+        short = 'l',
+        long = "length",
+        value_name = "SECONDS",
+        default_value_t = 180,
+        help = "number of seconds to emulate"
+    )]
+    seconds: u32,
+}
+
+fn compare_command(args: CompareArgs) {
+    let pf = load_project_file(&args.project_file);
+    let (mml_file, song_name) = load_mml_file(&args.song, &pf);
+
+    let previous = read_binary_file(&args.previous);
+
+    let samples = match build_sample_and_instrument_data(&pf) {
+        Ok(s) => s,
+        Err(e) => error!("{}", e.multiline_display()),
+    };
+    let sfx = blank_sfx();
+
+    let song_options = SongOptions {
+        print_tick_counts: false,
+    };
+    let song_data = compile_song(
+        mml_file,
+        song_name,
+        &song_options,
+        &pf,
+        samples.pitch_table(),
+    );
+
+    let common_audio_data = match build_common_audio_data(&samples, &sfx.0, &sfx.1) {
+        Ok(data) => data,
+        Err(e) => error!("{}", e.multiline_display()),
+    };
+
+    let spc = match export_spc_file(&common_audio_data, &song_data) {
+        Ok(d) => d,
+        Err(e) => error!("{}", e),
+    };
+
+    let comparison = match compare::compare_songs(&previous, &spc, args.seconds) {
+        Ok(c) => c,
+        Err(e) => error!("{}", e),
+    };
+
+    print!("{}", compare::comparison_report(&comparison));
+
+    if comparison.first_difference.is_some() {
+        std::process::exit(1);
+    }
+}
+
+//
+// Load report
+// ===========
+
+#[derive(Args)]
+struct LoadReportArgs {
+    #[arg(value_name = "PROJECT_FILE", help = "project file")]
+    project_file: PathBuf,
+
+    #[arg(
+        short = 't',
+        long = "transfer-size",
+        value_name = "BYTES",
+        default_value_t = load_report::DEFAULT_TRANSFER_SIZE,
+        help = "number of bytes transferred per frame (the `Tad_SetTransferSize` value)"
+    )]
+    transfer_size: u32,
+
+    #[arg(long, help = "transfer compressed common audio data and songs")]
+    compress: bool,
+
+    #[arg(
+        long = "frame-budget",
+        value_name = "FRAMES",
+        help = "flag the songs that take more than FRAMES frames to load (exits with an error)"
+    )]
+    frame_budget: Option<u64>,
+}
+
+fn load_report_command(args: LoadReportArgs) {
+    let pf = load_project_file(&args.project_file);
+    let (common_audio_data, songs) = compile_project(&pf);
+
+    let report = match load_report::measure_load_times(
+        &common_audio_data,
+        &songs,
+        args.transfer_size,
+        args.compress,
+    ) {
+        Ok(r) => r,
+        Err(e) => error!("{}", e),
+    };
+
+    let song_names: Vec<&Name> = pf.songs.list().iter().map(|s| &s.name).collect();
+
+    let (out, n_over_budget) = load_report::load_report(&report, &song_names, args.frame_budget);
+    print!("{}", out);
+
+    if n_over_budget > 0 {
+        error!("{} songs exceed the load frame budget", n_over_budget);
+    }
+}
+
+//
+// Subroutine report
+// =================
+
+#[derive(Args)]
+struct SubroutineReportArgs {
+    #[arg(value_name = "PROJECT_FILE", help = "project file")]
+    project_file: PathBuf,
+
+    #[arg(value_name = "SONG", help = "song name, song number, or MML file")]
+    song: OsString,
+
+    #[arg(
+        long = "min-bytes",
+        value_name = "BYTES",
+        default_value_t = 8,
+        help = "minimum number of bytes a sequence must save"
+    )]
+    min_bytes_saved: usize,
+
+    #[arg(
+        short = 'n',
+        long = "rows",
+        default_value_t = 20,
+        help = "maximum number of sequences to print"
+    )]
+    rows: usize,
+}
+
+fn subroutine_report_command(args: SubroutineReportArgs) {
+    let pf = load_project_file(&args.project_file);
+    let (mml_file, song_name) = load_mml_file(&args.song, &pf);
+
+    let pitch_table = match build_pitch_table(&pf.instruments_and_samples) {
+        Ok(pt) => pt,
+        Err(e) => error!("{}", e.multiline_display()),
+    };
+    let song_options = SongOptions {
+        print_tick_counts: false,
+    };
+    let song_data = compile_song(mml_file, song_name, &song_options, &pf, &pitch_table);
+
+    let candidates = find_subroutine_candidates(&song_data, args.min_bytes_saved, args.rows);
+
+    print!(
+        "{}",
+        subroutine_report::subroutine_report(&song_data, &candidates)
+    );
+}
+
+//
+// Render songs
+// ============
+
+#[derive(Args)]
+struct RenderArgs {
+    #[arg(value_name = "PROJECT_FILE", help = "project file")]
+    project_file: PathBuf,
+
+    #[arg(
+        value_name = "SONG",
+        help = "song names or song numbers to render (default: every song)"
+    )]
+    songs: Vec<OsString>,
+
+    #[arg(
+        short = 'o',
+        long = "output-dir",
+        value_name = "DIR",
+        help = "directory to write the WAV files to"
+    )]
+    output_dir: PathBuf,
+
+    #[arg(
+        short = 'l',
+        long = "length",
+        value_name = "SECONDS",
+        default_value_t = 600,
+        help = "maximum number of seconds to render (the length of songs that do not loop)"
+    )]
+    seconds: u32,
+
+    #[arg(
+        long = "loops",
+        default_value_t = 1,
+        help = "number of times to play the song's loop"
+    )]
+    loops: u32,
+
+    #[arg(
+        short = 'j',
+        long = "jobs",
+        help = "number of render threads (default: one per CPU core)"
+    )]
+    jobs: Option<usize>,
+
+    #[arg(
+        long = "no-cache",
+        help = "render every song, even if the song, common audio data and driver are unchanged"
+    )]
+    no_cache: bool,
+}
+
+fn render_songs_command(args: RenderArgs) {
+    let pf = load_project_file(&args.project_file);
+
+    let song_indexes: Vec<usize> = if args.songs.is_empty() {
+        (0..pf.songs.len()).collect()
+    } else {
+        args.songs
+            .iter()
+            .map(|s| {
+                let sn = s.to_string_lossy();
+                match find_song_index(&pf, &sn) {
+                    Some(i) => i,
+                    None => error!("Cannot find song: {}", sn),
+                }
+            })
+            .collect()
+    };
+
+    let (common_audio_data, songs) = compile_project(&pf);
+
+    if let Err(e) = std::fs::create_dir_all(&args.output_dir) {
+        error!("Cannot create {}: {}", args.output_dir.display(), e);
+    }
+
+    let options = render::RenderOptions {
+        seconds: args.seconds,
+        loops: args.loops,
+    };
+
+    let mut cache = render::RenderCache::load(&args.output_dir);
+
+    let wav_file_name = |i: usize| format!("{}.wav", pf.songs.list()[i].name);
+
+    let jobs = args.jobs.unwrap_or_else(available_threads);
+
+    // Idle threads are used to render long songs in segments
+    let segment_threads = (jobs / song_indexes.len().max(1)).max(1);
+
+    // The .spc files are snapshots of a booted audio driver, the loader transfers are not emulated
+    let results = parallel_map(&song_indexes, jobs, |&i| {
+        let spc = export_spc_file(&common_audio_data, &songs[i]).map_err(|e| e.to_string())?;
+        let file_name = wav_file_name(i);
+        let key = render::render_key(&spc, &options);
+
+        if !args.no_cache {
+            if let Some(r) = cache.get(&file_name, key) {
+                return Ok((key, r, true));
+            }
+        }
+
+        let path = args.output_dir.join(file_name);
+        render::render_song(&spc, &path, &options, segment_threads).map(|r| (key, r, false))
+    });
+
+    let mut n_errors = 0;
+
+    for (&i, r) in song_indexes.iter().zip(results) {
+        let name = &pf.songs.list()[i].name;
+        match r {
+            Ok((key, r, cached)) => {
+                cache.insert(&wav_file_name(i), key, r);
+
+                let unchanged = match cached {
+                    true => " (unchanged)",
+                    false => "",
+                };
+                let seconds = r.frames as f64 / f64::from(ShvcSoundEmu::SAMPLE_RATE);
+                match r.loop_point {
+                    Some(lp) => println!(
+                        "{name}: {seconds:.1} seconds, loop start {} samples, loop length {} samples{unchanged}",
+                        lp.start_samples(),
+                        lp.length_samples()
+                    ),
+                    None => println!("{name}: {seconds:.1} seconds, no loop found{unchanged}"),
+                }
+            }
+            Err(e) => {
+                cache.remove(&wav_file_name(i));
+
+                eprintln!("Error rendering {name}: {e}");
+                n_errors += 1;
+            }
+        }
+    }
+
+    cache.save();
+
+    if n_errors > 0 {
+        error!("{} songs failed to render", n_errors);
+    }
+}
+
+/// Returns the index of the song with the song number or name `s`
+fn find_song_index(pf: &UniqueNamesProjectFile, s: &str) -> Option<usize> {
+    match s.parse::<usize>() {
+        Ok(song_id) => song_id
+            .checked_sub(UniqueNamesProjectFile::FIRST_SONG_ID)
+            .filter(|&i| i < pf.songs.len()),
+        Err(_) => pf.songs.get_with_index(s).map(|(i, _)| i as usize),
+    }
+}
+
+//
+// Render sound effects
+// ====================
+
+#[derive(Args)]
+struct RenderSfxArgs {
+    #[arg(value_name = "PROJECT_FILE", help = "project file")]
+    project_file: PathBuf,
+
+    #[arg(
+        value_name = "SFX",
+        help = "sound effects to render (default: every sound effect)"
+    )]
+    sound_effects: Vec<String>,
+
+    #[arg(
+        short = 'o',
+        long = "output-dir",
+        value_name = "DIR",
+        help = "directory to write the WAV files to"
+    )]
+    output_dir: PathBuf,
+
+    #[arg(
+        short = 'l',
+        long = "length",
+        value_name = "SECONDS",
+        default_value_t = 30,
+        help = "maximum number of seconds to render"
+    )]
+    seconds: u32,
+
+    #[arg(
+        long = "silence",
+        value_name = "MS",
+        default_value_t = 250,
+        help = "stop once the output has been silent for MS milliseconds (and no sound effect is playing)"
+    )]
+    silence_ms: u32,
+
+    #[arg(
+        long = "threshold",
+        value_name = "DB",
+        default_value_t = DEFAULT_AUDIBLE_THRESHOLD_DB,
+        allow_negative_numbers = true,
+        help = "silence threshold in decibels relative to full scale"
+    )]
+    threshold_db: f64,
+
+    #[arg(
+        short = 'j',
+        long = "jobs",
+        help = "number of render threads (default: one per CPU core)"
+    )]
+    jobs: Option<usize>,
+}
+
+fn render_sound_effects_command(args: RenderSfxArgs) {
+    let pf = load_project_file(&args.project_file);
+
+    let export_order = pf.sfx_export_order.export_order();
+    if export_order.is_empty() {
+        error!("Project has no sound effects");
+    }
+
+    let sfx_indexes: Vec<usize> = if args.sound_effects.is_empty() {
+        (0..export_order.len()).collect()
+    } else {
+        args.sound_effects
+            .iter()
+            .map(|name| {
+                let i = export_order.iter().position(|n| n.as_str() == name);
+                match i {
+                    Some(i) => i,
+                    None => error!("Cannot find sound effect: {}", name),
+                }
+            })
+            .collect()
+    };
+
+    let samples = match build_sample_and_instrument_data(&pf) {
+        Ok(samples) => samples,
+        Err(e) => error!("{}", e.multiline_display()),
+    };
+
+    let sfx = match compile_sound_effects(&pf, samples.pitch_table()) {
+        Ok(sfx) => sfx,
+        Err(()) => error!("Error compiling sound effects"),
+    };
+
+    let common_audio_data = match build_common_audio_data(&samples, &sfx.0, &sfx.1) {
+        Ok(data) => data,
+        Err(e) => error!("{}", e.multiline_display()),
+    };
+
+    if let Err(e) = std::fs::create_dir_all(&args.output_dir) {
+        error!("Cannot create {}: {}", args.output_dir.display(), e);
+    }
+
+    let sound_effects: Vec<(u8, PathBuf)> = sfx_indexes
+        .iter()
+        .map(|&i| {
+            let path = args.output_dir.join(format!("{}.wav", export_order[i]));
+            (i.try_into().unwrap(), path)
+        })
+        .collect();
+
+    let options = render::SfxRenderOptions {
+        seconds: args.seconds,
+        silence_ms: args.silence_ms,
+        threshold_db: args.threshold_db,
+    };
+    let jobs = args.jobs.unwrap_or_else(available_threads);
+
+    let results =
+        match render::render_sound_effects(&common_audio_data, &sound_effects, &options, jobs) {
+            Ok(r) => r,
+            Err(e) => error!("Error rendering sound effects: {}", e),
+        };
+
+    let mut n_errors = 0;
+
+    for (&i, r) in sfx_indexes.iter().zip(results) {
+        let name = &export_order[i];
+        match r {
+            Ok(r) => {
+                let seconds = r.frames as f64 / f64::from(ShvcSoundEmu::SAMPLE_RATE);
+                match r.stopped {
+                    true => println!("{name}: {seconds:.2} seconds"),
+                    false => println!("{name}: {seconds:.2} seconds, still playing"),
+                }
+            }
+            Err(e) => {
+                eprintln!("Error rendering {name}: {e}");
+                n_errors += 1;
+            }
+        }
+    }
+
+    if n_errors > 0 {
+        error!("{} sound effects failed to render", n_errors);
+    }
+}
+
+//
+// Render server
+// =============
+
+#[derive(Args)]
+struct ServeArgs {
+    #[arg(
+        long = "bind",
+        value_name = "ADDRESS",
+        default_value = "127.0.0.1:8080",
+        help = "address and port to listen on"
+    )]
+    bind: String,
+
+    #[arg(
+        long = "root",
+        value_name = "DIR",
+        default_value = ".",
+        help = "directory containing the projects (the project parameter is relative to DIR and cannot leave it)"
+    )]
+    root: PathBuf,
+
+    #[arg(
+        short = 'j',
+        long = "jobs",
+        help = "total number of threads used to process requests (default: one per CPU core)"
+    )]
+    jobs: Option<usize>,
+
+    #[arg(
+        long = "workers",
+        value_name = "N",
+        help = "number of requests to process in parallel (default: 4 or --jobs, whichever is smaller)"
+    )]
+    workers: Option<usize>,
+}
+
+fn serve_command(args: ServeArgs) {
+    let jobs = args.jobs.unwrap_or_else(available_threads).max(1);
+    let workers = args
+        .workers
+        .unwrap_or(serve::DEFAULT_WORKERS)
+        .clamp(1, jobs);
+
+    let root = match args.root.canonicalize() {
+        Ok(r) => r,
+        Err(e) => error!("Cannot open root directory {}: {}", args.root.display(), e),
+    };
+
+    if let Err(e) = serve::serve(&args.bind, &root, workers, jobs / workers) {
+        error!("Cannot listen on {}: {}", args.bind, e);
+    }
+}
+
 //
 // Check project
 // ==============
@@ -371,11 +1164,37 @@ fn export_song_to_spc_file(args: Song2SpcArgs) {
 struct CheckProjectArgs {
     #[arg(value_name = "PROJECT_FILE", help = "project file")]
     project_file: PathBuf,
+
+    #[arg(
+        long = "emulate",
+        value_name = "SECONDS",
+        num_args = 0..=1,
+        default_missing_value = "60",
+        help = "play every song in the emulator for SECONDS seconds (default 60) and check for driver hangs, tick overruns and data corruption"
+    )]
+    emulate: Option<u32>,
 }
 
 fn check_project_command(args: CheckProjectArgs) {
     let pf = load_project_file(&args.project_file);
-    compile_project(&pf);
+    let (common_audio_data, songs) = compile_project(&pf);
+
+    if let Some(seconds) = args.emulate {
+        let results = parallel_map(&songs, available_threads(), |song_data| {
+            emulation_check::emulate_song(&common_audio_data, song_data, seconds)
+        });
+
+        let mut n_errors = 0;
+        for (song, r) in pf.songs.list().iter().zip(results) {
+            if let Err(e) = r {
+                eprintln!("Error emulating {}: {}", song.name, e);
+                n_errors += 1;
+            }
+        }
+        if n_errors > 0 {
+            error!("{} songs failed the emulated check", n_errors);
+        }
+    }
 
     println!("Project is valid and will fit in audio-RAM");
 }
@@ -398,7 +1217,7 @@ fn generate_enums_command<E: Exporter>(args: EnumArgs) {
 
     let pf = load_project_file(&args.project_file);
 
-    let inc_file = match E::generate_include_file(pf) {
+    let inc_file = match E::generate_include_file(&pf) {
         Ok(o) => o,
         Err(e) => error!("Error creating enum file: {}", e),
     };
@@ -466,45 +1285,78 @@ struct ExportWithAsmArgs {
     )]
     output_inc: Option<PathBuf>,
 
+    #[arg(
+        long,
+        help = "Compress the common audio data and songs\n(the audio data is decompressed by the loader)"
+    )]
+    compress: bool,
+
     #[arg(value_name = "PROJECT_FILE", help = "project file")]
     project_file: PathBuf,
 }
 
 fn export_with_asm_command<E: Exporter>(memory_map: &E::MemoryMap, args: ExportWithAsmArgs) {
-    let relative_bin_path = match bin_include_path(&args.output_asm, &args.output_bin) {
-        Ok(p) => p,
-        Err(e) => error!("Error:  {}", e),
+    let (pf, common_audio_data, songs) = load_and_compile_project(&args);
+
+    let files = match export_with_asm::<E>(
+        &pf,
+        &common_audio_data,
+        &songs,
+        memory_map,
+        &args.output_asm,
+        &args.output_bin,
+        args.output_inc.as_deref(),
+        args.compress,
+    ) {
+        Ok(f) => f,
+        Err(e) => error!("{}", e),
     };
 
-    let (pf, common_audio_data, songs) = load_and_compile_project(&args);
+    for (path, data) in files {
+        write_to_file(path, &data);
+    }
+}
 
-    let bin_file = match E::export_bin_file(&common_audio_data, &songs, memory_map) {
+/// Exports the compiled project, returning the files to write (in the order they are written).
+#[allow(clippy::too_many_arguments)]
+fn export_with_asm<'a, E: Exporter>(
+    pf: &UniqueNamesProjectFile,
+    common_audio_data: &CommonAudioData,
+    songs: &[SongData],
+    memory_map: &E::MemoryMap,
+    output_asm: &'a Path,
+    output_bin: &'a Path,
+    output_inc: Option<&'a Path>,
+    compress: bool,
+) -> Result<Vec<(&'a Path, Vec<u8>)>, String> {
+    let relative_bin_path = match bin_include_path(output_asm, output_bin) {
+        Ok(p) => p,
+        Err(e) => return Err(format!("Error:  {}", e)),
+    };
+
+    let bin_file = match E::export_bin_file(common_audio_data, songs, memory_map, compress) {
         Ok(b) => b,
-        Err(e) => error!("Error: {}", e),
+        Err(e) => return Err(format!("Error: {}", e)),
     };
 
     let asm_file = match E::generate_asm_file(&bin_file, memory_map, &relative_bin_path) {
         Ok(o) => o,
-        Err(e) => error!("Error creating assembly file: {}", e),
+        Err(e) => return Err(format!("Error creating assembly file: {}", e)),
     };
 
-    let inc_file = match &args.output_inc {
-        Some(path) => {
-            let inc_file = match E::generate_include_file(pf) {
-                Ok(o) => o,
-                Err(e) => error!("Error creating enum include file: {}", e),
-            };
-            Some((path, inc_file))
-        }
-        None => None,
-    };
-
-    write_to_file(&args.output_bin, bin_file.data());
-    write_to_file(&args.output_asm, asm_file.as_bytes());
+    let mut files = vec![
+        (output_bin, bin_file.data().to_vec()),
+        (output_asm, asm_file.into_bytes()),
+    ];
 
-    if let Some((inc_path, inc_str)) = inc_file {
-        write_to_file(inc_path, inc_str.as_bytes());
+    if let Some(path) = output_inc {
+        match E::generate_include_file(pf) {
+            Ok(o) => files.push((path, o.into_bytes())),
+            Err(e) => return Err(format!("Error creating enum include file: {}", e)),
+        }
     }
+
+    Ok(files)
 }
 
 fn load_and_compile_project(
@@ -547,10 +1399,35 @@ fn compile_and_check_song(
     }
 }
 
+/// Compiles and checks every song of the project in parallel.
+///
+/// The results are in song order.
+fn compile_and_check_songs(
+    pf: &UniqueNamesProjectFile,
+    pitch_table: &PitchTable,
+    common_data: &CommonAudioData,
+) -> Vec<Result<SongData, String>> {
+    parallel_map(pf.songs.list(), available_threads(), |song| {
+        compile_and_check_song(song, pf, pitch_table, common_data)
+    })
+}
+
 fn compile_project(pf: &UniqueNamesProjectFile) -> (CommonAudioData, Vec<SongData>) {
+    match try_compile_project(pf) {
+        Ok(r) => r,
+        Err(e) => error!("{}", e),
+    }
+}
+
+/// Compiles the project's common audio data and songs.
+///
+/// Sound effect errors are printed to stderr.
+fn try_compile_project(
+    pf: &UniqueNamesProjectFile,
+) -> Result<(CommonAudioData, Vec<SongData>), String> {
     let samples = build_sample_and_instrument_data(pf);
     if let Err(e) = samples {
-        error!("{}", e.multiline_display())
+        return Err(e.multiline_display().to_string());
     };
 
     let sfx = if let Ok(s) = &samples {
@@ -561,38 +1438,41 @@ fn compile_project(pf: &UniqueNamesProjectFile) -> (CommonAudioData, Vec<SongDat
 
     let (samples, sfx) = match (samples, sfx) {
         (Ok(samples), Ok(sfx)) => (samples, sfx),
-        _ => error!("Error compiling common audio data"),
+        _ => return Err("Error compiling common audio data".to_owned()),
     };
 
     let common_audio_data = match build_common_audio_data(&samples, &sfx.0, &sfx.1) {
         Ok(data) => data,
-        Err(e) => error!("{}", e.multiline_display()),
+        Err(e) => return Err(e.multiline_display().to_string()),
     };
 
+    let results = compile_and_check_songs(pf, samples.pitch_table(), &common_audio_data);
+
     let mut compiled_songs = Vec::with_capacity(pf.songs.len());
+    let mut song_errors = String::new();
     let mut n_song_errors = 0;
 
-    for song in pf.songs.list().iter() {
-        match compile_and_check_song(song, pf, samples.pitch_table(), &common_audio_data) {
+    for r in results {
+        match r {
             Ok(sd) => compiled_songs.push(sd),
             Err(e) => {
                 n_song_errors += 1;
-                eprintln!("{}\n", e);
+                song_errors += &format!("{}\n\n", e);
             }
         }
     }
 
     if n_song_errors > 0 {
         if n_song_errors == 1 {
-            error!("{} song has an error", n_song_errors);
+            return Err(format!("{song_errors}{} song has an error", n_song_errors));
         } else {
-            error!("{} songs have errors", n_song_errors);
+            return Err(format!("{song_errors}{} songs have errors", n_song_errors));
         }
     }
 
     assert!(compiled_songs.len() == pf.songs.len());
 
-    (common_audio_data, compiled_songs)
+    Ok((common_audio_data, compiled_songs))
 }
 
 //
@@ -726,6 +1606,162 @@ fn parse_pv_memory_map(args: &PvExportArgs) -> PvMemoryMap {
     }
 }
 
+//
+// multi-export
+// ============
+
+#[derive(Args)]
+struct MultiExportArgs {
+    #[arg(
+        long = "target",
+        short = 't',
+        value_name = "TARGET",
+        required = true,
+        help = "Comma separated export target (can be used multiple times)\n\
+                format=<ca65|64tass|pv>,mode=<lorom|hirom>,first=<segment, section or bank>,asm=<ASM_FILE>,bin=<BIN_FILE>[,inc=<INC_FILE>][,suffix=<lower-hex|upper-hex>]\n\
+                (eg, format=ca65,mode=lorom,first=AUDIO_DATA_0,asm=gen/audio.s,bin=gen/audio.bin)"
+    )]
+    targets: Vec<String>,
+
+    #[arg(
+        long,
+        help = "Compress the common audio data and songs\n(the audio data is decompressed by the loader)"
+    )]
+    compress: bool,
+
+    #[arg(value_name = "PROJECT_FILE", help = "project file")]
+    project_file: PathBuf,
+}
+
+enum TargetMemoryMap {
+    Ca65(Ca65MemoryMap),
+    Tass64(Tass64MemoryMap),
+    Pv(PvMemoryMap),
+}
+
+struct ExportTarget {
+    memory_map: TargetMemoryMap,
+    output_asm: PathBuf,
+    output_bin: PathBuf,
+    output_inc: Option<PathBuf>,
+}
+
+fn parse_export_target(s: &str) -> Result<ExportTarget, String> {
+    let mut format = None;
+    let mut mode = None;
+    let mut first = None;
+    let mut output_asm = None;
+    let mut output_bin = None;
+    let mut output_inc = None;
+    let mut suffix_type = SuffixType::Integer;
+
+    for kv in s.split(',') {
+        let (key, value) = kv
+            .split_once('=')
+            .ok_or_else(|| format!("expected key=value, got {kv:?}"))?;
+
+        match key {
+            "format" => format = Some(value),
+            "mode" => {
+                mode = Some(match value {
+                    "lorom" => MemoryMapMode::LoRom,
+                    "hirom" => MemoryMapMode::HiRom,
+                    _ => return Err(format!("unknown memory map mode: {value}")),
+                })
+            }
+            "first" => first = Some(value),
+            "asm" => output_asm = Some(PathBuf::from(value)),
+            "bin" => output_bin = Some(PathBuf::from(value)),
+            "inc" => output_inc = Some(PathBuf::from(value)),
+            "suffix" => {
+                suffix_type = match value {
+                    "lower-hex" => SuffixType::LowerHex,
+                    "upper-hex" => SuffixType::UpperHex,
+                    _ => return Err(format!("unknown suffix: {value}")),
+                }
+            }
+            _ => return Err(format!("unknown key: {key}")),
+        }
+    }
+
+    let mode = mode.ok_or("missing mode")?;
+    let first = first.ok_or("missing first")?;
+
+    let memory_map = match format.ok_or("missing format")? {
+        "ca65" => Ca65MemoryMap::try_new(mode, first, suffix_type).map(TargetMemoryMap::Ca65),
+        "64tass" => Tass64MemoryMap::try_new(mode, first, suffix_type).map(TargetMemoryMap::Tass64),
+        "pv" => {
+            let bank = first
+                .parse()
+                .map_err(|_| format!("invalid bank: {first}"))?;
+            PvMemoryMap::try_new(mode, bank).map(TargetMemoryMap::Pv)
+        }
+        f => return Err(format!("unknown format: {f}")),
+    }
+    .map_err(|e| format!("invalid memory map: {e}"))?;
+
+    Ok(ExportTarget {
+        memory_map,
+        output_asm: output_asm.ok_or("missing asm")?,
+        output_bin: output_bin.ok_or("missing bin")?,
+        output_inc,
+    })
+}
+
+/// Compiles the project once and exports it for every target in parallel.
+fn multi_export_command(args: MultiExportArgs) {
+    let targets: Vec<ExportTarget> = args
+        .targets
+        .iter()
+        .map(|t| match parse_export_target(t) {
+            Ok(t) => t,
+            Err(e) => error!("Invalid target {:?}: {}", t, e),
+        })
+        .collect();
+
+    let pf = load_project_file(&args.project_file);
+    let (common_audio_data, songs) = compile_project(&pf);
+
+    let results = parallel_map(&targets, available_threads(), |t| {
+        let asm = &t.output_asm;
+        let bin = &t.output_bin;
+        let inc = t.output_inc.as_deref();
+        let (pf, cad, songs, c) = (&pf, &common_audio_data, &songs, args.compress);
+
+        match &t.memory_map {
+            TargetMemoryMap::Ca65(mm) => {
+                export_with_asm::<Ca65Exporter>(pf, cad, songs, mm, asm, bin, inc, c)
+            }
+            TargetMemoryMap::Tass64(mm) => {
+                export_with_asm::<Tass64Exporter>(pf, cad, songs, mm, asm, bin, inc, c)
+            }
+            TargetMemoryMap::Pv(mm) => {
+                export_with_asm::<PvExporter>(pf, cad, songs, mm, asm, bin, inc, c)
+            }
+        }
+    });
+
+    let mut n_errors = 0;
+
+    for (t, r) in targets.iter().zip(results) {
+        match r {
+            Ok(files) => {
+                for (path, data) in files {
+                    write_to_file(path, &data);
+                }
+            }
+            Err(e) => {
+                eprintln!("{}: {}", t.output_asm.display(), e);
+                n_errors += 1;
+            }
+        }
+    }
+
+    if n_errors > 0 {
+        error!("{} targets failed to export", n_errors);
+    }
+}
+
 //
 // Main
 // ====
@@ -737,7 +1773,15 @@ fn main() {
         Command::Common(args) => compile_common_data(args),
         Command::Song(args) => compile_song_data(args),
         Command::Song2spc(args) => export_song_to_spc_file(args),
+        Command::AllSongs2spc(args) => export_all_songs_to_spc_files(args),
         Command::Check(args) => check_project_command(args),
+        Command::TickReport(args) => tick_report_command(args),
+        Command::Compare(args) => compare_command(args),
+        Command::LoadReport(args) => load_report_command(args),
+        Command::SubroutineReport(args) => subroutine_report_command(args),
+        Command::Render(args) => render_songs_command(args),
+        Command::RenderSfx(args) => render_sound_effects_command(args),
+        Command::Serve(args) => serve_command(args),
         Command::Ca65Enums(args) => generate_enums_command::<Ca65Exporter>(args),
         Command::Ca65Export(args) => {
             export_with_asm_command::<Ca65Exporter>(&parse_ca65_memory_map(&args), args.base)
@@ -750,6 +1794,7 @@ fn main() {
         Command::PvExport(args) => {
             export_with_asm_command::<PvExporter>(&parse_pv_memory_map(&args), args.base)
         }
+        Command::MultiExport(args) => multi_export_command(args),
     }
 }
 
@@ -758,15 +1803,29 @@ fn main() {
 // ==============
 
 fn load_project_file(path: &Path) -> UniqueNamesProjectFile {
+    match try_load_project_file(path) {
+        Ok(pf) => pf,
+        Err(e) => error!("{}", e),
+    }
+}
+
+fn try_load_project_file(path: &Path) -> Result<UniqueNamesProjectFile, String> {
     match compiler::data::load_project_file(path) {
-        Err(e) => error!("Cannot load project file: {}", e),
+        Err(e) => Err(format!("Cannot load project file: {}", e)),
         Ok(m) => match compiler::data::validate_project_file_names(m) {
-            Ok(vm) => vm,
-            Err(e) => error!("{}", e.multiline_display()),
+            Ok(vm) => Ok(vm),
+            Err(e) => Err(e.multiline_display().to_string()),
         },
     }
 }
 
+fn read_binary_file(path: &Path) -> Vec<u8> {
+    match std::fs::read(path) {
+        Ok(d) => d,
+        Err(e) => error!("Error reading {}: {}", path.display(), e),
+    }
+}
+
 // Output
 // ======
 
@@ -0,0 +1,467 @@
+//! Song and sound effect WAV renderer
+
+// SPDX-FileCopyrightText: © 2024 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+use compiler::common_audio_data::CommonAudioData;
+use compiler::driver_constants::{
+    addresses, io_commands, FIRST_SFX_CHANNEL, IO_COMMAND_I_MASK, IO_COMMAND_MASK, N_SFX_CHANNELS,
+};
+use compiler::fnv1a::Fnv1a;
+use compiler::songs::blank_song;
+use compiler::spc_file_export::export_spc_file;
+use compiler::time::{MIN_TICK_TIMER, TIMER_HZ};
+use compiler::Pan;
+use shvc_sound_emu::{
+    IdleWatch, InvalidSpcFile, IoPortWrite, LoopPoint, SfxRenderJob, SfxRenderSettings,
+    ShvcSoundEmu,
+};
+
+use std::collections::HashMap;
+use std::fs;
+use std::io::{BufWriter, Write};
+use std::path::{Path, PathBuf};
+
+/// Maximum number of song ticks per second
+const MAX_TICKS_PER_SECOND: u32 = TIMER_HZ / (MIN_TICK_TIMER as u32);
+
+/// Name of the render cache file in the output directory
+const RENDER_CACHE_FILE_NAME: &str = ".tad-render-cache";
+
+/// Incremented whenever the render output or the render cache file format changes
+const RENDER_CACHE_VERSION: u64 = 1;
+
+/// Minimum length of a segment when a song is rendered on multiple threads
+const MIN_SEGMENT_FRAMES: u64 = 10 * ShvcSoundEmu::SAMPLE_RATE as u64;
+
+/// Number of samples mixed before a segment checkpoint.
+///
+/// `fast_forward()` does not mix audio, the sample it stops in is only partially mixed.
+const SEGMENT_WARMUP_FRAMES: u64 = 16;
+
+/// Must match `WavHeader` in `render.cpp`
+const WAV_SAMPLE_RATE: u32 = 32040;
+const WAV_FRAME_SIZE: u32 = 4;
+const WAV_HEADER_SIZE: u32 = 44;
+
+pub struct RenderOptions {
+    /// Maximum number of seconds to render
+    /// (the length of a song that does not loop within `seconds`)
+    pub seconds: u32,
+    /// Number of times to play the song's loop (if the song loops within `seconds`)
+    pub loops: u32,
+}
+
+#[derive(Clone, Copy)]
+pub struct RenderedSong {
+    /// Number of stereo samples written
+    pub frames: u64,
+    pub loop_point: Option<LoopPoint>,
+}
+
+/// Plays a .spc file exported by `export_spc_file()` and writes the audio to a WAV file.
+///
+/// A song that loops (see `ShvcSoundEmu::find_loop()`) is rendered until the end of the
+/// `options.loops`th loop, otherwise `options.seconds` seconds are rendered.
+///
+/// Long songs are split into segments and rendered on up to `threads` threads
+/// (see `render_segments()`).  The output is identical to a single threaded render.
+pub fn render_song(
+    spc: &[u8],
+    path: &Path,
+    options: &RenderOptions,
+    threads: usize,
+) -> Result<RenderedSong, String> {
+    let mut emu = ShvcSoundEmu::new(&[0; 64]);
+    emu.load_spc(spc)
+        .map_err(|InvalidSpcFile| "Invalid .spc file".to_owned())?;
+
+    let max_smp_clocks = u64::from(options.seconds) * ShvcSoundEmu::SMP_CLOCKS_PER_SECOND;
+
+    let loop_point = find_song_loop(&emu, options.seconds);
+
+    let smp_clocks = match loop_point {
+        Some(lp) => (lp.start_smp_clocks + lp.length_smp_clocks * u64::from(options.loops))
+            .min(max_smp_clocks),
+        None => max_smp_clocks,
+    };
+
+    let total_frames = smp_clocks.div_ceil(ShvcSoundEmu::SMP_CLOCKS_PER_SAMPLE);
+
+    // Streamed output is not segmented (stdout cannot be rewritten if the render fails)
+    if threads > 1 && total_frames >= MIN_SEGMENT_FRAMES * 2 && path != Path::new("-") {
+        if let Some(segments) = render_segments(&emu, total_frames, threads) {
+            return match write_wav_file(path, &segments) {
+                Ok(()) => Ok(RenderedSong {
+                    frames: total_frames,
+                    loop_point,
+                }),
+                Err(e) => Err(format!("{}: {}", path.display(), e)),
+            };
+        }
+    }
+
+    match emu.render_to_file(path, smp_clocks, None) {
+        Ok(frames) => Ok(RenderedSong { frames, loop_point }),
+        Err(e) => Err(format!("{}: {}", path.display(), e)),
+    }
+}
+
+pub struct SfxRenderOptions {
+    /// Maximum number of seconds to render
+    pub seconds: u32,
+    /// Number of milliseconds the output must be silent (with no sound effect playing) before
+    /// the render stops
+    pub silence_ms: u32,
+    /// Silence threshold in decibels relative to full scale
+    pub threshold_db: f64,
+}
+
+#[derive(Clone, Copy)]
+pub struct RenderedSfx {
+    /// Number of stereo samples written
+    pub frames: u64,
+    /// False if the sound effect was still playing after `SfxRenderOptions::seconds`
+    pub stopped: bool,
+}
+
+/// Plays each sound effect (with the blank song) and writes the audio to a WAV file.
+///
+/// Every sound effect is played from the same snapshot of a booted audio driver and rendered
+/// until the output has been silent for `options.silence_ms` and both sound effect channels are
+/// idle (see `shvc_sound_emu::render_sound_effects()`).  The trailing silence is not written.
+///
+/// The sound effects are rendered in parallel on up to `threads` threads.
+pub fn render_sound_effects(
+    common_audio_data: &CommonAudioData,
+    sound_effects: &[(u8, PathBuf)],
+    options: &SfxRenderOptions,
+    threads: usize,
+) -> Result<Vec<Result<RenderedSfx, String>>, String> {
+    let spc = export_spc_file(common_audio_data, &blank_song()).map_err(|e| e.to_string())?;
+
+    let mut emu = ShvcSoundEmu::new(&[0; 64]);
+    emu.load_spc(&spc)
+        .map_err(|InvalidSpcFile| "Invalid .spc file".to_owned())?;
+
+    let r = emu.run_until_pc(
+        addresses::MAINLOOP_CODE,
+        ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+    );
+    if !r.hit {
+        return Err("audio driver did not start".to_owned());
+    }
+
+    // The driver acknowledges a command by writing its command id to port 0
+    let previous_command = emu.read_io_ports()[0];
+    let command = ((previous_command ^ u8::MAX) & IO_COMMAND_I_MASK)
+        | (io_commands::PLAY_SOUND_EFFECT & IO_COMMAND_MASK);
+
+    // A sound effect channel is idle if its instruction pointer is below the common audio data
+    let watches: Vec<IdleWatch> = (0..N_SFX_CHANNELS)
+        .map(|i| {
+            let c = (FIRST_SFX_CHANNEL + i) as u16;
+            IdleWatch {
+                addr_l: addresses::CHANNEL_INSTRUCTION_PTR_L + c,
+                addr_h: addresses::CHANNEL_INSTRUCTION_PTR_H + c,
+                active_min: addresses::COMMON_DATA,
+            }
+        })
+        .collect();
+
+    let threshold = f64::from(i16::MAX) * 10.0_f64.powf(options.threshold_db / 20.0);
+
+    let settings = SfxRenderSettings {
+        silence_threshold: threshold.clamp(0.0, f64::from(i16::MAX)) as u16,
+        silence_samples: (u64::from(options.silence_ms) * u64::from(ShvcSoundEmu::SAMPLE_RATE)
+            / 1000)
+            .try_into()
+            .unwrap_or(u32::MAX),
+        max_smp_clocks: u64::from(options.seconds) * ShvcSoundEmu::SMP_CLOCKS_PER_SECOND,
+    };
+
+    let jobs: Vec<SfxRenderJob> = sound_effects
+        .iter()
+        .map(|(sfx_id, _)| SfxRenderJob {
+            port_writes: vec![IoPortWrite {
+                smp_clock: 0,
+                ports: [command, *sfx_id, Pan::CENTER.as_u8(), 0],
+            }],
+        })
+        .collect();
+
+    let state = emu.save_state();
+    let results = shvc_sound_emu::render_sound_effects(
+        &state,
+        &watches,
+        &settings,
+        &jobs,
+        threads.try_into().unwrap_or(u32::MAX),
+    )
+    .map_err(|e| e.to_string())?;
+
+    Ok(sound_effects
+        .iter()
+        .zip(results)
+        .map(
+            |((_, path), r)| match write_wav_file(path, std::slice::from_ref(&r.samples)) {
+                Ok(()) => Ok(RenderedSfx {
+                    frames: r.samples.len() as u64 / 2,
+                    stopped: r.stopped,
+                }),
+                Err(e) => Err(format!("{}: {}", path.display(), e)),
+            },
+        )
+        .collect())
+}
+
+/// Searches for the song's loop in the first `seconds` seconds of a booted audio driver.
+fn find_song_loop(emu: &ShvcSoundEmu, seconds: u32) -> Option<LoopPoint> {
+    emu.clone().find_loop(
+        addresses::PROCESS_MUSIC_CHANNELS_CODE,
+        &addresses::driver_state_ranges(),
+        seconds.saturating_mul(MAX_TICKS_PER_SECOND),
+    )
+}
+
+/// Plays a .spc file exported by `export_spc_file()` and searches for the song's loop in the
+/// first `seconds` seconds.
+pub fn find_spc_loop(spc: &[u8], seconds: u32) -> Result<Option<LoopPoint>, String> {
+    let mut emu = ShvcSoundEmu::new(&[0; 64]);
+    emu.load_spc(spc)
+        .map_err(|InvalidSpcFile| "Invalid .spc file".to_owned())?;
+
+    Ok(find_song_loop(&emu, seconds))
+}
+
+/// Number of samples output by the S-DSP before `dsp_clock`
+/// (the S-DSP outputs a sample on clock 27 of every 32 clock sample).
+fn dsp_samples(dsp_clock: u64) -> u64 {
+    (dsp_clock + 5) / 32
+}
+
+/// Renders `total_frames` samples in segments of equal length on up to `threads` threads.
+///
+/// The first pass plays the song without mixing audio and clones the emulator at the start of
+/// every segment.  The second pass renders the segments in parallel.
+///
+/// Returns `None` if the song must be rendered by `render_to_file()`:
+///  * a checkpoint is not on the expected sample,
+///  * the S-SMP has halted (`render_to_file()` stops early when a halted song is silent).
+fn render_segments(emu: &ShvcSoundEmu, total_frames: u64, threads: usize) -> Option<Vec<Vec<i16>>> {
+    let n_segments = (total_frames / MIN_SEGMENT_FRAMES)
+        .min(threads as u64)
+        .max(1);
+    let segment_frames = total_frames.div_ceil(n_segments);
+
+    let first_sample = dsp_samples(emu.dsp_clock());
+    let frames = |e: &ShvcSoundEmu| dsp_samples(e.dsp_clock()) - first_sample;
+
+    let mut checkpoints = Vec::with_capacity(n_segments as usize);
+    checkpoints.push((0, emu.clone()));
+
+    let mut e = emu.clone();
+    let mut warmup = vec![0; (SEGMENT_WARMUP_FRAMES * 2) as usize];
+
+    for start in (segment_frames..total_frames).step_by(segment_frames as usize) {
+        let ff_frames = (start - frames(&e)).saturating_sub(SEGMENT_WARMUP_FRAMES);
+        e.fast_forward(ff_frames * ShvcSoundEmu::SMP_CLOCKS_PER_SAMPLE);
+
+        let remaining = start.checked_sub(frames(&e)).filter(|&n| n > 0)?;
+        if remaining > SEGMENT_WARMUP_FRAMES {
+            return None;
+        }
+        e.emulate_into(&mut warmup[..(remaining * 2) as usize]);
+
+        if frames(&e) != start || e.halted() {
+            return None;
+        }
+        checkpoints.push((start, e.clone()));
+    }
+    drop(e);
+
+    let segments = crate::parallel_map(&checkpoints, threads, |(start, e)| {
+        let len = segment_frames.min(total_frames - start);
+
+        let mut e = e.clone();
+        let mut out = vec![0; (len * 2) as usize];
+        e.emulate_into(&mut out);
+
+        (!e.halted()).then_some(out)
+    });
+
+    segments.into_iter().collect()
+}
+
+fn write_wav_file(path: &Path, segments: &[Vec<i16>]) -> std::io::Result<()> {
+    let frames: u64 = segments.iter().map(|s| s.len() as u64 / 2).sum();
+
+    let max_data_size = u64::from(u32::MAX - (WAV_HEADER_SIZE - 8));
+    let data_size = (frames * u64::from(WAV_FRAME_SIZE)).min(max_data_size) as u32;
+
+    let mut w = BufWriter::with_capacity(1 << 20, fs::File::create(path)?);
+
+    w.write_all(b"RIFF")?;
+    w.write_all(&(data_size + (WAV_HEADER_SIZE - 8)).to_le_bytes())?;
+    w.write_all(b"WAVEfmt ")?;
+    w.write_all(&16_u32.to_le_bytes())?;
+    w.write_all(&1_u16.to_le_bytes())?; // PCM
+    w.write_all(&2_u16.to_le_bytes())?; // channels
+    w.write_all(&WAV_SAMPLE_RATE.to_le_bytes())?;
+    w.write_all(&(WAV_SAMPLE_RATE * WAV_FRAME_SIZE).to_le_bytes())?;
+    w.write_all(&(WAV_FRAME_SIZE as u16).to_le_bytes())?;
+    w.write_all(&16_u16.to_le_bytes())?; // bits per sample
+    w.write_all(b"data")?;
+    w.write_all(&data_size.to_le_bytes())?;
+
+    for s in segments.iter().flatten() {
+        w.write_all(&s.to_le_bytes())?;
+    }
+
+    w.flush()
+}
+
+/// Returns a hash of the `render_song()` input.
+///
+/// The .spc file contains the audio driver, common audio data and song data.
+pub fn render_key(spc: &[u8], options: &RenderOptions) -> u64 {
+    let mut h = Fnv1a::new();
+    h.write(&RENDER_CACHE_VERSION.to_le_bytes());
+    h.write(env!("CARGO_PKG_VERSION").as_bytes());
+    h.write(&(spc.len() as u64).to_le_bytes());
+    h.write(spc);
+    h.write(&options.seconds.to_le_bytes());
+    h.write(&options.loops.to_le_bytes());
+    h.finish()
+}
+
+struct RenderCacheEntry {
+    key: u64,
+    /// Size of the WAV file, used to detect WAV files modified after they were rendered
+    file_size: u64,
+    song: RenderedSong,
+}
+
+/// Records the `render_key()` of the WAV files in a directory, so unchanged songs are not
+/// rendered again.
+///
+/// The cache is stored in a text file in the output directory, one WAV file per line:
+/// `<key> <file size> <frames> <loop point or -> <file name>`.
+pub struct RenderCache {
+    path: PathBuf,
+    entries: HashMap<String, RenderCacheEntry>,
+}
+
+fn parse_loop_point(s: &str) -> Option<Option<LoopPoint>> {
+    if s == "-" {
+        return Some(None);
+    }
+    let mut it = s.split(',');
+    let lp = LoopPoint {
+        start_tick: it.next()?.parse().ok()?,
+        length_ticks: it.next()?.parse().ok()?,
+        start_smp_clocks: it.next()?.parse().ok()?,
+        length_smp_clocks: it.next()?.parse().ok()?,
+    };
+    match it.next() {
+        None => Some(Some(lp)),
+        Some(_) => None,
+    }
+}
+
+fn parse_cache_line(line: &str) -> Option<(String, RenderCacheEntry)> {
+    let mut it = line.splitn(5, ' ');
+    let key = u64::from_str_radix(it.next()?, 16).ok()?;
+    let file_size = it.next()?.parse().ok()?;
+    let frames = it.next()?.parse().ok()?;
+    let loop_point = parse_loop_point(it.next()?)?;
+    let file_name = it.next()?.to_owned();
+
+    Some((
+        file_name,
+        RenderCacheEntry {
+            key,
+            file_size,
+            song: RenderedSong { frames, loop_point },
+        },
+    ))
+}
+
+fn file_size(path: &Path) -> Option<u64> {
+    fs::metadata(path).ok().map(|m| m.len())
+}
+
+impl RenderCache {
+    /// Reads the render cache file in `dir` (invalid lines are ignored)
+    pub fn load(dir: &Path) -> Self {
+        let path = dir.join(RENDER_CACHE_FILE_NAME);
+
+        let entries = match fs::read_to_string(&path) {
+            Ok(s) => s.lines().filter_map(parse_cache_line).collect(),
+            Err(_) => HashMap::new(),
+        };
+
+        Self { path, entries }
+    }
+
+    /// Returns the previous render of `file_name` if `key` is unchanged and the WAV file has not
+    /// been modified
+    pub fn get(&self, file_name: &str, key: u64) -> Option<RenderedSong> {
+        let e = self.entries.get(file_name)?;
+        let dir = self.path.parent()?;
+
+        match e.key == key && file_size(&dir.join(file_name)) == Some(e.file_size) {
+            true => Some(e.song),
+            false => None,
+        }
+    }
+
+    pub fn insert(&mut self, file_name: &str, key: u64, song: RenderedSong) {
+        let size = self
+            .path
+            .parent()
+            .and_then(|dir| file_size(&dir.join(file_name)));
+
+        match size {
+            Some(file_size) => self.entries.insert(
+                file_name.to_owned(),
+                RenderCacheEntry {
+                    key,
+                    file_size,
+                    song,
+                },
+            ),
+            None => self.entries.remove(file_name),
+        };
+    }
+
+    pub fn remove(&mut self, file_name: &str) {
+        self.entries.remove(file_name);
+    }
+
+    /// Writes the render cache file.
+    /// Errors are ignored, the cache is optional.
+    pub fn save(&self) {
+        let mut names: Vec<&String> = self.entries.keys().collect();
+        names.sort();
+
+        let mut out = String::new();
+        for name in names {
+            let e = &self.entries[name];
+            let lp = match &e.song.loop_point {
+                Some(lp) => format!(
+                    "{},{},{},{}",
+                    lp.start_tick, lp.length_ticks, lp.start_smp_clocks, lp.length_smp_clocks
+                ),
+                None => "-".to_owned(),
+            };
+            out += &format!(
+                "{:016x} {} {} {} {}\n",
+                e.key, e.file_size, e.song.frames, lp, name
+            );
+        }
+
+        let _ = fs::write(&self.path, out);
+    }
+}
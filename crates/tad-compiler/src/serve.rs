@@ -0,0 +1,476 @@
+//! Headless render server
+//!
+//! A long running HTTP/1.1 server that keeps the compiled projects (and the .spc snapshot of every
+//! song) in memory, so a build farm can render and check songs without reparsing and recompiling
+//! the project for every song.
+//!
+//! Requests:
+//!  * `GET /render?project=PATH&song=SONG[&seconds=N][&loops=N]` responds with a WAV file.
+//!    `SONG` is a song name or song number.
+//!  * `GET /check?project=PATH[&seconds=N]` plays every song in the emulator
+//!    (see `emulation_check::emulate_song()`) and responds with a JSON object containing the errors.
+//!
+//! `PATH` is relative to the server's root directory and MUST be inside it.
+//!
+//! Requests are processed by a fixed number of worker threads.  Connections are queued until a
+//! worker is free, a connection that does not fit in the queue is sent a `503` error.
+//!
+//! A project is recompiled if the project file or any of its sources has been modified.
+//! Errors are a JSON object with an `error` string.
+
+// SPDX-FileCopyrightText: © 2024 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+use crate::{
+    emulation_check, find_song_index, parallel_map, render, try_compile_project,
+    try_load_project_file,
+};
+
+use compiler::common_audio_data::CommonAudioData;
+use compiler::data::UniqueNamesProjectFile;
+use compiler::songs::SongData;
+use compiler::spc_file_export::export_spc_file;
+
+use std::collections::HashMap;
+use std::fs;
+use std::io::{self, BufRead, BufReader, Read, Write};
+use std::net::{TcpListener, TcpStream};
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{mpsc, Arc, Mutex};
+use std::time::{Duration, SystemTime};
+
+const DEFAULT_RENDER_SECONDS: u32 = 600;
+const DEFAULT_RENDER_LOOPS: u32 = 1;
+const DEFAULT_CHECK_SECONDS: u32 = 60;
+
+/// Maximum size of the request line and headers
+const MAX_REQUEST_SIZE: u64 = 16 * 1024;
+
+const READ_TIMEOUT: Duration = Duration::from_secs(30);
+
+/// Default number of requests to process in parallel
+pub const DEFAULT_WORKERS: usize = 4;
+
+/// Maximum number of connections waiting for a worker
+const MAX_QUEUED_CONNECTIONS: usize = 64;
+
+struct Project {
+    pf: UniqueNamesProjectFile,
+    common_audio_data: CommonAudioData,
+    songs: Vec<SongData>,
+    /// The .spc file of every song (a snapshot of the booted audio driver)
+    spc_files: Vec<Vec<u8>>,
+    /// The modification time of every file used to compile the project
+    sources: Vec<(PathBuf, Option<SystemTime>)>,
+}
+
+fn modified_time(path: &Path) -> Option<SystemTime> {
+    fs::metadata(path).and_then(|m| m.modified()).ok()
+}
+
+impl Project {
+    fn compile(path: &Path) -> Result<Self, String> {
+        let project_modified = modified_time(path);
+        let pf = try_load_project_file(path)?;
+
+        // Read the modification times before compiling so a file modified during compilation
+        // is recompiled by the next request
+        let source_paths = pf
+            .instruments
+            .list()
+            .iter()
+            .map(|i| &i.source)
+            .chain(pf.samples.list().iter().map(|s| &s.source))
+            .chain(pf.sound_effect_file.iter())
+            .chain(pf.songs.list().iter().map(|s| &s.source));
+
+        let mut sources = vec![(path.to_owned(), project_modified)];
+        sources.extend(source_paths.map(|s| {
+            let p = s.to_path(&pf.parent_path);
+            let m = modified_time(&p);
+            (p, m)
+        }));
+
+        let (common_audio_data, songs) = try_compile_project(&pf)?;
+
+        let spc_files = songs
+            .iter()
+            .map(|s| export_spc_file(&common_audio_data, s).map_err(|e| e.to_string()))
+            .collect::<Result<_, _>>()?;
+
+        Ok(Self {
+            pf,
+            common_audio_data,
+            songs,
+            spc_files,
+            sources,
+        })
+    }
+
+    fn is_modified(&self) -> bool {
+        self.sources.iter().any(|(p, m)| modified_time(p) != *m)
+    }
+}
+
+struct Server {
+    /// Canonical path of the directory containing the projects
+    root: PathBuf,
+    /// Number of threads used by each job
+    jobs: usize,
+    projects: Mutex<HashMap<PathBuf, Arc<Project>>>,
+    next_temp_file: AtomicU64,
+}
+
+impl Server {
+    /// Returns the canonical path of a project file inside `root`
+    fn project_path(&self, path: &str) -> Result<PathBuf, Response> {
+        // `canonicalize()` resolves `..` and symbolic links
+        let path = self
+            .root
+            .join(path)
+            .canonicalize()
+            .map_err(|e| Response::error(NOT_FOUND, &format!("cannot open project: {}", e)))?;
+
+        match path.starts_with(&self.root) {
+            true => Ok(path),
+            false => Err(Response::error(
+                FORBIDDEN,
+                "project is not inside the server's root directory",
+            )),
+        }
+    }
+
+    fn project(&self, path: &str) -> Result<Arc<Project>, Response> {
+        let path = self.project_path(path)?;
+
+        // Projects are compiled with the lock held so a project is never compiled twice
+        let mut projects = self.projects.lock().unwrap_or_else(|e| e.into_inner());
+
+        if let Some(p) = projects.get(&path) {
+            if !p.is_modified() {
+                return Ok(p.clone());
+            }
+        }
+        projects.remove(&path);
+
+        match Project::compile(&path) {
+            Ok(p) => {
+                let p = Arc::new(p);
+                projects.insert(path, p.clone());
+                Ok(p)
+            }
+            Err(e) => Err(Response::error(UNPROCESSABLE, &e)),
+        }
+    }
+
+    fn temp_wav_path(&self) -> PathBuf {
+        let n = self.next_temp_file.fetch_add(1, Ordering::Relaxed);
+        std::env::temp_dir().join(format!("tad-serve-{}-{}.wav", std::process::id(), n))
+    }
+}
+
+/// Listens on `address` and processes up to `workers` requests in parallel, with
+/// `jobs_per_worker` threads per request.
+///
+/// `root` MUST be a canonical path.
+///
+/// Only returns if the address cannot be bound.
+pub fn serve(address: &str, root: &Path, workers: usize, jobs_per_worker: usize) -> io::Result<()> {
+    let listener = TcpListener::bind(address)?;
+
+    eprintln!(
+        "Listening on {} ({} workers, {} threads per worker)",
+        listener.local_addr()?,
+        workers,
+        jobs_per_worker
+    );
+
+    let server = Server {
+        root: root.to_owned(),
+        jobs: jobs_per_worker.max(1),
+        projects: Mutex::new(HashMap::new()),
+        next_temp_file: AtomicU64::new(0),
+    };
+
+    let (sender, receiver) = mpsc::sync_channel::<TcpStream>(MAX_QUEUED_CONNECTIONS);
+    let receiver = Mutex::new(receiver);
+
+    std::thread::scope(|scope| {
+        for _ in 0..workers.max(1) {
+            let receiver = &receiver;
+            let server = &server;
+            scope.spawn(move || loop {
+                // The lock is released before the connection is processed
+                let stream = receiver.lock().unwrap_or_else(|e| e.into_inner()).recv();
+                let Ok(stream) = stream else {
+                    return;
+                };
+
+                if let Err(e) = process_connection(server, stream) {
+                    eprintln!("Connection error: {}", e);
+                }
+            });
+        }
+
+        for stream in listener.incoming().flatten() {
+            if let Err(mpsc::TrySendError::Full(stream)) = sender.try_send(stream) {
+                let r = Response::error(SERVICE_UNAVAILABLE, "too many queued requests");
+                if let Err(e) = write_response(&stream, r) {
+                    eprintln!("Connection error: {}", e);
+                }
+            }
+        }
+
+        // Stops the workers
+        drop(sender);
+    });
+
+    Ok(())
+}
+
+const OK: &str = "200 OK";
+const BAD_REQUEST: &str = "400 Bad Request";
+const FORBIDDEN: &str = "403 Forbidden";
+const NOT_FOUND: &str = "404 Not Found";
+const METHOD_NOT_ALLOWED: &str = "405 Method Not Allowed";
+const UNPROCESSABLE: &str = "422 Unprocessable Content";
+const INTERNAL_ERROR: &str = "500 Internal Server Error";
+const SERVICE_UNAVAILABLE: &str = "503 Service Unavailable";
+
+enum Body {
+    Json(String),
+    /// A temporary WAV file, deleted after it is sent
+    WavFile(PathBuf),
+}
+
+struct Response {
+    status: &'static str,
+    body: Body,
+}
+
+impl Response {
+    fn error(status: &'static str, message: &str) -> Self {
+        Self {
+            status,
+            body: Body::Json(format!("{{\"error\":{}}}", json_string(message))),
+        }
+    }
+}
+
+fn process_connection(server: &Server, stream: TcpStream) -> io::Result<()> {
+    stream.set_read_timeout(Some(READ_TIMEOUT))?;
+
+    let request_target = match read_request(&stream)? {
+        Ok(t) => t,
+        Err(r) => return write_response(&stream, r),
+    };
+
+    let response = process_request(server, &request_target).unwrap_or_else(|r| r);
+
+    write_response(&stream, response)
+}
+
+/// Reads the request line and headers, returning the request target of a GET request.
+///
+/// The request body (if any) is ignored.
+fn read_request(stream: &TcpStream) -> io::Result<Result<String, Response>> {
+    let mut reader = BufReader::new(stream.take(MAX_REQUEST_SIZE));
+
+    let mut request_line = String::new();
+    reader.read_line(&mut request_line)?;
+
+    loop {
+        let mut line = String::new();
+        if reader.read_line(&mut line)? == 0 {
+            return Ok(Err(Response::error(BAD_REQUEST, "incomplete request")));
+        }
+        if line.trim_end().is_empty() {
+            break;
+        }
+    }
+
+    let mut parts = request_line.split_ascii_whitespace();
+    match (parts.next(), parts.next()) {
+        (Some("GET"), Some(target)) => Ok(Ok(target.to_owned())),
+        (Some(_), Some(_)) => Ok(Err(Response::error(
+            METHOD_NOT_ALLOWED,
+            "only GET requests are supported",
+        ))),
+        _ => Ok(Err(Response::error(BAD_REQUEST, "invalid request line"))),
+    }
+}
+
+struct Query(Vec<(String, String)>);
+
+impl Query {
+    fn parse(query: &str) -> Result<Self, Response> {
+        query
+            .split('&')
+            .filter(|s| !s.is_empty())
+            .map(|s| {
+                let (k, v) = s.split_once('=').unwrap_or((s, ""));
+                match (percent_decode(k), percent_decode(v)) {
+                    (Some(k), Some(v)) => Ok((k, v)),
+                    _ => Err(Response::error(BAD_REQUEST, "invalid query string")),
+                }
+            })
+            .collect::<Result<_, _>>()
+            .map(Self)
+    }
+
+    fn get(&self, key: &str) -> Option<&str> {
+        self.0
+            .iter()
+            .find(|(k, _)| k == key)
+            .map(|(_, v)| v.as_str())
+    }
+
+    fn required(&self, key: &str) -> Result<&str, Response> {
+        self.get(key)
+            .ok_or_else(|| Response::error(BAD_REQUEST, &format!("missing {} parameter", key)))
+    }
+
+    fn u32_or(&self, key: &str, default: u32) -> Result<u32, Response> {
+        match self.get(key) {
+            None => Ok(default),
+            Some(v) => v
+                .parse()
+                .map_err(|_| Response::error(BAD_REQUEST, &format!("{} must be an integer", key))),
+        }
+    }
+}
+
+fn percent_decode(s: &str) -> Option<String> {
+    let mut out = Vec::with_capacity(s.len());
+    let mut bytes = s.bytes();
+
+    while let Some(b) = bytes.next() {
+        match b {
+            b'+' => out.push(b' '),
+            b'%' => {
+                let hex = [bytes.next()?, bytes.next()?];
+                out.push(u8::from_str_radix(std::str::from_utf8(&hex).ok()?, 16).ok()?);
+            }
+            b => out.push(b),
+        }
+    }
+
+    String::from_utf8(out).ok()
+}
+
+fn process_request(server: &Server, target: &str) -> Result<Response, Response> {
+    let (path, query) = target.split_once('?').unwrap_or((target, ""));
+    let query = Query::parse(query)?;
+
+    match path {
+        "/render" => render_request(server, &query),
+        "/check" => check_request(server, &query),
+        _ => Err(Response::error(NOT_FOUND, "unknown request")),
+    }
+}
+
+fn render_request(server: &Server, query: &Query) -> Result<Response, Response> {
+    let project = server.project(query.required("project")?)?;
+
+    let song = query.required("song")?;
+    let song_index = find_song_index(&project.pf, song)
+        .ok_or_else(|| Response::error(NOT_FOUND, &format!("cannot find song: {}", song)))?;
+
+    let options = render::RenderOptions {
+        seconds: query.u32_or("seconds", DEFAULT_RENDER_SECONDS)?,
+        loops: query.u32_or("loops", DEFAULT_RENDER_LOOPS)?,
+    };
+
+    let path = server.temp_wav_path();
+
+    match render::render_song(&project.spc_files[song_index], &path, &options, server.jobs) {
+        Ok(_) => Ok(Response {
+            status: OK,
+            body: Body::WavFile(path),
+        }),
+        Err(e) => {
+            let _ = fs::remove_file(&path);
+            Err(Response::error(INTERNAL_ERROR, &e))
+        }
+    }
+}
+
+fn check_request(server: &Server, query: &Query) -> Result<Response, Response> {
+    let project = server.project(query.required("project")?)?;
+    let seconds = query.u32_or("seconds", DEFAULT_CHECK_SECONDS)?;
+
+    let results = parallel_map(&project.songs, server.jobs, |song_data| {
+        emulation_check::emulate_song(&project.common_audio_data, song_data, seconds)
+    });
+
+    let errors: Vec<String> = project
+        .pf
+        .songs
+        .list()
+        .iter()
+        .zip(results)
+        .filter_map(|(song, r)| {
+            r.err().map(|e| {
+                format!(
+                    "{{\"song\":{},\"error\":{}}}",
+                    json_string(song.name.as_str()),
+                    json_string(&e)
+                )
+            })
+        })
+        .collect();
+
+    Ok(Response {
+        status: OK,
+        body: Body::Json(format!("{{\"errors\":[{}]}}", errors.join(","))),
+    })
+}
+
+fn write_response(stream: &TcpStream, response: Response) -> io::Result<()> {
+    let mut w = io::BufWriter::new(stream);
+
+    let header = |w: &mut io::BufWriter<&TcpStream>, content_type: &str, length: u64| {
+        write!(
+            w,
+            "HTTP/1.1 {}\r\nContent-Type: {}\r\nContent-Length: {}\r\nConnection: close\r\n\r\n",
+            response.status, content_type, length
+        )
+    };
+
+    match &response.body {
+        Body::Json(s) => {
+            header(&mut w, "application/json", s.len() as u64)?;
+            w.write_all(s.as_bytes())?;
+        }
+        Body::WavFile(path) => {
+            let r = fs::File::open(path).and_then(|mut f| {
+                header(&mut w, "audio/wav", f.metadata()?.len())?;
+                io::copy(&mut f, &mut w)
+            });
+            let _ = fs::remove_file(path);
+            r?;
+        }
+    }
+
+    w.flush()
+}
+
+fn json_string(s: &str) -> String {
+    let mut out = String::with_capacity(s.len() + 2);
+    out.push('"');
+    for c in s.chars() {
+        match c {
+            '"' => out.push_str("\\\""),
+            '\\' => out.push_str("\\\\"),
+            '\n' => out.push_str("\\n"),
+            '\r' => out.push_str("\\r"),
+            '\t' => out.push_str("\\t"),
+            c if u32::from(c) < 0x20 => out.push_str(&format!("\\u{:04x}", u32::from(c))),
+            c => out.push(c),
+        }
+    }
+    out.push('"');
+    out
+}
@@ -0,0 +1,85 @@
+//! Repeated bytecode sequence report
+
+// SPDX-FileCopyrightText: © 2025 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+use compiler::songs::SongData;
+use compiler::subroutine_candidates::SubroutineCandidate;
+
+use std::fmt::Write;
+
+/// Returns the name of the channel or subroutine containing `offset` and the offset within it
+fn bytecode_location(song: &SongData, offset: u16) -> String {
+    let block = song
+        .channels()
+        .iter()
+        .flatten()
+        .map(|c| (format!("channel {}", c.name), c.bytecode_offset))
+        .chain(
+            song.subroutines()
+                .iter()
+                .map(|s| (format!("!{}", s.identifier.as_str()), s.bytecode_offset)),
+        )
+        .filter(|(_, o)| *o <= offset)
+        .max_by_key(|(_, o)| *o);
+
+    match block {
+        Some((name, start)) => format!("{name}+{}", offset - start),
+        None => format!("{offset}"),
+    }
+}
+
+pub fn subroutine_report(song: &SongData, candidates: &[SubroutineCandidate]) -> String {
+    let mut out = String::new();
+
+    writeln!(
+        out,
+        "Song data: {} bytes, {} subroutines",
+        song.data().len(),
+        song.subroutines().len()
+    )
+    .unwrap();
+
+    if candidates.is_empty() {
+        out.push_str("No repeated bytecode sequences found\n");
+        return out;
+    }
+
+    let total_saved: usize = candidates.iter().map(|c| c.bytes_saved).sum();
+    writeln!(
+        out,
+        "Moving these sequences into subroutines would save {total_saved} bytes"
+    )
+    .unwrap();
+    writeln!(out).unwrap();
+
+    writeln!(
+        out,
+        "{:>5} {:>5} {:>12} {:>11} {:>11}  locations",
+        "saved", "size", "instructions", "occurrences", "call cycles"
+    )
+    .unwrap();
+
+    for c in candidates {
+        let locations: Vec<String> = c
+            .offsets
+            .iter()
+            .map(|&o| bytecode_location(song, o))
+            .collect();
+
+        writeln!(
+            out,
+            "{:>5} {:>5} {:>12} {:>11} {:>11}  {}",
+            c.bytes_saved,
+            c.size,
+            c.n_instructions,
+            c.offsets.len(),
+            c.call_cycles,
+            locations.join(", ")
+        )
+        .unwrap();
+    }
+
+    out
+}
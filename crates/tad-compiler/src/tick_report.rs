@@ -0,0 +1,181 @@
+//! Song tick S-SMP cycle report
+
+// SPDX-FileCopyrightText: © 2023 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+use compiler::driver_constants::{addresses, N_MUSIC_CHANNELS};
+use compiler::tick_cost::{
+    smp_clocks_to_cycles, TickCostEstimate, TickStep, TickTracker, CYCLES_PER_TIMER_CLOCK,
+};
+use compiler::time::TickClock;
+use shvc_sound_emu::{InvalidSpcFile, ShvcSoundEmu};
+
+use std::fmt::Write;
+
+/// The S-SMP cycles used by a single music tick
+pub struct TickCycles {
+    /// Number of music ticks processed before this tick
+    pub tick: u32,
+    /// Value of the audio driver's song tick counter at the start of the tick
+    pub song_tick_counter: u16,
+    /// S-SMP clock at the start of the tick
+    pub smp_clock: u64,
+    /// S-SMP cycles used by `process_music_channels()`
+    pub cycles: u64,
+    /// S-SMP cycles used by each music channel's bytecode
+    pub bytecode_cycles: [u64; N_MUSIC_CHANNELS],
+}
+
+/// Steps `emu` one instruction at a time until `process_music_channels()` returns.
+///
+/// ASSUMES: the program counter is `addresses::PROCESS_MUSIC_CHANNELS_CODE`
+fn measure_tick(emu: &mut ShvcSoundEmu, tick: u32, smp_clock: u64) -> Option<TickCycles> {
+    let song_tick_counter = u16::from_le_bytes([
+        emu.apuram()[usize::from(addresses::SONG_TICK_COUNTER)],
+        emu.apuram()[usize::from(addresses::SONG_TICK_COUNTER) + 1],
+    ]);
+
+    let mut tracker = TickTracker::new(emu.smp_registers().sp);
+
+    loop {
+        let r = emu.smp_registers();
+
+        match tracker.next_instruction(r.pc, r.sp, r.x) {
+            TickStep::Ended => break,
+            TickStep::TimedOut => return None,
+            TickStep::ChannelOverhead | TickStep::Bytecode { .. } => (),
+        }
+
+        // Executes a single instruction
+        tracker.add_clocks(emu.fast_forward(1));
+    }
+
+    Some(TickCycles {
+        tick,
+        song_tick_counter,
+        smp_clock,
+        cycles: smp_clocks_to_cycles(tracker.smp_clocks()),
+        bytecode_cycles: tracker.bytecode_smp_clocks().map(smp_clocks_to_cycles),
+    })
+}
+
+/// Plays a .spc file exported by `export_spc_file()` for `seconds` and measures the S-SMP cycles
+/// used by every music tick.
+///
+/// Returns an error if the song tick never ends (ie, the audio driver crashed).
+pub fn measure_song_ticks(spc: &[u8], seconds: u32) -> Result<Vec<TickCycles>, String> {
+    let mut emu = ShvcSoundEmu::new(&[0; 64]);
+    emu.load_spc(spc)
+        .map_err(|InvalidSpcFile| "Invalid .spc file".to_owned())?;
+
+    let end_clock = u64::from(seconds) * ShvcSoundEmu::SMP_CLOCKS_PER_SECOND;
+
+    let mut ticks = Vec::new();
+    let mut smp_clock = 0;
+
+    while smp_clock < end_clock {
+        let r = emu.run_until_pc(
+            addresses::PROCESS_MUSIC_CHANNELS_CODE,
+            end_clock - smp_clock,
+        );
+        smp_clock += r.smp_clocks;
+        if !r.hit {
+            break;
+        }
+
+        let tick_number = ticks.len().try_into().unwrap_or(u32::MAX);
+        match measure_tick(&mut emu, tick_number, smp_clock) {
+            Some(t) => {
+                // 2 clocks per S-SMP cycle (S-SMP clocks are always even)
+                smp_clock += t.cycles * 2;
+                ticks.push(t);
+            }
+            None => return Err(format!("Music tick {tick_number} did not end")),
+        }
+    }
+
+    Ok(ticks)
+}
+
+/// Returns a table of the `n_rows` most expensive ticks.
+///
+/// The tick budget is the number of S-SMP cycles between song ticks at the song's starting tempo.
+///
+/// If `estimate` is not None, the compiler's estimated worst-case cycles for the song tick is
+/// printed next to the measured cycles.
+pub fn tick_report(
+    ticks: &[TickCycles],
+    tick_clock: TickClock,
+    estimate: Option<&TickCostEstimate>,
+    n_rows: usize,
+) -> String {
+    let budget = u64::from(tick_clock.as_u8()) * u64::from(CYCLES_PER_TIMER_CLOCK);
+    let percent = |c: u64| c as f64 * 100.0 / budget as f64;
+
+    let mut out = String::new();
+
+    if ticks.is_empty() {
+        out.push_str("No music ticks\n");
+        return out;
+    }
+
+    let total: u64 = ticks.iter().map(|t| t.cycles).sum();
+    let mean = total / ticks.len() as u64;
+    let over_budget = ticks.iter().filter(|t| t.cycles > budget).count();
+
+    writeln!(
+        out,
+        "Tick budget: {budget} S-SMP cycles (tick clock {})",
+        tick_clock.as_u8()
+    )
+    .unwrap();
+    writeln!(
+        out,
+        "Music ticks: {}, mean {mean} cycles ({:.1}%), {over_budget} over budget",
+        ticks.len(),
+        percent(mean)
+    )
+    .unwrap();
+    writeln!(out).unwrap();
+
+    let mut worst: Vec<&TickCycles> = ticks.iter().collect();
+    worst.sort_by(|a, b| b.cycles.cmp(&a.cycles).then(a.tick.cmp(&b.tick)));
+    worst.truncate(n_rows);
+
+    write!(
+        out,
+        "{:>8} {:>9} {:>8} {:>7} {:>8} ",
+        "tick", "time", "cycles", "budget", "estimate"
+    )
+    .unwrap();
+    for c in 'A'..='H' {
+        write!(out, " {c:>6}").unwrap();
+    }
+    writeln!(out).unwrap();
+
+    for t in worst {
+        let seconds = t.smp_clock as f64 / ShvcSoundEmu::SMP_CLOCKS_PER_SECOND as f64;
+
+        let estimated = estimate
+            .and_then(|e| e.cycles.get(usize::from(t.song_tick_counter)))
+            .map(|c| c.to_string())
+            .unwrap_or_default();
+
+        write!(
+            out,
+            "{:>8} {:>8.2}s {:>8} {:>6.1}% {estimated:>8} ",
+            t.song_tick_counter,
+            seconds,
+            t.cycles,
+            percent(t.cycles)
+        )
+        .unwrap();
+        for b in t.bytecode_cycles {
+            write!(out, " {b:>6}").unwrap();
+        }
+        writeln!(out).unwrap();
+    }
+
+    out
+}
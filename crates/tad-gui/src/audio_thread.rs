@@ -6,7 +6,7 @@
 
 #![allow(clippy::assertions_on_constants)]
 
-use brr::{BrrSample, SAMPLES_PER_BLOCK};
+use brr::BrrSample;
 use compiler::audio_driver;
 use compiler::bytecode_interpreter;
 use compiler::bytecode_interpreter::Emulator;
@@ -17,29 +17,46 @@ use compiler::driver_constants::N_DSP_VOICES;
 use compiler::driver_constants::N_MUSIC_CHANNELS;
 use compiler::driver_constants::SONG_HEADER_ECHO_EDL;
 use compiler::driver_constants::{
-    addresses, io_commands, LoaderDataType, FIRST_SFX_CHANNEL, IO_COMMAND_I_MASK, IO_COMMAND_MASK,
-    N_SFX_CHANNELS,
+    addresses, io_commands, LoaderDataType, BC_CHANNEL_STACK_OFFSET, BC_CHANNEL_STACK_SIZE,
+    FIRST_SFX_CHANNEL, IO_COMMAND_I_MASK, IO_COMMAND_MASK, N_SFX_CHANNELS, SFX_TICK_CLOCK,
 };
+use compiler::fnv1a::Fnv1a;
 use compiler::mml::MmlPrefixData;
-use compiler::songs::{blank_song, SongData};
+use compiler::songs::{blank_song, song_diff, SongData};
 use compiler::sound_effects::CompiledSoundEffect;
-use compiler::time::TickCounter;
+use compiler::time::{TickCounter, TIMER_HZ};
 use compiler::Pan;
 
 use sdl2::Sdl;
-use shvc_sound_emu::ShvcSoundEmu;
+use shvc_sound_emu::{
+    snapshot_buffer, AudioMeters, DspAuditionVoice, EchoGuardHit, EmulatorBatch, MonitorLayout,
+    MonitorSnapshot, SharedStateView, ShvcSoundEmu, SnapshotReader, SnapshotWriter,
+};
 
 extern crate sdl2;
 use sdl2::audio::{AudioCallback, AudioDevice, AudioSpecDesired};
 
+use std::cell::RefCell;
+use std::fs;
 use std::ops::Range;
-use std::sync::{mpsc, Arc, Mutex};
+use std::path::{Path, PathBuf};
+use std::rc::Rc;
+use std::sync::atomic::{AtomicBool, AtomicI16, AtomicU32, AtomicUsize, Ordering};
+use std::sync::{mpsc, Arc};
 use std::thread;
-use std::time::Duration;
+use std::time::{Duration, Instant};
 
 use crate::compiler_thread::CommonAudioDataWithSfx;
 use crate::compiler_thread::ItemId;
+use crate::intro_cache::{
+    lock_intro, Intro, IntroCache, IntroRenderer, SharedIntro, INTRO_CHUNKS, SNAPSHOT_INTERVAL,
+};
+use crate::note_cache::{CachedInstrument, CachedNote, NoteCache, NoteCacheJob, ATTACK_CHUNKS};
+use crate::session_recorder::{SessionInput, SessionRecorder};
 use crate::sfx_export_order::SfxId;
+use crate::song_checkpoints::{SongCheckpoints, CHECKPOINT_INTERVAL};
+use crate::speculative_renderer::{SpeculativeChunk, SpeculativeRenderer};
+use crate::standby_loader::StandbyLoader;
 use crate::GuiMessage;
 
 /// Sample rate to run the audio driver at
@@ -51,6 +68,41 @@ const BRR_SAMPLE_RATE: i32 = 32000;
 /// Approximate number of samples to play a looping BRR sample for
 const LOOPING_BRR_SAMPLE_SAMPLES: usize = 24000;
 
+/// Number of samples to play after a BRR sample has been keyed off
+/// (the S-DSP release envelope takes 256 samples)
+const BRR_SAMPLE_RELEASE_SAMPLES: usize = 512;
+
+/// Number of samples in a `test_sample_song()` tick.
+const SFX_TICK_SAMPLES: usize =
+    SFX_TICK_CLOCK as usize * (ShvcSoundEmu::SAMPLE_RATE / TIMER_HZ) as usize;
+
+/// Maximum `test_sample_song()` note length
+const MAX_INSTRUMENT_NOTE_TICKS: u32 = 2000;
+
+/// Maximum number of S-SMP clocks to wait for the audio driver to initialise
+const DRIVER_BOOT_TIMEOUT_SMP_CLOCKS: u64 = ShvcSoundEmu::SMP_CLOCKS_PER_SECOND;
+
+/// Maximum number of S-SMP clocks between song ticks (timer 0 at 8KHz with a divider of 256)
+const MAX_SMP_CLOCKS_PER_TICK: u64 = 256 * 256;
+
+/// Maximum number of song ticks the audio thread will emulate to catch a standby emulator up
+/// with the playing song.
+/// A standby emulator that is further behind is reloaded ahead of the playing song.
+const MAX_STANDBY_CATCH_UP_TICKS: u16 = 32;
+
+/// Name of the shared memory segment published by `AudioMessage::SetSharedStateView`
+const SHARED_STATE_VIEW_NAME: &str = "terrific-audio-driver";
+
+const MONITOR_LAYOUT: MonitorLayout = MonitorLayout {
+    song_ptr: addresses::SONG_PTR,
+    song_tick_counter: addresses::SONG_TICK_COUNTER,
+    music_channels_mask: addresses::IO_MUSIC_CHANNELS_MASK,
+    instruction_ptr_l: addresses::CHANNEL_INSTRUCTION_PTR_L,
+    instruction_ptr_h: addresses::CHANNEL_INSTRUCTION_PTR_H,
+    volume: addresses::CHANNEL_VOLUME,
+    pan: addresses::CHANNEL_PAN,
+};
+
 // Amount of Audio-RAM (in common-audio-data) to allocate to sound effects
 pub const SFX_BUFFER_SIZE: usize = 128;
 
@@ -101,6 +153,23 @@ pub enum AudioMessage {
 
     SetStereoFlag(StereoFlag),
 
+    // Buffer less audio (increases the buffer size on every underrun).
+    // The SDL audio device buffer size changes the next time the device is opened.
+    SetLowLatency(bool),
+
+    // Write the changed bytecode of a recompiled song into the playing song (see `SongRecompiled`)
+    SetLiveSongPatching(bool),
+
+    // Load a recompiled playing song into a standby emulator (on a background thread) and switch
+    // to it at a chunk boundary, without stopping playback (see `SongRecompiled`).
+    // Live song patching is used instead if it is enabled and the patch can be applied.
+    SetStandbyReload(bool),
+
+    // Publish the Audio-RAM, S-DSP registers and channel state to a shared memory segment after
+    // every emulated chunk (for external visualizers).
+    // Disables speculative rendering and pre-rendered intros.
+    SetSharedStateView(bool),
+
     // Stop audio and close the audio device
     StopAndClose,
 
@@ -128,9 +197,37 @@ pub enum AudioMessage {
     PlaySfxUsingSfxBuffer(Arc<CompiledSoundEffect>, Pan),
     PlaySample(CommonAudioData, Box<SongData>),
 
+    // Pre-render the instrument's notes (does nothing if they have already been rendered)
+    CacheInstrumentNotes(ItemId, Box<NoteCacheJob>),
+    // Plays the note from the note cache (if the instrument is in the cache),
+    // otherwise plays the `test_sample_song()` with the audio driver.
+    PlayInstrumentNote(ItemId, InstrumentNote, CommonAudioData, Box<SongData>),
+
+    // The song has been successfully compiled.
+    // If live song patching is enabled and ItemId is playing, the changed channel bytecode is
+    // written to Audio-RAM the next time no channel is reading it.
+    SongRecompiled(ItemId, Arc<SongData>),
+
     PlayBrrSampleAt32Khz(Arc<BrrSample>),
 }
 
+/// A note played by the instrument editor
+#[derive(Debug, Copy, Clone)]
+pub struct InstrumentNote {
+    pub note_id: u8,
+    /// In `test_sample_song()` ticks
+    pub note_length: u32,
+    pub adsr1: u8,
+    pub adsr2_or_gain: u8,
+}
+
+impl InstrumentNote {
+    /// Number of samples before the note is keyed off
+    fn key_off_samples(&self) -> usize {
+        self.note_length.min(MAX_INSTRUMENT_NOTE_TICKS) as usize * SFX_TICK_SAMPLES
+    }
+}
+
 #[derive(Debug, Copy, Clone)]
 pub enum StereoFlag {
     Mono,
@@ -155,6 +252,13 @@ pub struct AudioMonitorData {
     pub voice_instruction_ptrs: [Option<u16>; N_MUSIC_CHANNELS],
     /// May not be valid.
     pub voice_return_inst_ptrs: [Option<u16>; N_MUSIC_CHANNELS],
+    /// Audio driver channel variables and S-DSP voice state
+    /// (zeroed if a song is not playing)
+    pub channels: MonitorSnapshot,
+
+    pub playback: PlaybackStats,
+    /// Voice and main output levels of the last emulated audio
+    pub meters: AudioMeters,
 }
 
 impl AudioMonitorData {
@@ -163,246 +267,772 @@ impl AudioMonitorData {
             song_id,
             voice_instruction_ptrs: Default::default(),
             voice_return_inst_ptrs: Default::default(),
+            channels: MonitorSnapshot::default(),
+            playback: PlaybackStats::default(),
+            meters: AudioMeters::default(),
         }
     }
 }
 
+/// The audio thread side of the `AudioMonitor`
+struct AudioMonitorWriter {
+    writer: SnapshotWriter<Option<AudioMonitorData>>,
+}
+
+impl AudioMonitorWriter {
+    fn set(&mut self, data: Option<AudioMonitorData>) {
+        self.writer.write(data);
+    }
+}
+
+/// The latest `AudioMonitorData` published by the audio thread.
+///
+/// Written once per emulated chunk, read by the GUI thread without locking.
 #[derive(Clone)]
 pub struct AudioMonitor {
-    data: Arc<Mutex<Option<AudioMonitorData>>>,
+    // The reader is shared by the GUI thread's widgets (not between threads)
+    reader: Rc<RefCell<SnapshotReader<Option<AudioMonitorData>>>>,
 }
 
 impl AudioMonitor {
+    fn new() -> (AudioMonitorWriter, Self) {
+        let (writer, reader) = snapshot_buffer();
+        (
+            AudioMonitorWriter { writer },
+            Self {
+                reader: Rc::new(RefCell::new(reader)),
+            },
+        )
+    }
+
+    pub fn get(&self) -> Option<AudioMonitorData> {
+        self.reader.borrow_mut().read().clone()
+    }
+}
+
+/// Ring buffer latency and underruns, displayed in the GUI.
+#[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+pub struct PlaybackStats {
+    /// Approximate time between emulating a sample and hearing it
+    pub latency_ms: u32,
+    /// Number of SDL callbacks that read past the end of the emulated audio
+    pub underruns: u32,
+    /// Audio thread timing histograms of the last `PerformanceWindow::DURATION`
+    pub performance: AudioPerformance,
+}
+
+/// Power-of-two histogram, bucket `n` counts the values in `2^n..2^(n+1)` (bucket 0 includes 0).
+#[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+pub struct Log2Histogram {
+    pub buckets: [u32; Log2Histogram::N_BUCKETS],
+}
+
+impl Log2Histogram {
+    pub const N_BUCKETS: usize = 17;
+
+    fn bucket(value: u64) -> usize {
+        let b = (u64::BITS - value.leading_zeros()).saturating_sub(1);
+        (b as usize).min(Self::N_BUCKETS - 1)
+    }
+
+    /// Exclusive upper bound of bucket `b`
+    pub fn bucket_end(b: usize) -> u64 {
+        2 << b
+    }
+
+    fn add(&mut self, value: u64) {
+        let b = &mut self.buckets[Self::bucket(value)];
+        *b = b.saturating_add(1);
+    }
+
+    fn merge(&mut self, other: &Self) {
+        for (b, o) in self.buckets.iter_mut().zip(other.buckets) {
+            *b = b.saturating_add(o);
+        }
+    }
+
+    pub fn count(&self) -> u32 {
+        self.buckets.iter().fold(0, |acc, b| acc.saturating_add(*b))
+    }
+
+    /// Returns the upper bound of the bucket containing the `percent` percentile
+    /// (None if the histogram is empty)
+    pub fn percentile(&self, percent: u32) -> Option<u64> {
+        let count = u64::from(self.count());
+        if count == 0 {
+            return None;
+        }
+        let target = (count * u64::from(percent)).div_ceil(100).max(1);
+
+        let mut sum = 0;
+        for (i, b) in self.buckets.iter().enumerate() {
+            sum += u64::from(*b);
+            if sum >= target {
+                return Some(Self::bucket_end(i));
+            }
+        }
+        Some(Self::bucket_end(Self::N_BUCKETS - 1))
+    }
+}
+
+/// `Log2Histogram` that can be written by the SDL callback while the audio thread reads it
+#[derive(Default)]
+struct AtomicLog2Histogram {
+    buckets: [AtomicU32; Log2Histogram::N_BUCKETS],
+}
+
+impl AtomicLog2Histogram {
+    fn add(&self, value: u64) {
+        self.buckets[Log2Histogram::bucket(value)].fetch_add(1, Ordering::Relaxed);
+    }
+
+    /// Returns and clears the histogram
+    fn take(&self) -> Log2Histogram {
+        Log2Histogram {
+            buckets: std::array::from_fn(|i| self.buckets[i].swap(0, Ordering::Relaxed)),
+        }
+    }
+}
+
+/// Audio thread and SDL callback timing histograms (all values in microseconds).
+///
+/// Used to tell the causes of an underrun apart:
+/// slow emulation (`emulate`), a late audio thread (`fill_level`) or
+/// irregular SDL callbacks (`callback_interval`).
+#[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+pub struct AudioPerformance {
+    /// Time taken to emulate a `RingBuffer::EMU_BUFFER_SAMPLES` chunk
+    pub emulate: Log2Histogram,
+    /// Amount of buffered audio at the start of each SDL callback
+    pub fill_level: Log2Histogram,
+    /// Time between SDL callbacks
+    pub callback_interval: Log2Histogram,
+    /// Duration of a `RingBuffer::EMU_BUFFER_SAMPLES` chunk
+    pub chunk_duration: u32,
+}
+
+/// Accumulates `AudioPerformance` histograms and publishes them once per `DURATION`
+struct PerformanceWindow {
+    start: Instant,
+    current: AudioPerformance,
+    last: AudioPerformance,
+}
+
+impl PerformanceWindow {
+    const DURATION: Duration = Duration::from_secs(1);
+
     fn new() -> Self {
         Self {
-            data: Arc::new(Mutex::default()),
+            start: Instant::now(),
+            current: AudioPerformance::default(),
+            last: AudioPerformance::default(),
         }
     }
 
-    fn set(&mut self, data: Option<AudioMonitorData>) {
-        *self.data.lock().unwrap() = data;
-    }
+    fn update(&mut self, state: &RingBufferState, chunk_duration: u32) {
+        self.current.fill_level.merge(&state.fill_level.take());
+        self.current
+            .callback_interval
+            .merge(&state.callback_interval.take());
 
-    pub fn get(&self) -> Option<AudioMonitorData> {
-        match self.data.lock() {
-            Ok(d) => d.clone(),
-            Err(_) => None,
+        if self.start.elapsed() >= Self::DURATION {
+            self.current.chunk_duration = chunk_duration;
+            self.last = std::mem::take(&mut self.current);
+            self.start = Instant::now();
         }
     }
 }
 
-struct RingBuffer {
+fn micros(d: Duration) -> u64 {
+    d.as_micros().try_into().unwrap_or(u64::MAX)
+}
+
+/// Audio samples shared between the audio thread and the SDL audio callback.
+///
+/// A wait-free single-producer single-consumer ring buffer.
+/// The audio thread writes `RingBuffer::EMU_BUFFER_SIZE` chunks, the SDL callback reads them.
+/// Neither side locks the `AudioDevice` to access the buffer.
+///
+/// The positions count the number of `i16` values read or written since the buffer was reset.
+/// They are not wrapped to the buffer size, the amount of buffered audio is
+/// `write_pos - read_pos` (negative after an underrun).
+struct RingBufferState {
+    // Accessed with `Relaxed` ordering, the positions order the samples.
+    buffer: Box<[AtomicI16]>,
+
+    // Only written by the SDL callback (or `RingBuffer::reset()` when the callback is locked)
+    read_pos: AtomicUsize,
+    // Only written by the audio thread
+    write_pos: AtomicUsize,
+
+    underruns: AtomicU32,
+
+    // Written by the SDL callback, taken by `RingBuffer::consumed_message_received()`
+    fill_level: AtomicLog2Histogram,
+    callback_interval: AtomicLog2Histogram,
+    // `i16` values per second, used by the SDL callback to convert the fill level into time
+    values_per_second: AtomicUsize,
+
+    // Set when the SDL callback sends `AudioMessage::RingBufferConsumed`,
+    // cleared when the audio thread receives it.
+    wakeup_pending: AtomicBool,
+}
+
+/// The SDL audio callback (ring buffer consumer)
+struct RingBufferCallback {
     sender: mpsc::Sender<AudioMessage>,
+    state: Arc<RingBufferState>,
+    last_callback: Option<Instant>,
+}
+
+/// The audio thread's end of the ring buffer (ring buffer producer)
+struct RingBuffer {
+    state: Arc<RingBufferState>,
+    chunk: [i16; Self::EMU_BUFFER_SIZE],
 
-    buffer: [i16; Self::BUFFER_SIZE],
-    read_cursor: usize,
-    write_cursor: usize,
+    /// Size of the SDL audio device buffer (in `i16` values)
+    device_buffer_size: usize,
+    /// `i16` values per second
+    values_per_second: usize,
+
+    low_latency: bool,
+    /// The amount of audio to buffer (in `i16` values)
+    fill_limit: usize,
+    /// Underruns processed by `consumed_message_received()`
+    underruns_seen: u32,
+
+    performance: PerformanceWindow,
 }
 
 impl RingBuffer {
     const SDL_BUFFER_SAMPLES: usize = 2048;
-    const EMU_BUFFER_SAMPLES: usize = ShvcSoundEmu::AUDIO_BUFFER_SAMPLES;
+    /// SDL audio device buffer size in low latency mode
+    const LOW_LATENCY_SDL_BUFFER_SAMPLES: usize = 256;
+
+    // The emulator writes directly into the ring buffer, chunks do not need to match
+    // `ShvcSoundEmu::AUDIO_BUFFER_SAMPLES`.
+    const EMU_BUFFER_SAMPLES: usize = 256;
     const BUFFER_SAMPLES: usize = Self::SDL_BUFFER_SAMPLES + Self::EMU_BUFFER_SAMPLES * 2;
 
     const BUFFER_SIZE: usize = Self::BUFFER_SAMPLES * 2;
     const EMU_BUFFER_SIZE: usize = Self::EMU_BUFFER_SAMPLES * 2;
 
-    fn new(sender: mpsc::Sender<AudioMessage>) -> Self {
+    /// Maximum `fill_limit`.
+    ///
+    /// Ensures the audio thread never writes to the part of the buffer the SDL callback is reading.
+    const MAX_FILL_LIMIT: usize = Self::BUFFER_SIZE - Self::EMU_BUFFER_SIZE;
+
+    fn new(sender: mpsc::Sender<AudioMessage>) -> (Self, RingBufferCallback) {
         const _: () = assert!(RingBuffer::SDL_BUFFER_SAMPLES % RingBuffer::EMU_BUFFER_SAMPLES == 0);
         const _: () = assert!(
             RingBuffer::SDL_BUFFER_SAMPLES + RingBuffer::EMU_BUFFER_SAMPLES
                 < RingBuffer::BUFFER_SAMPLES
         );
 
-        Self {
-            sender,
-            buffer: [0; Self::BUFFER_SIZE],
-            read_cursor: 0,
-            write_cursor: Self::EMU_BUFFER_SIZE,
+        let state = Arc::new(RingBufferState {
+            buffer: (0..Self::BUFFER_SIZE).map(|_| AtomicI16::new(0)).collect(),
+            read_pos: AtomicUsize::new(0),
+            write_pos: AtomicUsize::new(Self::EMU_BUFFER_SIZE),
+            underruns: AtomicU32::new(0),
+            fill_level: AtomicLog2Histogram::default(),
+            callback_interval: AtomicLog2Histogram::default(),
+            values_per_second: AtomicUsize::new(APU_SAMPLE_RATE as usize * 2),
+            wakeup_pending: AtomicBool::new(false),
+        });
+
+        (
+            Self {
+                state: state.clone(),
+                chunk: [0; Self::EMU_BUFFER_SIZE],
+                device_buffer_size: Self::SDL_BUFFER_SAMPLES * 2,
+                values_per_second: APU_SAMPLE_RATE as usize * 2,
+                low_latency: false,
+                fill_limit: Self::MAX_FILL_LIMIT,
+                underruns_seen: 0,
+                performance: PerformanceWindow::new(),
+            },
+            RingBufferCallback {
+                sender,
+                state,
+                last_callback: None,
+            },
+        )
+    }
+
+    fn open_playback(
+        audio_subsystem: &sdl2::AudioSubsystem,
+        desired_spec: &AudioSpecDesired,
+        sender: mpsc::Sender<AudioMessage>,
+        low_latency: bool,
+    ) -> (Self, AudioDevice<RingBufferCallback>) {
+        let (mut ring_buffer, callback) = Self::new(sender);
+
+        let mut desired_spec = AudioSpecDesired {
+            freq: desired_spec.freq,
+            channels: desired_spec.channels,
+            samples: desired_spec.samples,
+        };
+        if low_latency {
+            desired_spec.samples = Some(Self::LOW_LATENCY_SDL_BUFFER_SAMPLES.try_into().unwrap());
+        }
+
+        let playback = audio_subsystem
+            .open_playback(None, &desired_spec, |_spec| callback)
+            .unwrap();
+
+        let spec = playback.spec();
+        let channels = usize::from(spec.channels);
+        ring_buffer.device_buffer_size = usize::from(spec.samples) * channels;
+        ring_buffer.values_per_second = usize::try_from(spec.freq).unwrap_or(1) * channels;
+        ring_buffer
+            .state
+            .values_per_second
+            .store(ring_buffer.values_per_second, Ordering::Relaxed);
+        ring_buffer.set_low_latency(low_latency);
+
+        (ring_buffer, playback)
+    }
+
+    /// In low latency mode, the ring buffer starts with the smallest fill limit the SDL audio
+    /// device allows and the limit is increased after every underrun.
+    fn set_low_latency(&mut self, low_latency: bool) {
+        self.low_latency = low_latency;
+        self.fill_limit = match low_latency {
+            true => Self::MAX_FILL_LIMIT.min(
+                self.device_buffer_size
+                    .next_multiple_of(Self::EMU_BUFFER_SIZE)
+                    + Self::EMU_BUFFER_SIZE,
+            ),
+            false => Self::MAX_FILL_LIMIT,
+        };
+    }
+
+    fn playback_stats(&self) -> PlaybackStats {
+        let buffered = self.fill_limit + self.device_buffer_size;
+
+        PlaybackStats {
+            latency_ms: (buffered * 1000 / self.values_per_second.max(1))
+                .try_into()
+                .unwrap_or(u32::MAX),
+            underruns: self.underruns_seen,
+            performance: self.performance.last,
+        }
+    }
+
+    /// Clears the buffer and fills the first `fill_limit` values with silence.
+    ///
+    /// Locks `playback` to prevent the SDL callback from reading the buffer.
+    fn reset(&mut self, playback: &mut AudioDevice<RingBufferCallback>) {
+        let _lock = playback.lock();
+
+        let s = &*self.state;
+        s.buffer.iter().for_each(|b| b.store(0, Ordering::Relaxed));
+
+        // Silence prevents an underrun when playback is resumed before the buffer is refilled.
+        let write_pos = self.fill_limit - self.fill_limit % Self::EMU_BUFFER_SIZE;
+
+        s.read_pos.store(0, Ordering::Relaxed);
+        s.write_pos.store(write_pos, Ordering::Relaxed);
+    }
+
+    /// Must be called when the audio thread receives a `RingBufferConsumed` message.
+    fn consumed_message_received(&mut self) {
+        let s = &*self.state;
+
+        s.wakeup_pending.store(false, Ordering::Release);
+
+        let underruns = s.underruns.load(Ordering::Relaxed);
+        if underruns != self.underruns_seen {
+            self.underruns_seen = underruns;
+
+            if self.low_latency {
+                self.fill_limit =
+                    (self.fill_limit + Self::EMU_BUFFER_SIZE).min(Self::MAX_FILL_LIMIT);
+            }
         }
+
+        let chunk_duration =
+            Self::EMU_BUFFER_SIZE as u64 * 1_000_000 / self.values_per_second.max(1) as u64;
+        self.performance
+            .update(s, chunk_duration.try_into().unwrap_or(u32::MAX));
     }
 
-    /// Clears the buffer and reset the cursors.
-    fn reset(&mut self) {
-        self.buffer.fill(0);
+    /// Number of `i16` values in the buffer (negative after an underrun)
+    fn buffered(&self) -> isize {
+        let s = &*self.state;
 
-        self.read_cursor = 0;
-        self.write_cursor = Self::EMU_BUFFER_SIZE;
+        let write_pos = s.write_pos.load(Ordering::Relaxed);
+        let read_pos = s.read_pos.load(Ordering::Acquire);
+
+        write_pos.wrapping_sub(read_pos) as isize
     }
 
     fn is_buffer_full(&self) -> bool {
-        self.write_cursor / RingBuffer::EMU_BUFFER_SIZE
-            == self.read_cursor / RingBuffer::EMU_BUFFER_SIZE
+        self.buffered() + (Self::EMU_BUFFER_SIZE as isize) > (self.fill_limit as isize)
     }
 
     /// Returns true if the buffer is full
     fn add_chunk(&mut self, samples: &[i16; Self::EMU_BUFFER_SIZE]) -> bool {
-        const _: () = assert!(RingBuffer::BUFFER_SIZE % RingBuffer::EMU_BUFFER_SIZE == 0);
+        self.write_chunk(|chunk| chunk.copy_from_slice(samples))
+    }
 
-        assert!(self.write_cursor % RingBuffer::EMU_BUFFER_SIZE == 0);
+    /// Calls `f` to emulate the next chunk into the ring buffer and records the time taken.
+    ///
+    /// Returns true if the buffer is full
+    fn emulate_chunk(&mut self, f: impl FnOnce(&mut [i16; Self::EMU_BUFFER_SIZE])) -> bool {
+        let mut elapsed = Duration::ZERO;
+        let full = self.write_chunk(|chunk| {
+            let start = Instant::now();
+            f(chunk);
+            elapsed = start.elapsed();
+        });
+        self.performance.current.emulate.add(micros(elapsed));
 
-        let wc = self.write_cursor;
-        let wc_end = wc + Self::EMU_BUFFER_SIZE;
+        full
+    }
 
-        self.buffer[wc..wc_end].copy_from_slice(samples);
+    /// Calls `f` to write the next chunk into the ring buffer.
+    ///
+    /// Returns true if the buffer is full
+    fn write_chunk(&mut self, f: impl FnOnce(&mut [i16; Self::EMU_BUFFER_SIZE])) -> bool {
+        f(&mut self.chunk);
 
-        self.write_cursor = if wc_end < self.buffer.len() {
-            wc_end
-        } else {
-            0
-        };
+        self.store_chunk(|b, i| b.store(self.chunk[i], Ordering::Relaxed));
 
         self.is_buffer_full()
     }
 
     fn fill_remaining_with_silence(&mut self) {
         while !self.is_buffer_full() {
-            assert!(self.write_cursor % RingBuffer::EMU_BUFFER_SIZE == 0);
+            self.store_chunk(|b, _| b.store(0, Ordering::Relaxed));
+        }
+    }
 
-            let wc = self.write_cursor;
-            let wc_end = wc + Self::EMU_BUFFER_SIZE;
+    /// Calls `f` on every sample in the next chunk and advances the write position.
+    fn store_chunk(&self, f: impl Fn(&AtomicI16, usize)) {
+        const _: () = assert!(RingBuffer::BUFFER_SIZE % RingBuffer::EMU_BUFFER_SIZE == 0);
 
-            self.buffer[wc..wc_end].fill(0);
+        let s = &*self.state;
+        let mut write_pos = s.write_pos.load(Ordering::Relaxed);
 
-            self.write_cursor = if wc_end < self.buffer.len() {
-                wc_end
-            } else {
-                0
-            };
+        // Skip the chunks the SDL callback has already played
+        let buffered = self.buffered();
+        if buffered < 0 {
+            write_pos = write_pos.wrapping_add(buffered.unsigned_abs());
+            write_pos = write_pos.next_multiple_of(Self::EMU_BUFFER_SIZE);
         }
+
+        assert!(write_pos % RingBuffer::EMU_BUFFER_SIZE == 0);
+
+        let wc = write_pos % Self::BUFFER_SIZE;
+
+        s.buffer[wc..wc + Self::EMU_BUFFER_SIZE]
+            .iter()
+            .enumerate()
+            .for_each(|(i, b)| f(b, i));
+
+        s.write_pos.store(
+            write_pos.wrapping_add(Self::EMU_BUFFER_SIZE),
+            Ordering::Release,
+        );
     }
 }
 
-impl AudioCallback for RingBuffer {
+impl AudioCallback for RingBufferCallback {
     type Channel = i16;
 
     fn callback(&mut self, out: &mut [i16]) {
-        let rc = self.read_cursor;
+        let s = &*self.state;
 
-        if rc + out.len() <= self.buffer.len() {
-            let rc_end = rc + out.len();
-            out.copy_from_slice(&self.buffer[rc..rc_end]);
+        // Synchronises with the chunks written by the audio thread
+        let write_pos = s.write_pos.load(Ordering::Acquire);
+        let read_pos = s.read_pos.load(Ordering::Relaxed);
 
-            self.read_cursor = if rc_end < self.buffer.len() {
-                rc_end
-            } else {
-                0
+        let buffered = write_pos.wrapping_sub(read_pos) as isize;
+        if buffered < (out.len() as isize) {
+            s.underruns.fetch_add(1, Ordering::Relaxed);
+        }
+
+        let now = Instant::now();
+        if let Some(last) = self.last_callback.replace(now) {
+            // Long intervals are caused by paused playback
+            let interval = now - last;
+            if interval < PerformanceWindow::DURATION {
+                s.callback_interval.add(micros(interval));
             }
+        }
+        let values_per_second = s.values_per_second.load(Ordering::Relaxed).max(1) as u64;
+        s.fill_level
+            .add(buffered.max(0) as u64 * 1_000_000 / values_per_second);
+
+        let copy = |out: &mut [i16], buffer: &[AtomicI16]| {
+            out.iter_mut()
+                .zip(buffer)
+                .for_each(|(o, b)| *o = b.load(Ordering::Relaxed));
+        };
+
+        let rc = read_pos % s.buffer.len();
+
+        if rc + out.len() <= s.buffer.len() {
+            copy(out, &s.buffer[rc..rc + out.len()]);
         } else {
-            let buffer1 = &self.buffer[rc..];
+            let buffer1 = &s.buffer[rc..];
             let (out1, out2) = out.split_at_mut(buffer1.len());
-            let buffer2 = &self.buffer[..out2.len()];
+            let buffer2 = &s.buffer[..out2.len()];
+
+            copy(out1, buffer1);
+            copy(out2, buffer2);
+        }
+
+        s.read_pos
+            .store(read_pos.wrapping_add(out.len()), Ordering::Release);
+
+        // Only send a message if the audio thread has received the previous one
+        if !s.wakeup_pending.swap(true, Ordering::AcqRel) {
+            let _ = self
+                .sender
+                .send(AudioMessage::RingBufferConsumed(PrivateToken::new()));
+        }
+    }
+}
+
+type Renderer = SpeculativeRenderer<{ RingBuffer::EMU_BUFFER_SIZE }>;
+
+type SongIntro = Intro<LoadedSongKey, { RingBuffer::EMU_BUFFER_SIZE }>;
+type SharedSongIntro = SharedIntro<LoadedSongKey, { RingBuffer::EMU_BUFFER_SIZE }>;
+type SongIntroCache = IntroCache<IntroJob, LoadedSongKey, { RingBuffer::EMU_BUFFER_SIZE }>;
+type SongIntroRenderer = IntroRenderer<IntroJob, LoadedSongKey, { RingBuffer::EMU_BUFFER_SIZE }>;
+type SongStandbyLoader = StandbyLoader<StandbyJob, Standby>;
+
+/// Combines the levels of multiple equally sized chunks
+#[derive(Default)]
+struct MetersSum {
+    meters: AudioMeters,
+    voice_squares: [u64; N_DSP_VOICES],
+    squares: [u64; 2],
+    count: u64,
+}
 
-            out1.copy_from_slice(buffer1);
-            out2.copy_from_slice(buffer2);
+impl MetersSum {
+    fn add(&mut self, m: &AudioMeters) {
+        let square = |rms: u16| u64::from(rms) * u64::from(rms);
 
-            self.read_cursor = buffer2.len();
+        for v in 0..N_DSP_VOICES {
+            self.meters.voice_peak[v] = self.meters.voice_peak[v].max(m.voice_peak[v]);
+            self.voice_squares[v] += square(m.voice_rms[v]);
+        }
+        for c in 0..2 {
+            self.meters.peak[c] = self.meters.peak[c].max(m.peak[c]);
+            self.squares[c] += square(m.rms[c]);
         }
+        self.count += 1;
+    }
 
-        let _ = self
-            .sender
-            .send(AudioMessage::RingBufferConsumed(PrivateToken::new()));
+    fn meters(&self) -> AudioMeters {
+        let rms = |squares: u64| match self.count {
+            0 => 0,
+            n => ((squares / n) as f64).sqrt() as u16,
+        };
+
+        AudioMeters {
+            voice_rms: self.voice_squares.map(rms),
+            rms: self.squares.map(rms),
+            ..self.meters
+        }
     }
 }
 
-// Returns true if any sound is output by the emulator
-fn fill_ring_buffer_emu(emu: &mut TadEmu, playback: &mut AudioDevice<RingBuffer>) -> bool {
+// Returns the levels of the emulated audio, or None if the ring buffer was already full
+fn fill_ring_buffer_emu(
+    emu: &mut TadEmu,
+    renderer: &mut Renderer,
+    ring_buffer: &mut RingBuffer,
+) -> Option<AudioMeters> {
     // Do not emulate the next audio chunk if the ring buffer is full,
     // which can happen if an SDL audio callback occurs in the middle of the last `fill_ring_buffer()` call.
     //
     // In my opinion, the stuttering caused by this early return sounds better then skipping audio.
-    if playback.lock().is_buffer_full() {
-        return true;
+    if ring_buffer.is_buffer_full() {
+        return None;
+    }
+
+    if let Some(meters) = emu.fill_ring_buffer_intro(ring_buffer) {
+        return Some(meters);
+    }
+
+    if !renderer.is_active() && emu.can_speculate() {
+        renderer.start(emu.emu.clone());
     }
 
-    let mut silence = true;
+    if renderer.is_active() {
+        let mut meters = MetersSum::default();
 
-    loop {
-        let emu_buffer = emu.emulate();
-        if silence {
-            silence &= emu_buffer.iter().all(|&b| b == 0);
+        while let Some(chunk) = renderer.pop() {
+            if let Some(snapshot) = chunk.snapshot {
+                emu.load_snapshot(snapshot);
+            }
+            meters.add(&chunk.meters);
+
+            let full = ring_buffer.add_chunk(&chunk.samples);
+            if full {
+                break;
+            }
         }
-        let full = playback.lock().add_chunk(emu_buffer);
+
+        return Some(meters.meters());
+    }
+
+    // Discard the levels of any audio emulated outside this function
+    emu.meters();
+
+    loop {
+        let full = ring_buffer.emulate_chunk(|chunk| emu.emulate_into(chunk));
         if full {
             break;
         }
     }
 
-    !silence
+    // The emulator accumulates the levels, the chunks do not need to be scanned
+    Some(emu.meters())
 }
 
-struct BrrSampleDecoder<'a> {
-    sample: &'a BrrSample,
-    sample_pos: usize,
-    blocks_decoded: usize,
-    blocks_to_decode: usize,
-    prev1: i16,
-    prev2: i16,
+type AttackChunks = Vec<Box<[i16; RingBuffer::EMU_BUFFER_SIZE]>>;
+
+type InstrumentNoteCache = NoteCache<{ RingBuffer::EMU_BUFFER_SIZE }>;
+
+// The cached attack must fill the ring buffer
+const _: () = assert!(ATTACK_CHUNKS * RingBuffer::EMU_BUFFER_SIZE >= RingBuffer::BUFFER_SIZE);
+
+fn start_dsp_audition(sample: &BrrSample, voice: &DspAuditionVoice) -> Option<ShvcSoundEmu> {
+    // No IPL ROM
+    let mut emu = ShvcSoundEmu::new(&[0; 64]);
+
+    emu.start_dsp_audition(sample.brr_data(), sample.loop_offset().unwrap_or(0), voice)
+        .ok()?;
+
+    Some(emu)
 }
 
-impl<'a> BrrSampleDecoder<'a> {
-    fn new(sample: &'a BrrSample) -> Self {
-        let blocks_to_decode = match sample.is_looping() {
-            true => LOOPING_BRR_SAMPLE_SAMPLES / SAMPLES_PER_BLOCK,
-            false => sample.n_brr_blocks(),
-        };
+/// Plays a sample on an emulated S-DSP voice (without the audio driver)
+struct DspSampleAudition {
+    emu: ShvcSoundEmu,
+    /// Pre-rendered chunks to play before `emu` is emulated
+    attack: std::vec::IntoIter<Box<[i16; RingBuffer::EMU_BUFFER_SIZE]>>,
+    samples_played: usize,
+    release_at: usize,
+    released: bool,
+}
 
+impl DspSampleAudition {
+    /// `emu` must be started with `start_dsp_audition()`
+    fn new(emu: ShvcSoundEmu, release_at: usize) -> Self {
+        Self::with_attack(Vec::new(), emu, release_at)
+    }
+
+    /// `release_at` must not be inside the attack
+    fn with_attack(attack: AttackChunks, after_attack: ShvcSoundEmu, release_at: usize) -> Self {
         Self {
-            sample,
-            sample_pos: 0,
-            blocks_to_decode,
-            blocks_decoded: 0,
-            prev1: 0,
-            prev2: 0,
+            emu: after_attack,
+            attack: attack.into_iter(),
+            samples_played: 0,
+            release_at,
+            released: false,
         }
     }
 
-    fn is_finished(&self) -> bool {
-        self.blocks_decoded > self.blocks_to_decode
+    fn brr_sample(sample: &BrrSample) -> Option<Self> {
+        let emu = start_dsp_audition(sample, &DspAuditionVoice::BRR_SAMPLE_RATE)?;
+
+        let release_at = match sample.is_looping() {
+            true => LOOPING_BRR_SAMPLE_SAMPLES,
+            false => sample.n_samples(),
+        };
+
+        Some(Self::new(emu, release_at))
+    }
+
+    fn instrument_note(
+        cached: &CachedInstrument<{ RingBuffer::EMU_BUFFER_SIZE }>,
+        note: &InstrumentNote,
+    ) -> Option<Self> {
+        const ATTACK_SAMPLES: usize = ATTACK_CHUNKS * RingBuffer::EMU_BUFFER_SAMPLES;
+
+        let job = &cached.job;
+        let release_at = note.key_off_samples();
+
+        if note.adsr1 == job.adsr1
+            && note.adsr2_or_gain == job.adsr2_or_gain
+            && release_at >= ATTACK_SAMPLES
+        {
+            if let Some((attack, after_attack)) = cached.note(note.note_id) {
+                return Some(Self::with_attack(attack, after_attack, release_at));
+            }
+        }
+
+        // The note is shorter than the attack or the envelope has been overridden
+        let voice = job.voice(note.note_id, note.adsr1, note.adsr2_or_gain)?;
+        let emu = start_dsp_audition(&job.brr_sample, &voice)?;
+
+        Some(Self::new(emu, release_at))
     }
 
-    fn fill_ring_buffer(&mut self, playback: &mut AudioDevice<RingBuffer>) {
-        const BUF_LEN: usize = RingBuffer::EMU_BUFFER_SIZE;
+    fn is_finished(&self) -> bool {
+        self.samples_played > self.release_at + BRR_SAMPLE_RELEASE_SAMPLES
+    }
 
-        if playback.lock().is_buffer_full() {
+    fn fill_ring_buffer(&mut self, ring_buffer: &mut RingBuffer) {
+        if ring_buffer.is_buffer_full() {
             return;
         }
 
-        let mut buf = [0; BUF_LEN];
-        let mut is_done = self.is_finished();
-
         loop {
-            if !is_done {
-                self.sample_pos = self.sample.decode_into_buffer(
-                    &mut buf,
-                    self.sample_pos,
-                    self.prev1,
-                    self.prev2,
-                );
-                self.prev1 = buf[buf.len() - 1];
-                self.prev2 = buf[buf.len() - 2];
-
-                self.blocks_decoded += buf.len() / SAMPLES_PER_BLOCK;
-                if self.blocks_decoded > self.blocks_to_decode {
-                    // Fade out the audio
-                    buf.iter_mut().enumerate().for_each(|(i, s)| {
-                        let p = (BUF_LEN - i) as i32;
-                        *s = i16::try_from(i32::from(*s) * p / (BUF_LEN as i32)).unwrap_or(0);
-                    });
-                    is_done = true;
-                }
-                let full = playback.lock().add_chunk(&buf);
-                if full {
-                    break;
+            if self.is_finished() {
+                ring_buffer.fill_remaining_with_silence();
+                break;
+            }
+
+            let full = match self.attack.next() {
+                Some(chunk) => ring_buffer.add_chunk(&chunk),
+                None => {
+                    if !self.released && self.samples_played >= self.release_at {
+                        // The S-DSP release envelope fades out the audio
+                        self.emu.release_dsp_audition();
+                        self.released = true;
+                    }
+                    ring_buffer.emulate_chunk(|chunk| self.emu.emulate_into(chunk))
                 }
-            } else {
-                playback.lock().fill_remaining_with_silence();
+            };
+            self.samples_played += RingBuffer::EMU_BUFFER_SAMPLES;
+            if full {
                 break;
             }
         }
     }
 }
 
+/// Renders the attack of every note in `job` (runs on the note cache thread)
+fn render_instrument_notes(job: &NoteCacheJob) -> Vec<CachedNote<{ RingBuffer::EMU_BUFFER_SIZE }>> {
+    (0..job.pitches.len())
+        .map_while(|note_id| {
+            let voice = job.default_voice(note_id.try_into().ok()?)?;
+            let mut emu = start_dsp_audition(&job.brr_sample, &voice)?;
+
+            let attack = (0..ATTACK_CHUNKS)
+                .map(|_| {
+                    let mut chunk = Box::new([0; RingBuffer::EMU_BUFFER_SIZE]);
+                    emu.emulate_into(chunk.as_mut_slice());
+                    chunk
+                })
+                .collect();
+
+            Some(CachedNote {
+                attack,
+                after_attack: emu,
+            })
+        })
+        .collect()
+}
+
 struct EmulatorWrapper<'a>(&'a mut ShvcSoundEmu);
 impl bytecode_interpreter::Emulator for EmulatorWrapper<'_> {
     fn apuram_mut(&mut self) -> &mut [u8; 0x10000] {
@@ -427,6 +1057,7 @@ enum AudioDataState {
     SongWithSfxBuffer(Arc<CommonAudioDataWithSfxBuffer>, Arc<SongData>),
 }
 
+#[derive(Clone)]
 enum SiCad {
     NoSfx(Arc<CommonAudioDataNoSfx>),
     SfxBuffer(Arc<CommonAudioDataWithSfxBuffer>),
@@ -445,18 +1076,39 @@ impl std::ops::Deref for SiCad {
     }
 }
 
+impl SiCad {
+    /// Returns None if `audio_data` is not a song stored in an `Arc`
+    fn from_data_state(audio_data: &AudioDataState) -> Option<(SiCad, Arc<SongData>)> {
+        match audio_data {
+            AudioDataState::NotLoaded => None,
+            AudioDataState::CommonDataOutOfDate => None,
+            AudioDataState::Sample(..) => None,
+            AudioDataState::SongNoSfx(cad, sd) => Some((SiCad::NoSfx(cad.clone()), sd.clone())),
+            AudioDataState::SongAndSfx(cad, sd) => Some((SiCad::WithSfx(cad.clone()), sd.clone())),
+            AudioDataState::SongWithSfxBuffer(cad, sd) => {
+                Some((SiCad::SfxBuffer(cad.clone()), sd.clone()))
+            }
+        }
+    }
+
+    fn ptr_eq(&self, other: &Self) -> bool {
+        match (self, other) {
+            (Self::NoSfx(a), Self::NoSfx(b)) => Arc::ptr_eq(a, b),
+            (Self::SfxBuffer(a), Self::SfxBuffer(b)) => Arc::ptr_eq(a, b),
+            (Self::WithSfx(a), Self::WithSfx(b)) => Arc::ptr_eq(a, b),
+            _ => false,
+        }
+    }
+}
+
 fn create_and_process_song_interpreter(
     audio_data: &AudioDataState,
     song_skip: SongSkip,
     stereo_flag: bool,
 ) -> Result<Option<SongInterpreter<SiCad, Arc<SongData>>>, ()> {
-    let (cad, sd) = match audio_data {
-        AudioDataState::NotLoaded => return Ok(None),
-        AudioDataState::CommonDataOutOfDate => return Ok(None),
-        AudioDataState::Sample(..) => return Ok(None),
-        AudioDataState::SongNoSfx(cad, sd) => (SiCad::NoSfx(cad.clone()), sd.clone()),
-        AudioDataState::SongAndSfx(cad, sd) => (SiCad::WithSfx(cad.clone()), sd.clone()),
-        AudioDataState::SongWithSfxBuffer(cad, sd) => (SiCad::SfxBuffer(cad.clone()), sd.clone()),
+    let (cad, sd) = match SiCad::from_data_state(audio_data) {
+        Some(d) => d,
+        None => return Ok(None),
     };
 
     match song_skip {
@@ -484,12 +1136,245 @@ fn create_and_process_song_interpreter(
     }
 }
 
+/// The song and common audio data loaded into the emulator.
+#[derive(Clone)]
+struct LoadedSongKey {
+    common_audio_data: SiCad,
+    song: Arc<SongData>,
+    stereo_flag: bool,
+}
+
+impl LoadedSongKey {
+    fn matches(&self, o: &Self) -> bool {
+        self.common_audio_data.ptr_eq(&o.common_audio_data)
+            && Arc::ptr_eq(&self.song, &o.song)
+            && self.stereo_flag == o.stereo_flag
+    }
+}
+
+/// The emulator input that determines the state of the audio driver after it has booted.
+struct BootSnapshotKey {
+    song: LoadedSongKey,
+    song_header_edl: Option<u8>,
+    esa: u8,
+    edl: u8,
+}
+
+impl BootSnapshotKey {
+    fn matches(&self, o: &Self) -> bool {
+        self.song.matches(&o.song)
+            && self.song_header_edl == o.song_header_edl
+            && self.esa == o.esa
+            && self.edl == o.edl
+    }
+}
+
+/// Environment variable containing the path of the on-disk boot snapshot cache directory
+/// (the directory is created if it does not exist).
+const BOOT_SNAPSHOT_CACHE_DIR_ENV_VAR: &str = "TAD_BOOT_SNAPSHOT_CACHE_DIR";
+
+/// Incremented whenever the boot snapshot cache file name or contents change
+const BOOT_SNAPSHOT_CACHE_VERSION: u64 = 1;
+
+/// Returns the file name of the boot snapshot in the on-disk boot snapshot cache.
+///
+/// The name is a hash of the emulator input (driver, common audio data, song and
+/// `BootSnapshotKey` registers), the GUI version and the length of the data.
+fn boot_snapshot_file_name(
+    key: &BootSnapshotKey,
+    common_audio_data: &CommonAudioData,
+    song: &SongData,
+) -> String {
+    let cad = common_audio_data.data();
+
+    let mut h = Fnv1a::new();
+    h.write(&BOOT_SNAPSHOT_CACHE_VERSION.to_le_bytes());
+    h.write(env!("CARGO_PKG_VERSION").as_bytes());
+    h.write(audio_driver::LOADER);
+    h.write(audio_driver::AUDIO_DRIVER);
+    h.write(&(cad.len() as u64).to_le_bytes());
+    h.write(cad);
+    h.write(&(song.data().len() as u64).to_le_bytes());
+    h.write(song.data());
+    h.write(&[
+        key.song.stereo_flag.into(),
+        key.song_header_edl.is_some().into(),
+        key.song_header_edl.unwrap_or(0),
+        key.esa,
+        key.edl,
+    ]);
+
+    format!(
+        "{:016x}-{}.state",
+        h.finish(),
+        cad.len() + song.data().len()
+    )
+}
+
+// Errors are ignored, the cache is optional
+fn write_boot_snapshot_file(path: &Path, state: &[u8]) {
+    let dir = match path.parent() {
+        Some(d) => d,
+        None => return,
+    };
+    if fs::create_dir_all(dir).is_err() {
+        return;
+    }
+
+    // Write to a temporary file so another process never reads a partially written file
+    let mut tmp_path = path.as_os_str().to_owned();
+    tmp_path.push(format!(".{}.tmp", std::process::id()));
+    let tmp_path = PathBuf::from(tmp_path);
+
+    if fs::write(&tmp_path, state).is_ok() && fs::rename(&tmp_path, path).is_err() {
+        let _ = fs::remove_file(&tmp_path);
+    }
+}
+
+/// Emulator save state taken after the audio driver has booted
+/// (before the song interpreter state, channel mask and unpause command are written).
+///
+/// Restored instead of booting the driver when the same song and common audio data is loaded
+/// again (ie, sound effect previews, which all use the blank song, and playing a song from the
+/// cursor).
+///
+/// If the `TAD_BOOT_SNAPSHOT_CACHE_DIR` environment variable is set, the snapshots are also
+/// stored in that directory and reused by later GUI sessions.
+struct BootSnapshot {
+    key: BootSnapshotKey,
+    state: Vec<u8>,
+}
+
+/// An idle audio driver with the blank song and the sound effects loaded, unpaused and ready
+/// to receive an IO command.
+///
+/// Cloned when a sound effect is played while no song is playing, instead of booting the
+/// driver (or restoring a boot snapshot, which a song may have replaced) on every click.
+struct SfxInstance {
+    key: LoadedSongKey,
+    emu: ShvcSoundEmu,
+}
+
+/// Checkpoints recorded while playing a song from the start.
+///
+/// Used to seek into a song by restoring the nearest checkpoint and emulating the remaining ticks,
+/// instead of writing the bytecode interpreter state to the emulator.
+#[derive(Clone)]
+struct SongCheckpointCache {
+    key: LoadedSongKey,
+    checkpoints: SongCheckpoints,
+    /// True if the emulator is playing the song from the start with no sound effects and all
+    /// music channels enabled.
+    recording: bool,
+    /// Set if some of the checkpoints were recorded with an earlier compile of the song.
+    /// The song data from this offset is written to the emulator after restoring a checkpoint.
+    patch_offset: Option<usize>,
+}
+
+/// The input required to render the intro of a song on the intro render thread
+/// (see `render_song_intro()`).
+struct IntroJob {
+    song_id: ItemId,
+    song: Arc<SongData>,
+    stereo_flag: StereoFlag,
+    cad_no_sfx: Option<Arc<CommonAudioDataNoSfx>>,
+    cad_with_sfx_buffer: Option<Arc<CommonAudioDataWithSfxBuffer>>,
+    cad_with_sfx: Option<Arc<CommonAudioDataWithSfx>>,
+}
+
+/// A pre-rendered song intro that is being played instead of emulating the audio driver
+struct IntroPlayback {
+    intro: SharedSongIntro,
+    next_chunk: usize,
+    /// Number of chunks played after the last snapshot was loaded
+    chunks_after_snapshot: usize,
+}
+
+/// The input required to load a recompiled song into a standby emulator on the standby loader
+/// thread (see `load_standby()`).
+struct StandbyJob {
+    song_id: ItemId,
+    song: Arc<SongData>,
+    stereo_flag: StereoFlag,
+    cad_no_sfx: Option<Arc<CommonAudioDataNoSfx>>,
+    cad_with_sfx_buffer: Option<Arc<CommonAudioDataWithSfxBuffer>>,
+    cad_with_sfx: Option<Arc<CommonAudioDataWithSfx>>,
+    /// The song tick to seek to
+    tick: u16,
+    music_channels_mask: MusicChannelsMask,
+    /// The playing song's checkpoints (the checkpoint data is shared with the audio thread).
+    /// The checkpoints recorded before the first tick that reads the changed bytecode are
+    /// used to seek the standby emulator.
+    checkpoints: Option<SongCheckpointCache>,
+}
+
+/// A recompiled song loaded into a second emulator and positioned at a song tick.
+///
+/// Replaces the audio thread's emulator when the playing song reaches the same tick
+/// (see `TadEmu::process_standby()`).
+struct Standby {
+    song_id: ItemId,
+    emu: ShvcSoundEmu,
+    data_state: AudioDataState,
+    bc_interpreter: Option<SongInterpreter<SiCad, Arc<SongData>>>,
+    checkpoints: Option<SongCheckpointCache>,
+    previous_command: u8,
+}
+
 enum SfxQueue {
     None,
     TestSfx(Arc<CompiledSoundEffect>, Pan),
     PlaySfx(SfxId, Pan),
 }
 
+fn read_song_tick_counter(emu: &ShvcSoundEmu) -> u16 {
+    const STC: usize = addresses::SONG_TICK_COUNTER as usize;
+
+    let apuram = emu.apuram();
+    u16::from_le_bytes([apuram[STC], apuram[STC + 1]])
+}
+
+/// Emulates the audio driver until it has processed song tick `tick` and returned to the main
+/// loop.
+///
+/// Returns false if the audio driver did not process `tick` within `max_smp_clocks`.
+fn emulate_until_song_tick(emu: &mut ShvcSoundEmu, tick: u16, max_smp_clocks: u64) -> bool {
+    let mut smp_clocks = 0;
+
+    // Emulate until the audio driver is about to process `tick`
+    let ticks_remaining = |e: &ShvcSoundEmu| tick.wrapping_sub(read_song_tick_counter(e)) as i16;
+    while ticks_remaining(emu) > 1 {
+        if smp_clocks >= max_smp_clocks {
+            return false;
+        }
+        smp_clocks += emu.fast_forward(ShvcSoundEmu::SMP_CLOCKS_PER_SAMPLE);
+    }
+    if ticks_remaining(emu) == 1 {
+        let r = emu.run_until_pc(
+            addresses::PROCESS_MUSIC_CHANNELS_CODE,
+            max_smp_clocks.saturating_sub(smp_clocks),
+        );
+        if !r.hit {
+            return false;
+        }
+    }
+
+    // Wait for the audio driver to finish processing the tick
+    while !addresses::MAIN_LOOP_CODE_RANGE.contains(&emu.program_counter()) {
+        if smp_clocks >= max_smp_clocks {
+            return false;
+        }
+        smp_clocks += emu
+            .run_until_pc(
+                addresses::MAINLOOP_CODE,
+                ShvcSoundEmu::SMP_CLOCKS_PER_SAMPLE,
+            )
+            .smp_clocks;
+    }
+
+    read_song_tick_counter(emu) == tick
+}
+
 struct TadEmu {
     emu: ShvcSoundEmu,
 
@@ -503,13 +1388,33 @@ struct TadEmu {
     data_state: AudioDataState,
     song_id: Option<ItemId>,
     bc_interpreter: Option<SongInterpreter<SiCad, Arc<SongData>>>,
+    playing_subroutine: bool,
+
+    live_song_patching: bool,
+    song_patch: Option<Arc<SongData>>,
+
+    standby_reload: bool,
+    standby_loader: Option<SongStandbyLoader>,
+    standby: Option<Standby>,
 
     previous_command: u8,
     sfx_queue: SfxQueue,
+
+    boot_snapshot: Option<BootSnapshot>,
+    boot_snapshot_cache_dir: Option<PathBuf>,
+    sfx_instance: Option<SfxInstance>,
+    checkpoints: Option<SongCheckpointCache>,
+
+    intro_cache: Option<SongIntroCache>,
+    intro: Option<IntroPlayback>,
+
+    shared_state_view: Option<SharedStateView>,
+
+    session_recorder: Option<SessionRecorder>,
 }
 
 impl TadEmu {
-    fn new() -> Self {
+    fn new(intro_cache: Option<SongIntroCache>) -> Self {
         // No IPL ROM
         let iplrom = [0; 64];
 
@@ -523,8 +1428,24 @@ impl TadEmu {
             data_state: AudioDataState::NotLoaded,
             bc_interpreter: None,
             song_id: None,
+            playing_subroutine: false,
+            live_song_patching: false,
+            song_patch: None,
+            standby_reload: false,
+            standby_loader: None,
+            standby: None,
             previous_command: 0,
             sfx_queue: SfxQueue::None,
+            boot_snapshot: None,
+            boot_snapshot_cache_dir: std::env::var_os(BOOT_SNAPSHOT_CACHE_DIR_ENV_VAR)
+                .filter(|d| !d.is_empty())
+                .map(PathBuf::from),
+            sfx_instance: None,
+            checkpoints: None,
+            intro_cache,
+            intro: None,
+            shared_state_view: None,
+            session_recorder: None,
         }
     }
 
@@ -548,6 +1469,37 @@ impl TadEmu {
         self.stereo_flag = stereo_flag;
     }
 
+    fn set_live_song_patching(&mut self, enabled: bool) {
+        self.live_song_patching = enabled;
+        if !enabled {
+            self.song_patch = None;
+        }
+    }
+
+    fn set_standby_reload(&mut self, enabled: bool) {
+        self.standby_reload = enabled;
+        if !enabled {
+            self.cancel_standby();
+        }
+    }
+
+    /// Returns an error message if the shared memory segment cannot be created
+    fn set_shared_state_view(&mut self, enabled: bool) -> Result<(), String> {
+        match (enabled, &self.shared_state_view) {
+            (true, None) => {
+                self.shared_state_view = SharedStateView::new(SHARED_STATE_VIEW_NAME);
+                if self.shared_state_view.is_none() {
+                    return Err(format!(
+                        "Cannot create shared memory segment {SHARED_STATE_VIEW_NAME}\n(is tad-gui built with the shared-memory feature?)"
+                    ));
+                }
+            }
+            (false, Some(_)) => self.shared_state_view = None,
+            _ => (),
+        }
+        Ok(())
+    }
+
     fn load_cad_no_sfx(&mut self, cad: Option<Arc<CommonAudioDataNoSfx>>) {
         self.cad_no_sfx = cad;
         if matches!(self.data_state, AudioDataState::SongWithSfxBuffer(..)) {
@@ -564,6 +1516,7 @@ impl TadEmu {
 
     fn load_cad_with_sfx(&mut self, cad: Option<Arc<CommonAudioDataWithSfx>>) {
         self.cad_with_sfx = cad;
+        self.sfx_instance = None;
         if matches!(self.data_state, AudioDataState::SongAndSfx(..)) {
             self.data_state = AudioDataState::CommonDataOutOfDate;
         }
@@ -572,6 +1525,7 @@ impl TadEmu {
     fn stop_song(&mut self) {
         self.data_state = AudioDataState::NotLoaded;
         self.song_id = None;
+        self.cancel_standby();
     }
 
     fn load_song(
@@ -676,13 +1630,16 @@ impl TadEmu {
         song_skip: SongSkip,
         music_channels_mask: MusicChannelsMask,
     ) -> Result<(), ()> {
-        const LOADER_DATA_TYPE_ADDR: usize = addresses::LOADER_DATA_TYPE as usize;
-
         self.data_state = AudioDataState::NotLoaded;
         self.song_id = None;
         self.bc_interpreter = None;
+        self.playing_subroutine = matches!(song_skip, SongSkip::Subroutine(..));
+        self.song_patch = None;
+        self.intro = None;
+        self.cancel_standby();
 
         self.sfx_queue = SfxQueue::None;
+        self.stop_recording_checkpoints();
 
         let (common_audio_data, song) = match &data_state {
             AudioDataState::NotLoaded => return Err(()),
@@ -693,8 +1650,6 @@ impl TadEmu {
             AudioDataState::SongWithSfxBuffer(cad, sd) => (&cad.0, sd.as_ref()),
         };
 
-        let song_data = song.data();
-        let common_data = common_audio_data.data();
         let echo_buffer = &song.metadata().echo_buffer;
 
         let stereo_flag = match self.stereo_flag {
@@ -702,9 +1657,350 @@ impl TadEmu {
             StereoFlag::Mono => false,
         };
 
+        let seek_tick = match &song_skip {
+            SongSkip::Song(t) => Some(*t),
+            _ => None,
+        };
+
+        // Sound effects played with the sound effect buttons use the blank song
+        let sfx_instance = song_id.is_none()
+            && matches!(song_skip, SongSkip::None)
+            && music_channels_mask.0 == MusicChannelsMask::ALL.0
+            && match &data_state {
+                AudioDataState::SongAndSfx(_, sd) => Arc::ptr_eq(sd, &self.blank_song),
+                _ => false,
+            };
+
         self.bc_interpreter =
             create_and_process_song_interpreter(&data_state, song_skip, stereo_flag)?;
 
+        let song_key = SiCad::from_data_state(&data_state).map(|(cad, song)| LoadedSongKey {
+            common_audio_data: cad,
+            song,
+            stereo_flag,
+        });
+
+        // The shared state view is published by `emulate_into()`, which does not play intros
+        let intro = match (&song_key, seek_tick, &self.intro_cache) {
+            (Some(key), Some(tick), Some(cache))
+                if tick.value() == 0
+                    && music_channels_mask.0 == MusicChannelsMask::ALL.0
+                    && self.shared_state_view.is_none() =>
+            {
+                cache.find(|k| k.matches(key))
+            }
+            _ => None,
+        };
+        if let Some(intro) = intro {
+            // The intro was rendered from an emulator with the song loaded and unpaused
+            self.emu = lock_intro(&intro).start.clone();
+            self.intro = Some(IntroPlayback {
+                intro,
+                next_chunk: 0,
+                chunks_after_snapshot: 0,
+            });
+            self.previous_command = io_commands::UNPAUSE;
+
+            if let Some(key) = song_key {
+                self.start_recording_checkpoints(key);
+            }
+
+            self.data_state = data_state;
+            self.song_id = song_id;
+
+            return Ok(());
+        }
+
+        if sfx_instance {
+            if let (Some(key), Some(instance)) = (&song_key, &self.sfx_instance) {
+                if key.matches(&instance.key) {
+                    self.emu = instance.emu.clone();
+                    self.previous_command = io_commands::UNPAUSE;
+
+                    self.data_state = data_state;
+                    self.song_id = song_id;
+
+                    return Ok(());
+                }
+            }
+        }
+
+        let restored_checkpoint = match (&song_key, seek_tick) {
+            (Some(key), Some(tick)) if tick.value() > 0 => self.seek_using_checkpoints(key, tick),
+            _ => false,
+        };
+        if restored_checkpoint {
+            self.set_music_channels_mask(music_channels_mask);
+            self.previous_command = io_commands::UNPAUSE;
+
+            self.data_state = data_state;
+            self.song_id = song_id;
+
+            return Ok(());
+        }
+
+        // The echo buffer registers must be setup BEFORE the emulator processes instructions.
+        // Otherwise the audio sounds weird.
+        let (song_header_edl, esa, edl) = match &self.bc_interpreter {
+            Some(bci) => (
+                Some(bci.song_header_edl()),
+                bci.esa_register(),
+                bci.edl_register(),
+            ),
+            None => (None, echo_buffer.esa_register(), echo_buffer.edl_register()),
+        };
+
+        let snapshot_key = song_key.as_ref().map(|song| BootSnapshotKey {
+            song: song.clone(),
+            song_header_edl,
+            esa,
+            edl,
+        });
+
+        let restored = match (&snapshot_key, &self.boot_snapshot) {
+            (Some(key), Some(snapshot)) if key.matches(&snapshot.key) => {
+                self.emu.load_state(&snapshot.state).is_ok()
+            }
+            _ => false,
+        };
+
+        if !restored {
+            let cache_path = match (&snapshot_key, &self.boot_snapshot_cache_dir) {
+                (Some(key), Some(dir)) => {
+                    Some(dir.join(boot_snapshot_file_name(key, common_audio_data, song)))
+                }
+                _ => None,
+            };
+
+            let cached = cache_path
+                .as_deref()
+                .and_then(|p| self.load_boot_snapshot_file(p, common_audio_data));
+
+            let state = match cached {
+                Some(state) => state,
+                None => {
+                    self.boot_audio_driver(
+                        common_audio_data,
+                        song,
+                        stereo_flag,
+                        song_header_edl,
+                        esa,
+                        edl,
+                    );
+
+                    let state = self.emu.save_state();
+                    if let Some(p) = &cache_path {
+                        write_boot_snapshot_file(p, &state);
+                    }
+                    state
+                }
+            };
+
+            self.boot_snapshot = snapshot_key.map(|key| BootSnapshot { key, state });
+        }
+
+        // Detect echo buffer writes to the common audio data and song data
+        let data_end = usize::from(common_audio_data.song_data_addr()) + song.data().len() - 1;
+        self.emu
+            .set_echo_guard(addresses::COMMON_DATA..=data_end as u16);
+
+        let mut emu_wrapper = EmulatorWrapper(&mut self.emu);
+
+        if let Some(bci) = &self.bc_interpreter {
+            bci.write_to_emulator(&mut emu_wrapper);
+        }
+
+        // Set the channels mask and unpause the audio driver with a single emulator call
+        let mut batch = EmulatorBatch::new();
+        self.music_channels_mask_batch(&mut batch, music_channels_mask);
+        batch.write_io_ports([io_commands::UNPAUSE, 0, 0, 0]);
+        self.emu.apply_batch(&batch);
+
+        self.previous_command = io_commands::UNPAUSE;
+
+        if sfx_instance {
+            self.save_sfx_instance(song_key.clone());
+        }
+
+        if let (Some(key), Some(tick)) = (song_key, seek_tick) {
+            if tick.value() == 0 && music_channels_mask.0 == MusicChannelsMask::ALL.0 {
+                self.start_recording_checkpoints(key);
+            }
+        }
+
+        self.data_state = data_state;
+        self.song_id = song_id;
+
+        Ok(())
+    }
+
+    /// Emulates the blank song until the audio driver has acknowledged the unpause command
+    /// and saves the emulator to `sfx_instance`.
+    fn save_sfx_instance(&mut self, key: Option<LoadedSongKey>) {
+        // The blank song is silent, the emulator does not need to mix audio
+        let mut clocks = 0;
+        while !self.is_io_command_acknowledged() && clocks < ShvcSoundEmu::SMP_CLOCKS_PER_SECOND {
+            let r = self
+                .emu
+                .run_until_port_write(0b0001, ShvcSoundEmu::SMP_CLOCKS_PER_SECOND - clocks);
+            clocks += r.smp_clocks;
+        }
+
+        self.sfx_instance = match (key, self.is_io_command_acknowledged()) {
+            (Some(key), true) => Some(SfxInstance {
+                key,
+                emu: self.emu.clone(),
+            }),
+            _ => None,
+        };
+    }
+
+    fn start_recording_checkpoints(&mut self, key: LoadedSongKey) {
+        self.update_checkpoints_song(&key);
+
+        match &mut self.checkpoints {
+            Some(c) if c.key.matches(&key) => c.recording = true,
+            _ => {
+                self.checkpoints = Some(SongCheckpointCache {
+                    key,
+                    checkpoints: SongCheckpoints::new(),
+                    recording: true,
+                    patch_offset: None,
+                })
+            }
+        }
+    }
+
+    fn stop_recording_checkpoints(&mut self) {
+        if let Some(c) = &mut self.checkpoints {
+            c.recording = false;
+        }
+    }
+
+    fn song_tick_counter(&self) -> u16 {
+        read_song_tick_counter(&self.emu)
+    }
+
+    fn record_checkpoint(&mut self) {
+        let tick = self.song_tick_counter();
+
+        if let Some(c) = &mut self.checkpoints {
+            if c.recording {
+                match c.checkpoints.next_tick() {
+                    Some(next) if tick >= next => {
+                        let dirty_pages = self.emu.dirty_apuram_pages();
+                        c.checkpoints
+                            .push(tick, self.emu.save_state(), &dirty_pages);
+                        self.emu.clear_dirty_apuram_pages();
+                    }
+                    Some(_) => (),
+                    None => c.recording = false,
+                }
+            }
+        }
+    }
+
+    /// Restores the nearest checkpoint before `tick` and emulates the audio driver until
+    /// `tick` has been processed.
+    ///
+    /// Returns false if there is no checkpoint near `tick`.
+    /// The emulator state is invalid if this function returns false after a checkpoint has been
+    /// restored.
+    /// Keeps the checkpoints of an earlier compile of the song that were recorded before the
+    /// first tick that reads the changed bytecode (see `song_diff()`).
+    fn update_checkpoints_song(&mut self, key: &LoadedSongKey) {
+        let c = match &mut self.checkpoints {
+            Some(c) if !c.key.matches(key) => c,
+            _ => return,
+        };
+
+        // The sound effect buffer is stored after the song data
+        if !c.key.common_audio_data.ptr_eq(&key.common_audio_data)
+            || matches!(key.common_audio_data, SiCad::SfxBuffer(_))
+            || c.key.stereo_flag != key.stereo_flag
+        {
+            return;
+        }
+
+        if let Some(diff) = song_diff(&c.key.song, &key.song) {
+            c.checkpoints.truncate(diff.tick.value());
+            c.patch_offset = Some(diff.offset.min(c.patch_offset.unwrap_or(usize::MAX)));
+        }
+        c.key = key.clone();
+    }
+
+    fn seek_using_checkpoints(&mut self, key: &LoadedSongKey, tick: TickCounter) -> bool {
+        let tick = match u16::try_from(tick.value()) {
+            Ok(t) => t,
+            Err(_) => return false,
+        };
+
+        self.update_checkpoints_song(key);
+
+        let (checkpoint_tick, state, patch_offset) = match &self.checkpoints {
+            Some(c) if c.key.matches(key) => match c.checkpoints.nearest(tick) {
+                Some((t, s)) => (t, s, c.patch_offset),
+                None => return false,
+            },
+            _ => return false,
+        };
+        if tick - checkpoint_tick > CHECKPOINT_INTERVAL {
+            return false;
+        }
+
+        if self.emu.load_state(&state).is_err() {
+            return false;
+        }
+
+        if let Some(offset) = patch_offset {
+            let song_data = key.song.data();
+            let addr = usize::from(key.common_audio_data.song_data_addr()) + offset;
+            if let Some(d) = song_data.get(offset..) {
+                self.emu.apuram_mut()[addr..addr + d.len()].copy_from_slice(d);
+            }
+        }
+
+        let max_smp_clocks = u64::from(tick - checkpoint_tick + 1) * MAX_SMP_CLOCKS_PER_TICK;
+
+        emulate_until_song_tick(&mut self.emu, tick, max_smp_clocks)
+    }
+
+    /// Loads a boot snapshot from the on-disk cache.
+    ///
+    /// Returns the save state if it was loaded and contains `common_audio_data`.
+    fn load_boot_snapshot_file(
+        &mut self,
+        path: &Path,
+        common_audio_data: &CommonAudioData,
+    ) -> Option<Vec<u8>> {
+        let state = fs::read(path).ok()?;
+        self.emu.load_state(&state).ok()?;
+
+        // Guard against hash collisions and stale files
+        let cad = common_audio_data.data();
+        let start = usize::from(addresses::COMMON_DATA);
+        if &self.emu.apuram()[start..start + cad.len()] != cad {
+            return None;
+        }
+
+        Some(state)
+    }
+
+    fn boot_audio_driver(
+        &mut self,
+        common_audio_data: &CommonAudioData,
+        song: &SongData,
+        stereo_flag: bool,
+        song_header_edl: Option<u8>,
+        esa: u8,
+        edl: u8,
+    ) {
+        const LOADER_DATA_TYPE_ADDR: usize = addresses::LOADER_DATA_TYPE as usize;
+
+        let song_data = song.data();
+        let common_data = common_audio_data.data();
+        let echo_buffer = &song.metadata().echo_buffer;
+
         let song_data_addr = common_audio_data.song_data_addr();
 
         let apuram = self.emu.apuram_mut();
@@ -732,19 +2028,13 @@ impl TadEmu {
             stereo_flag,
             play_song: false,
             skip_echo_buffer_reset: true,
+            tick_budget: false,
         }
         .driver_value();
 
-        // The echo buffer registers must be setup BEFORE the emulator processes instructions.
-        // Otherwise the audio sounds weird.
-        let (esa, edl) = match &self.bc_interpreter {
-            Some(bci) => {
-                apuram[usize::from(song_data_addr) + SONG_HEADER_ECHO_EDL] = bci.song_header_edl();
-
-                (bci.esa_register(), bci.edl_register())
-            }
-            None => (echo_buffer.esa_register(), echo_buffer.edl_register()),
-        };
+        if let Some(edl) = song_header_edl {
+            apuram[usize::from(song_data_addr) + SONG_HEADER_ECHO_EDL] = edl;
+        }
 
         self.emu.reset(shvc_sound_emu::ResetRegisters {
             pc: addresses::DRIVER_CODE,
@@ -757,27 +2047,21 @@ impl TadEmu {
             edl,
         });
 
-        // Wait for the audio-driver to finish initialization
+        // Clears the access map (does nothing without the `access-map` feature)
+        self.emu.set_access_map_enabled(ShvcSoundEmu::ACCESS_MAP);
+
+        // Wait for the audio-driver to finish initialization and process the first tick
+        self.emu.run_until_pc(
+            addresses::PROCESS_MUSIC_CHANNELS_CODE,
+            DRIVER_BOOT_TIMEOUT_SMP_CLOCKS,
+        );
         let mut emu_wrapper = EmulatorWrapper(&mut self.emu);
         while !emu_wrapper.is_pc_in_mainloop() {
-            emu_wrapper.0.emulate();
+            emu_wrapper.0.run_until_pc(
+                addresses::MAINLOOP_CODE,
+                ShvcSoundEmu::SMP_CLOCKS_PER_SAMPLE,
+            );
         }
-
-        if let Some(bci) = &self.bc_interpreter {
-            bci.write_to_emulator(&mut emu_wrapper);
-        }
-
-        self.set_music_channels_mask(music_channels_mask);
-
-        // Unpause the audio driver
-        self.emu.write_io_ports([io_commands::UNPAUSE, 0, 0, 0]);
-
-        self.previous_command = io_commands::UNPAUSE;
-
-        self.data_state = data_state;
-        self.song_id = song_id;
-
-        Ok(())
     }
 
     fn is_io_command_acknowledged(&self) -> bool {
@@ -789,27 +2073,90 @@ impl TadEmu {
             let command = ((self.previous_command ^ u8::MAX) & IO_COMMAND_I_MASK)
                 | (command & IO_COMMAND_MASK);
 
-            self.emu.write_io_ports([command, param1, param2, 0]);
+            let ports = [command, param1, param2, 0];
+            self.before_recorded_change();
+            self.emu.write_io_ports(ports);
+            self.after_recorded_change(&[SessionInput::IoPorts(ports)]);
             self.previous_command = command;
+
+            self.stop_recording_checkpoints();
         }
     }
 
+    /// Sends an IO command with a port write scheduled at the current S-SMP clock,
+    /// so the command is read by the next audio driver instruction (instead of waiting for the
+    /// next `emulate_into()` call).
+    ///
+    /// ASSUMES: the previous command has been acknowledged.
+    fn inject_io_command(&mut self, command: u8, param1: u8, param2: u8) {
+        let command =
+            ((self.previous_command ^ u8::MAX) & IO_COMMAND_I_MASK) | (command & IO_COMMAND_MASK);
+
+        let ports = [command, param1, param2, 0];
+        self.before_recorded_change();
+        let clock = self.emu.counters().smp_clocks;
+        self.emu.schedule_port_write(clock, ports);
+        // The write is applied before the next instruction, the same as an immediate write
+        self.after_recorded_change(&[SessionInput::IoPorts(ports)]);
+        self.previous_command = command;
+
+        self.stop_recording_checkpoints();
+    }
+
     fn set_music_channels_mask(&mut self, mask: MusicChannelsMask) {
-        let apuram = self.emu.apuram_mut();
+        self.before_recorded_change();
+
+        let mut batch = EmulatorBatch::new();
+        self.music_channels_mask_batch(&mut batch, mask);
+        self.emu.apply_batch(&batch);
+
+        let keyoff_shadow = self.emu.apuram()[addresses::KEYOFF_SHADOW_MUSIC as usize];
+        self.after_recorded_change(&[
+            SessionInput::Apuram(addresses::IO_MUSIC_CHANNELS_MASK, &[mask.0]),
+            SessionInput::Apuram(addresses::KEYOFF_SHADOW_MUSIC, &[keyoff_shadow]),
+        ]);
+    }
+
+    /// Must be called before an emulator change that is recorded by `after_recorded_change()`
+    fn before_recorded_change(&mut self) {
+        if let Some(r) = &mut self.session_recorder {
+            r.before_change(&mut self.emu);
+        }
+    }
+
+    fn after_recorded_change(&mut self, inputs: &[SessionInput]) {
+        if let Some(r) = &mut self.session_recorder {
+            r.after_change(&mut self.emu, inputs);
+        }
+    }
+
+    fn music_channels_mask_batch(&mut self, batch: &mut EmulatorBatch, mask: MusicChannelsMask) {
+        self.stop_recording_checkpoints();
 
-        apuram[addresses::IO_MUSIC_CHANNELS_MASK as usize] = mask.0;
         // Keyoff muted channels
-        apuram[addresses::KEYOFF_SHADOW_MUSIC as usize] |= mask.0 ^ 0xff;
+        let keyoff_shadow =
+            self.emu.apuram()[addresses::KEYOFF_SHADOW_MUSIC as usize] | (mask.0 ^ 0xff);
+
+        batch.write_apuram(addresses::IO_MUSIC_CHANNELS_MASK, &[mask.0]);
+        batch.write_apuram(addresses::KEYOFF_SHADOW_MUSIC, &[keyoff_shadow]);
     }
 
+    /// Plays a sound effect like the game would, with a `play_sound_effect` IO command.
+    ///
+    /// The command is injected immediately if the audio driver is ready, otherwise it replaces
+    /// the queued sound effect (like the game's sound effect queue).
     fn queue_sound_effect(&mut self, sfx_id: SfxId, pan: Pan) {
-        if matches!(self.data_state, AudioDataState::SongAndSfx(..)) {
-            self.sfx_queue = SfxQueue::PlaySfx(sfx_id, pan);
+        if !matches!(self.data_state, AudioDataState::SongAndSfx(..))
+            && self.load_blank_song().is_err()
+        {
+            return;
+        }
+
+        if self.is_io_command_acknowledged() {
+            self.inject_io_command(io_commands::PLAY_SOUND_EFFECT, sfx_id.value(), pan.as_u8());
+            self.sfx_queue = SfxQueue::None;
         } else {
-            let r = self.load_blank_song().is_ok();
-            if r {
-                self.sfx_queue = SfxQueue::PlaySfx(sfx_id, pan);
-            }
+            self.sfx_queue = SfxQueue::PlaySfx(sfx_id, pan);
         }
     }
 
@@ -885,67 +2232,462 @@ impl TadEmu {
         };
     }
 
-    fn emulate(&mut self) -> &[i16; RingBuffer::EMU_BUFFER_SIZE] {
-        const EMPTY_BUFFER: [i16; RingBuffer::EMU_BUFFER_SIZE] = [0; RingBuffer::EMU_BUFFER_SIZE];
+    /// Called when the playing song has been recompiled.
+    ///
+    /// Queues the song to be patched into Audio-RAM (see `process_song_patch()`) if live song
+    /// patching is enabled, otherwise loads the song into a standby emulator.
+    fn song_recompiled(&mut self, song: Arc<SongData>) {
+        if self.live_song_patching {
+            self.song_patch = Some(song);
+        } else {
+            self.queue_standby(song, 0);
+        }
+    }
+
+    /// Loads `song` into a standby emulator, `lead` ticks after the playing song tick
+    /// (see `process_standby()`).
+    ///
+    /// Does nothing if standby reload is disabled or a song is not playing.
+    fn queue_standby(&mut self, song: Arc<SongData>, lead: u16) {
+        let loader = match &self.standby_loader {
+            Some(l) if self.standby_reload => l,
+            _ => return,
+        };
+        let song_id = match self.song_id {
+            Some(id) => id,
+            None => return,
+        };
+
+        // Not using the sound effect buffer as it is stored after the song data.
+        // The session recorder cannot record an emulator swap.
+        let song_playing = matches!(
+            self.data_state,
+            AudioDataState::SongNoSfx(..)
+                | AudioDataState::SongAndSfx(..)
+                | AudioDataState::CommonDataOutOfDate
+        );
+        if !song_playing || self.playing_subroutine || self.session_recorder.is_some() {
+            return;
+        }
+
+        self.standby = None;
+
+        loader.queue(StandbyJob {
+            song_id,
+            song,
+            stereo_flag: self.stereo_flag,
+            cad_no_sfx: self.cad_no_sfx.clone(),
+            cad_with_sfx_buffer: self.cad_with_sfx_buffer.clone(),
+            cad_with_sfx: self.cad_with_sfx.clone(),
+            tick: self.song_tick_counter().wrapping_add(lead),
+            music_channels_mask: MusicChannelsMask(
+                self.emu.apuram()[addresses::IO_MUSIC_CHANNELS_MASK as usize],
+            ),
+            checkpoints: self.checkpoints.clone(),
+        });
+    }
+
+    fn cancel_standby(&mut self) {
+        self.standby = None;
+        if let Some(l) = &self.standby_loader {
+            l.cancel();
+        }
+    }
+
+    /// Returns true if a standby emulator is loading or waiting for the playing song
+    fn standby_pending(&self) -> bool {
+        self.standby.is_some() || self.standby_loader.as_ref().is_some_and(|l| l.is_pending())
+    }
+
+    /// Replaces the emulator with the standby emulator once the playing song has reached the
+    /// standby emulator's song tick.
+    ///
+    /// A standby emulator that is a few ticks behind is emulated until it reaches the playing
+    /// song tick, one that is too far behind is reloaded ahead of the playing song.
+    ///
+    /// Must only be called between chunks.
+    fn process_standby(&mut self) {
+        if self.standby.is_none() {
+            self.standby = self.standby_loader.as_ref().and_then(|l| l.take());
+        }
+        let standby = match &mut self.standby {
+            Some(s) => s,
+            None => return,
+        };
+
+        if self.song_id != Some(standby.song_id) || self.playing_subroutine {
+            self.standby = None;
+            return;
+        }
+
+        // Try again after the queued sound effect has been sent to the audio driver
+        if !matches!(self.sfx_queue, SfxQueue::None) {
+            return;
+        }
+
+        let tick = read_song_tick_counter(&self.emu);
+        let ticks_behind = tick.wrapping_sub(read_song_tick_counter(&standby.emu)) as i16;
+
+        if ticks_behind < 0 {
+            // Wait for the playing song to reach the standby emulator
+            return;
+        }
+        if ticks_behind > 0 {
+            let ticks_behind = ticks_behind as u16;
+
+            let caught_up = ticks_behind <= MAX_STANDBY_CATCH_UP_TICKS
+                && emulate_until_song_tick(
+                    &mut standby.emu,
+                    tick,
+                    u64::from(ticks_behind + 1) * MAX_SMP_CLOCKS_PER_TICK,
+                );
+
+            if !caught_up {
+                let song = SiCad::from_data_state(&standby.data_state).map(|(_, s)| s);
+                self.standby = None;
+
+                // Reload the song ahead of the playing song by the time it took to load
+                if let Some(song) = song {
+                    if ticks_behind > MAX_STANDBY_CATCH_UP_TICKS {
+                        self.queue_standby(song, ticks_behind);
+                    }
+                }
+                return;
+            }
+        }
+
+        let standby = match self.standby.take() {
+            Some(s) => s,
+            None => return,
+        };
+
+        let mask = self.emu.apuram()[addresses::IO_MUSIC_CHANNELS_MASK as usize];
+
+        // The echo guard hit and access map of the old emulator are for the old song data
+        self.emu = standby.emu;
+        self.data_state = standby.data_state;
+        self.bc_interpreter = standby.bc_interpreter;
+        self.previous_command = standby.previous_command;
+        self.song_patch = None;
+        if standby.checkpoints.is_some() {
+            self.checkpoints = standby.checkpoints;
+        }
+
+        // The music channels mask may have changed while the standby emulator was loading
+        if self.emu.apuram()[addresses::IO_MUSIC_CHANNELS_MASK as usize] != mask {
+            self.set_music_channels_mask(MusicChannelsMask(mask));
+        }
+    }
+
+    /// Returns true if a music or sound effect channel is reading `addr_range` or will return
+    /// to `addr_range` (ie, a loop or subroutine return address is inside `addr_range`).
+    ///
+    /// Overestimates as every pair of bytes in the channel's bytecode stack is tested.
+    fn song_bytecode_in_use(&self, addr_range: Range<u16>) -> bool {
+        const COMMON_DATA_ADDR_H: u8 = (addresses::COMMON_DATA >> 8) as u8;
+        const BC_STACK: usize = addresses::BYTECODE_STACK as usize - BC_CHANNEL_STACK_OFFSET;
+
+        let apuram = self.emu.apuram();
+
+        (0..N_CHANNELS).any(|i| {
+            let inst_ptr_l = apuram[usize::from(addresses::CHANNEL_INSTRUCTION_PTR_L) + i];
+            let inst_ptr_h = apuram[usize::from(addresses::CHANNEL_INSTRUCTION_PTR_H) + i];
+
+            // Disabled channel
+            if inst_ptr_h <= COMMON_DATA_ADDR_H {
+                return false;
+            }
+
+            let stack_pointer = apuram[usize::from(addresses::CHANNEL_STACK_POINTER) + i];
+            let stack_end = BC_CHANNEL_STACK_OFFSET + (i + 1) * BC_CHANNEL_STACK_SIZE;
+            let stack_start = usize::from(stack_pointer).min(stack_end);
+
+            addr_range.contains(&u16::from_le_bytes([inst_ptr_l, inst_ptr_h]))
+                || apuram[BC_STACK + stack_start..BC_STACK + stack_end]
+                    .windows(2)
+                    .any(|w| addr_range.contains(&u16::from_le_bytes([w[0], w[1]])))
+        })
+    }
+
+    /// Writes the changed channel bytecode of the queued song patch into Audio-RAM.
+    ///
+    /// The song is only patched if the song header and subroutines are unchanged and
+    /// the audio driver is not processing the music channels.
+    /// The patch is delayed if a channel is reading the changed bytecode.
+    fn process_song_patch(&mut self) {
+        let song = match &self.song_patch {
+            Some(s) => s.clone(),
+            None => return,
+        };
+
+        // Do not patch the song while the audio driver is reading bytecode
+        if !addresses::MAIN_LOOP_CODE_RANGE.contains(&self.emu.program_counter()) {
+            return;
+        }
+
+        // Not using the sound effect buffer as it is stored after the song data
+        let (cad, old_song) = match SiCad::from_data_state(&self.data_state) {
+            Some((cad @ (SiCad::NoSfx(_) | SiCad::WithSfx(_)), s)) => (cad, s),
+            _ => {
+                self.song_patch = None;
+                self.queue_standby(song, 0);
+                return;
+            }
+        };
+
+        // The playing song must be compiled with the same common audio data as the patch
+        let cad_changed = match (&cad, &self.cad_no_sfx, &self.cad_with_sfx) {
+            (SiCad::WithSfx(c), _, Some(l)) => !Arc::ptr_eq(c, l),
+            (SiCad::NoSfx(c), Some(l), None) => !Arc::ptr_eq(c, l),
+            _ => true,
+        };
+
+        let song_addr = cad.song_data_addr();
+        let old_len = old_song.data().len();
+        let new_len = song.data().len();
+
+        let diff = song_diff(&old_song, &song);
+        let offset = match diff {
+            Some(d) => d.offset,
+            None => new_len,
+        };
+
+        // The header and subroutines are read when a channel starts or calls a subroutine
+        let header_changed = match old_song.tracking() {
+            Some(t) => offset < usize::from(t.first_channel_bc_offset),
+            None => true,
+        };
+        let fits = usize::from(song_addr) + new_len
+            <= usize::from(song.metadata().echo_buffer.buffer_addr());
+
+        if cad_changed || header_changed || !fits || self.playing_subroutine {
+            self.song_patch = None;
+            self.queue_standby(song, 0);
+            return;
+        }
+
+        let patch_start = usize::from(song_addr) + offset;
+        let patch_end = usize::from(song_addr) + old_len.max(new_len);
+
+        let patch_range = Range {
+            start: patch_start.try_into().unwrap_or(u16::MAX),
+            end: patch_end.try_into().unwrap_or(u16::MAX),
+        };
+        if self.song_bytecode_in_use(patch_range) {
+            // Try again after the next `emulate_into()` call
+            return;
+        }
+
+        self.song_patch = None;
+
+        self.emu.apuram_mut()[patch_start..usize::from(song_addr) + new_len]
+            .copy_from_slice(&song.data()[offset..]);
+
+        if new_len != old_len {
+            self.emu.set_echo_guard(
+                addresses::COMMON_DATA..=(usize::from(song_addr) + new_len - 1) as u16,
+            );
+        }
+
+        match &mut self.data_state {
+            AudioDataState::SongNoSfx(_, s) | AudioDataState::SongAndSfx(_, s) => *s = song.clone(),
+            _ => (),
+        }
+
+        let stereo_flag = match self.stereo_flag {
+            StereoFlag::Stereo => true,
+            StereoFlag::Mono => false,
+        };
+
+        // Rebuild the bytecode interpreter so return positions match the patched song
+        if let Some(old) = &self.bc_interpreter {
+            let ticks = old.tick_counter();
+            let mut si = SongInterpreter::new(cad.clone(), song.clone(), stereo_flag);
+            self.bc_interpreter = if si.process_ticks(ticks) {
+                Some(si)
+            } else {
+                None
+            };
+        }
+
+        // Checkpoints recorded after the song read a changed byte are out of date.
+        let tick = self.song_tick_counter();
+        let recorded_changed_bytecode = match diff {
+            Some(d) => u32::from(tick) >= d.tick.value(),
+            None => false,
+        };
+
+        self.update_checkpoints_song(&LoadedSongKey {
+            common_audio_data: cad,
+            song,
+            stereo_flag,
+        });
+        if recorded_changed_bytecode {
+            self.stop_recording_checkpoints();
+        }
+    }
+
+    fn meters(&mut self) -> AudioMeters {
+        self.emu.meters()
+    }
+
+    /// Returns true if `emulate_into()` will not send any input to the emulator
+    /// (the audio can be rendered ahead by the speculative renderer)
+    fn can_speculate(&self) -> bool {
+        self.song_loaded()
+            && matches!(self.sfx_queue, SfxQueue::None)
+            && self.song_patch.is_none()
+            && self.intro.is_none()
+            && self.shared_state_view.is_none()
+            && !self.standby_pending()
+    }
+
+    /// Returns true if the emulator will output silence until the next command is sent.
+    ///
+    /// Does not test the audio driver's channels, `read_voice_positions()` returns None if no
+    /// channels are active.
+    fn is_quiescent(&self) -> bool {
+        matches!(self.sfx_queue, SfxQueue::None) && self.intro.is_none() && self.emu.dsp_quiescent()
+    }
+
+    /// Returns a copy of the emulator's access map (if the `access-map` feature is enabled)
+    fn access_map(&self) -> Option<Box<[u8; 0x10000]>> {
+        self.emu.access_map().map(|m| Box::new(*m))
+    }
+
+    /// Returns the first echo buffer write to the common audio data or song data since the song
+    /// was loaded or the previous call
+    fn take_echo_guard_hit(&mut self) -> Option<EchoGuardHit> {
+        self.emu.take_echo_guard_hit()
+    }
+
+    /// The input required to render the intro of `song` with the current common audio data
+    fn intro_job(&self, song_id: ItemId, song: Arc<SongData>) -> IntroJob {
+        IntroJob {
+            song_id,
+            song,
+            stereo_flag: self.stereo_flag,
+            cad_no_sfx: self.cad_no_sfx.clone(),
+            cad_with_sfx_buffer: self.cad_with_sfx_buffer.clone(),
+            cad_with_sfx: self.cad_with_sfx.clone(),
+        }
+    }
+
+    /// Writes the next chunks of the playing intro to the ring buffer.
+    ///
+    /// Returns None if an intro is not playing or the intro has finished.
+    fn fill_ring_buffer_intro(&mut self, ring_buffer: &mut RingBuffer) -> Option<AudioMeters> {
+        let intro = self.intro.as_ref()?.intro.clone();
+        let intro = lock_intro(&intro);
+
+        let mut meters = MetersSum::default();
+
+        while let Some(p) = &mut self.intro {
+            let chunk = match intro.chunks.get(p.next_chunk) {
+                Some(c) => c,
+                None => {
+                    // The last chunk has a snapshot, the emulator is up to date
+                    self.intro = None;
+                    if meters.count == 0 {
+                        return None;
+                    }
+                    break;
+                }
+            };
+            p.next_chunk += 1;
+            p.chunks_after_snapshot += 1;
+
+            if let Some(snapshot) = &chunk.snapshot {
+                p.chunks_after_snapshot = 0;
+                self.load_snapshot(snapshot.clone());
+            }
+            meters.add(&chunk.meters);
+
+            let full = ring_buffer.add_chunk(&chunk.samples);
+            if full {
+                break;
+            }
+        }
+
+        Some(meters.meters())
+    }
+
+    /// Stops the playing intro and emulates the audio played after the last intro snapshot
+    fn stop_intro(&mut self) {
+        if let Some(p) = self.intro.take() {
+            let mut chunk = [0; RingBuffer::EMU_BUFFER_SIZE];
+
+            for _ in 0..p.chunks_after_snapshot {
+                self.emulate_into(&mut chunk);
+            }
+        }
+    }
+
+    /// Replaces the emulator with a speculative renderer snapshot
+    fn load_snapshot(&mut self, snapshot: ShvcSoundEmu) {
+        self.emu = snapshot;
+        self.record_checkpoint();
+    }
+
+    /// Stops the playing intro and the speculative renderer and emulates the audio consumed after
+    /// the last snapshot, so the emulator is at the end of the audio written to the ring buffer.
+    fn stop_speculating(&mut self, renderer: &mut Renderer) {
+        self.stop_intro();
+
+        let mut chunk = [0; RingBuffer::EMU_BUFFER_SIZE];
+
+        for _ in 0..renderer.stop() {
+            self.emulate_into(&mut chunk);
+        }
+    }
 
+    fn emulate_into(&mut self, out: &mut [i16; RingBuffer::EMU_BUFFER_SIZE]) {
         if !self.song_loaded() {
-            return &EMPTY_BUFFER;
+            out.fill(0);
+            return;
         }
 
+        self.process_standby();
         self.process_sfx_queue();
+        self.process_song_patch();
+
+        self.before_recorded_change();
+        self.emu.emulate_into(out);
+        self.after_recorded_change(&[]);
+
+        if let Some(v) = &mut self.shared_state_view {
+            v.publish(&mut self.emu, &MONITOR_LAYOUT);
+        }
 
-        self.emu.emulate()
+        self.record_checkpoint();
     }
 
     /// Returns None if the song and sound effects have finished
     fn read_voice_positions(&mut self) -> Option<AudioMonitorData> {
-        const ALL_CHANNELS_INSTRUCTION_PTR_H_RANGE: Range<usize> = Range {
-            start: addresses::CHANNEL_INSTRUCTION_PTR_H as usize,
-            end: addresses::CHANNEL_INSTRUCTION_PTR_H as usize + N_CHANNELS,
-        };
+        const _: () = assert!(MonitorSnapshot::N_CHANNELS == N_CHANNELS);
         const COMMON_DATA_ADDR_H: u8 = (addresses::COMMON_DATA >> 8) as u8;
 
         if !self.song_loaded() {
             return None;
         }
 
-        let apuram = self.emu.apuram();
-
-        let song_addr = u16::from_le_bytes([
-            apuram[usize::from(addresses::SONG_PTR)],
-            apuram[usize::from(addresses::SONG_PTR) + 1],
-        ]);
-
-        let music_channels_mask = apuram[addresses::IO_MUSIC_CHANNELS_MASK as usize];
-
-        let read_offsets = |addr_l: u16, addr_h: u16| -> [Option<u16>; N_MUSIC_CHANNELS] {
-            std::array::from_fn(|i| {
-                const _: () = assert!(N_MUSIC_CHANNELS <= 8);
+        let channels = self.emu.monitor_snapshot(&MONITOR_LAYOUT);
 
-                if music_channels_mask & (1 << i) != 0 {
-                    let word = u16::from_le_bytes([
-                        apuram[usize::from(addr_l) + i],
-                        apuram[usize::from(addr_h) + i],
-                    ]);
-                    word.checked_sub(song_addr)
-                } else {
-                    None
-                }
-            })
-        };
+        let voice_instruction_ptrs = std::array::from_fn(|i| {
+            const _: () = assert!(N_MUSIC_CHANNELS <= 8);
 
-        let voice_instruction_ptrs = read_offsets(
-            addresses::CHANNEL_INSTRUCTION_PTR_L,
-            addresses::CHANNEL_INSTRUCTION_PTR_H,
-        );
+            if channels.music_channels_mask & (1 << i) != 0 {
+                channels.instruction_ptrs[i].checked_sub(channels.song_ptr)
+            } else {
+                None
+            }
+        });
 
         let voice_return_inst_ptrs = match &mut self.bc_interpreter {
             Some(b) => {
-                const STC: usize = addresses::SONG_TICK_COUNTER as usize;
-
                 // Assumes number of ticks since the last read was < 256;
                 let bc_tick_counter_l = b.tick_counter().value().to_le_bytes()[0];
-                let emu_tick_counter_l = apuram[STC];
+                let emu_tick_counter_l = channels.song_tick_counter.to_le_bytes()[0];
 
                 let ticks_passed = emu_tick_counter_l.wrapping_sub(bc_tick_counter_l);
                 if ticks_passed > 0 {
@@ -954,7 +2696,7 @@ impl TadEmu {
                 }
                 debug_assert_eq!(
                     b.tick_counter().value() as u16,
-                    u16::from_le_bytes(apuram[STC..STC + 2].try_into().unwrap()),
+                    channels.song_tick_counter,
                     "Bytecode interpreter desync"
                 );
 
@@ -965,15 +2707,19 @@ impl TadEmu {
             None => Default::default(),
         };
 
-        let any_channels_active = apuram[ALL_CHANNELS_INSTRUCTION_PTR_H_RANGE]
+        let any_channels_active = channels
+            .instruction_ptrs
             .iter()
-            .any(|&inst_ptr_h| inst_ptr_h > COMMON_DATA_ADDR_H);
+            .any(|&inst_ptr| inst_ptr.to_le_bytes()[1] > COMMON_DATA_ADDR_H);
 
         if any_channels_active {
             Some(AudioMonitorData {
                 song_id: self.song_id,
                 voice_instruction_ptrs,
                 voice_return_inst_ptrs,
+                channels,
+                playback: PlaybackStats::default(),
+                meters: AudioMeters::default(),
             })
         } else {
             None
@@ -998,16 +2744,115 @@ impl PlayState {
     }
 }
 
+/// Boots the intro job's song in `tad` and renders the first `INTRO_CHUNKS` chunks.
+///
+/// Called on the intro render thread.
+fn render_song_intro(tad: &mut TadEmu, job: IntroJob) -> Option<SongIntro> {
+    tad.cad_no_sfx = job.cad_no_sfx;
+    tad.cad_with_sfx_buffer = job.cad_with_sfx_buffer;
+    tad.cad_with_sfx = job.cad_with_sfx;
+    tad.set_stereo_flag(job.stereo_flag);
+
+    tad.load_song(
+        job.song_id,
+        job.song,
+        TickCounter::new(0),
+        MusicChannelsMask::ALL,
+    )
+    .ok()?;
+
+    // The checkpoints are recorded by the audio thread when the intro is played
+    tad.checkpoints = None;
+
+    let stereo_flag = match tad.stereo_flag {
+        StereoFlag::Stereo => true,
+        StereoFlag::Mono => false,
+    };
+    let key = SiCad::from_data_state(&tad.data_state).map(|(cad, song)| LoadedSongKey {
+        common_audio_data: cad,
+        song,
+        stereo_flag,
+    })?;
+
+    // Discard the levels of any audio emulated before the start
+    tad.emu.meters();
+
+    let start = tad.emu.clone();
+
+    let chunks = (1..=INTRO_CHUNKS)
+        .map(|i| {
+            let mut samples = Box::new([0; RingBuffer::EMU_BUFFER_SIZE]);
+            tad.emu.emulate_into(samples.as_mut_slice());
+            let meters = tad.emu.meters();
+
+            let snapshot = match i % SNAPSHOT_INTERVAL == 0 || i == INTRO_CHUNKS {
+                true => Some(tad.emu.clone()),
+                false => None,
+            };
+
+            SpeculativeChunk {
+                samples,
+                meters,
+                snapshot,
+            }
+        })
+        .collect();
+
+    tad.stop_song();
+
+    Some(SongIntro { key, start, chunks })
+}
+
+/// Loads the standby job's song in `tad` and seeks to the job's song tick.
+///
+/// Called on the standby loader thread.
+fn load_standby(tad: &mut TadEmu, job: StandbyJob) -> Option<Standby> {
+    tad.cad_no_sfx = job.cad_no_sfx;
+    tad.cad_with_sfx_buffer = job.cad_with_sfx_buffer;
+    tad.cad_with_sfx = job.cad_with_sfx;
+    tad.set_stereo_flag(job.stereo_flag);
+
+    // Restores a checkpoint (if possible) instead of writing the bytecode interpreter state
+    // to the boot snapshot
+    tad.checkpoints = job.checkpoints;
+
+    let r = tad.load_song(
+        job.song_id,
+        job.song,
+        TickCounter::new(job.tick.into()),
+        job.music_channels_mask,
+    );
+    let checkpoints = tad.checkpoints.take();
+    r.ok()?;
+
+    let standby = Standby {
+        song_id: job.song_id,
+        emu: tad.emu.clone(),
+        data_state: std::mem::replace(&mut tad.data_state, AudioDataState::NotLoaded),
+        bc_interpreter: tad.bc_interpreter.take(),
+        checkpoints,
+        previous_command: tad.previous_command,
+    };
+
+    tad.stop_song();
+
+    Some(standby)
+}
+
 struct AudioThread {
     sender: mpsc::Sender<AudioMessage>,
     rx: mpsc::Receiver<AudioMessage>,
 
     gui_sender: fltk::app::Sender<GuiMessage>,
-    monitor: AudioMonitor,
+    monitor: AudioMonitorWriter,
 
     sdl_context: Sdl,
+    low_latency: bool,
 
     tad: TadEmu,
+    renderer: Renderer,
+    intro_renderer: SongIntroRenderer,
+    note_cache: InstrumentNoteCache,
 }
 
 impl AudioThread {
@@ -1015,16 +2860,32 @@ impl AudioThread {
         sender: mpsc::Sender<AudioMessage>,
         rx: mpsc::Receiver<AudioMessage>,
         gui_sender: fltk::app::Sender<GuiMessage>,
-        monitor: AudioMonitor,
+        monitor: AudioMonitorWriter,
     ) -> Self {
+        let intro_renderer = SongIntroRenderer::new({
+            let mut tad = TadEmu::new(None);
+            move |job| render_song_intro(&mut tad, job)
+        });
+
         Self {
             sender,
             rx,
             gui_sender,
             monitor,
             sdl_context: sdl2::init().unwrap(),
-
-            tad: TadEmu::new(),
+            low_latency: false,
+
+            tad: TadEmu {
+                session_recorder: SessionRecorder::from_env(),
+                standby_loader: Some(SongStandbyLoader::new({
+                    let mut tad = TadEmu::new(None);
+                    move |job| load_standby(&mut tad, job)
+                })),
+                ..TadEmu::new(Some(intro_renderer.cache()))
+            },
+            renderer: Renderer::new(),
+            intro_renderer,
+            note_cache: InstrumentNoteCache::new(render_instrument_notes),
         }
     }
 
@@ -1077,6 +2938,21 @@ impl AudioThread {
                 // Disable unpause
                 self.tad.stop_song();
             }
+            AudioMessage::SetLowLatency(l) => {
+                self.low_latency = l;
+            }
+            AudioMessage::SetLiveSongPatching(l) => {
+                self.tad.set_live_song_patching(l);
+            }
+            AudioMessage::SetStandbyReload(r) => {
+                self.tad.set_standby_reload(r);
+            }
+            AudioMessage::SetSharedStateView(v) => {
+                if let Err(e) = self.tad.set_shared_state_view(v) {
+                    self.gui_sender
+                        .send(GuiMessage::AudioThreadSharedStateViewError(e));
+                }
+            }
 
             AudioMessage::PlaySong(song_id, song, song_skip, channels_mask) => {
                 if self
@@ -1126,8 +3002,29 @@ impl AudioThread {
                 }
             }
 
+            AudioMessage::CacheInstrumentNotes(id, job) => {
+                self.note_cache.queue(id, *job);
+            }
+            AudioMessage::PlayInstrumentNote(id, note, common_data, song_data) => {
+                let audition = self
+                    .note_cache
+                    .find(id)
+                    .and_then(|c| DspSampleAudition::instrument_note(&c, &note));
+
+                match audition {
+                    Some(a) => return self.play_dsp_audition(a),
+                    None => {
+                        if self.tad.play_sample(common_data, song_data).is_ok() {
+                            return self.play_song();
+                        }
+                    }
+                }
+            }
+
             AudioMessage::PlayBrrSampleAt32Khz(brr_sample) => {
-                return self.play_brr_sample(&brr_sample);
+                if let Some(a) = DspSampleAudition::brr_sample(&brr_sample) {
+                    return self.play_dsp_audition(a);
+                }
             }
 
             AudioMessage::PauseResume(id) => {
@@ -1141,6 +3038,10 @@ impl AudioThread {
                 }
             }
 
+            AudioMessage::SongRecompiled(id, song) => {
+                self.intro_renderer.queue(id, self.tad.intro_job(id, song));
+            }
+
             AudioMessage::StopAndClose
             | AudioMessage::CloseIfSongIdEquals(_)
             | AudioMessage::Pause
@@ -1164,19 +3065,29 @@ impl AudioThread {
             samples: Some(RingBuffer::SDL_BUFFER_SAMPLES.try_into().unwrap()),
         };
 
-        let mut playback = audio_subsystem
-            .open_playback(None, &desired_spec, {
-                |_spec| RingBuffer::new(self.sender.clone())
-            })
-            .unwrap();
+        let (mut ring_buffer, mut playback) = RingBuffer::open_playback(
+            &audio_subsystem,
+            &desired_spec,
+            self.sender.clone(),
+            self.low_latency,
+        );
 
-        fill_ring_buffer_emu(&mut self.tad, &mut playback);
+        fill_ring_buffer_emu(&mut self.tad, &mut self.renderer, &mut ring_buffer);
 
         let mut state = PlayState::Running;
         playback.resume();
 
         // Will exit the loop and close the audio device on timeout or channel disconnect.
         while let Ok(msg) = self.rx.recv_timeout(state.timeout_until_close()) {
+            // Discard the speculatively rendered audio on input
+            match msg {
+                AudioMessage::RingBufferConsumed(_)
+                | AudioMessage::SetLowLatency(_)
+                | AudioMessage::CacheInstrumentNotes(..) => (),
+                AudioMessage::SongRecompiled(id, _) if Some(id) != self.tad.song_id() => (),
+                _ => self.tad.stop_speculating(&mut self.renderer),
+            }
+
             match msg {
                 AudioMessage::StopAndClose => break,
 
@@ -1187,23 +3098,36 @@ impl AudioThread {
                 }
 
                 AudioMessage::RingBufferConsumed(_) => {
+                    ring_buffer.consumed_message_received();
+
                     match state {
                         PlayState::Paused | PlayState::SongFinished => (),
                         PlayState::Running => {
-                            let sound = fill_ring_buffer_emu(&mut self.tad, &mut playback);
-
+                            let meters = fill_ring_buffer_emu(
+                                &mut self.tad,
+                                &mut self.renderer,
+                                &mut ring_buffer,
+                            );
                             // Detect when the song has finished playing.
                             //
-                            // Must test if the emulator is outputting audio as the echo buffer
-                            // feedback can output sound long after the song has finished.
+                            // Must test if the S-DSP is quiescent as the echo buffer feedback can
+                            // output sound long after the song has finished.
+                            // (It is not enough to test for a silent chunk, the echo buffer
+                            // can be silent between echoes and the feedback can leave a small
+                            // residue that never decays to zero.)
                             let voices = self.tad.read_voice_positions();
-                            if voices.is_some() {
-                                self.monitor.set(voices);
-                            } else if sound {
-                                self.monitor
-                                    .set(Some(AudioMonitorData::new(self.tad.song_id())));
+                            if let Some(mut voices) = voices {
+                                voices.playback = ring_buffer.playback_stats();
+                                voices.meters = meters.unwrap_or_default();
+                                self.monitor.set(Some(voices));
+                            } else if !self.tad.is_quiescent() {
+                                let mut data = AudioMonitorData::new(self.tad.song_id());
+                                data.playback = ring_buffer.playback_stats();
+                                data.meters = meters.unwrap_or_default();
+                                self.monitor.set(Some(data));
                             } else {
                                 // The song has finished
+                                self.tad.stop_speculating(&mut self.renderer);
                                 self.tad.stop_song();
                                 state = PlayState::SongFinished;
                                 playback.pause();
@@ -1212,7 +3136,7 @@ impl AudioThread {
                             }
                         }
                         PlayState::PauseRequested => {
-                            playback.lock().fill_remaining_with_silence();
+                            ring_buffer.fill_remaining_with_silence();
                             state = PlayState::Pausing;
                         }
                         PlayState::Pausing => {
@@ -1220,7 +3144,7 @@ impl AudioThread {
                             playback.pause();
 
                             // Reset ring buffer to the beginning when playback is resumed.
-                            playback.lock().reset();
+                            ring_buffer.reset(&mut playback);
 
                             self.monitor.set(None);
                         }
@@ -1238,7 +3162,7 @@ impl AudioThread {
                 AudioMessage::PlaySong(id, song, song_skip, channels_mask) => {
                     // Pause playback to prevent buffer overrun when tick_to_skip is large.
                     playback.pause();
-                    playback.lock().reset();
+                    ring_buffer.reset(&mut playback);
                     match self
                         .tad
                         .load_song(id, song.clone(), song_skip, channels_mask)
@@ -1259,7 +3183,7 @@ impl AudioThread {
                 AudioMessage::PlaySongSubroutine(id, song, prefix, si, skip) => {
                     // Pause playback to prevent buffer overrun when tick_to_skip is large.
                     playback.pause();
-                    playback.lock().reset();
+                    ring_buffer.reset(&mut playback);
                     match self
                         .tad
                         .load_song_subroutine(id, song.clone(), prefix, si, skip)
@@ -1296,7 +3220,7 @@ impl AudioThread {
                 AudioMessage::PlaySongWithSfxBuffer(id, song, song_skip) => {
                     // Pause playback to prevent buffer overrun when tick_to_skip is large.
                     playback.pause();
-                    playback.lock().reset();
+                    ring_buffer.reset(&mut playback);
                     match self
                         .tad
                         .load_song_with_sfx_buffer(id, song.clone(), song_skip)
@@ -1330,9 +3254,16 @@ impl AudioThread {
                     }
                 },
 
-                AudioMessage::PlaySample(common_data, song_data) => {
+                // Must close `AudioDevice` to play a cached note (different sample rate)
+                m @ AudioMessage::PlayInstrumentNote(id, ..)
+                    if self.note_cache.find(id).is_some() =>
+                {
+                    return Some(m);
+                }
+                AudioMessage::PlaySample(common_data, song_data)
+                | AudioMessage::PlayInstrumentNote(_, _, common_data, song_data) => {
                     playback.pause();
-                    playback.lock().reset();
+                    ring_buffer.reset(&mut playback);
 
                     match self.tad.play_sample(common_data, song_data) {
                         Ok(()) => {
@@ -1378,6 +3309,37 @@ impl AudioThread {
                     }
                 }
 
+                AudioMessage::SetLowLatency(l) => {
+                    self.low_latency = l;
+                    ring_buffer.set_low_latency(l);
+                }
+
+                AudioMessage::SetLiveSongPatching(l) => {
+                    self.tad.set_live_song_patching(l);
+                }
+
+                AudioMessage::SetStandbyReload(r) => {
+                    self.tad.set_standby_reload(r);
+                }
+
+                AudioMessage::SetSharedStateView(v) => {
+                    if let Err(e) = self.tad.set_shared_state_view(v) {
+                        self.gui_sender
+                            .send(GuiMessage::AudioThreadSharedStateViewError(e));
+                    }
+                }
+
+                AudioMessage::SongRecompiled(id, song) => {
+                    if Some(id) == self.tad.song_id() {
+                        self.tad.song_recompiled(song.clone());
+                    }
+                    self.intro_renderer.queue(id, self.tad.intro_job(id, song));
+                }
+
+                AudioMessage::CacheInstrumentNotes(id, job) => {
+                    self.note_cache.queue(id, *job);
+                }
+
                 // Cannot process these messages here.
                 // Must reload the song when the stereo flag changes.
                 // Must close `AudioDevice` to change the sample rate.
@@ -1387,45 +3349,61 @@ impl AudioThread {
             }
         }
 
+        self.tad.stop_speculating(&mut self.renderer);
+
+        if let Some(map) = self.tad.access_map() {
+            self.gui_sender.send(GuiMessage::AudioThreadAccessMap(map));
+        }
+
+        if let (Some(id), Some(hit)) = (self.tad.song_id(), self.tad.take_echo_guard_hit()) {
+            self.gui_sender
+                .send(GuiMessage::AudioThreadEchoOverwrite(id, hit.address));
+        }
+
         None
     }
 
     // Returns Some if the AudioMessage could not be processed
     #[must_use]
-    fn play_brr_sample(&self, sample: &BrrSample) -> Option<AudioMessage> {
+    fn play_dsp_audition(&self, mut audition: DspSampleAudition) -> Option<AudioMessage> {
         const TIMEOUT: Duration = Duration::from_secs(1);
 
         let audio_subsystem = self.sdl_context.audio().unwrap();
         let desired_spec = AudioSpecDesired {
             freq: Some(BRR_SAMPLE_RATE),
-            channels: Some(1),
-            samples: Some((RingBuffer::SDL_BUFFER_SAMPLES * 2).try_into().unwrap()),
+            channels: Some(2),
+            samples: Some(RingBuffer::SDL_BUFFER_SAMPLES.try_into().unwrap()),
         };
 
-        let mut playback = audio_subsystem
-            .open_playback(None, &desired_spec, {
-                |_spec| RingBuffer::new(self.sender.clone())
-            })
-            .unwrap();
+        let (mut ring_buffer, playback) = RingBuffer::open_playback(
+            &audio_subsystem,
+            &desired_spec,
+            self.sender.clone(),
+            self.low_latency,
+        );
 
-        let mut decoder = BrrSampleDecoder::new(sample);
         let mut remaining_after_finished: i32 = 1;
 
-        decoder.fill_ring_buffer(&mut playback);
+        audition.fill_ring_buffer(&mut ring_buffer);
 
         playback.resume();
 
         while let Ok(msg) = self.rx.recv_timeout(TIMEOUT) {
             match msg {
                 AudioMessage::RingBufferConsumed(_) => {
-                    if decoder.is_finished() {
+                    ring_buffer.consumed_message_received();
+
+                    if audition.is_finished() {
                         // Must wait one more `RingBufferConsumed` message
                         remaining_after_finished -= 1;
                         if remaining_after_finished < 0 {
                             return None;
                         }
                     }
-                    decoder.fill_ring_buffer(&mut playback);
+                    audition.fill_ring_buffer(&mut ring_buffer);
+                }
+                AudioMessage::CacheInstrumentNotes(id, job) => {
+                    self.note_cache.queue(id, *job);
                 }
                 m => {
                     return Some(m);
@@ -1444,14 +3422,13 @@ pub fn create_audio_thread(
     AudioMonitor,
 ) {
     let (sender, rx) = mpsc::channel();
-    let monitor = AudioMonitor::new();
+    let (monitor_writer, monitor) = AudioMonitor::new();
 
     let handler = thread::Builder::new()
         .name("audio_thread".into())
         .spawn({
             let s = sender.clone();
-            let m = monitor.clone();
-            move || AudioThread::new(s, rx, gui_sender, m).run()
+            move || AudioThread::new(s, rx, gui_sender, monitor_writer).run()
         })
         .unwrap();
 
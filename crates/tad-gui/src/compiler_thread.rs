@@ -5,22 +5,27 @@
 // SPDX-License-Identifier: MIT
 
 use crate::names::NameGetter;
+use crate::note_cache::NoteCacheJob;
 use crate::sample_analyser::{self, SampleAnalysis};
 use crate::sfx_export_order::{GuiSfxExportOrder, SfxExportOrderAction};
 use crate::GuiMessage;
 
 use crate::audio_thread::{
-    AudioMessage, CommonAudioDataNoSfx, CommonAudioDataWithSfxBuffer, MusicChannelsMask,
-    SFX_BUFFER_SIZE,
+    AudioMessage, CommonAudioDataNoSfx, CommonAudioDataWithSfxBuffer, InstrumentNote,
+    MusicChannelsMask, SFX_BUFFER_SIZE,
 };
 
-use std::collections::hash_map::Entry;
+use std::collections::hash_map::{DefaultHasher, Entry};
 use std::collections::HashMap;
 use std::fmt::Display;
+use std::hash::{Hash, Hasher};
 use std::ops::Deref;
 use std::sync::{mpsc, Arc};
 use std::thread;
 
+use compiler::audible_end::{
+    instrument_audible_end, sample_audible_end, AudibleEnd, DEFAULT_AUDIBLE_THRESHOLD_DB,
+};
 use compiler::common_audio_data::{build_common_audio_data, CommonAudioData};
 use compiler::data::{self, BrrEvaluator};
 use compiler::data::{load_text_file_with_limit, DefaultSfxFlags, LoopSetting, TextFile};
@@ -32,11 +37,13 @@ use compiler::errors::{
 };
 use compiler::mml::compile_mml_prefix;
 use compiler::notes::Note;
+use compiler::parallel::{available_threads, parallel_map};
 use compiler::path::{ParentPathBuf, SourcePathBuf};
 use compiler::samples::{
     combine_samples, create_test_instrument_data, encode_or_load_brr_file,
-    load_sample_for_instrument, load_sample_for_sample, CompiledDataList, InstrumentSampleData,
-    SampleAndInstrumentData, SampleFileCache, SampleSampleData, WAV_EXTENSION,
+    load_sample_for_instrument, load_sample_for_sample, test_instrument_pitches, CompiledDataList,
+    InstrumentSampleData, SampleAndInstrumentData, SampleFileCache, SampleSampleData,
+    WAV_EXTENSION,
 };
 use compiler::songs::{test_sample_song, SongAramSize, SongData, BLANK_SONG_ARAM_SIZE};
 use compiler::sound_effects::{
@@ -153,11 +160,13 @@ pub enum ToCompiler {
     RecompileInstrumentsUsingSample(SourcePathBuf),
 }
 
+/// BRR sample size and audible end (None if the sample loops)
 #[derive(Debug)]
-pub struct InstrumentSize(pub usize);
+pub struct InstrumentSize(pub usize, pub Option<AudibleEnd>);
 
+/// BRR sample size and audible end (None if the sample loops)
 #[derive(Debug)]
-pub struct SampleSize(pub usize);
+pub struct SampleSize(pub usize, pub Option<AudibleEnd>);
 
 pub type InstrumentOutput = Result<InstrumentSize, errors::SampleError>;
 pub type SampleOutput = Result<SampleSize, errors::SampleError>;
@@ -187,7 +196,7 @@ pub enum CompilerOutput {
     // The result of the last `ToCompiler::ExportSongToSpcFile` operation
     SpcFileResult(Result<(String, Vec<u8>), SpcFileError>),
 
-    SampleAnalysis(Result<SampleAnalysis, BrrError>),
+    SampleAnalysis(Result<Arc<SampleAnalysis>, BrrError>),
 }
 
 #[derive(Debug)]
@@ -575,6 +584,26 @@ where
         }
     }
 
+    /// Recompiles every item on multiple threads.
+    ///
+    /// The outputs are stored in item order (not the order the items finished compiling).
+    fn recompile_all_parallel(&mut self, compiler_fn: impl Fn(ItemId, &ItemT) -> OutT + Sync)
+    where
+        ItemT: Sync,
+        OutT: Send,
+    {
+        let to_compile: Vec<(ItemId, usize)> = self.map.iter().map(|(&id, &i)| (id, i)).collect();
+
+        let items = &self.items;
+        let out = parallel_map(&to_compile, available_threads(), |&(id, index)| {
+            compiler_fn(id, &items[index])
+        });
+
+        for ((_, index), o) in to_compile.into_iter().zip(out) {
+            self.output[index] = o;
+        }
+    }
+
     fn recompile_all_if(
         &mut self,
         mut compiler_fn: impl FnMut(ItemId, &ItemT) -> OutT,
@@ -634,7 +663,10 @@ fn create_instrument_compiler<'a>(
         Ok(s) => {
             sender.send(CompilerOutput::Instrument(
                 id,
-                Ok(InstrumentSize(s.sample_size())),
+                Ok(InstrumentSize(
+                    s.sample_size(),
+                    instrument_audible_end(inst, &s, DEFAULT_AUDIBLE_THRESHOLD_DB),
+                )),
             ));
             Some(s)
         }
@@ -651,7 +683,13 @@ fn create_sample_compiler<'a>(
 ) -> impl (FnMut(ItemId, &data::Sample) -> Option<SampleSampleData>) + 'a {
     |id, sample| match load_sample_for_sample(sample, sample_file_cache) {
         Ok(s) => {
-            sender.send(CompilerOutput::Sample(id, Ok(SampleSize(s.sample_size()))));
+            sender.send(CompilerOutput::Sample(
+                id,
+                Ok(SampleSize(
+                    s.sample_size(),
+                    sample_audible_end(sample, &s, DEFAULT_AUDIBLE_THRESHOLD_DB),
+                )),
+            ));
             Some(s)
         }
         Err(e) => {
@@ -661,16 +699,44 @@ fn create_sample_compiler<'a>(
     }
 }
 
+fn note_cache_job(
+    instruments: &CList<data::Instrument, Option<InstrumentSampleData>>,
+    id: ItemId,
+) -> Option<NoteCacheJob> {
+    let sample = match instruments.get_output_for_id(&id) {
+        Some(Some(s)) => s,
+        _ => return None,
+    };
+
+    Some(NoteCacheJob {
+        brr_sample: sample.brr_sample().clone(),
+        adsr1: sample.adsr1(),
+        adsr2_or_gain: sample.adsr2_or_gain(),
+        pitches: test_instrument_pitches(sample)?,
+    })
+}
+
 fn build_play_instrument_data(
     instruments: &CList<data::Instrument, Option<InstrumentSampleData>>,
     id: ItemId,
     args: PlaySampleArgs,
-) -> Option<(CommonAudioData, SongData)> {
+) -> Option<(CommonAudioData, SongData, InstrumentNote)> {
     let sample = match instruments.get_output_for_id(&id) {
         Some(Some(s)) => s,
         _ => return None,
     };
 
+    let (adsr1, adsr2_or_gain) = match &args.envelope {
+        Some(e) => e.engine_value(),
+        None => (sample.adsr1(), sample.adsr2_or_gain()),
+    };
+    let note = InstrumentNote {
+        note_id: args.note.note_id(),
+        note_length: args.note_length,
+        adsr1,
+        adsr2_or_gain,
+    };
+
     let (sample_data, max_octave) = create_test_instrument_data(sample)?;
 
     if args.note > Note::last_note_for_octave(max_octave) {
@@ -683,7 +749,7 @@ fn build_play_instrument_data(
         build_common_audio_data(&sample_data, &blank_sfx_subroutines, &blank_sfx).ok()?;
     let song_data = test_sample_song(0, args.note, args.note_length, args.envelope).ok()?;
 
-    Some((common_audio_data, song_data))
+    Some((common_audio_data, song_data, note))
 }
 
 fn build_play_sample_data(
@@ -755,7 +821,7 @@ fn create_sfx_compiler<'a>(
     dependencies: &'a Option<SongDependencies>,
     sfx_subroutines: &'a Option<Arc<CompiledSfxSubroutines>>,
     sender: &'a Sender,
-) -> impl (Fn(ItemId, &SoundEffectInput) -> Option<Arc<CompiledSoundEffect>>) + 'a {
+) -> impl (Fn(ItemId, &SoundEffectInput) -> Option<Arc<CompiledSoundEffect>>) + Sync + 'a {
     move |id, sfx| {
         let dep = match dependencies.as_ref() {
             Some(d) => d,
@@ -839,11 +905,19 @@ fn calc_sfx_data_size(
     sfx_table_size + sfx_size + sfx_subroutines
 }
 
+// The project data a compiled song depends on (used to detect if a song needs recompiling)
+#[derive(PartialEq)]
+struct SongDependencyInputs {
+    instruments: Vec<data::Instrument>,
+    samples: Vec<data::Sample>,
+}
+
 struct SongDependencies {
     inst_map: data::UniqueNamesList<data::InstrumentOrSample>,
     combined_samples: SampleAndInstrumentData,
     common_data_no_sfx_size: usize,
     sfx_data_size: usize,
+    inputs: Arc<SongDependencyInputs>,
 }
 
 impl SongDependencies {
@@ -895,6 +969,10 @@ fn build_cad_no_sfx_and_song_dependencies(
                 combined_samples,
                 common_data_no_sfx_size: cad.data().len(),
                 sfx_data_size: calc_sfx_data_size(sfx_export_order, sfx_subroutines, sound_effects),
+                inputs: Arc::new(SongDependencyInputs {
+                    instruments: instruments.items().to_vec(),
+                    samples: samples.items.to_vec(),
+                }),
             };
             Ok((Arc::new(CommonAudioDataNoSfx(cad)), sd))
         }
@@ -965,9 +1043,72 @@ fn build_common_audio_data_with_sfx(
     (cad, sfx_data_size)
 }
 
+// The inputs of a successfully compiled song
+struct SongCacheKey {
+    // Hash of the song name and MML text
+    mml_hash: u64,
+    dependencies: Arc<SongDependencyInputs>,
+}
+
+impl SongCacheKey {
+    fn new(name: Option<&data::Name>, f: &TextFile, dependencies: &SongDependencies) -> Self {
+        let mut hasher = DefaultHasher::new();
+        name.hash(&mut hasher);
+        f.contents.hash(&mut hasher);
+
+        Self {
+            mml_hash: hasher.finish(),
+            dependencies: dependencies.inputs.clone(),
+        }
+    }
+
+    fn matches(&self, other: &Self) -> bool {
+        self.mml_hash == other.mml_hash
+            && (Arc::ptr_eq(&self.dependencies, &other.dependencies)
+                || self.dependencies == other.dependencies)
+    }
+}
+
 struct SongState {
     file: TextFile,
     song_data: Option<Arc<SongData>>,
+    cache_key: Option<SongCacheKey>,
+}
+
+impl SongState {
+    fn new(file: TextFile) -> Self {
+        Self {
+            file,
+            song_data: None,
+            cache_key: None,
+        }
+    }
+
+    /// Compiles the song, unless the MML and dependencies are unchanged since the last
+    /// successful compile (the song size is always rechecked).
+    fn compile(
+        &mut self,
+        id: ItemId,
+        name: Option<&data::Name>,
+        dependencies: &Option<SongDependencies>,
+        sender: &Sender,
+    ) {
+        let key = dependencies
+            .as_ref()
+            .map(|d| SongCacheKey::new(name, &self.file, d));
+
+        if let (Some(dep), Some(key), Some(old_key), Some(song_data)) =
+            (dependencies, &key, &self.cache_key, &self.song_data)
+        {
+            if key.matches(old_key) {
+                SongCompiler::send_song_size_result(id, song_data, dep, sender);
+                return;
+            }
+        }
+
+        self.song_data = SongCompiler::compile_song(id, name, &self.file, dependencies, sender);
+        self.cache_key = self.song_data.as_ref().and(key);
+    }
 }
 struct SongCompiler {
     parent_path: ParentPathBuf,
@@ -1020,7 +1161,18 @@ impl SongCompiler {
             }
         };
 
-        match compiler::songs::validate_song_size(&song_data, dep.common_data_size()) {
+        Self::send_song_size_result(id, &song_data, dep, sender);
+
+        Some(song_data)
+    }
+
+    fn send_song_size_result(
+        id: ItemId,
+        song_data: &Arc<SongData>,
+        dep: &SongDependencies,
+        sender: &Sender,
+    ) {
+        match compiler::songs::validate_song_size(song_data, dep.common_data_size()) {
             Ok(()) => {
                 sender.send(CompilerOutput::Song(id, Ok(song_data.clone())));
             }
@@ -1028,18 +1180,17 @@ impl SongCompiler {
                 sender.send(CompilerOutput::Song(id, Err(SongError::TooLarge(e))));
             }
         }
-
-        Some(song_data)
     }
 
+    // Reuses the previous compiled song if the song file is unchanged
     fn load_and_compile_song(
-        &self,
+        &mut self,
         id: ItemId,
         source_path: &SourcePathBuf,
         pf_songs: &IList<data::Song>,
         dependencies: &Option<SongDependencies>,
         sender: &Sender,
-    ) -> SongState {
+    ) {
         let song_name = pf_songs.get(&id).map(|s| &s.name);
 
         let file = match load_text_file_with_limit(source_path, &self.parent_path) {
@@ -1051,10 +1202,15 @@ impl SongCompiler {
             },
         };
 
-        SongState {
-            song_data: Self::compile_song(id, song_name, &file, dependencies, sender),
-            file,
-        }
+        let state = match self.songs.entry(id) {
+            Entry::Occupied(o) => {
+                let state = o.into_mut();
+                state.file = file;
+                state
+            }
+            Entry::Vacant(v) => v.insert(SongState::new(file)),
+        };
+        state.compile(id, song_name, dependencies, sender);
     }
 
     fn replace_all_and_load_songs(&mut self, pf_songs: &ReplaceAllVec<data::Song>) {
@@ -1063,13 +1219,7 @@ impl SongCompiler {
             .iter()
             .filter_map(|(id, item)| {
                 match load_text_file_with_limit(&item.source, &self.parent_path) {
-                    Ok(file) => Some((
-                        *id,
-                        SongState {
-                            song_data: None,
-                            file,
-                        },
-                    )),
+                    Ok(file) => Some((*id, SongState::new(file))),
                     Err(_) => None,
                 }
             })
@@ -1086,12 +1236,8 @@ impl SongCompiler {
         let mut add_or_edit = |id: &ItemId, item: &data::Song| {
             // Only add songs, do not modify them
             // (source is not editable by the GUI)
-            #[allow(clippy::map_entry)] // Cannot use HashMap::entry() due to the borrow checker
             if !self.songs.contains_key(id) {
-                self.songs.insert(
-                    *id,
-                    self.load_and_compile_song(*id, &item.source, pf_songs, dependencies, sender),
-                );
+                self.load_and_compile_song(*id, &item.source, pf_songs, dependencies, sender);
             }
         };
 
@@ -1122,10 +1268,7 @@ impl SongCompiler {
         match pf_songs.get(&id) {
             Some(pf_song) => {
                 // The song-tab may have been closed without saving it, reload the song file.
-                self.songs.insert(
-                    id,
-                    self.load_and_compile_song(id, &pf_song.source, pf_songs, dependencies, sender),
-                );
+                self.load_and_compile_song(id, &pf_song.source, pf_songs, dependencies, sender);
             }
             None => {
                 self.songs.remove(&id);
@@ -1144,7 +1287,7 @@ impl SongCompiler {
         for (id, s) in self.songs.iter_mut() {
             let song_name = pf_songs.get(id).map(|s| &s.name);
 
-            s.song_data = Self::compile_song(*id, song_name, &s.file, dependencies, sender);
+            s.compile(*id, song_name, dependencies, sender);
         }
 
         self.output_largest_song_size(sender);
@@ -1179,8 +1322,7 @@ impl SongCompiler {
             Entry::Occupied(mut o) => {
                 let state = o.get_mut();
                 state.file.contents = mml;
-                state.song_data =
-                    Self::compile_song(id, song_name, &state.file, dependencies, sender)
+                state.compile(id, song_name, dependencies, sender);
             }
             Entry::Vacant(v) => {
                 let file = TextFile {
@@ -1188,8 +1330,8 @@ impl SongCompiler {
                     file_name: "MML".to_owned(),
                     path: None,
                 };
-                let song_data = Self::compile_song(id, song_name, &file, dependencies, sender);
-                v.insert(SongState { file, song_data });
+                v.insert(SongState::new(file))
+                    .compile(id, song_name, dependencies, sender);
             }
         }
 
@@ -1252,12 +1394,77 @@ impl SongCompiler {
     }
 }
 
+/// Maximum number of sample analyses to keep in `SampleAnalysisCache`
+const SAMPLE_ANALYSIS_CACHE_SIZE: usize = 16;
+
+/// Caches the most recent sample analyses, so switching between samples in the sample analyser
+/// does not decode and analyse the sample again.
+///
+/// Must be invalidated whenever a sample is removed from `SampleFileCache`.
+#[derive(Default)]
+struct SampleAnalysisCache {
+    // Most recently used last
+    analyses: Vec<(
+        SourcePathBuf,
+        LoopSetting,
+        BrrEvaluator,
+        Arc<SampleAnalysis>,
+    )>,
+}
+
+impl SampleAnalysisCache {
+    fn get(
+        &mut self,
+        source: &SourcePathBuf,
+        loop_setting: &LoopSetting,
+        evaluator: BrrEvaluator,
+    ) -> Option<Arc<SampleAnalysis>> {
+        let i = self
+            .analyses
+            .iter()
+            .position(|(s, ls, e, _)| s == source && ls == loop_setting && *e == evaluator)?;
+
+        let a = self.analyses.remove(i);
+        let out = a.3.clone();
+        self.analyses.push(a);
+
+        Some(out)
+    }
+
+    fn insert(
+        &mut self,
+        source: SourcePathBuf,
+        loop_setting: LoopSetting,
+        evaluator: BrrEvaluator,
+        analysis: Arc<SampleAnalysis>,
+    ) {
+        if self.analyses.len() >= SAMPLE_ANALYSIS_CACHE_SIZE {
+            self.analyses.remove(0);
+        }
+        self.analyses
+            .push((source, loop_setting, evaluator, analysis));
+    }
+
+    fn clear(&mut self) {
+        self.analyses.clear();
+    }
+
+    fn remove_path(&mut self, source: &SourcePathBuf) {
+        self.analyses.retain(|(s, ..)| s != source);
+    }
+}
+
 fn analyse_sample(
     cache: &mut SampleFileCache,
+    analysis_cache: &mut SampleAnalysisCache,
     source: SourcePathBuf,
     loop_setting: LoopSetting,
     evaluator: BrrEvaluator,
-) -> Result<SampleAnalysis, BrrError> {
+) -> Result<Arc<SampleAnalysis>, BrrError> {
+    if let Some(a) = analysis_cache.get(&source, &loop_setting, evaluator) {
+        return Ok(a);
+    }
+
     let brr_sample = Arc::new(encode_or_load_brr_file(
         &source,
         cache,
@@ -1273,7 +1480,10 @@ fn analyse_sample(
         _ => None,
     };
 
-    Ok(sample_analyser::analyse_sample(brr_sample, wav_sample))
+    let analysis = Arc::new(sample_analyser::analyse_sample(brr_sample, wav_sample));
+    analysis_cache.insert(source, loop_setting, evaluator, analysis.clone());
+
+    Ok(analysis)
 }
 
 fn compile_all_samples(
@@ -1282,6 +1492,19 @@ fn compile_all_samples(
     sample_file_cache: &mut SampleFileCache,
     sender: &Sender,
 ) {
+    sample_file_cache.encode_wav_files_in_parallel(
+        instruments
+            .items()
+            .iter()
+            .map(|i| (&i.source, &i.loop_setting, i.evaluator))
+            .chain(
+                samples
+                    .items()
+                    .iter()
+                    .map(|s| (&s.source, &s.loop_setting, s.evaluator)),
+            ),
+    );
+
     let c = create_instrument_compiler(sample_file_cache, sender);
     instruments.recompile_all(c);
 
@@ -1320,6 +1543,7 @@ fn bg_thread(
     let mut songs = SongCompiler::new(parent_path.clone());
 
     let mut sample_file_cache = SampleFileCache::new(parent_path);
+    let mut sample_analysis_cache = SampleAnalysisCache::default();
 
     let mut song_dependencies = None;
     let mut cad_with_sfx_buffer: Option<Arc<CommonAudioDataWithSfxBuffer>> = None;
@@ -1370,6 +1594,7 @@ fn bg_thread(
 
             ToCompiler::ClearSampleCacheAndRebuild => {
                 sample_file_cache.clear_cache();
+                sample_analysis_cache.clear();
                 compile_all_samples(
                     &mut instruments,
                     &mut samples,
@@ -1398,10 +1623,20 @@ fn bg_thread(
             }
             ToCompiler::Instrument(m) => {
                 let name_changed = instruments.item_changes_name(&m);
+                let edited_id = match &m {
+                    ItemChanged::AddedOrEdited(id, _) => Some(*id),
+                    _ => None,
+                };
 
                 let c = create_instrument_compiler(&mut sample_file_cache, &sender);
                 instruments.process_message(m, c);
 
+                if let Some(id) = edited_id {
+                    if let Some(job) = note_cache_job(&instruments, id) {
+                        sender.send_audio(AudioMessage::CacheInstrumentNotes(id, Box::new(job)));
+                    }
+                }
+
                 if name_changed {
                     inst_sample_names = instrument_and_sample_names(&instruments, &samples);
                 }
@@ -1543,8 +1778,19 @@ fn bg_thread(
                 }
             }
             ToCompiler::PlayInstrument(id, args) => {
-                if let Some((c_data, s_data)) = build_play_instrument_data(&instruments, id, args) {
-                    sender.send_audio(AudioMessage::PlaySample(c_data, s_data.into()));
+                // The note cache is not populated when a project is loaded
+                if let Some(job) = note_cache_job(&instruments, id) {
+                    sender.send_audio(AudioMessage::CacheInstrumentNotes(id, Box::new(job)));
+                }
+                if let Some((c_data, s_data, note)) =
+                    build_play_instrument_data(&instruments, id, args)
+                {
+                    sender.send_audio(AudioMessage::PlayInstrumentNote(
+                        id,
+                        note,
+                        c_data,
+                        s_data.into(),
+                    ));
                 }
             }
             ToCompiler::PlaySample(id, args) => {
@@ -1560,11 +1806,17 @@ fn bg_thread(
 
             ToCompiler::RemoveFileFromSampleCache(source_path) => {
                 sample_file_cache.remove_path(&source_path);
+                sample_analysis_cache.remove_path(&source_path);
             }
 
             ToCompiler::AnalyseSample(source_path, loop_setting, evaluator) => {
-                let r =
-                    analyse_sample(&mut sample_file_cache, source_path, loop_setting, evaluator);
+                let r = analyse_sample(
+                    &mut sample_file_cache,
+                    &mut sample_analysis_cache,
+                    source_path,
+                    loop_setting,
+                    evaluator,
+                );
                 sender.send(CompilerOutput::SampleAnalysis(r));
             }
         }
@@ -1610,7 +1862,7 @@ fn bg_thread(
                 compile_sfx_subroutines(&song_dependencies, &sfx_subroutines_mml, &sender);
 
             let c = create_sfx_compiler(&song_dependencies, &sfx_subroutines, &sender);
-            sound_effects.recompile_all(c);
+            sound_effects.recompile_all_parallel(c);
 
             match build_common_data_with_sfx_buffer(
                 &song_dependencies,
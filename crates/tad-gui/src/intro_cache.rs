@@ -0,0 +1,191 @@
+//! Song intro pre-render cache
+//!
+//! Renders the first few seconds of recently compiled songs on a background thread, so the
+//! audio thread can start playing a song without booting the audio driver or emulating the
+//! audio that fills the ring buffer.
+//!
+//! An intro contains the emulator state before the first chunk and a snapshot of the emulator
+//! every `SNAPSHOT_INTERVAL` chunks (including the last chunk).  The audio thread hands over to
+//! its own emulator at the last snapshot (or emulates the chunks consumed after the previous
+//! snapshot if the intro is interrupted).
+
+// SPDX-FileCopyrightText: © 2024 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+use crate::compiler_thread::ItemId;
+use crate::speculative_renderer::SpeculativeChunk;
+
+use shvc_sound_emu::ShvcSoundEmu;
+
+use std::collections::VecDeque;
+use std::sync::{Arc, Condvar, Mutex, MutexGuard};
+use std::thread;
+
+/// Number of chunks in an intro
+pub const INTRO_CHUNKS: usize = 256;
+
+/// Every Nth chunk of an intro includes a snapshot of the emulator after the chunk was rendered.
+pub const SNAPSHOT_INTERVAL: usize = 16;
+
+/// Maximum number of intros in the cache
+const MAX_INTROS: usize = 12;
+
+/// `ShvcSoundEmu` is not `Sync`, intros are shared between threads behind a mutex.
+pub type SharedIntro<K, const CHUNK_SIZE: usize> = Arc<Mutex<Intro<K, CHUNK_SIZE>>>;
+
+pub struct Intro<K, const CHUNK_SIZE: usize> {
+    pub key: K,
+    /// The emulator before the first chunk was rendered
+    pub start: ShvcSoundEmu,
+    pub chunks: Vec<SpeculativeChunk<CHUNK_SIZE>>,
+}
+
+struct State<J, K, const CHUNK_SIZE: usize> {
+    /// At most one job per item, oldest first
+    jobs: VecDeque<(ItemId, J)>,
+    /// At most one intro per item, oldest first
+    intros: VecDeque<(ItemId, SharedIntro<K, CHUNK_SIZE>)>,
+    quit: bool,
+}
+
+struct Shared<J, K, const CHUNK_SIZE: usize> {
+    state: Mutex<State<J, K, CHUNK_SIZE>>,
+    /// Notified when a job is queued or `quit` is set
+    condvar: Condvar,
+}
+
+impl<J, K, const CHUNK_SIZE: usize> Shared<J, K, CHUNK_SIZE> {
+    fn lock(&self) -> MutexGuard<'_, State<J, K, CHUNK_SIZE>> {
+        // The render thread does not hold the lock while rendering,
+        // the state is valid even if the mutex is poisoned.
+        self.state.lock().unwrap_or_else(|e| e.into_inner())
+    }
+}
+
+/// Read access to the intros rendered by an `IntroRenderer`
+pub struct IntroCache<J, K, const CHUNK_SIZE: usize> {
+    shared: Arc<Shared<J, K, CHUNK_SIZE>>,
+}
+
+impl<J, K, const CHUNK_SIZE: usize> IntroCache<J, K, CHUNK_SIZE> {
+    /// Returns the intro whose key matches `f`
+    pub fn find(&self, f: impl Fn(&K) -> bool) -> Option<SharedIntro<K, CHUNK_SIZE>> {
+        self.shared
+            .lock()
+            .intros
+            .iter()
+            .find(|(_, intro)| f(&lock_intro(intro).key))
+            .map(|(_, intro)| intro.clone())
+    }
+}
+
+/// Locks a rendered intro
+pub fn lock_intro<K, const CHUNK_SIZE: usize>(
+    intro: &SharedIntro<K, CHUNK_SIZE>,
+) -> MutexGuard<'_, Intro<K, CHUNK_SIZE>> {
+    // An intro is not modified after it has been rendered
+    intro.lock().unwrap_or_else(|e| e.into_inner())
+}
+
+/// Renders intros on a background thread
+pub struct IntroRenderer<J, K, const CHUNK_SIZE: usize> {
+    shared: Arc<Shared<J, K, CHUNK_SIZE>>,
+    thread: Option<thread::JoinHandle<()>>,
+}
+
+impl<J, K, const CHUNK_SIZE: usize> IntroRenderer<J, K, CHUNK_SIZE>
+where
+    J: Send + 'static,
+    K: Send + 'static,
+{
+    /// Spawns the render thread.
+    ///
+    /// `render` is called on the render thread for every queued job.
+    pub fn new<F>(mut render: F) -> Self
+    where
+        F: FnMut(J) -> Option<Intro<K, CHUNK_SIZE>> + Send + 'static,
+    {
+        let shared = Arc::new(Shared {
+            state: Mutex::new(State {
+                jobs: VecDeque::new(),
+                intros: VecDeque::with_capacity(MAX_INTROS + 1),
+                quit: false,
+            }),
+            condvar: Condvar::new(),
+        });
+
+        let thread = thread::Builder::new()
+            .name("intro_renderer".into())
+            .spawn({
+                let shared = shared.clone();
+                move || render_thread(&shared, &mut render)
+            })
+            .unwrap();
+
+        Self {
+            shared,
+            thread: Some(thread),
+        }
+    }
+}
+
+impl<J, K, const CHUNK_SIZE: usize> IntroRenderer<J, K, CHUNK_SIZE> {
+    pub fn cache(&self) -> IntroCache<J, K, CHUNK_SIZE> {
+        IntroCache {
+            shared: self.shared.clone(),
+        }
+    }
+
+    /// Queues an intro to be rendered, replacing any unprocessed job for `id`
+    pub fn queue(&self, id: ItemId, job: J) {
+        let mut s = self.shared.lock();
+        s.jobs.retain(|(i, _)| *i != id);
+        s.jobs.push_back((id, job));
+        drop(s);
+
+        self.shared.condvar.notify_all();
+    }
+}
+
+impl<J, K, const CHUNK_SIZE: usize> Drop for IntroRenderer<J, K, CHUNK_SIZE> {
+    fn drop(&mut self) {
+        self.shared.lock().quit = true;
+        self.shared.condvar.notify_all();
+
+        if let Some(t) = self.thread.take() {
+            let _ = t.join();
+        }
+    }
+}
+
+fn render_thread<J, K, const CHUNK_SIZE: usize>(
+    shared: &Shared<J, K, CHUNK_SIZE>,
+    render: &mut impl FnMut(J) -> Option<Intro<K, CHUNK_SIZE>>,
+) {
+    let mut s = shared.lock();
+
+    loop {
+        let (id, job) = loop {
+            if s.quit {
+                return;
+            }
+            match s.jobs.pop_front() {
+                Some(j) => break j,
+                None => s = shared.condvar.wait(s).unwrap_or_else(|e| e.into_inner()),
+            }
+        };
+        drop(s);
+
+        let intro = render(job);
+
+        s = shared.lock();
+        if let Some(intro) = intro {
+            s.intros.retain(|(i, _)| *i != id);
+            s.intros.push_back((id, Arc::new(Mutex::new(intro))));
+            while s.intros.len() > MAX_INTROS {
+                s.intros.pop_front();
+            }
+        }
+    }
+}
@@ -15,18 +15,24 @@ mod files;
 mod help;
 mod helpers;
 mod instrument_editor;
+mod intro_cache;
 mod licenses_dialog;
 mod list_editor;
 mod menu;
 mod mml_editor;
 mod monitor_timer;
 mod names;
+mod note_cache;
 mod sample_analyser;
 mod sample_editor;
 mod sample_sizes_widget;
 mod sample_widgets;
+mod session_recorder;
 mod sfx_export_order;
 mod sfx_window;
+mod song_checkpoints;
+mod speculative_renderer;
+mod standby_loader;
 mod symbols;
 mod tables;
 mod tabs;
@@ -172,7 +178,7 @@ pub enum GuiMessage {
 
     OpenSongTab(usize),
 
-    SongChanged(ItemId, String),
+    SongEdited(ItemId),
     RecompileSong(ItemId, String),
 
     PlaySong(ItemId, String, TickCounter, MusicChannelsMask),
@@ -188,6 +194,9 @@ pub enum GuiMessage {
 
     AudioThreadStartedSong(ItemId, Arc<SongData>),
     AudioThreadResumedSong(ItemId),
+    AudioThreadAccessMap(Box<[u8; 0x10000]>),
+    AudioThreadEchoOverwrite(ItemId, u16),
+    AudioThreadSharedStateViewError(String),
     SongMonitorTimeout,
 
     ClearSampleCacheAndRebuild,
@@ -529,9 +538,8 @@ impl Project {
                 }
             }
 
-            GuiMessage::SongChanged(id, mml) => {
+            GuiMessage::SongEdited(id) => {
                 self.tab_manager.mark_unsaved(FileType::Song(id));
-                let _ = self.compiler_sender.send(ToCompiler::SongChanged(id, mml));
             }
             GuiMessage::RecompileSong(id, mml) => {
                 // RecompileSong should not mark the song as unsaved
@@ -606,6 +614,14 @@ impl Project {
                     self.audio_monitor_timer.start();
                 }
             }
+            GuiMessage::AudioThreadAccessMap(map) => {
+                self.samples_tab.set_access_map(map);
+            }
+            GuiMessage::AudioThreadEchoOverwrite(song_id, addr) => {
+                if let Some(tab) = self.song_tabs.get_mut(&song_id) {
+                    tab.echo_buffer_overwrite(addr);
+                }
+            }
             GuiMessage::SongMonitorTimeout => match self.audio_monitor.get() {
                 Some(mon) => match mon.song_id {
                     Some(id) => match self.song_tabs.get_mut(&id) {
@@ -801,6 +817,7 @@ impl Project {
             GuiMessage::OpenProject => (),
             GuiMessage::NewProject => (),
             GuiMessage::SelectedTabChanged => (),
+            GuiMessage::AudioThreadSharedStateViewError(_) => (),
         }
     }
 
@@ -850,6 +867,12 @@ impl Project {
                     .project_songs
                     .set_compiler_output(id, pf_co, &mut self.project_tab);
 
+                if let Ok(sd) = &co {
+                    let _ = self
+                        .audio_sender
+                        .send(AudioMessage::SongRecompiled(id, sd.clone()));
+                }
+
                 if let Some(song_tab) = self.song_tabs.get_mut(&id) {
                     self.tab_manager.set_tab_label_color(song_tab, co.is_ok());
                     song_tab.set_compiler_output(Some(co));
@@ -1095,7 +1118,8 @@ impl Project {
 
     // NOTE: Does not test if the song is unsaved before closing
     fn close_song_tab(&mut self, song_id: ItemId) {
-        if let Some(song_tab) = self.song_tabs.remove(&song_id) {
+        if let Some(mut song_tab) = self.song_tabs.remove(&song_id) {
+            song_tab.cancel_pending_compile();
             self.tab_manager.remove_tab(&song_tab);
             let _ = self
                 .compiler_sender
@@ -1139,6 +1163,10 @@ impl Project {
             },
             FileType::Song(id) => {
                 let id = *id;
+                if let Some(song_tab) = self.song_tabs.get_mut(&id) {
+                    // Do not wait for the user to stop typing
+                    song_tab.flush_pending_compile();
+                }
                 match self.song_tabs.get(&id) {
                     Some(song_tab) => match self
                         .tab_manager
@@ -1420,6 +1448,11 @@ impl MainWindow {
             GuiMessage::SelectedTabChanged => {
                 self.selected_tab_changed();
             }
+            GuiMessage::AudioThreadSharedStateViewError(msg) => {
+                self.menu.clear_shared_state_view();
+                dialog::message_title("Error");
+                dialog::alert_default(&msg);
+            }
             GuiMessage::ShowOrHideHelpSyntax => {
                 self.show_or_hide_help_syntax();
             }
@@ -39,6 +39,11 @@ const AUDIO_STOP: &str = "&Audio/&Stop Audio";
 const AUDIO_MONO: &str = "&Audio/&Mono";
 const AUDIO_STEREO: &str = "&Audio/&Stereo";
 
+const AUDIO_LOW_LATENCY: &str = "&Audio/&Low latency";
+const AUDIO_LIVE_SONG_PATCHING: &str = "&Audio/Live song &patching";
+const AUDIO_STANDBY_RELOAD: &str = "&Audio/Gap-free song &reload";
+const AUDIO_SHARED_STATE_VIEW: &str = "&Audio/Publish shared memory &view";
+
 const SHOW_HELP_SYNTAX: &str = "&Help/&Syntax";
 const SHOW_LICENSES: &str = "&Help/&Licencing Information";
 const SHOW_ABOUT_TAB: &str = "&Help/&About";
@@ -150,6 +155,62 @@ impl Menu {
             || AudioMessage::SetStereoFlag(StereoFlag::Stereo),
         );
 
+        menu_bar2.add(
+            AUDIO_LOW_LATENCY,
+            Shortcut::None,
+            fltk::menu::MenuFlag::Toggle,
+            {
+                let s = audio_sender.clone();
+                move |m: &mut fltk::menu::MenuBar| {
+                    if let Some(item) = m.find_item(AUDIO_LOW_LATENCY) {
+                        s.send(AudioMessage::SetLowLatency(item.value())).ok();
+                    }
+                }
+            },
+        );
+
+        menu_bar2.add(
+            AUDIO_LIVE_SONG_PATCHING,
+            Shortcut::None,
+            fltk::menu::MenuFlag::Toggle,
+            {
+                let s = audio_sender.clone();
+                move |m: &mut fltk::menu::MenuBar| {
+                    if let Some(item) = m.find_item(AUDIO_LIVE_SONG_PATCHING) {
+                        s.send(AudioMessage::SetLiveSongPatching(item.value())).ok();
+                    }
+                }
+            },
+        );
+
+        menu_bar2.add(
+            AUDIO_STANDBY_RELOAD,
+            Shortcut::None,
+            fltk::menu::MenuFlag::Toggle,
+            {
+                let s = audio_sender.clone();
+                move |m: &mut fltk::menu::MenuBar| {
+                    if let Some(item) = m.find_item(AUDIO_STANDBY_RELOAD) {
+                        s.send(AudioMessage::SetStandbyReload(item.value())).ok();
+                    }
+                }
+            },
+        );
+
+        menu_bar2.add(
+            AUDIO_SHARED_STATE_VIEW,
+            Shortcut::None,
+            fltk::menu::MenuFlag::Toggle,
+            {
+                let s = audio_sender.clone();
+                move |m: &mut fltk::menu::MenuBar| {
+                    if let Some(item) = m.find_item(AUDIO_SHARED_STATE_VIEW) {
+                        s.send(AudioMessage::SetSharedStateView(item.value())).ok();
+                    }
+                }
+            },
+        );
+
         add(
             SHOW_HELP_SYNTAX,
             Shortcut::from_key(Key::F1),
@@ -212,6 +273,12 @@ impl Menu {
         self.deactivate(AUDIO_SFX_WINDOW);
     }
 
+    pub fn clear_shared_state_view(&mut self) {
+        if let Some(mut m) = self.menu_bar.find_item(AUDIO_SHARED_STATE_VIEW) {
+            m.clear();
+        }
+    }
+
     pub fn is_help_syntax_checked(&self) -> bool {
         self.menu_bar
             .find_item(SHOW_HELP_SYNTAX)
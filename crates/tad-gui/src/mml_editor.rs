@@ -4,7 +4,7 @@
 //
 // SPDX-License-Identifier: MIT
 
-use crate::audio_thread::AudioMonitorData;
+use crate::audio_thread::{AudioMonitorData, AudioPerformance, Log2Histogram, PlaybackStats};
 use crate::helpers::ch_units_to_width;
 
 use compiler::driver_constants::N_MUSIC_CHANNELS;
@@ -100,6 +100,9 @@ pub struct MmlEditorState {
 
     prev_cursor_index: Option<u32>,
 
+    // Shown in the status bar while the song is playing
+    playback_stats: Option<PlaybackStats>,
+
     errors_in_style_buffer: bool,
 }
 
@@ -155,6 +158,8 @@ impl MmlEditor {
             prev_cursor_index: None,
             compiled_data: None,
 
+            playback_stats: None,
+
             changed_callback: Box::from(Self::blank_callback),
 
             errors_in_style_buffer: false,
@@ -413,19 +418,43 @@ impl MmlEditorState {
         let editor_buffer = &self.buffer.borrow();
         let text_buffer = &editor_buffer.text_buffer;
 
-        let to_style_start = pos;
-        let to_style_end = match text_buffer.find_char_forward(pos + n_inserted, '\n') {
+        let line_end = |i: i32| match text_buffer.find_char_forward(i, '\n') {
             Some(i) => i + 1,
             None => text_buffer.length(),
         };
 
-        let changed = Self::update_style_vec(
-            &mut self.style_vec,
-            to_style_start,
-            to_style_end,
-            text_buffer,
-            editor_buffer.format,
-        );
+        // Only the modified lines are restyled.
+        // The style at the end of a line is carried into the next line (ie, multi-line asm
+        // blocks), the following lines are only restyled until a line ends with the same style
+        // it had before the modification.
+        let to_style_start = pos;
+        let mut to_style_end = pos;
+        let mut next_line_end = line_end(pos + n_inserted);
+
+        while next_line_end > to_style_end {
+            let last = usize::try_from(next_line_end - 1).unwrap();
+            let old_line_end_style = self.style_vec[last];
+
+            Self::update_style_vec(
+                &mut self.style_vec,
+                to_style_end,
+                next_line_end,
+                text_buffer,
+                editor_buffer.format,
+            );
+            to_style_end = next_line_end;
+
+            if self.style_vec[last] == old_line_end_style {
+                break;
+            }
+            next_line_end = line_end(to_style_end);
+        }
+
+        let changed = std::str::from_utf8(
+            &self.style_vec
+                [usize::try_from(to_style_start).unwrap()..usize::try_from(to_style_end).unwrap()],
+        )
+        .unwrap();
 
         if self.playing_song_notes_valid {
             self.playing_song_notes_valid = false;
@@ -625,6 +654,10 @@ impl MmlEditorState {
     }
 
     fn clear_note_tracking(&mut self) {
+        if self.playback_stats.take().is_some() {
+            self.update_statusbar();
+        }
+
         if self.tracking_notes {
             self.tracking_notes = false;
             self.note_tracking_state = Default::default();
@@ -644,6 +677,11 @@ impl MmlEditorState {
     }
 
     fn update_note_tracking(&mut self, mon: AudioMonitorData) {
+        if self.playback_stats != Some(mon.playback) {
+            self.playback_stats = Some(mon.playback);
+            self.update_statusbar();
+        }
+
         if !self.playing_song_notes_valid {
             return;
         }
@@ -719,7 +757,7 @@ impl MmlEditorState {
         let (cursor_index, compiled_data) = match (cursor_index, &self.compiled_data) {
             (Some(ci), Some(sd)) => (ci, sd),
             _ => {
-                self.status_bar.set_label("");
+                self.set_statusbar_label(String::new());
                 return;
             }
         };
@@ -798,13 +836,75 @@ impl MmlEditorState {
                     let _ = write!(s, "  ZenLen: {}", c.state.zenlen.as_u8());
                 }
 
-                self.status_bar.set_label(&s);
+                self.set_statusbar_label(s);
             }
             None => {
-                self.status_bar.set_label("");
+                self.set_statusbar_label(String::new());
             }
         }
     }
+
+    fn set_statusbar_label(&mut self, mut s: String) {
+        if let Some(p) = &self.playback_stats {
+            if !s.is_empty() {
+                s.push_str("    ");
+            }
+            let _ = write!(s, "{} ms latency  {} underruns", p.latency_ms, p.underruns);
+
+            let perf = &p.performance;
+            if let Some(e) = perf.emulate.percentile(99) {
+                let _ = write!(s, "  emulate p99 <{} / {} µs", e, perf.chunk_duration);
+            }
+            self.status_bar.set_tooltip(&performance_tooltip(perf));
+        } else {
+            self.status_bar.set_tooltip("");
+        }
+
+        self.status_bar.set_label(&s);
+    }
+}
+
+/// Audio thread timing histograms, shown in the status bar tooltip while a song is playing
+fn performance_tooltip(perf: &AudioPerformance) -> String {
+    const BAR_WIDTH: u32 = 30;
+
+    let mut s = String::new();
+
+    let _ = writeln!(
+        s,
+        "Audio performance (last second, {} µs per chunk)",
+        perf.chunk_duration
+    );
+
+    for (name, h) in [
+        ("Chunk emulation time", &perf.emulate),
+        ("Buffered audio at SDL callback", &perf.fill_level),
+        ("SDL callback interval", &perf.callback_interval),
+    ] {
+        let _ = writeln!(s, "\n{name}:");
+
+        let count = h.count();
+        if count == 0 {
+            let _ = writeln!(s, "  (none)");
+            continue;
+        }
+
+        let first = h.buckets.iter().position(|b| *b != 0).unwrap_or(0);
+        let last = h.buckets.iter().rposition(|b| *b != 0).unwrap_or(0);
+
+        for (i, b) in h.buckets.iter().enumerate().take(last + 1).skip(first) {
+            let bar = (u64::from(*b) * u64::from(BAR_WIDTH)).div_ceil(u64::from(count));
+            let _ = writeln!(
+                s,
+                "  <{:>6} µs {:>5} {}",
+                Log2Histogram::bucket_end(i),
+                b,
+                "#".repeat(bar as usize)
+            );
+        }
+    }
+
+    s
 }
 
 pub struct NotePos {
@@ -0,0 +1,226 @@
+//! Instrument note pre-render cache
+//!
+//! Renders the attack of every note an instrument can play on a background thread after the
+//! instrument is edited, so the instrument editor's keyboard can play a note without booting the
+//! audio driver or emulating the audio that fills the ring buffer.
+//!
+//! The notes are played on a S-DSP voice (see `ShvcSoundEmu::start_dsp_audition()`).
+//! The audio thread plays the cached attack, then hands over to a copy of the emulator after
+//! the attack for the sustain and release.
+
+// SPDX-FileCopyrightText: © 2024 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+use crate::compiler_thread::ItemId;
+
+use brr::BrrSample;
+use shvc_sound_emu::{DspAuditionVoice, ShvcSoundEmu};
+
+use std::collections::VecDeque;
+use std::sync::{Arc, Condvar, Mutex, MutexGuard};
+use std::thread;
+
+/// Number of chunks in a note's attack
+pub const ATTACK_CHUNKS: usize = 12;
+
+/// Maximum number of instruments in the cache
+const MAX_INSTRUMENTS: usize = 4;
+
+/// The instrument data required to play a note on a S-DSP voice
+#[derive(Clone, PartialEq, Eq)]
+pub struct NoteCacheJob {
+    pub brr_sample: BrrSample,
+    pub adsr1: u8,
+    pub adsr2_or_gain: u8,
+    /// S-DSP pitch of every note the instrument can play (indexed by note id)
+    pub pitches: Vec<u16>,
+}
+
+impl NoteCacheJob {
+    /// Returns None if the instrument cannot play `note_id`
+    pub fn voice(&self, note_id: u8, adsr1: u8, adsr2_or_gain: u8) -> Option<DspAuditionVoice> {
+        let pitch = *self.pitches.get(usize::from(note_id))?;
+
+        Some(DspAuditionVoice {
+            pitch,
+            adsr1,
+            // The S-DSP ignores ADSR2 in GAIN mode and GAIN in ADSR mode
+            adsr2: adsr2_or_gain,
+            gain: adsr2_or_gain,
+            ..DspAuditionVoice::BRR_SAMPLE_RATE
+        })
+    }
+
+    pub fn default_voice(&self, note_id: u8) -> Option<DspAuditionVoice> {
+        self.voice(note_id, self.adsr1, self.adsr2_or_gain)
+    }
+}
+
+pub struct CachedNote<const CHUNK_SIZE: usize> {
+    pub attack: Vec<Box<[i16; CHUNK_SIZE]>>,
+    /// The emulator after the attack was rendered
+    pub after_attack: ShvcSoundEmu,
+}
+
+pub struct CachedInstrument<const CHUNK_SIZE: usize> {
+    pub job: Arc<NoteCacheJob>,
+    /// Indexed by note id.
+    /// `ShvcSoundEmu` is not `Sync`, the notes are shared between threads behind a mutex.
+    notes: Mutex<Vec<CachedNote<CHUNK_SIZE>>>,
+}
+
+impl<const CHUNK_SIZE: usize> CachedInstrument<CHUNK_SIZE> {
+    /// Returns a copy of the note's attack and the emulator after the attack
+    pub fn note(&self, note_id: u8) -> Option<(Vec<Box<[i16; CHUNK_SIZE]>>, ShvcSoundEmu)> {
+        // The notes are not modified after they have been rendered
+        let notes = self.notes.lock().unwrap_or_else(|e| e.into_inner());
+
+        notes
+            .get(usize::from(note_id))
+            .map(|n| (n.attack.clone(), n.after_attack.clone()))
+    }
+}
+
+struct State<const CHUNK_SIZE: usize> {
+    /// At most one job per item, oldest first
+    jobs: VecDeque<(ItemId, Arc<NoteCacheJob>)>,
+    /// At most one instrument per item, oldest first
+    instruments: VecDeque<(ItemId, Arc<CachedInstrument<CHUNK_SIZE>>)>,
+    quit: bool,
+}
+
+struct Shared<const CHUNK_SIZE: usize> {
+    state: Mutex<State<CHUNK_SIZE>>,
+    /// Notified when a job is queued or `quit` is set
+    condvar: Condvar,
+}
+
+impl<const CHUNK_SIZE: usize> Shared<CHUNK_SIZE> {
+    fn lock(&self) -> MutexGuard<'_, State<CHUNK_SIZE>> {
+        // The render thread does not hold the lock while rendering,
+        // the state is valid even if the mutex is poisoned.
+        self.state.lock().unwrap_or_else(|e| e.into_inner())
+    }
+}
+
+/// Renders instrument notes on a background thread
+pub struct NoteCache<const CHUNK_SIZE: usize> {
+    shared: Arc<Shared<CHUNK_SIZE>>,
+    thread: Option<thread::JoinHandle<()>>,
+}
+
+impl<const CHUNK_SIZE: usize> NoteCache<CHUNK_SIZE> {
+    /// Spawns the render thread.
+    ///
+    /// `render` is called on the render thread for every queued job.
+    pub fn new<F>(mut render: F) -> Self
+    where
+        F: FnMut(&NoteCacheJob) -> Vec<CachedNote<CHUNK_SIZE>> + Send + 'static,
+    {
+        let shared = Arc::new(Shared {
+            state: Mutex::new(State {
+                jobs: VecDeque::new(),
+                instruments: VecDeque::with_capacity(MAX_INSTRUMENTS + 1),
+                quit: false,
+            }),
+            condvar: Condvar::new(),
+        });
+
+        let thread = thread::Builder::new()
+            .name("note_cache".into())
+            .spawn({
+                let shared = shared.clone();
+                move || render_thread(&shared, &mut render)
+            })
+            .unwrap();
+
+        Self {
+            shared,
+            thread: Some(thread),
+        }
+    }
+
+    /// Queues an instrument to be rendered, replacing any unprocessed job for `id`.
+    ///
+    /// Does nothing if `job` has already been rendered or queued.
+    pub fn queue(&self, id: ItemId, job: NoteCacheJob) {
+        let mut s = self.shared.lock();
+
+        let rendered = s.instruments.iter().any(|(i, c)| *i == id && *c.job == job);
+        let queued = s.jobs.iter().any(|(i, j)| *i == id && **j == job);
+        if rendered || queued {
+            return;
+        }
+
+        // Do not play an outdated instrument while the job is rendered
+        s.instruments.retain(|(i, _)| *i != id);
+
+        s.jobs.retain(|(i, _)| *i != id);
+        s.jobs.push_back((id, Arc::new(job)));
+        drop(s);
+
+        self.shared.condvar.notify_all();
+    }
+
+    pub fn find(&self, id: ItemId) -> Option<Arc<CachedInstrument<CHUNK_SIZE>>> {
+        self.shared
+            .lock()
+            .instruments
+            .iter()
+            .find(|(i, _)| *i == id)
+            .map(|(_, c)| c.clone())
+    }
+}
+
+impl<const CHUNK_SIZE: usize> Drop for NoteCache<CHUNK_SIZE> {
+    fn drop(&mut self) {
+        self.shared.lock().quit = true;
+        self.shared.condvar.notify_all();
+
+        if let Some(t) = self.thread.take() {
+            let _ = t.join();
+        }
+    }
+}
+
+fn render_thread<const CHUNK_SIZE: usize>(
+    shared: &Shared<CHUNK_SIZE>,
+    render: &mut impl FnMut(&NoteCacheJob) -> Vec<CachedNote<CHUNK_SIZE>>,
+) {
+    let mut s = shared.lock();
+
+    loop {
+        let (id, job) = loop {
+            if s.quit {
+                return;
+            }
+            match s.jobs.pop_front() {
+                Some(j) => break j,
+                None => s = shared.condvar.wait(s).unwrap_or_else(|e| e.into_inner()),
+            }
+        };
+        drop(s);
+
+        let notes = render(&job);
+
+        s = shared.lock();
+
+        // Discard the notes if the instrument was edited while they were rendered
+        if s.jobs.iter().any(|(i, _)| *i == id) {
+            continue;
+        }
+
+        s.instruments.retain(|(i, _)| *i != id);
+        s.instruments.push_back((
+            id,
+            Arc::new(CachedInstrument {
+                job,
+                notes: Mutex::new(notes),
+            }),
+        ));
+        while s.instruments.len() > MAX_INSTRUMENTS {
+            s.instruments.pop_front();
+        }
+    }
+}
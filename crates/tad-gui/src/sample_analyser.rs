@@ -103,7 +103,7 @@ struct State {
     loop_setting: data::LoopSetting,
     evaluator: data::BrrEvaluator,
 
-    analysis: Option<SampleAnalysis>,
+    analysis: Option<Arc<SampleAnalysis>>,
     analysis_error: Option<String>,
 
     spectrum_max_freq: f64,
@@ -396,7 +396,7 @@ impl SampleAnalyserDialog {
         );
     }
 
-    pub fn analysis_from_compiler_thread(&mut self, r: Result<SampleAnalysis, BrrError>) {
+    pub fn analysis_from_compiler_thread(&mut self, r: Result<Arc<SampleAnalysis>, BrrError>) {
         self.state.borrow_mut().analysis_from_compiler_thread(r)
     }
 
@@ -523,7 +523,7 @@ impl State {
         ));
     }
 
-    fn analysis_from_compiler_thread(&mut self, r: Result<SampleAnalysis, BrrError>) {
+    fn analysis_from_compiler_thread(&mut self, r: Result<Arc<SampleAnalysis>, BrrError>) {
         match r {
             Ok(a) => {
                 match &a.spectrum {
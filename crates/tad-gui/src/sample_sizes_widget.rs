@@ -14,6 +14,7 @@ use compiler::data::{Instrument, Name, Sample};
 use compiler::driver_constants::{addresses, COMMON_DATA_HEADER_SIZE};
 use compiler::songs::{SongAramSize, BLANK_SONG_ARAM_SIZE};
 use fltk::table::TableContext;
+use shvc_sound_emu::ShvcSoundEmu;
 
 use std::cell::RefCell;
 use std::ops::Range;
@@ -37,6 +38,9 @@ pub struct SampleSizesWidget {
     graph_data: Option<GraphData>,
     largest_song: SongAramSize,
 
+    /// Audio-RAM accessed by the last song played (`ShvcSoundEmu::access_map()`)
+    access_map: Option<Box<[u8; 0x10000]>>,
+
     stat_sizes: [String; N_STAT_ROWS],
     brr_sizes: Vec<String>,
     brr_sample_names: Arc<Vec<Name>>,
@@ -56,6 +60,12 @@ const BRR_SAMPLES_LINE_COLOR: Color = Color::DarkYellow;
 const LARGEST_SONG_COLOR: Color = Color::Red;
 const LARGEST_SONG_ECHO_COLOR: Color = Color::Red;
 
+const ACCESS_READ_COLOR: Color = Color::DarkGreen;
+const ACCESS_WRITE_COLOR: Color = Color::DarkRed;
+const ACCESS_EXECUTE_COLOR: Color = Color::DarkBlue;
+
+const ACCESS_MAP_TOOLTIP: &str = "The bar below the memory map shows the Audio-RAM accessed by the last song played\n(blue: executed, red: written, green: read)";
+
 const AUDIO_DRIVER_SIZE: u16 = addresses::COMMON_DATA;
 const CAD_HEADER_END: u16 = addresses::COMMON_DATA + COMMON_DATA_HEADER_SIZE as u16;
 
@@ -144,6 +154,7 @@ impl SampleSizesWidget {
             table,
             graph_data: None,
             largest_song: BLANK_SONG_ARAM_SIZE,
+            access_map: None,
 
             stat_sizes: Default::default(),
             brr_sample_names: Arc::default(),
@@ -199,6 +210,13 @@ impl SampleSizesWidget {
         }
     }
 
+    pub fn set_access_map(&mut self, map: Box<[u8; 0x10000]>) {
+        self.access_map = Some(map);
+
+        self.graph_widget.set_tooltip(ACCESS_MAP_TOOLTIP);
+        self.graph_widget.redraw();
+    }
+
     pub fn cad_changed(&mut self, cad: &CadOutput) {
         match cad {
             CadOutput::None | CadOutput::Err(_) => {
@@ -410,9 +428,41 @@ impl SampleSizesWidget {
             }
         }
 
+        if let Some(map) = &self.access_map {
+            Self::draw_access_map(map, x, y + h - h / 4, w, h / 4);
+        }
+
         draw::draw_box(FrameType::ThinDownFrame, x, y, w, h, Color::FrameDefault);
     }
 
+    /// Draws a bar with one line per pixel column, coloured by the most significant access to the
+    /// column's Audio-RAM (execute, then write, then read)
+    fn draw_access_map(map: &[u8; 0x10000], x: i32, y: i32, w: i32, h: i32) {
+        draw::draw_rect_fill(x, y, w, h, Color::Background);
+
+        for col in 0..w {
+            let start = (col * 0x10000 / w) as usize;
+            let end = (((col + 1) * 0x10000 / w) as usize).max(start + 1);
+
+            let access = map[start..end].iter().fold(0, |acc, a| acc | a);
+
+            let color = if access & ShvcSoundEmu::WATCH_EXECUTE != 0 {
+                ACCESS_EXECUTE_COLOR
+            } else if access & ShvcSoundEmu::WATCH_WRITE != 0 {
+                ACCESS_WRITE_COLOR
+            } else if access & ShvcSoundEmu::WATCH_READ != 0 {
+                ACCESS_READ_COLOR
+            } else {
+                continue;
+            };
+            draw::set_draw_color(color);
+            draw::draw_yxline(x + col, y, y + h - 1);
+        }
+
+        draw::set_draw_color(Color::Foreground);
+        draw::draw_xyline(x, y, x + w - 1);
+    }
+
     #[allow(clippy::too_many_arguments)]
     fn draw_table_cell(
         &self,
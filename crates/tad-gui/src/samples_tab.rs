@@ -19,6 +19,7 @@ use crate::{helpers::*, InstrumentsAndSamplesData};
 use crate::instrument_editor::{InstrumentEditor, InstrumentMapping, TestInstrumentWidget};
 use crate::sample_editor::{SampleEditor, SampleMapping, TestSampleWidget};
 
+use compiler::audible_end::{AudibleEnd, DEFAULT_AUDIBLE_THRESHOLD_DB};
 use compiler::data::{self, Instrument};
 use compiler::songs::SongAramSize;
 use fltk::button::Button;
@@ -33,6 +34,18 @@ use fltk::group::{Flex, Wizard};
 use fltk::prelude::*;
 use fltk::text::{TextBuffer, TextDisplay, WrapMode};
 
+fn brr_size_text(size: usize, audible_end: &Option<AudibleEnd>) -> String {
+    match audible_end {
+        Some(a) if a.bytes_saved() > 0 => format!(
+            "BRR Sample size: {size} bytes\nAudible end: {} of {} BRR blocks ({} bytes could be trimmed at {DEFAULT_AUDIBLE_THRESHOLD_DB}dB)",
+            a.audible_blocks,
+            a.n_blocks,
+            a.bytes_saved()
+        ),
+        _ => format!("BRR Sample size: {size} bytes"),
+    }
+}
+
 #[derive(PartialEq)]
 enum SelectedEditor {
     CombinedSamplesResult,
@@ -244,6 +257,10 @@ impl SamplesTab {
         self.sample_sizes_widget.borrow_mut().set_largest_song(s);
     }
 
+    pub fn set_access_map(&mut self, map: Box<[u8; 0x10000]>) {
+        self.sample_sizes_widget.borrow_mut().set_access_map(map);
+    }
+
     pub fn show_sample_sizes_widget(&mut self) {
         self.inst_table.clear_selected_row();
         self.sample_table.clear_selected_row();
@@ -290,8 +307,7 @@ impl SamplesTab {
                 self.console_buffer.set_text("");
             }
             Some(Ok(o)) => {
-                self.console_buffer
-                    .set_text(&format!("BRR Sample size: {} bytes", o.0));
+                self.console_buffer.set_text(&brr_size_text(o.0, &o.1));
                 self.console.set_text_color(Color::Foreground);
             }
             Some(Err(errors)) => {
@@ -321,8 +337,7 @@ impl SamplesTab {
                 self.console_buffer.set_text("");
             }
             Some(Ok(o)) => {
-                self.console_buffer
-                    .set_text(&format!("BRR Sample size: {} bytes", o.0));
+                self.console_buffer.set_text(&brr_size_text(o.0, &o.1));
                 self.console.set_text_color(Color::Foreground);
             }
             Some(Err(errors)) => {
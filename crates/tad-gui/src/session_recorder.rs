@@ -0,0 +1,187 @@
+//! Session recorder
+//!
+//! Records the audio thread's emulator inputs as a `scenario_runner` scenario
+//! (`crates/shvc-sound-emu/examples/scenario_runner.cpp`), so a GUI session can be replayed
+//! deterministically at full speed with any emulator core and instrumentation.
+//!
+//! The recording is the initial emulator state, every IO port write and channel mask change
+//! (at the S-SMP clock it was applied on) and a save state for every other change to the emulator
+//! (song loads, seeks, sound effect and song patch Audio-RAM writes, intro and speculative
+//! renderer snapshots).
+//!
+//! Changes are detected by comparing the emulator's state hash with the hash after the last
+//! recorded input, every change that is not recorded as an input is recorded as a reload.
+//! The hashes are also written to the scenario, so the replay fails if it diverges.
+
+// SPDX-FileCopyrightText: © 2025 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+use shvc_sound_emu::ShvcSoundEmu;
+
+use std::fs::{self, File};
+use std::io::Write;
+use std::path::PathBuf;
+use std::time::{SystemTime, UNIX_EPOCH};
+
+/// Environment variable containing the directory the audio thread records its sessions to
+/// (each session is written to a new `session-<unix time>` subdirectory).
+pub const SESSION_RECORDING_DIR_ENV_VAR: &str = "TAD_SESSION_RECORDING_DIR";
+
+const SCENARIO_FILE_NAME: &str = "session.scenario";
+const INITIAL_STATE_FILE_NAME: &str = "initial.state";
+
+/// An emulator input recorded by `SessionRecorder::after_change()`
+pub enum SessionInput<'a> {
+    IoPorts([u8; 4]),
+    Apuram(u16, &'a [u8]),
+}
+
+/// The emulator state after the last recorded input or emulated chunk
+#[derive(Clone, Copy, PartialEq)]
+struct RecordedState {
+    smp_clock: u64,
+    hash: u64,
+}
+
+pub struct SessionRecorder {
+    dir: PathBuf,
+    scenario: File,
+
+    n_reloads: u32,
+
+    /// None until the initial state is written
+    last: Option<RecordedState>,
+
+    /// S-SMP clock of the most recently written state (the scenario clocks are relative to it)
+    base_clock: u64,
+    /// The clock of the last `run-until` command (relative to `base_clock`)
+    run_until: u64,
+}
+
+impl SessionRecorder {
+    /// Starts a recording if the `TAD_SESSION_RECORDING_DIR` environment variable is set.
+    pub fn from_env() -> Option<Self> {
+        let parent = std::env::var_os(SESSION_RECORDING_DIR_ENV_VAR).filter(|d| !d.is_empty())?;
+
+        let secs = SystemTime::now()
+            .duration_since(UNIX_EPOCH)
+            .map(|d| d.as_secs())
+            .unwrap_or(0);
+        let dir = PathBuf::from(parent).join(format!("session-{secs}"));
+
+        let scenario =
+            fs::create_dir_all(&dir).and_then(|()| File::create(dir.join(SCENARIO_FILE_NAME)));
+
+        match scenario {
+            Ok(scenario) => Some(Self {
+                dir,
+                scenario,
+                n_reloads: 0,
+                last: None,
+                base_clock: 0,
+                run_until: 0,
+            }),
+            Err(e) => {
+                eprintln!("Cannot record audio session to {}: {}", dir.display(), e);
+                None
+            }
+        }
+    }
+
+    // Errors are ignored, the recording is a debugging aid
+    fn line(&mut self, line: std::fmt::Arguments) {
+        let _ = self.scenario.write_fmt(line);
+        let _ = self.scenario.write_all(b"\n");
+    }
+
+    fn write_state(&mut self, file_name: &str, emu: &ShvcSoundEmu) {
+        let _ = fs::write(self.dir.join(file_name), emu.save_state());
+    }
+
+    fn run_until(&mut self, smp_clock: u64) {
+        let clock = smp_clock - self.base_clock;
+        if clock > self.run_until {
+            self.line(format_args!("run-until {clock}"));
+            self.run_until = clock;
+        }
+    }
+
+    fn check_hash(&mut self, state: RecordedState) {
+        self.run_until(state.smp_clock);
+        self.line(format_args!("check-hash {:#018x}", state.hash));
+    }
+
+    fn current_state(emu: &mut ShvcSoundEmu) -> RecordedState {
+        // `counters()` also synchronizes the S-DSP, which is emulated lazily
+        let smp_clock = emu.counters().smp_clocks;
+
+        RecordedState {
+            smp_clock,
+            hash: emu.state_hash(),
+        }
+    }
+
+    /// Must be called before the emulator is emulated or changed by a recorded input.
+    ///
+    /// Records a save state if the emulator was changed outside of `before_change()` and
+    /// `after_change()`.
+    pub fn before_change(&mut self, emu: &mut ShvcSoundEmu) {
+        let state = Self::current_state(emu);
+
+        match self.last {
+            Some(last) if last == state => (),
+            Some(last) => {
+                self.check_hash(last);
+
+                self.n_reloads += 1;
+                let file_name = format!("reload-{:04}.state", self.n_reloads);
+                self.write_state(&file_name, emu);
+                self.line(format_args!("load-state {file_name}"));
+
+                self.base_clock = state.smp_clock;
+                self.run_until = 0;
+            }
+            None => {
+                self.write_state(INITIAL_STATE_FILE_NAME, emu);
+                self.line(format_args!(
+                    "# replay with: scenario_runner {INITIAL_STATE_FILE_NAME} {SCENARIO_FILE_NAME}"
+                ));
+                self.base_clock = state.smp_clock;
+            }
+        }
+
+        self.last = Some(state);
+    }
+
+    /// Records the inputs applied (and the audio emulated) since `before_change()`
+    pub fn after_change(&mut self, emu: &mut ShvcSoundEmu, inputs: &[SessionInput]) {
+        let state = Self::current_state(emu);
+
+        if !inputs.is_empty() {
+            self.run_until(state.smp_clock);
+        }
+        for i in inputs {
+            match i {
+                SessionInput::IoPorts(p) => self.line(format_args!(
+                    "ports {:#04x} {:#04x} {:#04x} {:#04x}",
+                    p[0], p[1], p[2], p[3]
+                )),
+                SessionInput::Apuram(addr, data) => {
+                    let bytes: Vec<String> = data.iter().map(|b| format!("{b:#04x}")).collect();
+                    self.line(format_args!("apuram {addr:#06x} {}", bytes.join(" ")));
+                }
+            }
+        }
+
+        self.last = Some(state);
+    }
+}
+
+impl Drop for SessionRecorder {
+    fn drop(&mut self) {
+        if let Some(last) = self.last {
+            self.check_hash(last);
+        }
+    }
+}
@@ -0,0 +1,242 @@
+//! Song checkpoints
+//!
+//! Emulator save states recorded at regular tick intervals the first time a song is played,
+//! used to seek into the song without replaying it from the start.
+
+// SPDX-FileCopyrightText: © 2024 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+use shvc_sound_emu::{ApuramPages, ShvcSoundEmu};
+
+use std::ops::Range;
+use std::sync::Arc;
+
+/// Number of song ticks between checkpoints
+pub const CHECKPOINT_INTERVAL: u16 = 256;
+
+/// Every Nth checkpoint is a keyframe that stores the bytes that differ from the first checkpoint,
+/// the others only store the bytes that changed since the previous checkpoint.
+///
+/// Most of the save state is Audio-RAM that does not change while a song is playing, a keyframe
+/// is usually the driver variables, the song's bytecode state and the echo buffer.
+const KEYFRAME_INTERVAL: usize = 16;
+
+/// Maximum amount of memory used by the checkpoints of a single song
+const MAX_CHECKPOINT_BYTES: usize = 32 * 1024 * 1024;
+
+/// Bytes that changed since the previous checkpoint.
+struct Delta {
+    /// Ranges of the save state that changed
+    ranges: Vec<Range<usize>>,
+    /// The new values of `ranges`, concatenated
+    data: Vec<u8>,
+}
+
+impl Delta {
+    /// Byte runs separated by fewer unchanged bytes than this are merged into a single range
+    const MERGE_GAP: usize = 8;
+
+    /// Compares the save states, skipping the Audio-RAM pages that are not in `dirty_pages`.
+    fn new(previous: &[u8], state: &[u8], dirty_pages: &ApuramPages) -> Self {
+        const APURAM: Range<usize> = Range {
+            start: ShvcSoundEmu::STATE_APURAM_OFFSET,
+            end: ShvcSoundEmu::STATE_APURAM_OFFSET + 0x10000,
+        };
+
+        assert_eq!(previous.len(), state.len());
+        assert!(state.len() >= APURAM.end);
+
+        let mut ranges: Vec<Range<usize>> = Vec::new();
+
+        let dirty_apuram = (0..=u8::MAX)
+            .filter(|&p| dirty_pages.contains(p))
+            .map(|p| APURAM.start + usize::from(p) * 0x100)
+            .map(|s| s..s + 0x100);
+
+        let segments = std::iter::once(0..APURAM.start)
+            .chain(dirty_apuram)
+            .chain(std::iter::once(APURAM.end..state.len()));
+
+        for segment in segments {
+            let mut i = segment.start;
+            while i < segment.end {
+                if state[i] == previous[i] {
+                    i += 1;
+                    continue;
+                }
+
+                let start = i;
+                let mut end = i + 1;
+                i += 1;
+                while i < segment.end && i < end + Self::MERGE_GAP {
+                    if state[i] != previous[i] {
+                        end = i + 1;
+                    }
+                    i += 1;
+                }
+
+                ranges.push(start..end);
+            }
+        }
+
+        let data = ranges
+            .iter()
+            .flat_map(|r| &state[r.clone()])
+            .copied()
+            .collect();
+
+        Self { ranges, data }
+    }
+
+    fn apply(&self, state: &mut [u8]) {
+        let mut data = self.data.as_slice();
+
+        for r in &self.ranges {
+            let (d, remaining) = data.split_at(r.len());
+            state[r.clone()].copy_from_slice(d);
+            data = remaining;
+        }
+    }
+
+    fn memory_used(&self) -> usize {
+        self.data.len() + self.ranges.len() * std::mem::size_of::<Range<usize>>()
+    }
+}
+
+enum CheckpointData {
+    /// The entire save state (only used by the first checkpoint)
+    Base(Vec<u8>),
+    /// The bytes that differ from the first checkpoint
+    Keyframe(Delta),
+    /// The bytes that changed since the previous checkpoint
+    Delta(Delta),
+}
+
+impl CheckpointData {
+    fn memory_used(&self) -> usize {
+        match self {
+            Self::Base(s) => s.len(),
+            Self::Keyframe(d) | Self::Delta(d) => d.memory_used(),
+        }
+    }
+}
+
+#[derive(Clone)]
+struct Checkpoint {
+    /// The audio driver's song tick counter when the save state was taken
+    tick: u16,
+    /// Shared between clones, a checkpoint is never modified after it is recorded
+    data: Arc<CheckpointData>,
+}
+
+/// The checkpoints of a song.
+///
+/// The save states are shared, cloning a `SongCheckpoints` does not copy the checkpoint data
+/// (the audio thread clones the checkpoints when it queues a standby job).
+#[derive(Clone)]
+pub struct SongCheckpoints {
+    checkpoints: Vec<Checkpoint>,
+
+    /// The save state of the last checkpoint (used to build the next delta)
+    last_state: Arc<Vec<u8>>,
+
+    memory_used: usize,
+}
+
+impl SongCheckpoints {
+    pub fn new() -> Self {
+        Self {
+            checkpoints: Vec::new(),
+            last_state: Arc::new(Vec::new()),
+            memory_used: 0,
+        }
+    }
+
+    /// The song tick to record the next checkpoint at.
+    ///
+    /// Returns None if no more checkpoints can be recorded.
+    pub fn next_tick(&self) -> Option<u16> {
+        if self.memory_used >= MAX_CHECKPOINT_BYTES {
+            return None;
+        }
+        match self.checkpoints.last() {
+            Some(c) => c.tick.checked_add(CHECKPOINT_INTERVAL),
+            None => Some(0),
+        }
+    }
+
+    /// The song tick of the last checkpoint
+    pub fn last_tick(&self) -> Option<u16> {
+        self.checkpoints.last().map(|c| c.tick)
+    }
+
+    /// Records a checkpoint.
+    ///
+    /// `tick` MUST be >= `next_tick()`.
+    /// `state` MUST be the same size as the previous checkpoint's `state`.
+    /// `dirty_pages` MUST contain every Audio-RAM page written since the previous checkpoint.
+    pub fn push(&mut self, tick: u16, state: Vec<u8>, dirty_pages: &ApuramPages) {
+        debug_assert!(matches!(self.next_tick(), Some(t) if tick >= t));
+
+        let data = match self.base() {
+            None => CheckpointData::Base(state.clone()),
+            Some(base) if self.checkpoints.len() % KEYFRAME_INTERVAL == 0 => {
+                CheckpointData::Keyframe(Delta::new(base, &state, &ApuramPages::ALL))
+            }
+            Some(_) => CheckpointData::Delta(Delta::new(&self.last_state, &state, dirty_pages)),
+        };
+        self.memory_used += data.memory_used();
+
+        self.checkpoints.push(Checkpoint {
+            tick,
+            data: Arc::new(data),
+        });
+        self.last_state = Arc::new(state);
+    }
+
+    /// Removes the checkpoints at or after song tick `tick`.
+    pub fn truncate(&mut self, tick: u32) {
+        let n = self
+            .checkpoints
+            .partition_point(|c| u32::from(c.tick) < tick);
+        if n == self.checkpoints.len() {
+            return;
+        }
+
+        self.checkpoints.truncate(n);
+        self.memory_used = self.checkpoints.iter().map(|c| c.data.memory_used()).sum();
+        self.last_state = Arc::new(
+            self.last_tick()
+                .and_then(|t| self.nearest(t))
+                .map(|(_, s)| s)
+                .unwrap_or_default(),
+        );
+    }
+
+    /// The save state of the first checkpoint
+    fn base(&self) -> Option<&[u8]> {
+        match self.checkpoints.first()?.data.as_ref() {
+            CheckpointData::Base(s) => Some(s),
+            CheckpointData::Keyframe(_) | CheckpointData::Delta(_) => None,
+        }
+    }
+
+    /// Returns the song tick and the save state of the last checkpoint at or before `tick`.
+    pub fn nearest(&self, tick: u16) -> Option<(u16, Vec<u8>)> {
+        let index = self.checkpoints.partition_point(|c| c.tick <= tick);
+        let index = index.checked_sub(1)?;
+
+        let keyframe = index - index % KEYFRAME_INTERVAL;
+
+        let mut state = self.base()?.to_vec();
+        for c in &self.checkpoints[keyframe..=index] {
+            match c.data.as_ref() {
+                CheckpointData::Base(_) => (),
+                CheckpointData::Keyframe(d) | CheckpointData::Delta(d) => d.apply(&mut state),
+            }
+        }
+
+        Some((self.checkpoints[index].tick, state))
+    }
+}
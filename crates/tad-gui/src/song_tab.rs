@@ -34,6 +34,11 @@ use std::sync::Arc;
 
 const MAX_START_TICKS: u32 = 2_000_000;
 
+/// Delay (in seconds) between the last edit and compiling the song.
+///
+/// Compiling a large song on every keystroke makes typing laggy.
+const COMPILE_DELAY: f64 = 0.4;
+
 pub fn blank_mml_file() -> TextFile {
     TextFile {
         path: None,
@@ -64,6 +69,8 @@ pub struct State {
     console_buffer: TextBuffer,
 
     errors: Option<MmlCompileErrors>,
+
+    compile_timeout: Option<app::TimeoutHandle>,
 }
 
 pub struct SongTab {
@@ -219,6 +226,7 @@ impl SongTab {
             console,
             console_buffer,
             errors: None,
+            compile_timeout: None,
         }));
 
         group.set_trigger(CallbackTrigger::Closed);
@@ -389,9 +397,9 @@ impl SongTab {
 
             s.editor.set_changed_callback({
                 let s = state.clone();
-                move |buffer| {
-                    if let Ok(s) = s.try_borrow() {
-                        s.song_changed(buffer.text());
+                move |_buffer| {
+                    if let Ok(mut state) = s.try_borrow_mut() {
+                        state.song_edited(&s);
                     }
                 }
             });
@@ -478,6 +486,19 @@ impl SongTab {
         self.state.borrow().editor.text()
     }
 
+    /// Immediately compiles the song if it was edited and has not been compiled yet
+    pub fn flush_pending_compile(&mut self) {
+        if let Ok(mut s) = self.state.try_borrow_mut() {
+            s.flush_pending_compile();
+        }
+    }
+
+    pub fn cancel_pending_compile(&mut self) {
+        if let Ok(mut s) = self.state.try_borrow_mut() {
+            s.cancel_pending_compile();
+        }
+    }
+
     pub fn set_compiler_output(&mut self, co: Option<SongOutput>) {
         if let Ok(mut s) = self.state.try_borrow_mut() {
             s.set_compiler_output(co);
@@ -505,6 +526,12 @@ impl SongTab {
             .audio_thread_started_song(song_data);
     }
 
+    pub fn echo_buffer_overwrite(&mut self, addr: u16) {
+        if let Ok(mut s) = self.state.try_borrow_mut() {
+            s.echo_buffer_overwrite(addr);
+        }
+    }
+
     pub fn monitor_timer_elapsed(&mut self, mon: AudioMonitorData) {
         self.state.borrow_mut().editor.update_note_tracking(mon);
     }
@@ -515,9 +542,37 @@ impl SongTab {
 }
 
 impl State {
-    fn song_changed(&self, text: String) {
-        self.sender
-            .send(GuiMessage::SongChanged(self.song_id, text));
+    fn song_edited(&mut self, state: &Rc<RefCell<State>>) {
+        self.sender.send(GuiMessage::SongEdited(self.song_id));
+
+        // Delay compiling the song until the user stops typing
+        self.cancel_pending_compile();
+        self.compile_timeout = Some(app::add_timeout3(COMPILE_DELAY, {
+            let state = state.clone();
+            move |_| {
+                if let Ok(mut s) = state.try_borrow_mut() {
+                    s.compile_timeout = None;
+                    s.compile_song();
+                }
+            }
+        }));
+    }
+
+    /// Returns true if there was a pending compile
+    fn cancel_pending_compile(&mut self) -> bool {
+        match self.compile_timeout.take() {
+            Some(h) => {
+                app::remove_timeout3(h);
+                true
+            }
+            None => false,
+        }
+    }
+
+    fn flush_pending_compile(&mut self) {
+        if self.cancel_pending_compile() {
+            self.compile_song();
+        }
     }
 
     fn compile_song(&self) {
@@ -728,6 +783,14 @@ impl State {
             .highlight_errors(self.errors.as_ref().map(TextErrorRef::Song));
     }
 
+    fn echo_buffer_overwrite(&mut self, addr: u16) {
+        let text = format!(
+            "\n\nERROR: the echo buffer overwrote song or common audio data at 0x{addr:04x}\n"
+        );
+        self.console_buffer.append(&text);
+        self.console.set_text_color(Color::Red);
+    }
+
     fn set_song_prefix_result(&mut self, r: Result<(), MmlPrefixError>) {
         match r {
             Ok(()) => {
@@ -0,0 +1,238 @@
+//! Speculative audio renderer
+//!
+//! Renders audio ahead of the audio thread on a background thread, so playback does not glitch
+//! when the audio thread is starved of CPU time (ie, when the compiler thread is busy).
+//!
+//! The renderer starts from a clone of the audio thread's emulator and assumes no input is sent
+//! to the emulator.  Everything rendered after the first input (IO command, music channels mask
+//! change, seek, etc) is discarded by `SpeculativeRenderer::stop()`.
+
+// SPDX-FileCopyrightText: © 2024 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+use shvc_sound_emu::{AudioMeters, ShvcSoundEmu};
+
+use std::collections::VecDeque;
+use std::sync::{Arc, Condvar, Mutex, MutexGuard};
+use std::thread;
+
+/// Maximum number of chunks to render ahead of the audio thread (approximately 2 seconds)
+const MAX_CHUNKS_AHEAD: usize = 256;
+
+/// Every Nth chunk includes a snapshot of the emulator after the chunk was rendered.
+///
+/// The audio thread's emulator is only updated at a snapshot, the chunks consumed after the last
+/// snapshot must be emulated again when the renderer is stopped.
+const SNAPSHOT_INTERVAL: u32 = 4;
+
+pub struct SpeculativeChunk<const CHUNK_SIZE: usize> {
+    pub samples: Box<[i16; CHUNK_SIZE]>,
+    pub meters: AudioMeters,
+    /// The emulator state after this chunk was rendered
+    pub snapshot: Option<ShvcSoundEmu>,
+}
+
+struct State<const CHUNK_SIZE: usize> {
+    /// Incremented whenever the renderer is started or stopped.
+    /// Chunks rendered for an old generation are discarded.
+    generation: u64,
+    /// The emulator to render from, taken by the render thread
+    start: Option<ShvcSoundEmu>,
+    chunks: VecDeque<SpeculativeChunk<CHUNK_SIZE>>,
+    quit: bool,
+}
+
+struct Shared<const CHUNK_SIZE: usize> {
+    state: Mutex<State<CHUNK_SIZE>>,
+    /// Notified when `state` changes
+    condvar: Condvar,
+}
+
+impl<const CHUNK_SIZE: usize> Shared<CHUNK_SIZE> {
+    fn lock(&self) -> MutexGuard<'_, State<CHUNK_SIZE>> {
+        // The render thread does not panic while holding the lock,
+        // the state is valid even if the mutex is poisoned.
+        self.state.lock().unwrap_or_else(|e| e.into_inner())
+    }
+
+    fn wait<'a>(
+        &self,
+        guard: MutexGuard<'a, State<CHUNK_SIZE>>,
+    ) -> MutexGuard<'a, State<CHUNK_SIZE>> {
+        self.condvar.wait(guard).unwrap_or_else(|e| e.into_inner())
+    }
+}
+
+/// The audio thread's end of the speculative renderer
+pub struct SpeculativeRenderer<const CHUNK_SIZE: usize> {
+    shared: Arc<Shared<CHUNK_SIZE>>,
+    thread: Option<thread::JoinHandle<()>>,
+
+    active: bool,
+    /// Number of chunks popped since the last snapshot
+    chunks_after_snapshot: usize,
+}
+
+impl<const CHUNK_SIZE: usize> SpeculativeRenderer<CHUNK_SIZE> {
+    pub fn new() -> Self {
+        let shared = Arc::new(Shared {
+            state: Mutex::new(State {
+                generation: 0,
+                start: None,
+                chunks: VecDeque::with_capacity(MAX_CHUNKS_AHEAD),
+                quit: false,
+            }),
+            condvar: Condvar::new(),
+        });
+
+        let thread = thread::Builder::new()
+            .name("speculative_renderer".into())
+            .spawn({
+                let s = shared.clone();
+                move || render_thread::<CHUNK_SIZE>(&s)
+            })
+            .unwrap();
+
+        Self {
+            shared,
+            thread: Some(thread),
+            active: false,
+            chunks_after_snapshot: 0,
+        }
+    }
+
+    pub fn is_active(&self) -> bool {
+        self.active
+    }
+
+    /// Starts rendering audio from `emu` on the render thread.
+    ///
+    /// `emu` must not have any pending input (queued sound effects, etc).
+    pub fn start(&mut self, emu: ShvcSoundEmu) {
+        let mut s = self.shared.lock();
+        s.generation = s.generation.wrapping_add(1);
+        s.chunks.clear();
+        s.start = Some(emu);
+        drop(s);
+
+        self.shared.condvar.notify_all();
+
+        self.active = true;
+        self.chunks_after_snapshot = 0;
+    }
+
+    /// Discards all unconsumed chunks and stops the render thread.
+    ///
+    /// Returns the number of chunks consumed after the last snapshot, which the caller must
+    /// emulate to bring its emulator up to date.
+    #[must_use]
+    pub fn stop(&mut self) -> usize {
+        if !self.active {
+            return 0;
+        }
+
+        let mut s = self.shared.lock();
+        s.generation = s.generation.wrapping_add(1);
+        s.chunks.clear();
+        s.start = None;
+        drop(s);
+
+        self.shared.condvar.notify_all();
+
+        self.active = false;
+        std::mem::take(&mut self.chunks_after_snapshot)
+    }
+
+    /// Returns the next chunk, blocking until it has been rendered.
+    ///
+    /// Returns None if the renderer is not active.
+    pub fn pop(&mut self) -> Option<SpeculativeChunk<CHUNK_SIZE>> {
+        if !self.active {
+            return None;
+        }
+
+        let mut s = self.shared.lock();
+        let chunk = loop {
+            match s.chunks.pop_front() {
+                Some(c) => break c,
+                None => s = self.shared.wait(s),
+            }
+        };
+        drop(s);
+
+        // Wake the render thread if it is waiting for space
+        self.shared.condvar.notify_all();
+
+        match chunk.snapshot {
+            Some(_) => self.chunks_after_snapshot = 0,
+            None => self.chunks_after_snapshot += 1,
+        }
+
+        Some(chunk)
+    }
+}
+
+impl<const CHUNK_SIZE: usize> Drop for SpeculativeRenderer<CHUNK_SIZE> {
+    fn drop(&mut self) {
+        self.shared.lock().quit = true;
+        self.shared.condvar.notify_all();
+
+        if let Some(t) = self.thread.take() {
+            let _ = t.join();
+        }
+    }
+}
+
+fn render_thread<const CHUNK_SIZE: usize>(shared: &Shared<CHUNK_SIZE>) {
+    let mut s = shared.lock();
+
+    loop {
+        // Wait for the next start
+        let (generation, mut emu) = loop {
+            if s.quit {
+                return;
+            }
+            match s.start.take() {
+                Some(emu) => break (s.generation, emu),
+                None => s = shared.wait(s),
+            }
+        };
+        drop(s);
+
+        // Discard the levels of any audio emulated before the start
+        emu.meters();
+
+        let mut n_chunks: u32 = 0;
+
+        s = loop {
+            let mut samples = Box::new([0; CHUNK_SIZE]);
+            emu.emulate_into(samples.as_mut_slice());
+            let meters = emu.meters();
+
+            n_chunks = n_chunks.wrapping_add(1);
+            let snapshot = match n_chunks % SNAPSHOT_INTERVAL {
+                0 => Some(emu.clone()),
+                _ => None,
+            };
+
+            let mut s = shared.lock();
+            if s.generation != generation || s.quit {
+                break s;
+            }
+            s.chunks.push_back(SpeculativeChunk {
+                samples,
+                meters,
+                snapshot,
+            });
+            shared.condvar.notify_all();
+
+            while s.chunks.len() >= MAX_CHUNKS_AHEAD && s.generation == generation && !s.quit {
+                s = shared.wait(s);
+            }
+            if s.generation != generation || s.quit {
+                break s;
+            }
+        };
+    }
+}
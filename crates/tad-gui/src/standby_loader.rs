@@ -0,0 +1,154 @@
+//! Standby emulator loader
+//!
+//! Loads a recompiled song into a second emulator on a background thread, so the audio thread can
+//! switch to the new song data at a chunk boundary instead of stopping playback and rebooting the
+//! audio driver.
+//!
+//! Only the most recent job is loaded.  Queuing a job discards the unprocessed job and any
+//! standby emulator that has not been taken.
+
+// SPDX-FileCopyrightText: © 2024 Marcus Rowe <undisbeliever@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+use std::sync::{Arc, Condvar, Mutex, MutexGuard};
+use std::thread;
+
+struct State<J, S> {
+    /// Incremented every time a job is queued or cancelled
+    generation: u64,
+    job: Option<(u64, J)>,
+    /// The generation of the job the loader thread is processing
+    loading: Option<u64>,
+    standby: Option<S>,
+    quit: bool,
+}
+
+struct Shared<J, S> {
+    state: Mutex<State<J, S>>,
+    /// Notified when a job is queued or `quit` is set
+    condvar: Condvar,
+}
+
+impl<J, S> Shared<J, S> {
+    fn lock(&self) -> MutexGuard<'_, State<J, S>> {
+        // The loader thread does not hold the lock while loading,
+        // the state is valid even if the mutex is poisoned.
+        self.state.lock().unwrap_or_else(|e| e.into_inner())
+    }
+}
+
+/// Loads standby emulators on a background thread
+pub struct StandbyLoader<J, S> {
+    shared: Arc<Shared<J, S>>,
+    thread: Option<thread::JoinHandle<()>>,
+}
+
+impl<J, S> StandbyLoader<J, S>
+where
+    J: Send + 'static,
+    S: Send + 'static,
+{
+    /// Spawns the loader thread.
+    ///
+    /// `load` is called on the loader thread for every job that is not replaced before it starts.
+    pub fn new<F>(mut load: F) -> Self
+    where
+        F: FnMut(J) -> Option<S> + Send + 'static,
+    {
+        let shared = Arc::new(Shared {
+            state: Mutex::new(State {
+                generation: 0,
+                job: None,
+                loading: None,
+                standby: None,
+                quit: false,
+            }),
+            condvar: Condvar::new(),
+        });
+
+        let thread = thread::Builder::new()
+            .name("standby_loader".into())
+            .spawn({
+                let shared = shared.clone();
+                move || loader_thread(&shared, &mut load)
+            })
+            .unwrap();
+
+        Self {
+            shared,
+            thread: Some(thread),
+        }
+    }
+}
+
+impl<J, S> StandbyLoader<J, S> {
+    /// Queues a job, replacing the unprocessed job and discarding the previous standby emulator
+    pub fn queue(&self, job: J) {
+        let mut s = self.shared.lock();
+        s.generation += 1;
+        s.job = Some((s.generation, job));
+        s.standby = None;
+        drop(s);
+
+        self.shared.condvar.notify_all();
+    }
+
+    /// Discards the unprocessed job and the standby emulator that is loading or loaded
+    pub fn cancel(&self) {
+        let mut s = self.shared.lock();
+        s.generation += 1;
+        s.job = None;
+        s.standby = None;
+    }
+
+    /// Returns true if the queued job has not been loaded or taken
+    pub fn is_pending(&self) -> bool {
+        let s = self.shared.lock();
+        s.job.is_some() || s.loading == Some(s.generation) || s.standby.is_some()
+    }
+
+    /// Takes the standby emulator of the last queued job (if it has been loaded)
+    pub fn take(&self) -> Option<S> {
+        self.shared.lock().standby.take()
+    }
+}
+
+impl<J, S> Drop for StandbyLoader<J, S> {
+    fn drop(&mut self) {
+        self.shared.lock().quit = true;
+        self.shared.condvar.notify_all();
+
+        if let Some(t) = self.thread.take() {
+            let _ = t.join();
+        }
+    }
+}
+
+fn loader_thread<J, S>(shared: &Shared<J, S>, load: &mut impl FnMut(J) -> Option<S>) {
+    let mut s = shared.lock();
+
+    loop {
+        let (generation, job) = loop {
+            if s.quit {
+                return;
+            }
+            match s.job.take() {
+                Some(j) => break j,
+                None => s = shared.condvar.wait(s).unwrap_or_else(|e| e.into_inner()),
+            }
+        };
+        s.loading = Some(generation);
+        drop(s);
+
+        let standby = load(job);
+
+        s = shared.lock();
+        s.loading = None;
+
+        // Discard the emulator if the job was replaced or cancelled while it was loading
+        if s.generation == generation {
+            s.standby = standby;
+        }
+    }
+}
@@ -11,6 +11,7 @@ use brr::{encode_brr, read_mono_pcm_wave_file, BrrFilter, Evaluator};
 use clap::Parser;
 
 use std::fs;
+use std::io::BufReader;
 use std::path::PathBuf;
 
 #[derive(clap::ValueEnum, Clone)]
@@ -122,7 +123,7 @@ fn main() {
     let wav = {
         let mut wave_file = match fs::File::open(&args.input) {
             Err(why) => error!("Couldn't open {}: {}", args.input.display(), why),
-            Ok(file) => file,
+            Ok(file) => BufReader::new(file),
         };
 
         match read_mono_pcm_wave_file(&mut wave_file, u16::MAX.into()) {